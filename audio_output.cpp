@@ -0,0 +1,303 @@
+#include "audio_output.h"
+#include "event_log.h"
+#include "profile_zones.h"
+#include "sdl_init.h"
+#include "thread_tuning.h"
+#include <algorithm> // For std::clamp and std::max
+#include <cmath>     // For std::pow, std::floor
+
+namespace
+{
+    const double toneHz = 440.0;
+    const float amplitude = 0.25f;
+
+    // Correction near a step of the naive square, t the phase past the
+    // step and dt the phase per sample: smooths it over two samples
+    double polyBlep(double t, double dt)
+    {
+        if (t < dt)
+        {
+            t /= dt;
+            return t + t - t * t - 1.0;
+        }
+        if (t > 1.0 - dt)
+        {
+            t = (t - 1.0) / dt;
+            return t * t + t + t + 1.0;
+        }
+        return 0.0;
+    }
+}
+
+AudioOutput::AudioOutput(const SoundState &soundRef, int bufferSamples)
+    : AudioOutput(std::vector<const SoundState *>{&soundRef}, bufferSamples)
+{
+}
+
+// The voices are made before the device thread starts, and never change
+AudioOutput::AudioOutput(const std::vector<const SoundState *> &sources, int bufferSamples)
+    : voices([&sources]
+             {
+                 std::vector<std::unique_ptr<Voice>> made;
+                 for (const SoundState *source : sources)
+                     made.push_back(std::make_unique<Voice>(*source));
+                 return made; }()),
+      requestedSamples(std::clamp(bufferSamples, 128, 1024)), deviceThread(&AudioOutput::run, this)
+{
+}
+
+AudioOutput::~AudioOutput()
+{
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        stopping = true;
+    }
+    requestWake.notify_one();
+    deviceThread.join();
+}
+
+void AudioOutput::setGain(size_t source, float gain)
+{
+    if (source < voices.size())
+        voices[source]->gain.store(std::clamp(gain, 0.0f, 1.0f), std::memory_order_relaxed);
+}
+
+void AudioOutput::setBufferSamples(int samples)
+{
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        requestedSamples = std::clamp(samples, 128, 1024);
+        resize = true;
+    }
+    requestWake.notify_one();
+}
+
+// Opens the device, then checks on it every checkInterval. SDL marks a
+// device that went away as stopped. Without one open, opening is retried
+// every retryInterval, as starting the driver isn't free.
+void AudioOutput::run()
+{
+    open();
+    std::unique_lock<std::mutex> lock(requestMutex);
+    while (!stopping)
+    {
+        const bool closed = device.load(std::memory_order_relaxed) == 0;
+        requestWake.wait_for(lock, closed ? retryInterval : checkInterval, [this]
+                             { return stopping || resize; });
+        if (stopping)
+            break;
+        const SDL_AudioDeviceID id = device.load(std::memory_order_relaxed);
+        const bool lost = id != 0 && SDL_GetAudioDeviceStatus(id) == SDL_AUDIO_STOPPED;
+        const bool resized = resize;
+        if (!resized && !lost && id != 0)
+            continue;
+        resize = false;
+
+        lock.unlock();
+        close();
+        if (open() && !resized)
+            reopens.fetch_add(1, std::memory_order_relaxed);
+        lock.lock();
+    }
+    lock.unlock();
+    close();
+}
+
+bool AudioOutput::open()
+{
+    {
+        std::lock_guard<std::mutex> lock(sdlSubsystemMutex());
+        if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0)
+            return false;
+    }
+
+    SDL_AudioSpec want{};
+    want.freq = 44100;
+    want.format = AUDIO_F32SYS;
+    want.channels = 1;
+    {
+        std::lock_guard<std::mutex> lock(requestMutex);
+        want.samples = static_cast<Uint16>(requestedSamples);
+    }
+    want.callback = &AudioOutput::fill;
+    want.userdata = this;
+
+    SDL_AudioSpec have{};
+    const SDL_AudioDeviceID id = SDL_OpenAudioDevice(nullptr, 0, &want, &have,
+                                                     SDL_AUDIO_ALLOW_FREQUENCY_CHANGE | SDL_AUDIO_ALLOW_SAMPLES_CHANGE);
+    if (id == 0)
+    {
+        std::lock_guard<std::mutex> lock(sdlSubsystemMutex());
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return false;
+    }
+    sampleRate = have.freq;
+    lastCallback = {}; // No gap to the new device's first callback
+    obtainedSamples.store(have.samples, std::memory_order_relaxed);
+    device.store(id, std::memory_order_release);
+    SDL_PauseAudioDevice(id, 0);
+    return true;
+}
+
+void AudioOutput::close()
+{
+    const SDL_AudioDeviceID id = device.exchange(0);
+    if (id != 0)
+    {
+        SDL_CloseAudioDevice(id); // Returns once no callback is running
+        obtainedSamples.store(0, std::memory_order_relaxed);
+        std::lock_guard<std::mutex> lock(sdlSubsystemMutex());
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    }
+}
+
+void SDLCALL AudioOutput::fill(void *userdata, Uint8 *stream, int len)
+{
+    CHIP8_ZONE("Audio callback");
+    AudioOutput *self = static_cast<AudioOutput *>(userdata);
+    ThreadTuning::shared().apply(ThreadTuning::Role::Audio);
+    self->noteCallback();
+    self->render(reinterpret_cast<float *>(stream), len / static_cast<int>(sizeof(float)));
+}
+
+void AudioOutput::noteCallback()
+{
+    auto now = std::chrono::steady_clock::now();
+    if (lastCallback.time_since_epoch().count() != 0)
+    {
+        uint32_t gap = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - lastCallback).count());
+        uint32_t longest = longestGap.load(std::memory_order_relaxed);
+        while (gap > longest && !longestGap.compare_exchange_weak(longest, gap, std::memory_order_relaxed))
+        {
+        }
+
+        // A gap of two buffers left the device with nothing to play; these
+        // go to the event log once a second at most
+        const uint32_t bufferMicros = static_cast<uint32_t>(obtainedSamples.load(std::memory_order_relaxed) * 1000000LL / sampleRate);
+        if (gap > 2 * bufferMicros)
+        {
+            ++underruns;
+            worstUnderrun = std::max(worstUnderrun, gap);
+        }
+        if (underruns > 0 && now - underrunLogged >= std::chrono::seconds(1))
+        {
+            EventLog::shared().record(EventLog::Kind::AudioUnderrun, worstUnderrun, bufferMicros, underruns);
+            underrunLogged = now;
+            underruns = 0;
+            worstUnderrun = 0;
+        }
+    }
+    lastCallback = now;
+}
+
+// Sums the sounding voices, each at its gain, scaled down by the total
+// gain once that passes 1
+void AudioOutput::render(float *out, int count)
+{
+    for (int i = 0; i < count; ++i)
+        out[i] = 0.0f;
+    float total = 0.0f;
+    for (const auto &voice : voices)
+    {
+        const float gain = voice->gain.load(std::memory_order_relaxed);
+        if (!takeSound(*voice, count) || gain <= 0.0f)
+            continue;
+        renderVoice(*voice, out, count, gain);
+        total += gain;
+    }
+    if (total > 1.0f)
+    {
+        const float scale = 1.0f / total;
+        for (int i = 0; i < count; ++i)
+            out[i] *= scale;
+    }
+}
+
+// Reads the voice's source for this buffer, false if its buzzer is off
+bool AudioOutput::takeSound(Voice &voice, int count)
+{
+    const SoundState &sound = voice.sound;
+
+    // Take the pattern only if no frame was being published meanwhile
+    uint32_t seq = sound.sequence.load(std::memory_order_acquire);
+    if (!(seq & 1))
+    {
+        uint64_t high = sound.patternHigh.load(std::memory_order_relaxed);
+        uint64_t low = sound.patternLow.load(std::memory_order_relaxed);
+        uint8_t newPitch = sound.pitch.load(std::memory_order_relaxed);
+        bool newPatterned = sound.patterned.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (sound.sequence.load(std::memory_order_relaxed) == seq)
+        {
+            voice.patternHigh = high;
+            voice.patternLow = low;
+            voice.pitch = newPitch;
+            voice.patterned = newPatterned;
+        }
+    }
+
+    if (!sound.tone.load(std::memory_order_relaxed))
+    {
+        voice.toneWasOn = false;
+        return false;
+    }
+
+    // This buffer plays once the one before it has: the beep is heard
+    // about a buffer from now
+    if (!voice.toneWasOn)
+    {
+        voice.toneWasOn = true;
+        const int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(lastCallback.time_since_epoch()).count();
+        const int64_t waited = now - sound.toneSince.load(std::memory_order_relaxed);
+        const int64_t buffer = static_cast<int64_t>(count) * 1000000 / sampleRate;
+        lastBeepLatency.store(static_cast<uint32_t>(std::clamp<int64_t>(waited + buffer, 0, UINT32_MAX)), std::memory_order_relaxed);
+    }
+    return true;
+}
+
+// Adds the voice's wave at gain to out
+void AudioOutput::renderVoice(Voice &voice, float *out, int count, float gain)
+{
+    const double level = amplitude * gain;
+    if (voice.patterned)
+    {
+        // XO-CHIP plays the pattern at 4000 * 2^((pitch - 64) / 48) bits a
+        // second; each sample is the average of the bits it spans
+        const double step = 4000.0 * std::pow(2.0, (voice.pitch - 64) / 48.0) / sampleRate;
+        double pos = voice.patternPos;
+        for (int i = 0; i < count; ++i)
+        {
+            const double end = pos + step;
+            double on = 0;
+            for (double at = pos; at < end;)
+            {
+                const double next = std::min(std::floor(at) + 1.0, end);
+                const int bit = static_cast<int>(at) & 127;
+                const uint64_t word = bit < 64 ? voice.patternHigh : voice.patternLow;
+                if ((word >> (63 - (bit & 63))) & 1)
+                    on += next - at;
+                at = next;
+            }
+            out[i] += static_cast<float>((on / step * 2.0 - 1.0) * level);
+            pos = end >= 128.0 ? end - 128.0 : end;
+        }
+        voice.patternPos = pos;
+        return;
+    }
+
+    // The phase carries over between callbacks, so the wave has no seams
+    const double step = toneHz / sampleRate;
+    double pos = voice.phase;
+    for (int i = 0; i < count; ++i)
+    {
+        double half = pos + 0.5;
+        if (half >= 1.0)
+            half -= 1.0;
+        const double value = (pos < 0.5 ? 1.0 : -1.0) + polyBlep(pos, step) - polyBlep(half, step);
+        out[i] += static_cast<float>(value * level);
+        pos += step;
+        if (pos >= 1.0)
+            pos -= 1.0;
+    }
+    voice.phase = pos;
+}
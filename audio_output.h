@@ -0,0 +1,126 @@
+#ifndef AUDIO_OUTPUT_H
+#define AUDIO_OUTPUT_H
+
+#include "sound_state.h"
+#include <SDL2/SDL.h>
+#include <atomic>  // For the callback gap read by the GUI
+#include <chrono>             // For timing callbacks
+#include <condition_variable> // For waking the device thread
+#include <cstdint>            // For uint64_t
+#include <memory>             // For the voices
+#include <mutex>              // For the device thread's requests
+#include <thread>             // For opening the device in the background
+#include <vector>             // For the sources
+
+// SDL audio device for the CHIP-8 buzzer. The device callback synthesizes
+// samples straight from the published SoundState: a phase-continuous square
+// wave for the plain buzzer, band-limited with polyBLEP so its edges don't
+// alias, or the XO-CHIP 1-bit pattern averaged over each sample's span of
+// its pitch-dependent rate. Nothing is queued or allocated per frame and
+// latency stays at one device buffer, whose size can be chosen.
+//
+// One device can play several machines, such as the tiles of the ROM wall:
+// the callback reads each source's SoundState and mixes the ones sounding,
+// each at its own gain. When the gains of the sounding sources add up to
+// more than 1 the mix is scaled down by their sum, so it never gets louder
+// than one buzzer at full gain.
+//
+// Starting an audio driver can take hundreds of milliseconds, so the device
+// opens on a thread of its own and the window doesn't wait for it; it is
+// normally running well before a game first sounds the buzzer. The thread
+// then looks after the device: one that disappears (a headset unplugged)
+// is closed and opened again, on the new default output, until that works.
+// The emulation only ever publishes SoundState and never waits on any of it.
+class AudioOutput
+{
+public:
+    static constexpr int defaultBufferSamples = 512; // About 12 ms at 44.1 kHz
+
+    explicit AudioOutput(const SoundState &soundRef, int bufferSamples = defaultBufferSamples);
+    explicit AudioOutput(const std::vector<const SoundState *> &sources, int bufferSamples = defaultBufferSamples);
+    ~AudioOutput();
+
+    AudioOutput(const AudioOutput &) = delete;
+    AudioOutput &operator=(const AudioOutput &) = delete;
+
+    // False until the device has opened, and for good if it can't
+    bool isOpen() const { return device.load(std::memory_order_acquire) != 0; }
+
+    // Longest wait between two device callbacks since the last call, in
+    // microseconds. Normally one buffer; more means the device went hungry.
+    uint32_t takeLongestGap() { return longestGap.exchange(0, std::memory_order_relaxed); }
+
+    // Reopens the device with buffers of about this many samples, 128 to
+    // 1024; smaller ones answer sooner but starve more easily
+    void setBufferSamples(int samples);
+    int bufferSamples() const { return obtainedSamples.load(std::memory_order_relaxed); } // As the device granted
+
+    // From the emulation thread turning the buzzer on to when the first
+    // sample of it is due out of SDL, for the last beep, in microseconds:
+    // the wait for the callback plus the buffer it fills, which plays next.
+    // The driver's own buffering comes on top. 0 until a beep has played.
+    uint32_t beepLatency() const { return lastBeepLatency.load(std::memory_order_relaxed); }
+
+    // Times a device was opened after losing one, or after none would open
+    uint32_t reopenCount() const { return reopens.load(std::memory_order_relaxed); }
+
+    // Level of source i, from 0 (muted) to 1, the default; the callback
+    // picks it up with its next buffer
+    void setGain(size_t source, float gain);
+
+private:
+    static constexpr std::chrono::milliseconds checkInterval{500};
+    static constexpr std::chrono::milliseconds retryInterval{2000};
+
+    void run(); // The device thread
+    bool open();
+    void close();
+    static void SDLCALL fill(void *userdata, Uint8 *stream, int len);
+    // A source and the callback's synthesis state for it
+    struct Voice
+    {
+        explicit Voice(const SoundState &soundRef) : sound(soundRef) {}
+
+        const SoundState &sound;
+        std::atomic<float> gain{1.0f};
+
+        // Owned by the audio callback
+        double phase = 0;        // Plain buzzer position within the wave period, [0, 1)
+        double patternPos = 0;   // XO-CHIP position within the pattern, [0, 128)
+        uint64_t patternHigh = 0; // Last pattern read without a concurrent write
+        uint64_t patternLow = 0;
+        uint8_t pitch = 64;
+        bool patterned = false;
+        bool toneWasOn = false;
+    };
+
+    void noteCallback();
+    void render(float *out, int count);
+    bool takeSound(Voice &voice, int count); // False if the voice is silent
+    void renderVoice(Voice &voice, float *out, int count, float gain);
+
+    std::vector<std::unique_ptr<Voice>> voices; // Fixed at construction
+    std::atomic<SDL_AudioDeviceID> device{0};
+    int sampleRate = 44100; // Set before the device starts calling back
+    std::atomic<int> obtainedSamples{0};
+    std::atomic<uint32_t> reopens{0};
+    std::atomic<uint32_t> longestGap{0};
+    std::atomic<uint32_t> lastBeepLatency{0};
+
+    // Owned by the audio callback
+    std::chrono::steady_clock::time_point lastCallback{};
+    std::chrono::steady_clock::time_point underrunLogged{}; // Last underrun event log entry
+    uint32_t underruns = 0;     // Callbacks late by more than a buffer since then
+    uint32_t worstUnderrun = 0; // And the longest gap, in microseconds
+
+    // Requests to the device thread
+    std::mutex requestMutex;
+    std::condition_variable requestWake;
+    int requestedSamples;
+    bool resize = false;
+    bool stopping = false;
+
+    std::thread deviceThread; // Declared last, so it starts with every member set
+};
+
+#endif
@@ -0,0 +1,181 @@
+#include "autosave.h"
+#include "event_log.h"
+#include <cstdio>     // For the flushed writes
+#include <filesystem> // For the rename into place
+#include <iterator>   // For std::next
+
+#if defined(_WIN32)
+#include <io.h> // For _commit
+#else
+#include <unistd.h> // For fsync
+#endif
+
+Autosaver::~Autosaver()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (writer.joinable())
+        writer.join();
+}
+
+Autosaver &Autosaver::shared()
+{
+    static Autosaver saver;
+    return saver;
+}
+
+int Autosaver::open(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!writer.joinable())
+        writer = std::thread(&Autosaver::writeLoop, this);
+    const int session = nextSession++;
+    sessions[session].path = path;
+    return session;
+}
+
+void Autosaver::close(int session)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    auto found = sessions.find(session);
+    if (found == sessions.end())
+        return;
+    if (!found->second.pending)
+    {
+        sessions.erase(found);
+        return;
+    }
+    // The writer drops it once the last state is on disk
+    found->second.closing = true;
+    wake.notify_all();
+    written.wait(lock, [&]
+                 { return sessions.find(session) == sessions.end(); });
+}
+
+bool Autosaver::submit(int session, const Chip8::Snapshot &state)
+{
+    std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+    if (!lock.owns_lock())
+        return false;
+    auto found = sessions.find(session);
+    if (found == sessions.end() || found->second.closing)
+        return false;
+    found->second.state = state;
+    if (!found->second.pending)
+    {
+        found->second.pending = true;
+        wake.notify_one();
+    }
+    return true;
+}
+
+uint64_t Autosaver::writes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return writeCount;
+}
+
+uint64_t Autosaver::failures() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return failureCount;
+}
+
+// Holds the lock only to copy states out, never across a write
+void Autosaver::writeLoop()
+{
+    std::vector<Job> batch;
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        wake.wait(lock, [&]
+                  { return stopping || hasPending(); });
+        if (stopping && !hasPending())
+            break;
+
+        // Let the other sessions' states catch up with the first, unless
+        // something is waiting on this one
+        bool hurry = stopping;
+        for (const auto &entry : sessions)
+            hurry = hurry || entry.second.closing;
+        if (!hurry)
+            wake.wait_for(lock, batchDelay, [&]
+                          { return stopping; });
+        takeBatch(batch);
+
+        lock.unlock();
+        uint64_t ok = 0;
+        for (const Job &job : batch)
+            ok += write(job) ? 1 : 0;
+        lock.lock();
+        writeCount += ok;
+        failureCount += batch.size() - ok;
+        for (auto it = sessions.begin(); it != sessions.end();)
+            it = it->second.closing && !it->second.pending ? sessions.erase(it) : std::next(it);
+        written.notify_all();
+        batch.clear();
+    }
+}
+
+bool Autosaver::hasPending() const
+{
+    for (const auto &entry : sessions)
+    {
+        if (entry.second.pending)
+            return true;
+    }
+    return false;
+}
+
+void Autosaver::takeBatch(std::vector<Job> &batch)
+{
+    for (auto &entry : sessions)
+    {
+        Session &session = entry.second;
+        if (!session.pending)
+            continue;
+        batch.push_back({session.path, session.state});
+        session.pending = false;
+    }
+}
+
+bool Autosaver::write(const Job &job)
+{
+    scratch.restore(job.state);
+    const std::vector<uint8_t> blob = scratch.saveState();
+    const auto started = std::chrono::steady_clock::now();
+    const bool ok = writeFile(job.path, blob);
+    const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started).count();
+    EventLog::shared().record(EventLog::Kind::Snapshot, static_cast<int64_t>(blob.size()), micros, ok,
+                              std::filesystem::u8path(job.path).filename().u8string().c_str());
+    return ok;
+}
+
+bool Autosaver::writeFile(const std::string &target, const std::vector<uint8_t> &blob)
+{
+    std::error_code ec;
+    const std::filesystem::path path = std::filesystem::u8path(target);
+    if (path.has_parent_path())
+        std::filesystem::create_directories(path.parent_path(), ec);
+    const std::string temporary = target + ".tmp";
+    FILE *file = std::fopen(temporary.c_str(), "wb");
+    if (!file)
+        return false;
+
+    // On the disk before the rename, or power loss could leave the new
+    // name on a file that never got its data
+    bool ok = std::fwrite(blob.data(), 1, blob.size(), file) == blob.size() && std::fflush(file) == 0;
+#if defined(_WIN32)
+    ok = ok && _commit(_fileno(file)) == 0;
+#else
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok)
+        return false;
+    std::filesystem::rename(std::filesystem::u8path(temporary), path, ec);
+    return !ec;
+}
@@ -0,0 +1,88 @@
+#ifndef AUTOSAVE_H
+#define AUTOSAVE_H
+
+#include "chip8.h"
+#include <chrono>             // For the batching delay
+#include <condition_variable> // For the idle writer
+#include <cstdint>            // For the counters
+#include <mutex>              // For the pending states
+#include <string>             // For paths
+#include <thread>             // For the writer thread
+#include <unordered_map>      // For the sessions
+#include <vector>             // For a batch
+
+// Keeps a save state of every running session on disk, for kiosks that
+// lose power. Emulation threads hand over their machine's state struct,
+// a copy and no serializing, and never wait: the writer turns the latest
+// state of each session into a saveState() blob and writes it on its own
+// thread. States that arrive close together go out as one batch, each
+// written next to its file, flushed to the disk and renamed over it, so a
+// crash leaves the previous save or the new one and never half of one.
+//
+// A session's file is an ordinary save state, read back with
+// Chip8::loadStateFile.
+class Autosaver
+{
+public:
+    // States handed over within this long of the first go out together
+    static constexpr std::chrono::milliseconds batchDelay{250};
+
+    Autosaver() = default;
+    ~Autosaver(); // Writes what is still pending
+    Autosaver(const Autosaver &) = delete;
+    Autosaver &operator=(const Autosaver &) = delete;
+
+    static Autosaver &shared();
+
+    // A session saving to path; starts the writer with the first one
+    int open(const std::string &path);
+
+    // Writes the session's last state if it is pending, then forgets it.
+    // Waits for the disk, so not for emulation threads.
+    void close(int session);
+
+    // Lets the writer save state for session, replacing one it hasn't got
+    // to. Copies the state and returns, false without waiting if the
+    // writer is taking a batch just then; the caller tries again later.
+    bool submit(int session, const Chip8::Snapshot &state);
+
+    uint64_t writes() const;   // Files written since startup
+    uint64_t failures() const; // Files that couldn't be
+
+private:
+    struct Session
+    {
+        std::string path;
+        Chip8::Snapshot state;
+        bool pending = false;
+        bool closing = false;
+    };
+
+    struct Job
+    {
+        std::string path;
+        Chip8::Snapshot state;
+    };
+
+    void writeLoop();
+    // With mutex held
+    bool hasPending() const;
+    void takeBatch(std::vector<Job> &batch); // Moves out every pending state
+    bool write(const Job &job);
+    static bool writeFile(const std::string &path, const std::vector<uint8_t> &blob);
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable written; // For close()
+    std::unordered_map<int, Session> sessions;
+    int nextSession = 0;
+    uint64_t writeCount = 0;
+    uint64_t failureCount = 0;
+    bool stopping = false;
+    std::thread writer;
+
+    // Writer thread only: the scratch machine the blobs come from
+    Chip8 scratch;
+};
+
+#endif
@@ -0,0 +1,385 @@
+// Batch runner: emulates every ROM under several interpreter cores at
+// once, spread over all hardware threads, and reports per-ROM results
+// (load status, distinct final screens across cores, throughput). Every
+// instance uses the same RNG seed, so all cores must end on one screen.
+// Workers are spread over the NUMA nodes and keep their machines in
+// arenas on their own node, backed by 2 MB huge pages where available, so
+// runs of many instances neither cross sockets nor thrash the TLB.
+//
+//   chip8-batch [options] <rom files or folders...>
+//     --frames N     frames to run per instance (default 600)
+//     --ipf N        instructions per frame (default 5)
+//     --cores LIST   comma separated cores (default switch,table,predecoded,jit)
+//     --instances N  copies of each ROM on each core, stepped side by side
+//                    a frame at a time by one worker (default 1)
+//     --threads N    worker threads (default: all hardware threads)
+//     --seed N       CXNN seed shared by every instance (default 1)
+//     --no-numa      leave workers unpinned and memory wherever it lands
+//     --metrics FILE write Prometheus metrics there at the end, for
+//                    node_exporter's textfile collector
+
+#include "chip8.h"
+#include "metrics.h"
+#include "numa_arena.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    struct CoreConfig
+    {
+        const char *name;
+        Chip8::Core core;
+        size_t index; // In knownCores
+    };
+
+    const CoreConfig knownCores[] = {
+        {"switch", Chip8::Core::Switch, 0},
+        {"table", Chip8::Core::Table, 1},
+        {"predecoded", Chip8::Core::Predecoded, 2},
+        {"jit", Chip8::Core::Jit, 3},
+    };
+
+    // Each instance and each result on its own cache line, so workers never false-share
+    struct alignas(64) Instance
+    {
+        explicit Instance(Chip8::Core core) : chip8(core) {}
+        Chip8 chip8;
+    };
+
+    // The worker's node, its arena there and the instances it has finished
+    // with, per core, for its next job on that core. A Chip8 is tens of
+    // kilobytes and a JIT one maps its own code buffer, so jobs reuse them:
+    // loadROM() resets everything a run depends on, and keeps the decoded
+    // code when the ROM is the same. Instances live in the arena, which
+    // outlives them as it is declared first.
+    struct InstancePool
+    {
+        int node = -1; // Index into numa::nodes(), -1 until the first job
+        std::unique_ptr<numa::Arena> arena;
+        std::vector<Instance *> spare[std::size(knownCores)];
+        std::vector<Instance *> all;
+
+        ~InstancePool()
+        {
+            for (Instance *instance : all)
+                instance->~Instance();
+        }
+
+        Instance *acquire(size_t core, Chip8::Core kind)
+        {
+            if (!spare[core].empty())
+            {
+                Instance *instance = spare[core].back();
+                spare[core].pop_back();
+                return instance;
+            }
+            void *memory = arena->allocate(sizeof(Instance), alignof(Instance));
+            if (!memory)
+                throw std::bad_alloc();
+            all.push_back(new (memory) Instance(kind));
+            return all.back();
+        }
+
+        void release(size_t core, Instance *instance) { spare[core].push_back(instance); }
+    };
+
+    thread_local InstancePool workerInstances;
+    std::atomic<unsigned> workersPlaced{0};
+
+    // On a worker's first job: the next node round-robin, pinned there
+    // with its arena, so what it allocates is local to where it runs
+    void placeWorker(bool useNuma)
+    {
+        InstancePool &pool = workerInstances;
+        if (pool.arena)
+            return;
+        const std::vector<numa::Node> &nodes = numa::nodes();
+        pool.node = static_cast<int>(workersPlaced.fetch_add(1) % nodes.size());
+        const bool bound = useNuma && nodes.size() > 1 && numa::bindThread(nodes[pool.node]);
+        pool.arena = std::make_unique<numa::Arena>(bound ? nodes[pool.node].id : -1);
+    }
+
+    struct alignas(64) Result
+    {
+        bool loaded = false;
+        uint64_t screenHash = 0; // Of the first instance; the others must match it
+        bool copiesAgree = true;
+        double seconds = 0;
+        int node = 0; // Of the worker that ran it
+    };
+
+    // What each node's workers got through, and the arenas they hold
+    struct alignas(64) NodeStats
+    {
+        std::atomic<long long> jobs{0};
+        std::atomic<long long> micros{0};
+        std::atomic<size_t> reserved{0};
+        std::atomic<size_t> hugeReserved{0};
+        std::atomic<unsigned> workers{0};
+    };
+
+    // FNV-1a over the display, enough to tell whether two runs agree
+    uint64_t hashScreen(const Chip8 &chip8)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (uint64_t row : chip8.gfx)
+        {
+            for (int byte = 0; byte < 8; ++byte)
+            {
+                hash ^= (row >> (byte * 8)) & 0xFF;
+                hash *= 1099511628211ull;
+            }
+        }
+        return hash;
+    }
+
+    void usage()
+    {
+        std::fprintf(stderr, "usage: chip8-batch [--frames N] [--ipf N] [--cores LIST] [--instances N] [--threads N] [--seed N] "
+                             "[--no-numa] [--metrics FILE] <rom files or folders...>\n");
+    }
+
+    bool parseCores(const std::string &list, std::vector<CoreConfig> &cores)
+    {
+        std::stringstream ss(list);
+        std::string name;
+        while (std::getline(ss, name, ','))
+        {
+            bool found = false;
+            for (const CoreConfig &config : knownCores)
+            {
+                if (name == config.name)
+                {
+                    cores.push_back(config);
+                    found = true;
+                }
+            }
+            if (!found)
+                return false;
+        }
+        return !cores.empty();
+    }
+
+    void collectRoms(const fs::path &path, std::vector<std::string> &roms)
+    {
+        std::error_code ec;
+        if (!fs::is_directory(path, ec))
+        {
+            roms.push_back(path.string());
+            return;
+        }
+        for (const fs::directory_entry &entry : fs::directory_iterator(path, ec))
+        {
+            std::string ext = entry.path().extension().string();
+            if (entry.is_regular_file() && (ext == ".ch8" || ext == ".rom"))
+                roms.push_back(entry.path().string());
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    long long frames = 600;
+    int ipf = 5;
+    int instances = 1;
+    bool useNuma = true;
+    unsigned threads = 0;
+    uint64_t seed = 1;
+    std::string metricsPath;
+    std::vector<CoreConfig> cores;
+    std::vector<std::string> roms;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--frames" && hasValue)
+            frames = std::atoll(argv[++i]);
+        else if (arg == "--ipf" && hasValue)
+            ipf = std::atoi(argv[++i]);
+        else if (arg == "--instances" && hasValue)
+            instances = std::atoi(argv[++i]);
+        else if (arg == "--no-numa")
+            useNuma = false;
+        else if (arg == "--threads" && hasValue)
+            threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (arg == "--seed" && hasValue)
+            seed = std::strtoull(argv[++i], nullptr, 0);
+        else if (arg == "--metrics" && hasValue)
+            metricsPath = argv[++i];
+        else if (arg == "--cores" && hasValue)
+        {
+            if (!parseCores(argv[++i], cores))
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if (arg[0] != '-')
+            collectRoms(arg, roms);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (roms.empty() || ipf <= 0 || frames < 0 || instances <= 0)
+    {
+        usage();
+        return 1;
+    }
+    if (cores.empty())
+        cores.assign(std::begin(knownCores), std::end(knownCores));
+
+    // One job per (ROM, core) pair
+    std::vector<Result> results(roms.size() * cores.size());
+    std::vector<NodeStats> nodeStats(numa::nodes().size());
+    ThreadPool pool(threads);
+    FrameMetrics metrics;
+    const bool timeFrames = !metricsPath.empty();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < roms.size(); ++r)
+    {
+        for (size_t c = 0; c < cores.size(); ++c)
+        {
+            pool.submit([&, r, c]
+                        {
+                            const bool placed = workerInstances.arena != nullptr;
+                            placeWorker(useNuma);
+                            NodeStats &stats = nodeStats[workerInstances.node];
+                            if (!placed)
+                                stats.workers.fetch_add(1, std::memory_order_relaxed);
+                            const size_t reservedBefore = workerInstances.arena->reserved();
+                            const size_t hugeBefore = workerInstances.arena->hugeReserved();
+
+                            Result &result = results[r * cores.size() + c];
+                            result.node = workerInstances.node;
+                            std::vector<Instance *> machines;
+                            bool loaded = true;
+                            for (int n = 0; n < instances && loaded; ++n)
+                            {
+                                machines.push_back(workerInstances.acquire(cores[c].index, cores[c].core));
+                                loaded = machines.back()->chip8.loadROM(roms[r]);
+                                machines.back()->chip8.seedRandom(seed);
+                            }
+
+                            if (loaded)
+                            {
+                                // Frame by frame across the copies, as a
+                                // training batch steps them
+                                auto t0 = std::chrono::steady_clock::now();
+                                for (long long f = 0; f < frames; ++f)
+                                {
+                                    const auto frameStart = timeFrames ? std::chrono::steady_clock::now() : t0;
+                                    for (Instance *instance : machines)
+                                        instance->chip8.runFrame(ipf);
+                                    if (timeFrames)
+                                        metrics.recordFrame(static_cast<uint64_t>(ipf) * machines.size(),
+                                                            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                                                std::chrono::steady_clock::now() - frameStart)
+                                                                .count());
+                                }
+                                result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+                                result.screenHash = hashScreen(machines[0]->chip8);
+                                for (Instance *instance : machines)
+                                    result.copiesAgree = result.copiesAgree && hashScreen(instance->chip8) == result.screenHash;
+                                result.loaded = true;
+                                stats.jobs.fetch_add(1, std::memory_order_relaxed);
+                                stats.micros.fetch_add(static_cast<long long>(result.seconds * 1e6), std::memory_order_relaxed);
+                            }
+                            for (Instance *instance : machines)
+                                workerInstances.release(cores[c].index, instance);
+                            stats.reserved.fetch_add(workerInstances.arena->reserved() - reservedBefore, std::memory_order_relaxed);
+                            stats.hugeReserved.fetch_add(workerInstances.arena->hugeReserved() - hugeBefore, std::memory_order_relaxed);
+                        });
+        }
+    }
+    pool.wait();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    // Aggregate per ROM: how many distinct final screens the cores produced
+    int divergent = 0;
+    int failures = 0;
+    double cpuSeconds = 0;
+    for (size_t r = 0; r < roms.size(); ++r)
+    {
+        const Result *row = &results[r * cores.size()];
+        bool loaded = true;
+        int screens = 0;
+        double seconds = 0;
+        for (size_t c = 0; c < cores.size(); ++c)
+        {
+            loaded = loaded && row[c].loaded;
+            if (!row[c].copiesAgree)
+                ++screens; // Copies of one core disagreeing count as another screen
+            bool seen = false;
+            for (size_t p = 0; p < c; ++p)
+                seen = seen || row[p].screenHash == row[c].screenHash;
+            screens += seen ? 0 : 1;
+            seconds += row[c].seconds;
+        }
+        cpuSeconds += seconds;
+        failures += loaded ? 0 : 1;
+        divergent += (loaded && screens > 1) ? 1 : 0;
+
+        const char *status = !loaded ? "LOAD FAILED" : screens > 1 ? "MISMATCH" : "ok";
+        std::printf("%-11s %d screen(s) %8.2f M cycles/s  %s\n", status, screens,
+                    seconds > 0 ? static_cast<double>(frames) * ipf * instances * cores.size() / seconds / 1e6 : 0.0,
+                    roms[r].c_str());
+    }
+
+    double totalCycles = static_cast<double>(frames) * ipf * instances * results.size();
+    std::printf("\n%zu instances on %u threads in %.3f s: %.2f M cycles/s aggregate, %.2fx parallel speedup\n",
+                results.size() * instances, pool.size(), wall, wall > 0 ? totalCycles / wall / 1e6 : 0.0,
+                wall > 0 ? cpuSeconds / wall : 0.0);
+    for (size_t n = 0; n < nodeStats.size(); ++n)
+    {
+        const NodeStats &stats = nodeStats[n];
+        const double nodeSeconds = stats.micros.load() / 1e6;
+        const double nodeCycles = static_cast<double>(frames) * ipf * instances * stats.jobs.load();
+        std::printf("node %d: %u workers, %lld jobs, %.2f M cycles/s per worker, %zu MB of arena (%zu MB in huge pages)\n",
+                    numa::nodes()[n].id, stats.workers.load(), stats.jobs.load(),
+                    nodeSeconds > 0 ? nodeCycles / nodeSeconds / 1e6 : 0.0, stats.reserved.load() >> 20,
+                    stats.hugeReserved.load() >> 20);
+    }
+    std::printf("%d ROMs ended on different screens across cores, %d load failures\n", divergent, failures);
+
+    if (!metricsPath.empty())
+    {
+        std::string text;
+        writeMetric(text, "chip8_batch_jobs", "gauge", "ROM and core pairs run", static_cast<double>(results.size()));
+        writeMetric(text, "chip8_batch_instances", "gauge", "Machines run", static_cast<double>(results.size() * instances));
+        writeMetric(text, "chip8_batch_threads", "gauge", "Worker threads", pool.size());
+        writeMetric(text, "chip8_batch_wall_seconds", "gauge", "Wall time of the run", wall);
+        writeMetric(text, "chip8_batch_load_failures", "gauge", "ROMs that didn't load", failures);
+        writeMetric(text, "chip8_batch_divergent", "gauge", "ROMs whose cores ended on different screens", divergent);
+        size_t reserved = 0;
+        for (const NodeStats &stats : nodeStats)
+            reserved += stats.reserved.load();
+        writeMetric(text, "chip8_batch_arena_bytes", "gauge", "Arena memory the workers reserved", static_cast<double>(reserved));
+        metrics.write(text, "chip8_batch", false);
+        // Written whole and renamed over, so the collector never reads half
+        const std::string temporary = metricsPath + ".tmp";
+        std::ofstream(temporary, std::ios::binary) << text;
+        std::error_code ec;
+        fs::rename(temporary, metricsPath, ec);
+        if (ec)
+            std::fprintf(stderr, "chip8-batch: can't write %s\n", metricsPath.c_str());
+    }
+    return (failures || divergent) ? 1 : 0;
+}
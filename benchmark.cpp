@@ -0,0 +1,710 @@
+// Micro-benchmarks: nanoseconds per instruction for each opcode class on
+// every interpreter core, plus whole-ROM throughput on a fixed set of
+// titles from roms/. Results are written as JSON for regression tracking:
+// every trial's time, their median with a 95% confidence interval, and on
+// Linux the host instructions, branch misses and cache misses per
+// emulated instruction from perf_event. Against a stored baseline it
+// fails when a case got slower by more than a threshold and a rank test
+// says the slowdown isn't noise.
+//
+//   chip8-bench [options]
+//     --cores LIST   comma separated cores (default switch,table,predecoded,jit,
+//                    tiered)
+//     --min-time MS  minimum timed run per measurement (default 200)
+//     --repeat N     measurements per case (default 3, 11 with --compare)
+//     --roms DIR     folder holding the ROM set (default roms)
+//     --out FILE     write the JSON there instead of stdout
+//     --simd LEVEL   scalar | sse2 | avx2 | avx512 kernels instead of the
+//                    widest the CPU runs
+//     --compare FILE compare against a baseline JSON from an earlier run,
+//                    print a table and exit with status 2 on a regression;
+//                    the JSON is then only written with --out
+//     --threshold P  slowdown of the median that counts, in percent
+//                    (default 5)
+//     --alpha P      significance the rank test needs (default 0.01)
+//     --library FILE also run the ROM set on --cores of a chip8core library
+//                    loaded at run time (repeatable), reported as core
+//                    FILE:core, to compare builds without rebuilding this
+
+#include "chip8.h"
+#include "chip8_simd.h"
+#include "core_library.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct CoreConfig
+    {
+        const char *name;
+        Chip8::Core core;
+    };
+
+    const CoreConfig knownCores[] = {
+        {"switch", Chip8::Core::Switch},
+        {"table", Chip8::Core::Table},
+        {"predecoded", Chip8::Core::Predecoded},
+        {"jit", Chip8::Core::Jit},
+        {"tiered", Chip8::Core::Tiered},
+    };
+
+    // A loop of 64 instructions repeating the body pattern. The setup runs
+    // once, then the loop repeats through a jump, so 1 in 65 is a 1NNN.
+    struct OpcodeCase
+    {
+        const char *name;
+        std::vector<uint16_t> setup;
+        std::vector<uint16_t> body;
+    };
+
+    const uint16_t bodyStart = 0x220; // Leaves room for the setup
+    const int bodyLength = 64;
+
+    // I points at 0x400 in every case: a 15 row sprite, digits for FX33
+    // and registers for FX55/FX65, all away from the code
+    const std::vector<uint16_t> commonSetup = {0xA400, 0x6012, 0x6134, 0x6256, 0x6378};
+
+    const OpcodeCase opcodeCases[] = {
+        {"6XNN", {}, {0x6A42}},
+        {"7XNN", {}, {0x7A01}},
+        {"8XY4", {}, {0x8014}},
+        {"8XY6", {}, {0x8216}},
+        {"ANNN", {}, {0xA400}},
+        {"CXNN", {}, {0xC3FF}},
+        {"3XNN", {}, {0x3000}}, // Never equal, so never skips
+        {"FX1E", {0x6001}, {0xF01E}},
+        {"FX29", {}, {0xF129}},
+        {"00E0", {}, {0x00E0}},
+        {"DXY1", {}, {0xD011}},
+        {"DXY5", {}, {0xD015}},
+        {"DXY8", {}, {0xD018}},
+        {"DXYF", {}, {0xD01F}},
+        {"DXYF-wrap", {0x603C, 0x611C}, {0xD01F}}, // Clipped at the corner
+        {"FX33", {}, {0xF333}},
+        // FX55/FX65 move I on, so every other instruction puts it back
+        {"FX55+ANNN", {}, {0xFF55, 0xA400}},
+        {"FX65+ANNN", {}, {0xFF65, 0xA400}},
+    };
+
+    // Whole-ROM set, run with the database-style 10 instructions per frame
+    const char *romSet[] = {
+        "Brix [Andreas Gustafsson, 1990].ch8",
+        "Tetris [Fran Dachille, 1991].ch8",
+        "Space Invaders [David Winter].ch8",
+        "Pong [Paul Vervalin, 1990].ch8",
+        "Blinky [Hans Christian Egeberg, 1991].ch8",
+        "UFO [Lutz V, 1992].ch8",
+    };
+
+    struct Options
+    {
+        std::vector<CoreConfig> cores;
+        double minSeconds = 0.2;
+        int repeat = 0; // 0 until the options pick a default
+        std::string romDir = "roms";
+        const char *outPath = nullptr;
+        const char *comparePath = nullptr;
+        std::vector<std::string> libraries;
+        double threshold = 0.05;
+        double alpha = 0.01;
+    };
+
+    // Host events over all of a case's trials; valid only where the
+    // kernel lets this process count them
+    struct HostCounters
+    {
+        bool valid = false;
+        uint64_t instructions = 0;
+        uint64_t branchMisses = 0;
+        uint64_t cacheMisses = 0;
+    };
+
+    struct Timed
+    {
+        uint64_t instructions = 0; // Of the fastest trial
+        double seconds = 0;
+        std::vector<double> samples; // Nanoseconds per instruction, per trial
+        uint64_t totalInstructions = 0; // Over every trial, for the counters
+        HostCounters counters;
+    };
+
+    struct Result
+    {
+        std::string group; // "opcode" or "rom"
+        std::string name;
+        std::string core;
+        Timed timed;
+    };
+
+    // User-space hardware counters for this thread, one group read at once
+    class PerfCounters
+    {
+    public:
+        PerfCounters()
+        {
+#if defined(__linux__)
+            const uint64_t configs[eventCount] = {PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES};
+            for (int e = 0; e < eventCount; ++e)
+            {
+                perf_event_attr attr;
+                std::memset(&attr, 0, sizeof attr);
+                attr.size = sizeof attr;
+                attr.type = PERF_TYPE_HARDWARE;
+                attr.config = configs[e];
+                attr.disabled = e == 0;
+                attr.exclude_kernel = 1;
+                attr.exclude_hv = 1;
+                attr.read_format = PERF_FORMAT_GROUP;
+                fds[e] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, e == 0 ? -1 : fds[0], 0));
+                if (fds[e] < 0)
+                {
+                    closeAll();
+                    return;
+                }
+            }
+#endif
+        }
+        ~PerfCounters() { closeAll(); }
+        PerfCounters(const PerfCounters &) = delete;
+        PerfCounters &operator=(const PerfCounters &) = delete;
+
+        bool available() const { return fds[0] >= 0; }
+
+        void start()
+        {
+#if defined(__linux__)
+            if (available())
+            {
+                ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+#endif
+        }
+
+        // Adds what was counted since start()
+        void stop(HostCounters &into)
+        {
+#if defined(__linux__)
+            if (!available())
+                return;
+            ioctl(fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+            uint64_t values[1 + eventCount] = {};
+            if (read(fds[0], values, sizeof values) != static_cast<ssize_t>(sizeof values) || values[0] != eventCount)
+                return;
+            into.valid = true;
+            into.instructions += values[1];
+            into.branchMisses += values[2];
+            into.cacheMisses += values[3];
+#else
+            (void)into;
+#endif
+        }
+
+    private:
+        static constexpr int eventCount = 3;
+
+        void closeAll()
+        {
+            for (int &fd : fds)
+            {
+#if defined(__linux__)
+                if (fd >= 0)
+                    ::close(fd);
+#endif
+                fd = -1;
+            }
+        }
+
+        int fds[eventCount] = {-1, -1, -1};
+    };
+
+    PerfCounters &perfCounters()
+    {
+        static PerfCounters counters;
+        return counters;
+    }
+
+    double median(std::vector<double> values)
+    {
+        if (values.empty())
+            return 0;
+        std::sort(values.begin(), values.end());
+        const size_t n = values.size();
+        return n % 2 ? values[n / 2] : (values[n / 2 - 1] + values[n / 2]) / 2;
+    }
+
+    // Distribution-free interval for the median from order statistics:
+    // the widest ranks j whose binomial tail stays within 2.5% on each side.
+    // With fewer than 6 trials that can't reach 95%, and it is the range.
+    std::pair<double, double> medianInterval(std::vector<double> values)
+    {
+        if (values.empty())
+            return {0, 0};
+        std::sort(values.begin(), values.end());
+        const int n = static_cast<int>(values.size());
+        double tail = std::pow(0.5, n); // P(B <= k) for B ~ Binomial(n, 1/2)
+        double term = tail;
+        int j = 0;
+        for (int k = 0; k < n / 2; ++k)
+        {
+            if (tail > 0.025)
+                break;
+            j = k + 1;
+            term = term * (n - k) / (k + 1);
+            tail += term;
+        }
+        const int low = std::max(j - 1, 0);
+        return {values[low], values[n - 1 - low]};
+    }
+
+    // One-sided Mann-Whitney U: how likely samples at least this much
+    // slower than the baseline's would be if both came from one machine
+    // state. Normal approximation with a continuity and no tie correction,
+    // fine for the dozen trials a case gets.
+    double slowerPValue(const std::vector<double> &current, const std::vector<double> &baseline)
+    {
+        const double n1 = static_cast<double>(current.size());
+        const double n2 = static_cast<double>(baseline.size());
+        if (n1 == 0 || n2 == 0)
+            return 1;
+        double u = 0;
+        for (double a : current)
+        {
+            for (double b : baseline)
+                u += a > b ? 1 : a == b ? 0.5 : 0;
+        }
+        const double mean = n1 * n2 / 2;
+        const double sd = std::sqrt(n1 * n2 * (n1 + n2 + 1) / 12);
+        const double z = (u - mean - 0.5) / sd;
+        return 0.5 * std::erfc(z / std::sqrt(2.0));
+    }
+
+    void usage()
+    {
+        std::fprintf(stderr, "usage: chip8-bench [--cores LIST] [--min-time MS] [--repeat N] [--roms DIR] [--out FILE] [--simd LEVEL]\n"
+                             "                  [--compare FILE] [--threshold PERCENT] [--alpha P] [--library FILE]...\n");
+    }
+
+    bool parseCores(const std::string &list, std::vector<CoreConfig> &cores)
+    {
+        std::stringstream ss(list);
+        std::string name;
+        while (std::getline(ss, name, ','))
+        {
+            auto it = std::find_if(std::begin(knownCores), std::end(knownCores), [&](const CoreConfig &config)
+                                   { return name == config.name; });
+            if (it == std::end(knownCores))
+                return false;
+            cores.push_back(*it);
+        }
+        return !cores.empty();
+    }
+
+    std::vector<uint8_t> buildRom(const OpcodeCase &test)
+    {
+        std::vector<uint8_t> rom(bodyStart - 0x200 + (bodyLength + 1) * 2, 0);
+        auto put = [&](uint16_t addr, uint16_t opcode)
+        {
+            rom[addr - 0x200] = static_cast<uint8_t>(opcode >> 8);
+            rom[addr - 0x200 + 1] = static_cast<uint8_t>(opcode & 0xFF);
+        };
+
+        std::vector<uint16_t> setup = commonSetup;
+        setup.insert(setup.end(), test.setup.begin(), test.setup.end());
+        setup.push_back(static_cast<uint16_t>(0x1000 | bodyStart));
+        for (size_t i = 0; i < setup.size(); ++i)
+            put(static_cast<uint16_t>(0x200 + i * 2), setup[i]);
+
+        for (int i = 0; i < bodyLength; ++i)
+            put(static_cast<uint16_t>(bodyStart + i * 2), test.body[i % test.body.size()]);
+        put(static_cast<uint16_t>(bodyStart + bodyLength * 2), static_cast<uint16_t>(0x1000 | bodyStart));
+        return rom;
+    }
+
+    // Runs slices until minSeconds have passed, repeat times; keeps every
+    // trial and the fastest, with the host counters over all of them
+    template <typename Step>
+    Timed measure(const Options &opt, int slice, Step &&step)
+    {
+        Timed best;
+        PerfCounters &counters = perfCounters();
+        for (int r = 0; r < opt.repeat; ++r)
+        {
+            uint64_t executed = 0;
+            double seconds = 0;
+            counters.start();
+            Clock::time_point start = Clock::now();
+            do
+            {
+                step(slice);
+                executed += slice;
+                seconds = std::chrono::duration<double>(Clock::now() - start).count();
+            } while (seconds < opt.minSeconds);
+            counters.stop(best.counters);
+
+            best.samples.push_back(seconds * 1e9 / executed);
+            best.totalInstructions += executed;
+            if (best.instructions == 0 || seconds / executed < best.seconds / best.instructions)
+            {
+                best.instructions = executed;
+                best.seconds = seconds;
+            }
+        }
+        return best;
+    }
+
+    void benchOpcodes(const Options &opt, std::vector<Result> &results)
+    {
+        for (const CoreConfig &config : opt.cores)
+        {
+            for (const OpcodeCase &test : opcodeCases)
+            {
+                std::vector<uint8_t> rom = buildRom(test);
+                std::unique_ptr<Chip8> chip8 = std::make_unique<Chip8>(config.core);
+                chip8->loadROM(rom.data(), rom.size());
+                chip8->seedRandom(1);
+                chip8->emulateCycles(32); // Setup, and warms the caches and the JIT
+
+                Timed timed = measure(opt, 65 * 64, [&](int count)
+                                      { chip8->emulateCycles(count); });
+                results.push_back({"opcode", test.name, config.name, std::move(timed)});
+            }
+        }
+    }
+
+    void benchRoms(const Options &opt, std::vector<Result> &results)
+    {
+        const int ipf = 10;
+        for (const CoreConfig &config : opt.cores)
+        {
+            for (const char *name : romSet)
+            {
+                std::unique_ptr<Chip8> chip8 = std::make_unique<Chip8>(config.core);
+                if (!chip8->loadROM(opt.romDir + "/" + name))
+                {
+                    std::fprintf(stderr, "Skipping missing ROM: %s\n", name);
+                    continue;
+                }
+                chip8->seedRandom(1);
+
+                // Frames with timer ticks, so waits end as they would in the GUI
+                Timed timed = measure(opt, ipf * 60, [&](int count)
+                                      {
+                                          for (int done = 0; done < count; done += ipf)
+                                          {
+                                              chip8->emulateCycles(ipf);
+                                              chip8->decrementTimers();
+                                          } });
+                results.push_back({"rom", name, config.name, std::move(timed)});
+            }
+        }
+    }
+
+    // The ROM set again through chip8core libraries, a frame per call as
+    // their interface runs. Each library's cores are separate results, so
+    // two builds compare like two cores.
+    bool benchLibraries(const Options &opt, std::vector<Result> &results)
+    {
+        const int ipf = 10;
+        for (const std::string &path : opt.libraries)
+        {
+            CoreLibrary library;
+            std::string error;
+            if (!library.open(path, error))
+            {
+                std::fprintf(stderr, "Cannot load %s: %s\n", path.c_str(), error.c_str());
+                return false;
+            }
+            const CoreLibrary::Api &api = library.api();
+            for (const CoreConfig &config : opt.cores)
+            {
+                for (const char *name : romSet)
+                {
+                    std::ifstream file(opt.romDir + "/" + name, std::ios::binary);
+                    const std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+                    if (rom.empty())
+                    {
+                        std::fprintf(stderr, "Skipping missing ROM: %s\n", name);
+                        continue;
+                    }
+                    chip8core *core = library.create(CHIP8CORE_CHIP8, ipf, static_cast<int>(config.core));
+                    if (!core)
+                    {
+                        std::fprintf(stderr, "%s has no %s core\n", path.c_str(), config.name);
+                        break;
+                    }
+                    api.chip8core_load_rom(core, rom.data(), rom.size());
+                    api.chip8core_seed_random(core, 1);
+                    Timed timed = measure(opt, ipf * 60, [&](int count)
+                                          { api.chip8core_run_frames(core, count / ipf); });
+                    api.chip8core_destroy(core);
+                    results.push_back({"rom", name, path + ":" + config.name, std::move(timed)});
+                }
+            }
+        }
+        return true;
+    }
+
+    std::string jsonString(const std::string &text)
+    {
+        std::string out = "\"";
+        for (char c : text)
+        {
+            if (c == '"' || c == '\\')
+                out += '\\';
+            out += c;
+        }
+        return out + "\"";
+    }
+
+    // One benchmark per line; the baseline reader below relies on it
+    void writeJson(FILE *out, const std::vector<Result> &results)
+    {
+        std::fprintf(out, "{\n  \"simd\": \"%s\",\n  \"benchmarks\": [\n", simd::levelName(simd::activeLevel()));
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const Result &r = results[i];
+            const Timed &t = r.timed;
+            double ns = t.seconds * 1e9 / t.instructions;
+            std::pair<double, double> interval = medianInterval(t.samples);
+            std::fprintf(out, "    {\"group\": %s, \"name\": %s, \"core\": %s, \"instructions\": %llu, "
+                              "\"seconds\": %.6f, \"ns_per_instruction\": %.3f, \"mips\": %.2f, "
+                              "\"median_ns\": %.3f, \"ci_low_ns\": %.3f, \"ci_high_ns\": %.3f, \"samples\": [",
+                         jsonString(r.group).c_str(), jsonString(r.name).c_str(), jsonString(r.core).c_str(),
+                         static_cast<unsigned long long>(t.instructions), t.seconds, ns, 1e3 / ns,
+                         median(t.samples), interval.first, interval.second);
+            for (size_t s = 0; s < t.samples.size(); ++s)
+                std::fprintf(out, "%s%.3f", s ? ", " : "", t.samples[s]);
+            std::fprintf(out, "]");
+            if (t.counters.valid)
+            {
+                const double per = static_cast<double>(t.totalInstructions);
+                std::fprintf(out, ", \"host_instructions\": %.3f, \"branch_misses\": %.5f, \"cache_misses\": %.5f",
+                             t.counters.instructions / per, t.counters.branchMisses / per, t.counters.cacheMisses / per);
+            }
+            std::fprintf(out, "}%s\n", i + 1 < results.size() ? "," : "");
+        }
+        std::fprintf(out, "  ]\n}\n");
+    }
+
+    // A result from a baseline file
+    struct Baseline
+    {
+        double median = 0;
+        double ciHigh = 0;
+        double hostInstructions = -1;
+        std::vector<double> samples;
+    };
+
+    // The value after "key": on a line, or an empty string
+    std::string field(const std::string &line, const char *key)
+    {
+        const std::string quoted = std::string("\"") + key + "\": ";
+        size_t at = line.find(quoted);
+        if (at == std::string::npos)
+            return "";
+        at += quoted.size();
+        if (line[at] == '"')
+        {
+            size_t end = line.find('"', at + 1);
+            return end == std::string::npos ? "" : line.substr(at + 1, end - at - 1);
+        }
+        if (line[at] == '[')
+        {
+            size_t end = line.find(']', at);
+            return end == std::string::npos ? "" : line.substr(at + 1, end - at - 1);
+        }
+        size_t end = line.find_first_of(",}", at);
+        return line.substr(at, end == std::string::npos ? std::string::npos : end - at);
+    }
+
+    // Reads what writeJson wrote, keyed by group/name/core. Files from
+    // before medians were recorded compare their fastest trial instead.
+    bool readBaseline(const char *path, std::map<std::string, Baseline> &out, std::string &simdLevel)
+    {
+        std::ifstream in(path);
+        if (!in)
+            return false;
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (simdLevel.empty() && line.find("\"simd\"") != std::string::npos)
+                simdLevel = field(line, "simd");
+            const std::string group = field(line, "group");
+            if (group.empty())
+                continue;
+            Baseline b;
+            const std::string medianText = field(line, "median_ns");
+            b.median = std::atof((medianText.empty() ? field(line, "ns_per_instruction") : medianText).c_str());
+            const std::string high = field(line, "ci_high_ns");
+            b.ciHigh = high.empty() ? b.median : std::atof(high.c_str());
+            const std::string host = field(line, "host_instructions");
+            if (!host.empty())
+                b.hostInstructions = std::atof(host.c_str());
+            std::stringstream samples(field(line, "samples"));
+            std::string sample;
+            while (std::getline(samples, sample, ','))
+                b.samples.push_back(std::atof(sample.c_str()));
+            out[group + "/" + field(line, "name") + "/" + field(line, "core")] = b;
+        }
+        return !out.empty();
+    }
+
+    // Prints a line per case and returns how many regressed. A case
+    // regresses when its median is more than the threshold slower and the
+    // rank test (or, for a baseline without trials, the confidence
+    // intervals no longer overlapping) says it isn't noise.
+    int compare(const Options &opt, const std::vector<Result> &results, const std::map<std::string, Baseline> &baseline)
+    {
+        int regressions = 0;
+        std::printf("%-6s %-24s %-10s %10s %10s %8s %8s %9s\n", "group", "name", "core", "base ns", "now ns", "change", "p", "host ins");
+        for (const Result &r : results)
+        {
+            auto found = baseline.find(r.group + "/" + r.name + "/" + r.core);
+            if (found == baseline.end())
+            {
+                std::printf("%-6s %-24.24s %-10s %10s %10.3f %8s %8s %9s  new\n", r.group.c_str(), r.name.c_str(), r.core.c_str(), "-",
+                            median(r.timed.samples), "", "", "");
+                continue;
+            }
+            const Baseline &b = found->second;
+            const double now = median(r.timed.samples);
+            const double change = b.median > 0 ? now / b.median - 1 : 0;
+            bool significant;
+            double p = -1;
+            if (b.samples.size() >= 2)
+            {
+                p = slowerPValue(r.timed.samples, b.samples);
+                significant = p < opt.alpha;
+            }
+            else
+                significant = medianInterval(r.timed.samples).first > b.ciHigh;
+            const bool regressed = change > opt.threshold && significant;
+            regressions += regressed;
+
+            char pText[16] = "-", hostText[16] = "-";
+            if (p >= 0)
+                std::snprintf(pText, sizeof pText, "%.4f", p);
+            if (r.timed.counters.valid && b.hostInstructions > 0)
+                std::snprintf(hostText, sizeof hostText, "%+.1f%%",
+                              100.0 * (r.timed.counters.instructions / static_cast<double>(r.timed.totalInstructions) / b.hostInstructions - 1));
+            std::printf("%-6s %-24.24s %-10s %10.3f %10.3f %+7.1f%% %8s %9s%s\n", r.group.c_str(), r.name.c_str(), r.core.c_str(),
+                        b.median, now, 100 * change, pText, hostText, regressed ? "  REGRESSED" : "");
+        }
+        return regressions;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--cores" && hasValue)
+        {
+            if (!parseCores(argv[++i], opt.cores))
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if (arg == "--min-time" && hasValue)
+            opt.minSeconds = std::atof(argv[++i]) / 1000;
+        else if (arg == "--repeat" && hasValue)
+            opt.repeat = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--roms" && hasValue)
+            opt.romDir = argv[++i];
+        else if (arg == "--out" && hasValue)
+            opt.outPath = argv[++i];
+        else if (arg == "--compare" && hasValue)
+            opt.comparePath = argv[++i];
+        else if (arg == "--threshold" && hasValue)
+            opt.threshold = std::atof(argv[++i]) / 100;
+        else if (arg == "--alpha" && hasValue)
+            opt.alpha = std::atof(argv[++i]);
+        else if (arg == "--library" && hasValue)
+            opt.libraries.push_back(argv[++i]);
+        else if (arg == "--simd" && hasValue)
+        {
+            simd::Level level;
+            if (!simd::parseLevel(argv[++i], level))
+            {
+                usage();
+                return 1;
+            }
+            if (simd::setLevel(level) != level)
+                std::fprintf(stderr, "This CPU runs %s kernels at most\n", simd::levelName(simd::supportedLevel()));
+        }
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (opt.cores.empty())
+        opt.cores.assign(std::begin(knownCores), std::end(knownCores));
+    if (opt.repeat == 0)
+        opt.repeat = opt.comparePath ? 11 : 3;
+
+    std::map<std::string, Baseline> baseline;
+    std::string baselineSimd;
+    if (opt.comparePath && !readBaseline(opt.comparePath, baseline, baselineSimd))
+    {
+        std::fprintf(stderr, "Cannot read a baseline from %s\n", opt.comparePath);
+        return 1;
+    }
+    if (!perfCounters().available())
+        std::fprintf(stderr, "Hardware counters unavailable, timing only\n");
+
+    std::vector<Result> results;
+    benchOpcodes(opt, results);
+    benchRoms(opt, results);
+    if (!benchLibraries(opt, results))
+        return 1;
+
+    if (opt.outPath || !opt.comparePath)
+    {
+        FILE *out = opt.outPath ? std::fopen(opt.outPath, "w") : stdout;
+        if (!out)
+        {
+            std::fprintf(stderr, "Cannot write %s\n", opt.outPath);
+            return 1;
+        }
+        writeJson(out, results);
+        if (out != stdout)
+            std::fclose(out);
+    }
+    if (!opt.comparePath)
+        return 0;
+
+    if (!baselineSimd.empty() && baselineSimd != simd::levelName(simd::activeLevel()))
+        std::fprintf(stderr, "The baseline ran %s kernels, this run %s\n", baselineSimd.c_str(), simd::levelName(simd::activeLevel()));
+    int regressions = compare(opt, results, baseline);
+    if (regressions)
+    {
+        std::printf("%d regression%s over %.1f%%\n", regressions, regressions == 1 ? "" : "s", 100 * opt.threshold);
+        return 2;
+    }
+    std::printf("No regressions over %.1f%%\n", 100 * opt.threshold);
+    return 0;
+}
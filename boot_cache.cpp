@@ -0,0 +1,157 @@
+#include "boot_cache.h"
+#include "chip8.h"
+#include "rom_database.h"
+#include <cstring>    // For std::memcmp
+#include <filesystem> // For creating the directory and renaming
+#include <fstream>
+#include <iterator> // For std::istreambuf_iterator
+#include <memory>   // For the boot machines
+#include <utility>  // For std::move
+#include <vector>
+
+namespace
+{
+    const uint8_t bootMagic[4] = {'C', '8', 'B', 'T'};
+    constexpr uint16_t bootVersion = 1;
+    constexpr size_t headerSize = sizeof bootMagic + 2 + 8 + 4 + 4;
+
+    // Part of the file name, so each profile boots and caches separately
+    template <typename Machine>
+    const char *profileName();
+    template <>
+    const char *profileName<Chip8>() { return "legacy"; }
+    template <>
+    const char *profileName<VipChip8>() { return "vip"; }
+    template <>
+    const char *profileName<Chip48>() { return "chip48"; }
+    template <>
+    const char *profileName<SuperChip8>() { return "schip"; }
+    template <>
+    const char *profileName<XoChip8>() { return "xochip"; }
+
+    uint64_t getU64(const uint8_t *p)
+    {
+        uint64_t value = 0;
+        for (int i = 7; i >= 0; --i)
+            value = (value << 8) | p[i];
+        return value;
+    }
+
+    uint32_t getU32(const uint8_t *p)
+    {
+        return static_cast<uint32_t>(p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24));
+    }
+
+    void putLE(std::vector<uint8_t> &out, uint64_t value, int bytes)
+    {
+        for (int i = 0; i < bytes; ++i)
+            out.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+BootCache::BootCache(std::string directoryPath) : directory(std::move(directoryPath)) {}
+
+std::string BootCache::pathFor(const uint8_t *rom, size_t size, const char *profile, int ipf) const
+{
+    std::filesystem::path path(directory);
+    path /= RomDatabase::sha1(rom, size) + "-" + profile + "-" + std::to_string(ipf) + ".c8boot";
+    return path.string();
+}
+
+template <typename Machine>
+bool BootCache::restore(Machine &machine, const uint8_t *rom, size_t size, int ipf, uint64_t seed, Seed policy) const
+{
+    std::ifstream file(pathFor(rom, size, profileName<Machine>(), ipf), std::ios::binary);
+    if (!file)
+        return false;
+    std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    if (bytes.size() < headerSize || std::memcmp(bytes.data(), bootMagic, sizeof bootMagic) != 0 ||
+        (bytes[4] | (bytes[5] << 8)) != bootVersion)
+        return false;
+    const uint8_t *header = bytes.data() + sizeof bootMagic + 2;
+    if (getU32(header + 8) != static_cast<uint32_t>(ipf))
+        return false;
+    if (policy == Seed::MustMatch && getU64(header) != seed)
+        return false;
+
+    // Check the blob on a scratch machine first, a stale or damaged file
+    // must not leave the real one half loaded
+    std::unique_ptr<Machine> scratch = std::make_unique<Machine>();
+    if (!scratch->loadState(bytes.data() + headerSize, bytes.size() - headerSize))
+        return false;
+
+    // The ROM goes in first, so reset() afterwards restarts it as usual
+    if (!machine.loadROM(rom, size) || !machine.loadState(bytes.data() + headerSize, bytes.size() - headerSize))
+        return false;
+    if (policy == Seed::Reseed)
+        machine.seedRandom(seed);
+    return true;
+}
+
+template <typename Machine>
+bool BootCache::has(const uint8_t *rom, size_t size, int ipf, uint64_t seed, Seed policy) const
+{
+    std::ifstream file(pathFor(rom, size, profileName<Machine>(), ipf), std::ios::binary);
+    uint8_t bytes[headerSize];
+    if (!file.read(reinterpret_cast<char *>(bytes), sizeof bytes) || std::memcmp(bytes, bootMagic, sizeof bootMagic) != 0 ||
+        (bytes[4] | (bytes[5] << 8)) != bootVersion)
+        return false;
+    const uint8_t *header = bytes + sizeof bootMagic + 2;
+    return getU32(header + 8) == static_cast<uint32_t>(ipf) && (policy != Seed::MustMatch || getU64(header) == seed);
+}
+
+template <typename Machine>
+bool BootCache::build(const uint8_t *rom, size_t size, int ipf, uint64_t seed) const
+{
+    std::unique_ptr<Machine> machine = std::make_unique<Machine>();
+    if (!machine->loadROM(rom, size))
+        return false;
+    machine->seedRandom(seed);
+
+    int frames = 0;
+    while (!machine->isWaitingForKey())
+    {
+        if (frames == maxFrames)
+            return false;
+        machine->runFrame(ipf);
+        ++frames;
+    }
+
+    std::vector<uint8_t> out(bootMagic, bootMagic + sizeof bootMagic);
+    putLE(out, bootVersion, 2);
+    putLE(out, seed, 8);
+    putLE(out, static_cast<uint32_t>(ipf), 4);
+    putLE(out, static_cast<uint32_t>(frames), 4);
+    std::vector<uint8_t> state = machine->saveState();
+    out.insert(out.end(), state.begin(), state.end());
+
+    // Written aside and renamed, so a reader never sees half a file
+    std::error_code ec;
+    std::filesystem::create_directories(directory, ec);
+    const std::string path = pathFor(rom, size, profileName<Machine>(), ipf);
+    const std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char *>(out.data()), out.size());
+        if (!file)
+            return false;
+    }
+    std::filesystem::rename(temporary, path, ec);
+    return !ec;
+}
+
+template bool BootCache::restore(Chip8 &, const uint8_t *, size_t, int, uint64_t, Seed) const;
+template bool BootCache::restore(VipChip8 &, const uint8_t *, size_t, int, uint64_t, Seed) const;
+template bool BootCache::restore(Chip48 &, const uint8_t *, size_t, int, uint64_t, Seed) const;
+template bool BootCache::restore(SuperChip8 &, const uint8_t *, size_t, int, uint64_t, Seed) const;
+template bool BootCache::restore(XoChip8 &, const uint8_t *, size_t, int, uint64_t, Seed) const;
+template bool BootCache::has<Chip8>(const uint8_t *, size_t, int, uint64_t, Seed) const;
+template bool BootCache::has<VipChip8>(const uint8_t *, size_t, int, uint64_t, Seed) const;
+template bool BootCache::has<Chip48>(const uint8_t *, size_t, int, uint64_t, Seed) const;
+template bool BootCache::has<SuperChip8>(const uint8_t *, size_t, int, uint64_t, Seed) const;
+template bool BootCache::has<XoChip8>(const uint8_t *, size_t, int, uint64_t, Seed) const;
+template bool BootCache::build<Chip8>(const uint8_t *, size_t, int, uint64_t) const;
+template bool BootCache::build<VipChip8>(const uint8_t *, size_t, int, uint64_t) const;
+template bool BootCache::build<Chip48>(const uint8_t *, size_t, int, uint64_t) const;
+template bool BootCache::build<SuperChip8>(const uint8_t *, size_t, int, uint64_t) const;
+template bool BootCache::build<XoChip8>(const uint8_t *, size_t, int, uint64_t) const;
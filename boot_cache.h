@@ -0,0 +1,48 @@
+#ifndef BOOT_CACHE_H
+#define BOOT_CACHE_H
+
+#include <cstddef> // For size_t
+#include <cstdint> // For uint8_t, uint64_t
+#include <string>  // For paths
+
+// On-disk cache of post-boot states, one per ROM, quirk profile and speed.
+// Booting runs the ROM until it first waits for a key (its title screen or
+// menu) and saves the machine there, so playing it again starts at that
+// point at once instead of sitting through the intro.
+class BootCache
+{
+public:
+    // What to do with the random generator of a cached state
+    enum class Seed
+    {
+        Reseed,   // Use any cached state, then seed the generator anew
+        MustMatch // Use only a state booted with this seed, keep its generator
+    };
+
+    static constexpr int maxFrames = 3600; // A minute of boot before giving up
+
+    explicit BootCache(std::string directoryPath);
+
+    // Load the ROM into machine and restore its cached boot state. False,
+    // with the machine untouched, when there is none to use.
+    template <typename Machine>
+    bool restore(Machine &machine, const uint8_t *rom, size_t size, int ipf, uint64_t seed, Seed policy) const;
+
+    // Whether restore() with these would find a state, reading only the
+    // file's header
+    template <typename Machine>
+    bool has(const uint8_t *rom, size_t size, int ipf, uint64_t seed, Seed policy) const;
+
+    // Boot the ROM on a machine of its own at ipf instructions per frame and
+    // cache the state. False if it never waits for a key within maxFrames.
+    template <typename Machine>
+    bool build(const uint8_t *rom, size_t size, int ipf, uint64_t seed) const;
+
+    // Cache file of this ROM, profile and speed
+    std::string pathFor(const uint8_t *rom, size_t size, const char *profile, int ipf) const;
+
+private:
+    std::string directory;
+};
+
+#endif
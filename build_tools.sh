@@ -0,0 +1,165 @@
+#!/usr/bin/env bash
+# Builds the core and every program that doesn't need a window: the
+# headless runner, the batch, regression, replay, cluster and state tools,
+# the differential, conformance and sandbox testers, the benchmark, the
+# session server, the ROM disassembler, statistics and AOT compiler, and
+# the libchip8env and libchip8core libraries. Nothing here uses wxWidgets,
+# OpenGL or SDL, only a C++17 compiler, zlib and threads, so it runs on a
+# Linux build host or server as is (and under MSYS2, where the programs get
+# .exe and the libraries .dll). The core is compiled once and linked into
+# all of them; the libraries get a position-independent copy of it.
+#
+#   ./build_tools.sh [options]
+#     --out DIR      where the binaries and the objects go (default build)
+#     --no-libs      skip libchip8env and libchip8core
+#     --check        then play roms/ on every core against the golden hashes
+#                    in roms/golden_hashes.txt, failing on any difference
+#
+# CXX and CXXFLAGS are honoured. For the profile-guided headless runner and
+# server, use pgo_build.sh instead.
+
+set -euo pipefail
+
+out=build
+libs=yes
+check=no
+while [ $# -gt 0 ]; do
+    case "$1" in
+    --out) out="$2"; shift 2 ;;
+    --no-libs) libs=no; shift ;;
+    --check) check=yes; shift ;;
+    *)
+        echo "usage: ./build_tools.sh [--out DIR] [--no-libs] [--check]" >&2
+        exit 1
+        ;;
+    esac
+done
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-std=c++17 -O2"}
+exe=
+so=.so
+socket_libs=
+case "$(uname -s)" in
+MINGW* | MSYS*)
+    exe=.exe
+    so=.dll
+    socket_libs=-lws2_32
+    ;;
+esac
+
+core="chip8.cpp chip8_jit.cpp chip8_aot.cpp chip8_simd.cpp chip8_batch.cpp rom_cache.cpp rom_archive.cpp"
+# Program name, then its sources besides the core
+programs=(
+    "chip8-headless headless.cpp megachip.cpp movie.cpp rom_database.cpp video_recorder.cpp trace_log.cpp chip8_coverage.cpp pc_sampler.cpp chip8_disasm.cpp"
+    "chip8-batch batch_runner.cpp metrics.cpp thread_pool.cpp numa_arena.cpp"
+    "chip8-explore state_explorer.cpp snapshot_store.cpp thread_pool.cpp"
+    "chip8-diff core_diff.cpp thread_pool.cpp chip8_disasm.cpp"
+    "chip8-regress rom_regress.cpp thread_pool.cpp"
+    "chip8-replay-check replay_check.cpp movie.cpp thread_pool.cpp"
+    "chip8-cluster cluster_runner.cpp thread_pool.cpp"
+    "chip8-conformance conformance.cpp"
+    "chip8-sandbox-check sandbox_check.cpp sandbox_pool.cpp"
+    "chip8-bench benchmark.cpp core_library.cpp"
+    "chip8-rom-stats rom_stats.cpp chip8_cfg.cpp chip8_profile.cpp chip8_disasm.cpp"
+    "chip8-server chip8_server.cpp stream_server.cpp sandbox_pool.cpp metrics.cpp session_store.cpp state_codec.cpp timer_wheel.cpp thread_pool.cpp rom_database.cpp"
+)
+# These don't run the machine; the disassembler and the AOT compiler take
+# only its ROM loading
+loaders=(
+    "chip8-trace-dump trace_dump.cpp trace_log.cpp chip8_disasm.cpp"
+    "chip8-disasm rom_disasm.cpp chip8_cfg.cpp chip8_coverage.cpp chip8_disasm.cpp"
+    "chip8-aot rom_aot.cpp chip8_cfg.cpp chip8_disasm.cpp"
+)
+
+objects() # dir sources...
+{
+    local dir=$1
+    shift
+    for source in "$@"; do
+        printf '%s/%s.o ' "$dir" "${source%.cpp}"
+    done
+}
+
+compile() # dir flags sources...
+{
+    local dir=$1 flags=$2
+    shift 2
+    local pids=() pid
+    mkdir -p "$dir"
+    for source in "$@"; do
+        # shellcheck disable=SC2086
+        $CXX $CXXFLAGS $flags -c "$source" -o "$dir/${source%.cpp}.o" &
+        pids+=($!)
+    done
+    for pid in "${pids[@]}"; do
+        wait "$pid"
+    done
+}
+
+# Each source once, however many programs share it
+unique() # sources...
+{
+    printf '%s\n' "$@" | sort -u | tr '\n' ' '
+}
+
+echo "build: core"
+# shellcheck disable=SC2086
+compile "$out/core" "" $core
+
+echo "build: tools"
+all=()
+for entry in "${programs[@]}" "${loaders[@]}"; do
+    read -r -a words <<<"$entry"
+    all+=("${words[@]:1}")
+done
+# shellcheck disable=SC2046
+compile "$out/tools" "" $(unique "${all[@]}")
+
+link() # name libs core-sources sources...
+{
+    local name=$1 extra=$2 linked=$3
+    shift 3
+    # shellcheck disable=SC2046,SC2086
+    $CXX $CXXFLAGS $(objects "$out/tools" "$@") $(objects "$out/core" $linked) -o "$out/$name$exe" $extra
+}
+
+for entry in "${programs[@]}"; do
+    read -r -a words <<<"$entry"
+    extra="-lpthread -lz"
+    case "${words[0]}" in
+    chip8-bench) [ -z "$exe" ] && extra="$extra -ldl" ;;
+    chip8-server) extra="$extra $socket_libs" ;;
+    esac
+    link "${words[0]}" "$extra" "$core" "${words[@]:1}"
+done
+for entry in "${loaders[@]}"; do
+    read -r -a words <<<"$entry"
+    linked=
+    [ "${words[0]}" != chip8-trace-dump ] && linked="rom_cache.cpp rom_archive.cpp"
+    link "${words[0]}" "-lz" "$linked" "${words[@]:1}"
+done
+
+if [ "$libs" = yes ]; then
+    echo "build: libraries"
+    # shellcheck disable=SC2086
+    compile "$out/pic" "-fPIC" $core
+    # shellcheck disable=SC2086
+    compile "$out/pic" "-fPIC -DCHIP8_ENV_BUILD" chip8_env.cpp
+    # shellcheck disable=SC2086
+    compile "$out/pic" "-fPIC -DCHIP8CORE_BUILD" chip8core.cpp
+    # shellcheck disable=SC2046,SC2086
+    $CXX $CXXFLAGS -shared $(objects "$out/pic" chip8_env.cpp $core) -o "$out/libchip8env$so" -lz
+    # shellcheck disable=SC2046,SC2086
+    $CXX $CXXFLAGS -shared $(objects "$out/pic" chip8core.cpp $core) -o "$out/libchip8core$so" -lz
+fi
+echo "build: done, binaries in $out/"
+
+if [ "$check" = yes ]; then
+    # set -e stops at the first core whose screens differ
+    for core_name in switch table predecoded jit aot tiered; do
+        echo "check: $core_name"
+        "$out/chip8-regress$exe" --core "$core_name" roms
+    done
+    echo "check: every core matches the golden hashes"
+fi
@@ -0,0 +1,290 @@
+#include "cheat_engine.h"
+#include "chip8_simd.h"
+#include <cctype>  // For std::isspace, std::isxdigit
+#include <cstdlib> // For std::strtoul
+
+void MemorySearch::start(const uint8_t *memory, size_t size)
+{
+    snapshot.assign(memory, memory + size);
+    keep.assign(size, 0xFF);
+    left = size;
+}
+
+size_t MemorySearch::filter(const uint8_t *memory, Filter test, uint8_t value)
+{
+    if (!isStarted())
+        return 0;
+    const size_t size = snapshot.size();
+
+    // Increased and Decreased are Greater and Less than the snapshot, the
+    // value tests compare with a splat of the value
+    const uint8_t *against = snapshot.data();
+    if (test == Filter::Equal || test == Filter::NotEqual)
+    {
+        operand.assign(size, value);
+        against = operand.data();
+    }
+    simd::ByteTest byteTest = simd::ByteTest::Equal;
+    switch (test)
+    {
+    case Filter::Changed:
+    case Filter::NotEqual:
+        byteTest = simd::ByteTest::NotEqual;
+        break;
+    case Filter::Increased:
+        byteTest = simd::ByteTest::Greater;
+        break;
+    case Filter::Decreased:
+        byteTest = simd::ByteTest::Less;
+        break;
+    default:
+        break;
+    }
+    left = simd::filterBytes(keep.data(), memory, against, size, byteTest);
+    snapshot.assign(memory, memory + size);
+    return left;
+}
+
+std::vector<uint16_t> MemorySearch::candidates(size_t limit) const
+{
+    std::vector<uint16_t> found;
+    for (size_t addr = 0; addr < keep.size() && found.size() < limit; ++addr)
+    {
+        if (keep[addr])
+            found.push_back(static_cast<uint16_t>(addr));
+    }
+    return found;
+}
+
+namespace
+{
+    enum Test : uint8_t
+    {
+        Eq,
+        Ne,
+        Lt,
+        Gt,
+        Le,
+        Ge
+    };
+
+    // Reads one line's tokens; every method is false on anything unexpected
+    struct LineParser
+    {
+        const std::string &line;
+        size_t at = 0;
+
+        void skipSpace()
+        {
+            while (at < line.size() && std::isspace(static_cast<unsigned char>(line[at])))
+                ++at;
+        }
+
+        bool atEnd()
+        {
+            skipSpace();
+            return at == line.size();
+        }
+
+        bool hex(unsigned long limit, unsigned long &out)
+        {
+            skipSpace();
+            size_t end = at;
+            while (end < line.size() && std::isxdigit(static_cast<unsigned char>(line[end])))
+                ++end;
+            if (end == at || end - at > 4)
+                return false;
+            out = std::strtoul(line.substr(at, end - at).c_str(), nullptr, 16);
+            at = end;
+            return out <= limit;
+        }
+
+        bool literal(const char *text)
+        {
+            skipSpace();
+            const size_t n = std::char_traits<char>::length(text);
+            if (line.compare(at, n, text) != 0)
+                return false;
+            at += n;
+            return true;
+        }
+
+        bool test(uint8_t &out)
+        {
+            // Two-character operators first, so "<=" isn't read as "<"
+            static const struct
+            {
+                const char *text;
+                Test test;
+            } tests[] = {{"==", Eq}, {"!=", Ne}, {"<=", Le}, {">=", Ge}, {"<", Lt}, {">", Gt}};
+            for (const auto &t : tests)
+            {
+                if (literal(t.text))
+                {
+                    out = t.test;
+                    return true;
+                }
+            }
+            return false;
+        }
+    };
+
+    void emitAddress(std::vector<uint8_t> &code, unsigned long addr)
+    {
+        code.push_back(static_cast<uint8_t>(addr >> 8));
+        code.push_back(static_cast<uint8_t>(addr));
+    }
+}
+
+bool CheatList::compile(const std::string &source, std::string &error)
+{
+    const unsigned long lastAddress = Chip8::memorySize - 1;
+    std::vector<uint8_t> compiled;
+    size_t count = 0;
+    size_t lineStart = 0;
+    for (int number = 1; lineStart <= source.size(); ++number)
+    {
+        size_t lineEnd = source.find('\n', lineStart);
+        if (lineEnd == std::string::npos)
+            lineEnd = source.size();
+        std::string line = source.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        LineParser parser{line};
+        if (parser.atEnd())
+            continue;
+        auto fail = [&](const char *reason)
+        {
+            error = "Line " + std::to_string(number) + ": " + reason;
+            return false;
+        };
+
+        unsigned long target = 0, value = 0;
+        if (!parser.hex(lastAddress, target))
+            return fail("expected an address from 000 to FFF");
+        if (!parser.literal("="))
+            return fail("expected = after the address");
+        if (!parser.hex(0xFF, value))
+            return fail("expected a value from 00 to FF");
+
+        // The condition goes first, then a skip over the store when it's false
+        size_t skipAt = 0;
+        if (!parser.atEnd())
+        {
+            if (!parser.literal("if"))
+                return fail("expected if or the end of the line");
+            bool first = true;
+            do
+            {
+                unsigned long addr = 0, operand = 0;
+                uint8_t test = Eq;
+                if (!parser.hex(lastAddress, addr))
+                    return fail("expected an address to compare");
+                if (!parser.test(test))
+                    return fail("expected == != < > <= or >=");
+                if (!parser.hex(0xFF, operand))
+                    return fail("expected a value to compare with");
+                compiled.push_back(Load);
+                emitAddress(compiled, addr);
+                compiled.push_back(Push);
+                compiled.push_back(static_cast<uint8_t>(operand));
+                compiled.push_back(Compare);
+                compiled.push_back(test);
+                if (!first)
+                    compiled.push_back(And);
+                first = false;
+            } while (parser.literal("&&"));
+            if (!parser.atEnd())
+                return fail("expected && or the end of the line");
+            compiled.push_back(SkipUnless);
+            skipAt = compiled.size();
+            compiled.insert(compiled.end(), 2, 0);
+        }
+
+        compiled.push_back(Store);
+        emitAddress(compiled, target);
+        compiled.push_back(static_cast<uint8_t>(value));
+        if (skipAt)
+        {
+            const size_t length = compiled.size() - skipAt - 2;
+            compiled[skipAt] = static_cast<uint8_t>(length >> 8);
+            compiled[skipAt + 1] = static_cast<uint8_t>(length);
+        }
+        ++count;
+    }
+
+    code = std::move(compiled);
+    cheats = count;
+    error.clear();
+    return true;
+}
+
+// The compiler only emits well-formed code, so nothing here is checked
+void CheatList::apply(Chip8 &machine) const
+{
+    const auto &memory = machine.getMemory();
+    uint8_t stack[stackDepth];
+    int top = 0;
+    size_t pc = 0;
+    while (pc < code.size())
+    {
+        switch (code[pc])
+        {
+        case Load:
+            stack[top++] = memory[(code[pc + 1] << 8 | code[pc + 2]) % memory.size()];
+            pc += 3;
+            break;
+        case Push:
+            stack[top++] = code[pc + 1];
+            pc += 2;
+            break;
+        case Compare:
+        {
+            const uint8_t b = stack[--top];
+            const uint8_t a = stack[top - 1];
+            bool result = false;
+            switch (code[pc + 1])
+            {
+            case Eq:
+                result = a == b;
+                break;
+            case Ne:
+                result = a != b;
+                break;
+            case Lt:
+                result = a < b;
+                break;
+            case Gt:
+                result = a > b;
+                break;
+            case Le:
+                result = a <= b;
+                break;
+            default:
+                result = a >= b;
+                break;
+            }
+            stack[top - 1] = result;
+            pc += 2;
+            break;
+        }
+        case And:
+            --top;
+            stack[top - 1] = stack[top - 1] && stack[top];
+            pc += 1;
+            break;
+        case SkipUnless:
+            pc += 3;
+            if (!stack[--top])
+                pc += code[pc - 2] << 8 | code[pc - 1];
+            break;
+        default: // Store
+            machine.pokeMemory(static_cast<uint16_t>(code[pc + 1] << 8 | code[pc + 2]), code[pc + 3]);
+            pc += 4;
+            break;
+        }
+    }
+}
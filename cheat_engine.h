@@ -0,0 +1,92 @@
+#ifndef CHEAT_ENGINE_H
+#define CHEAT_ENGINE_H
+
+#include "chip8.h"
+#include <cstddef> // For size_t
+#include <cstdint> // For uint8_t, uint16_t
+#include <string>  // For cheat text and errors
+#include <vector>  // For snapshots and bytecode
+
+// RAM search: narrows memory down to the bytes that hold a value of
+// interest (lives, a timer, the score) by comparing snapshots taken while
+// it changes or holds still. The candidates are a byte mask the size of
+// memory, filtered 16 or 32 bytes at a time, so a filter over 4 KB is a
+// couple of hundred vector compares and can run every frame.
+class MemorySearch
+{
+public:
+    enum class Filter
+    {
+        Changed, // Since the last snapshot
+        Unchanged,
+        Increased,
+        Decreased,
+        Equal, // To the value
+        NotEqual
+    };
+
+    // Every address a candidate, memory the first snapshot
+    void start(const uint8_t *memory, size_t size);
+    bool isStarted() const { return !snapshot.empty(); }
+
+    // Drops the candidates that fail the test, then takes memory as the
+    // snapshot the next filter compares with. The number left.
+    size_t filter(const uint8_t *memory, Filter test, uint8_t value = 0);
+
+    size_t count() const { return left; }
+
+    // Up to limit candidate addresses, lowest first
+    std::vector<uint16_t> candidates(size_t limit) const;
+
+    // The byte at addr in the last snapshot
+    uint8_t previous(uint16_t addr) const { return snapshot[addr % snapshot.size()]; }
+
+private:
+    std::vector<uint8_t> snapshot;
+    std::vector<uint8_t> keep;    // 0xFF where the address is still a candidate
+    std::vector<uint8_t> operand; // Equal and NotEqual's value in every byte
+    size_t left = 0;
+};
+
+// Cheats, one per line of text:
+//
+//   3F0 = 05                        hold a byte at a value
+//   3F0 = 09 if 3F1 < 02            only while a condition holds
+//   2A0 = 01 if 2A1 == 00 && 2A2 != FF
+//   # A comment
+//
+// Addresses and values are hex, a condition compares the byte at an
+// address with a value (== != < > <= >=). Parsing happens once: the list
+// is compiled to bytecode for a small stack machine, which runs once per
+// frame after the timer tick rather than inside the instruction loop.
+class CheatList
+{
+public:
+    // Replaces the list with the cheats in source. False with the line and
+    // the reason in error, the list unchanged.
+    bool compile(const std::string &source, std::string &error);
+
+    bool empty() const { return code.empty(); }
+    size_t size() const { return cheats; }
+
+    // Writes the value of every cheat whose condition holds
+    void apply(Chip8 &machine) const;
+
+private:
+    enum Op : uint8_t
+    {
+        Load,       // addr(2): push memory[addr]
+        Push,       // value(1)
+        Compare,    // test(1): pop b, pop a, push a test b
+        And,        // pop b, pop a, push a && b
+        SkipUnless, // length(2): pop, skip length bytes of code if 0
+        Store       // addr(2) value(1): memory[addr] = value
+    };
+
+    static constexpr int stackDepth = 3; // A condition so far, and the two sides of the next
+
+    std::vector<uint8_t> code;
+    size_t cheats = 0;
+};
+
+#endif
@@ -1,21 +1,22 @@
 #include "chip8.h"
+#include "chip8_jit.h"
+#include "chip8_aot.h"
+#include "chip8_simd.h"
+#include "profile_zones.h"
+#include "rom_cache.h"
+#include <algorithm> // For std::min
+#include <cstddef>   // For offsetof
+#include <cstring>   // For std::memcmp, std::memcpy
 #include <fstream>
-#include <random> // For random opcode
+#include <climits>  // For INT_MAX
+#include <iterator> // For std::istreambuf_iterator
+#include <random>   // For the default seed
+#include <type_traits> // For the classic-layout checks
 
-Chip8::Chip8()
-{
-    initFont();
-    // Random seed for CXNN opcode
-    std::random_device rd;
-    // We'll use this later
-}
-
-Chip8::~Chip8() {}
-
-void Chip8::initFont()
+namespace
 {
     // Font sprites (0-F), each 5 bytes, at 0x050
-    const std::array<uint8_t, 80> font = {
+    constexpr std::array<uint8_t, 80> font = {
         0xF0, 0x90, 0x90, 0x90, 0xF0, // 0
         0x20, 0x60, 0x20, 0x20, 0x70, // 1
         0xF0, 0x10, 0xF0, 0x80, 0xF0, // 2
@@ -33,284 +34,2084 @@ void Chip8::initFont()
         0xF0, 0x80, 0xF0, 0x80, 0xF0, // E
         0xF0, 0x80, 0xF0, 0x80, 0x80  // F
     };
-    for (size_t i = 0; i < font.size(); ++i)
+
+    // SUPER-CHIP 8x10 digits (FX30), each 10 bytes, at 0x0A0
+    constexpr std::array<uint8_t, 160> bigFont = {
+        0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+        0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+        0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+        0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+        0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+        0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+        0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+        0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+        0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+        0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+        0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+    };
+
+    // FX33 digits of every byte value, hundreds first
+    constexpr std::array<std::array<uint8_t, 3>, 256> bcdDigits = []
     {
-        memory[0x050 + i] = font[i];
+        std::array<std::array<uint8_t, 3>, 256> digits{};
+        for (int v = 0; v < 256; ++v)
+            digits[v] = {static_cast<uint8_t>(v / 100), static_cast<uint8_t>(v / 10 % 10), static_cast<uint8_t>(v % 10)};
+        return digits;
+    }();
+
+    // Zeroed memory with both fonts in place, evaluated by the compiler
+    template <size_t Size>
+    constexpr std::array<uint8_t, Size> makeBootMemory()
+    {
+        std::array<uint8_t, Size> boot{};
+        for (size_t i = 0; i < font.size(); ++i)
+            boot[0x050 + i] = font[i];
+        for (size_t i = 0; i < bigFont.size(); ++i)
+            boot[0x0A0 + i] = bigFont[i];
+        return boot;
     }
 }
 
-bool Chip8::loadROM(const std::string &filename)
+template <size_t MemorySize, int Planes, typename Quirks>
+BasicChip8<MemorySize, Planes, Quirks>::BasicChip8(Core coreType)
+    : core(coreType)
 {
-    reset(); // clear state before loading
+    memory = bootMemory();
 
-    std::ifstream file(filename, std::ios::binary | std::ios::ate);
-    if (!file.is_open())
-        return false;
+    // Generated code assumes the classic memory and display layout
+    if constexpr (std::is_same<BasicChip8, Chip8>::value)
+    {
+        if (core == Core::Jit || core == Core::Tiered)
+            jit = std::make_unique<Chip8Jit>(*this);
+        if (core == Core::Tiered)
+            jit->setTiers(TierPolicy{}.predecodeAfter, TierPolicy{}.compileAfter);
+        if (core == Core::Aot)
+            aot = std::make_unique<Chip8Aot>(*this);
+    }
+    // Without a recompiler the tiers stop at predecoded
+    if (core == Core::Tiered && !(jit && jit->available()))
+        core = Core::Predecoded;
+
+    // Unpredictable unless the caller seeds it
+    std::random_device rd;
+    seedRandom((static_cast<uint64_t>(rd()) << 32) | rd());
 
-    std::streamsize size = file.tellg();
-    file.seekg(0, std::ios::beg);
+#if defined(CHIP8_PROFILE)
+    opTable(); // Built now rather than inside the first timed instruction
+#endif
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+BasicChip8<MemorySize, Planes, Quirks>::~BasicChip8() {}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+const std::array<uint8_t, MemorySize> &BasicChip8<MemorySize, Planes, Quirks>::bootMemory()
+{
+    // Static data, construction and reset only copy it
+    static constexpr std::array<uint8_t, MemorySize> image = makeBootMemory<MemorySize>();
+    return image;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+bool BasicChip8<MemorySize, Planes, Quirks>::loadROM(const std::string &filename)
+{
+    std::shared_ptr<const RomCache::Image> rom = RomCache::shared().get(filename);
+    if (!rom)
+    {
+        romImage.clear();
+        reset();
+        return false;
+    }
+    return loadROM(rom->data(), rom->size());
+}
 
-    if (size > 4096 - 0x200)
+template <size_t MemorySize, int Planes, typename Quirks>
+bool BasicChip8<MemorySize, Planes, Quirks>::loadROM(const uint8_t *data, size_t size)
+{
+    CHIP8_ZONE("ROM load");
+    if (size > romLimit)
+    {
+        romImage.clear();
+        reset();
         return false; // Too big
+    }
 
-    file.read(reinterpret_cast<char *>(&memory[0x200]), size);
+    romImage.assign(data, data + size);
+    reset();
+    if (aot)
+        aot->select(data, size);
     return true;
 }
 
-void Chip8::emulateCycle()
+template <size_t MemorySize, int Planes, typename Quirks>
+bool BasicChip8<MemorySize, Planes, Quirks>::patchROM(const uint8_t *data, size_t size)
 {
-    // Fetch opcode
-    uint16_t opcode = (memory[PC] << 8) | memory[PC + 1];
-    PC += 2;
+    if (size != romImage.size())
+        return false;
+    for (size_t i = 0; i < size; ++i)
+    {
+        if (data[i] == romImage[i])
+            continue;
+        const uint16_t addr = static_cast<uint16_t>(Quirks::loadAddress + i);
+        if (memory[addr] == romImage[i])
+        {
+            memory[addr] = data[i];
+            invalidateCode(addr);
+        }
+        romImage[i] = data[i];
+    }
+    if (aot)
+        aot->select(data, size); // A translation of the old ROM no longer fits
+    return true;
+}
 
-    // Decode and execute
-    uint8_t x = (opcode & 0x0F00) >> 8;
-    uint8_t y = (opcode & 0x00F0) >> 4;
-    uint8_t n = opcode & 0x000F;
-    uint8_t nn = opcode & 0x00FF;
-    uint16_t nnn = opcode & 0x0FFF;
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::pokeMemory(uint16_t addr, uint8_t value)
+{
+    addr %= MemorySize;
+    if (memory[addr] == value)
+        return; // Frozen bytes are written every frame, mostly with what's there
+    memory[addr] = value;
+    invalidateCode(addr);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+typename BasicChip8<MemorySize, Planes, Quirks>::Instruction BasicChip8<MemorySize, Planes, Quirks>::decode(uint16_t opcode)
+{
+    Instruction in;
+    in.opcode = opcode;
+    in.nnn = opcode & 0x0FFF;
+    in.x = (opcode & 0x0F00) >> 8;
+    in.y = (opcode & 0x00F0) >> 4;
+    in.n = opcode & 0x000F;
+    in.nn = opcode & 0x00FF;
+    return in;
+}
 
+template <size_t MemorySize, int Planes, typename Quirks>
+typename BasicChip8<MemorySize, Planes, Quirks>::OpHandler BasicChip8<MemorySize, Planes, Quirks>::decodeHandler(uint16_t opcode)
+{
     switch (opcode & 0xF000)
     {
     case 0x0000:
         if (opcode == 0x00E0)
-        { // CLS
-            gfx.fill(false);
-            drawFlag = true;
+            return &invoke<&BasicChip8::opCLS>;
+        if (opcode == 0x00EE)
+            return &invoke<&BasicChip8::opRET>;
+        if ((opcode & 0xFFF0) == 0x00C0)
+            return &invoke<&BasicChip8::opSCD>;
+        if (opcode == 0x00FB)
+            return &invoke<&BasicChip8::opSCR>;
+        if (opcode == 0x00FC)
+            return &invoke<&BasicChip8::opSCL>;
+        if (opcode == 0x00FE)
+            return &invoke<&BasicChip8::opLOW>;
+        if (opcode == 0x00FF)
+            return &invoke<&BasicChip8::opHIGH>;
+        if constexpr (Quirks::loresRows == 64)
+        {
+            if (opcode == 0x0230)
+                return &invoke<&BasicChip8::opCLS>;
+        }
+        if constexpr (Quirks::colourZones)
+        {
+            if (opcode == 0x02A0)
+                return &invoke<&BasicChip8::opBGC>;
         }
-        else if (opcode == 0x00EE)
-        { // RET
-            --sp;
-            PC = stack[sp];
+        return &invoke<&BasicChip8::opNOP>; // Ignore 0NNN
+    case 0x1000:
+        return &invoke<&BasicChip8::opJP>;
+    case 0x2000:
+        return &invoke<&BasicChip8::opCALL>;
+    case 0x3000:
+        return &invoke<&BasicChip8::opSEByte>;
+    case 0x4000:
+        return &invoke<&BasicChip8::opSNEByte>;
+    case 0x5000:
+        if constexpr (xoChip)
+        {
+            if ((opcode & 0x000F) == 0x2)
+                return &invoke<&BasicChip8::opSAVE>;
+            if ((opcode & 0x000F) == 0x3)
+                return &invoke<&BasicChip8::opLOAD>;
         }
-        // Ignore 0NNN
-        break;
-    case 0x1000: // JP addr
-        PC = nnn;
-        break;
-    case 0x2000: // CALL addr
-        stack[sp] = PC;
-        ++sp;
-        PC = nnn;
-        break;
-    case 0x3000: // SE Vx, byte
-        if (V[x] == nn)
-            PC += 2;
-        break;
-    case 0x4000: // SNE Vx, byte
-        if (V[x] != nn)
-            PC += 2;
-        break;
-    case 0x5000: // SE Vx, Vy
-        if (V[x] == V[y])
-            PC += 2;
-        break;
-    case 0x6000: // LD Vx, byte
-        V[x] = nn;
-        break;
-    case 0x7000: // ADD Vx, byte
-        V[x] += nn;
-        break;
+        if constexpr (Quirks::colourZones)
+        {
+            if ((opcode & 0x000F) == 0x1)
+                return &invoke<&BasicChip8::opADDN>;
+        }
+        return &invoke<&BasicChip8::opSEReg>;
+    case 0x6000:
+        return &invoke<&BasicChip8::opLDByte>;
+    case 0x7000:
+        return &invoke<&BasicChip8::opADDByte>;
     case 0x8000:
-        switch (n)
+        switch (opcode & 0x000F)
         {
         case 0x0:
-            V[x] = V[y];
-            break; // LD Vx, Vy
+            return &invoke<&BasicChip8::opLDReg>;
         case 0x1:
-            V[x] |= V[y];
-            break; // OR Vx, Vy
+            return &invoke<&BasicChip8::opOR>;
         case 0x2:
-            V[x] &= V[y];
-            break; // AND Vx, Vy
+            return &invoke<&BasicChip8::opAND>;
         case 0x3:
-            V[x] ^= V[y];
-            break; // XOR Vx, Vy
+            return &invoke<&BasicChip8::opXOR>;
         case 0x4:
-        { // ADD Vx, Vy
-            uint16_t sum = V[x] + V[y];
-            V[x] = sum & 0xFF;
-            V[0xF] = (sum > 0xFF) ? 1 : 0;
-        }
-        break;
+            return &invoke<&BasicChip8::opADDReg>;
         case 0x5:
-        { // SUB Vx, Vy
-            V[0xF] = (V[x] >= V[y]) ? 1 : 0;
-            V[x] -= V[y];
-        }
-        break;
+            return &invoke<&BasicChip8::opSUB>;
         case 0x6:
-        { // SHR Vx {, Vy}
-            V[0xF] = V[x] & 0x01;
-            V[x] >>= 1;
-        }
-        break;
+            return &invoke<&BasicChip8::opSHR>;
         case 0x7:
-        { // SUBN Vx, Vy
-            V[0xF] = (V[y] >= V[x]) ? 1 : 0;
-            V[x] = V[y] - V[x];
-        }
-        break;
+            return &invoke<&BasicChip8::opSUBN>;
         case 0xE:
-        { // SHL Vx {, Vy}
-            V[0xF] = (V[x] >> 7) & 0x01;
-            V[x] <<= 1;
+            return &invoke<&BasicChip8::opSHL>;
         }
         break;
+    case 0x9000:
+        return &invoke<&BasicChip8::opSNEReg>;
+    case 0xA000:
+        return &invoke<&BasicChip8::opLDI>;
+    case 0xB000:
+        if constexpr (Quirks::colourZones)
+            return &invoke<&BasicChip8::opCOL>; // CHIP-8X has no jump with offset
+        return &invoke<&BasicChip8::opJPV0>;
+    case 0xC000:
+        return &invoke<&BasicChip8::opRND>;
+    case 0xD000:
+        return &invoke<&BasicChip8::opDRW>;
+    case 0xE000:
+        switch (opcode & 0x00FF)
+        {
+        case 0x9E:
+            return &invoke<&BasicChip8::opSKP>;
+        case 0xA1:
+            return &invoke<&BasicChip8::opSKNP>;
+        }
+        if constexpr (Quirks::colourZones)
+        {
+            if ((opcode & 0x00FF) == 0xF2)
+                return &invoke<&BasicChip8::opSKP2>;
+            if ((opcode & 0x00FF) == 0xF5)
+                return &invoke<&BasicChip8::opSKNP2>;
         }
         break;
-    case 0x9000: // SNE Vx, Vy
-        if (V[x] != V[y])
-            PC += 2;
-        break;
-    case 0xA000: // LD I, addr
-        I = nnn;
-        break;
-    case 0xB000: // JP V0, addr
-        PC = nnn + V[0];
+    case 0xF000:
+        switch (opcode & 0x00FF)
+        {
+        case 0x07:
+            return &invoke<&BasicChip8::opLDVxDT>;
+        case 0x0A:
+            return &invoke<&BasicChip8::opLDVxK>;
+        case 0x15:
+            return &invoke<&BasicChip8::opLDDTVx>;
+        case 0x18:
+            return &invoke<&BasicChip8::opLDSTVx>;
+        case 0x1E:
+            return &invoke<&BasicChip8::opADDI>;
+        case 0x29:
+            return &invoke<&BasicChip8::opLDF>;
+        case 0x30:
+            return &invoke<&BasicChip8::opLDHF>;
+        case 0x33:
+            return &invoke<&BasicChip8::opLDB>;
+        case 0x55:
+            return &invoke<&BasicChip8::opLDIVx>;
+        case 0x65:
+            return &invoke<&BasicChip8::opLDVxI>;
+        case 0x75:
+            return &invoke<&BasicChip8::opLDRVx>;
+        case 0x85:
+            return &invoke<&BasicChip8::opLDVxR>;
+        case 0x3A:
+            return &invoke<&BasicChip8::opPITCH>;
+        case 0x02:
+            if (opcode == 0xF002)
+                return &invoke<&BasicChip8::opAUDIO>;
+            break;
+        }
+        if constexpr (xoChip)
+        {
+            if (opcode == 0xF000)
+                return &invoke<&BasicChip8::opLDIL>;
+            if ((opcode & 0x00FF) == 0x01)
+                return &invoke<&BasicChip8::opPLANE>;
+        }
+        if constexpr (Quirks::colourZones)
+        {
+            if ((opcode & 0x00FF) == 0xFB)
+                return &invoke<&BasicChip8::opIN>;
+            if ((opcode & 0x00FF) == 0xF8)
+                return &invoke<&BasicChip8::opNOP>; // FXF8's output goes nowhere
+        }
         break;
-    case 0xC000: // RND Vx, byte
-    {
-        static std::mt19937 gen(std::random_device{}());
-        std::uniform_int_distribution<uint8_t> dist(0, 255);
-        V[x] = dist(gen) & nn;
     }
-    break;
-    case 0xD000: // DRW Vx, Vy, nibble
+    // Unknown opcode - ignore, but count it
+    return &invoke<&BasicChip8::opUNKNOWN>;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+const std::array<typename BasicChip8<MemorySize, Planes, Quirks>::OpHandler, 0x10000> &BasicChip8<MemorySize, Planes, Quirks>::opTable()
+{
+    // Built once and shared by every instance
+    static const std::array<OpHandler, 0x10000> table = []
     {
-        V[0xF] = 0;
-        uint8_t vx = V[x] % 64;
-        uint8_t vy = V[y] % 32;
-        for (uint8_t row = 0; row < n; ++row)
+        std::array<OpHandler, 0x10000> t{};
+        for (size_t op = 0; op < t.size(); ++op)
+            t[op] = decodeHandler(static_cast<uint16_t>(op));
+        return t;
+    }();
+    return table;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::emulateCycle()
+{
+    ++cycleCount;
+    if (keyWaitReg >= 0)
+        return; // Halted in FX0A until setKey wakes it
+    if constexpr (Quirks::displayWait)
+    {
+        // Halted in DXYN, the first turn after the tick draws
+        if (drawWait)
         {
-            uint8_t sprite = memory[I + row];
-            for (uint8_t col = 0; col < 8; ++col)
+            if (vblank)
             {
-                if ((sprite & (0x80 >> col)) != 0)
-                {
-                    size_t idx = (vy + row) * 64 + (vx + col);
-                    if (idx < 64 * 32)
-                    { // Clip to screen
-                        if (gfx[idx])
-                            V[0xF] = 1;
-                        gfx[idx] ^= true;
-                    }
-                }
+                const Instruction in = decode(drawWait);
+                drawWait = 0;
+                opDRW(in);
             }
+            return;
         }
-        drawFlag = true;
     }
-    break;
-    case 0xE000:
-        if (nn == 0x9E)
-        { // SKP Vx
-            if (keys[V[x]])
-                PC += 2;
-        }
-        else if (nn == 0xA1)
-        { // SKNP Vx
-            if (!keys[V[x]])
-                PC += 2;
+#if defined(CHIP8_PROFILE)
+    Chip8Profile::Scope profileScope(profiler, PC, static_cast<uint16_t>((memory[PC % MemorySize] << 8) | memory[(PC + 1) % MemorySize]));
+#endif
+    if (core == Core::Predecoded && (PC & 1) == 0)
+    {
+        DecodedOp &op = decodedAt(PC);
+        PC += 2;
+        op.handler(*this, op.in);
+        return;
+    }
+
+    // Fetch opcode
+    uint16_t opcode = (memory[PC % MemorySize] << 8) | memory[(PC + 1) % MemorySize];
+    PC += 2;
+
+    // Decode and execute
+    OpHandler handler = (core == Core::Switch) ? decodeHandler(opcode) : opTable()[opcode];
+    handler(*this, decode(opcode));
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::emulateCycles(int count)
+{
+#if !defined(CHIP8_PROFILE)
+    if (jit && jit->available())
+    {
+        // Compiled blocks don't count, the ones run through emulateCycle did
+        uint64_t before = cycleCount;
+        cycleCount = before + jit->run(count);
+        return;
+    }
+    if (aot && aot->hasProgram())
+    {
+        uint64_t before = cycleCount;
+        cycleCount = before + aot->run(count);
+        return;
+    }
+#endif
+    // Halted, the turns pass with nothing to run
+    if (keyWaitReg >= 0 || (Quirks::displayWait && drawWait && !vblank))
+    {
+        cycleCount += count;
+        countIdle(1, count);
+        return;
+    }
+    idleCheck = false;
+    int i = 0;
+#if !defined(CHIP8_PROFILE)
+    if (core == Core::Table && !(Quirks::displayWait && drawWait))
+        i = runInline(count); // The general loop below takes over a halt
+#endif
+    for (; i < count; ++i)
+    {
+#if !defined(CHIP8_PROFILE)
+        if (core == Core::Predecoded && (PC & 1) == 0 && keyWaitReg < 0 && !(Quirks::displayWait && drawWait))
+            i += stepDecoded(count - i) - 1;
+        else
+#endif
+            emulateCycle();
+        if (!idleCheck)
+            continue;
+
+        // Keys and timers only change between calls: skip the turns left
+        idleCheck = false;
+        if (int loop = idleLoopAt(PC))
+        {
+            int skip = (count - i - 1) / loop * loop;
+            cycleCount += skip;
+            i += skip;
+            countIdle(loop, skip);
         }
-        break;
-    case 0xF000:
-        switch (nn)
+    }
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+int BasicChip8<MemorySize, Planes, Quirks>::stepDecoded(int budget)
+{
+    static constexpr int fusedLength[] = {0, 0, 3, 3, 2};
+    const size_t index = (PC >> 1) % predecoded.size();
+    if (fused[index] == FusedUnchecked)
+        fuseAt(PC);
+    DecodedOp &op = predecoded[index];
+    const Fused kind = fused[index];
+    if (kind > FusedNone && fusedLength[kind] <= budget)
+    {
+        int ran = kind == FusedDrawAt ? fusedDrawAt(&op) : kind == FusedCountedLoop ? fusedCountedLoop(&op) : fusedLoadBlock(&op);
+        cycleCount += ran;
+        return ran;
+    }
+
+    // What emulateCycle would do, the entry is already at hand
+    ++cycleCount;
+    PC += 2;
+    op.handler(*this, op.in);
+    return 1;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+int BasicChip8<MemorySize, Planes, Quirks>::runStraight(int limit, bool decoded)
+{
+    int ran = 0;
+    while (ran < limit)
+    {
+        const uint16_t from = PC;
+        int step = 1;
+        if (decoded && (PC & 1) == 0 && !(Quirks::displayWait && drawWait))
+            step = stepDecoded(limit - ran);
+        else
+            emulateCycle();
+        ran += step;
+        if (PC != static_cast<uint16_t>(from + 2 * step) || keyWaitReg >= 0 || idleCheck)
+            break;
+    }
+    return ran;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::setTierPolicy(const TierPolicy &policy)
+{
+    if (jit && core == Core::Tiered)
+        jit->setTiers(policy.predecodeAfter, policy.compileAfter);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::setWholeBlocks(bool enabled)
+{
+    if (jit)
+        jit->setWholeBlocks(enabled);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::runUntil(uint64_t cycle)
+{
+    while (cycleCount < cycle)
+        emulateCycles(static_cast<int>(std::min<uint64_t>(cycle - cycleCount, INT_MAX)));
+}
+
+// PC, I, sp and the cycle count live in locals here, so the compiler
+// keeps them in registers: stores into V, which as uint8_t may alias
+// anything in the machine, no longer force them to be reloaded. V itself
+// stays in the machine; a local copy costs a store-forwarding stall at
+// every event, more than its loads save. Jumps, calls,
+// skips, loads, 8XYN, ANNN, FX07, FX1E and FX29 run inline, matching
+// their handlers quirk for quirk. Any other instruction is an event: the
+// locals go back to the machine, the handler runs from the table and
+// they are read again. The loop stops after a halt, FX0A or the
+// displayWait DXYN.
+template <size_t MemorySize, int Planes, typename Quirks>
+int BasicChip8<MemorySize, Planes, Quirks>::runInline(int count)
+{
+    uint16_t pc = PC;
+    uint16_t index = I;
+    uint8_t stackTop = sp;
+    uint64_t cycles = cycleCount;
+    auto byteAt = [this](unsigned addr)
+    { return memory[addr % MemorySize]; };
+    auto skipIf = [&](bool cond)
+    {
+        unsigned length = 2;
+        if constexpr (xoChip)
+            length += 2u * ((byteAt(pc) == 0xF0) & (byteAt(pc + 1) == 0x00));
+        pc += static_cast<uint16_t>(cond * length);
+    };
+
+    int i = 0;
+    while (i < count)
+    {
+        const uint16_t opcode = static_cast<uint16_t>(byteAt(pc) << 8 | byteAt(pc + 1u));
+        const unsigned x = (opcode >> 8) & 0xF, y = (opcode >> 4) & 0xF;
+        const uint8_t nn = opcode & 0xFF;
+        const uint16_t nnn = opcode & 0xFFF;
+        pc += 2;
+        ++cycles;
+        ++i;
+        switch (opcode >> 12)
         {
-        case 0x07:
-            V[x] = delay_timer;
-            break; // LD Vx, DT
-        case 0x0A:
-        { // LD Vx, K
-            bool keyPressed = false;
-            for (uint8_t i = 0; i < 16; ++i)
+        case 0x1:
+            if (nnn < pc)
             {
-                if (keys[i])
+                // A backward jump may close an idle loop, as in opJP
+                pc = nnn;
+                if (int loop = idleLoopAt(pc))
                 {
-                    V[x] = i;
-                    keyPressed = true;
+                    const int skip = (count - i) / loop * loop;
+                    cycles += skip;
+                    i += skip;
+                    countIdle(loop, skip);
                 }
+                continue;
             }
-            if (!keyPressed)
-                PC -= 2; // Wait: repeat this instruction
-        }
-        break;
-        case 0x15:
-            delay_timer = V[x];
-            break; // LD DT, Vx
-        case 0x18:
-            sound_timer = V[x];
-            break; // LD ST, Vx
-        case 0x1E:
-            I += V[x];
-            break; // ADD I, Vx (no carry flag)
-        case 0x29:
-            I = 0x050 + (V[x] & 0x0F) * 5;
-            break; // LD F, Vx (font)
-        case 0x33:
-        { // LD B, Vx (BCD)
-            memory[I] = V[x] / 100;
-            memory[I + 1] = (V[x] / 10) % 10;
-            memory[I + 2] = V[x] % 10;
+            pc = nnn;
+            continue;
+        case 0x2:
+            stack[stackTop & (stackDepth - 1)] = pc;
+            ++stackTop;
+            pc = nnn;
+            continue;
+        case 0x3:
+            skipIf(V[x] == nn);
+            continue;
+        case 0x4:
+            skipIf(V[x] != nn);
+            continue;
+        case 0x5:
+            if ((opcode & 0xF) != 0)
+                break; // XO-CHIP's 5XY2/5XY3 and unknown opcodes
+            skipIf(V[x] == V[y]);
+            continue;
+        case 0x6:
+            V[x] = nn;
+            continue;
+        case 0x7:
+            V[x] += nn;
+            continue;
+        case 0x8:
+        {
+            const uint8_t vx = V[x], vy = V[y];
+            switch (opcode & 0xF)
+            {
+            case 0x0:
+                V[x] = vy;
+                continue;
+            case 0x1:
+            case 0x2:
+            case 0x3:
+                V[x] = (opcode & 0xF) == 0x1 ? vx | vy : (opcode & 0xF) == 0x2 ? vx & vy : vx ^ vy;
+                if constexpr (Quirks::logicResetsVF)
+                    V[0xF] = 0;
+                continue;
+            case 0x4:
+            {
+                const unsigned sum = vx + vy;
+                V[x] = static_cast<uint8_t>(sum);
+                V[0xF] = static_cast<uint8_t>(sum >> 8);
+                continue;
+            }
+            case 0x5:
+            case 0x7:
+            {
+                const uint8_t lhs = (opcode & 0xF) == 0x5 ? vx : vy, rhs = (opcode & 0xF) == 0x5 ? vy : vx;
+                if constexpr (Quirks::flagBeforeResult)
+                {
+                    V[0xF] = lhs >= rhs;
+                    V[x] = (opcode & 0xF) == 0x5 ? V[x] - V[y] : V[y] - V[x];
+                    continue;
+                }
+                V[x] = static_cast<uint8_t>(lhs - rhs);
+                V[0xF] = lhs >= rhs;
+                continue;
+            }
+            case 0x6:
+            case 0xE:
+            {
+                const bool left = (opcode & 0xF) == 0xE;
+                const uint8_t src = Quirks::shiftUsesVy ? vy : vx;
+                const uint8_t flag = left ? src >> 7 : src & 0x01;
+                if constexpr (Quirks::flagBeforeResult && !Quirks::shiftUsesVy)
+                {
+                    V[0xF] = flag;
+                    V[x] = left ? static_cast<uint8_t>(V[x] << 1) : V[x] >> 1;
+                    continue;
+                }
+                V[x] = left ? static_cast<uint8_t>(src << 1) : src >> 1;
+                V[0xF] = flag;
+                continue;
+            }
+            }
+            break; // Unknown 8XYN
         }
-        break;
-        case 0x55:
-        { // LD [I], Vx
-            for (uint8_t i = 0; i <= x; ++i)
+        case 0x9:
+            if ((opcode & 0xF) != 0)
+                break;
+            skipIf(V[x] != V[y]);
+            continue;
+        case 0xA:
+            index = nnn;
+            continue;
+        case 0xB:
+            if constexpr (Quirks::colourZones)
+                break; // BXYN colours
+            pc = static_cast<uint16_t>(nnn + V[Quirks::jumpUsesVx ? x : 0]);
+            continue;
+        case 0xF:
+            if (nn == 0x07)
+            {
+                V[x] = getDelayTimer();
+                continue;
+            }
+            if (nn == 0x1E)
+            {
+                index += V[x];
+                continue;
+            }
+            if (nn == 0x29)
+            {
+                index = static_cast<uint16_t>(0x050 + (V[x] & 0x0F) * 5);
+                continue;
+            }
+            break;
+        default:
+            if (opcode == 0x00EE)
             {
-                memory[I + i] = V[i];
+                --stackTop;
+                pc = stack[stackTop & (stackDepth - 1)];
+                continue;
             }
-            I += x + 1; // Increment I (original behavior)
+            break;
         }
-        break;
-        case 0x65:
-        { // LD Vx, [I]
-            for (uint8_t i = 0; i <= x; ++i)
+
+        // An event: the handler sees and leaves the machine as it is
+        PC = pc;
+        I = index;
+        sp = stackTop;
+        cycleCount = cycles;
+        opTable()[opcode](*this, decode(opcode));
+        pc = PC;
+        index = I;
+        stackTop = sp;
+        cycles = cycleCount;
+        if (keyWaitReg >= 0 || (Quirks::displayWait && drawWait))
+            break;
+        if (idleCheck)
+        {
+            idleCheck = false;
+            if (int loop = idleLoopAt(pc))
             {
-                V[i] = memory[I + i];
+                const int skip = (count - i) / loop * loop;
+                cycles += skip;
+                i += skip;
+                countIdle(loop, skip);
             }
-            I += x + 1; // Increment I (original behavior)
         }
-        break;
+    }
+    PC = pc;
+    I = index;
+    sp = stackTop;
+    cycleCount = cycles;
+    return i;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+typename BasicChip8<MemorySize, Planes, Quirks>::DecodedOp &BasicChip8<MemorySize, Planes, Quirks>::decodedAt(uint16_t pc)
+{
+    DecodedOp &op = predecoded[(pc >> 1) % predecoded.size()];
+    if (!op.handler)
+    {
+        uint16_t opcode = (memory[pc % MemorySize] << 8) | memory[(pc + 1) % MemorySize];
+        op.handler = opTable()[opcode];
+        op.in = decode(opcode);
+        bool &again = redecode[(pc >> 1) % redecode.size()];
+        if (again)
+        {
+            again = false;
+            ++decodeStats.recompiles;
         }
-        break;
-    default:
-        // Unknown opcode - handle error or ignore
-        break;
     }
+    return op;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::fuseAt(uint16_t pc)
+{
+    Fused &kind = fused[(pc >> 1) % fused.size()];
+    kind = FusedNone;
+    const uint16_t first = decodedAt(pc).in.opcode;
+    if (pc + 6u > MemorySize)
+        return; // The entries after it would wrap around
+    const uint16_t second = decodedAt(pc + 2).in.opcode;
+    const uint16_t third = decodedAt(pc + 4).in.opcode; // So invalidateCode only has to look at one entry
+    if ((first & 0xF000) == 0xA000 && (second & 0xF0FF) == 0xF065)
+        kind = FusedLoadBlock;
+    else if ((first & 0xF000) == 0x6000 && (second & 0xF000) == 0x6000 && (third & 0xF000) == 0xD000)
+        kind = FusedDrawAt;
+    else if ((first & 0xF000) == 0x7000 && ((second & 0xF000) == 0x3000 || (second & 0xF000) == 0x4000) &&
+             (third & 0xF000) == 0x1000)
+        kind = FusedCountedLoop;
 }
 
-void Chip8::decrementTimers()
+// The handlers below do exactly what running their instructions one by
+// one would, PC included, so a sequence can be entered or left anywhere
+
+template <size_t MemorySize, int Planes, typename Quirks>
+int BasicChip8<MemorySize, Planes, Quirks>::fusedDrawAt(const DecodedOp *ops)
 {
-    if (delay_timer > 0)
-        --delay_timer;
+    V[ops[0].in.x] = ops[0].in.nn;
+    V[ops[1].in.x] = ops[1].in.nn;
+    PC += 6;
+    opDRW(ops[2].in);
+    return 3;
+}
 
-    if (sound_timer > 0)
+template <size_t MemorySize, int Planes, typename Quirks>
+int BasicChip8<MemorySize, Planes, Quirks>::fusedCountedLoop(const DecodedOp *ops)
+{
+    V[ops[0].in.x] += ops[0].in.nn;
+    PC += 4;
+    const Instruction &test = ops[1].in;
+    if ((V[test.x] == test.nn) == ((test.opcode & 0xF000) == 0x3000))
     {
-        --sound_timer;
-        beepFlag = true; // set flag whenever sound_timer is non-zero
+        skipIf(true); // Out of the loop, past the jump
+        return 2;
     }
-    else
+    PC += 2;
+    opJP(ops[2].in);
+    return 3;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+int BasicChip8<MemorySize, Planes, Quirks>::fusedLoadBlock(const DecodedOp *ops)
+{
+    I = ops[0].in.nnn;
+    PC += 4;
+    opLDVxI(ops[1].in);
+    return 2;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+int BasicChip8<MemorySize, Planes, Quirks>::idleLoopAt(uint16_t pc) const
+{
+    auto fetch = [this](size_t addr)
+    {
+        return static_cast<uint16_t>((memory[addr % MemorySize] << 8) | memory[(addr + 1) % MemorySize]);
+    };
+    if (keyWaitReg >= 0 || (Quirks::displayWait && drawWait && !vblank))
+        return 1;
+    uint16_t opcode = fetch(pc);
+    if (opcode == (0x1000 | pc))
+        return 1;
+    // Vx must already hold the timer, or the first turn would still change it
+    if ((opcode & 0xF0FF) == 0xF007 && getDelayTimer() > 0 && V[(opcode >> 8) & 0xF] == getDelayTimer())
     {
-        beepFlag = false; // reset flag when sound_timer is zero
+        uint16_t x = opcode & 0x0F00;
+        if (fetch(pc + 2) == (0x3000 | x) && fetch(pc + 4) == (0x1000 | pc))
+            return 3;
     }
+    return 0;
 }
 
-void Chip8::reset()
+// Approximate VIP interpreter costs in machine cycles, fetch and decode
+// included. Skips add 4 when taken, see emulateVipCycles.
+template <size_t MemorySize, int Planes, typename Quirks>
+int BasicChip8<MemorySize, Planes, Quirks>::vipCost(uint16_t opcode)
 {
-    memory.fill(0);
-    V.fill(0);
-    gfx.fill(false);
-    keys.fill(false);
-    stack.fill(0);
-
-    I = 0;
-    PC = 0x200; // programs start at 0x200
-    sp = 0;
-    delay_timer = 0;
-    sound_timer = 0;
+    const int fetch = 40;
+    const int x = (opcode >> 8) & 0xF;
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        if (opcode == 0x00E0)
+            return fetch + 24 + 256 * 8; // Clears the 256 display bytes one at a time
+        return fetch + 10;
+    case 0x1:
+        return fetch + 12;
+    case 0x2:
+        return fetch + 26;
+    case 0x3:
+    case 0x4:
+        return fetch + 10;
+    case 0x5:
+    case 0x9:
+        return fetch + 14;
+    case 0x6:
+        return fetch + 6;
+    case 0x7:
+        return fetch + 10;
+    case 0x8:
+        return fetch + 44;
+    case 0xA:
+        return fetch + 12;
+    case 0xB:
+        return fetch + 22;
+    case 0xC:
+        return fetch + 36;
+    case 0xD:
+        return fetch + 26 + 46 * (opcode & 0xF); // Each row is shifted into place bit by bit
+    case 0xE:
+        return fetch + 14;
+    default:
+        switch (opcode & 0xFF)
+        {
+        case 0x1E:
+        case 0x29:
+            return fetch + 16;
+        case 0x33:
+            return fetch + 150;
+        case 0x55:
+        case 0x65:
+            return fetch + 14 + 14 * (x + 1);
+        default:
+            return fetch + 10;
+        }
+    }
+}
 
-    drawFlag = false;
-    beepFlag = false;
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::emulateVipCycles(int budget)
+{
+    // Whatever is left of a frame after DXYN or in FX0A is spent waiting
+    if (vipWaiting || keyWaitReg >= 0)
+    {
+        vipDebt = 0;
+        return;
+    }
+    budget -= vipDebt;
+    while (budget > 0 && keyWaitReg < 0)
+    {
+        uint16_t opcode = (memory[PC % MemorySize] << 8) | memory[(PC + 1) % MemorySize];
+        if (Quirks::displayWait && drawWait)
+            opcode = drawWait; // The halted DXYN finishes in this turn
+        uint16_t pc = PC;
+        emulateCycle();
+        budget -= vipCost(opcode);
+        int group = opcode >> 12;
+        bool skip = group == 0x3 || group == 0x4 || group == 0x5 || group == 0x9 || group == 0xE;
+        if (skip && PC != static_cast<uint16_t>(pc + 2))
+            budget -= 4;
+        if (group == 0xD)
+        {
+            vipWaiting = true;
+            budget = 0;
+            break;
+        }
+    }
+    vipDebt = -budget;
+}
 
-    initFont(); // reload font sprites
+template <size_t MemorySize, int Planes, typename Quirks>
+inline void BasicChip8<MemorySize, Planes, Quirks>::invalidateCode(uint16_t addr)
+{
+    // fuseAt decodes every entry it looks at, so if this one isn't decoded
+    // no fused kind depends on it
+    const uint64_t page = uint64_t(1) << ((addr % MemorySize) / hashPageBytes);
+    dirtyPages |= page;
+    if (spritePages & page)
+        dropSprites();
+    if (predecoded[(addr >> 1) % predecoded.size()].handler)
+    {
+        unfuse(addr >> 1);
+        redecode[(addr >> 1) % redecode.size()] = true;
+        ++decodeStats.codeWrites;
+        ++decodeStats.invalidations;
+    }
+    if (jit)
+        jit->invalidate(addr);
+    if (aot)
+        aot->invalidate(addr);
 }
+
+template <size_t MemorySize, int Planes, typename Quirks>
+typename BasicChip8<MemorySize, Planes, Quirks>::CodeCacheStats BasicChip8<MemorySize, Planes, Quirks>::getCodeCacheStats() const
+{
+    switch (core)
+    {
+    case Core::Predecoded:
+        return decodeStats;
+    case Core::Jit:
+    case Core::Tiered:
+        if (jit)
+            return {jit->codeWrites(), jit->invalidations(), jit->recompiles()};
+        break;
+    case Core::Aot:
+        if (aot)
+            return {aot->codeWrites(), aot->invalidations(), 0}; // Dropped blocks stay interpreted
+        break;
+    default:
+        break;
+    }
+    return {};
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::unfuse(size_t index)
+{
+    // Superinstructions start up to two entries before the one written
+    predecoded[index % predecoded.size()].handler = nullptr;
+    fused[index % fused.size()] = FusedUnchecked;
+    fused[(index - 1) % fused.size()] = FusedUnchecked;
+    fused[(index - 2) % fused.size()] = FusedUnchecked;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opNOP(const Instruction &) {}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opUNKNOWN(const Instruction &in)
+{
+    ++unknownOpcodes.count;
+    unknownOpcodes.lastOpcode = in.opcode;
+    unknownOpcodes.lastPC = static_cast<uint16_t>(PC - 2);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opCLS(const Instruction &)
+{
+    if (presentPoint == PresentPoint::BeforeClear)
+    {
+        cleared = gfx;
+        clearedHires = hires;
+        clearedSincePresent = true;
+    }
+    for (int p = 0; p < Planes; ++p)
+    {
+        if (!(planeMask & (1 << p)))
+            continue;
+        uint64_t *plane = &gfx[p * planeWords];
+        for (size_t y = 0; y < planeWords / rowWords; ++y)
+        {
+            if (plane[y * rowWords] | plane[y * rowWords + 1])
+                dirtyRows |= 1ull << y;
+        }
+        std::fill(plane, plane + planeWords, 0);
+    }
+    drawFlag = true;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opRET(const Instruction &)
+{
+    // The stack wraps at stackDepth entries, as sp does at 256: the mask
+    // keeps a runaway program inside the array without a branch, and the
+    // debugger's stack trap is what catches one
+    --sp;
+    PC = stack[sp & (stackDepth - 1)];
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opJP(const Instruction &in) // JP addr
+{
+    idleCheck |= in.nnn < PC;
+    PC = in.nnn;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opCALL(const Instruction &in) // CALL addr
+{
+    stack[sp & (stackDepth - 1)] = PC;
+    ++sp;
+    PC = in.nnn;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSEByte(const Instruction &in) // SE Vx, byte
+{
+    skipIf(V[in.x] == in.nn);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSNEByte(const Instruction &in) // SNE Vx, byte
+{
+    skipIf(V[in.x] != in.nn);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSEReg(const Instruction &in) // SE Vx, Vy
+{
+    skipIf(V[in.x] == V[in.y]);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDByte(const Instruction &in) // LD Vx, byte
+{
+    V[in.x] = in.nn;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opADDByte(const Instruction &in) // ADD Vx, byte
+{
+    V[in.x] += in.nn;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDReg(const Instruction &in) // LD Vx, Vy
+{
+    V[in.x] = V[in.y];
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opOR(const Instruction &in) // OR Vx, Vy
+{
+    V[in.x] |= V[in.y];
+    if constexpr (Quirks::logicResetsVF)
+        V[0xF] = 0;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opAND(const Instruction &in) // AND Vx, Vy
+{
+    V[in.x] &= V[in.y];
+    if constexpr (Quirks::logicResetsVF)
+        V[0xF] = 0;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opXOR(const Instruction &in) // XOR Vx, Vy
+{
+    V[in.x] ^= V[in.y];
+    if constexpr (Quirks::logicResetsVF)
+        V[0xF] = 0;
+}
+
+// 8XY4-8XYE work out the result and the flag from the operands as read
+// and store both at the end, which leaves the compiler setc/adc and no
+// branches. Quirks::flagBeforeResult keeps the old order for 8XY5-8XYE:
+// VF first, then Vx from the registers as they are after it.
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opADDReg(const Instruction &in) // ADD Vx, Vy
+{
+    const unsigned sum = V[in.x] + V[in.y];
+    setResult(in.x, static_cast<uint8_t>(sum), static_cast<uint8_t>(sum >> 8));
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSUB(const Instruction &in) // SUB Vx, Vy
+{
+    if constexpr (Quirks::flagBeforeResult)
+    {
+        V[0xF] = (V[in.x] >= V[in.y]) ? 1 : 0;
+        V[in.x] -= V[in.y];
+        return;
+    }
+    const uint8_t vx = V[in.x], vy = V[in.y];
+    setResult(in.x, static_cast<uint8_t>(vx - vy), vx >= vy);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSHR(const Instruction &in) // SHR Vx {, Vy}
+{
+    const uint8_t src = Quirks::shiftUsesVy ? V[in.y] : V[in.x];
+    if constexpr (Quirks::flagBeforeResult && !Quirks::shiftUsesVy)
+    {
+        V[0xF] = src & 0x01;
+        V[in.x] >>= 1;
+        return;
+    }
+    setResult(in.x, src >> 1, src & 0x01);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSUBN(const Instruction &in) // SUBN Vx, Vy
+{
+    if constexpr (Quirks::flagBeforeResult)
+    {
+        V[0xF] = (V[in.y] >= V[in.x]) ? 1 : 0;
+        V[in.x] = V[in.y] - V[in.x];
+        return;
+    }
+    const uint8_t vx = V[in.x], vy = V[in.y];
+    setResult(in.x, static_cast<uint8_t>(vy - vx), vy >= vx);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSHL(const Instruction &in) // SHL Vx {, Vy}
+{
+    const uint8_t src = Quirks::shiftUsesVy ? V[in.y] : V[in.x];
+    if constexpr (Quirks::flagBeforeResult && !Quirks::shiftUsesVy)
+    {
+        V[0xF] = src >> 7;
+        V[in.x] <<= 1;
+        return;
+    }
+    setResult(in.x, static_cast<uint8_t>(src << 1), src >> 7);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSNEReg(const Instruction &in) // SNE Vx, Vy
+{
+    skipIf(V[in.x] != V[in.y]);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDI(const Instruction &in) // LD I, addr
+{
+    I = in.nnn;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opJPV0(const Instruction &in) // JP V0, addr
+{
+    PC = in.nnn + V[Quirks::jumpUsesVx ? in.x : 0]; // BXNN: XNN + Vx
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opRND(const Instruction &in) // RND Vx, byte
+{
+    V[in.x] = nextRandom() & in.nn;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opDRW(const Instruction &in) // DRW Vx, Vy, nibble
+{
+    // Like the VIP, draw at most once per 60 Hz tick: halt, yielding the
+    // rest of the frame, and draw in the first turn after the next one
+    if constexpr (Quirks::displayWait)
+    {
+        if (!vblank)
+        {
+            drawWait = in.opcode;
+            idleCheck = true;
+            return;
+        }
+        vblank = false;
+    }
+
+    // Each selected plane takes the next sprite's worth of bytes from I
+    size_t spriteBytes = (hires && in.n == 0) ? 32 : in.n;
+    uint16_t addr = I;
+    bool hit = false;
+    for (int p = 0; p < Planes; ++p)
+    {
+        if (!(planeMask & (1 << p)))
+            continue;
+        uint64_t *plane = &gfx[p * planeWords];
+        hit |= hires ? drawHires(plane, addr, in) : drawLores(plane, addr, in);
+        addr += spriteBytes;
+    }
+    V[0xF] = hit ? 1 : 0;
+    drawFlag = true;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+bool BasicChip8<MemorySize, Planes, Quirks>::drawLores(uint64_t *plane, uint16_t addr, const Instruction &in)
+{
+    uint8_t vx = V[in.x] % 64;
+    uint8_t vy = V[in.y] % Quirks::loresRows;
+    const SpriteRows &sprite = loresSprite(addr, vx, in.n);
+
+    // Rows past the bottom continue at the top, or are clipped; either way
+    // it is the same blit with no per-pixel checks
+    size_t rows = Quirks::wrapSprites ? sprite.n : std::min<size_t>(sprite.n, Quirks::loresRows - vy);
+    return blitRows(plane, sprite.words.data(), rows, vy, Quirks::loresRows);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+const typename BasicChip8<MemorySize, Planes, Quirks>::SpriteRows &
+BasicChip8<MemorySize, Planes, Quirks>::loresSprite(uint16_t addr, uint8_t vx, uint8_t n)
+{
+    addr %= MemorySize;
+    SpriteRows &entry = spriteCache[(addr * 5u + vx * 3u + n) % spriteCache.size()];
+    if (entry.n == n && entry.addr == addr && entry.vx == vx)
+        return entry;
+
+    entry.addr = addr;
+    entry.vx = vx;
+    entry.n = n;
+    entry.words.fill(0);
+    for (uint8_t row = 0; row < n; ++row)
+    {
+        // Columns past 63 rotate back in at the left, or are dropped
+        const uint64_t line = static_cast<uint64_t>(memory[(addr + row) % MemorySize]) << 56;
+        entry.words[row * rowWords] = Quirks::wrapSprites ? simd::rotr(line, vx) : line >> vx;
+    }
+    if (n)
+    {
+        spritePages |= uint64_t(1) << (addr / hashPageBytes);
+        spritePages |= uint64_t(1) << (((addr + n - 1) % MemorySize) / hashPageBytes);
+    }
+    return entry;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::dropSprites()
+{
+    for (SpriteRows &entry : spriteCache)
+        entry.n = 0;
+    spritePages = 0;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+bool BasicChip8<MemorySize, Planes, Quirks>::drawHires(uint64_t *plane, uint16_t addr, const Instruction &in)
+{
+    uint8_t vx = V[in.x] % 128;
+    uint8_t vy = V[in.y] % 64;
+    bool wide = in.n == 0; // DXY0: 16x16, two bytes per row
+    size_t rows = wide ? 16 : in.n;
+    if (!Quirks::wrapSprites)
+        rows = std::min<size_t>(rows, 64 - vy);
+
+    // The sprite line lands in the row's first or second word; bits past
+    // column 127 are clipped, or wrap into the first word
+    size_t word = vx >> 6;
+    unsigned shift = vx & 63;
+    std::array<uint64_t, 16 * rowWords> sprite{};
+    for (size_t row = 0; row < rows; ++row)
+    {
+        uint64_t line = wide ? (static_cast<uint64_t>(memory[(addr + 2 * row) % MemorySize]) << 56) |
+                                   (static_cast<uint64_t>(memory[(addr + 2 * row + 1) % MemorySize]) << 48)
+                             : static_cast<uint64_t>(memory[(addr + row) % MemorySize]) << 56;
+        sprite[row * rowWords + word] = line >> shift;
+        if (shift && word == 0)
+            sprite[row * rowWords + 1] = line << (64 - shift);
+        else if (shift && Quirks::wrapSprites)
+            sprite[row * rowWords] = line << (64 - shift);
+    }
+    return blitRows(plane, sprite.data(), rows, vy, 64);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+bool BasicChip8<MemorySize, Planes, Quirks>::blitRows(uint64_t *plane, const uint64_t *sprite, size_t rows, size_t vy, size_t screenRows)
+{
+    // At most two runs of whole rows, each XORed in with one collision reduction
+    size_t first = std::min(rows, screenRows - vy);
+    bool hit = simd::xorBlit(&plane[vy * rowWords], sprite, first * rowWords);
+    if (rows > first)
+        hit |= simd::xorBlit(plane, sprite + first * rowWords, (rows - first) * rowWords);
+    for (size_t row = 0; row < rows; ++row)
+    {
+        if (sprite[row * rowWords] | sprite[row * rowWords + 1])
+            dirtyRows |= 1ull << ((vy + row) % screenRows);
+    }
+    return hit;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::advanceIndex(uint8_t x)
+{
+    if constexpr (Quirks::loadStoreIndex == quirks::IndexStep::PlusXPlusOne)
+        I += x + 1;
+    else if constexpr (Quirks::loadStoreIndex == quirks::IndexStep::PlusX)
+        I += x;
+}
+
+// PC moves by the condition times the skip length, so the skips that
+// dominate game loops never branch on it; only XO-CHIP looks at the
+// skipped instruction, which is 4 bytes long if it is F000 NNNN
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::skipIf(bool cond)
+{
+    unsigned length = 2;
+    if constexpr (xoChip)
+        length += 2u * ((memory[PC % MemorySize] == 0xF0) & (memory[(PC + 1) % MemorySize] == 0x00));
+    PC += static_cast<uint16_t>(cond * length);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSKP(const Instruction &in) // SKP Vx
+{
+    if ((V[in.x] & 0xF) == watchedKey)
+        noteKeyRead();
+    skipIf(keys[V[in.x] & 0xF]);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSKNP(const Instruction &in) // SKNP Vx
+{
+    if ((V[in.x] & 0xF) == watchedKey)
+        noteKeyRead();
+    skipIf(!keys[V[in.x] & 0xF]);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDVxDT(const Instruction &in) // LD Vx, DT
+{
+    V[in.x] = getDelayTimer();
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDVxK(const Instruction &in) // LD Vx, K
+{
+    // Halt; keys already down when the wait starts don't count
+    keyWaitReg = static_cast<int8_t>(in.x);
+    keyWaitKey = -1;
+    idleCheck = true;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::setKey(int key, bool pressed)
+{
+    key &= 0xF;
+    bool wasDown = keys[key]; // Auto-repeat is not a new press
+    keys[key] = pressed;
+    if (keyWaitReg < 0)
+        return;
+    if (pressed && !wasDown && keyWaitKey < 0)
+    {
+        keyWaitKey = static_cast<int8_t>(key);
+    }
+    else if (!pressed && key == keyWaitKey)
+    {
+        if (key == watchedKey)
+            noteKeyRead();
+        V[keyWaitReg] = static_cast<uint8_t>(key);
+        keyWaitReg = -1;
+        keyWaitKey = -1;
+    }
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+uint16_t BasicChip8<MemorySize, Planes, Quirks>::keyMask() const
+{
+    uint16_t mask = 0;
+    for (int k = 0; k < 16; ++k)
+        mask |= static_cast<uint16_t>(keys[k]) << k;
+    return mask;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::setKeyMask(uint16_t mask)
+{
+    for (int k = 0; k < 16; ++k)
+        keys[k] = (mask >> k) & 1;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDDTVx(const Instruction &in) // LD DT, Vx
+{
+    setDelayTimer(V[in.x]);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDSTVx(const Instruction &in) // LD ST, Vx
+{
+    setSoundTimer(V[in.x]);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opADDI(const Instruction &in) // ADD I, Vx (no carry flag)
+{
+    I += V[in.x];
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDF(const Instruction &in) // LD F, Vx (font)
+{
+    I = 0x050 + (V[in.x] & 0x0F) * 5;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDB(const Instruction &in) // LD B, Vx (BCD)
+{
+    const std::array<uint8_t, 3> &digits = bcdDigits[V[in.x]];
+    if (I + 2u < MemorySize)
+        std::memcpy(&memory[I], digits.data(), digits.size());
+    else
+    {
+        for (size_t i = 0; i < digits.size(); ++i)
+            memory[(I + i) % MemorySize] = digits[i];
+    }
+    invalidateCode(I);
+    invalidateCode(I + 2);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDIVx(const Instruction &in) // LD [I], Vx
+{
+    for (uint8_t i = 0; i <= in.x; ++i)
+    {
+        memory[(I + i) % MemorySize] = V[i];
+        invalidateCode(I + i);
+    }
+    advanceIndex(in.x);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDVxI(const Instruction &in) // LD Vx, [I]
+{
+    for (uint8_t i = 0; i <= in.x; ++i)
+    {
+        V[i] = memory[(I + i) % MemorySize];
+    }
+    advanceIndex(in.x);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opAUDIO(const Instruction &) // F002: load audio pattern from [I]
+{
+    for (size_t i = 0; i < audioPattern.size(); ++i)
+        audioPattern[i] = memory[(I + i) % MemorySize];
+    audioPatternLoaded = true;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opPITCH(const Instruction &in) // FX3A: set playback pitch
+{
+    pitch = V[in.x];
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSCD(const Instruction &in) // 00CN: scroll down N rows
+{
+    // Whole rows move, so this is a word copy down each plane
+    size_t rows = height();
+    for (int p = 0; p < Planes; ++p)
+    {
+        if (!(planeMask & (1 << p)))
+            continue;
+        uint64_t *plane = &gfx[p * planeWords];
+        std::copy_backward(plane, plane + (rows - in.n) * rowWords, plane + rows * rowWords);
+        std::fill(plane, plane + in.n * rowWords, 0);
+    }
+    dirtyRows = ~0ull;
+    drawFlag = true;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSCR(const Instruction &) // 00FB: scroll right 4 pixels
+{
+    for (int p = 0; p < Planes; ++p)
+    {
+        if (!(planeMask & (1 << p)))
+            continue;
+        for (int y = 0; y < height(); ++y)
+        {
+            uint64_t *row = &gfx[p * planeWords + y * rowWords];
+            // Lo-res drops what leaves column 63, hi-res carries it into the second word
+            if (hires)
+                row[1] = (row[1] >> 4) | (row[0] << 60);
+            row[0] >>= 4;
+        }
+    }
+    dirtyRows = ~0ull;
+    drawFlag = true;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSCL(const Instruction &) // 00FC: scroll left 4 pixels
+{
+    for (int p = 0; p < Planes; ++p)
+    {
+        if (!(planeMask & (1 << p)))
+            continue;
+        for (int y = 0; y < height(); ++y)
+        {
+            uint64_t *row = &gfx[p * planeWords + y * rowWords];
+            row[0] = (row[0] << 4) | (row[1] >> 60);
+            row[1] <<= 4;
+        }
+    }
+    dirtyRows = ~0ull;
+    drawFlag = true;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLOW(const Instruction &) // 00FE: 64x32, clears the screen
+{
+    hires = false;
+    gfx.fill(0);
+    dirtyRows = ~0ull;
+    drawFlag = true;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opHIGH(const Instruction &) // 00FF: 128x64, clears the screen
+{
+    hires = true;
+    gfx.fill(0);
+    dirtyRows = ~0ull;
+    drawFlag = true;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDHF(const Instruction &in) // LD HF, Vx (8x10 font)
+{
+    I = 0x0A0 + (V[in.x] & 0x0F) * 10;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDRVx(const Instruction &in) // LD R, Vx
+{
+    for (uint8_t i = 0; i <= in.x; ++i)
+        rplFlags[i] = V[i];
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDVxR(const Instruction &in) // LD Vx, R
+{
+    for (uint8_t i = 0; i <= in.x; ++i)
+        V[i] = rplFlags[i];
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLDIL(const Instruction &) // F000 NNNN: LD I, long addr
+{
+    I = (memory[PC % MemorySize] << 8) | memory[(PC + 1) % MemorySize];
+    PC += 2;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opPLANE(const Instruction &in) // FN01: select drawing planes
+{
+    planeMask = in.x & ((1 << Planes) - 1);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSAVE(const Instruction &in) // 5XY2: save Vx..Vy to [I], I unchanged
+{
+    int step = in.x <= in.y ? 1 : -1;
+    for (int i = 0, r = in.x;; ++i, r += step)
+    {
+        memory[(I + i) % MemorySize] = V[r];
+        invalidateCode((I + i) % MemorySize);
+        if (r == in.y)
+            break;
+    }
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opLOAD(const Instruction &in) // 5XY3: load Vx..Vy from [I], I unchanged
+{
+    int step = in.x <= in.y ? 1 : -1;
+    for (int i = 0, r = in.x;; ++i, r += step)
+    {
+        V[r] = memory[(I + i) % MemorySize];
+        if (r == in.y)
+            break;
+    }
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opBGC(const Instruction &) // 02A0: step the background colour
+{
+    colour.background = (colour.background + 1) & 3;
+    dirtyRows = ~0ull;
+    drawFlag = true;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opADDN(const Instruction &in) // 5XY1: add Vy to Vx, each nibble carrying nothing
+{
+    const uint8_t vx = V[in.x], vy = V[in.y];
+    V[in.x] = static_cast<uint8_t>(((vx & 0xF0) + (vy & 0xF0)) & 0xF0) | ((vx + vy) & 0x0F);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opCOL(const Instruction &in) // BXYN: foreground colour Vy
+{
+    if constexpr (Quirks::colourZones)
+    {
+        const uint8_t ink = V[in.y] & 7;
+        const uint8_t across = V[in.x], down = V[(in.x + 1) & 0xF];
+        int left, columns, top, rows;
+        if (in.n == 0)
+        {
+            // BXY0: zones of 8x4 pixels, the low nibbles the first zone, the
+            // high ones how many more in each direction
+            left = across & 7;
+            columns = (across >> 4) + 1;
+            top = (down & 7) * 4;
+            rows = ((down >> 4) + 1) * 4;
+        }
+        else
+        {
+            // BXYN: N pixel rows from Vx+1 of the column of 8 holding Vx
+            left = (across % 64) / 8;
+            columns = 1;
+            top = down % 32;
+            rows = in.n;
+        }
+        for (int row = top; row < top + rows && row < 32; ++row)
+        {
+            for (int column = left; column < left + columns && column < 8; ++column)
+                colour.cells[row * 8 + column] = ink;
+            dirtyRows |= 1ull << row;
+        }
+        drawFlag = true;
+    }
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSKP2(const Instruction &) // EXF2: skip if key Vx is down on keypad 2
+{
+    // Never down, so never skips
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opSKNP2(const Instruction &) // EXF5: skip if key Vx is up on keypad 2
+{
+    skipIf(true);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::opIN(const Instruction &in) // FXFB: read the expansion port into Vx
+{
+    V[in.x] = 0;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+bool BasicChip8<MemorySize, Planes, Quirks>::runFrame(int instructions)
+{
+    const bool pending = drawFlag;
+    drawFlag = false;
+    emulateCycles(instructions);
+    decrementTimers();
+    const bool drew = drawFlag;
+    drawFlag = drew || pending;
+    return drew;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::presentFrame()
+{
+    if (clearedSincePresent)
+    {
+        front = cleared;
+        frontHires = clearedHires;
+    }
+    else
+    {
+        front = gfx;
+        frontHires = hires;
+    }
+    clearedSincePresent = false;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+bool BasicChip8<MemorySize, Planes, Quirks>::runVipFrame()
+{
+    const bool pending = drawFlag;
+    drawFlag = false;
+    emulateVipCycles(vipCyclesPerFrame - vipDisplayCycles);
+    decrementTimers();
+    const bool drew = drawFlag;
+    drawFlag = drew || pending;
+    return drew;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::decrementTimers()
+{
+    beepFlag = getSoundTimer() > 0; // On for every frame the sound timer was running
+    ++timerFrame;
+    vblank = true;
+    vipWaiting = false;
+
+    // Pin timers that ran out to now every so often, so the difference
+    // can't wrap round on a machine left running for years
+    if ((timerFrame & 0xFFFF) == 0)
+    {
+        if (getDelayTimer() == 0)
+            delayExpiry = timerFrame;
+        if (getSoundTimer() == 0)
+            soundExpiry = timerFrame;
+    }
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::reset()
+{
+    // Fonts and the loaded ROM. Restarting a ROM that didn't write over
+    // itself finds memory as it was, so the decoded code stays valid.
+    const std::array<uint8_t, MemorySize> &boot = bootMemory();
+    const size_t romStart = Quirks::loadAddress;
+    const size_t romEnd = romStart + romImage.size();
+    const bool same = std::memcmp(memory.data(), boot.data(), romStart) == 0 &&
+                      (romImage.empty() || std::memcmp(&memory[romStart], romImage.data(), romImage.size()) == 0) &&
+                      std::memcmp(&memory[romEnd], &boot[romEnd], MemorySize - romEnd) == 0;
+    if (!same)
+    {
+        memory = boot;
+        if (!romImage.empty())
+            std::memcpy(&memory[romStart], romImage.data(), romImage.size());
+        dirtyPages = ~0ull;
+        dropSprites();
+        predecoded.fill({});
+        fused.fill(FusedUnchecked);
+        redecode.fill(false);
+        if (jit)
+            jit->flush();
+        if (aot)
+            aot->flush();
+    }
+    V.fill(0);
+    gfx.fill(0);
+    keys.fill(false);
+    stack.fill(0);
+
+    I = 0;
+    PC = Quirks::loadAddress;
+    // HIRES ROMs jump into the 1802 code of their first page; running
+    // that patch gives the 64x64 screen, so go straight past it
+    if constexpr (Quirks::loresRows == 64)
+    {
+        if (romImage.size() > 2 && romImage[0] == 0x12 && romImage[1] == 0x60)
+            PC = 0x2C0;
+    }
+    sp = 0;
+    setDelayTimer(0);
+    setSoundTimer(0);
+    cycleCount = 0;
+    idleStats = {};
+    unknownOpcodes = {};
+    if (jit)
+        jit->dropOwed();
+    audioPattern.fill(0);
+    pitch = 64;
+    audioPatternLoaded = false;
+    hires = false;
+    rplFlags.fill(0);
+    planeMask = 1;
+    vblank = false;
+    drawWait = 0;
+    vipDebt = 0;
+    vipWaiting = false;
+    keyWaitReg = -1;
+    keyWaitKey = -1;
+    if constexpr (Quirks::colourZones)
+    {
+        colour.background = 0;
+        colour.cells.fill(7); // White, so monochrome programs look as they always did
+    }
+
+    drawFlag = true; // The cleared screen still has to be presented
+    clearedSincePresent = false;
+    dirtyRows = ~0ull;
+    beepFlag = false;
+#if defined(CHIP8_PROFILE)
+    profiler.restartCalls(nullptr, 0);
+#endif
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::seedRandom(uint64_t seed)
+{
+    // Standard PCG32 initialisation
+    rngState = 0;
+    nextRandom();
+    rngState += seed;
+    nextRandom();
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+uint8_t BasicChip8<MemorySize, Planes, Quirks>::nextRandom()
+{
+    // PCG32 XSH-RR: LCG step, output permuted from the old state
+    uint64_t old = rngState;
+    rngState = old * 6364136223846793005ull + 1442695040888963407ull;
+    uint32_t xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+    uint32_t rot = static_cast<uint32_t>(old >> 59);
+    uint32_t out = (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    return static_cast<uint8_t>(out >> 24);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::snapshot(Snapshot &out) const
+{
+    static_assert(std::is_trivially_copyable<State>::value && std::is_standard_layout<State>::value,
+                  "snapshots are plain copies");
+    static_assert(std::has_unique_object_representations<State>::value, "no padding, so equal states have equal bytes");
+    static_assert(offsetof(State, stack) % 64 == 0, "the scalars fill the first cache line and the stack starts a new one");
+    std::memcpy(&out, &state(), sizeof(State));
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::restore(const Snapshot &in)
+{
+    // Memory may hold different code now; run-ahead restores every frame
+    // and rarely changes any, so keep the decoded code when it is the same
+    uint64_t changed = 0;
+    for (size_t page = 0; page < hashPages; ++page)
+    {
+        const size_t at = page * hashPageBytes;
+        if (std::memcmp(&memory[at], &in.memory[at], hashPageBytes) != 0)
+            changed |= uint64_t(1) << page;
+    }
+    if (changed)
+    {
+        dirtyPages |= changed;
+        if (spritePages & changed)
+            dropSprites();
+        predecoded.fill({});
+        fused.fill(FusedUnchecked);
+        redecode.fill(false);
+        if (jit)
+            jit->flush();
+        if (aot)
+            aot->flush();
+    }
+    std::memcpy(static_cast<State *>(this), &in, sizeof(State));
+    if (jit)
+        jit->dropOwed(); // A restored state owes no turns
+
+    drawFlag = true;
+    dirtyRows = ~0ull;
+    beepFlag = getSoundTimer() > 0;
+#if defined(CHIP8_PROFILE)
+    restartProfileCalls();
+#endif
+}
+
+#if defined(CHIP8_PROFILE)
+// Each return address sits just past its 2NNN, which names the callee
+template <size_t MemorySize, int Planes, typename Quirks>
+void BasicChip8<MemorySize, Planes, Quirks>::restartProfileCalls()
+{
+    std::array<uint16_t, Chip8Profile::maxCallDepth> callees{};
+    const int depth = std::min({int(sp), static_cast<int>(callees.size()), stackDepth});
+    for (int i = 0; i < depth; ++i)
+    {
+        const uint16_t call = static_cast<uint16_t>(stack[i] - 2);
+        callees[i] = static_cast<uint16_t>(((memory[call % MemorySize] << 8) | memory[(call + 1) % MemorySize]) & 0x0FFF);
+    }
+    profiler.restartCalls(callees.data(), depth);
+}
+#endif
+
+template <size_t MemorySize, int Planes, typename Quirks>
+uint64_t BasicChip8<MemorySize, Planes, Quirks>::stateHash() const
+{
+    for (size_t page = 0; page < hashPages; ++page)
+    {
+        if ((dirtyPages >> page) & 1)
+            pageHashes[page] = simd::hashBytes(&memory[page * hashPageBytes], hashPageBytes, page);
+    }
+    dirtyPages = 0;
+
+    // Everything before memory, with the counters taken out
+    uint8_t head[offsetof(State, memory)];
+    std::memcpy(head, &state(), sizeof head);
+    const uint64_t noCycles = 0;
+    const uint32_t timers[3] = {0, getDelayTimer(), getSoundTimer()}; // timerFrame, delayExpiry, soundExpiry
+    static_assert(offsetof(State, delayExpiry) == offsetof(State, timerFrame) + 4 && offsetof(State, soundExpiry) == offsetof(State, timerFrame) + 8,
+                  "the timers follow each other");
+    std::memcpy(head + offsetof(State, cycleCount), &noCycles, sizeof noCycles);
+    std::memcpy(head + offsetof(State, timerFrame), timers, sizeof timers);
+    return simd::hashBytes(pageHashes.data(), sizeof pageHashes, simd::hashBytes(head, sizeof head));
+}
+
+namespace
+{
+    const char stateMagic[4] = {'C', '8', 'S', 'T'};
+    const uint16_t stateVersion = 4; // 2 added the RNG state, 3 the SCHIP screen and flags, 4 the FX0A halt
+
+    void putU16(std::vector<uint8_t> &out, uint16_t value)
+    {
+        out.push_back(value & 0xFF);
+        out.push_back(value >> 8);
+    }
+
+    void putU64(std::vector<uint8_t> &out, uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+            out.push_back((value >> (8 * i)) & 0xFF);
+    }
+
+    // Bounds-checked cursor over a state blob
+    struct StateReader
+    {
+        const uint8_t *data;
+        size_t size;
+        size_t pos = 0;
+
+        bool has(size_t count) const { return size - pos >= count; }
+        uint8_t u8() { return data[pos++]; }
+        uint16_t u16()
+        {
+            uint16_t value = data[pos] | (data[pos + 1] << 8);
+            pos += 2;
+            return value;
+        }
+        uint64_t u64()
+        {
+            uint64_t value = 0;
+            for (int i = 0; i < 8; ++i)
+                value |= static_cast<uint64_t>(data[pos + i]) << (8 * i);
+            pos += 8;
+            return value;
+        }
+    };
+
+    // Fixed payload sizes after the 6-byte header. Versions 1 and 2 only
+    // exist for the classic machine, later sizes follow the variant.
+    const size_t statePayloadV1 = 4096 + 32 * 8 + 16 + 16 * 2 + 16 + 2 + 2 + 5;
+    const size_t statePayloadV2 = statePayloadV1 + 8;
+
+    constexpr size_t statePayloadV3(size_t memorySize, int planes, int stackDepth)
+    {
+        return memorySize + 64 * 2 * planes * 8 + 16 + stackDepth * 2 + 16 + 2 + 2 + 5 + 8 + 16 + 1 + (planes > 1 ? 1 : 0);
+    }
+
+    // CHIP-8X adds its background and colour cells
+    constexpr size_t statePayloadV4(size_t memorySize, int planes, int stackDepth, bool colourZones)
+    {
+        return statePayloadV3(memorySize, planes, stackDepth) + 2 + (colourZones ? 1 + 8 * 32 : 0);
+    }
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+std::vector<uint8_t> BasicChip8<MemorySize, Planes, Quirks>::saveState() const
+{
+    CHIP8_ZONE("Snapshot save");
+    std::vector<uint8_t> out;
+    out.reserve(sizeof stateMagic + 2 + statePayloadV4(MemorySize, Planes, stackDepth, Quirks::colourZones));
+    out.insert(out.end(), stateMagic, stateMagic + sizeof stateMagic);
+    putU16(out, stateVersion);
+
+    out.insert(out.end(), memory.begin(), memory.end());
+    for (uint64_t row : gfx)
+        putU64(out, row);
+    out.insert(out.end(), V.begin(), V.end());
+    for (uint16_t entry : stack)
+        putU16(out, entry);
+    out.insert(out.end(), audioPattern.begin(), audioPattern.end());
+    putU16(out, I);
+    putU16(out, drawWait ? static_cast<uint16_t>(PC - 2) : PC); // A halted DXYN runs again, see loadState
+    out.push_back(sp);
+    out.push_back(getDelayTimer());
+    out.push_back(getSoundTimer());
+    out.push_back(pitch);
+    out.push_back(audioPatternLoaded ? 1 : 0);
+    putU64(out, rngState);
+    out.insert(out.end(), rplFlags.begin(), rplFlags.end());
+    out.push_back(hires ? 1 : 0);
+    if (Planes > 1)
+        out.push_back(planeMask);
+    out.push_back(static_cast<uint8_t>(keyWaitReg));
+    out.push_back(static_cast<uint8_t>(keyWaitKey));
+    if constexpr (Quirks::colourZones)
+    {
+        out.push_back(colour.background);
+        out.insert(out.end(), colour.cells.begin(), colour.cells.end());
+    }
+    return out;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+bool BasicChip8<MemorySize, Planes, Quirks>::loadState(const uint8_t *data, size_t size)
+{
+    CHIP8_ZONE("Snapshot load");
+    StateReader in{data, size};
+    if (!in.has(sizeof stateMagic + 2) || std::memcmp(data, stateMagic, sizeof stateMagic) != 0)
+        return false;
+    in.pos = sizeof stateMagic;
+    uint16_t version = in.u16();
+    if (version < 1 || version > stateVersion)
+        return false;
+    if (version < 3)
+    {
+        if (!std::is_same<BasicChip8, Chip8>::value || !in.has(version == 1 ? statePayloadV1 : statePayloadV2))
+            return false;
+    }
+    else if (size - in.pos != (version == 3 ? statePayloadV3(MemorySize, Planes, stackDepth)
+                                            : statePayloadV4(MemorySize, Planes, stackDepth, Quirks::colourZones)) ||
+             (Quirks::colourZones && version < 4))
+        return false; // Also rejects states of another variant, and CHIP-8X's are all version 4
+
+    // Decode into a snapshot first so a bad blob leaves the machine untouched
+    Snapshot s;
+    s.cycleCount = cycleCount;
+    for (uint8_t &byte : s.memory)
+        byte = in.u8();
+    s.gfx.fill(0);
+    if (version >= 3)
+    {
+        for (uint64_t &word : s.gfx)
+            word = in.u64();
+    }
+    else
+    {
+        for (int y = 0; y < 32; ++y) // One word per lo-res row
+            s.gfx[y * rowWords] = in.u64();
+    }
+    for (uint8_t &reg : s.V)
+        reg = in.u8();
+    for (uint16_t &entry : s.stack)
+        entry = in.u16();
+    for (uint8_t &byte : s.audioPattern)
+        byte = in.u8();
+    s.I = in.u16();
+    s.PC = in.u16();
+    s.sp = in.u8();
+    s.timerFrame = timerFrame; // Blobs hold the timers' values, the count carries on
+    s.delayExpiry = timerFrame + in.u8();
+    s.soundExpiry = timerFrame + in.u8();
+    s.pitch = in.u8();
+    s.audioPatternLoaded = in.u8() != 0;
+    s.rngState = version >= 2 ? in.u64() : rngState; // Older states keep the current generator
+    s.rplFlags.fill(0);
+    s.hires = false;
+    if (version >= 3)
+    {
+        for (uint8_t &flag : s.rplFlags)
+            flag = in.u8();
+        s.hires = in.u8() != 0;
+    }
+    s.planeMask = (Planes > 1 && version >= 3) ? in.u8() & ((1 << Planes) - 1) : 1;
+
+    // Older states rewound PC onto a waiting FX0A, which simply runs again,
+    // as a DXYN waiting for vblank still does
+    s.keyWaitReg = -1;
+    s.keyWaitKey = -1;
+    s.drawWait = 0;
+    if (version >= 4)
+    {
+        s.keyWaitReg = static_cast<int8_t>(in.u8());
+        s.keyWaitKey = static_cast<int8_t>(in.u8());
+        if (s.keyWaitReg > 15 || s.keyWaitKey > 15 || s.keyWaitReg < -1 || s.keyWaitKey < -1)
+            return false;
+    }
+    if constexpr (Quirks::colourZones)
+    {
+        s.colour.background = in.u8() & 3;
+        for (uint8_t &cell : s.colour.cells)
+            cell = in.u8() & 7;
+    }
+
+    restore(s);
+    return true;
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+bool BasicChip8<MemorySize, Planes, Quirks>::saveStateFile(const std::string &filename) const
+{
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    std::vector<uint8_t> state = saveState();
+    file.write(reinterpret_cast<const char *>(state.data()), state.size());
+    return static_cast<bool>(file);
+}
+
+template <size_t MemorySize, int Planes, typename Quirks>
+bool BasicChip8<MemorySize, Planes, Quirks>::loadStateFile(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    std::vector<uint8_t> state((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return loadState(state.data(), state.size());
+}
+
+template class BasicChip8<4096, 1, quirks::Legacy>;
+template class BasicChip8<4096, 1, quirks::CosmacVip>;
+template class BasicChip8<4096, 1, quirks::Chip48>;
+template class BasicChip8<4096, 1, quirks::SuperChip>;
+template class BasicChip8<0x10000, 2, quirks::XoChip>;
+template class BasicChip8<4096, 1, quirks::HiresVip>;
+template class BasicChip8<4096, 1, quirks::Chip8X>;
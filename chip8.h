@@ -2,52 +2,776 @@
 #define CHIP8_H
 
 #include <cstdint> // For uint8_t, uint16_t
+#include <cstddef> // For size_t
 #include <array>   // For std::array
 #include <string>  // For file loading
+#include <memory>  // For std::unique_ptr
+#include <vector>  // For serialized save states
 
-class Chip8
+#if __cplusplus >= 202002L && __has_include(<span>)
+#include <span> // For loading a ROM from a span
+#define CHIP8_HAS_SPAN 1
+#endif
+
+#if defined(CHIP8_PROFILE)
+#include "chip8_profile.h"
+#endif
+
+class Chip8Jit;
+class Chip8Aot;
+
+// Settings shared by every machine variant
+class Chip8Common
 {
 public:
-    Chip8();
-    ~Chip8();
+    // Interpreter core, picked at construction time
+    enum class Core
+    {
+        Switch,    // Nested switch decode on every cycle (reference)
+        Table,     // Common opcodes inline, the rest through a 64K-entry handler table
+        Predecoded, // Per-address cache of decoded instructions over memory
+        Jit,        // Native x86-64 basic blocks, table interpreter as fallback
+        Aot,        // ROMs translated to C++ by chip8-aot, table interpreter for the rest
+        Tiered      // Table, then predecoded, then Jit for each block as it gets hot
+    };
+};
+
+// Behaviours that differ between CHIP-8 interpreters. A profile is a
+// machine template argument, so each one compiles to its own handlers.
+namespace quirks
+{
+    // Where FX55/FX65 leave I
+    enum class IndexStep
+    {
+        PlusXPlusOne, // I += X + 1
+        PlusX,        // I += X
+        Unchanged
+    };
+
+    // What this emulator has always done
+    struct Legacy
+    {
+        static constexpr IndexStep loadStoreIndex = IndexStep::PlusXPlusOne;
+        static constexpr bool shiftUsesVy = false;      // 8XY6/8XYE shift Vy into Vx
+        static constexpr bool jumpUsesVx = false;       // BXNN jumps to XNN + Vx
+        static constexpr bool logicResetsVF = false;    // 8XY1/8XY2/8XY3 clear VF
+        static constexpr bool wrapSprites = false;      // Sprites wrap around the edges
+        static constexpr bool displayWait = false;      // DXYN waits for the next 60 Hz tick
+        static constexpr bool flagBeforeResult = false; // 8XY5/8XY6/8XY7/8XYE write VF before Vx, so VF as Vx loses the flag
+        static constexpr uint16_t loadAddress = 0x200;   // Where the ROM goes and PC starts
+        static constexpr int loresRows = 32;             // Height of the 64-pixel-wide screen
+        static constexpr bool colourZones = false;       // CHIP-8X colour opcodes (02A0, 5XY1, BXYN, EXF2, EXF5, FXF8, FXFB)
+        static constexpr int stackDepth = 16;            // Return addresses 2NNN keeps, a power of two; deeper calls wrap
+    };
+
+    struct CosmacVip : Legacy
+    {
+        static constexpr bool shiftUsesVy = true;
+        static constexpr bool logicResetsVF = true;
+        static constexpr bool displayWait = true;
+    };
+
+    struct Chip48 : Legacy
+    {
+        static constexpr IndexStep loadStoreIndex = IndexStep::PlusX;
+        static constexpr bool jumpUsesVx = true;
+    };
+
+    struct SuperChip : Legacy
+    {
+        static constexpr IndexStep loadStoreIndex = IndexStep::Unchanged;
+        static constexpr bool jumpUsesVx = true;
+    };
+
+    struct XoChip : Legacy
+    {
+        static constexpr bool shiftUsesVy = true;
+        static constexpr bool wrapSprites = true;
+    };
+
+    // Two-page HIRES CHIP-8 (1977): the VIP interpreter patched for a
+    // 64x64 screen. Its ROMs begin with 1260, a jump into the patch, and
+    // the program itself starts at 0x2C0; 0230 clears the screen.
+    struct HiresVip : CosmacVip
+    {
+        static constexpr int loresRows = 64;
+    };
+
+    // CHIP-8X (RCA, 1980): the VIP with the VP-590 colour board, its
+    // interpreter taking memory up to 0x300
+    struct Chip8X : CosmacVip
+    {
+        static constexpr uint16_t loadAddress = 0x300;
+        static constexpr bool colourZones = true;
+    };
+}
+
+// CHIP-8X colour, in the place of what would be a padding byte; other
+// machines keep only the byte, which stays 0
+template <bool ColourZones>
+struct Chip8Colour
+{
+    uint8_t background = 0;
+};
+
+template <>
+struct Chip8Colour<true>
+{
+    uint8_t background = 0; // 02A0 steps it through blue, black, green and red
+    // Foreground of each 8x1 pixel cell, 8 to a row: bit 0 red, 1 blue, 2 green
+    std::array<uint8_t, 8 * 32> cells{};
+};
+
+// Everything a program can observe or change, in one trivially copyable
+// block with no padding: taking, restoring or comparing a snapshot is one
+// memcpy or memcmp, and a hash can run over its bytes. The first 64 bytes
+// are every scalar, registers and timers first, so one cache line holds
+// what nearly every instruction touches and the JIT reaches it with
+// one-byte displacements. The stack starts the next line (after the colour
+// cells on CHIP-8X), then the flag arrays, screen and memory. BasicChip8 is
+// aligned to 64 bytes, so the block never shares a line with another
+// machine's. Input (the keys) and the GUI's flags are not part of it.
+template <size_t MemorySize, int Planes, int StackDepth = 16, bool ColourZones = false>
+struct Chip8State
+{
+    // Registers
+    std::array<uint8_t, 16> V{}; // V0-VF
+    uint16_t I = 0;              // Index
+    uint16_t PC = 0x200;         // Program counter
+    uint8_t sp = 0;              // Stack pointer
+
+    // FX0A halt, see BasicChip8::setKey
+    int8_t keyWaitReg = -1; // Vx receiving the key, -1 while running
+    int8_t keyWaitKey = -1; // Key pressed during the wait, -1 until one is
+
+    bool hires = false; // SUPER-CHIP 128x64 mode
+
+    // Timers, kept as the timer frame each runs out on rather than counted
+    // down, so a tick is one increment however the timers stand and
+    // nothing reads them until FX07, the buzzer or a snapshot asks
+    uint32_t timerFrame = 0;  // decrementTimers() calls so far
+    uint32_t delayExpiry = 0; // Delay timer reads delayExpiry - timerFrame, 0 once passed
+    uint32_t soundExpiry = 0;
+
+    uint16_t drawWait = 0; // DXYN halted until the next tick draws it (displayWait), 0 while running
+    uint8_t planeMask = 1; // Only XO-CHIP selects other planes
+    bool vblank = false;   // A timer tick happened since the last DXYN (displayWait)
+
+    uint64_t cycleCount = 0;
+    uint64_t rngState = 0; // PCG32 state, seeded in the constructor
+
+    // VIP timing, see BasicChip8::emulateVipCycles
+    int32_t vipDebt = 0;     // Machine cycles already spent from the next budget
+    bool vipWaiting = false; // A DXYN ran, nothing more until the timer tick
 
-    bool loadROM(const std::string &filename);
+    // XO-CHIP audio
+    bool audioPatternLoaded = false; // Until F002 runs the plain buzzer plays
+    uint8_t pitch = 64;              // 4000 Hz playback
+    Chip8Colour<ColourZones> colour; // CHIP-8X only, elsewhere the byte fills out the first line
+
+    std::array<uint16_t, StackDepth> stack{};
+
+    std::array<uint8_t, 16> audioPattern{};
+    std::array<uint8_t, 16> rplFlags{}; // SUPER-CHIP FX75/FX85 user flags
+
+    // Display planes, see BasicChip8::gfx
+    std::array<uint64_t, 64 * 2 * Planes> gfx{};
+
+    std::array<uint8_t, MemorySize> memory{};
+};
+
+// CHIP-8 machine with its address space, display bit planes and quirks
+// fixed at compile time. A 64 KB address space also enables the XO-CHIP
+// opcodes (F000 NNNN, FN01, 5XY2, 5XY3); the classic 4 KB, one-plane
+// machine compiles without any of it.
+template <size_t MemorySize, int Planes, typename Quirks>
+class alignas(64) BasicChip8 : public Chip8Common, private Chip8State<MemorySize, Planes, Quirks::stackDepth, Quirks::colourZones>
+{
+    static_assert(MemorySize == 4096 || MemorySize == 0x10000, "CHIP-8 or XO-CHIP address space");
+    static_assert(Planes >= 1 && Planes <= 4, "one to four display planes");
+    static_assert(Quirks::loresRows == 32 || Quirks::loresRows == 64, "64x32 or 64x64 lo-res screen");
+    static_assert(Quirks::stackDepth >= 4 && Quirks::stackDepth <= 256 && (Quirks::stackDepth & (Quirks::stackDepth - 1)) == 0,
+                  "the stack index is sp masked, and sp wraps at 256");
+    static_assert(!Quirks::colourZones || (MemorySize == 4096 && Quirks::loresRows == 32), "colour zones cover the VIP's 64x32 screen");
+
+public:
+    static constexpr size_t memorySize = MemorySize;
+    static constexpr int planes = Planes;
+    static constexpr bool xoChip = MemorySize > 4096;
+    static constexpr int stackDepth = Quirks::stackDepth;
+    using QuirkProfile = Quirks;
+
+    explicit BasicChip8(Core core = Core::Table);
+    ~BasicChip8();
+
+    bool loadROM(const std::string &filename); // Through the shared RomCache
+
+    // Copies into memory at the profile's Quirks::loadAddress (0x200, or
+    // 0x300 for CHIP-8X), no file involved. False, leaving the machine
+    // reset with no ROM, if it doesn't fit below memorySize.
+    bool loadROM(const uint8_t *data, size_t size);
+#if defined(CHIP8_HAS_SPAN)
+    bool loadROM(std::span<const uint8_t> rom) { return loadROM(rom.data(), rom.size()); }
+#endif
+
+    // Swaps in a rebuilt ROM of the same length without a reset: each byte
+    // that differs from the loaded ROM is written over memory, and its
+    // decoded code dropped, unless the program has changed it since. The
+    // registers, screen and timers carry on. False, changing nothing, if
+    // the length differs.
+    bool patchROM(const uint8_t *data, size_t size);
     void emulateCycle();
+    void emulateCycles(int count); // Lets the JIT run whole blocks
+    void runUntil(uint64_t cycle); // emulateCycles up to getCycleCount() == cycle
     void decrementTimers();
 
-    void reset();
+    // COSMAC VIP timing: runs instructions until budget machine cycles (8
+    // clocks of the 1.76 MHz CDP1802) are spent, each opcode charged about
+    // what the VIP interpreter takes. DXYN ends the frame, as the VIP draws
+    // after the display interrupt. Overshoot is taken from the next call.
+    void emulateVipCycles(int budget);
+    static constexpr int vipCyclesPerFrame = 3668; // 1760640 Hz / 8 / 60
+    static constexpr int vipDisplayCycles = 1832;  // Spent on display DMA and the interrupt routine
+
+    // One emulated frame: instructions turns (or a VIP frame's budget),
+    // then the 60 Hz timer tick. True if the frame drew or cleared
+    // anything; drawFlag is left set for the renderer either way.
+    bool runFrame(int instructions);
+    bool runVipFrame();
+
+    void reset(); // Back to power-on, with the loaded ROM in memory again
+
+    // Instructions executed since the last reset
+    uint64_t getCycleCount() const { return cycleCount; }
+
+    // Restart the CXNN generator from a fixed seed, for reproducible runs
+    void seedRandom(uint64_t seed);
+
+#if defined(CHIP8_PROFILE)
+    // Instruction counts and handler times since construction or the last
+    // resetProfile(). Profiled builds always interpret, the JIT is not used.
+    const Chip8Profile &getProfile() const { return profiler; }
+    void resetProfile() { profiler.reset(); }
+#endif
+
+    // Complete machine state, see Chip8State. Key state is input and not
+    // included.
+    using State = Chip8State<MemorySize, Planes, Quirks::stackDepth, Quirks::colourZones>;
+    using Snapshot = State;
+    const State &state() const { return *this; }
+
+    void snapshot(Snapshot &out) const;
+    void restore(const Snapshot &in);
+
+    // 64-bit hash of the state, equal for machines that run the same from
+    // here on: the instruction count and timer frame are left out and the
+    // timers go in by what they read. Memory is hashed in 64 pages, and
+    // only pages stored to since the last call are hashed again, so a
+    // frame's hash costs about the registers and screen.
+    uint64_t stateHash() const;
+
+    // Versioned little-endian binary save states
+    std::vector<uint8_t> saveState() const;
+    bool loadState(const uint8_t *data, size_t size); // False if the blob is not a valid state
+    bool saveStateFile(const std::string &filename) const;
+    bool loadStateFile(const std::string &filename);
+
+    // What memory below 0x200 boots as, both fonts in place, for
+    // machines that don't derive from this one
+    static const uint8_t *bootImage() { return bootMemory().data(); }
+
+    // Read-only machine state for debugging and headless tools
+    const std::array<uint8_t, MemorySize> &getMemory() const { return memory; }
+    size_t getRomSize() const { return romImage.size(); }
+    const std::array<uint8_t, 16> &getV() const { return V; }
+    const std::array<uint16_t, stackDepth> &getStack() const { return stack; }
+    uint16_t getI() const { return I; }
+    uint16_t getPC() const { return PC; }
+    uint8_t getSP() const { return sp; }
+    uint8_t getDelayTimer() const { return timerLeft(delayExpiry); }
+    uint8_t getSoundTimer() const { return timerLeft(soundExpiry); }
+
+    // Decodes the instruction at pc into the predecoded core's cache ahead
+    // of its first run, see Chip8Coverage::warm
+    void predecode(uint16_t pc)
+    {
+        if ((pc & 1) == 0)
+            decodedAt(pc);
+    }
+
+    // Self-modifying code: stores that hit decoded or compiled code, the
+    // cached entries or blocks they dropped, and how many of those were
+    // decoded or compiled again. Counts this core's cache only.
+    struct CodeCacheStats
+    {
+        uint64_t codeWrites = 0;
+        uint64_t invalidations = 0;
+        uint64_t recompiles = 0;
+    };
+    CodeCacheStats getCodeCacheStats() const;
+
+    // Instructions passed in busy-wait loops since reset(), by the kind of
+    // loop idleLoopAt found; over getCycleCount() that is the share of the
+    // emulated CPU's time spent waiting. Counted where the turns are
+    // skipped, so a busy program pays nothing for it. COSMAC VIP timing
+    // waits in machine cycles and isn't counted.
+    struct IdleStats
+    {
+        uint64_t keyWait = 0;     // FX0A halts
+        uint64_t timerPoll = 0;   // FX07 / 3X00 / 1NNN polling the delay timer
+        uint64_t selfJump = 0;    // 1NNN to itself
+        uint64_t displayWait = 0; // DXYN halted for the next tick (displayWait)
+        uint64_t total() const { return keyWait + timerPoll + selfJump + displayWait; }
+    };
+    const IdleStats &getIdleStats() const { return idleStats; }
+
+    // Opcodes this machine doesn't know, run as no-ops since reset(), and
+    // the latest of them with the address it was at
+    struct UnknownOpcodes
+    {
+        uint64_t count = 0;
+        uint16_t lastOpcode = 0;
+        uint16_t lastPC = 0;
+    };
+    const UnknownOpcodes &getUnknownOpcodes() const { return unknownOpcodes; }
+
+    // Core::Tiered: entries into a block start before its code runs
+    // predecoded, and before it is compiled. Blocks hot at once (0, 0)
+    // make it the Jit core; thresholds never reached keep it interpreted.
+    struct TierPolicy
+    {
+        uint32_t predecodeAfter = 4;
+        uint32_t compileAfter = 64;
+    };
+    void setTierPolicy(const TierPolicy &policy);
+
+    // Core::Jit and Core::Tiered: a compiled block longer than the turns
+    // left in a call still runs whole, and the turns it ran over come off
+    // the next call, so budgets are checked once per block. Frames then run
+    // up to a block long or short; off by default, as the differential
+    // tools compare exact budgets.
+    void setWholeBlocks(bool enabled);
 
-    // Display buffer (64x32, true = pixel on)
-    std::array<bool, 64 * 32> gfx{};
+    // A byte written from outside the program, by a cheat, as a store
+    // instruction would: code decoded or compiled from it is dropped
+    void pokeMemory(uint16_t addr, uint8_t value);
 
-    // Keyboard state (true = pressed)
+    // XO-CHIP audio: 128-bit sample pattern (F002) and playback pitch (FX3A)
+    const std::array<uint8_t, 16> &getAudioPattern() const { return audioPattern; }
+    uint8_t getPitch() const { return pitch; }
+    bool hasAudioPattern() const { return audioPatternLoaded; }
+
+    // Display buffer sized for SCHIP hi-res (128x64), two words per row,
+    // bit 63 of the first word = leftmost pixel. Lo-res (64x32) uses the
+    // first word of the top 32 rows only. Planes follow each other.
+    static constexpr int rowWords = 2;
+    static constexpr size_t planeWords = 64 * rowWords;
+    using State::gfx;
+
+    // Current resolution
+    bool isHires() const { return hires; }
+    int width() const { return hires ? 128 : 64; }
+    int height() const { return hires ? 64 : Quirks::loresRows; }
+
+    // True if the pixel at (x, y) is on in the given plane
+    bool pixel(int x, int y, int plane = 0) const
+    {
+        return (gfx[plane * planeWords + y * rowWords + (x >> 6)] >> (63 - (x & 63))) & 1;
+    }
+
+    // CHIP-8X: the colour a lit pixel at (x, y) shows, bit 0 red, 1 blue,
+    // 2 green (white elsewhere), and the colour unlit pixels show, 0-3 for
+    // blue, black, green and red
+    uint8_t foregroundAt(int x, int y) const
+    {
+        if constexpr (Quirks::colourZones)
+            return colour.cells[(y % 32) * 8 + (x % 64) / 8];
+        return 7;
+    }
+    uint8_t getBackground() const { return colour.background; }
+
+    // Planes selected by FN01 for drawing, clearing and scrolling
+    uint8_t getPlaneMask() const { return planeMask; }
+
+    // Keyboard state (true = pressed), read-only: change it with setKey
     std::array<bool, 16> keys{};
 
+    // Updates keys and wakes an FX0A wait, which like on the VIP halts
+    // until a key has gone down and come up again
+    void setKey(int key, bool pressed);
+    bool isWaitingForKey() const { return keyWaitReg >= 0; }
+
+    // Halted in a DXYN that waits for the next timer tick (displayWait)
+    bool isWaitingForDisplay() const { return Quirks::displayWait && drawWait != 0 && !vblank; }
+
+    // True if the program sits in an idle loop at PC, see idleLoopAt:
+    // running it longer only burns host time until keys or timers change
+    bool isIdle() const { return idleLoopAt(PC) != 0; }
+
+    // All 16 keys as bits (bit k = key k). setKeyMask replaces the state
+    // without waking FX0A, for putting back the keys that went with a
+    // snapshot; restore() leaves the keys alone.
+    uint16_t keyMask() const;
+    void setKeyMask(uint16_t mask);
+
+    // Input latency probe: the next EX9E/EXA1 that tests key, or FX0A
+    // ending on it, stores the cycle count in keyReadCycle(), -1 until
+    // then. The JIT and AOT cores count a block's cycles when it leaves.
+    void watchKeyRead(int key)
+    {
+        watchedKey = static_cast<int8_t>(key & 0xF);
+        keyReadAt = -1;
+    }
+    int64_t keyReadCycle() const { return keyReadAt; }
+
+    // Where presentFrame() takes the picture it copies to the front buffer
+    enum class PresentPoint
+    {
+        FrameEnd,   // The screen as the frame left it
+        BeforeClear // If 00E0 ran since the last present, the screen just before
+                    // the last one: a program that clears and redraws across a
+                    // frame boundary then never shows a half-drawn screen
+    };
+    void setPresentPoint(PresentPoint point) { presentPoint = point; }
+    PresentPoint getPresentPoint() const { return presentPoint; }
+
+    // The screen is double-buffered: gfx is the back buffer the program
+    // draws into, and presentFrame() copies the last complete picture to
+    // the front buffer between frames. Front ends read only the front
+    // buffer, so they never see a DXYN half done. Neither is part of
+    // State, the front buffer is output like drawFlag.
+    void presentFrame();
+    const std::array<uint64_t, 64 * 2 * Planes> &frontBuffer() const { return front; }
+    bool isFrontHires() const { return frontHires; }
+
     // Draw flag for main loop to know when to render
     bool drawFlag = false;
 
+    // Rows changed since the renderer last cleared this (bit y = row y)
+    uint64_t dirtyRows = 0;
+
     // Beep flag for sound
     bool beepFlag = false;
 
 private:
-    // Memory
-    std::array<uint8_t, 4096> memory{};
+    friend class Chip8Jit;
+    friend class Chip8Aot;
 
-    // Registers
-    std::array<uint8_t, 16> V{}; // V0-VF
-    uint16_t I = 0;              // Index
-    uint16_t PC = 0x200;         // Program counter
+    static constexpr size_t romLimit = MemorySize - Quirks::loadAddress;
+
+    // Opcode with its operand fields already extracted
+    struct Instruction
+    {
+        uint16_t opcode;
+        uint16_t nnn;
+        uint8_t x;
+        uint8_t y;
+        uint8_t n;
+        uint8_t nn;
+    };
+
+    using OpHandler = void (*)(BasicChip8 &, const Instruction &);
+
+    // Predecoded cache entry (handler == nullptr means not decoded yet)
+    struct DecodedOp
+    {
+        OpHandler handler;
+        Instruction in;
+    };
+
+    // Superinstruction starting at a predecoded entry
+    enum Fused : uint8_t
+    {
+        FusedUnchecked, // fuseAt hasn't looked at the entry yet
+        FusedNone,
+        FusedDrawAt,
+        FusedCountedLoop,
+        FusedLoadBlock
+    };
+
+    // Adapts a member handler to a plain function pointer for the table
+    template <void (BasicChip8::*Op)(const Instruction &)>
+    static void invoke(BasicChip8 &chip8, const Instruction &in) { (chip8.*Op)(in); }
+
+    static Instruction decode(uint16_t opcode);
+
+    // Predecoded entry for an even pc, decoded on first use
+    DecodedOp &decodedAt(uint16_t pc);
+
+    // Superinstructions for the predecoded core: common sequences found
+    // when their first instruction first runs, then executed by one
+    // handler calling the instruction handlers directly. Only
+    // emulateCycles uses them, and only with budget left for all of one.
+    // Each returns the instructions it ran, a skip can cut one short.
+    void fuseAt(uint16_t pc);
+    void unfuse(size_t index); // Entry index was written, forget it and what it's part of
+    int fusedDrawAt(const DecodedOp *ops);      // 6XNN 6YNN DXYN, a sprite at a constant position
+    int fusedCountedLoop(const DecodedOp *ops); // 7XNN 3XNN/4XNN 1NNN, the end of a counted loop
+    int fusedLoadBlock(const DecodedOp *ops);   // ANNN FX65, registers from a table
+    static OpHandler decodeHandler(uint16_t opcode);
+    static const std::array<OpHandler, 0x10000> &opTable();
+
+    // Instruction handlers
+    void opNOP(const Instruction &in);
+    void opUNKNOWN(const Instruction &in);
+    void opCLS(const Instruction &in);
+    void opRET(const Instruction &in);
+    void opJP(const Instruction &in);
+    void opCALL(const Instruction &in);
+    void opSEByte(const Instruction &in);
+    void opSNEByte(const Instruction &in);
+    void opSEReg(const Instruction &in);
+    void opLDByte(const Instruction &in);
+    void opADDByte(const Instruction &in);
+    void opLDReg(const Instruction &in);
+    void opOR(const Instruction &in);
+    void opAND(const Instruction &in);
+    void opXOR(const Instruction &in);
+    void opADDReg(const Instruction &in);
+    void opSUB(const Instruction &in);
+    void opSHR(const Instruction &in);
+    void opSUBN(const Instruction &in);
+    void opSHL(const Instruction &in);
+    void opSNEReg(const Instruction &in);
+    void opLDI(const Instruction &in);
+    void opJPV0(const Instruction &in);
+    void opRND(const Instruction &in);
+    void opDRW(const Instruction &in);
+    void opSKP(const Instruction &in);
+    void opSKNP(const Instruction &in);
+    void opLDVxDT(const Instruction &in);
+    void opLDVxK(const Instruction &in);
+    void opLDDTVx(const Instruction &in);
+    void opLDSTVx(const Instruction &in);
+    void opADDI(const Instruction &in);
+    void opLDF(const Instruction &in);
+    void opLDB(const Instruction &in);
+    void opLDIVx(const Instruction &in);
+    void opLDVxI(const Instruction &in);
+    void opAUDIO(const Instruction &in);
+    void opPITCH(const Instruction &in);
+
+    // SUPER-CHIP
+    void opSCD(const Instruction &in);
+    void opSCR(const Instruction &in);
+    void opSCL(const Instruction &in);
+    void opLOW(const Instruction &in);
+    void opHIGH(const Instruction &in);
+    void opLDHF(const Instruction &in);
+    void opLDRVx(const Instruction &in);
+    void opLDVxR(const Instruction &in);
+
+    // XO-CHIP
+    void opLDIL(const Instruction &in);
+    void opPLANE(const Instruction &in);
+    void opSAVE(const Instruction &in);
+    void opLOAD(const Instruction &in);
+
+    // CHIP-8X. There is no second keypad, so its keys are never down, and
+    // nothing on the expansion port.
+    void opBGC(const Instruction &in);   // 02A0 background colour
+    void opADDN(const Instruction &in);  // 5XY1 nibble-wise add
+    void opCOL(const Instruction &in);   // BXYN foreground colour
+    void opSKP2(const Instruction &in);  // EXF2
+    void opSKNP2(const Instruction &in); // EXF5
+    void opIN(const Instruction &in);    // FXFB
+
+    // DXYN into one plane from sprite data at addr, true on collision.
+    // In hi-res DXY0 draws 16x16.
+    bool drawLores(uint64_t *plane, uint16_t addr, const Instruction &in);
+    bool drawHires(uint64_t *plane, uint16_t addr, const Instruction &in);
 
-    // Stack
-    std::array<uint16_t, 16> stack{};
-    uint8_t sp = 0; // Stack pointer
+    // A lo-res sprite laid out in screen-row words as drawLores blits it
+    struct SpriteRows
+    {
+        uint16_t addr = 0;
+        uint8_t vx = 0;
+        uint8_t n = 0; // Rows, 0 while the entry is free
+        std::array<uint64_t, 16 * rowWords> words{};
+    };
 
-    // Timers
-    uint8_t delay_timer = 0;
-    uint8_t sound_timer = 0;
+    // The cached layout of the n-row sprite at addr drawn at column vx,
+    // built on a miss
+    const SpriteRows &loresSprite(uint16_t addr, uint8_t vx, uint8_t n);
+    void dropSprites();
 
-    // Helper to initialize font
-    void initFont();
+    // XOR sprite rows in from row vy, wrapping past the bottom; true on collision
+    bool blitRows(uint64_t *plane, const uint64_t *sprite, size_t rows, size_t vy, size_t screenRows);
+
+    // 8XYN stores: Vx first, VF last, so VF as Vx ends up with the flag
+    void setResult(uint8_t x, uint8_t result, uint8_t flag)
+    {
+        V[x] = result;
+        V[0xF] = flag;
+    }
+
+    // Skip the next instruction if cond, which is 4 bytes long for XO-CHIP
+    // F000 NNNN; PC arithmetic, no branch
+    void skipIf(bool cond);
+
+    // I after FX55/FX65 stored or loaded V0..Vx, per the quirk profile
+    void advanceIndex(uint8_t x);
+
+    // Next CXNN byte from the instance's PCG32 generator
+    uint8_t nextRandom();
+
+    // Drop cached decodes, superinstructions and compiled code covering a
+    // written address
+    void invalidateCode(uint16_t addr);
+
+    // Length in instructions of the idle loop starting at pc, 0 if none:
+    // the FX0A halt, the DXYN halt of displayWait, a jump to itself, or
+    // FX07 / 3X00 / 1NNN polling a running delay timer. Nothing in it
+    // changes state until keys or timers do, so whole turns can be skipped.
+    int idleLoopAt(uint16_t pc) const;
+
+    // Charges turns skipped in the idle loop idleLoopAt found, of length
+    // loop, to its kind in idleStats
+    void countIdle(int loop, int turns)
+    {
+        if (keyWaitReg >= 0)
+            idleStats.keyWait += turns;
+        else if (Quirks::displayWait && drawWait && !vblank)
+            idleStats.displayWait += turns;
+        else if (loop == 1)
+            idleStats.selfJump += turns;
+        else
+            idleStats.timerPoll += turns;
+    }
+
+    // The table core's loop for emulateCycles, see chip8.cpp. Returns the
+    // turns run, fewer than count if the machine halted.
+    int runInline(int count);
+
+    // One predecoded entry at an even PC, or the superinstruction starting
+    // there if budget has room for all of it. Returns the turns run.
+    int stepDecoded(int budget);
+
+    // Core::Tiered's interpreted tiers: runs up to limit instructions, the
+    // predecoded way or the table way, until one moves PC anywhere but
+    // on or the machine halts. Returns the turns run.
+    int runStraight(int limit, bool decoded);
+
+    Core core;
+
+    // Machine state, see Chip8State
+    using State::memory;
+    using State::V;
+    using State::I;
+    using State::PC;
+    using State::stack;
+    using State::sp;
+    using State::timerFrame;
+    using State::delayExpiry;
+    using State::soundExpiry;
+    using State::audioPattern;
+    using State::pitch;
+    using State::audioPatternLoaded;
+    using State::hires;
+    using State::rplFlags;
+    using State::planeMask;
+    using State::vblank;
+    using State::drawWait;
+    using State::keyWaitReg;
+    using State::keyWaitKey;
+    using State::vipDebt;
+    using State::vipWaiting;
+    using State::cycleCount;
+    using State::rngState;
+    using State::colour;
+
+    // One decoded entry per even address (odd PCs use the table)
+    std::array<DecodedOp, MemorySize / 2> predecoded{};
+    std::array<Fused, MemorySize / 2> fused{};  // Fused kind per predecoded entry
+    std::array<bool, MemorySize / 2> redecode{}; // Entry dropped by a store, not decoded since
+    CodeCacheStats decodeStats;
+
+    // See presentFrame; cleared is the screen before the last 00E0, kept
+    // only with PresentPoint::BeforeClear
+    PresentPoint presentPoint = PresentPoint::FrameEnd;
+    std::array<uint64_t, 64 * 2 * Planes> front{};
+    std::array<uint64_t, 64 * 2 * Planes> cleared{};
+    bool frontHires = false;
+    bool clearedHires = false;
+    bool clearedSincePresent = false;
+    IdleStats idleStats;
+    UnknownOpcodes unknownOpcodes;
+
+    // Lo-res sprites by address, column and height: font digits and game
+    // sprites are redrawn at the same x over and over, and then DXYN is
+    // only the XOR of ready words. All are dropped when a store hits one
+    // of the hash pages they were read from.
+    std::array<SpriteRows, 64> spriteCache{};
+    uint64_t spritePages = 0;
+
+    // stateHash's page hashes, and the pages written since they were taken
+    static constexpr size_t hashPages = 64;
+    static constexpr size_t hashPageBytes = MemorySize / hashPages;
+    mutable std::array<uint64_t, hashPages> pageHashes{};
+    mutable uint64_t dirtyPages = ~0ull;
+
+    // Recompiler, only created for Core::Jit and Core::Tiered on the
+    // classic machine
+    std::unique_ptr<Chip8Jit> jit;
+
+    // Translated ROMs, only created for Core::Aot on the classic machine
+    std::unique_ptr<Chip8Aot> aot;
+
+    uint8_t timerLeft(uint32_t expiry) const
+    {
+        const int32_t left = static_cast<int32_t>(expiry - timerFrame);
+        return left > 0 ? static_cast<uint8_t>(left) : 0;
+    }
+    void setDelayTimer(uint8_t value) { delayExpiry = timerFrame + value; }
+    void setSoundTimer(uint8_t value) { soundExpiry = timerFrame + value; }
+
+    bool idleCheck = false; // Set by backward jumps and waits, emulateCycles looks for an idle loop
+
+    // See watchKeyRead
+    int8_t watchedKey = -1;
+    int64_t keyReadAt = -1;
+    void noteKeyRead()
+    {
+        keyReadAt = static_cast<int64_t>(cycleCount);
+        watchedKey = -1;
+    }
+
+    // VIP timing, see emulateVipCycles
+    static int vipCost(uint16_t opcode);
+
+#if defined(CHIP8_PROFILE)
+    Chip8Profile profiler{MemorySize};
+
+    // Points the profiler's call path at the subroutines on the stack
+    void restartProfileCalls();
+#endif
+
+    // Zeroed memory with both fonts in place
+    static const std::array<uint8_t, MemorySize> &bootMemory();
+    std::vector<uint8_t> romImage; // What reset() puts back at Quirks::loadAddress
 };
 
+// The classic 64x32/128x64 machine every front end uses
+using Chip8 = BasicChip8<4096, 1, quirks::Legacy>;
+
+// The same machine with the quirks of a specific interpreter
+using VipChip8 = BasicChip8<4096, 1, quirks::CosmacVip>;
+using Chip48 = BasicChip8<4096, 1, quirks::Chip48>;
+using SuperChip8 = BasicChip8<4096, 1, quirks::SuperChip>;
+
+// XO-CHIP: 64 KB of memory and two bit planes
+using XoChip8 = BasicChip8<0x10000, 2, quirks::XoChip>;
+
+// The VIP's own variants: a 64x64 screen, and colour zones
+using HiresChip8 = BasicChip8<4096, 1, quirks::HiresVip>;
+using Chip8X = BasicChip8<4096, 1, quirks::Chip8X>;
+
+extern template class BasicChip8<4096, 1, quirks::Legacy>;
+extern template class BasicChip8<4096, 1, quirks::CosmacVip>;
+extern template class BasicChip8<4096, 1, quirks::Chip48>;
+extern template class BasicChip8<4096, 1, quirks::SuperChip>;
+extern template class BasicChip8<0x10000, 2, quirks::XoChip>;
+extern template class BasicChip8<4096, 1, quirks::HiresVip>;
+extern template class BasicChip8<4096, 1, quirks::Chip8X>;
+
 #endif
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "chip8_aot.h"
+#include "chip8.h"
+#include <cstring> // For std::memcmp
+
+namespace
+{
+    // Filled during static initialization, only read afterwards
+    std::vector<const Chip8Aot::Program *> &programs()
+    {
+        static std::vector<const Chip8Aot::Program *> list;
+        return list;
+    }
+}
+
+Chip8Aot::Registration::Registration(const Program &program)
+{
+    programs().push_back(&program);
+}
+
+const Chip8Aot::Program *Chip8Aot::find(const uint8_t *rom, size_t size)
+{
+    for (const Program *program : programs())
+    {
+        if (program->romSize == size && std::memcmp(program->rom, rom, size) == 0)
+            return program;
+    }
+    return nullptr;
+}
+
+Chip8Aot::Chip8Aot(Chip8 &chip8Ref)
+    : V(chip8Ref.V.data()), I(chip8Ref.I), PC(chip8Ref.PC), timerFrame(chip8Ref.timerFrame),
+      delayExpiry(chip8Ref.delayExpiry), soundExpiry(chip8Ref.soundExpiry), chip8(chip8Ref)
+{
+    blockAt.fill(-1);
+}
+
+void Chip8Aot::select(const uint8_t *rom, size_t size)
+{
+    program = find(rom, size);
+    blockAt.fill(-1);
+    covered.fill(false);
+    valid.assign(program ? program->blockCount : 0, false);
+    checked = false;
+    if (!program)
+        return;
+    for (size_t i = 0; i < program->blockCount; ++i)
+    {
+        const Block &block = program->blocks[i];
+        blockAt[block.start] = static_cast<int32_t>(i);
+        for (size_t a = block.start; a < block.end; ++a)
+            covered[a] = true;
+    }
+}
+
+int Chip8Aot::run(int count)
+{
+    if (!checked)
+        check();
+
+    int executed = 0;
+    while (executed < count)
+    {
+        // Halted in FX0A, nothing runs until a key wakes it
+        if (chip8.keyWaitReg >= 0)
+        {
+            chip8.countIdle(1, count - executed);
+            return count;
+        }
+
+        uint16_t pc = chip8.PC;
+        int32_t idx = pc < 4096 ? blockAt[pc] : -1;
+        if (idx >= 0 && !valid[idx])
+            idx = -1;
+
+        // Skip whole turns of an idle loop, as the interpreter does
+        if (idx >= 0 && program->blocks[idx].idleCandidate)
+        {
+            if (int loop = chip8.idleLoopAt(pc))
+            {
+                const int skip = (count - executed) / loop * loop;
+                executed += skip;
+                chip8.countIdle(loop, skip);
+                if (executed == count)
+                    break;
+            }
+        }
+
+        // Blocks run to completion, so finish a too-short budget one by one
+        if (idx < 0 || program->blocks[idx].length > count - executed)
+        {
+            chip8.emulateCycle();
+            ++executed;
+            continue;
+        }
+
+        written = false;
+        executed += program->blocks[idx].fn(*this);
+    }
+    return executed;
+}
+
+void Chip8Aot::invalidate(uint16_t addr)
+{
+    addr &= 0xFFF; // Stores wrap around memory
+    if (!program || !covered[addr])
+        return;
+    written = true;
+    ++writes;
+    for (size_t i = 0; i < program->blockCount; ++i)
+    {
+        const Block &block = program->blocks[i];
+        if (block.start > addr)
+            break;
+        if (addr < block.end && valid[i])
+        {
+            valid[i] = false;
+            ++dropped;
+        }
+    }
+}
+
+void Chip8Aot::op(uint16_t opcode, uint16_t next)
+{
+    PC = next;
+    Chip8::opTable()[opcode](chip8, Chip8::decode(opcode));
+}
+
+void Chip8Aot::check()
+{
+    const auto &memory = chip8.memory;
+    for (size_t i = 0; i < valid.size(); ++i)
+    {
+        const Block &block = program->blocks[i];
+        valid[i] = std::memcmp(&memory[block.start], &program->rom[block.start - 0x200], block.end - block.start) == 0;
+    }
+    checked = true;
+}
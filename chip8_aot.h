@@ -0,0 +1,109 @@
+#ifndef CHIP8_AOT_H
+#define CHIP8_AOT_H
+
+#include <cstdint> // For uint8_t, uint16_t
+#include <cstddef> // For size_t
+#include <array>   // For std::array
+#include <vector>  // For the block states
+
+namespace quirks
+{
+    struct Legacy;
+}
+template <size_t MemorySize, int Planes, typename Quirks>
+class BasicChip8;
+using Chip8 = BasicChip8<4096, 1, quirks::Legacy>;
+
+// Runs ROMs that chip8-aot translated to C++ ahead of time and that were
+// compiled into the program, for hosts that can't run the JIT because they
+// forbid writable executable memory. Each basic block of the ROM's static
+// control-flow graph is a C++ function. Code the graph didn't find (BNNN
+// targets) and blocks whose bytes no longer match the ROM, because it
+// wrote over them, go through the interpreter.
+class Chip8Aot
+{
+public:
+    using BlockFn = int (*)(Chip8Aot &); // Returns the instructions it executed
+
+    struct Block
+    {
+        uint16_t start;
+        uint16_t end;       // One past the last byte
+        uint16_t length;    // Instructions in the block
+        bool idleCandidate; // First opcode could start an idle loop
+        BlockFn fn;
+    };
+
+    // One translated ROM, the image it was translated from included
+    struct Program
+    {
+        const char *name;
+        const uint8_t *rom;
+        size_t romSize;
+        const Block *blocks; // Sorted by start
+        size_t blockCount;
+    };
+
+    // A generated file adds its program with a static one of these
+    struct Registration
+    {
+        explicit Registration(const Program &program);
+    };
+
+    // The linked-in program translated from exactly this ROM, or nullptr
+    static const Program *find(const uint8_t *rom, size_t size);
+
+    explicit Chip8Aot(Chip8 &chip8Ref);
+
+    Chip8Aot(const Chip8Aot &) = delete;
+    Chip8Aot &operator=(const Chip8Aot &) = delete;
+
+    // Called with each loaded ROM; without a program for it run() isn't used
+    void select(const uint8_t *rom, size_t size);
+    bool hasProgram() const { return program != nullptr; }
+
+    // Run up to count instructions, returns how many were executed
+    int run(int count);
+
+    // Memory write hook: blocks covering addr go back to the interpreter
+    void invalidate(uint16_t addr);
+
+    // Memory may have changed anywhere, compare every block again
+    void flush() { checked = false; }
+
+    // Stores that hit translated code, and blocks they sent back
+    uint64_t codeWrites() const { return writes; }
+    uint64_t invalidations() const { return dropped; }
+
+    // Used by translated code: the machine's registers, and the interpreter
+    // handler for what has no inline translation, run with PC at next
+    uint8_t *const V;
+    uint16_t &I;
+    uint16_t &PC;
+    uint8_t delay() const
+    {
+        const int32_t left = static_cast<int32_t>(delayExpiry - timerFrame);
+        return left > 0 ? static_cast<uint8_t>(left) : 0;
+    }
+    void setDelay(uint8_t value) { delayExpiry = timerFrame + value; }
+    void setSound(uint8_t value) { soundExpiry = timerFrame + value; }
+    const uint32_t &timerFrame; // The machine's timers, see Chip8::timerFrame
+    uint32_t &delayExpiry;
+    uint32_t &soundExpiry;
+    bool written = false; // A store hit translated code, the block must leave
+    void op(uint16_t opcode, uint16_t next);
+
+private:
+    void check();
+
+    Chip8 &chip8;
+    const Program *program = nullptr;
+    std::array<int32_t, 4096> blockAt{}; // Block index by start PC, -1 if none
+    std::array<bool, 4096> covered{};    // Memory bytes some block was translated from
+    std::vector<bool> valid;             // Per block: its bytes still match the ROM
+    bool checked = false;                // valid is up to date
+    uint64_t writes = 0;
+    uint64_t dropped = 0;
+};
+
+#endif
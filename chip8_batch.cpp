@@ -0,0 +1,847 @@
+#include "chip8_batch.h"
+#include "chip8.h"
+#include "chip8_simd.h"
+#include <algorithm> // For std::min, std::fill
+#include <cstring>   // For std::memcpy
+#include <memory>    // For the boot machine
+
+namespace
+{
+    // Chip8's PCG32 XSH-RR, so seeded lanes draw the same CXNN bytes
+    uint8_t nextRandom(uint64_t &state)
+    {
+        uint64_t old = state;
+        state = old * 6364136223846793005ull + 1442695040888963407ull;
+        uint32_t xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+        uint32_t rot = static_cast<uint32_t>(old >> 59);
+        uint32_t out = (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+        return static_cast<uint8_t>(out >> 24);
+    }
+}
+
+Chip8Batch::Chip8Batch(size_t lanes)
+{
+    loadROM(nullptr, 0);
+    resize(lanes);
+}
+
+void Chip8Batch::resize(size_t lanes)
+{
+    size_t old = size();
+    for (size_t lane = lanes; lane < old; ++lane)
+        freeLanePages(lane); // Dropped lanes' hi-res screens stay pooled
+    for (std::vector<uint8_t> &reg : v)
+        reg.resize(lanes);
+    pc.resize(lanes);
+    index.resize(lanes);
+    keys.resize(lanes);
+    sp.resize(lanes);
+    delayTimer.resize(lanes);
+    soundTimer.resize(lanes);
+    hiresOn.resize(lanes);
+    keyWaitReg.resize(lanes);
+    keyWaitKey.resize(lanes);
+    rngState.resize(lanes);
+    stacks.resize(lanes);
+    rplFlags.resize(lanes);
+    screens.resize(lanes);
+    hiresScreen.resize(lanes, noScreen);
+    pageTables.resize(lanes); // All zero, which reset() takes as shared
+    for (size_t lane = old; lane < lanes; ++lane)
+    {
+        reset(lane);
+        seedRandom(lane, lane);
+    }
+}
+
+bool Chip8Batch::loadROM(const uint8_t *data, size_t size)
+{
+    // Chip8 lays out the fonts and the program, the lanes share the result
+    std::unique_ptr<Chip8> boot = std::make_unique<Chip8>();
+    if (!boot->loadROM(data, size))
+        return false;
+    for (size_t lane = 0; lane < this->size(); ++lane)
+        freeLanePages(lane);
+    pages.assign(pageCount, Page());
+    freePages.clear();
+    for (int p = 0; p < pageCount; ++p)
+        std::memcpy(pages[p].data(), &boot->getMemory()[p * pageSize], pageSize);
+    for (size_t lane = 0; lane < this->size(); ++lane)
+        reset(lane);
+    return true;
+}
+
+void Chip8Batch::freeLanePages(size_t lane)
+{
+    for (int p = 0; p < pageCount; ++p)
+    {
+        uint32_t &page = pageTables[lane][p];
+        if (page >= static_cast<uint32_t>(pageCount))
+            freePages.push_back(page);
+        page = static_cast<uint32_t>(p);
+    }
+}
+
+void Chip8Batch::reset(size_t lane)
+{
+    freeLanePages(lane);
+    for (std::vector<uint8_t> &reg : v)
+        reg[lane] = 0;
+    pc[lane] = 0x200;
+    index[lane] = 0;
+    keys[lane] = 0;
+    sp[lane] = 0;
+    delayTimer[lane] = 0;
+    soundTimer[lane] = 0;
+    hiresOn[lane] = 0;
+    keyWaitReg[lane] = -1;
+    keyWaitKey[lane] = -1;
+    stacks[lane].fill(0);
+    rplFlags[lane].fill(0);
+    screens[lane].fill(0);
+    if (hiresScreen[lane] != noScreen)
+        hiresScreens[hiresScreen[lane]].fill(0);
+}
+
+void Chip8Batch::seedRandom(size_t lane, uint64_t seed)
+{
+    uint64_t &state = rngState[lane];
+    state = 0;
+    nextRandom(state);
+    state += seed;
+    nextRandom(state);
+}
+
+void Chip8Batch::setKey(size_t lane, int key, bool pressed)
+{
+    key &= 0xF;
+    uint16_t bit = static_cast<uint16_t>(1u << key);
+    bool wasDown = (keys[lane] & bit) != 0;
+    keys[lane] = pressed ? (keys[lane] | bit) : (keys[lane] & ~bit);
+    if (keyWaitReg[lane] < 0)
+        return;
+    if (pressed && !wasDown && keyWaitKey[lane] < 0)
+    {
+        keyWaitKey[lane] = static_cast<int8_t>(key);
+    }
+    else if (!pressed && key == keyWaitKey[lane])
+    {
+        v[keyWaitReg[lane]][lane] = static_cast<uint8_t>(key);
+        keyWaitReg[lane] = -1;
+        keyWaitKey[lane] = -1;
+    }
+}
+
+void Chip8Batch::write(size_t lane, uint16_t addr, uint8_t value)
+{
+    uint32_t &page = pageTables[lane][(addr >> 8) & (pageCount - 1)];
+    if (page < static_cast<uint32_t>(pageCount))
+    {
+        // First write to a shared page: give the lane its own copy
+        Page copy = pages[page];
+        if (freePages.empty())
+        {
+            page = static_cast<uint32_t>(pages.size());
+            pages.push_back(copy);
+        }
+        else
+        {
+            page = freePages.back();
+            freePages.pop_back();
+            pages[page] = copy;
+        }
+    }
+    pages[page][addr & (pageSize - 1)] = value;
+}
+
+uint64_t *Chip8Batch::hiresFor(size_t lane)
+{
+    if (hiresScreen[lane] == noScreen)
+    {
+        hiresScreen[lane] = static_cast<uint32_t>(hiresScreens.size());
+        hiresScreens.push_back(HiresScreen());
+    }
+    return hiresScreens[hiresScreen[lane]].data();
+}
+
+Chip8Batch::Registers Chip8Batch::load(size_t lane) const
+{
+    Registers r;
+    for (int x = 0; x < 16; ++x)
+        r.V[x] = v[x][lane];
+    r.PC = pc[lane];
+    r.I = index[lane];
+    r.keys = keys[lane];
+    r.sp = sp[lane];
+    r.delayTimer = delayTimer[lane];
+    r.soundTimer = soundTimer[lane];
+    r.hires = hiresOn[lane] != 0;
+    r.keyWaitReg = keyWaitReg[lane];
+    r.keyWaitKey = keyWaitKey[lane];
+    r.rngState = rngState[lane];
+    return r;
+}
+
+void Chip8Batch::store(size_t lane, const Registers &r)
+{
+    for (int x = 0; x < 16; ++x)
+        v[x][lane] = r.V[x];
+    pc[lane] = r.PC;
+    index[lane] = r.I;
+    keys[lane] = r.keys;
+    sp[lane] = r.sp;
+    delayTimer[lane] = r.delayTimer;
+    soundTimer[lane] = r.soundTimer;
+    hiresOn[lane] = r.hires ? 1 : 0;
+    keyWaitReg[lane] = r.keyWaitReg;
+    keyWaitKey[lane] = r.keyWaitKey;
+    rngState[lane] = r.rngState;
+}
+
+bool Chip8Batch::draw(size_t lane, uint8_t vx, uint8_t vy, uint16_t addr, unsigned n, uint64_t *hires)
+{
+    auto mem = [this, lane](unsigned at)
+    { return read(lane, static_cast<uint16_t>(at & 0xFFF)); };
+    if (!hires)
+    {
+        // As Chip8::drawLores: columns past 63 and rows past 31 are clipped
+        unsigned px = vx % 64;
+        unsigned py = vy % 32;
+        std::array<uint64_t, 16> sprite{};
+        for (unsigned row = 0; row < n; ++row)
+            sprite[row] = (static_cast<uint64_t>(mem(addr + row)) << 56) >> px;
+        unsigned rows = std::min(n, 32 - py);
+        return simd::xorBlit(screens[lane].data() + py, sprite.data(), rows);
+    }
+
+    unsigned px = vx % 128;
+    unsigned py = vy % 64;
+    bool wide = n == 0; // 16x16
+    unsigned rows = std::min(wide ? 16u : n, 64 - py);
+    unsigned word = px >> 6;
+    unsigned shift = px & 63;
+    std::array<uint64_t, 32> sprite{};
+    for (unsigned row = 0; row < rows; ++row)
+    {
+        uint64_t line = wide ? (static_cast<uint64_t>(mem(addr + 2 * row)) << 56) |
+                                   (static_cast<uint64_t>(mem(addr + 2 * row + 1)) << 48)
+                             : static_cast<uint64_t>(mem(addr + row)) << 56;
+        sprite[row * 2 + word] = line >> shift;
+        if (shift && word == 0)
+            sprite[row * 2 + 1] = line << (64 - shift);
+    }
+    return simd::xorBlit(hires + py * 2, sprite.data(), rows * 2);
+}
+
+void Chip8Batch::run(size_t lane, int count)
+{
+    Registers r = load(lane);
+    uint64_t *hires = r.hires ? hiresFor(lane) : nullptr;
+    for (int n = 0; n < count && r.keyWaitReg < 0; ++n)
+    {
+        uint16_t opcode = fetch(lane, r.PC);
+        r.PC += 2;
+        execute(lane, r, opcode, hires);
+    }
+    store(lane, r);
+}
+
+void Chip8Batch::execute(size_t lane, Registers &r, uint16_t opcode, uint64_t *&hires)
+{
+    // The same instructions as Chip8's handlers, PC already past the
+    // opcode. Addresses wrap at 4 KB and the stack at 16 entries.
+    uint16_t *stack = stacks[lane].data();
+    uint64_t *lores = screens[lane].data();
+    auto mem = [this, lane](unsigned addr)
+    { return read(lane, static_cast<uint16_t>(addr & 0xFFF)); };
+    const uint8_t x = (opcode >> 8) & 0xF;
+    const uint8_t y = (opcode >> 4) & 0xF;
+    const uint8_t nn = opcode & 0xFF;
+    const uint16_t nnn = opcode & 0xFFF;
+    uint8_t &vx = r.V[x];
+    const uint8_t vy = r.V[y];
+
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        if (opcode == 0x00E0)
+        {
+            std::fill(lores, lores + 32, 0);
+            if (hires)
+                std::fill(hires, hires + 128, 0);
+        }
+        else if (opcode == 0x00EE)
+            r.PC = stack[--r.sp & 15];
+        else if ((opcode & 0xFFF0) == 0x00C0) // Scroll down N rows
+        {
+            unsigned rows = opcode & 0xF;
+            if (r.hires)
+            {
+                std::copy_backward(hires, hires + (64 - rows) * 2, hires + 128);
+                std::fill(hires, hires + rows * 2, 0);
+            }
+            else
+            {
+                std::copy_backward(lores, lores + (32 - rows), lores + 32);
+                std::fill(lores, lores + rows, 0);
+            }
+        }
+        else if (opcode == 0x00FB) // Scroll right 4
+        {
+            if (r.hires)
+            {
+                for (int row = 0; row < 64; ++row)
+                {
+                    hires[row * 2 + 1] = (hires[row * 2 + 1] >> 4) | (hires[row * 2] << 60);
+                    hires[row * 2] >>= 4;
+                }
+            }
+            else
+            {
+                for (int row = 0; row < 32; ++row)
+                    lores[row] >>= 4;
+            }
+        }
+        else if (opcode == 0x00FC) // Scroll left 4
+        {
+            if (r.hires)
+            {
+                for (int row = 0; row < 64; ++row)
+                {
+                    hires[row * 2] = (hires[row * 2] << 4) | (hires[row * 2 + 1] >> 60);
+                    hires[row * 2 + 1] <<= 4;
+                }
+            }
+            else
+            {
+                for (int row = 0; row < 32; ++row)
+                    lores[row] <<= 4;
+            }
+        }
+        else if (opcode == 0x00FE || opcode == 0x00FF) // Resolution change clears the screen
+        {
+            r.hires = opcode == 0x00FF;
+            std::fill(lores, lores + 32, 0);
+            if (r.hires || hires)
+            {
+                hires = hiresFor(lane);
+                std::fill(hires, hires + 128, 0);
+            }
+        }
+        break;
+    case 0x1:
+        r.PC = nnn;
+        break;
+    case 0x2:
+        stack[r.sp++ & 15] = r.PC;
+        r.PC = nnn;
+        break;
+    case 0x3:
+        r.PC += (vx == nn) << 1;
+        break;
+    case 0x4:
+        r.PC += (vx != nn) << 1;
+        break;
+    case 0x5:
+        r.PC += (vx == vy) << 1;
+        break;
+    case 0x6:
+        vx = nn;
+        break;
+    case 0x7:
+        vx += nn;
+        break;
+    case 0x8:
+        switch (opcode & 0xF)
+        {
+        case 0x0:
+            vx = vy;
+            break;
+        case 0x1:
+            vx |= vy;
+            break;
+        case 0x2:
+            vx &= vy;
+            break;
+        case 0x3:
+            vx ^= vy;
+            break;
+        case 0x4:
+        {
+            unsigned sum = vx + vy;
+            vx = sum & 0xFF;
+            r.V[0xF] = sum > 0xFF ? 1 : 0;
+            break;
+        }
+        case 0x5:
+        {
+            const uint8_t flag = vx >= vy ? 1 : 0;
+            vx -= vy;
+            r.V[0xF] = flag; // Last, VF may be Vx
+            break;
+        }
+        case 0x6:
+        {
+            const uint8_t flag = vx & 1;
+            vx >>= 1;
+            r.V[0xF] = flag;
+            break;
+        }
+        case 0x7:
+        {
+            const uint8_t flag = vy >= vx ? 1 : 0;
+            vx = vy - vx;
+            r.V[0xF] = flag;
+            break;
+        }
+        case 0xE:
+        {
+            const uint8_t flag = vx >> 7;
+            vx <<= 1;
+            r.V[0xF] = flag;
+            break;
+        }
+        }
+        break;
+    case 0x9:
+        r.PC += (vx != vy) << 1;
+        break;
+    case 0xA:
+        r.I = nnn;
+        break;
+    case 0xB:
+        r.PC = nnn + r.V[0];
+        break;
+    case 0xC:
+        vx = nextRandom(r.rngState) & nn;
+        break;
+    case 0xD:
+        r.V[0xF] = draw(lane, vx, vy, r.I, opcode & 0xF, r.hires ? hires : nullptr) ? 1 : 0;
+        break;
+    case 0xE:
+        if (nn == 0x9E || nn == 0xA1)
+            r.PC += (((r.keys >> (vx & 0xF)) & 1) == (nn == 0x9E)) << 1;
+        break;
+    default:
+        switch (nn)
+        {
+        case 0x07:
+            vx = r.delayTimer;
+            break;
+        case 0x0A: // Halt until a key goes down and up, see setKey
+            r.keyWaitReg = static_cast<int8_t>(x);
+            r.keyWaitKey = -1;
+            break;
+        case 0x15:
+            r.delayTimer = vx;
+            break;
+        case 0x18:
+            r.soundTimer = vx;
+            break;
+        case 0x1E:
+            r.I += vx;
+            break;
+        case 0x29:
+            r.I = static_cast<uint16_t>(0x050 + (vx & 0xF) * 5);
+            break;
+        case 0x30:
+            r.I = static_cast<uint16_t>(0x0A0 + (vx & 0xF) * 10);
+            break;
+        case 0x33:
+            write(lane, (r.I) & 0xFFF, vx / 100);
+            write(lane, (r.I + 1) & 0xFFF, (vx / 10) % 10);
+            write(lane, (r.I + 2) & 0xFFF, vx % 10);
+            break;
+        case 0x55:
+            for (unsigned i = 0; i <= x; ++i)
+                write(lane, (r.I + i) & 0xFFF, r.V[i]);
+            r.I += x + 1;
+            break;
+        case 0x65:
+            for (unsigned i = 0; i <= x; ++i)
+                r.V[i] = mem(r.I + i);
+            r.I += x + 1;
+            break;
+        case 0x75:
+            std::copy(r.V.begin(), r.V.begin() + x + 1, rplFlags[lane].begin());
+            break;
+        case 0x85:
+            std::copy(rplFlags[lane].begin(), rplFlags[lane].begin() + x + 1, r.V.begin());
+            break;
+        }
+        break;
+    }
+}
+
+void Chip8Batch::decrementTimers(size_t lane)
+{
+    if (delayTimer[lane] > 0)
+        --delayTimer[lane];
+    if (soundTimer[lane] > 0)
+        --soundTimer[lane];
+}
+
+void Chip8Batch::runLockstep(int count)
+{
+    for (size_t first = 0; first < size(); first += lockstepWidth)
+        runGroup(first, count);
+}
+
+void Chip8Batch::runFrames(int frames, int ipf)
+{
+    // Group by group, so one group's state stays in cache for all its frames
+    for (size_t first = 0; first < size(); first += lockstepWidth)
+    {
+        size_t last = std::min(size(), first + lockstepWidth);
+        for (int f = 0; f < frames; ++f)
+        {
+            runGroup(first, ipf);
+            for (size_t lane = first; lane < last; ++lane)
+                decrementTimers(lane);
+        }
+    }
+}
+
+void Chip8Batch::runGroup(size_t first, int count)
+{
+    const size_t lanes = std::min<size_t>(lockstepWidth, size() - first);
+    std::array<int, lockstepWidth> remaining{};
+    for (size_t l = 0; l < lanes; ++l)
+        remaining[l] = count;
+
+    for (;;)
+    {
+        // Lead with the lane furthest behind, lowest PC on ties, so lanes
+        // that split at a branch tend to meet again at the loop head
+        int leader = -1;
+        for (size_t l = 0; l < lanes; ++l)
+        {
+            if (keyWaitReg[first + l] >= 0)
+                remaining[l] = 0; // Halted in FX0A, as run stops
+            if (remaining[l] == 0)
+                continue;
+            if (leader < 0 || remaining[l] > remaining[leader] ||
+                (remaining[l] == remaining[leader] && pc[first + l] < pc[first + leader]))
+                leader = static_cast<int>(l);
+        }
+        if (leader < 0)
+            return;
+
+        // Everyone at the leader's PC with the same code there
+        const size_t lead = first + leader;
+        uint16_t at = pc[lead];
+        const int codePage = at >> 8;
+        bool sharedCode = true; // Every member reads the leader's page
+        std::array<uint8_t, lockstepWidth> mask{};
+        int active = 0;
+        int steps = remaining[leader];
+        for (size_t l = 0; l < lanes; ++l)
+        {
+            bool member = remaining[l] > 0 && pc[first + l] == at;
+            if (member && pageTables[first + l][codePage] != pageTables[lead][codePage])
+            {
+                sharedCode = false;
+                member = fetch(first + l, at) == fetch(lead, at);
+            }
+            if (!member)
+                continue;
+            mask[l] = 0xFF;
+            ++active;
+            steps = std::min(steps, remaining[l]);
+        }
+        if (active == 1)
+        {
+            run(lead, remaining[leader]);
+            remaining[leader] = 0;
+            continue;
+        }
+
+        // Stay together until a lane leaves the group or the code moves
+        // to a page not checked above
+        int done = 0;
+        bool together = true;
+        while (together && done < steps)
+        {
+            together = executeLanes(first, lanes, mask.data(), fetch(lead, at));
+            ++done;
+            at = pc[lead];
+            together = together && sharedCode && (at >> 8) == codePage && ((at + 1) >> 8) == codePage;
+        }
+        for (size_t l = 0; l < lanes; ++l)
+            remaining[l] -= mask[l] ? done : 0;
+    }
+}
+
+bool Chip8Batch::executeLanes(size_t first, size_t lanes, const uint8_t *mask, uint16_t opcode)
+{
+    // Register and branch instructions are plain loops over the group's
+    // slice of each field array, written so the compiler turns them into
+    // SIMD blends. Everything else runs lane by lane. True if the members
+    // are still at one PC and may go on together.
+    const unsigned x = (opcode >> 8) & 0xF;
+    const unsigned y = (opcode >> 4) & 0xF;
+    const uint8_t nn = opcode & 0xFF;
+    const uint16_t nnn = opcode & 0xFFF;
+    uint16_t *PC = &pc[first];
+    uint16_t *I = &index[first];
+    uint8_t *vx = &v[x][first];
+    uint8_t *vy = &v[y][first];
+    uint8_t *vf = &v[0xF][first];
+    for (size_t l = 0; l < lanes; ++l)
+        PC[l] += mask[l] & 2;
+
+    // Skips: condition per lane, the group only stays if all agree
+    auto skipIf = [&](auto condition)
+    {
+        int members = 0, skipped = 0;
+        for (size_t l = 0; l < lanes; ++l)
+        {
+            const int skip = (mask[l] & 1) & static_cast<int>(condition(l));
+            PC[l] += skip << 1;
+            members += mask[l] & 1;
+            skipped += skip;
+        }
+        return skipped == 0 || skipped == members;
+    };
+    auto setVx = [&](auto value)
+    {
+        for (size_t l = 0; l < lanes; ++l)
+            vx[l] = mask[l] ? static_cast<uint8_t>(value(l)) : vx[l];
+        return true;
+    };
+    // Both from the operands as read, then Vx and VF last, as Chip8 does
+    auto vxThenFlag = [&](auto value, auto flag)
+    {
+        for (size_t l = 0; l < lanes; ++l)
+        {
+            const uint8_t result = static_cast<uint8_t>(value(l)), carry = static_cast<uint8_t>(flag(l));
+            vx[l] = mask[l] ? result : vx[l];
+            vf[l] = mask[l] ? carry : vf[l];
+        }
+        return true;
+    };
+
+    switch (opcode >> 12)
+    {
+    case 0x1:
+        for (size_t l = 0; l < lanes; ++l)
+            PC[l] = mask[l] ? nnn : PC[l];
+        return true;
+    case 0x3:
+        return skipIf([&](size_t l)
+                      { return vx[l] == nn; });
+    case 0x4:
+        return skipIf([&](size_t l)
+                      { return vx[l] != nn; });
+    case 0x5:
+        return skipIf([&](size_t l)
+                      { return vx[l] == vy[l]; });
+    case 0x6:
+        return setVx([&](size_t)
+                     { return nn; });
+    case 0x7:
+        for (size_t l = 0; l < lanes; ++l)
+            vx[l] += mask[l] & nn;
+        return true;
+    case 0x8:
+        switch (opcode & 0xF)
+        {
+        case 0x0:
+            return setVx([&](size_t l)
+                         { return vy[l]; });
+        case 0x1:
+            return setVx([&](size_t l)
+                         { return vx[l] | vy[l]; });
+        case 0x2:
+            return setVx([&](size_t l)
+                         { return vx[l] & vy[l]; });
+        case 0x3:
+            return setVx([&](size_t l)
+                         { return vx[l] ^ vy[l]; });
+        case 0x4:
+            return vxThenFlag([&](size_t l)
+                              { return vx[l] + vy[l]; },
+                              [&](size_t l)
+                              { return (vx[l] + vy[l]) >> 8; });
+        case 0x5:
+            return vxThenFlag([&](size_t l)
+                              { return vx[l] - vy[l]; },
+                              [&](size_t l)
+                              { return vx[l] >= vy[l]; });
+        case 0x6:
+            return vxThenFlag([&](size_t l)
+                              { return vx[l] >> 1; },
+                              [&](size_t l)
+                              { return vx[l] & 1; });
+        case 0x7:
+            return vxThenFlag([&](size_t l)
+                              { return vy[l] - vx[l]; },
+                              [&](size_t l)
+                              { return vy[l] >= vx[l]; });
+        case 0xE:
+            return vxThenFlag([&](size_t l)
+                              { return vx[l] << 1; },
+                              [&](size_t l)
+                              { return vx[l] >> 7; });
+        }
+        return true; // Unknown 8XYN does nothing
+    case 0x9:
+        return skipIf([&](size_t l)
+                      { return vx[l] != vy[l]; });
+    case 0xA:
+        for (size_t l = 0; l < lanes; ++l)
+            I[l] = mask[l] ? nnn : I[l];
+        return true;
+    case 0xC:
+        for (size_t l = 0; l < lanes; ++l)
+        {
+            if (mask[l])
+                vx[l] = nextRandom(rngState[first + l]) & nn;
+        }
+        return true;
+    case 0xD:
+        for (size_t l = 0; l < lanes; ++l)
+        {
+            if (!mask[l])
+                continue;
+            uint64_t *hires = hiresOn[first + l] ? hiresFor(first + l) : nullptr;
+            vf[l] = draw(first + l, vx[l], vy[l], I[l], opcode & 0xF, hires) ? 1 : 0;
+        }
+        return true;
+    case 0xE:
+        if (nn == 0x9E || nn == 0xA1)
+        {
+            const uint16_t *down = &keys[first];
+            const bool pressed = nn == 0x9E;
+            return skipIf([&](size_t l)
+                          { return (((down[l] >> (vx[l] & 0xF)) & 1) != 0) == pressed; });
+        }
+        return true;
+    case 0xF:
+        switch (nn)
+        {
+        case 0x07:
+        {
+            const uint8_t *dt = &delayTimer[first];
+            return setVx([&](size_t l)
+                         { return dt[l]; });
+        }
+        case 0x15:
+        case 0x18:
+        {
+            uint8_t *timer = nn == 0x15 ? &delayTimer[first] : &soundTimer[first];
+            for (size_t l = 0; l < lanes; ++l)
+                timer[l] = mask[l] ? vx[l] : timer[l];
+            return true;
+        }
+        case 0x1E:
+            for (size_t l = 0; l < lanes; ++l)
+                I[l] += mask[l] ? vx[l] : 0;
+            return true;
+        case 0x29:
+            for (size_t l = 0; l < lanes; ++l)
+                I[l] = mask[l] ? static_cast<uint16_t>(0x050 + (vx[l] & 0xF) * 5) : I[l];
+            return true;
+        }
+        break;
+    }
+
+    // Calls, memory, the key wait and the rest, through the scalar path.
+    // Writes may give lanes their own copy of the code, so regroup after.
+    int at = -1;
+    bool together = !(opcode >> 12 == 0xF && (nn == 0x33 || nn == 0x55 || nn == 0x0A));
+    for (size_t l = 0; l < lanes; ++l)
+    {
+        if (!mask[l])
+            continue;
+        Registers r = load(first + l);
+        uint64_t *hires = r.hires ? hiresFor(first + l) : nullptr;
+        execute(first + l, r, opcode, hires);
+        store(first + l, r);
+        together = together && (at < 0 || at == r.PC);
+        at = r.PC;
+    }
+    return together;
+}
+
+void Chip8Batch::get(size_t lane, Machine &out) const
+{
+    out.regs = load(lane);
+    out.stack = stacks[lane];
+    out.rplFlags = rplFlags[lane];
+    screen(lane, out.gfx);
+    for (int p = 0; p < pageCount; ++p)
+        std::memcpy(&out.memory[p * pageSize], pages[pageTables[lane][p]].data(), pageSize);
+}
+
+void Chip8Batch::set(size_t lane, const Machine &in)
+{
+    store(lane, in.regs);
+    stacks[lane] = in.stack;
+    rplFlags[lane] = in.rplFlags;
+    screens[lane].fill(0);
+    if (in.regs.hires)
+        std::memcpy(hiresFor(lane), in.gfx.data(), sizeof in.gfx);
+    else
+    {
+        for (int row = 0; row < 32; ++row)
+            screens[lane][row] = in.gfx[row * 2];
+    }
+
+    // Pages equal to the shared image stay shared
+    freeLanePages(lane);
+    for (int p = 0; p < pageCount; ++p)
+    {
+        const uint8_t *src = &in.memory[p * pageSize];
+        if (std::memcmp(src, pages[p].data(), pageSize) == 0)
+            continue;
+        for (int i = 0; i < pageSize; ++i)
+            write(lane, static_cast<uint16_t>(p * pageSize + i), src[i]);
+    }
+}
+
+void Chip8Batch::copyLane(size_t from, size_t to)
+{
+    if (from == to)
+        return;
+    store(to, load(from));
+    stacks[to] = stacks[from];
+    rplFlags[to] = rplFlags[from];
+    screens[to] = screens[from];
+    if (hiresScreen[from] != noScreen)
+    {
+        uint64_t *dst = hiresFor(to); // May move hiresScreens, so look up the source after
+        std::memcpy(dst, hiresScreens[hiresScreen[from]].data(), sizeof(HiresScreen));
+    }
+    freeLanePages(to);
+    for (int p = 0; p < pageCount; ++p)
+    {
+        uint32_t page = pageTables[from][p];
+        if (page < static_cast<uint32_t>(pageCount))
+            continue;
+        write(to, static_cast<uint16_t>(p * pageSize), 0); // Allocates the copy
+        pages[pageTables[to][p]] = pages[page];
+    }
+}
+
+void Chip8Batch::screen(size_t lane, std::array<uint64_t, 128> &out) const
+{
+    if (hiresOn[lane])
+    {
+        out = hiresScreens[hiresScreen[lane]];
+        return;
+    }
+    out.fill(0);
+    for (int row = 0; row < 32; ++row)
+        out[row * 2] = screens[lane][row];
+}
+
+bool Chip8Batch::pixel(size_t lane, int x, int y) const
+{
+    if (hiresOn[lane])
+    {
+        const HiresScreen &screen = hiresScreens[hiresScreen[lane]];
+        return (screen[y * 2 + (x >> 6)] >> (63 - (x & 63))) & 1;
+    }
+    return (screens[lane][y] >> (63 - x)) & 1;
+}
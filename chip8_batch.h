@@ -0,0 +1,162 @@
+#ifndef CHIP8_BATCH_H
+#define CHIP8_BATCH_H
+
+#include <array>   // For the per-lane blocks
+#include <cstdint> // For uint8_t, uint16_t, uint64_t
+#include <cstddef> // For size_t
+#include <vector>  // For the field arrays
+
+// Many classic machines (what Chip8 runs: CHIP-8 plus the SUPER-CHIP
+// opcodes, original quirks) for fuzzing and other mass simulation. A Chip8
+// is about 38 KB, mostly decode caches and its own copy of memory; a lane
+// here is a few hundred bytes. Every field is its own array indexed by
+// lane, memory is 256-byte pages copied from the shared ROM image only
+// when a lane writes to them, and the screen is one bit per pixel, one
+// word per lo-res row. Hi-res lanes get a full 128x64 screen on their
+// first 00FF. Lanes match a Chip8 with the same seed and keys instruction
+// for instruction; sound and the GUI's redraw flags are left out.
+class Chip8Batch
+{
+public:
+    static constexpr int pageSize = 256;
+    static constexpr int pageCount = 4096 / pageSize;
+
+    // Hot state of one lane, in the order the interpreter uses it
+    struct Registers
+    {
+        std::array<uint8_t, 16> V;
+        uint16_t PC;
+        uint16_t I;
+        uint16_t keys; // Bit k = key k down
+        uint8_t sp;
+        uint8_t delayTimer;
+        uint8_t soundTimer;
+        bool hires;
+        int8_t keyWaitReg; // FX0A, as in Chip8
+        int8_t keyWaitKey;
+        uint64_t rngState;
+    };
+
+    // One lane as a plain struct: registers first, then the rest in
+    // falling order of use. gfx uses Chip8's layout, so it compares and
+    // hashes the same way.
+    struct Machine
+    {
+        Registers regs;
+        std::array<uint16_t, 16> stack;
+        std::array<uint8_t, 16> rplFlags;
+        std::array<uint64_t, 128> gfx;
+        std::array<uint8_t, 4096> memory;
+    };
+
+    explicit Chip8Batch(size_t lanes = 0);
+
+    size_t size() const { return pc.size(); }
+    void resize(size_t lanes); // New lanes start reset
+
+    // Shared image every lane boots from, copied to 0x200; resets all lanes
+    bool loadROM(const uint8_t *data, size_t size);
+
+    // reset keeps the generator, which starts seeded with the lane number
+    void reset(size_t lane);
+    void seedRandom(size_t lane, uint64_t seed); // Same generator as Chip8::seedRandom
+
+    // Like Chip8::setKey and setKeyMask
+    void setKey(size_t lane, int key, bool pressed);
+    void setKeyMask(size_t lane, uint16_t mask) { keys[lane] = mask; }
+
+    // count instructions on one lane; stops early while halted in FX0A
+    void run(size_t lane, int count);
+    void decrementTimers(size_t lane);
+
+    // count instructions on every lane, lockstepWidth lanes at a time.
+    // Lanes at the same PC share one fetch and decode and run it as one
+    // vector operation over the group; a lane left alone at its PC runs
+    // the rest of the call on its own. The end state is the same as
+    // calling run on every lane.
+    static constexpr int lockstepWidth = 32;
+    void runLockstep(int count);
+
+    // Every lane for frames frames of ipf instructions and a timer tick,
+    // on the lockstep path
+    void runFrames(int frames, int ipf);
+
+    // Copies, for inspection and for cloning a lane into another
+    void get(size_t lane, Machine &out) const;
+    void set(size_t lane, const Machine &in);
+    void copyLane(size_t from, size_t to);
+
+    uint16_t getPC(size_t lane) const { return pc[lane]; }
+    uint8_t getV(size_t lane, int reg) const { return v[reg][lane]; }
+    uint8_t read(size_t lane, uint16_t addr) const
+    {
+        return pages[pageTables[lane][(addr >> 8) & (pageCount - 1)]][addr & (pageSize - 1)];
+    }
+    bool isHires(size_t lane) const { return hiresOn[lane] != 0; }
+    uint16_t keyMask(size_t lane) const { return keys[lane]; }
+    uint8_t getSoundTimer(size_t lane) const { return soundTimer[lane]; }
+    bool isWaitingForKey(size_t lane) const { return keyWaitReg[lane] >= 0; }
+    bool pixel(size_t lane, int x, int y) const;
+
+    // The lane's screen in Chip8::gfx layout, as get() fills Machine::gfx
+    void screen(size_t lane, std::array<uint64_t, 128> &out) const;
+
+    // Pages lanes have written to, each pageSize bytes on top of the lanes
+    size_t privatePages() const { return pages.size() - pageCount - freePages.size(); }
+
+private:
+    using Page = std::array<uint8_t, pageSize>;
+    using HiresScreen = std::array<uint64_t, 128>; // 64 rows of two words, as Chip8::gfx
+    static constexpr uint32_t noScreen = UINT32_MAX;
+
+    uint16_t fetch(size_t lane, uint16_t addr) const
+    {
+        return static_cast<uint16_t>((read(lane, addr & 0xFFF) << 8) | read(lane, (addr + 1) & 0xFFF));
+    }
+    void write(size_t lane, uint16_t addr, uint8_t value);
+
+    // One instruction on one lane, r loaded from it and PC already advanced
+    void execute(size_t lane, Registers &r, uint16_t opcode, uint64_t *&hires);
+
+    // Lanes first.. of up to lockstepWidth, see runLockstep
+    void runGroup(size_t first, int count);
+
+    // opcode on the lanes of a group whose mask byte is set; false once
+    // they are no longer at one PC
+    bool executeLanes(size_t first, size_t lanes, const uint8_t *mask, uint16_t opcode);
+
+    // DXYN on one lane; hires is its hi-res screen, or nullptr in lo-res
+    bool draw(size_t lane, uint8_t vx, uint8_t vy, uint16_t addr, unsigned n, uint64_t *hires);
+    void freeLanePages(size_t lane);
+    uint64_t *hiresFor(size_t lane); // Allocates the lane's hi-res screen
+
+    Registers load(size_t lane) const;
+    void store(size_t lane, const Registers &r);
+
+    // Registers, one array per field
+    std::array<std::vector<uint8_t>, 16> v; // v[x][lane]
+    std::vector<uint16_t> pc;
+    std::vector<uint16_t> index;
+    std::vector<uint16_t> keys;
+    std::vector<uint8_t> sp;
+    std::vector<uint8_t> delayTimer;
+    std::vector<uint8_t> soundTimer;
+    std::vector<uint8_t> hiresOn;
+    std::vector<int8_t> keyWaitReg;
+    std::vector<int8_t> keyWaitKey;
+    std::vector<uint64_t> rngState;
+
+    std::vector<std::array<uint16_t, 16>> stacks;
+    std::vector<std::array<uint8_t, 16>> rplFlags;
+    std::vector<std::array<uint64_t, 32>> screens; // Lo-res, one word per row
+    std::vector<uint32_t> hiresScreen;              // Into hiresScreens, noScreen until 00FF
+    std::vector<HiresScreen> hiresScreens;
+
+    // Page p of a lane is pages[pageTables[lane][p]]; the first pageCount
+    // pages are the shared image, a lane's first write copies one
+    std::vector<std::array<uint32_t, pageCount>> pageTables;
+    std::vector<Page> pages;
+    std::vector<uint32_t> freePages;
+};
+
+#endif
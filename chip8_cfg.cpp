@@ -0,0 +1,354 @@
+#include "chip8_cfg.h"
+#include "chip8_coverage.h"
+#include "chip8_disasm.h"
+#include <algorithm> // For std::copy, std::lower_bound
+#include <cstdio>    // For std::snprintf
+
+namespace
+{
+    // The skips, whose successors are the next two instructions
+    bool isSkip(uint16_t opcode)
+    {
+        switch (opcode & 0xF000)
+        {
+        case 0x3000:
+        case 0x4000:
+            return true;
+        case 0x5000:
+        case 0x9000:
+            return (opcode & 0xF) == 0;
+        case 0xE000:
+            return (opcode & 0xFF) == 0x9E || (opcode & 0xFF) == 0xA1;
+        }
+        return false;
+    }
+
+    // Words that run as something. 0NNN and unknown opcodes are NOPs on
+    // the machine, but in a walk they almost always mean it went into data.
+    bool executable(uint16_t opcode, bool xo)
+    {
+        if (!xo && (opcode == 0xF000 || (opcode & 0xF0FF) == 0xF001 ||
+                    (opcode & 0xF00F) == 0x5002 || (opcode & 0xF00F) == 0x5003))
+            return false;
+        std::string text = Chip8Disassembler::text(opcode);
+        return text.compare(0, 3, "DW ") != 0 && text.compare(0, 4, "SYS ") != 0;
+    }
+
+    // One byte as eight pixels, the way DXYN would draw it
+    std::string pixels(uint8_t byte)
+    {
+        std::string row(8, '.');
+        for (int bit = 0; bit < 8; ++bit)
+        {
+            if (byte & (0x80 >> bit))
+                row[bit] = '#';
+        }
+        return row;
+    }
+}
+
+void Chip8Cfg::build(const uint8_t *rom, size_t size, bool xoChip, const Chip8Coverage *seen)
+{
+    xo = xoChip;
+    const size_t space = xoChip ? 0x10000 : 0x1000;
+    size = std::min(size, space - 0x200);
+    memory.assign(space, 0);
+    flags.assign(space, 0);
+    std::copy(rom, rom + size, memory.begin() + 0x200);
+    romEnd = 0x200 + size;
+    blocks.clear();
+    computedJumps.clear();
+
+    std::vector<Pending> pending;
+    addLeader(0x200, -1, pending);
+    while (!pending.empty())
+    {
+        Pending start = pending.back();
+        pending.pop_back();
+        walk(start, pending);
+    }
+
+    // What ran but the walk didn't reach starts blocks of its own
+    if (seen && seen->size() == space)
+    {
+        for (size_t addr = 0x200; addr < romEnd; ++addr)
+        {
+            if (seen->isData(addr))
+                flags[addr] |= DataFlag;
+            if (!seen->isCode(addr) || (flags[addr] & StartFlag))
+                continue;
+            addLeader(static_cast<uint16_t>(addr), -1, pending);
+            while (!pending.empty())
+            {
+                Pending start = pending.back();
+                pending.pop_back();
+                walk(start, pending);
+            }
+        }
+    }
+
+    // Each block runs from its leader to the first exit or the next leader
+    for (size_t start = 0x200; start < romEnd; ++start)
+    {
+        if ((flags[start] & (LeaderFlag | StartFlag)) != (LeaderFlag | StartFlag))
+            continue;
+        Block block{static_cast<uint16_t>(start), 0, 0, Exit::End, {}};
+        size_t pc = start;
+        while (true)
+        {
+            const uint16_t opcode = opcodeAt(pc);
+            const size_t next = pc + length(opcode);
+            ++block.instructions;
+            block.end = static_cast<uint16_t>(next);
+            if (exitOf(pc, opcode, block.exit, block.successors))
+                break;
+            if (next >= romEnd || !(flags[next] & StartFlag))
+                break; // Exit::End
+            if (flags[next] & LeaderFlag)
+            {
+                block.exit = Exit::FallThrough;
+                block.successors.push_back(static_cast<uint16_t>(next));
+                break;
+            }
+            pc = next;
+        }
+        blocks.push_back(std::move(block));
+    }
+}
+
+int Chip8Cfg::blockAt(uint16_t addr) const
+{
+    auto it = std::lower_bound(blocks.begin(), blocks.end(), addr, [](const Block &block, uint16_t a)
+                               { return block.start < a; });
+    return it != blocks.end() && it->start == addr ? static_cast<int>(it - blocks.begin()) : -1;
+}
+
+Chip8Cfg::Byte Chip8Cfg::byteKind(uint16_t addr) const
+{
+    if (addr >= flags.size())
+        return Byte::Unreached;
+    if (flags[addr] & CodeFlag)
+        return Byte::Code;
+    return flags[addr] & DataFlag ? Byte::Data : Byte::Unreached;
+}
+
+uint16_t Chip8Cfg::opcodeAt(size_t addr) const
+{
+    return static_cast<uint16_t>((memory[addr % memory.size()] << 8) | memory[(addr + 1) % memory.size()]);
+}
+
+int Chip8Cfg::length(uint16_t opcode) const
+{
+    return xo ? Chip8Disassembler::length(opcode) : 2;
+}
+
+bool Chip8Cfg::exitOf(size_t pc, uint16_t opcode, Exit &exit, std::vector<uint16_t> &targets) const
+{
+    auto target = [&](size_t addr)
+    {
+        if (addr < memory.size())
+            targets.push_back(static_cast<uint16_t>(addr));
+    };
+    if (opcode == 0x00EE)
+        exit = Exit::Return;
+    else if ((opcode & 0xF000) == 0x1000)
+    {
+        exit = Exit::Jump;
+        target(opcode & 0xFFF);
+    }
+    else if ((opcode & 0xF000) == 0x2000)
+    {
+        exit = Exit::Call;
+        target(opcode & 0xFFF);
+        target(pc + 2);
+    }
+    else if ((opcode & 0xF000) == 0xB000)
+        exit = Exit::Computed;
+    else if (isSkip(opcode))
+    {
+        exit = Exit::Skip;
+        target(pc + 2);
+        target(pc + 2 + length(opcodeAt(pc + 2)));
+    }
+    else
+        return false;
+    return true;
+}
+
+void Chip8Cfg::walk(Pending start, std::vector<Pending> &pending)
+{
+    long index = start.index; // I, while this walk knows it
+    size_t pc = start.addr;
+    while (inRom(pc, 2))
+    {
+        const uint16_t opcode = opcodeAt(pc);
+        const int bytes = length(opcode);
+        if (!inRom(pc, bytes) || !executable(opcode, xo) || (flags[pc] & StartFlag))
+            return;
+        flags[pc] |= StartFlag;
+        for (int b = 0; b < bytes; ++b)
+            flags[pc + b] |= CodeFlag;
+
+        const unsigned x = (opcode >> 8) & 0xF;
+        const unsigned y = (opcode >> 4) & 0xF;
+        switch (opcode & 0xF000)
+        {
+        case 0x5000:
+            if ((opcode & 0xF) == 2 || (opcode & 0xF) == 3)
+                markData(index, (x > y ? x - y : y - x) + 1);
+            break;
+        case 0xA000:
+            index = opcode & 0xFFF;
+            break;
+        case 0xD000:
+            markData(index, (opcode & 0xF) ? (opcode & 0xF) : 32);
+            break;
+        case 0xF000:
+            if (opcode == 0xF000)
+                index = opcodeAt(pc + 2);
+            else if ((opcode & 0xFF) == 0x33)
+                markData(index, 3, true);
+            else if ((opcode & 0xFF) == 0x55 || (opcode & 0xFF) == 0x65)
+            {
+                markData(index, static_cast<int>(x) + 1, (opcode & 0xFF) == 0x55);
+                index = -1; // Where I ends up depends on the quirks
+            }
+            else if ((opcode & 0xFF) == 0x1E || (opcode & 0xFF) == 0x29 || (opcode & 0xFF) == 0x30)
+                index = -1;
+            break;
+        }
+
+        Exit exit;
+        std::vector<uint16_t> targets;
+        if (exitOf(pc, opcode, exit, targets))
+        {
+            if (exit == Exit::Call || exit == Exit::Jump)
+                flags[targets[0]] |= exit == Exit::Call ? CallFlag : JumpFlag;
+            if (exit == Exit::Computed)
+                computedJumps.push_back(static_cast<uint16_t>(pc));
+
+            // A subroutine may move I, so the return site starts without it
+            for (size_t t = 0; t < targets.size(); ++t)
+                addLeader(targets[t], exit == Exit::Call && t == 1 ? -1 : index, pending);
+            return;
+        }
+        pc += bytes;
+    }
+}
+
+void Chip8Cfg::markData(long addr, int bytes, bool written)
+{
+    if (addr < 0)
+        return;
+    if (static_cast<size_t>(addr) < flags.size())
+        flags[addr] |= DataRefFlag;
+    for (long a = addr; a < addr + bytes; ++a)
+    {
+        if (inRom(static_cast<size_t>(a), 1))
+            flags[a] |= written ? DataFlag | WriteFlag : DataFlag;
+    }
+}
+
+void Chip8Cfg::addLeader(uint16_t addr, long index, std::vector<Pending> &pending)
+{
+    if (addr >= flags.size() || (flags[addr] & LeaderFlag))
+        return;
+    flags[addr] |= LeaderFlag;
+    pending.push_back({addr, index});
+}
+
+void Chip8Cfg::writeListing(std::ostream &out) const
+{
+    const char *addrFormat = xo ? "%04X" : "%03X";
+    char line[96];
+    auto address = [&](size_t addr)
+    {
+        char text[8];
+        std::snprintf(text, sizeof text, addrFormat, static_cast<unsigned>(addr));
+        return std::string(text);
+    };
+
+    size_t code = 0, data = 0, unreached = 0;
+    for (size_t a = 0x200; a < romEnd; ++a)
+    {
+        Byte kind = byteKind(static_cast<uint16_t>(a));
+        (kind == Byte::Code ? code : kind == Byte::Data ? data : unreached) += 1;
+    }
+    std::snprintf(line, sizeof line, "; %zu bytes: %zu blocks, %zu code, %zu data, %zu unreached\n",
+                  romEnd - 0x200, blocks.size(), code, data, unreached);
+    out << line;
+    for (uint16_t pc : computedJumps)
+        out << "; BNNN at " << address(pc) << " jumps to a computed address, code only it reaches shows as unreached\n";
+
+    bool inUnreached = false;
+    size_t a = 0x200;
+    while (a < romEnd)
+    {
+        const uint8_t f = flags[a];
+        if (f & StartFlag)
+        {
+            // Every block is set apart, only jump and call targets are labelled
+            if (f & (CallFlag | JumpFlag))
+                out << '\n' << (f & CallFlag ? "sub_" : "loc_") << address(a) << ":\n";
+            else if (f & LeaderFlag)
+                out << '\n';
+            const uint16_t opcode = opcodeAt(a);
+            const int bytes = length(opcode);
+            std::snprintf(line, sizeof line, bytes == 4 ? "%04X %04X" : "%04X     ", opcode, opcodeAt(a + 2));
+            out << "    " << address(a) << "  " << line << "  " << Chip8Disassembler::text(opcode, opcodeAt(a + 2)) << '\n';
+            inUnreached = false;
+            a += bytes;
+            continue;
+        }
+
+        if (f & DataFlag)
+        {
+            if (f & DataRefFlag)
+                out << "\ndata_" << address(a) << ":\n";
+            inUnreached = false;
+        }
+        else if (!(f & CodeFlag) && !inUnreached)
+        {
+            out << "\n    ; not reached\n";
+            inUnreached = true;
+        }
+        std::snprintf(line, sizeof line, "%02X       ", memory[a]);
+        out << "    " << address(a) << "  " << line << "  " << pixels(memory[a]) << '\n';
+        ++a;
+    }
+}
+
+void Chip8Cfg::writeDot(std::ostream &out) const
+{
+    const char *addrFormat = xo ? "%04X" : "%03X";
+    char text[8];
+    auto address = [&](size_t addr)
+    {
+        std::snprintf(text, sizeof text, addrFormat, static_cast<unsigned>(addr));
+        return std::string(text);
+    };
+
+    out << "digraph rom {\n    node [shape=box, fontname=\"Courier\"];\n";
+    for (const Block &block : blocks)
+    {
+        out << "    b" << address(block.start) << " [label=\"" << (isCallTarget(block.start) ? "sub_" : "loc_")
+            << address(block.start) << "\\l";
+        for (size_t pc = block.start; pc < block.end; pc += length(opcodeAt(pc)))
+            out << address(pc) << "  " << Chip8Disassembler::text(opcodeAt(pc), opcodeAt(pc + 2)) << "\\l";
+        out << "\"];\n";
+    }
+    for (const Block &block : blocks)
+    {
+        for (size_t i = 0; i < block.successors.size(); ++i)
+        {
+            uint16_t to = block.successors[i];
+            if (blockAt(to) < 0)
+                continue; // Outside the ROM, or not an instruction
+            out << "    b" << address(block.start) << " -> b" << address(to);
+            if (block.exit == Exit::Call && i == 0)
+                out << " [style=dashed]";
+            out << ";\n";
+        }
+    }
+    out << "}\n";
+}
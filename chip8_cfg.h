@@ -0,0 +1,117 @@
+#ifndef CHIP8_CFG_H
+#define CHIP8_CFG_H
+
+#include <cstddef> // For size_t
+#include <cstdint> // For addresses and opcodes
+#include <ostream> // For the listing and the graph
+#include <vector>  // For blocks and the byte map
+
+class Chip8Coverage;
+
+// Static control-flow graph of a ROM. The walk starts at 0x200 and follows
+// every jump, call, return site and both ways out of each skip, so what it
+// reaches is code; bytes that ANNN points the reached DXYN, FX33, FX55 and
+// FX65 at are data. I is followed into jumps and calls, since sprites are
+// often set up by the caller and drawn by a subroutine. Blocks end where the JIT ends them: after a jump,
+// call, return, skip or BNNN, or in front of another block's start.
+// BNNN targets depend on a register, so the walk stops there.
+class Chip8Cfg
+{
+public:
+    enum class Byte : uint8_t
+    {
+        Unreached, // Nothing the walk saw runs or reads it
+        Code,      // Part of a reached instruction, even if also read as data
+        Data       // Read through I by reached code
+    };
+
+    // How a block hands over control
+    enum class Exit : uint8_t
+    {
+        FallThrough, // Runs on into the next block
+        Jump,        // 1NNN
+        Call,        // 2NNN, successors are the target and the return site
+        Return,      // 00EE
+        Skip,        // Successors are the next instruction and the one after
+        Computed,    // BNNN, no static successors
+        End          // Ran off the ROM or into a word that isn't an instruction
+    };
+
+    struct Block
+    {
+        uint16_t start;
+        uint16_t end; // One past the last byte
+        uint16_t instructions;
+        Exit exit;
+        std::vector<uint16_t> successors; // Targets outside the ROM included
+    };
+
+    // rom as loaded at 0x200; xoChip makes F000 NNNN 4 bytes long and the
+    // address space 64 KB. With a coverage map of a run, every instruction
+    // it saw run is walked from as well (BNNN targets, code only reached
+    // through computed jumps) and the bytes it saw read are data.
+    void build(const uint8_t *rom, size_t size, bool xoChip = false, const Chip8Coverage *seen = nullptr);
+
+    // Sorted by start address
+    const std::vector<Block> &getBlocks() const { return blocks; }
+
+    // Index of the block starting at addr, -1 if none does
+    int blockAt(uint16_t addr) const;
+
+    Byte byteKind(uint16_t addr) const;
+    bool isCallTarget(uint16_t addr) const { return addr < flags.size() && (flags[addr] & CallFlag); }
+    bool isDataStart(uint16_t addr) const { return addr < flags.size() && (flags[addr] & DataRefFlag); }
+    // Stored to by a reached FX33 or FX55; with byteKind Code, the ROM
+    // writes over its own code
+    bool isWritten(uint16_t addr) const { return addr < flags.size() && (flags[addr] & WriteFlag); }
+
+    // Addresses of the BNNN instructions reached
+    const std::vector<uint16_t> &getComputedJumps() const { return computedJumps; }
+
+    // Disassembly with labels for blocks, subroutines and data, data bytes
+    // drawn as pixels so sprites can be recognized
+    void writeListing(std::ostream &out) const;
+
+    // Graphviz digraph, one node per block
+    void writeDot(std::ostream &out) const;
+
+private:
+    enum : uint8_t
+    {
+        CodeFlag = 1,    // Byte of a reached instruction
+        DataFlag = 2,    // Read through I
+        StartFlag = 4,   // First byte of a reached instruction
+        LeaderFlag = 8,  // A block starts here
+        CallFlag = 16,    // Target of a 2NNN
+        DataRefFlag = 32, // First byte an ANNN read was made from
+        JumpFlag = 64,    // Target of a 1NNN
+        WriteFlag = 128   // Stored to through I
+    };
+
+    // A leader still to walk, with I as the code jumping there left it
+    struct Pending
+    {
+        uint16_t addr;
+        long index;
+    };
+
+    uint16_t opcodeAt(size_t addr) const;
+    int length(uint16_t opcode) const;
+    bool inRom(size_t addr, int bytes) const { return addr >= 0x200 && addr + bytes <= romEnd; }
+
+    // True for an instruction that ends a block, with its static targets
+    bool exitOf(size_t pc, uint16_t opcode, Exit &exit, std::vector<uint16_t> &targets) const;
+    void walk(Pending start, std::vector<Pending> &pending);
+    void markData(long addr, int bytes, bool written = false);
+    void addLeader(uint16_t addr, long index, std::vector<Pending> &pending);
+
+    std::vector<uint8_t> memory; // The ROM in an address space of its own
+    std::vector<uint8_t> flags;  // Per address
+    size_t romEnd = 0x200;
+    bool xo = false;
+
+    std::vector<Block> blocks;
+    std::vector<uint16_t> computedJumps;
+};
+
+#endif
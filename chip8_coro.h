@@ -0,0 +1,111 @@
+#ifndef CHIP8_CORO_H
+#define CHIP8_CORO_H
+
+#include "chip8.h" // For BasicChip8
+
+// A machine's run as a C++20 coroutine, for frontends and servers that
+// drive thousands of machines from one event loop: resume a task and it
+// runs one frame, then suspends and says where the program stands. The
+// loop can then skip machines halted in FX0A until their keys change, and
+// treat a DXYN waiting for the tick as the frame's end. A suspension is a
+// return from the coroutine's own frame, allocated once when the run
+// starts, with no thread or callback behind it. Needs a C++20 build; the
+// rest of the tree stays C++17 and doesn't include this.
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine> // For std::coroutine_handle
+#include <cstdint>   // For uint64_t
+#include <exception> // For std::terminate
+#include <utility>   // For std::exchange
+
+// Where a run stood when it suspended
+enum class Chip8Suspend
+{
+    Frame,      // The frame's instructions ran and the timers ticked
+    KeyWait,    // Halted in FX0A; nothing runs until setKey presses and releases a key
+    DisplayWait // The frame ended in a DXYN that draws on the tick (displayWait quirk)
+};
+
+class Chip8Task
+{
+public:
+    struct promise_type
+    {
+        Chip8Suspend reason = Chip8Suspend::Frame;
+
+        Chip8Task get_return_object() { return Chip8Task(std::coroutine_handle<promise_type>::from_promise(*this)); }
+        std::suspend_always initial_suspend() noexcept { return {}; } // Nothing runs before the first resume
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(Chip8Suspend why) noexcept
+        {
+            reason = why;
+            return {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() { std::terminate(); } // The core doesn't throw
+    };
+
+    Chip8Task() = default;
+    Chip8Task(Chip8Task &&other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Chip8Task &operator=(Chip8Task &&other) noexcept
+    {
+        if (this != &other)
+        {
+            if (handle)
+                handle.destroy();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    ~Chip8Task()
+    {
+        if (handle)
+            handle.destroy();
+    }
+
+    // Runs to the next suspension; false once the run has finished
+    bool resume()
+    {
+        if (!handle || handle.done())
+            return false;
+        handle.resume();
+        return !handle.done();
+    }
+
+    bool done() const { return !handle || handle.done(); }
+
+    // Why the last resume suspended
+    Chip8Suspend reason() const { return handle.promise().reason; }
+
+private:
+    explicit Chip8Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// Runs machine for frames frames of ipf instructions, or forever, each
+// frame as runFrame would; ipf 0 runs VIP-timed frames as runVipFrame. The
+// machine must outlive the task, and keys set between resumes take effect
+// in the next frame.
+template <size_t MemorySize, int Planes, typename Quirks>
+Chip8Task chip8Run(BasicChip8<MemorySize, Planes, Quirks> &machine, int ipf, uint64_t frames = UINT64_MAX)
+{
+    using Machine = BasicChip8<MemorySize, Planes, Quirks>;
+    for (uint64_t frame = 0; frame < frames; ++frame)
+    {
+        if (ipf > 0)
+            machine.emulateCycles(ipf);
+        else
+            machine.emulateVipCycles(Machine::vipCyclesPerFrame - Machine::vipDisplayCycles);
+        // Taken before the tick, which ends any wait for it
+        const Chip8Suspend reason = machine.isWaitingForKey()       ? Chip8Suspend::KeyWait
+                                    : machine.isWaitingForDisplay() ? Chip8Suspend::DisplayWait
+                                                                    : Chip8Suspend::Frame;
+        machine.decrementTimers();
+        co_yield reason;
+    }
+}
+
+#endif
+
+#endif
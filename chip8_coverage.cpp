@@ -0,0 +1,147 @@
+#include "chip8_coverage.h"
+#include <bitset>  // For counting set bits
+#include <cstring> // For std::memcmp
+#include <fstream>
+
+namespace
+{
+    const char coverageMagic[4] = {'C', '8', 'C', 'V'};
+    const uint32_t coverageVersion = 1;
+    const size_t romStart = 0x200;
+
+    void put32(std::ostream &out, uint32_t value)
+    {
+        for (int b = 0; b < 4; ++b)
+            out.put(static_cast<char>(value >> (8 * b)));
+    }
+
+    bool get32(std::istream &in, uint32_t &value)
+    {
+        uint8_t bytes[4];
+        if (!in.read(reinterpret_cast<char *>(bytes), sizeof bytes))
+            return false;
+        value = bytes[0] | bytes[1] << 8 | bytes[2] << 16 | static_cast<uint32_t>(bytes[3]) << 24;
+        return true;
+    }
+
+    void putWords(std::ostream &out, const std::vector<uint64_t> &words)
+    {
+        for (uint64_t word : words)
+        {
+            put32(out, static_cast<uint32_t>(word));
+            put32(out, static_cast<uint32_t>(word >> 32));
+        }
+    }
+
+    bool getWords(std::istream &in, std::vector<uint64_t> &words)
+    {
+        for (uint64_t &word : words)
+        {
+            uint32_t low = 0, high = 0;
+            if (!get32(in, low) || !get32(in, high))
+                return false;
+            word = low | static_cast<uint64_t>(high) << 32;
+        }
+        return true;
+    }
+
+    size_t countBits(const std::vector<uint64_t> &words)
+    {
+        size_t count = 0;
+        for (uint64_t word : words)
+            count += std::bitset<64>(word).count();
+        return count;
+    }
+}
+
+// Whole words only, the address spaces are all multiples of 64
+Chip8Coverage::Chip8Coverage(size_t memorySize)
+    : space((memorySize + 63) & ~size_t(63)), code(space / 64, 0), data(space / 64, 0)
+{
+}
+
+size_t Chip8Coverage::codeCount() const { return countBits(code); }
+size_t Chip8Coverage::dataCount() const { return countBits(data); }
+
+void Chip8Coverage::merge(const Chip8Coverage &other)
+{
+    for (size_t i = 0; i < code.size() && i < other.code.size(); ++i)
+    {
+        code[i] |= other.code[i];
+        data[i] |= other.data[i];
+    }
+}
+
+bool Chip8Coverage::save(const std::string &path) const
+{
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(coverageMagic, sizeof coverageMagic);
+    put32(out, coverageVersion);
+    put32(out, static_cast<uint32_t>(space));
+    putWords(out, code);
+    putWords(out, data);
+    return static_cast<bool>(out);
+}
+
+bool Chip8Coverage::load(const std::string &path)
+{
+    std::ifstream in(path, std::ios::binary);
+    char magic[4];
+    uint32_t version = 0, size = 0;
+    if (!in.read(magic, sizeof magic) || std::memcmp(magic, coverageMagic, sizeof magic) != 0 || !get32(in, version) ||
+        version != coverageVersion || !get32(in, size) || size == 0 || size > 0x10000 || size % 64 != 0)
+        return false;
+    std::vector<uint64_t> newCode(size / 64), newData(size / 64);
+    if (!getWords(in, newCode) || !getWords(in, newData))
+        return false;
+    space = size;
+    code = std::move(newCode);
+    data = std::move(newData);
+    return true;
+}
+
+bool Chip8Coverage::writeImage(const std::string &path, size_t romSize, int scale) const
+{
+    const size_t perRow = 64;
+    const size_t width = perRow * scale;
+    const size_t height = space / perRow * scale;
+    const size_t stride = (width * 3 + 3) & ~size_t(3);
+    const uint32_t pixelBytes = static_cast<uint32_t>(stride * height);
+
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.put('B');
+    out.put('M');
+    put32(out, 54 + pixelBytes);
+    put32(out, 0);
+    put32(out, 54); // Pixels follow the two headers
+    put32(out, 40);
+    put32(out, static_cast<uint32_t>(width));
+    put32(out, static_cast<uint32_t>(height));
+    put32(out, 1 | 24 << 16); // One plane, 24 bits a pixel
+    put32(out, 0);              // Uncompressed
+    put32(out, pixelBytes);
+    put32(out, 2835); // 72 DPI
+    put32(out, 2835);
+    put32(out, 0);
+    put32(out, 0);
+
+    // Rows go bottom-up, colours as blue, green, red
+    std::vector<char> row(stride, 0);
+    for (size_t y = height; y-- > 0;)
+    {
+        const size_t base = y / scale * perRow;
+        for (size_t x = 0; x < width; ++x)
+        {
+            const size_t addr = base + x / scale;
+            const bool run = isCode(addr), read = isData(addr);
+            uint8_t blue = read ? 0xE0 : 0, green = run ? 0xD0 : 0, red = 0;
+            if (!run && !read && addr >= romStart && addr < romStart + romSize)
+                blue = green = red = 0x40;
+            row[x * 3] = static_cast<char>(blue);
+            row[x * 3 + 1] = static_cast<char>(green);
+            row[x * 3 + 2] = static_cast<char>(red);
+        }
+        out.write(row.data(), static_cast<std::streamsize>(row.size()));
+    }
+    return static_cast<bool>(out);
+}
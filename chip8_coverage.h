@@ -0,0 +1,89 @@
+#ifndef CHIP8_COVERAGE_H
+#define CHIP8_COVERAGE_H
+
+#include <cstddef> // For size_t
+#include <cstdint> // For addresses and bitmap words
+#include <string>  // For file names
+#include <vector>  // For the bitmaps
+
+// Which addresses a run used, one bit per address in each of two maps:
+// instructions executed (the address of the opcode) and bytes read as data
+// by DXYN or FX65. Unlike Chip8Cfg's static walk this sees code reached
+// through BNNN and data found through computed I, and nothing that never
+// ran. Whatever steps the machine an instruction at a time marks them (the
+// headless runner with --coverage), so the core has no hooks. A .c8cv file
+// is "C8CV", a 32-bit version and the address space size, then the code
+// map and the data map as little-endian 64-bit words.
+class Chip8Coverage
+{
+public:
+    explicit Chip8Coverage(size_t memorySize = 0x1000);
+
+    // An instruction run at pc, with I as it was before
+    void mark(uint16_t pc, uint16_t opcode, uint16_t index)
+    {
+        setBits(code, pc, 1);
+        if ((opcode & 0xF000) == 0xD000)
+            setBits(data, index, (opcode & 0xF) ? (opcode & 0xF) : 32); // DXY0 draws 16x16 on SUPER-CHIP
+        else if ((opcode & 0xF0FF) == 0xF065)
+            setBits(data, index, ((opcode >> 8) & 0xF) + 1);
+    }
+
+    size_t size() const { return space; }
+    bool isCode(size_t addr) const { return testBit(code, addr); }
+    bool isData(size_t addr) const { return testBit(data, addr); }
+    size_t codeCount() const; // Instruction addresses executed
+    size_t dataCount() const; // Bytes read as data
+
+    // Predecodes every executed instruction into machine's cache, so a
+    // later run of the same ROM starts with the code it will reach decoded
+    template <typename Machine>
+    void warm(Machine &machine) const
+    {
+        for (size_t addr = 0; addr < space; ++addr)
+        {
+            if (isCode(addr))
+                machine.predecode(static_cast<uint16_t>(addr));
+        }
+    }
+
+    // Adds the maps of other, of the same size
+    void merge(const Chip8Coverage &other);
+
+    bool save(const std::string &path) const;
+    bool load(const std::string &path); // False if it isn't a coverage file
+
+    // Map of the address space as a BMP, 64 addresses a row and each a
+    // scale x scale square: green executed, blue read as data, cyan both,
+    // dark grey for the ROM's bytes left unused, black around them
+    bool writeImage(const std::string &path, size_t romSize, int scale = 8) const;
+
+private:
+    bool testBit(const std::vector<uint64_t> &bits, size_t addr) const
+    {
+        addr %= space;
+        return (bits[addr >> 6] >> (addr & 63)) & 1;
+    }
+
+    // count bits from addr on, wrapping at the end of the address space
+    // as I does; whole words at a time past the first
+    void setBits(std::vector<uint64_t> &bits, size_t addr, size_t count)
+    {
+        addr %= space;
+        while (count > 0)
+        {
+            const size_t shift = addr & 63;
+            const size_t run = count < 64 - shift ? count : 64 - shift;
+            const uint64_t ones = run == 64 ? ~uint64_t(0) : ((uint64_t(1) << run) - 1);
+            bits[addr >> 6] |= ones << shift;
+            count -= run;
+            addr = (addr + run) % space;
+        }
+    }
+
+    size_t space;
+    std::vector<uint64_t> code;
+    std::vector<uint64_t> data;
+};
+
+#endif
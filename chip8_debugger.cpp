@@ -0,0 +1,411 @@
+#include "chip8_debugger.h"
+#include <algorithm> // For std::fill and std::min
+
+namespace
+{
+    // Bytes FX33 (three BCD digits) or FX55 (V0..Vx) store from I on, 0 for
+    // any other instruction
+    int storeLength(uint16_t opcode)
+    {
+        if ((opcode & 0xF0FF) == 0xF033)
+            return 3;
+        if ((opcode & 0xF0FF) == 0xF055)
+            return ((opcode >> 8) & 0xF) + 1;
+        return 0;
+    }
+
+    uint16_t opcodeAt(const Chip8 &chip8)
+    {
+        const auto &memory = chip8.getMemory();
+        const uint16_t pc = chip8.getPC();
+        return static_cast<uint16_t>((memory[pc % memory.size()] << 8) | memory[(pc + 1) % memory.size()]);
+    }
+}
+
+void Chip8Debugger::clearAll()
+{
+    std::fill(flags.begin(), flags.end(), 0);
+    classBreaks.fill(false);
+    breakWrites.fill(0);
+    logWrites.fill(0);
+    watchCount = 0;
+    logCount = 0;
+}
+
+bool Chip8Debugger::run(Chip8 &chip8, int count, bool vip)
+{
+    stop = Stop::None;
+    // VIP cycles aren't instructions, the history can't be replayed by them
+    if (vip)
+        clearHistory();
+    else
+        follow(chip8);
+    const auto &memory = chip8.getMemory();
+    bool stopped = false;
+    for (int i = 0; i < count; ++i)
+    {
+        // Nothing executes until a key, the machine can count the time itself
+        if (chip8.isWaitingForKey())
+        {
+            if (vip)
+                chip8.emulateVipCycles(count - i);
+            else
+                chip8.emulateCycles(count - i);
+            break;
+        }
+
+        const uint16_t pc = chip8.getPC();
+        const uint16_t opcode = static_cast<uint16_t>((memory[pc % memory.size()] << 8) | memory[(pc + 1) % memory.size()]);
+        if (!resume && breaksBefore(chip8, opcode))
+        {
+            resume = true;
+            stopped = true;
+            break;
+        }
+        if (!vip)
+            checkpoint(chip8);
+
+        // A VIP cycle at a time runs an instruction whenever the budget for
+        // one has built up, the same ones a whole frame's budget would
+        const uint64_t before = chip8.getCycleCount();
+        const uint16_t index = chip8.getI();
+        const uint32_t logged = logCount ? bitsIn(logWrites, index, storeLength(opcode)) : 0;
+        uint8_t old[16];
+        for (uint32_t i = 0, bits = logged; bits; ++i, bits >>= 1)
+            old[i] = memory[(index + i) % memory.size()];
+        if (vip)
+            chip8.emulateVipCycles(1);
+        else
+            chip8.emulateCycle();
+        if (chip8.getCycleCount() != before)
+        {
+            record(pc, opcode);
+            noteAccesses(opcode, index);
+            resume = false;
+            for (uint32_t i = 0, bits = logged; bits; ++i, bits >>= 1)
+            {
+                if (!(bits & 1))
+                    continue;
+                const uint16_t addr = static_cast<uint16_t>((index + i) % memory.size());
+                if (!writes.push({chip8.getCycleCount(), pc, addr, old[i], memory[addr]}))
+                    ++dropped;
+            }
+        }
+    }
+    if (!vip)
+        historyEnd = chip8.getCycleCount();
+    return stopped;
+}
+
+void Chip8Debugger::step(Chip8 &chip8)
+{
+    follow(chip8);
+    const auto &memory = chip8.getMemory();
+    const uint16_t pc = chip8.getPC();
+    const uint16_t opcode = static_cast<uint16_t>((memory[pc % memory.size()] << 8) | memory[(pc + 1) % memory.size()]);
+    const uint16_t index = chip8.getI();
+    const bool runs = !chip8.isWaitingForKey();
+    if (runs)
+    {
+        record(pc, opcode);
+        checkpoint(chip8);
+    }
+    chip8.emulateCycle();
+    if (runs)
+        noteAccesses(opcode, index);
+    historyEnd = chip8.getCycleCount();
+    stop = Stop::Step;
+    stopAt = chip8.getPC();
+    resume = false;
+}
+
+void Chip8Debugger::noteKey(const Chip8 &chip8, int key, bool pressed)
+{
+    follow(chip8);
+    if (!checkpoints.empty())
+        inputs.push_back({chip8.getCycleCount(), static_cast<uint8_t>((key & 0xF) | (pressed ? KeyDown : 0))});
+}
+
+void Chip8Debugger::noteTimerTick(const Chip8 &chip8)
+{
+    follow(chip8);
+    if (!checkpoints.empty())
+        inputs.push_back({chip8.getCycleCount(), TimerTick});
+}
+
+bool Chip8Debugger::stepBack(Chip8 &chip8)
+{
+    follow(chip8);
+    uint64_t cycle;
+    if (!matchesHistory(chip8) || !findBack(chip8, chip8.getCycleCount(), false, cycle))
+        return false;
+    travelTo(chip8, cycle);
+    stop = Stop::Step;
+    stopAt = chip8.getPC();
+    resume = false;
+    return true;
+}
+
+bool Chip8Debugger::runBack(Chip8 &chip8)
+{
+    follow(chip8);
+    if (!matchesHistory(chip8))
+        return false;
+    uint64_t cycle;
+    if (findBack(chip8, chip8.getCycleCount(), true, cycle))
+    {
+        travelTo(chip8, cycle);
+        breaksBefore(chip8, opcodeAt(chip8));
+    }
+    else
+    {
+        travelTo(chip8, checkpoints.front().state.cycleCount);
+        stop = Stop::HistoryStart;
+        stopAt = chip8.getPC();
+    }
+    // Continuing runs the instruction it stopped in front of
+    resume = true;
+    return true;
+}
+
+uint64_t Chip8Debugger::historyCycles(const Chip8 &chip8) const
+{
+    if (checkpoints.empty() || chip8.getCycleCount() != historyEnd)
+        return 0;
+    return historyEnd - checkpoints.front().state.cycleCount;
+}
+
+void Chip8Debugger::clearHistory()
+{
+    checkpoints.clear();
+    inputs.clear();
+}
+
+void Chip8Debugger::follow(const Chip8 &chip8)
+{
+    if (chip8.getCycleCount() != historyEnd)
+        clearHistory();
+    historyEnd = chip8.getCycleCount();
+}
+
+// Called in front of each instruction the debugger runs. A full history
+// loses every other checkpoint of its older half, the oldest included, so
+// the spacing doubles going back while the newest stay checkpointInterval
+// apart.
+void Chip8Debugger::checkpoint(const Chip8 &chip8)
+{
+    if (!checkpoints.empty() && chip8.getCycleCount() - checkpoints.back().state.cycleCount < checkpointInterval)
+        return;
+    if (checkpoints.size() == checkpointCapacity)
+    {
+        size_t kept = 0;
+        for (size_t i = 0; i < checkpoints.size(); ++i)
+        {
+            if (i < checkpointCapacity / 2 && i % 2 == 0)
+                continue;
+            checkpoints[kept++] = std::move(checkpoints[i]);
+        }
+        checkpoints.resize(kept);
+        const size_t dropped = checkpoints.front().input;
+        inputs.erase(inputs.begin(), inputs.begin() + dropped);
+        for (Checkpoint &point : checkpoints)
+            point.input -= dropped;
+    }
+    checkpoints.push_back({chip8.state(), chip8.keyMask(), traceCount, inputs.size()});
+}
+
+void Chip8Debugger::applyInput(Chip8 &chip8, const Input &input) const
+{
+    if (input.code == TimerTick)
+        chip8.decrementTimers();
+    else
+        chip8.setKey(input.code & 0xF, (input.code & KeyDown) != 0);
+}
+
+// Replays the newest checkpoint up to where chip8 stands and compares. A
+// machine changed from outside since (a state load, a cheat, the memory
+// editor) doesn't match, and its history is dropped rather than replayed
+// into a past it never had.
+bool Chip8Debugger::matchesHistory(Chip8 &chip8)
+{
+    if (checkpoints.empty())
+        return false;
+    const Chip8::Snapshot now = chip8.state();
+    const uint16_t keys = chip8.keyMask();
+    const uint64_t hash = chip8.stateHash();
+    travelTo(chip8, now.cycleCount);
+    if (chip8.stateHash() == hash && chip8.keyMask() == keys)
+        return true;
+    chip8.restore(now);
+    chip8.setKeyMask(keys);
+    clearHistory();
+    return false;
+}
+
+bool Chip8Debugger::findBack(Chip8 &chip8, uint64_t end, bool breaks, uint64_t &found)
+{
+    const Stop savedStop = stop;
+    const uint16_t savedAt = stopAt;
+    bool hit = false;
+    // One segment between checkpoints at a time, newest first, stepped
+    // instruction by instruction; the last match in the segment wins
+    for (size_t k = checkpoints.size(); k-- > 0 && !hit;)
+    {
+        const Checkpoint &point = checkpoints[k];
+        if (point.state.cycleCount >= end)
+            continue;
+        chip8.restore(point.state);
+        chip8.setKeyMask(point.keys);
+        size_t next = point.input;
+        while (chip8.getCycleCount() < end)
+        {
+            for (; next < inputs.size() && inputs[next].cycle <= chip8.getCycleCount(); ++next)
+                applyInput(chip8, inputs[next]);
+            if (!chip8.isWaitingForKey() && (!breaks || breaksBefore(chip8, opcodeAt(chip8))))
+            {
+                found = chip8.getCycleCount();
+                hit = true;
+            }
+            chip8.emulateCycle();
+        }
+        end = point.state.cycleCount;
+    }
+    stop = savedStop;
+    stopAt = savedAt;
+    return hit;
+}
+
+// Restores the last checkpoint at or before cycle and runs the inputs
+// after it on the fast core. The trace is wound back by the instructions
+// undone, counted as cycles, which an FX0A wait in between overstates.
+void Chip8Debugger::travelTo(Chip8 &chip8, uint64_t cycle)
+{
+    size_t k = checkpoints.size();
+    while (k > 1 && checkpoints[k - 1].state.cycleCount > cycle)
+        --k;
+    const Checkpoint &point = checkpoints[k - 1];
+    chip8.restore(point.state);
+    chip8.setKeyMask(point.keys);
+    size_t next = point.input;
+    for (; next < inputs.size() && inputs[next].cycle <= cycle; ++next)
+    {
+        chip8.runUntil(inputs[next].cycle);
+        applyInput(chip8, inputs[next]);
+    }
+    chip8.runUntil(cycle);
+
+    traceCount = std::min(traceCount, point.traceCount + (cycle - point.state.cycleCount));
+    checkpoints.resize(k);
+    inputs.resize(next);
+    historyEnd = cycle;
+}
+
+void Chip8Debugger::setFlag(uint16_t addr, uint8_t flag, bool on)
+{
+    uint8_t &f = flags[addr % flags.size()];
+    f = static_cast<uint8_t>(on ? f | flag : f & ~flag);
+}
+
+int Chip8Debugger::setBit(Bitmap &bits, uint16_t addr, bool on)
+{
+    if (testBit(bits, addr) == on)
+        return 0;
+    addr %= Chip8::memorySize;
+    bits[addr >> 6] ^= uint64_t(1) << (addr & 63);
+    return on ? 1 : -1;
+}
+
+void Chip8Debugger::takeAccesses(Bitmap &read, Bitmap &written)
+{
+    read = readsSeen;
+    written = writesSeen;
+    readsSeen.fill(0);
+    writesSeen.fill(0);
+}
+
+void Chip8Debugger::setRange(Bitmap &bits, uint16_t start, int length)
+{
+    for (int i = 0; i < length; ++i)
+    {
+        const uint16_t addr = static_cast<uint16_t>((start + i) % Chip8::memorySize);
+        bits[addr >> 6] |= uint64_t(1) << (addr & 63);
+    }
+}
+
+void Chip8Debugger::noteAccesses(uint16_t opcode, uint16_t index)
+{
+    if ((opcode & 0xF000) == 0xD000)
+        setRange(readsSeen, index, (opcode & 0xF) ? (opcode & 0xF) : 32); // DXY0 draws 16x16 on SUPER-CHIP
+    else if ((opcode & 0xF0FF) == 0xF065)
+        setRange(readsSeen, index, ((opcode >> 8) & 0xF) + 1);
+    else
+        setRange(writesSeen, index, storeLength(opcode));
+}
+
+// The range spans two words at most; the word after the last is the first,
+// as I wraps around memory
+uint32_t Chip8Debugger::bitsIn(const Bitmap &bits, uint16_t start, int length)
+{
+    if (length == 0)
+        return 0;
+    start %= Chip8::memorySize;
+    const size_t word = start >> 6;
+    const unsigned shift = start & 63;
+    uint64_t window = bits[word] >> shift;
+    if (shift)
+        window |= bits[(word + 1) % bits.size()] << (64 - shift);
+    return static_cast<uint32_t>(window & ((uint64_t(1) << length) - 1));
+}
+
+bool Chip8Debugger::breaksBefore(const Chip8 &chip8, uint16_t opcode)
+{
+    const uint16_t pc = chip8.getPC();
+    if (flags[pc % flags.size()] & ExecFlag)
+    {
+        stop = Stop::Breakpoint;
+        stopAt = pc;
+        return true;
+    }
+    if (classBreaks[Chip8Profile::opcodeClass(opcode)])
+    {
+        stop = Stop::OpcodeClass;
+        stopAt = pc;
+        return true;
+    }
+    if (stackTrap && (opcode & 0xF000) == 0x2000 && chip8.getSP() >= Chip8::stackDepth)
+    {
+        stop = Stop::StackOverflow;
+        stopAt = pc;
+        return true;
+    }
+    if (stackTrap && opcode == 0x00EE && chip8.getSP() == 0)
+    {
+        stop = Stop::StackUnderflow;
+        stopAt = pc;
+        return true;
+    }
+    if (watchCount == 0)
+        return false;
+
+    // Stops at the lowest watched byte of the store
+    uint32_t hit = bitsIn(breakWrites, chip8.getI(), storeLength(opcode));
+    if (!hit)
+        return false;
+    int first = 0;
+    while (!(hit & 1))
+    {
+        hit >>= 1;
+        ++first;
+    }
+    stop = Stop::MemoryWrite;
+    stopAt = static_cast<uint16_t>((chip8.getI() + first) % Chip8::memorySize);
+    return true;
+}
+
+void Chip8Debugger::record(uint16_t pc, uint16_t opcode)
+{
+    if (trace.empty())
+        trace.resize(traceCapacity);
+    trace[traceCount % traceCapacity] = {pc, opcode};
+    ++traceCount;
+}
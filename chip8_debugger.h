@@ -0,0 +1,213 @@
+#ifndef CHIP8_DEBUGGER_H
+#define CHIP8_DEBUGGER_H
+
+#include "chip8.h"
+#include "chip8_profile.h"
+#include "spsc_queue.h"
+#include <array>   // For the opcode class set and watch bitmaps
+#include <cstdint> // For addresses and opcodes
+#include <vector>  // For the breakpoint map and the trace ring
+
+// Breakpoints and instruction trace for a Chip8. The debugger steps the
+// machine itself one instruction at a time through its public interface,
+// checking breakpoints before each one, so the core has no hooks and
+// emulateCycles runs at full speed whenever no debugger is stepping it.
+// Memory writes are caught before they happen: the only instructions that
+// store to memory (FX33, FX55) write from I on, a range known beforehand.
+// Watched bytes are a 4096-bit map that only those two opcodes look up,
+// a shift and a mask for the whole range.
+//
+// While it steps the machine the debugger also keeps a history to run
+// backwards through: a checkpoint of the whole machine every
+// checkpointInterval instructions, and the key changes and timer ticks
+// in between with the cycle they landed on. Going back restores the last
+// checkpoint before the target and runs forward to it with runUntil, so
+// no step back is more than an interval of the fast core away. Old
+// checkpoints are thinned out as new ones come in, dense near the cursor
+// and sparser the further back they are.
+class Chip8Debugger
+{
+public:
+    enum class Stop
+    {
+        None,
+        Breakpoint,     // PC reached a breakpoint
+        MemoryWrite,    // The next instruction writes a watched byte
+        OpcodeClass,    // The next instruction is of a watched class
+        StackOverflow,  // The next instruction is a 2NNN with the stack full (stack trap)
+        StackUnderflow, // The next instruction is a 00EE with the stack empty (stack trap)
+        Step,           // step() or stepBack() finished
+        HistoryStart    // runBack() found no break before the oldest checkpoint
+    };
+
+    struct TraceEntry
+    {
+        uint16_t pc;
+        uint16_t opcode;
+    };
+
+    // One logged byte written by FX33 or FX55
+    struct WriteEvent
+    {
+        uint64_t cycle; // Instruction count after the store
+        uint16_t pc;    // Of the store
+        uint16_t addr;
+        uint8_t before;
+        uint8_t after;
+    };
+
+    // One bit per address
+    using Bitmap = std::array<uint64_t, Chip8::memorySize / 64>;
+
+    static constexpr size_t traceCapacity = 1 << 20;
+    static constexpr size_t writeLogCapacity = 4096;
+    static constexpr uint64_t checkpointInterval = 1024;
+    static constexpr size_t checkpointCapacity = 512; // About 2.5 MB of machines
+
+    void setBreakpoint(uint16_t pc, bool on) { setFlag(pc, ExecFlag, on); }
+    bool hasBreakpoint(uint16_t pc) const { return flags[pc % flags.size()] & ExecFlag; }
+    void setWatch(uint16_t addr, bool on) { watchCount += setBit(breakWrites, addr, on); }
+    bool hasWatch(uint16_t addr) const { return testBit(breakWrites, addr); }
+
+    // Writes to a logged byte don't stop the machine, they go into the
+    // write log for the GUI to drain
+    void setWriteLog(uint16_t addr, bool on) { logCount += setBit(logWrites, addr, on); }
+    bool hasWriteLog(uint16_t addr) const { return testBit(logWrites, addr); }
+
+    // Producer end is the thread running the machine, the consumer may be
+    // any one other thread and needs no lock. Events past a full log are
+    // dropped and counted.
+    SpscQueue<WriteEvent, writeLogCapacity> &writeLog() { return writes; }
+    uint64_t droppedWrites() const { return dropped; }
+
+    // Classes as Chip8Profile counts them, e.g. "DXYN"
+    void setClassBreak(int cls, bool on) { classBreaks[cls] = on; }
+    bool hasClassBreak(int cls) const { return classBreaks[cls]; }
+
+    // Stops in front of a call past Chip8::stackDepth or a return with
+    // nothing to return to, which the core would wrap around unnoticed
+    void setStackTrap(bool on) { stackTrap = on; }
+    bool hasStackTrap() const { return stackTrap; }
+    void clearAll();
+
+    // Runs count instructions, or with vip count COSMAC VIP machine cycles,
+    // and stops early in front of an instruction a breakpoint matches. The
+    // instruction a previous stop was in front of runs without stopping
+    // again. True if it stopped, see lastStop.
+    bool run(Chip8 &chip8, int count, bool vip);
+
+    // Exactly one instruction, breakpoints ignored
+    void step(Chip8 &chip8);
+
+    // Input the machine got while the debugger steps it, for the history
+    void noteKey(const Chip8 &chip8, int key, bool pressed);
+    void noteTimerTick(const Chip8 &chip8);
+
+    // Back to the start of the instruction before the current one, or to
+    // the last instruction before it a breakpoint matches (the oldest
+    // checkpoint if none does). Later history is dropped, running forward
+    // again makes new. False if there is no history to go back through,
+    // as after the machine ran without the debugger, in VIP timing or was
+    // changed behind its back (a loaded state, a cheat).
+    bool stepBack(Chip8 &chip8);
+    bool runBack(Chip8 &chip8);
+
+    // Cycles stepBack can reach back across
+    uint64_t historyCycles(const Chip8 &chip8) const;
+    void clearHistory();
+
+    Stop lastStop() const { return stop; }
+    uint16_t stopAddress() const { return stopAt; } // PC, or the watched byte for MemoryWrite
+
+    // Executed instructions, oldest first, the last traceCapacity at most
+    size_t traceSize() const { return traceCount < traceCapacity ? traceCount : traceCapacity; }
+    TraceEntry traceAt(size_t i) const { return trace[(traceCount - traceSize() + i) % traceCapacity]; }
+    uint64_t tracedTotal() const { return traceCount; }
+    void clearTrace() { traceCount = 0; }
+
+    // Bytes the instructions the debugger ran read as data (DXYN's sprite,
+    // FX65) and wrote (FX33, FX55) since the last call, which clears them;
+    // the memory map's recent-access tints
+    void takeAccesses(Bitmap &read, Bitmap &written);
+
+private:
+    enum : uint8_t
+    {
+        ExecFlag = 1
+    };
+
+    static bool testBit(const Bitmap &bits, uint16_t addr)
+    {
+        addr %= Chip8::memorySize;
+        return (bits[addr >> 6] >> (addr & 63)) & 1;
+    }
+    static int setBit(Bitmap &bits, uint16_t addr, bool on); // +1, -1 or 0 set bits
+
+    // Bit i set if start + i is set in bits, for i below length (at most 16)
+    static uint32_t bitsIn(const Bitmap &bits, uint16_t start, int length);
+    static void setRange(Bitmap &bits, uint16_t start, int length); // Wrapping as I does
+    void noteAccesses(uint16_t opcode, uint16_t index);                // I as before the instruction
+
+    // A machine to return to, and where the trace and the input stood
+    struct Checkpoint
+    {
+        Chip8::Snapshot state;
+        uint16_t keys; // Held, which snapshots leave out
+        uint64_t traceCount;
+        size_t input; // First input after it
+    };
+
+    // A key change (key | KeyDown) or a timer tick, before the
+    // instruction at cycle
+    struct Input
+    {
+        uint64_t cycle;
+        uint8_t code;
+    };
+    enum : uint8_t
+    {
+        KeyDown = 0x10,
+        TimerTick = 0x20
+    };
+
+    void setFlag(uint16_t addr, uint8_t flag, bool on);
+    bool breaksBefore(const Chip8 &chip8, uint16_t opcode);
+    void record(uint16_t pc, uint16_t opcode);
+
+    void follow(const Chip8 &chip8); // Drops the history if chip8 moved without it
+    void checkpoint(const Chip8 &chip8);
+    void applyInput(Chip8 &chip8, const Input &input) const;
+    bool matchesHistory(Chip8 &chip8);
+
+    // The last cycle before end at which the instruction about to run is
+    // one that executes (not an FX0A wait) and, with breaks set, one a
+    // breakpoint matches; false if the history holds none
+    bool findBack(Chip8 &chip8, uint64_t end, bool breaks, uint64_t &found);
+    void travelTo(Chip8 &chip8, uint64_t cycle);
+
+    std::vector<uint8_t> flags = std::vector<uint8_t>(Chip8::memorySize, 0);
+    std::array<bool, Chip8Profile::classCount> classBreaks{};
+    bool stackTrap = false;
+    Bitmap breakWrites{}; // Watched bytes
+    Bitmap logWrites{};   // Logged bytes
+    int watchCount = 0;   // Set bits in each, so the range check is skipped without any
+    int logCount = 0;
+    Bitmap readsSeen{}; // See takeAccesses
+    Bitmap writesSeen{};
+
+    SpscQueue<WriteEvent, writeLogCapacity> writes;
+    uint64_t dropped = 0;
+
+    std::vector<TraceEntry> trace; // Allocated on the first instruction traced
+    uint64_t traceCount = 0;
+
+    std::vector<Checkpoint> checkpoints; // Oldest first
+    std::vector<Input> inputs;
+    uint64_t historyEnd = 0; // Cycle count the history last saw
+
+    Stop stop = Stop::None;
+    uint16_t stopAt = 0;
+    bool resume = false; // The next instruction is the one the last stop was in front of
+};
+
+#endif
@@ -0,0 +1,134 @@
+#include "chip8_disasm.h"
+#include <cstdio> // For std::snprintf
+
+namespace
+{
+    template <typename... Args>
+    std::string format(const char *pattern, Args... args)
+    {
+        char line[32];
+        std::snprintf(line, sizeof line, pattern, args...);
+        return line;
+    }
+}
+
+std::string Chip8Disassembler::text(uint16_t opcode, uint16_t next)
+{
+    const unsigned x = (opcode >> 8) & 0xF;
+    const unsigned y = (opcode >> 4) & 0xF;
+    const unsigned n = opcode & 0xF;
+    const unsigned nn = opcode & 0xFF;
+    const unsigned nnn = opcode & 0xFFF;
+
+    switch (opcode & 0xF000)
+    {
+    case 0x0000:
+        switch (opcode)
+        {
+        case 0x00E0:
+            return "CLS";
+        case 0x00EE:
+            return "RET";
+        case 0x00FB:
+            return "SCR";
+        case 0x00FC:
+            return "SCL";
+        case 0x00FD:
+            return "EXIT";
+        case 0x00FE:
+            return "LOW";
+        case 0x00FF:
+            return "HIGH";
+        }
+        if ((opcode & 0xFFF0) == 0x00C0)
+            return format("SCD %u", n);
+        if ((opcode & 0xFFF0) == 0x00D0)
+            return format("SCU %u", n);
+        return format("SYS 0x%03X", nnn);
+    case 0x1000:
+        return format("JP 0x%03X", nnn);
+    case 0x2000:
+        return format("CALL 0x%03X", nnn);
+    case 0x3000:
+        return format("SE V%X, 0x%02X", x, nn);
+    case 0x4000:
+        return format("SNE V%X, 0x%02X", x, nn);
+    case 0x5000:
+        if (n == 0)
+            return format("SE V%X, V%X", x, y);
+        if (n == 2)
+            return format("SAVE V%X-V%X", x, y);
+        if (n == 3)
+            return format("LOAD V%X-V%X", x, y);
+        break;
+    case 0x6000:
+        return format("LD V%X, 0x%02X", x, nn);
+    case 0x7000:
+        return format("ADD V%X, 0x%02X", x, nn);
+    case 0x8000:
+    {
+        static const char *const names[16] = {"LD", "OR", "AND", "XOR", "ADD", "SUB", "SHR", "SUBN",
+                                              nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, "SHL", nullptr};
+        if (names[n])
+            return format("%s V%X, V%X", names[n], x, y);
+        break;
+    }
+    case 0x9000:
+        if (n == 0)
+            return format("SNE V%X, V%X", x, y);
+        break;
+    case 0xA000:
+        return format("LD I, 0x%03X", nnn);
+    case 0xB000:
+        return format("JP V0, 0x%03X", nnn);
+    case 0xC000:
+        return format("RND V%X, 0x%02X", x, nn);
+    case 0xD000:
+        return format("DRW V%X, V%X, %u", x, y, n);
+    case 0xE000:
+        if (nn == 0x9E)
+            return format("SKP V%X", x);
+        if (nn == 0xA1)
+            return format("SKNP V%X", x);
+        break;
+    case 0xF000:
+        if (opcode == 0xF000)
+            return format("LD I, 0x%04X", next);
+        if (opcode == 0xF002)
+            return "AUDIO";
+        switch (nn)
+        {
+        case 0x01:
+            return format("PLANE %u", x);
+        case 0x07:
+            return format("LD V%X, DT", x);
+        case 0x0A:
+            return format("LD V%X, K", x);
+        case 0x15:
+            return format("LD DT, V%X", x);
+        case 0x18:
+            return format("LD ST, V%X", x);
+        case 0x1E:
+            return format("ADD I, V%X", x);
+        case 0x29:
+            return format("LD F, V%X", x);
+        case 0x30:
+            return format("LD HF, V%X", x);
+        case 0x33:
+            return format("LD B, V%X", x);
+        case 0x3A:
+            return format("PITCH V%X", x);
+        case 0x55:
+            return format("LD [I], V%X", x);
+        case 0x65:
+            return format("LD V%X, [I]", x);
+        case 0x75:
+            return format("LD R, V%X", x);
+        case 0x85:
+            return format("LD V%X, R", x);
+        }
+        break;
+    }
+    return format("DW 0x%04X", opcode);
+}
+
@@ -0,0 +1,20 @@
+#ifndef CHIP8_DISASM_H
+#define CHIP8_DISASM_H
+
+#include <cstdint> // For uint16_t
+#include <string>  // For the listing text
+
+// Opcode to assembly text in the usual CHIP-8 mnemonics (Cowgod's, plus
+// the SUPER-CHIP and XO-CHIP additions): "LD V3, 0x1F", "DRW V0, V1, 5".
+// Words that aren't instructions come out as "DW 0xNNNN".
+class Chip8Disassembler
+{
+public:
+    // Bytes the instruction takes, 4 for XO-CHIP's F000 NNNN
+    static int length(uint16_t opcode) { return opcode == 0xF000 ? 4 : 2; }
+
+    // next is the word after opcode, only read by F000 NNNN
+    static std::string text(uint16_t opcode, uint16_t next = 0);
+};
+
+#endif
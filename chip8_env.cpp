@@ -0,0 +1,169 @@
+#include "chip8_env.h"
+#include <cstring>     // For std::memcpy
+#include <new>         // For std::nothrow
+#include <type_traits> // For the state layout check
+
+static_assert(std::is_trivially_copyable<Chip8Env::State>::value, "states are copied as bytes");
+
+Chip8Env::Chip8Env(const uint8_t *rom, size_t size, int instructionsPerFrame, Chip8::Core core)
+    : machine(core), ipf(instructionsPerFrame)
+{
+    loaded = machine.loadROM(rom, size);
+}
+
+bool Chip8Env::addWatch(const Watch &watch)
+{
+    if (watchCount == maxWatches)
+        return false;
+    watches[watchCount] = watch;
+    last[watchCount] = watchValue(watch);
+    ++watchCount;
+    return true;
+}
+
+void Chip8Env::reset(uint64_t seed)
+{
+    machine.reset(); // Boots the ROM again
+    machine.seedRandom(seed);
+    rememberWatches();
+}
+
+Chip8Env::StepResult Chip8Env::step(uint16_t keys, int frames)
+{
+    // Only changed keys go through setKey, so holding one isn't a new press
+    uint16_t changed = keys ^ machine.keyMask();
+    for (int k = 0; k < 16; ++k)
+    {
+        if (changed & (1u << k))
+            machine.setKey(k, (keys >> k) & 1);
+    }
+    for (int f = 0; f < frames; ++f)
+        machine.runFrame(ipf);
+
+    StepResult result{0.0f, false};
+    for (int w = 0; w < watchCount; ++w)
+    {
+        const Watch &watch = watches[w];
+        int32_t value = watchValue(watch);
+        switch (watch.kind)
+        {
+        case CHIP8_WATCH_DELTA:
+            result.reward += watch.weight * static_cast<float>(value - last[w]);
+            break;
+        case CHIP8_WATCH_VALUE:
+            result.reward += watch.weight * static_cast<float>(value);
+            break;
+        case CHIP8_WATCH_END_EQUAL:
+            result.done = result.done || value == watch.target;
+            break;
+        }
+        last[w] = value;
+    }
+    return result;
+}
+
+void Chip8Env::cloneState(State &out) const
+{
+    machine.snapshot(out.machine);
+    out.keys = machine.keyMask();
+    out.last = last;
+}
+
+void Chip8Env::restoreState(const State &in)
+{
+    machine.restore(in.machine);
+    machine.setKeyMask(in.keys);
+    last = in.last;
+}
+
+size_t Chip8Env::copyPixels(uint8_t *out, size_t size) const
+{
+    const int w = machine.width();
+    const int h = machine.height();
+    if (size < static_cast<size_t>(w * h))
+        return 0;
+    for (int y = 0; y < h; ++y)
+    {
+        for (int x = 0; x < w; ++x)
+            *out++ = machine.pixel(x, y) ? 1 : 0;
+    }
+    return static_cast<size_t>(w * h);
+}
+
+int32_t Chip8Env::watchValue(const Watch &watch) const
+{
+    const auto &memory = machine.getMemory();
+    auto at = [&](unsigned offset)
+    { return static_cast<int32_t>(memory[(watch.address + offset) % memory.size()]); };
+    switch (watch.source)
+    {
+    case CHIP8_WATCH_WORD:
+        return (at(0) << 8) | at(1);
+    case CHIP8_WATCH_BCD:
+        return at(0) * 100 + at(1) * 10 + at(2);
+    case CHIP8_WATCH_REGISTER:
+        return machine.getV()[watch.address & 0xF];
+    case CHIP8_WATCH_BYTE:
+    default:
+        return at(0);
+    }
+}
+
+void Chip8Env::rememberWatches()
+{
+    for (int w = 0; w < watchCount; ++w)
+        last[w] = watchValue(watches[w]);
+}
+
+// C interface: the handle is the environment itself
+struct chip8_env
+{
+    Chip8Env env;
+};
+
+chip8_env *chip8_env_create(const uint8_t *rom, size_t size, int ipf)
+{
+    chip8_env *handle = new (std::nothrow) chip8_env{Chip8Env(rom, size, ipf)};
+    if (handle && !handle->env.isLoaded())
+    {
+        delete handle;
+        return nullptr;
+    }
+    return handle;
+}
+
+void chip8_env_destroy(chip8_env *env) { delete env; }
+
+int chip8_env_add_watch(chip8_env *env, const chip8_watch *watch) { return env->env.addWatch(*watch) ? 1 : 0; }
+
+void chip8_env_reset(chip8_env *env, uint64_t seed) { env->env.reset(seed); }
+
+float chip8_env_step(chip8_env *env, uint16_t keys, int frames, int *done)
+{
+    Chip8Env::StepResult result = env->env.step(keys, frames);
+    if (done)
+        *done = result.done ? 1 : 0;
+    return result.reward;
+}
+
+const uint64_t *chip8_env_screen(const chip8_env *env) { return env->env.screen().data(); }
+
+int chip8_env_is_hires(const chip8_env *env) { return env->env.isHires() ? 1 : 0; }
+
+size_t chip8_env_pixels(const chip8_env *env, uint8_t *out, size_t size) { return env->env.copyPixels(out, size); }
+
+size_t chip8_env_state_size(void) { return sizeof(Chip8Env::State); }
+
+void chip8_env_clone_state(const chip8_env *env, void *out)
+{
+    Chip8Env::State state;
+    env->env.cloneState(state);
+    std::memcpy(out, &state, sizeof state);
+}
+
+void chip8_env_restore_state(chip8_env *env, const void *in)
+{
+    Chip8Env::State state;
+    std::memcpy(&state, in, sizeof state);
+    env->env.restoreState(state);
+}
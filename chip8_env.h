@@ -0,0 +1,76 @@
+#ifndef CHIP8_ENV_H
+#define CHIP8_ENV_H
+
+#include "chip8.h"
+#include "chip8_env_c.h"
+#include <array>   // For the watch list
+#include <cstdint> // For uint8_t, uint16_t
+
+// Reinforcement-learning environment over one classic machine, shaped
+// like a gym environment: reset with a seed, step with the keys held for
+// some frames, get back a reward from memory watches and whether the
+// episode ended. Nothing allocates after construction, and the whole
+// state including the watches' last values is a trivially copyable State
+// for cloning and restoring.
+class Chip8Env
+{
+public:
+    using Watch = chip8_watch;
+    static constexpr int maxWatches = CHIP8_ENV_MAX_WATCHES;
+
+    // Everything step and reset touch
+    struct State
+    {
+        Chip8::Snapshot machine;
+        uint16_t keys;
+        std::array<int32_t, maxWatches> last; // Watch values after the previous step
+    };
+
+    struct StepResult
+    {
+        float reward;
+        bool done;
+    };
+
+    // ipf instructions per frame, as the GUI's speed menu counts them
+    Chip8Env(const uint8_t *rom, size_t size, int ipf = 10, Chip8::Core core = Chip8::Core::Table);
+
+    bool isLoaded() const { return loaded; }
+
+    // False once maxWatches are set
+    bool addWatch(const Watch &watch);
+    void clearWatches() { watchCount = 0; }
+
+    // Boots the ROM again with CXNN seeded, no keys down
+    void reset(uint64_t seed);
+
+    // Holds keys (bit k = key k) for frames frames of ipf instructions and
+    // a timer tick each. Presses and releases reach FX0A like real ones.
+    StepResult step(uint16_t keys, int frames);
+
+    void cloneState(State &out) const;
+    void restoreState(const State &in);
+
+    // Chip8::gfx layout, see isHires for which part is shown
+    const std::array<uint64_t, 64 * Chip8::rowWords> &screen() const { return machine.gfx; }
+    bool isHires() const { return machine.isHires(); }
+
+    // One byte per pixel, 0 or 1, row by row; returns the pixel count or 0
+    // if size is too small for the current resolution
+    size_t copyPixels(uint8_t *out, size_t size) const;
+
+    const Chip8 &chip8() const { return machine; }
+
+private:
+    int32_t watchValue(const Watch &watch) const;
+    void rememberWatches();
+
+    Chip8 machine;
+    bool loaded = false;
+    int ipf;
+    std::array<Watch, maxWatches> watches{};
+    std::array<int32_t, maxWatches> last{};
+    int watchCount = 0;
+};
+
+#endif
@@ -0,0 +1,83 @@
+#ifndef CHIP8_ENV_C_H
+#define CHIP8_ENV_C_H
+
+/* C interface to Chip8Env, for Python (ctypes, cffi) and other languages.
+   Build chip8_env.cpp with the core sources as a shared library, see the
+   README. Every call takes the handle chip8_env_create returned. */
+
+#include <stddef.h> /* For size_t */
+#include <stdint.h> /* For the fixed-width types */
+
+#if defined(_WIN32) && defined(CHIP8_ENV_BUILD)
+#define CHIP8_ENV_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define CHIP8_ENV_API __declspec(dllimport)
+#else
+#define CHIP8_ENV_API
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+#define CHIP8_ENV_MAX_WATCHES 16
+
+    /* Where a watch reads its value */
+    enum chip8_watch_source
+    {
+        CHIP8_WATCH_BYTE = 0, /* memory[address] */
+        CHIP8_WATCH_WORD = 1, /* memory[address] << 8 | memory[address + 1] */
+        CHIP8_WATCH_BCD = 2,  /* Three FX33 digits from address on */
+        CHIP8_WATCH_REGISTER = 3 /* V[address & 0xF] */
+    };
+
+    /* What a step makes of the value */
+    enum chip8_watch_kind
+    {
+        CHIP8_WATCH_DELTA = 0,    /* reward += weight * (value - value before the step) */
+        CHIP8_WATCH_VALUE = 1,    /* reward += weight * value */
+        CHIP8_WATCH_END_EQUAL = 2 /* done when value == target */
+    };
+
+    typedef struct chip8_watch
+    {
+        int source; /* chip8_watch_source */
+        int kind;   /* chip8_watch_kind */
+        uint16_t address;
+        int32_t target;
+        float weight;
+    } chip8_watch;
+
+    typedef struct chip8_env chip8_env;
+
+    /* NULL if the ROM doesn't fit; ipf instructions per frame */
+    CHIP8_ENV_API chip8_env *chip8_env_create(const uint8_t *rom, size_t size, int ipf);
+    CHIP8_ENV_API void chip8_env_destroy(chip8_env *env);
+
+    /* 0 once CHIP8_ENV_MAX_WATCHES are set */
+    CHIP8_ENV_API int chip8_env_add_watch(chip8_env *env, const chip8_watch *watch);
+
+    CHIP8_ENV_API void chip8_env_reset(chip8_env *env, uint64_t seed);
+
+    /* Holds keys (bit k = key k) for frames frames; *done may be NULL */
+    CHIP8_ENV_API float chip8_env_step(chip8_env *env, uint16_t keys, int frames, int *done);
+
+    /* 128 words, two per row, bit 63 of a row's first word leftmost;
+       lo-res uses the first word of the top 32 rows */
+    CHIP8_ENV_API const uint64_t *chip8_env_screen(const chip8_env *env);
+    CHIP8_ENV_API int chip8_env_is_hires(const chip8_env *env);
+
+    /* One byte per pixel; returns the pixel count, 0 if size is too small */
+    CHIP8_ENV_API size_t chip8_env_pixels(const chip8_env *env, uint8_t *out, size_t size);
+
+    /* States are plain bytes of chip8_env_state_size() */
+    CHIP8_ENV_API size_t chip8_env_state_size(void);
+    CHIP8_ENV_API void chip8_env_clone_state(const chip8_env *env, void *out);
+    CHIP8_ENV_API void chip8_env_restore_state(chip8_env *env, const void *in);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
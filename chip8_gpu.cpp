@@ -0,0 +1,782 @@
+#include "chip8_gpu.h"
+#include "chip8.h"
+#include <cstring> // For std::memcpy
+#include <memory>  // For the boot machine
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+namespace
+{
+    // Compute entry points, past what the renderers load
+#define GPU_GL_FUNCTIONS(X)                              \
+    X(PFNGLGENBUFFERSPROC, GenBuffers)                   \
+    X(PFNGLBINDBUFFERPROC, BindBuffer)                   \
+    X(PFNGLBUFFERDATAPROC, BufferData)                   \
+    X(PFNGLBUFFERSUBDATAPROC, BufferSubData)             \
+    X(PFNGLGETBUFFERSUBDATAPROC, GetBufferSubData)       \
+    X(PFNGLDELETEBUFFERSPROC, DeleteBuffers)             \
+    X(PFNGLBINDBUFFERBASEPROC, BindBufferBase)           \
+    X(PFNGLCREATESHADERPROC, CreateShader)               \
+    X(PFNGLSHADERSOURCEPROC, ShaderSource)               \
+    X(PFNGLCOMPILESHADERPROC, CompileShader)             \
+    X(PFNGLGETSHADERIVPROC, GetShaderiv)                 \
+    X(PFNGLGETSHADERINFOLOGPROC, GetShaderInfoLog)       \
+    X(PFNGLDELETESHADERPROC, DeleteShader)               \
+    X(PFNGLCREATEPROGRAMPROC, CreateProgram)             \
+    X(PFNGLATTACHSHADERPROC, AttachShader)               \
+    X(PFNGLLINKPROGRAMPROC, LinkProgram)                 \
+    X(PFNGLGETPROGRAMIVPROC, GetProgramiv)               \
+    X(PFNGLGETPROGRAMINFOLOGPROC, GetProgramInfoLog)     \
+    X(PFNGLUSEPROGRAMPROC, UseProgram)                   \
+    X(PFNGLDELETEPROGRAMPROC, DeleteProgram)             \
+    X(PFNGLGETUNIFORMLOCATIONPROC, GetUniformLocation)   \
+    X(PFNGLUNIFORM1IPROC, Uniform1i)                     \
+    X(PFNGLDISPATCHCOMPUTEPROC, DispatchCompute)         \
+    X(PFNGLMEMORYBARRIERPROC, MemoryBarrier)             \
+    X(PFNGLGETINTEGER64VPROC, GetInteger64v)             \
+    X(PFNGLGETINTEGERI_VPROC, GetIntegeri_v)
+
+    struct GpuFunctions
+    {
+#define GPU_GL_DECLARE(type, name) type name = nullptr;
+        GPU_GL_FUNCTIONS(GPU_GL_DECLARE)
+#undef GPU_GL_DECLARE
+    };
+    GpuFunctions gpu;
+
+    // State fields, each an array over the lanes
+    constexpr int fieldV = 0; // 16 of them
+    constexpr int fieldPC = 16;
+    constexpr int fieldI = 17;
+    constexpr int fieldKeys = 18;
+    constexpr int fieldSP = 19;
+    constexpr int fieldDelay = 20;
+    constexpr int fieldSound = 21;
+    constexpr int fieldHires = 22;
+    constexpr int fieldWaitReg = 23; // -1 when not in FX0A
+    constexpr int fieldWaitKey = 24;
+    constexpr int fieldRng = 25; // Low half, then high half
+    constexpr int fieldStack = 27;
+    constexpr int fieldRpl = 43;
+    constexpr int fieldCount = 59;
+
+    constexpr int memoryWords = 1024;
+    constexpr int screenWords = 256;
+    constexpr int watchWords = 5; // source, kind, address, target, weight bits
+    constexpr uint32_t resetBit = 1u << 16;
+    constexpr int groupSize = 64;
+
+    // The shader follows Chip8Batch::execute line for line. GLSL has no
+    // 64-bit integers everywhere, so the generator and screen words are
+    // pairs of 32-bit halves.
+    const char *const kernelSource = R"(
+layout(local_size_x = GROUP_SIZE) in;
+
+layout(std430, binding = 0) buffer State { uint state[]; };
+layout(std430, binding = 1) buffer Memory { uint memory[]; };
+layout(std430, binding = 2) buffer Screen { uint screen[]; };
+layout(std430, binding = 3) readonly buffer Inputs { uint inputs[]; };
+layout(std430, binding = 4) writeonly buffer Results { uint results[]; };
+layout(std430, binding = 5) buffer Last { int last[]; };
+layout(std430, binding = 6) readonly buffer Constants { uint boot[MEMORY_WORDS]; uint watches[]; };
+
+uniform int laneCount;
+uniform int frames;
+uniform int ipf;
+uniform int watchCount;
+uniform int rememberFrom;
+
+uint lanes;
+uint lane;
+uint V[16];
+uint PC, I, keys, sp, delayTimer, soundTimer;
+bool hires;
+int waitReg, waitKey;
+uvec2 rng; // Low, high
+
+#define FIELD(f) state[uint(f) * lanes + lane]
+
+uint readByte(uint addr)
+{
+    addr &= 0xFFFu;
+    return (memory[(addr >> 2) * lanes + lane] >> ((addr & 3u) * 8u)) & 0xFFu;
+}
+
+void writeByte(uint addr, uint value)
+{
+    addr &= 0xFFFu;
+    uint at = (addr >> 2) * lanes + lane;
+    uint shift = (addr & 3u) * 8u;
+    memory[at] = (memory[at] & ~(0xFFu << shift)) | ((value & 0xFFu) << shift);
+}
+
+// PCG32 XSH-RR as Chip8: state * 6364136223846793005 + 1442695040888963407
+uint nextRandom()
+{
+    uvec2 old = rng;
+    uint high, low;
+    umulExtended(old.x, 0x4C957F2Du, high, low);
+    high += old.x * 0x5851F42Du + old.y * 0x4C957F2Du;
+    uint carry;
+    rng.x = uaddCarry(low, 0xF767814Fu, carry);
+    rng.y = high + 0x14057B7Eu + carry;
+    uvec2 t = uvec2(old.x ^ ((old.x >> 18) | (old.y << 14)), old.y ^ (old.y >> 18));
+    uint xorshifted = (t.x >> 27) | (t.y << 5);
+    uint rot = old.y >> 27;
+    uint result = (xorshifted >> rot) | (xorshifted << ((32u - rot) & 31u));
+    return result >> 24;
+}
+
+void seedRandom(uvec2 seed)
+{
+    rng = uvec2(0u);
+    nextRandom();
+    uint carry;
+    rng.x = uaddCarry(rng.x, seed.x, carry);
+    rng.y += seed.y + carry;
+    nextRandom();
+}
+
+int watchValue(int w)
+{
+    uint base = uint(w) * WATCH_WORDS;
+    uint source = watches[base];
+    uint addr = watches[base + 2u];
+    if (source == 1u)
+        return int((readByte(addr) << 8) | readByte(addr + 1u));
+    if (source == 2u)
+        return int(readByte(addr) * 100u + readByte(addr + 1u) * 10u + readByte(addr + 2u));
+    if (source == 3u)
+        return int(V[addr & 15u]);
+    return int(readByte(addr));
+}
+
+// Chip8Batch::setKey for a key that changed, so a press is always new
+void toggleKey(uint key)
+{
+    uint bit = 1u << key;
+    bool pressed = (keys & bit) == 0u;
+    if (waitReg >= 0 && pressed && waitKey < 0)
+    {
+        waitKey = int(key);
+    }
+    else if (waitReg >= 0 && !pressed && int(key) == waitKey)
+    {
+        V[waitReg] = key;
+        waitReg = -1;
+        waitKey = -1;
+    }
+    keys ^= bit;
+}
+
+// word in 0..255 of the lane's screen; true if it had any of bits set
+bool xorScreen(uint word, uint bits)
+{
+    if (bits == 0u)
+        return false;
+    uint at = word * lanes + lane;
+    uint old = screen[at];
+    screen[at] = old ^ bits;
+    return (old & bits) != 0u;
+}
+
+void clearScreen()
+{
+    for (uint w = 0u; w < SCREEN_WORDS; ++w)
+        screen[w * lanes + lane] = 0u;
+}
+
+// Rows are four words in hi-res and the first two of them in lo-res, so
+// both resolutions share Chip8::gfx's layout; a resolution change clears
+// the whole screen, so the words lo-res leaves alone stay zero.
+bool draw(uint vx, uint vy, uint addr, uint n)
+{
+    uint columns = hires ? 128u : 64u;
+    uint height = hires ? 64u : 32u;
+    uint words = columns / 32u;
+    uint px = vx % columns;
+    uint py = vy % height;
+    bool wide = hires && n == 0u; // 16x16
+    uint rows = min(wide ? 16u : n, height - py);
+    uint word = px >> 5;
+    uint shift = px & 31u;
+    bool collision = false;
+    for (uint row = 0u; row < rows; ++row)
+    {
+        uint line = wide ? (readByte(addr + 2u * row) << 24) | (readByte(addr + 2u * row + 1u) << 16)
+                         : readByte(addr + row) << 24;
+        uint base = (py + row) * 4u + word;
+        collision = xorScreen(base, line >> shift) || collision;
+        if (shift != 0u && word + 1u < words)
+            collision = xorScreen(base + 1u, line << (32u - shift)) || collision;
+    }
+    return collision;
+}
+
+void execute(uint opcode)
+{
+    uint x = (opcode >> 8) & 0xFu;
+    uint y = (opcode >> 4) & 0xFu;
+    uint nn = opcode & 0xFFu;
+    uint nnn = opcode & 0xFFFu;
+    uint vx = V[x];
+    uint vy = V[y];
+    uint height = hires ? 64u : 32u;
+    uint words = hires ? 4u : 2u;
+
+    switch (opcode >> 12)
+    {
+    case 0x0u:
+        if (opcode == 0x00E0u)
+            clearScreen();
+        else if (opcode == 0x00EEu)
+        {
+            sp = (sp - 1u) & 0xFFu;
+            PC = FIELD(FIELD_STACK + (sp & 15u));
+        }
+        else if ((opcode & 0xFFF0u) == 0x00C0u) // Scroll down N rows
+        {
+            uint rows = opcode & 0xFu;
+            for (uint row = height; row-- > 0u;)
+            {
+                for (uint w = 0u; w < words; ++w)
+                    screen[(row * 4u + w) * lanes + lane] = row >= rows ? screen[((row - rows) * 4u + w) * lanes + lane] : 0u;
+            }
+        }
+        else if (opcode == 0x00FBu) // Scroll right 4
+        {
+            for (uint row = 0u; row < height; ++row)
+            {
+                uint base = row * 4u;
+                for (uint w = words - 1u; w > 0u; --w)
+                    screen[(base + w) * lanes + lane] = (screen[(base + w) * lanes + lane] >> 4) | (screen[(base + w - 1u) * lanes + lane] << 28);
+                screen[base * lanes + lane] >>= 4;
+            }
+        }
+        else if (opcode == 0x00FCu) // Scroll left 4
+        {
+            for (uint row = 0u; row < height; ++row)
+            {
+                uint base = row * 4u;
+                for (uint w = 0u; w + 1u < words; ++w)
+                    screen[(base + w) * lanes + lane] = (screen[(base + w) * lanes + lane] << 4) | (screen[(base + w + 1u) * lanes + lane] >> 28);
+                screen[(base + words - 1u) * lanes + lane] <<= 4;
+            }
+        }
+        else if (opcode == 0x00FEu || opcode == 0x00FFu) // Resolution change clears the screen
+        {
+            hires = opcode == 0x00FFu;
+            clearScreen();
+        }
+        break;
+    case 0x1u:
+        PC = nnn;
+        break;
+    case 0x2u:
+        FIELD(FIELD_STACK + (sp & 15u)) = PC;
+        sp = (sp + 1u) & 0xFFu;
+        PC = nnn;
+        break;
+    case 0x3u:
+        PC += vx == nn ? 2u : 0u;
+        break;
+    case 0x4u:
+        PC += vx != nn ? 2u : 0u;
+        break;
+    case 0x5u:
+        PC += vx == vy ? 2u : 0u;
+        break;
+    case 0x6u:
+        V[x] = nn;
+        break;
+    case 0x7u:
+        V[x] = (vx + nn) & 0xFFu;
+        break;
+    case 0x8u:
+        switch (opcode & 0xFu)
+        {
+        case 0x0u:
+            V[x] = vy;
+            break;
+        case 0x1u:
+            V[x] = vx | vy;
+            break;
+        case 0x2u:
+            V[x] = vx & vy;
+            break;
+        case 0x3u:
+            V[x] = vx ^ vy;
+            break;
+        case 0x4u:
+            V[x] = (vx + vy) & 0xFFu;
+            V[15] = vx + vy > 0xFFu ? 1u : 0u;
+            break;
+        case 0x5u:
+            V[x] = (vx - vy) & 0xFFu;
+            V[15] = vx >= vy ? 1u : 0u; // Last, VF may be Vx
+            break;
+        case 0x6u:
+            V[x] = vx >> 1;
+            V[15] = vx & 1u;
+            break;
+        case 0x7u:
+            V[x] = (vy - vx) & 0xFFu;
+            V[15] = vy >= vx ? 1u : 0u;
+            break;
+        case 0xEu:
+            V[x] = (vx << 1) & 0xFFu;
+            V[15] = vx >> 7;
+            break;
+        }
+        break;
+    case 0x9u:
+        PC += vx != vy ? 2u : 0u;
+        break;
+    case 0xAu:
+        I = nnn;
+        break;
+    case 0xBu:
+        PC = nnn + V[0];
+        break;
+    case 0xCu:
+        V[x] = nextRandom() & nn;
+        break;
+    case 0xDu:
+        V[15] = draw(vx, vy, I, opcode & 0xFu) ? 1u : 0u;
+        break;
+    case 0xEu:
+        if (nn == 0x9Eu || nn == 0xA1u)
+            PC += (((keys >> (vx & 15u)) & 1u) == (nn == 0x9Eu ? 1u : 0u)) ? 2u : 0u;
+        break;
+    default:
+        switch (nn)
+        {
+        case 0x07u:
+            V[x] = delayTimer;
+            break;
+        case 0x0Au: // Halt until a key goes down and up, see setKey
+            waitReg = int(x);
+            waitKey = -1;
+            break;
+        case 0x15u:
+            delayTimer = vx;
+            break;
+        case 0x18u:
+            soundTimer = vx;
+            break;
+        case 0x1Eu:
+            I = (I + vx) & 0xFFFFu;
+            break;
+        case 0x29u:
+            I = 0x050u + (vx & 15u) * 5u;
+            break;
+        case 0x30u:
+            I = 0x0A0u + (vx & 15u) * 10u;
+            break;
+        case 0x33u:
+            writeByte(I, vx / 100u);
+            writeByte(I + 1u, (vx / 10u) % 10u);
+            writeByte(I + 2u, vx % 10u);
+            break;
+        case 0x55u:
+            for (uint i = 0u; i <= x; ++i)
+                writeByte(I + i, V[i]);
+            I = (I + x + 1u) & 0xFFFFu;
+            break;
+        case 0x65u:
+            for (uint i = 0u; i <= x; ++i)
+                V[i] = readByte(I + i);
+            I = (I + x + 1u) & 0xFFFFu;
+            break;
+        case 0x75u:
+            for (uint i = 0u; i <= x; ++i)
+                FIELD(FIELD_RPL + i) = V[i];
+            break;
+        case 0x85u:
+            for (uint i = 0u; i <= x; ++i)
+                V[i] = FIELD(FIELD_RPL + i);
+            break;
+        }
+        break;
+    }
+    PC &= 0xFFFFu;
+}
+
+void main()
+{
+    lanes = uint(laneCount);
+    lane = gl_GlobalInvocationID.x;
+    if (lane >= lanes)
+        return;
+
+    uint control = inputs[lane];
+    if ((control & RESET_BIT) != 0u)
+    {
+        // Chip8Batch::reset, then seedRandom
+        for (uint f = 0u; f < FIELD_COUNT; ++f)
+            FIELD(f) = 0u;
+        FIELD(FIELD_PC) = 0x200u;
+        FIELD(FIELD_WAIT_REG) = uint(-1);
+        FIELD(FIELD_WAIT_KEY) = uint(-1);
+        for (uint w = 0u; w < MEMORY_WORDS; ++w)
+            memory[w * lanes + lane] = boot[w];
+        clearScreen();
+    }
+
+    for (uint r = 0u; r < 16u; ++r)
+        V[r] = FIELD(FIELD_V + r);
+    PC = FIELD(FIELD_PC);
+    I = FIELD(FIELD_I);
+    keys = FIELD(FIELD_KEYS);
+    sp = FIELD(FIELD_SP);
+    delayTimer = FIELD(FIELD_DELAY);
+    soundTimer = FIELD(FIELD_SOUND);
+    hires = FIELD(FIELD_HIRES) != 0u;
+    waitReg = int(FIELD(FIELD_WAIT_REG));
+    waitKey = int(FIELD(FIELD_WAIT_KEY));
+    rng = uvec2(FIELD(FIELD_RNG), FIELD(FIELD_RNG + 1u));
+
+    bool reset = (control & RESET_BIT) != 0u;
+    if (reset)
+        seedRandom(uvec2(inputs[lanes + lane], inputs[2u * lanes + lane]));
+    for (int w = reset ? 0 : rememberFrom; w < watchCount; ++w)
+        last[uint(w) * lanes + lane] = watchValue(w);
+
+    // Chip8Env::step: only changed keys go through setKey
+    uint held = control & 0xFFFFu;
+    uint changed = held ^ keys;
+    for (uint k = 0u; k < 16u; ++k)
+    {
+        if ((changed & (1u << k)) != 0u)
+            toggleKey(k);
+    }
+
+    for (int f = 0; f < frames; ++f)
+    {
+        for (int n = 0; n < ipf && waitReg < 0; ++n)
+        {
+            uint opcode = (readByte(PC) << 8) | readByte(PC + 1u);
+            PC = (PC + 2u) & 0xFFFFu;
+            execute(opcode);
+        }
+        if (delayTimer > 0u)
+            --delayTimer;
+        if (soundTimer > 0u)
+            --soundTimer;
+    }
+
+    float reward = 0.0;
+    bool done = false;
+    for (int w = 0; w < watchCount; ++w)
+    {
+        uint base = uint(w) * WATCH_WORDS;
+        int value = watchValue(w);
+        uint kind = watches[base + 1u];
+        float weight = uintBitsToFloat(watches[base + 4u]);
+        uint at = uint(w) * lanes + lane;
+        if (kind == 0u)
+            reward += weight * float(value - last[at]);
+        else if (kind == 1u)
+            reward += weight * float(value);
+        else if (kind == 2u)
+            done = done || value == int(watches[base + 3u]);
+        last[at] = value;
+    }
+    results[lane] = floatBitsToUint(reward);
+    results[lanes + lane] = done ? 1u : 0u;
+
+    for (uint r = 0u; r < 16u; ++r)
+        FIELD(FIELD_V + r) = V[r];
+    FIELD(FIELD_PC) = PC;
+    FIELD(FIELD_I) = I;
+    FIELD(FIELD_KEYS) = keys;
+    FIELD(FIELD_SP) = sp;
+    FIELD(FIELD_DELAY) = delayTimer;
+    FIELD(FIELD_SOUND) = soundTimer;
+    FIELD(FIELD_HIRES) = hires ? 1u : 0u;
+    FIELD(FIELD_WAIT_REG) = uint(waitReg);
+    FIELD(FIELD_WAIT_KEY) = uint(waitKey);
+    FIELD(FIELD_RNG) = rng.x;
+    FIELD(FIELD_RNG + 1u) = rng.y;
+}
+)";
+
+    unsigned compileKernel(std::string &log)
+    {
+        // The kernel's layout constants come from the ones above
+        std::string constants = "#version 430\n";
+        auto define = [&constants](const char *name, unsigned value)
+        { constants += "#define " + std::string(name) + " " + std::to_string(value) + "u\n"; };
+        define("FIELD_V", fieldV);
+        define("FIELD_PC", fieldPC);
+        define("FIELD_I", fieldI);
+        define("FIELD_KEYS", fieldKeys);
+        define("FIELD_SP", fieldSP);
+        define("FIELD_DELAY", fieldDelay);
+        define("FIELD_SOUND", fieldSound);
+        define("FIELD_HIRES", fieldHires);
+        define("FIELD_WAIT_REG", fieldWaitReg);
+        define("FIELD_WAIT_KEY", fieldWaitKey);
+        define("FIELD_RNG", fieldRng);
+        define("FIELD_STACK", fieldStack);
+        define("FIELD_RPL", fieldRpl);
+        define("FIELD_COUNT", fieldCount);
+        define("MEMORY_WORDS", memoryWords);
+        define("SCREEN_WORDS", screenWords);
+        define("WATCH_WORDS", watchWords);
+        define("RESET_BIT", resetBit);
+        define("GROUP_SIZE", groupSize);
+        const char *sources[] = {constants.c_str(), kernelSource};
+        GLuint shader = gpu.CreateShader(GL_COMPUTE_SHADER);
+        gpu.ShaderSource(shader, 2, sources, nullptr);
+        gpu.CompileShader(shader);
+        GLint ok = GL_FALSE;
+        gpu.GetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+        if (ok != GL_TRUE)
+        {
+            char text[1024] = {};
+            gpu.GetShaderInfoLog(shader, sizeof text, nullptr, text);
+            log = text;
+            gpu.DeleteShader(shader);
+            return 0;
+        }
+        GLuint program = gpu.CreateProgram();
+        gpu.AttachShader(program, shader);
+        gpu.LinkProgram(program);
+        gpu.DeleteShader(shader); // Freed with the program from here on
+        gpu.GetProgramiv(program, GL_LINK_STATUS, &ok);
+        if (ok != GL_TRUE)
+        {
+            char text[1024] = {};
+            gpu.GetProgramInfoLog(program, sizeof text, nullptr, text);
+            log = text;
+            gpu.DeleteProgram(program);
+            return 0;
+        }
+        return program;
+    }
+}
+
+Chip8Gpu::Chip8Gpu(LookupFunction lookup, size_t laneCount, int instructionsPerFrame)
+    : lanes(laneCount), ipf(instructionsPerFrame), input(laneCount * 3, 0), stepRewards(laneCount, 0.0f),
+      stepDone(laneCount, 0)
+{
+    if (!build(lookup))
+        return;
+    loadROM(nullptr, 0);
+}
+
+Chip8Gpu::~Chip8Gpu()
+{
+    if (gpu.DeleteBuffers)
+        gpu.DeleteBuffers(bufferCount, buffers);
+    if (program)
+        gpu.DeleteProgram(program);
+}
+
+bool Chip8Gpu::build(LookupFunction lookup)
+{
+    bool complete = true;
+#define GPU_GL_LOAD(type, name)                           \
+    gpu.name = reinterpret_cast<type>(lookup("gl" #name)); \
+    complete = complete && gpu.name != nullptr;
+    GPU_GL_FUNCTIONS(GPU_GL_LOAD)
+#undef GPU_GL_LOAD
+    if (!complete)
+    {
+        failure = "OpenGL 4.3 compute shaders are not available";
+        return false;
+    }
+    if (lanes == 0 || lanes > size_t(UINT32_MAX) / screenWords)
+    {
+        failure = "lane count out of range";
+        return false;
+    }
+
+    // Memory is the largest buffer; GL only promises 16 MB of it
+    GLint64 largest = 0;
+    gpu.GetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &largest);
+    GLint groups = 0;
+    gpu.GetIntegeri_v(GL_MAX_COMPUTE_WORK_GROUP_COUNT, 0, &groups);
+    const size_t memoryBytes = lanes * memoryWords * sizeof(uint32_t);
+    if (static_cast<GLint64>(memoryBytes) > largest || (lanes + groupSize - 1) / groupSize > static_cast<size_t>(groups))
+    {
+        failure = "too many lanes for this device, at most " + std::to_string(largest / (memoryWords * 4));
+        return false;
+    }
+
+    std::string log;
+    GLuint built = compileKernel(log);
+    if (!built)
+    {
+        failure = "compute shader failed to build: " + log;
+        return false;
+    }
+    const size_t sizes[bufferCount] = {
+        lanes * fieldCount * 4,
+        memoryBytes,
+        lanes * screenWords * 4,
+        lanes * 3 * 4,
+        lanes * 2 * 4,
+        lanes * maxWatches * 4,
+        (memoryWords + maxWatches * watchWords) * 4,
+    };
+    gpu.GenBuffers(bufferCount, buffers);
+    for (int b = 0; b < bufferCount; ++b)
+    {
+        gpu.BindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[b]);
+        gpu.BufferData(GL_SHADER_STORAGE_BUFFER, static_cast<GLsizeiptr>(sizes[b]), nullptr, GL_DYNAMIC_COPY);
+    }
+    gpu.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+    if (glGetError() != GL_NO_ERROR)
+    {
+        failure = "out of graphics memory";
+        gpu.DeleteProgram(built);
+        return false;
+    }
+    program = built;
+    return true;
+}
+
+void Chip8Gpu::upload(Buffer buffer, const void *data, size_t bytes, size_t offset)
+{
+    gpu.BindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[buffer]);
+    gpu.BufferSubData(GL_SHADER_STORAGE_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes), data);
+    gpu.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void Chip8Gpu::download(Buffer buffer, void *data, size_t bytes, size_t offset) const
+{
+    gpu.BindBuffer(GL_SHADER_STORAGE_BUFFER, buffers[buffer]);
+    gpu.GetBufferSubData(GL_SHADER_STORAGE_BUFFER, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(bytes), data);
+    gpu.BindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+bool Chip8Gpu::loadROM(const uint8_t *data, size_t size)
+{
+    if (!program)
+        return false;
+    // Chip8 lays out the fonts and the program, as for Chip8Batch
+    std::unique_ptr<Chip8> boot = std::make_unique<Chip8>();
+    if (!boot->loadROM(data, size))
+        return false;
+    upload(ConstantBuffer, boot->getMemory().data(), memoryWords * 4);
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+        input[lane] = resetBit;
+        input[lanes + lane] = static_cast<uint32_t>(lane);
+        input[2 * lanes + lane] = static_cast<uint32_t>(uint64_t(lane) >> 32);
+    }
+    step(0); // Boots every lane on the card
+    return true;
+}
+
+bool Chip8Gpu::addWatch(const Watch &watch)
+{
+    if (static_cast<int>(watches.size()) == maxWatches)
+        return false;
+    uint32_t words[watchWords] = {static_cast<uint32_t>(watch.source), static_cast<uint32_t>(watch.kind), watch.address,
+                                  static_cast<uint32_t>(watch.target), 0};
+    std::memcpy(&words[4], &watch.weight, sizeof(float));
+    upload(ConstantBuffer, words, sizeof words, (memoryWords + watches.size() * watchWords) * 4);
+    watches.push_back(watch);
+    return true;
+}
+
+void Chip8Gpu::reset(size_t lane, uint64_t seed)
+{
+    input[lane] = (input[lane] & 0xFFFF) | resetBit;
+    input[lanes + lane] = static_cast<uint32_t>(seed);
+    input[2 * lanes + lane] = static_cast<uint32_t>(seed >> 32);
+}
+
+void Chip8Gpu::setKeys(size_t lane, uint16_t keys)
+{
+    input[lane] = (input[lane] & resetBit) | keys;
+}
+
+void Chip8Gpu::step(int frames)
+{
+    if (!program)
+        return;
+    upload(InputBuffer, input.data(), input.size() * 4);
+    dispatch(frames);
+    rememberFrom = static_cast<int>(watches.size());
+    for (size_t lane = 0; lane < lanes; ++lane)
+        input[lane] &= 0xFFFF;
+
+    std::vector<uint32_t> results(lanes * 2);
+    download(ResultBuffer, results.data(), results.size() * 4, 0);
+    std::memcpy(stepRewards.data(), results.data(), lanes * sizeof(float));
+    for (size_t lane = 0; lane < lanes; ++lane)
+        stepDone[lane] = results[lanes + lane] ? 1 : 0;
+}
+
+void Chip8Gpu::dispatch(int frames)
+{
+    gpu.UseProgram(program);
+    gpu.Uniform1i(gpu.GetUniformLocation(program, "laneCount"), static_cast<GLint>(lanes));
+    gpu.Uniform1i(gpu.GetUniformLocation(program, "frames"), frames);
+    gpu.Uniform1i(gpu.GetUniformLocation(program, "ipf"), ipf);
+    gpu.Uniform1i(gpu.GetUniformLocation(program, "watchCount"), static_cast<GLint>(watches.size()));
+    gpu.Uniform1i(gpu.GetUniformLocation(program, "rememberFrom"), rememberFrom);
+    for (int b = 0; b < bufferCount; ++b)
+        gpu.BindBufferBase(GL_SHADER_STORAGE_BUFFER, b, buffers[b]);
+    gpu.DispatchCompute(static_cast<GLuint>((lanes + groupSize - 1) / groupSize), 1, 1);
+    // Read back with GetBufferSubData, and by the next dispatch
+    gpu.MemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+    gpu.UseProgram(0);
+}
+
+void Chip8Gpu::screens(std::vector<uint64_t> &out) const
+{
+    std::vector<uint32_t> words(lanes * screenWords);
+    if (program)
+        download(ScreenBuffer, words.data(), words.size() * 4, 0);
+    out.resize(lanes * 128);
+    for (size_t lane = 0; lane < lanes; ++lane)
+    {
+        for (int w = 0; w < 128; ++w)
+            out[lane * 128 + w] = (uint64_t(words[(w * 2) * lanes + lane]) << 32) | words[(w * 2 + 1) * lanes + lane];
+    }
+}
+
+void Chip8Gpu::get(size_t lane, Chip8Batch::Machine &out) const
+{
+    // A word per field, strided over the lanes
+    auto fetch = [this, lane](Buffer buffer, size_t field)
+    {
+        uint32_t word = 0;
+        download(buffer, &word, 4, (field * lanes + lane) * 4);
+        return word;
+    };
+    Chip8Batch::Registers &r = out.regs;
+    for (int x = 0; x < 16; ++x)
+        r.V[x] = static_cast<uint8_t>(fetch(StateBuffer, fieldV + x));
+    r.PC = static_cast<uint16_t>(fetch(StateBuffer, fieldPC));
+    r.I = static_cast<uint16_t>(fetch(StateBuffer, fieldI));
+    r.keys = static_cast<uint16_t>(fetch(StateBuffer, fieldKeys));
+    r.sp = static_cast<uint8_t>(fetch(StateBuffer, fieldSP));
+    r.delayTimer = static_cast<uint8_t>(fetch(StateBuffer, fieldDelay));
+    r.soundTimer = static_cast<uint8_t>(fetch(StateBuffer, fieldSound));
+    r.hires = fetch(StateBuffer, fieldHires) != 0;
+    r.keyWaitReg = static_cast<int8_t>(fetch(StateBuffer, fieldWaitReg));
+    r.keyWaitKey = static_cast<int8_t>(fetch(StateBuffer, fieldWaitKey));
+    r.rngState = (uint64_t(fetch(StateBuffer, fieldRng + 1)) << 32) | fetch(StateBuffer, fieldRng);
+    for (int i = 0; i < 16; ++i)
+    {
+        out.stack[i] = static_cast<uint16_t>(fetch(StateBuffer, fieldStack + i));
+        out.rplFlags[i] = static_cast<uint8_t>(fetch(StateBuffer, fieldRpl + i));
+    }
+    for (int w = 0; w < 128; ++w)
+        out.gfx[w] = (uint64_t(fetch(ScreenBuffer, w * 2)) << 32) | fetch(ScreenBuffer, w * 2 + 1);
+    for (int w = 0; w < memoryWords; ++w)
+    {
+        const uint32_t word = fetch(MemoryBuffer, w);
+        std::memcpy(&out.memory[w * 4], &word, 4); // Low byte first, as the card stores it
+    }
+}
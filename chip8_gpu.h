@@ -0,0 +1,103 @@
+#ifndef CHIP8_GPU_H
+#define CHIP8_GPU_H
+
+#include "chip8_batch.h" // For Chip8Batch::Machine
+#include "chip8_env_c.h" // For chip8_watch
+#include <cstddef>       // For size_t
+#include <cstdint>       // For the fixed-width types
+#include <string>        // For the error text
+#include <vector>        // For keys, rewards and screens
+
+// Thousands of classic machines on the graphics card, one compute shader
+// invocation per lane. The lanes are Chip8Batch's machines: every field is
+// an array over all lanes in a buffer on the card, memory and screen
+// included, and a lane runs the same instructions to the same state as a
+// Chip8Batch lane with the same seed and keys. A step runs every lane for
+// a number of frames in one dispatch and evaluates Chip8Env-style watches
+// there, so only keys go up and rewards come back; screens are read back
+// in bulk only when asked for. Needs an OpenGL 4.3 context, current on
+// the calling thread for the object's whole life.
+class Chip8Gpu
+{
+public:
+    using Watch = chip8_watch;
+    static constexpr int maxWatches = CHIP8_ENV_MAX_WATCHES;
+
+    // Resolves gl* entry points in the current context, as
+    // SDL_GL_GetProcAddress or eglGetProcAddress do
+    using LookupFunction = void *(*)(const char *name);
+
+    // ipf instructions per frame; every lane starts reset, seeded with
+    // its number
+    Chip8Gpu(LookupFunction lookup, size_t lanes, int instructionsPerFrame);
+    ~Chip8Gpu();
+
+    Chip8Gpu(const Chip8Gpu &) = delete;
+    Chip8Gpu &operator=(const Chip8Gpu &) = delete;
+
+    // False if the context has no compute shaders or can't hold the lanes;
+    // error() says which
+    bool isReady() const { return program != 0; }
+    const std::string &error() const { return failure; }
+
+    size_t size() const { return lanes; }
+
+    // Every lane boots from it; resets each lane, seeded with its number
+    bool loadROM(const uint8_t *data, size_t size);
+
+    // False once maxWatches are set. Takes its first value on the next step.
+    bool addWatch(const Watch &watch);
+
+    // Both take effect at the start of the next step, the reset first, as
+    // Chip8Env::reset before Chip8Env::step. Keys stay held until changed,
+    // and only changed ones go through setKey, so FX0A sees real presses.
+    void reset(size_t lane, uint64_t seed);
+    void setKeys(size_t lane, uint16_t keys);
+
+    // Every lane for frames frames in one dispatch, then the watches. A
+    // dispatch that runs for seconds trips the driver's watchdog, so keep
+    // frames * ipf to what the card gets through in well under that.
+    void step(int frames);
+
+    // Per lane, from the last step, as Chip8Env::StepResult
+    const std::vector<float> &rewards() const { return stepRewards; }
+    const std::vector<uint8_t> &done() const { return stepDone; }
+
+    // 128 words per lane in Chip8::gfx layout, lane after lane
+    void screens(std::vector<uint64_t> &out) const;
+
+    // One lane read back whole
+    void get(size_t lane, Chip8Batch::Machine &out) const;
+
+private:
+    enum Buffer
+    {
+        StateBuffer,    // Registers, stack and flags, fieldCount words a lane
+        MemoryBuffer,   // 1024 words a lane, four bytes each, low byte first
+        ScreenBuffer,   // 256 words a lane, a 64-bit gfx word as two, high first
+        InputBuffer,    // Keys and reset flag, then the seed's two halves
+        ResultBuffer,   // Reward, then done
+        LastBuffer,     // maxWatches watch values a lane
+        ConstantBuffer, // Boot memory, then the watches
+        bufferCount
+    };
+
+    bool build(LookupFunction lookup);
+    void upload(Buffer buffer, const void *data, size_t bytes, size_t offset = 0);
+    void download(Buffer buffer, void *data, size_t bytes, size_t offset) const;
+    void dispatch(int frames);
+
+    size_t lanes;
+    int ipf;
+    std::string failure;
+    unsigned program = 0;
+    unsigned buffers[bufferCount] = {};
+
+    std::vector<uint32_t> input;
+    std::vector<Watch> watches;
+    int rememberFrom = 0; // Watches from here on have no value yet
+    std::vector<float> stepRewards;
+    std::vector<uint8_t> stepDone;
+};
+
+#endif
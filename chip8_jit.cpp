@@ -0,0 +1,824 @@
+#include "chip8_jit.h"
+#include "chip8.h"
+#include <cstring>          // For std::memcpy
+#include <initializer_list> // For Emitter::raw
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIP8_JIT_X64 1
+#endif
+
+namespace
+{
+    constexpr size_t codeCapacity = 256 * 1024; // Executable buffer per instance
+    constexpr size_t maxBlockBytes = 8 * 1024;  // Worst case for one block
+    constexpr int maxBlockLength = 64;          // Instructions per block
+
+    // The buffer starts out writable, never executable at the same time
+    uint8_t *allocExecutable(size_t size)
+    {
+#if !defined(CHIP8_JIT_X64)
+        (void)size;
+        return nullptr;
+#elif defined(_WIN32)
+        return static_cast<uint8_t *>(VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE));
+#else
+        void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        return p == MAP_FAILED ? nullptr : static_cast<uint8_t *>(p);
+#endif
+    }
+
+    // Flips the buffer between read-write and read-execute
+    bool protectExecutable(uint8_t *p, size_t size, bool executable)
+    {
+#if defined(_WIN32)
+        DWORD old;
+        if (!VirtualProtect(p, size, executable ? PAGE_EXECUTE_READ : PAGE_READWRITE, &old))
+            return false;
+        if (executable)
+            FlushInstructionCache(GetCurrentProcess(), p, size);
+        return true;
+#else
+        return mprotect(p, size, executable ? PROT_READ | PROT_EXEC : PROT_READ | PROT_WRITE) == 0;
+#endif
+    }
+
+    void freeExecutable(uint8_t *p, size_t size)
+    {
+        if (!p)
+            return;
+#if defined(_WIN32)
+        (void)size;
+        VirtualFree(p, 0, MEM_RELEASE);
+#else
+        munmap(p, size);
+#endif
+    }
+
+    // x86 ModRM register fields
+    constexpr uint8_t AL = 0;
+    constexpr uint8_t CL = 1;
+
+    // Host registers that hold guest registers inside a block. All are
+    // caller-saved, rax and rcx stay free as scratch, and nothing lives in
+    // them across a helper call.
+#if defined(_WIN32)
+    constexpr uint8_t hostPool[] = {2, 8, 9, 10, 11}; // rdx, r8-r11
+#else
+    constexpr uint8_t hostPool[] = {2, 6, 7, 8, 9, 10, 11}; // rdx, rsi, rdi, r8-r11
+#endif
+}
+
+// Appends raw machine code to the executable buffer
+class Chip8Jit::Emitter
+{
+public:
+    explicit Emitter(uint8_t *start) : begin(start), p(start) {}
+
+    Emitter &u8(uint8_t v)
+    {
+        *p++ = v;
+        return *this;
+    }
+    Emitter &u16(uint16_t v) { return put(&v, sizeof v); }
+    Emitter &u32(uint32_t v) { return put(&v, sizeof v); }
+    Emitter &u64(uint64_t v) { return put(&v, sizeof v); }
+    Emitter &put(const void *data, size_t size)
+    {
+        std::memcpy(p, data, size);
+        p += size;
+        return *this;
+    }
+
+    Emitter &raw(std::initializer_list<uint8_t> bytes)
+    {
+        for (uint8_t b : bytes)
+            u8(b);
+        return *this;
+    }
+
+    // Opcode bytes, then ModRM + disp32 for an operand at [rbx + disp]
+    Emitter &op(std::initializer_list<uint8_t> opcode, uint8_t reg, int32_t disp)
+    {
+        raw(opcode);
+        u8(0x83 | (reg << 3));
+        return u32(static_cast<uint32_t>(disp));
+    }
+
+    // REX prefix for a ModRM reg field and a register rm field. Always
+    // emitted, so byte operands 4-7 mean spl-dil and not ah-bh.
+    Emitter &rex(uint8_t reg, uint8_t rm)
+    {
+        return u8(static_cast<uint8_t>(0x40 | (reg >> 3) << 2 | rm >> 3));
+    }
+
+    // Opcode bytes with two host registers (or an opcode extension in reg)
+    Emitter &rr(std::initializer_list<uint8_t> opcode, uint8_t reg, uint8_t rm)
+    {
+        rex(reg, rm).raw(opcode);
+        return u8(static_cast<uint8_t>(0xC0 | (reg & 7) << 3 | (rm & 7)));
+    }
+
+    // op with a host register: [rbx + disp] and any of r8-r15
+    Emitter &rop(std::initializer_list<uint8_t> opcode, uint8_t reg, int32_t disp)
+    {
+        rex(reg, 0).raw(opcode);
+        u8(static_cast<uint8_t>(0x83 | (reg & 7) << 3));
+        return u32(static_cast<uint32_t>(disp));
+    }
+
+    uint8_t *pos() const { return p; }
+    size_t size() const { return static_cast<size_t>(p - begin); }
+
+private:
+    uint8_t *begin;
+    uint8_t *p;
+};
+
+Chip8Jit::Chip8Jit(Chip8 &chip8Ref)
+    : chip8(chip8Ref)
+{
+    auto offset = [&](const void *field)
+    {
+        return static_cast<int32_t>(static_cast<const uint8_t *>(field) - reinterpret_cast<const uint8_t *>(&chip8));
+    };
+    offV = offset(chip8.V.data());
+    offI = offset(&chip8.I);
+    offPC = offset(&chip8.PC);
+    offTimerFrame = offset(&chip8.timerFrame);
+    offDelay = offset(&chip8.delayExpiry);
+    offSound = offset(&chip8.soundExpiry);
+
+    code = allocExecutable(codeCapacity);
+    flush();
+}
+
+Chip8Jit::~Chip8Jit()
+{
+    freeExecutable(code, codeCapacity);
+}
+
+int Chip8Jit::run(int count)
+{
+    // Turns already run by a block that went past the last budget
+    int executed = owed < count ? owed : count;
+    owed -= executed;
+    while (executed < count)
+    {
+        // Halted in FX0A, nothing runs until a key wakes it
+        if (chip8.keyWaitReg >= 0)
+        {
+            chip8.countIdle(1, count - executed);
+            return count;
+        }
+
+        uint16_t pc = chip8.PC;
+        int32_t idx = -1;
+        if (pc < 4095)
+        {
+            idx = blockAt[pc];
+            if (idx < 0 && tiered && heat[pc] < compileHeat)
+            {
+                // Still cold: interpret up to the next jump, predecoded once warm
+                chip8.idleCheck = false;
+                executed += chip8.runStraight(count - executed, ++heat[pc] > decodeHeat);
+                if (chip8.idleCheck)
+                {
+                    chip8.idleCheck = false;
+                    if (int loop = chip8.idleLoopAt(chip8.PC))
+                    {
+                        const int skip = (count - executed) / loop * loop;
+                        executed += skip;
+                        chip8.countIdle(loop, skip);
+                    }
+                }
+                continue;
+            }
+            if (idx < 0)
+                idx = compile(pc);
+        }
+
+        // Skip whole turns of an idle loop, as the interpreter does
+        if (idx >= 0 && blocks[idx].idleCandidate)
+        {
+            if (int loop = chip8.idleLoopAt(pc))
+            {
+                const int skip = (count - executed) / loop * loop;
+                executed += skip;
+                chip8.countIdle(loop, skip);
+                if (executed == count)
+                    break;
+            }
+        }
+
+        // Blocks run to completion, so finish a too-short budget one by one
+        if (idx < 0 || (blocks[idx].length > count - executed && !wholeBlocks))
+        {
+            chip8.emulateCycle();
+            ++executed;
+            continue;
+        }
+
+        if (!codeExecutable)
+        {
+            // A buffer that can't be made executable runs nothing compiled
+            if (!protectExecutable(code, codeCapacity, true))
+            {
+                freeExecutable(code, codeCapacity);
+                code = nullptr;
+                flush();
+                continue;
+            }
+            codeExecutable = true;
+        }
+        codeWritten = false;
+        executed += blocks[idx].fn(&chip8);
+    }
+    if (executed > count)
+    {
+        owed = executed - count;
+        executed = count;
+    }
+    return executed;
+}
+
+// Blocks overlap where one starts inside another, so every live block
+// over addr goes; writes into code are rare enough to scan the list
+void Chip8Jit::invalidate(uint16_t addr)
+{
+    addr &= 0xFFF;
+    if (!covering[addr])
+        return;
+    ++writes;
+    for (Block &block : blocks)
+    {
+        if (!block.live || addr < block.start || addr >= block.end)
+            continue;
+        block.live = false;
+        blockAt[block.start] = -1;
+        heat[block.start] = 0; // Rewritten code warms up again
+        droppedAt[block.start] = true;
+        for (uint16_t a = block.start; a < block.end; ++a)
+            --covering[a];
+        ++dropped;
+    }
+    codeWritten = true; // Tells a running block to leave
+}
+
+void Chip8Jit::flush()
+{
+    blocks.clear();
+    blockAt.fill(-1);
+    covering.fill(0);
+    droppedAt.fill(false);
+    heat.fill(0);
+    codeUsed = 0;
+    codeWritten = true; // Tells a running block to leave
+}
+
+void Chip8Jit::setTiers(uint32_t predecodeAfter, uint32_t compileAfter)
+{
+    tiered = true;
+    decodeHeat = predecodeAfter;
+    compileHeat = compileAfter;
+}
+
+int Chip8Jit::compile(uint16_t start)
+{
+    if (!code)
+        return -1;
+    if (codeCapacity - codeUsed < maxBlockBytes)
+        flush();
+    if (codeExecutable)
+    {
+        if (!protectExecutable(code, codeCapacity, false))
+            return -1;
+        codeExecutable = false;
+    }
+
+    uint8_t *entry = code + codeUsed;
+    Emitter e(entry);
+
+    // Prologue: keep the Chip8 pointer in rbx for the whole block
+    e.raw({0x53}); // push rbx
+#if defined(_WIN32)
+    e.raw({0x48, 0x83, 0xEC, 0x20}); // sub rsp, 32 (shadow space)
+    e.raw({0x48, 0x89, 0xCB});       // mov rbx, rcx
+#else
+    e.raw({0x48, 0x89, 0xFB}); // mov rbx, rdi
+#endif
+    forget();
+
+    uint16_t first = (chip8.memory[start] << 8) | chip8.memory[start + 1];
+    bool idleCandidate = (first & 0xF000) == 0x1000 || (first & 0xF000) == 0xD000 || (first & 0xF0FF) == 0xF007;
+
+    uint16_t pc = start;
+    int count = 0;
+    bool ended = false;
+    while (!ended && count < maxBlockLength && pc < 4095)
+    {
+        uint16_t opcode = (chip8.memory[pc] << 8) | chip8.memory[pc + 1];
+        pc += 2;
+        ++count;
+        ended = emitInstruction(e, opcode, pc, count);
+    }
+
+    if (!ended)
+    {
+        // Fall through into the next block
+        e.op({0x66, 0xC7}, AL, offPC).u16(pc); // mov word [PC], pc
+        emitExit(e, count);
+    }
+
+    codeUsed = (codeUsed + e.size() + 15) & ~size_t(15);
+    blocks.push_back({reinterpret_cast<BlockFn>(entry), static_cast<uint16_t>(count), start, pc, idleCandidate, true});
+    blockAt[start] = static_cast<int32_t>(blocks.size() - 1);
+    for (uint16_t a = start; a < pc; ++a)
+        ++covering[a];
+    if (droppedAt[start])
+    {
+        droppedAt[start] = false;
+        ++rebuilt;
+    }
+    return blockAt[start];
+}
+
+// Emits one instruction, returns true when it ends the block
+bool Chip8Jit::emitInstruction(Emitter &e, uint16_t opcode, uint16_t next, int count)
+{
+    const uint8_t x = (opcode & 0x0F00) >> 8;
+    const uint8_t y = (opcode & 0x00F0) >> 4;
+    const uint8_t nn = opcode & 0x00FF;
+    const uint16_t nnn = opcode & 0x0FFF;
+
+    // PC = next, plus 2 when the setcc condition holds, then leave
+    auto emitSkip = [&](uint8_t setcc)
+    {
+        e.raw({0x0F, setcc, 0xC0});          // setcc al
+        e.raw({0x0F, 0xB6, 0xC0});           // movzx eax, al
+        e.raw({0x8D, 0x04, 0x45}).u32(next); // lea eax, [rax*2 + next]
+        e.op({0x66, 0x89}, AL, offPC);       // mov [PC], ax
+        emitExit(e, count);
+    };
+    // A skip decided at compile time
+    auto emitStaticSkip = [&](bool taken)
+    {
+        e.op({0x66, 0xC7}, AL, offPC).u16(static_cast<uint16_t>(next + (taken ? 2 : 0))); // mov word [PC], target
+        emitExit(e, count);
+    };
+    constexpr uint8_t SETE = 0x94;
+    constexpr uint8_t SETNE = 0x95;
+
+    switch (opcode & 0xF000)
+    {
+    case 0x0000:
+        if (opcode == 0x00E0 || (opcode & 0xFFF0) == 0x00C0 || (opcode >= 0x00FB && opcode <= 0x00FF && opcode != 0x00FD))
+        { // CLS, SUPER-CHIP scrolling and resolution switch
+            emitHelperCall(e, opcode, next);
+        }
+        else if (opcode == 0x00EE)
+        { // RET
+            emitHelperCall(e, opcode, next);
+            emitExit(e, count);
+            return true;
+        }
+        return false; // Ignore 0NNN
+    case 0x1000:                                // JP addr
+        e.op({0x66, 0xC7}, AL, offPC).u16(nnn); // mov word [PC], nnn
+        emitExit(e, count);
+        return true;
+    case 0x2000: // CALL addr
+    case 0xB000: // JP V0, addr
+        emitHelperCall(e, opcode, next);
+        emitExit(e, count);
+        return true;
+    case 0x3000: // SE Vx, byte
+    case 0x4000: // SNE Vx, byte
+        if (isKnown(x))
+        {
+            emitStaticSkip((constant[x] == nn) == ((opcode & 0xF000) == 0x3000));
+            return true;
+        }
+        e.rr({0x80}, 7, readReg(e, x)).u8(nn); // cmp vx, nn
+        emitSkip((opcode & 0xF000) == 0x3000 ? SETE : SETNE);
+        return true;
+    case 0x5000: // SE Vx, Vy
+    case 0x9000: // SNE Vx, Vy
+    {
+        if (isKnown(x) && isKnown(y))
+        {
+            emitStaticSkip((constant[x] == constant[y]) == ((opcode & 0xF000) == 0x5000));
+            return true;
+        }
+        const uint8_t rx = readReg(e, x), ry = readReg(e, y);
+        e.rr({0x38}, ry, rx); // cmp vx, vy
+        emitSkip((opcode & 0xF000) == 0x5000 ? SETE : SETNE);
+        return true;
+    }
+    case 0x6000: // LD Vx, byte
+        setConst(x, nn);
+        return false;
+    case 0x7000: // ADD Vx, byte
+        if (isKnown(x))
+            setConst(x, static_cast<uint8_t>(constant[x] + nn));
+        else
+            e.rr({0x80}, 0, writeReg(e, x, true)).u8(nn); // add vx, nn
+        return false;
+    case 0x8000:
+    {
+        const uint8_t n = opcode & 0x000F;
+        if (n > 0x7 && n != 0xE)
+        { // No such 8XYN: the handler counts it as unknown
+            emitHelperCall(e, opcode, next);
+            return false;
+        }
+        const bool flag = n == 0x4 || n == 0x5 || n == 0x6 || n == 0x7 || n == 0xE;
+        const bool keepFlag = flag && !flagOverwritten(next, count);
+        const bool readsY = n != 0x6 && n != 0xE;
+        if (isKnown(x) && (!readsY || isKnown(y)))
+        {
+            // Folded: Vx then VF as every handler stores them
+            const unsigned a = constant[x], b = constant[y];
+            unsigned result = a, carry = 0;
+            switch (n)
+            {
+            case 0x0: result = b; break;
+            case 0x1: result = a | b; break;
+            case 0x2: result = a & b; break;
+            case 0x3: result = a ^ b; break;
+            case 0x4: result = a + b; carry = result > 0xFF; break;
+            case 0x5: result = a - b; carry = a >= b; break;
+            case 0x6: result = a >> 1; carry = a & 1; break;
+            case 0x7: result = b - a; carry = b >= a; break;
+            case 0xE: result = a << 1; carry = a >> 7; break;
+            }
+            setConst(x, static_cast<uint8_t>(result));
+            if (keepFlag)
+                setConst(0xF, static_cast<uint8_t>(carry));
+            return false;
+        }
+        if (n == 0x0 && isKnown(y))
+        {
+            setConst(x, constant[y]);
+            return false;
+        }
+
+        // Operands first, so no allocation lands between an op and its setc.
+        // A known Vy is an immediate for the logic ops and ADD.
+        const bool immediate = isKnown(y) && (n == 0x1 || n == 0x2 || n == 0x3 || n == 0x4);
+        const uint8_t ry = readsY && !immediate ? readReg(e, y) : 0;
+        const uint8_t rx = writeReg(e, x, n != 0x0);
+        const uint8_t rf = keepFlag ? writeReg(e, 0xF, false) : 0;
+        const uint8_t imm = static_cast<uint8_t>(constant[y]);
+        switch (n)
+        {
+        case 0x0:                 // LD Vx, Vy
+            e.rr({0x88}, ry, rx); // mov vx, vy
+            break;
+        case 0x1: // OR Vx, Vy
+            if (immediate)
+                e.rr({0x80}, 1, rx).u8(imm); // or vx, imm
+            else
+                e.rr({0x08}, ry, rx); // or vx, vy
+            break;
+        case 0x2: // AND Vx, Vy
+            if (immediate)
+                e.rr({0x80}, 4, rx).u8(imm); // and vx, imm
+            else
+                e.rr({0x20}, ry, rx); // and vx, vy
+            break;
+        case 0x3: // XOR Vx, Vy
+            if (immediate)
+                e.rr({0x80}, 6, rx).u8(imm); // xor vx, imm
+            else
+                e.rr({0x30}, ry, rx); // xor vx, vy
+            break;
+        case 0x4: // ADD Vx, Vy
+            if (immediate)
+                e.rr({0x80}, 0, rx).u8(imm); // add vx, imm
+            else
+                e.rr({0x00}, ry, rx); // add vx, vy
+            break;
+        case 0x5: // SUB Vx, Vy
+        case 0x7: // SUBN Vx, Vy
+        {
+            // Vx then VF from the operands as read, as the interpreter stores them
+            uint8_t lhs = n == 0x5 ? rx : ry;
+            uint8_t rhs = n == 0x5 ? ry : rx;
+            e.rr({0x8A}, AL, lhs); // mov al, lhs
+            e.rr({0x2A}, AL, rhs); // sub al, rhs
+            if (keepFlag)
+                e.raw({0x0F, 0x93, 0xC1}); // setae cl
+            e.rr({0x88}, AL, rx);          // mov vx, al
+        }
+        break;
+        case 0x6:                // SHR Vx {, Vy}
+            e.rr({0xD0}, 5, rx); // shr vx, 1
+            break;
+        case 0xE:                // SHL Vx {, Vy}
+            e.rr({0xD0}, 4, rx); // shl vx, 1
+            break;
+        }
+        if (keepFlag)
+        {
+            if (n != 0x5 && n != 0x7)
+                e.raw({0x0F, 0x92, 0xC1}); // setc cl
+            e.rr({0x88}, CL, rf);          // mov vf, cl: VF last, over Vx if X is F
+        }
+        return false;
+    }
+    case 0xA000: // LD I, addr
+        setConst(slotI, nnn);
+        return false;
+    case 0xC000: // RND Vx, byte
+    case 0xD000: // DRW Vx, Vy, nibble
+        emitHelperCall(e, opcode, next);
+        return false;
+    case 0xE000:
+        if (nn == 0x9E || nn == 0xA1)
+        { // SKP / SKNP Vx
+            emitHelperCall(e, opcode, next);
+            emitExit(e, count);
+            return true;
+        }
+        emitHelperCall(e, opcode, next); // No such EXNN
+        return false;
+    case 0xF000:
+        switch (nn)
+        {
+        case 0x07:                           // LD Vx, DT
+            e.op({0x8B}, AL, offDelay);      // mov eax, [delay expiry]
+            e.op({0x2B}, AL, offTimerFrame); // sub eax, [timer frame]
+            e.raw({0x31, 0xC9});             // xor ecx, ecx
+            e.raw({0x85, 0xC0});             // test eax, eax
+            e.raw({0x0F, 0x48, 0xC1});       // cmovs eax, ecx: ran out
+            e.rr({0x88}, AL, writeReg(e, x, false)); // mov vx, al
+            break;
+        case 0x15: // LD DT, Vx
+        case 0x18: // LD ST, Vx
+            if (isKnown(x))
+                e.raw({0xB8}).u32(constant[x]); // mov eax, vx
+            else
+                e.rr({0x0F, 0xB6}, AL, readReg(e, x));     // movzx eax, vx
+            e.op({0x03}, AL, offTimerFrame);               // add eax, [timer frame]
+            e.op({0x89}, AL, nn == 0x15 ? offDelay : offSound); // mov [expiry], eax
+            break;
+        case 0x1E: // ADD I, Vx (no carry flag)
+            if (isKnown(x) && isKnown(slotI))
+                setConst(slotI, static_cast<uint16_t>(constant[slotI] + constant[x]));
+            else if (isKnown(x))
+                e.rr({0x81}, 0, writeReg(e, slotI, true)).u32(constant[x]); // add ri, vx
+            else
+            {
+                const uint8_t rx = readReg(e, x), ri = writeReg(e, slotI, true);
+                e.rr({0x0F, 0xB6}, AL, rx); // movzx eax, vx
+                e.rr({0x01}, AL, ri);       // add ri, eax: only the low 16 bits are I
+            }
+            break;
+        case 0x29: // LD F, Vx (font)
+            if (isKnown(x))
+                setConst(slotI, static_cast<uint16_t>((constant[x] & 0xF) * 5 + 0x50));
+            else
+            {
+                const uint8_t rx = readReg(e, x), ri = writeReg(e, slotI, false);
+                e.rr({0x0F, 0xB6}, AL, rx);                                    // movzx eax, vx
+                e.raw({0x83, 0xE0, 0x0F});                                     // and eax, 0xF
+                e.rex(ri, 0).raw({0x8D, static_cast<uint8_t>(0x44 | (ri & 7) << 3), 0x80, 0x50}); // lea ri, [rax + rax*4 + 0x50]
+            }
+            break;
+        case 0x0A: // LD Vx, K (halts the machine)
+            emitHelperCall(e, opcode, next);
+            emitExit(e, count);
+            return true;
+        case 0x33: // LD B, Vx
+        case 0x55: // LD [I], Vx
+        {
+            emitHelperCall(e, opcode, next);
+
+            // Leave if the store hit compiled code (PC already points past it)
+            e.raw({0x48, 0xB8}).u64(reinterpret_cast<uintptr_t>(&codeWritten)); // mov rax, &codeWritten
+            e.raw({0x80, 0x38, 0x00});                                          // cmp byte [rax], 0
+            e.raw({0x74, 0x00});                                                // je past the exit
+            uint8_t *rel = e.pos() - 1;
+            emitExit(e, count);
+            *rel = static_cast<uint8_t>(e.pos() - (rel + 1));
+        }
+        break;
+        case 0x65: // LD Vx, [I]
+        case 0x30: // LD HF, Vx
+        case 0x75: // LD R, Vx
+        case 0x85: // LD Vx, R
+        case 0x02: // XO-CHIP audio pattern
+        case 0x3A: // XO-CHIP pitch
+        default:   // No such FXNN
+            emitHelperCall(e, opcode, next);
+            break;
+        }
+        return false;
+    }
+    return false;
+}
+
+// Calls the interpreter handler for opcode, with PC set as after its fetch
+void Chip8Jit::emitHelperCall(Emitter &e, uint16_t opcode, uint16_t next)
+{
+    // Handlers see the machine in memory and clobber the host registers
+    writeBack(e);
+    forget();
+    e.op({0x66, 0xC7}, AL, offPC).u16(next); // mov word [PC], next
+
+    // The decoded operands live in the code stream, jumped over
+    const Chip8::Instruction in = Chip8::decode(opcode);
+    size_t pad = (8 - (reinterpret_cast<uintptr_t>(e.pos() + 2) & 7)) & 7;
+    e.raw({0xEB, static_cast<uint8_t>(pad + sizeof in)}); // jmp past the data
+    for (size_t i = 0; i < pad; ++i)
+        e.raw({0xCC});
+    uint8_t *data = e.pos();
+    e.put(&in, sizeof in);
+
+#if defined(_WIN32)
+    e.raw({0x48, 0x89, 0xD9}); // mov rcx, rbx
+    e.raw({0x48, 0x8D, 0x15}); // lea rdx, [rip + data]
+#else
+    e.raw({0x48, 0x89, 0xDF}); // mov rdi, rbx
+    e.raw({0x48, 0x8D, 0x35}); // lea rsi, [rip + data]
+#endif
+    e.u32(static_cast<uint32_t>(data - (e.pos() + 4)));
+
+    e.raw({0x48, 0xB8}).u64(reinterpret_cast<uintptr_t>(Chip8::opTable()[opcode])); // mov rax, handler
+    e.raw({0xFF, 0xD0});                                                            // call rax
+}
+
+// Leaves the block, returning how many instructions it executed
+void Chip8Jit::emitExit(Emitter &e, int count)
+{
+    writeBack(e);
+    e.raw({0xB8}).u32(static_cast<uint32_t>(count)); // mov eax, count
+#if defined(_WIN32)
+    e.raw({0x48, 0x83, 0xC4, 0x20}); // add rsp, 32
+#endif
+    e.raw({0x5B}); // pop rbx
+    e.raw({0xC3}); // ret
+}
+
+uint8_t Chip8Jit::hostReg(Emitter &e, int slot, bool load)
+{
+    if (hostOf[slot] >= 0)
+    {
+        lastUse[hostOf[slot]] = ++useClock;
+        return static_cast<uint8_t>(hostOf[slot]);
+    }
+
+    // A free register, or the least recently used one, written back first
+    uint8_t reg = hostPool[0];
+    for (uint8_t candidate : hostPool)
+    {
+        if (slotIn[candidate] < 0)
+        {
+            reg = candidate;
+            break;
+        }
+        if (lastUse[candidate] < lastUse[reg])
+            reg = candidate;
+    }
+    if (slotIn[reg] >= 0)
+    {
+        if (dirty >> reg & 1)
+            emitStore(e, reg);
+        hostOf[slotIn[reg]] = -1;
+    }
+    dirty &= static_cast<uint16_t>(~(1u << reg));
+
+    if (pending >> slot & 1)
+    {
+        // A folded constant the machine hasn't seen: it lands here instead
+        pending &= ~(1u << slot);
+        if (load)
+        {
+            e.rex(0, reg).u8(static_cast<uint8_t>(0xB8 | (reg & 7))).u32(constant[slot]); // mov reg, value
+            dirty |= static_cast<uint16_t>(1u << reg);
+        }
+    }
+    else if (load && slot == slotI)
+        e.rop({0x0F, 0xB7}, reg, offI); // movzx reg, word [I]
+    else if (load)
+        e.rop({0x0F, 0xB6}, reg, offV + slot); // movzx reg, byte [V + slot]
+    hostOf[slot] = static_cast<int8_t>(reg);
+    slotIn[reg] = static_cast<int8_t>(slot);
+    lastUse[reg] = ++useClock;
+    return reg;
+}
+
+uint8_t Chip8Jit::writeReg(Emitter &e, int slot, bool keep)
+{
+    const uint8_t reg = hostReg(e, slot, keep);
+    dirty |= static_cast<uint16_t>(1u << reg);
+    known &= ~(1u << slot);
+    return reg;
+}
+
+// The value is tracked at compile time, and only stored at an exit or
+// moved into a register if something reads it at run time
+void Chip8Jit::setConst(int slot, uint16_t value)
+{
+    if (hostOf[slot] >= 0)
+    {
+        dirty &= static_cast<uint16_t>(~(1u << hostOf[slot]));
+        slotIn[hostOf[slot]] = -1;
+        hostOf[slot] = -1;
+    }
+    constant[slot] = value;
+    known |= 1u << slot;
+    pending |= 1u << slot;
+}
+
+// True when VF is written again before anything can read it: the next
+// instructions are all native, none reads VF, and one overwrites it
+// before the block ends
+bool Chip8Jit::flagOverwritten(uint16_t pc, int count) const
+{
+    for (; count < maxBlockLength && pc < 4095; ++count, pc += 2)
+    {
+        const uint16_t opcode = (chip8.memory[pc] << 8) | chip8.memory[pc + 1];
+        const uint8_t x = (opcode & 0x0F00) >> 8;
+        const uint8_t y = (opcode & 0x00F0) >> 4;
+        const uint8_t n = opcode & 0x000F;
+        switch (opcode & 0xF000)
+        {
+        case 0x6000:
+            if (x == 0xF)
+                return true;
+            break;
+        case 0x7000:
+            if (x == 0xF)
+                return false;
+            break;
+        case 0x8000:
+            if (n == 0x6 || n == 0xE)
+            {
+                if (x == 0xF)
+                    return false;
+                return true;
+            }
+            if (n > 0x7 || y == 0xF || (x == 0xF && n != 0x0))
+                return false;
+            if (n >= 0x4 || x == 0xF)
+                return true;
+            break;
+        case 0xA000:
+            break;
+        case 0xF000:
+            if ((opcode & 0xFF) == 0x07 && x == 0xF)
+                return true;
+            if ((opcode & 0xFF) != 0x07 && (opcode & 0xFF) != 0x15 && (opcode & 0xFF) != 0x18 && (opcode & 0xFF) != 0x1E &&
+                (opcode & 0xFF) != 0x29)
+                return false;
+            if (x == 0xF && (opcode & 0xFF) != 0x07)
+                return false;
+            break;
+        default:
+            return false; // Exits, skips and handler calls see VF
+        }
+    }
+    return false; // Stored at the block's end
+}
+
+void Chip8Jit::emitStore(Emitter &e, uint8_t reg)
+{
+    if (slotIn[reg] == slotI)
+        e.u8(0x66).rop({0x89}, reg, offI); // mov [I], reg16
+    else
+        e.rop({0x88}, reg, offV + slotIn[reg]); // mov [V + slot], reg8
+}
+
+// Only emits the stores: an exit on one path of a branch leaves the
+// registers as they were for the other
+void Chip8Jit::writeBack(Emitter &e)
+{
+    for (int slot = 0; slot < slotI; ++slot)
+    {
+        if (pending >> slot & 1)
+            e.op({0xC6}, 0, offV + slot).u8(static_cast<uint8_t>(constant[slot])); // mov byte [V + slot], value
+    }
+    if (pending >> slotI & 1)
+        e.op({0x66, 0xC7}, 0, offI).u16(constant[slotI]); // mov word [I], value
+    for (uint8_t reg : hostPool)
+    {
+        if (dirty >> reg & 1)
+            emitStore(e, reg);
+    }
+}
+
+void Chip8Jit::forget()
+{
+    hostOf.fill(-1);
+    slotIn.fill(-1);
+    dirty = 0;
+    known = 0;
+    pending = 0;
+}
@@ -0,0 +1,140 @@
+#ifndef CHIP8_JIT_H
+#define CHIP8_JIT_H
+
+#include <cstdint> // For uint8_t, uint16_t
+#include <cstddef> // For size_t
+#include <array>   // For std::array
+#include <vector>  // For the block list
+
+namespace quirks
+{
+    struct Legacy;
+}
+template <size_t MemorySize, int Planes, typename Quirks>
+class BasicChip8;
+using Chip8 = BasicChip8<4096, 1, quirks::Legacy>;
+
+// Basic-block recompiler from CHIP-8 code to native x86-64.
+// Blocks run straight-line code up to the first jump, call, return or
+// skip. Instructions without a native translation call the interpreter
+// handler, so the interpreter remains the reference for every opcode.
+// Inside a block V0-VF and I live in host registers from their first use
+// and go back to the machine at its exits and before each handler call.
+// Values set from constants are folded into the instructions after them,
+// and carry flags that the block overwrites unread are never computed.
+class Chip8Jit
+{
+public:
+    explicit Chip8Jit(Chip8 &chip8Ref);
+    ~Chip8Jit();
+
+    Chip8Jit(const Chip8Jit &) = delete;
+    Chip8Jit &operator=(const Chip8Jit &) = delete;
+
+    // False when the host can't execute generated code
+    bool available() const { return code != nullptr; }
+
+    // Run up to count instructions, returns how many were executed, or
+    // with whole blocks how many were charged to this call
+    int run(int count);
+
+    // Memory write hook: drops the blocks compiled from addr, the others
+    // stay. Their code is only reclaimed once the buffer fills up.
+    void invalidate(uint16_t addr);
+
+    // Drop every compiled block
+    void flush();
+
+    // Tiered mode: a block start is interpreted until it has been entered
+    // predecodeAfter times, predecoded until compileAfter, then compiled
+    void setTiers(uint32_t predecodeAfter, uint32_t compileAfter);
+
+    // Blocks longer than the budget left run whole, the excess is owed
+    void setWholeBlocks(bool enabled) { wholeBlocks = enabled; }
+    void dropOwed() { owed = 0; }
+
+    // Stores that hit compiled code, blocks they dropped, and blocks
+    // compiled again at a start one was dropped from
+    uint64_t codeWrites() const { return writes; }
+    uint64_t invalidations() const { return dropped; }
+    uint64_t recompiles() const { return rebuilt; }
+
+private:
+    using BlockFn = int (*)(Chip8 *);
+
+    struct Block
+    {
+        BlockFn fn;
+        uint16_t length;    // Instructions in the block
+        uint16_t start;
+        uint16_t end;       // One past its last byte
+        bool idleCandidate; // First opcode could start an idle loop
+        bool live;          // Not dropped by a write
+    };
+
+    class Emitter;
+
+    int compile(uint16_t start);
+    bool emitInstruction(Emitter &e, uint16_t opcode, uint16_t next, int count);
+    void emitHelperCall(Emitter &e, uint16_t opcode, uint16_t next);
+    void emitExit(Emitter &e, int count);
+
+    // Host register holding slot (V0-VF, or slotI), loaded from the
+    // machine unless the instruction overwrites it without reading
+    uint8_t hostReg(Emitter &e, int slot, bool load);
+    uint8_t readReg(Emitter &e, int slot) { return hostReg(e, slot, true); }
+    uint8_t writeReg(Emitter &e, int slot, bool keep); // Marks it written
+    void emitStore(Emitter &e, uint8_t reg);
+    void writeBack(Emitter &e); // Stores every written register
+    void forget();              // Nothing is cached any more
+    void setConst(int slot, uint16_t value);
+    bool isKnown(int slot) const { return known >> slot & 1; }
+    bool flagOverwritten(uint16_t pc, int count) const;
+
+    Chip8 &chip8;
+
+    // Code buffer, blocks are appended until it is full. It is writable
+    // while blocks are compiled into it and executable while they run,
+    // never both: a bug the guest can reach in the emitter doesn't give it
+    // a page to write host code to. Compiling is rare once a ROM has warmed
+    // up, so the flips are too.
+    uint8_t *code = nullptr;
+    size_t codeUsed = 0;
+    bool codeExecutable = false;
+
+    std::vector<Block> blocks;
+    std::array<int32_t, 4096> blockAt{};   // Block index by start PC, -1 if none
+    std::array<uint16_t, 4096> covering{}; // Live blocks translated from each memory byte
+    std::array<bool, 4096> droppedAt{};    // A write dropped the block starting here
+    std::array<uint32_t, 4096> heat{};     // Entries into each block start not yet compiled
+    bool tiered = false;
+    bool wholeBlocks = false;
+    int owed = 0; // Turns whole blocks ran past earlier budgets
+    uint32_t decodeHeat = 0;
+    uint32_t compileHeat = 0;
+    bool codeWritten = false;              // Set when a block overwrote compiled code
+    uint64_t writes = 0;
+    uint64_t dropped = 0;
+    uint64_t rebuilt = 0;
+
+    // Register cache of the block being compiled
+    static constexpr int slotI = 16;
+    std::array<int8_t, 17> hostOf{}; // Host register per slot, -1 in memory
+    std::array<int8_t, 16> slotIn{}; // Slot per host register, -1 if none
+    std::array<uint32_t, 16> lastUse{};
+    uint32_t useClock = 0;
+    uint16_t dirty = 0; // Host registers written since they were loaded
+    std::array<uint16_t, 17> constant{}; // Value per slot, where known
+    uint32_t known = 0;                  // Slots holding a constant
+    uint32_t pending = 0;                // Known slots in no register and not yet stored
+
+    // Field offsets inside Chip8, used as displacements from its address
+    int32_t offV = 0;
+    int32_t offI = 0;
+    int32_t offPC = 0;
+    int32_t offTimerFrame = 0;
+    int32_t offDelay = 0; // Expiry frames, see Chip8::timerFrame
+    int32_t offSound = 0;
+};
+
+#endif
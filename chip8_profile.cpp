@@ -0,0 +1,329 @@
+#include "chip8_profile.h"
+#include <algorithm> // For std::partial_sort
+#include <cstdio>    // For std::snprintf
+
+namespace
+{
+    struct ClassPattern
+    {
+        uint16_t mask;
+        uint16_t value;
+        const char *name;
+    };
+
+    // First match wins, so exact opcodes come before their groups
+    const ClassPattern patterns[] = {
+        {0xFFFF, 0x00E0, "00E0"},
+        {0xFFFF, 0x00EE, "00EE"},
+        {0xFFF0, 0x00C0, "00CN"},
+        {0xFFFF, 0x00FB, "00FB"},
+        {0xFFFF, 0x00FC, "00FC"},
+        {0xFFFF, 0x00FD, "00FD"},
+        {0xFFFF, 0x00FE, "00FE"},
+        {0xFFFF, 0x00FF, "00FF"},
+        {0xF000, 0x0000, "0NNN"},
+        {0xF000, 0x1000, "1NNN"},
+        {0xF000, 0x2000, "2NNN"},
+        {0xF000, 0x3000, "3XNN"},
+        {0xF000, 0x4000, "4XNN"},
+        {0xF00F, 0x5000, "5XY0"},
+        {0xF00F, 0x5002, "5XY2"},
+        {0xF00F, 0x5003, "5XY3"},
+        {0xF000, 0x5000, "5XY?"},
+        {0xF000, 0x6000, "6XNN"},
+        {0xF000, 0x7000, "7XNN"},
+        {0xF00F, 0x8000, "8XY0"},
+        {0xF00F, 0x8001, "8XY1"},
+        {0xF00F, 0x8002, "8XY2"},
+        {0xF00F, 0x8003, "8XY3"},
+        {0xF00F, 0x8004, "8XY4"},
+        {0xF00F, 0x8005, "8XY5"},
+        {0xF00F, 0x8006, "8XY6"},
+        {0xF00F, 0x8007, "8XY7"},
+        {0xF00F, 0x800E, "8XYE"},
+        {0xF000, 0x8000, "8XY?"},
+        {0xF000, 0x9000, "9XY0"},
+        {0xF000, 0xA000, "ANNN"},
+        {0xF000, 0xB000, "BNNN"},
+        {0xF000, 0xC000, "CXNN"},
+        {0xF00F, 0xD000, "DXY0"},
+        {0xF000, 0xD000, "DXYN"},
+        {0xF0FF, 0xE09E, "EX9E"},
+        {0xF0FF, 0xE0A1, "EXA1"},
+        {0xF000, 0xE000, "EX??"},
+        {0xFFFF, 0xF000, "F000"},
+        {0xFFFF, 0xF002, "F002"},
+        {0xF0FF, 0xF001, "FN01"},
+        {0xF0FF, 0xF007, "FX07"},
+        {0xF0FF, 0xF00A, "FX0A"},
+        {0xF0FF, 0xF015, "FX15"},
+        {0xF0FF, 0xF018, "FX18"},
+        {0xF0FF, 0xF01E, "FX1E"},
+        {0xF0FF, 0xF029, "FX29"},
+        {0xF0FF, 0xF030, "FX30"},
+        {0xF0FF, 0xF033, "FX33"},
+        {0xF0FF, 0xF03A, "FX3A"},
+        {0xF0FF, 0xF055, "FX55"},
+        {0xF0FF, 0xF065, "FX65"},
+        {0xF0FF, 0xF075, "FX75"},
+        {0xF0FF, 0xF085, "FX85"},
+        {0xF000, 0xF000, "FX??"},
+    };
+    const int patternCount = static_cast<int>(sizeof patterns / sizeof patterns[0]);
+    static_assert(sizeof patterns / sizeof patterns[0] == Chip8Profile::classCount, "classCount out of date");
+
+    // Every opcode mapped once, profiling runs look it up per instruction
+    const std::array<uint8_t, 0x10000> &classTable()
+    {
+        static const std::array<uint8_t, 0x10000> table = []
+        {
+            std::array<uint8_t, 0x10000> t{};
+            for (size_t op = 0; op < t.size(); ++op)
+            {
+                int cls = 0;
+                while (cls < patternCount && (op & patterns[cls].mask) != patterns[cls].value)
+                    ++cls;
+                t[op] = static_cast<uint8_t>(cls);
+            }
+            return t;
+        }();
+        return table;
+    }
+}
+
+Chip8Profile::Chip8Profile(size_t memorySize)
+    : pcExecutions(memorySize, 0)
+{
+}
+
+int Chip8Profile::opcodeClass(uint16_t opcode)
+{
+    return classTable()[opcode];
+}
+
+const char *Chip8Profile::className(int cls)
+{
+    return cls >= 0 && cls < patternCount ? patterns[cls].name : "????";
+}
+
+void Chip8Profile::reset()
+{
+    classExecutions.fill(0);
+    classNanos.fill(0);
+    std::fill(pcExecutions.begin(), pcExecutions.end(), 0);
+    // The path being run stays, only its counts go
+    for (CallNode &node : callNodes)
+    {
+        node.calls = 0;
+        node.instructions = 0;
+        node.nanos = 0;
+    }
+}
+
+uint32_t Chip8Profile::child(uint32_t parent, uint16_t address)
+{
+    const uint64_t key = (static_cast<uint64_t>(parent) << 16) | address;
+    auto found = callChildren.find(key);
+    if (found != callChildren.end())
+        return found->second;
+    CallNode node;
+    node.parent = parent;
+    node.address = address;
+    node.depth = static_cast<uint8_t>(callNodes[parent].depth + 1);
+    callNodes.push_back(node);
+    const uint32_t index = static_cast<uint32_t>(callNodes.size() - 1);
+    callChildren.emplace(key, index);
+    return index;
+}
+
+void Chip8Profile::enterCall(uint16_t address)
+{
+    if (callNodes[currentCall].depth >= maxCallDepth)
+    {
+        ++foldedCalls;
+        return;
+    }
+    currentCall = child(currentCall, address);
+    ++callNodes[currentCall].calls;
+}
+
+void Chip8Profile::leaveCall()
+{
+    if (foldedCalls)
+        --foldedCalls;
+    else if (currentCall != 0)
+        currentCall = callNodes[currentCall].parent;
+    // A 00EE outside any call pops whatever the stack wrapped onto; the
+    // path stays at the root
+}
+
+void Chip8Profile::restartCalls(const uint16_t *callees, int depth)
+{
+    currentCall = 0;
+    foldedCalls = 0;
+    for (int i = 0; i < depth; ++i)
+        enterCall(callees[i]);
+    // Re-entering isn't a call the program made
+    for (uint32_t node = currentCall; node != 0; node = callNodes[node].parent)
+        --callNodes[node].calls;
+}
+
+std::string Chip8Profile::pathName(uint32_t node) const
+{
+    if (node == 0)
+        return "main";
+    char name[16];
+    std::snprintf(name, sizeof name, ";sub_%03X", callNodes[node].address);
+    return pathName(callNodes[node].parent) + name;
+}
+
+std::vector<Chip8Profile::Subroutine> Chip8Profile::subroutines() const
+{
+    // Children always come after their parents, so one pass from the end
+    // adds every path's cost into the paths above it
+    std::vector<uint64_t> treeInstructions(callNodes.size()), treeNanos(callNodes.size());
+    for (size_t i = callNodes.size(); i-- > 0;)
+    {
+        treeInstructions[i] += callNodes[i].instructions;
+        treeNanos[i] += callNodes[i].nanos;
+        if (i != 0)
+        {
+            treeInstructions[callNodes[i].parent] += treeInstructions[i];
+            treeNanos[callNodes[i].parent] += treeNanos[i];
+        }
+    }
+
+    std::unordered_map<uint16_t, size_t> index;
+    std::vector<Subroutine> out;
+    out.push_back({});
+    for (size_t i = 0; i < callNodes.size(); ++i)
+    {
+        const CallNode &node = callNodes[i];
+        size_t at = 0;
+        if (i != 0)
+        {
+            auto found = index.find(node.address);
+            if (found == index.end())
+            {
+                found = index.emplace(node.address, out.size()).first;
+                out.push_back({});
+                out.back().address = node.address;
+            }
+            at = found->second;
+        }
+        Subroutine &sub = out[at];
+        sub.calls += node.calls;
+        sub.exclusiveInstructions += node.instructions;
+        sub.exclusiveNanos += node.nanos;
+
+        // A recursive path is already inside its outermost entry's cost
+        bool nested = false;
+        for (uint32_t up = node.parent; up != 0 && !nested && i != 0; up = callNodes[up].parent)
+            nested = callNodes[up].address == node.address;
+        if (!nested)
+        {
+            sub.inclusiveInstructions += treeInstructions[i];
+            sub.inclusiveNanos += treeNanos[i];
+        }
+    }
+    std::sort(out.begin() + 1, out.end(), [](const Subroutine &a, const Subroutine &b)
+              { return a.inclusiveInstructions != b.inclusiveInstructions ? a.inclusiveInstructions > b.inclusiveInstructions
+                                                                          : a.address < b.address; });
+    return out;
+}
+
+std::string Chip8Profile::callReport(size_t topN) const
+{
+    std::string out;
+    char line[160];
+    const std::vector<Subroutine> subs = subroutines();
+    const uint64_t total = subs[0].inclusiveInstructions;
+
+    out += "routine       calls   incl insns incl %   excl insns excl %   incl ms   excl ms\n";
+    for (size_t i = 0; i < subs.size() && i <= topN; ++i)
+    {
+        const Subroutine &sub = subs[i];
+        char name[16];
+        if (i == 0)
+            std::snprintf(name, sizeof name, "main");
+        else
+            std::snprintf(name, sizeof name, "sub_%03X", sub.address);
+        std::snprintf(line, sizeof line, "%-8s %10llu %12llu %6.2f %12llu %6.2f %9.2f %9.2f\n", name,
+                      static_cast<unsigned long long>(sub.calls), static_cast<unsigned long long>(sub.inclusiveInstructions),
+                      total ? 100.0 * sub.inclusiveInstructions / total : 0.0,
+                      static_cast<unsigned long long>(sub.exclusiveInstructions),
+                      total ? 100.0 * sub.exclusiveInstructions / total : 0.0, sub.inclusiveNanos / 1e6, sub.exclusiveNanos / 1e6);
+        out += line;
+    }
+    return out;
+}
+
+std::string Chip8Profile::collapsedStacks(bool byTime) const
+{
+    std::string out;
+    char count[32];
+    for (uint32_t i = 0; i < callNodes.size(); ++i)
+    {
+        const uint64_t weight = byTime ? callNodes[i].nanos : callNodes[i].instructions;
+        if (!weight)
+            continue;
+        std::snprintf(count, sizeof count, " %llu\n", static_cast<unsigned long long>(weight));
+        out += pathName(i);
+        out += count;
+    }
+    return out;
+}
+
+uint64_t Chip8Profile::totalExecutions() const
+{
+    uint64_t total = 0;
+    for (uint64_t count : classExecutions)
+        total += count;
+    return total;
+}
+
+std::vector<std::pair<uint16_t, uint64_t>> Chip8Profile::hotAddresses(size_t n) const
+{
+    std::vector<std::pair<uint16_t, uint64_t>> hot;
+    for (size_t pc = 0; pc < pcExecutions.size(); ++pc)
+    {
+        if (pcExecutions[pc])
+            hot.push_back({static_cast<uint16_t>(pc), pcExecutions[pc]});
+    }
+    n = std::min(n, hot.size());
+    std::partial_sort(hot.begin(), hot.begin() + n, hot.end(), [](const auto &a, const auto &b)
+                      { return a.second > b.second; });
+    hot.resize(n);
+    return hot;
+}
+
+std::string Chip8Profile::report(size_t topN) const
+{
+    std::string out;
+    char line[128];
+    uint64_t total = totalExecutions();
+    uint64_t totalNanos = 0;
+    for (uint64_t ns : classNanos)
+        totalNanos += ns;
+
+    out += "class        count      %     ns/op   time %\n";
+    for (int cls = 0; cls < classCount; ++cls)
+    {
+        if (!classExecutions[cls])
+            continue;
+        std::snprintf(line, sizeof line, "%-6s %12llu %6.2f %9.1f %8.2f\n", className(cls),
+                      static_cast<unsigned long long>(classExecutions[cls]), 100.0 * classExecutions[cls] / total,
+                      static_cast<double>(classNanos[cls]) / classExecutions[cls],
+                      totalNanos ? 100.0 * classNanos[cls] / totalNanos : 0.0);
+        out += line;
+    }
+
+    out += "\naddress      count      %\n";
+    for (const auto &entry : hotAddresses(topN))
+    {
+        std::snprintf(line, sizeof line, "%04X   %12llu %6.2f\n", entry.first,
+                      static_cast<unsigned long long>(entry.second), 100.0 * entry.second / total);
+        out += line;
+    }
+    return out;
+}
@@ -0,0 +1,140 @@
+#ifndef CHIP8_PROFILE_H
+#define CHIP8_PROFILE_H
+
+#include <array>   // For per-class counters
+#include <chrono>  // For handler timing
+#include <cstdint> // For counters
+#include <string>        // For the report
+#include <unordered_map> // For the call tree's child lookup
+#include <utility>       // For std::pair
+#include <vector>        // For per-address counters
+
+// Execution counts per opcode class and per address, and host time per
+// opcode class. Only built into Chip8 when CHIP8_PROFILE is defined;
+// without it the interpreter has no trace of the instrumentation.
+//
+// It also follows 2NNN and 00EE to keep a tree of call paths, each with
+// the instructions and host time spent in it directly. From that come
+// every subroutine's inclusive and exclusive cost, and a collapsed-stack
+// listing for flame graphs. Paths are cut at the machine's 16 stack
+// entries: deeper calls are charged to the subroutine that made them.
+class Chip8Profile
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr int classCount = 55;
+
+    explicit Chip8Profile(size_t memorySize);
+
+    // Class index of an opcode, and its name such as "DXYN" or "8XY4"
+    static int opcodeClass(uint16_t opcode);
+    static const char *className(int cls);
+
+    static constexpr int maxCallDepth = 16;
+
+    // One subroutine's cost; inclusive counts each recursive entry once
+    struct Subroutine
+    {
+        uint16_t address = 0; // 0 for the code outside any call
+        uint64_t calls = 0;
+        uint64_t inclusiveInstructions = 0;
+        uint64_t exclusiveInstructions = 0;
+        uint64_t inclusiveNanos = 0;
+        uint64_t exclusiveNanos = 0;
+    };
+
+    void record(uint16_t pc, uint16_t opcode, Clock::duration elapsed)
+    {
+        int cls = opcodeClass(opcode);
+        uint64_t nanos = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+        ++classExecutions[cls];
+        classNanos[cls] += nanos;
+        ++pcExecutions[pc % pcExecutions.size()];
+
+        // A 2NNN is the caller's, a 00EE the callee's last instruction
+        CallNode &node = callNodes[currentCall];
+        ++node.instructions;
+        node.nanos += nanos;
+        if ((opcode & 0xF000) == 0x2000)
+            enterCall(opcode & 0x0FFF);
+        else if (opcode == 0x00EE)
+            leaveCall();
+    }
+
+    // Puts the call path back at the given callees, outermost first, after
+    // the machine was reset or a state restored
+    void restartCalls(const uint16_t *callees, int depth);
+
+    void reset();
+
+    uint64_t executions(int cls) const { return classExecutions[cls]; }
+    uint64_t nanoseconds(int cls) const { return classNanos[cls]; }
+    uint64_t executionsAt(uint16_t pc) const { return pcExecutions[pc % pcExecutions.size()]; }
+    uint64_t totalExecutions() const;
+
+    // The n most executed addresses, most executed first
+    std::vector<std::pair<uint16_t, uint64_t>> hotAddresses(size_t n) const;
+
+    // Text table of every executed class, then the top n addresses
+    std::string report(size_t topN = 20) const;
+
+    // Every subroutine entered, the code outside calls first and then by
+    // inclusive instructions
+    std::vector<Subroutine> subroutines() const;
+
+    // Text table of the n subroutines with the most inclusive instructions
+    std::string callReport(size_t topN = 20) const;
+
+    // One line per call path, "main;sub_0234;sub_0250 1234", weighted by
+    // instructions or by host nanoseconds, for flamegraph.pl or speedscope
+    std::string collapsedStacks(bool byTime = false) const;
+
+    // Times one instruction from construction to destruction
+    class Scope
+    {
+    public:
+        Scope(Chip8Profile &profileRef, uint16_t pcValue, uint16_t opcodeValue)
+            : profile(profileRef), pc(pcValue), opcode(opcodeValue), start(Clock::now())
+        {
+        }
+        ~Scope() { profile.record(pc, opcode, Clock::now() - start); }
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        Chip8Profile &profile;
+        uint16_t pc;
+        uint16_t opcode;
+        Clock::time_point start;
+    };
+
+private:
+    // A call path: its callee and the path it was called from
+    struct CallNode
+    {
+        uint32_t parent = 0;
+        uint16_t address = 0;
+        uint8_t depth = 0;
+        uint64_t calls = 0;
+        uint64_t instructions = 0; // Run in this path itself, not in deeper calls
+        uint64_t nanos = 0;
+    };
+
+    void enterCall(uint16_t address);
+    void leaveCall();
+    uint32_t child(uint32_t parent, uint16_t address);
+    std::string pathName(uint32_t node) const;
+
+    std::vector<CallNode> callNodes{CallNode{}}; // The root is the code outside any call
+    std::unordered_map<uint64_t, uint32_t> callChildren; // parent << 16 | address
+    uint32_t currentCall = 0;
+    uint32_t foldedCalls = 0; // Made past maxCallDepth but not yet returned from
+
+    std::array<uint64_t, classCount> classExecutions{};
+    std::array<uint64_t, classCount> classNanos{};
+    std::vector<uint64_t> pcExecutions;
+};
+
+#endif
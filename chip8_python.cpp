@@ -0,0 +1,678 @@
+// Python module: the headless core as chip8.Env, one Chip8Env, and
+// chip8.VectorEnv, many of them stepped together on a thread pool with
+// the GIL released. Screens, memory, rewards and done flags are exposed
+// as memoryviews straight over the C++ arrays, so numpy.asarray() on them
+// copies nothing; they stay valid while the environment lives and always
+// show its current state.
+//
+//   import chip8, numpy as np
+//   env = chip8.VectorEnv(open("pong.ch8", "rb").read(), 256)
+//   env.add_watch(chip8.WATCH_BCD, chip8.WATCH_DELTA, 0x2F0)
+//   screens = np.asarray(env.framebuffers)  # (256, 64, 2) uint64
+//   rewards, done = env.step(np.zeros(256, np.uint16), frames=4)
+//
+// Written against the CPython C API so it needs nothing but Python's
+// headers; see the README for the build line.
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "chip8_env.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <vector>
+
+namespace
+{
+    // A read-only N-dimensional array owned by another object, which it
+    // keeps alive; what the memoryviews below are made from
+    struct ArrayView
+    {
+        PyObject_HEAD
+        PyObject *owner;
+        void *data;
+        int ndim;
+        Py_ssize_t shape[3];
+        Py_ssize_t strides[3];
+        Py_ssize_t itemSize;
+        const char *format;
+    };
+    PyTypeObject *arrayViewType = nullptr;
+
+    int arrayViewGetBuffer(PyObject *self, Py_buffer *view, int flags)
+    {
+        ArrayView *array = reinterpret_cast<ArrayView *>(self);
+        if (flags & PyBUF_WRITABLE)
+        {
+            PyErr_SetString(PyExc_BufferError, "emulator state is read-only");
+            return -1;
+        }
+        view->buf = array->data;
+        view->obj = self;
+        Py_INCREF(self);
+        view->len = array->itemSize;
+        for (int d = 0; d < array->ndim; ++d)
+            view->len *= array->shape[d];
+        view->readonly = 1;
+        view->itemsize = array->itemSize;
+        view->format = (flags & PyBUF_FORMAT) ? const_cast<char *>(array->format) : nullptr;
+        view->ndim = array->ndim;
+        view->shape = (flags & PyBUF_ND) ? array->shape : nullptr;
+        view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? array->strides : nullptr;
+        view->suboffsets = nullptr;
+        view->internal = nullptr;
+        return 0;
+    }
+
+    void arrayViewDealloc(PyObject *self)
+    {
+        PyTypeObject *type = Py_TYPE(self);
+        Py_XDECREF(reinterpret_cast<ArrayView *>(self)->owner);
+        type->tp_free(self);
+        Py_DECREF(type);
+    }
+
+    PyType_Slot arrayViewSlots[] = {
+        {Py_bf_getbuffer, reinterpret_cast<void *>(arrayViewGetBuffer)},
+        {Py_tp_dealloc, reinterpret_cast<void *>(arrayViewDealloc)},
+        {0, nullptr},
+    };
+    PyType_Spec arrayViewSpec = {"chip8._ArrayView", sizeof(ArrayView), 0, Py_TPFLAGS_DEFAULT, arrayViewSlots};
+
+    // memoryview over data, C order, shape given outermost first
+    PyObject *viewOf(PyObject *owner, const void *data, const char *format, Py_ssize_t itemSize,
+                     std::initializer_list<Py_ssize_t> shape)
+    {
+        ArrayView *array = PyObject_New(ArrayView, arrayViewType);
+        if (!array)
+            return nullptr;
+        array->owner = owner;
+        Py_INCREF(owner);
+        array->data = const_cast<void *>(data);
+        array->ndim = static_cast<int>(shape.size());
+        array->itemSize = itemSize;
+        array->format = format;
+        std::copy(shape.begin(), shape.end(), array->shape);
+        Py_ssize_t stride = itemSize;
+        for (int d = array->ndim - 1; d >= 0; --d)
+        {
+            array->strides[d] = stride;
+            stride *= array->shape[d];
+        }
+        PyObject *view = PyMemoryView_FromObject(reinterpret_cast<PyObject *>(array));
+        Py_DECREF(array);
+        return view;
+    }
+
+    bool parseWatch(PyObject *args, PyObject *kwargs, Chip8Env::Watch &watch)
+    {
+        static const char *keywords[] = {"source", "kind", "address", "target", "weight", nullptr};
+        int source = 0, kind = 0;
+        unsigned address = 0;
+        int target = 0;
+        float weight = 1.0f;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "iiI|if", const_cast<char **>(keywords), &source, &kind, &address,
+                                         &target, &weight))
+            return false;
+        if (source < CHIP8_WATCH_BYTE || source > CHIP8_WATCH_REGISTER || kind < CHIP8_WATCH_DELTA ||
+            kind > CHIP8_WATCH_END_EQUAL)
+        {
+            PyErr_SetString(PyExc_ValueError, "unknown watch source or kind");
+            return false;
+        }
+        watch = Chip8Env::Watch{source, kind, static_cast<uint16_t>(address), target, weight};
+        return true;
+    }
+
+    // The ROM image from anything holding bytes
+    bool romBytes(PyObject *rom, std::vector<uint8_t> &out)
+    {
+        Py_buffer buffer;
+        if (PyObject_GetBuffer(rom, &buffer, PyBUF_SIMPLE) != 0)
+            return false;
+        const uint8_t *bytes = static_cast<const uint8_t *>(buffer.buf);
+        out.assign(bytes, bytes + buffer.len);
+        PyBuffer_Release(&buffer);
+        return true;
+    }
+
+    // ---- Env ----
+
+    struct EnvObject
+    {
+        PyObject_HEAD
+        Chip8Env *env;
+    };
+
+    int envInit(PyObject *self, PyObject *args, PyObject *kwargs)
+    {
+        static const char *keywords[] = {"rom", "ipf", nullptr};
+        PyObject *rom = nullptr;
+        int ipf = 10;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", const_cast<char **>(keywords), &rom, &ipf))
+            return -1;
+        std::vector<uint8_t> image;
+        if (!romBytes(rom, image))
+            return -1;
+        EnvObject *object = reinterpret_cast<EnvObject *>(self);
+        delete object->env;
+        object->env = new (std::nothrow) Chip8Env(image.data(), image.size(), ipf);
+        if (!object->env)
+        {
+            PyErr_NoMemory();
+            return -1;
+        }
+        if (!object->env->isLoaded())
+        {
+            PyErr_SetString(PyExc_ValueError, "ROM doesn't fit in memory");
+            return -1;
+        }
+        return 0;
+    }
+
+    void envDealloc(PyObject *self)
+    {
+        PyTypeObject *type = Py_TYPE(self);
+        delete reinterpret_cast<EnvObject *>(self)->env;
+        type->tp_free(self);
+        Py_DECREF(type);
+    }
+
+    Chip8Env *envOf(PyObject *self)
+    {
+        Chip8Env *env = reinterpret_cast<EnvObject *>(self)->env;
+        if (!env)
+            PyErr_SetString(PyExc_RuntimeError, "Env.__init__ wasn't called");
+        return env;
+    }
+
+    PyObject *envReset(PyObject *self, PyObject *args, PyObject *kwargs)
+    {
+        static const char *keywords[] = {"seed", nullptr};
+        unsigned long long seed = 0;
+        Chip8Env *env = envOf(self);
+        if (!env || !PyArg_ParseTupleAndKeywords(args, kwargs, "|K", const_cast<char **>(keywords), &seed))
+            return nullptr;
+        env->reset(seed);
+        Py_RETURN_NONE;
+    }
+
+    PyObject *envStep(PyObject *self, PyObject *args, PyObject *kwargs)
+    {
+        static const char *keywords[] = {"keys", "frames", nullptr};
+        unsigned keys = 0;
+        int frames = 1;
+        Chip8Env *env = envOf(self);
+        if (!env || !PyArg_ParseTupleAndKeywords(args, kwargs, "|Ii", const_cast<char **>(keywords), &keys, &frames))
+            return nullptr;
+        Chip8Env::StepResult result;
+        Py_BEGIN_ALLOW_THREADS;
+        result = env->step(static_cast<uint16_t>(keys), frames);
+        Py_END_ALLOW_THREADS;
+        return Py_BuildValue("(fO)", result.reward, result.done ? Py_True : Py_False);
+    }
+
+    PyObject *envAddWatch(PyObject *self, PyObject *args, PyObject *kwargs)
+    {
+        Chip8Env *env = envOf(self);
+        Chip8Env::Watch watch;
+        if (!env || !parseWatch(args, kwargs, watch))
+            return nullptr;
+        return PyBool_FromLong(env->addWatch(watch));
+    }
+
+    PyObject *envPixels(PyObject *self, PyObject *)
+    {
+        Chip8Env *env = envOf(self);
+        if (!env)
+            return nullptr;
+        const int width = env->chip8().width();
+        const int height = env->chip8().height();
+        PyObject *bytes = PyBytes_FromStringAndSize(nullptr, width * height);
+        if (!bytes)
+            return nullptr;
+        env->copyPixels(reinterpret_cast<uint8_t *>(PyBytes_AS_STRING(bytes)), static_cast<size_t>(width * height));
+        PyObject *view = viewOf(bytes, PyBytes_AS_STRING(bytes), "B", 1, {height, width});
+        Py_DECREF(bytes);
+        return view;
+    }
+
+    PyObject *envCloneState(PyObject *self, PyObject *)
+    {
+        Chip8Env *env = envOf(self);
+        if (!env)
+            return nullptr;
+        Chip8Env::State state;
+        env->cloneState(state);
+        return PyBytes_FromStringAndSize(reinterpret_cast<const char *>(&state), sizeof state);
+    }
+
+    PyObject *envRestoreState(PyObject *self, PyObject *arg)
+    {
+        Chip8Env *env = envOf(self);
+        Py_buffer buffer;
+        if (!env || PyObject_GetBuffer(arg, &buffer, PyBUF_SIMPLE) != 0)
+            return nullptr;
+        if (buffer.len != static_cast<Py_ssize_t>(sizeof(Chip8Env::State)))
+        {
+            PyBuffer_Release(&buffer);
+            PyErr_SetString(PyExc_ValueError, "not a state from clone_state");
+            return nullptr;
+        }
+        Chip8Env::State state;
+        std::memcpy(&state, buffer.buf, sizeof state);
+        PyBuffer_Release(&buffer);
+        env->restoreState(state);
+        Py_RETURN_NONE;
+    }
+
+    PyObject *envFramebuffer(PyObject *self, void *)
+    {
+        Chip8Env *env = envOf(self);
+        return env ? viewOf(self, env->screen().data(), "Q", 8, {64, Chip8::rowWords}) : nullptr;
+    }
+
+    PyObject *envMemory(PyObject *self, void *)
+    {
+        Chip8Env *env = envOf(self);
+        return env ? viewOf(self, env->chip8().getMemory().data(), "B", 1, {Chip8::memorySize}) : nullptr;
+    }
+
+    PyObject *envHires(PyObject *self, void *)
+    {
+        Chip8Env *env = envOf(self);
+        return env ? PyBool_FromLong(env->isHires()) : nullptr;
+    }
+
+    PyMethodDef envMethods[] = {
+        {"reset", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(envReset)), METH_VARARGS | METH_KEYWORDS,
+         "reset(seed=0): boot the ROM again with CXNN seeded, no keys down"},
+        {"step", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(envStep)), METH_VARARGS | METH_KEYWORDS,
+         "step(keys=0, frames=1) -> (reward, done): hold keys, bit k = key k, for frames frames"},
+        {"add_watch", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(envAddWatch)), METH_VARARGS | METH_KEYWORDS,
+         "add_watch(source, kind, address, target=0, weight=1.0) -> bool: a reward or end-of-episode watch"},
+        {"pixels", envPixels, METH_NOARGS, "pixels() -> memoryview: a copy of the screen, one byte per pixel, (height, width)"},
+        {"clone_state", envCloneState, METH_NOARGS, "clone_state() -> bytes"},
+        {"restore_state", envRestoreState, METH_O, "restore_state(state): back to a clone_state result"},
+        {nullptr, nullptr, 0, nullptr},
+    };
+
+    PyGetSetDef envGetters[] = {
+        {"framebuffer", envFramebuffer, nullptr,
+         "The live screen, (64, 2) uint64, Chip8::gfx layout; lo-res uses the first word of the top 32 rows", nullptr},
+        {"memory", envMemory, nullptr, "The live memory, 4096 uint8", nullptr},
+        {"hires", envHires, nullptr, "True in 128x64 mode", nullptr},
+        {nullptr, nullptr, nullptr, nullptr, nullptr},
+    };
+
+    PyType_Slot envSlots[] = {
+        {Py_tp_doc, const_cast<char *>("Env(rom, ipf=10): one classic machine as a reinforcement-learning environment")},
+        {Py_tp_new, reinterpret_cast<void *>(PyType_GenericNew)},
+        {Py_tp_init, reinterpret_cast<void *>(envInit)},
+        {Py_tp_dealloc, reinterpret_cast<void *>(envDealloc)},
+        {Py_tp_methods, envMethods},
+        {Py_tp_getset, envGetters},
+        {0, nullptr},
+    };
+    PyType_Spec envSpec = {"chip8.Env", sizeof(EnvObject), 0, Py_TPFLAGS_DEFAULT, envSlots};
+
+    // ---- VectorEnv ----
+
+    // n environments stepped in chunks on a pool. Results land in arrays
+    // allocated once, so the views handed out never dangle.
+    struct Vector
+    {
+        std::vector<std::unique_ptr<Chip8Env>> envs;
+        std::unique_ptr<ThreadPool> pool;
+        bool autoReset = true;
+        std::vector<uint16_t> keys;
+        std::vector<uint64_t> seeds; // Next seed per environment
+        std::vector<uint64_t> screens; // 128 words per environment
+        std::vector<float> rewards;
+        std::vector<uint8_t> done;
+        std::vector<uint8_t> hires;
+
+        size_t size() const { return envs.size(); }
+
+        // fn(first, last) over every environment, in parallel
+        template <typename Fn>
+        void forChunks(Fn fn)
+        {
+            const size_t n = size();
+            const size_t chunk = std::max<size_t>(1, n / (pool->size() * 4));
+            for (size_t first = 0; first < n; first += chunk)
+            {
+                const size_t last = std::min(n, first + chunk);
+                pool->submit([&fn, first, last]
+                             { fn(first, last); });
+            }
+            pool->wait();
+        }
+
+        void publish(size_t i)
+        {
+            std::memcpy(&screens[i * 128], envs[i]->screen().data(), 128 * sizeof(uint64_t));
+            hires[i] = envs[i]->isHires() ? 1 : 0;
+        }
+
+        void resetOne(size_t i)
+        {
+            envs[i]->reset(seeds[i]);
+            seeds[i] += size(); // The next episode gets a seed no other has had
+            publish(i);
+        }
+    };
+
+    struct VectorObject
+    {
+        PyObject_HEAD
+        Vector *vector;
+    };
+
+    int vectorInit(PyObject *self, PyObject *args, PyObject *kwargs)
+    {
+        static const char *keywords[] = {"rom", "n", "ipf", "threads", "auto_reset", "seed", nullptr};
+        PyObject *rom = nullptr;
+        Py_ssize_t n = 0;
+        int ipf = 10;
+        unsigned threads = 0;
+        int autoReset = 1;
+        unsigned long long seed = 0;
+        if (!PyArg_ParseTupleAndKeywords(args, kwargs, "On|iIpK", const_cast<char **>(keywords), &rom, &n, &ipf, &threads,
+                                         &autoReset, &seed))
+            return -1;
+        if (n < 1)
+        {
+            PyErr_SetString(PyExc_ValueError, "n must be at least 1");
+            return -1;
+        }
+        std::vector<uint8_t> image;
+        if (!romBytes(rom, image))
+            return -1;
+
+        VectorObject *object = reinterpret_cast<VectorObject *>(self);
+        delete object->vector;
+        object->vector = nullptr;
+        std::unique_ptr<Vector> vector;
+        bool loaded = true;
+        try
+        {
+            vector = std::make_unique<Vector>();
+            vector->pool = std::make_unique<ThreadPool>(threads);
+            vector->autoReset = autoReset != 0;
+            vector->envs.resize(static_cast<size_t>(n));
+            vector->keys.assign(n, 0);
+            vector->seeds.resize(n);
+            vector->screens.assign(n * 128, 0);
+            vector->rewards.assign(n, 0.0f);
+            vector->done.assign(n, 0);
+            vector->hires.assign(n, 0);
+            Vector *v = vector.get();
+            Py_BEGIN_ALLOW_THREADS;
+            v->forChunks([v, &image, ipf, seed](size_t first, size_t last)
+                         {
+                             for (size_t i = first; i < last; ++i)
+                             {
+                                 v->envs[i] = std::make_unique<Chip8Env>(image.data(), image.size(), ipf);
+                                 v->seeds[i] = seed + i;
+                                 v->resetOne(i);
+                             } });
+            Py_END_ALLOW_THREADS;
+            loaded = vector->envs[0]->isLoaded();
+        }
+        catch (const std::bad_alloc &)
+        {
+            PyErr_NoMemory();
+            return -1;
+        }
+        if (!loaded)
+        {
+            PyErr_SetString(PyExc_ValueError, "ROM doesn't fit in memory");
+            return -1;
+        }
+        object->vector = vector.release();
+        return 0;
+    }
+
+    void vectorDealloc(PyObject *self)
+    {
+        PyTypeObject *type = Py_TYPE(self);
+        delete reinterpret_cast<VectorObject *>(self)->vector;
+        type->tp_free(self);
+        Py_DECREF(type);
+    }
+
+    Vector *vectorOf(PyObject *self)
+    {
+        Vector *vector = reinterpret_cast<VectorObject *>(self)->vector;
+        if (!vector)
+            PyErr_SetString(PyExc_RuntimeError, "VectorEnv.__init__ wasn't called");
+        return vector;
+    }
+
+    // keys as n uint16 (a NumPy array or any buffer of them), any sequence
+    // of n integers, or one integer for every environment
+    bool parseKeys(PyObject *keys, Vector &vector)
+    {
+        const size_t n = vector.size();
+        if (PyLong_Check(keys))
+        {
+            const unsigned long mask = PyLong_AsUnsignedLongMask(keys);
+            std::fill(vector.keys.begin(), vector.keys.end(), static_cast<uint16_t>(mask));
+            return !PyErr_Occurred();
+        }
+        if (PyObject_CheckBuffer(keys))
+        {
+            Py_buffer buffer;
+            if (PyObject_GetBuffer(keys, &buffer, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) == 0)
+            {
+                const bool fits = buffer.itemsize == 2 && buffer.len == static_cast<Py_ssize_t>(n * 2) && buffer.format &&
+                                  (std::strcmp(buffer.format, "H") == 0 || std::strcmp(buffer.format, "=H") == 0 ||
+                                   std::strcmp(buffer.format, "<H") == 0);
+                if (fits)
+                    std::memcpy(vector.keys.data(), buffer.buf, n * 2);
+                PyBuffer_Release(&buffer);
+                if (fits)
+                    return true;
+            }
+            PyErr_Clear(); // Other formats go through the sequence path
+        }
+        PyObject *sequence = PySequence_Fast(keys, "keys must be an int, n uint16 values or a sequence of n ints");
+        if (!sequence)
+            return false;
+        if (static_cast<size_t>(PySequence_Fast_GET_SIZE(sequence)) != n)
+        {
+            Py_DECREF(sequence);
+            PyErr_SetString(PyExc_ValueError, "keys must have one entry per environment");
+            return false;
+        }
+        for (size_t i = 0; i < n; ++i)
+            vector.keys[i] = static_cast<uint16_t>(PyLong_AsUnsignedLongMask(PySequence_Fast_GET_ITEM(sequence, i)));
+        Py_DECREF(sequence);
+        return !PyErr_Occurred();
+    }
+
+    PyObject *vectorRewards(PyObject *self, void *);
+    PyObject *vectorDone(PyObject *self, void *);
+
+    PyObject *vectorStep(PyObject *self, PyObject *args, PyObject *kwargs)
+    {
+        static const char *keywords[] = {"keys", "frames", nullptr};
+        PyObject *keys = nullptr;
+        int frames = 1;
+        Vector *vector = vectorOf(self);
+        if (!vector || !PyArg_ParseTupleAndKeywords(args, kwargs, "O|i", const_cast<char **>(keywords), &keys, &frames) ||
+            !parseKeys(keys, *vector))
+            return nullptr;
+        Py_BEGIN_ALLOW_THREADS;
+        vector->forChunks([vector, frames](size_t first, size_t last)
+                          {
+                              for (size_t i = first; i < last; ++i)
+                              {
+                                  // Episodes that ended last step start over first
+                                  if (vector->autoReset && vector->done[i])
+                                      vector->resetOne(i);
+                                  const Chip8Env::StepResult result = vector->envs[i]->step(vector->keys[i], frames);
+                                  vector->rewards[i] = result.reward;
+                                  vector->done[i] = result.done ? 1 : 0;
+                                  vector->publish(i);
+                              } });
+        Py_END_ALLOW_THREADS;
+        PyObject *rewards = vectorRewards(self, nullptr);
+        PyObject *done = rewards ? vectorDone(self, nullptr) : nullptr;
+        if (!done)
+        {
+            Py_XDECREF(rewards);
+            return nullptr;
+        }
+        return Py_BuildValue("(NN)", rewards, done);
+    }
+
+    PyObject *vectorReset(PyObject *self, PyObject *args, PyObject *kwargs)
+    {
+        static const char *keywords[] = {"seed", "index", nullptr};
+        PyObject *seedArg = Py_None;
+        Py_ssize_t index = -1;
+        Vector *vector = vectorOf(self);
+        if (!vector || !PyArg_ParseTupleAndKeywords(args, kwargs, "|On", const_cast<char **>(keywords), &seedArg, &index))
+            return nullptr;
+        if (index >= static_cast<Py_ssize_t>(vector->size()))
+        {
+            PyErr_SetString(PyExc_IndexError, "no such environment");
+            return nullptr;
+        }
+        // A seed starts seed, seed + 1, ... over the environments reset
+        bool seeded = seedArg != Py_None;
+        unsigned long long seed = seeded ? PyLong_AsUnsignedLongLong(seedArg) : 0;
+        if (PyErr_Occurred())
+            return nullptr;
+        const size_t first = index < 0 ? 0 : static_cast<size_t>(index);
+        const size_t last = index < 0 ? vector->size() : first + 1;
+        for (size_t i = first; i < last && seeded; ++i)
+            vector->seeds[i] = seed + (i - first);
+        Py_BEGIN_ALLOW_THREADS;
+        vector->forChunks([vector, first, last](size_t from, size_t to)
+                          {
+                              for (size_t i = std::max(from, first); i < std::min(to, last); ++i)
+                              {
+                                  vector->resetOne(i);
+                                  vector->rewards[i] = 0.0f;
+                                  vector->done[i] = 0;
+                              } });
+        Py_END_ALLOW_THREADS;
+        Py_RETURN_NONE;
+    }
+
+    PyObject *vectorAddWatch(PyObject *self, PyObject *args, PyObject *kwargs)
+    {
+        Vector *vector = vectorOf(self);
+        Chip8Env::Watch watch;
+        if (!vector || !parseWatch(args, kwargs, watch))
+            return nullptr;
+        bool added = true;
+        for (std::unique_ptr<Chip8Env> &env : vector->envs)
+            added = env->addWatch(watch) && added;
+        return PyBool_FromLong(added);
+    }
+
+    PyObject *vectorFramebuffers(PyObject *self, void *)
+    {
+        Vector *vector = vectorOf(self);
+        return vector ? viewOf(self, vector->screens.data(), "Q", 8, {static_cast<Py_ssize_t>(vector->size()), 64, 2}) : nullptr;
+    }
+
+    PyObject *vectorRewards(PyObject *self, void *)
+    {
+        Vector *vector = vectorOf(self);
+        return vector ? viewOf(self, vector->rewards.data(), "f", 4, {static_cast<Py_ssize_t>(vector->size())}) : nullptr;
+    }
+
+    PyObject *vectorDone(PyObject *self, void *)
+    {
+        Vector *vector = vectorOf(self);
+        return vector ? viewOf(self, vector->done.data(), "B", 1, {static_cast<Py_ssize_t>(vector->size())}) : nullptr;
+    }
+
+    PyObject *vectorHires(PyObject *self, void *)
+    {
+        Vector *vector = vectorOf(self);
+        return vector ? viewOf(self, vector->hires.data(), "B", 1, {static_cast<Py_ssize_t>(vector->size())}) : nullptr;
+    }
+
+    Py_ssize_t vectorLength(PyObject *self)
+    {
+        Vector *vector = vectorOf(self);
+        return vector ? static_cast<Py_ssize_t>(vector->size()) : -1;
+    }
+
+    PyMethodDef vectorMethods[] = {
+        {"step", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(vectorStep)), METH_VARARGS | METH_KEYWORDS,
+         "step(keys, frames=1) -> (rewards, done): every environment holds its keys for frames frames"},
+        {"reset", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(vectorReset)), METH_VARARGS | METH_KEYWORDS,
+         "reset(seed=None, index=None): boot every environment, or one, again"},
+        {"add_watch", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)()>(vectorAddWatch)), METH_VARARGS | METH_KEYWORDS,
+         "add_watch(source, kind, address, target=0, weight=1.0) -> bool: a watch on every environment"},
+        {nullptr, nullptr, 0, nullptr},
+    };
+
+    PyGetSetDef vectorGetters[] = {
+        {"framebuffers", vectorFramebuffers, nullptr, "Every screen after the last step, (n, 64, 2) uint64", nullptr},
+        {"rewards", vectorRewards, nullptr, "Rewards of the last step, n float32", nullptr},
+        {"done", vectorDone, nullptr, "Episodes that ended in the last step, n uint8", nullptr},
+        {"hires", vectorHires, nullptr, "Environments in 128x64 mode, n uint8", nullptr},
+        {nullptr, nullptr, nullptr, nullptr, nullptr},
+    };
+
+    PyType_Slot vectorSlots[] = {
+        {Py_tp_doc, const_cast<char *>("VectorEnv(rom, n, ipf=10, threads=0, auto_reset=True, seed=0): n environments "
+                                       "stepped in parallel; environment i starts seeded with seed + i")},
+        {Py_tp_new, reinterpret_cast<void *>(PyType_GenericNew)},
+        {Py_tp_init, reinterpret_cast<void *>(vectorInit)},
+        {Py_tp_dealloc, reinterpret_cast<void *>(vectorDealloc)},
+        {Py_tp_methods, vectorMethods},
+        {Py_tp_getset, vectorGetters},
+        {Py_sq_length, reinterpret_cast<void *>(vectorLength)},
+        {0, nullptr},
+    };
+    PyType_Spec vectorSpec = {"chip8.VectorEnv", sizeof(VectorObject), 0, Py_TPFLAGS_DEFAULT, vectorSlots};
+
+    PyModuleDef moduleDef = {PyModuleDef_HEAD_INIT, "chip8", "Headless CHIP-8 environments", -1,
+                             nullptr, nullptr, nullptr, nullptr, nullptr};
+
+    bool addType(PyObject *module, PyType_Spec &spec, const char *name)
+    {
+        PyObject *type = PyType_FromSpec(&spec);
+        if (!type)
+            return false;
+        if (PyModule_AddObject(module, name, type) != 0)
+        {
+            Py_DECREF(type);
+            return false;
+        }
+        return true;
+    }
+}
+
+PyMODINIT_FUNC PyInit_chip8()
+{
+    PyObject *module = PyModule_Create(&moduleDef);
+    if (!module)
+        return nullptr;
+    arrayViewType = reinterpret_cast<PyTypeObject *>(PyType_FromSpec(&arrayViewSpec));
+    if (!arrayViewType || !addType(module, envSpec, "Env") || !addType(module, vectorSpec, "VectorEnv") ||
+        PyModule_AddIntConstant(module, "WATCH_BYTE", CHIP8_WATCH_BYTE) != 0 ||
+        PyModule_AddIntConstant(module, "WATCH_WORD", CHIP8_WATCH_WORD) != 0 ||
+        PyModule_AddIntConstant(module, "WATCH_BCD", CHIP8_WATCH_BCD) != 0 ||
+        PyModule_AddIntConstant(module, "WATCH_REGISTER", CHIP8_WATCH_REGISTER) != 0 ||
+        PyModule_AddIntConstant(module, "WATCH_DELTA", CHIP8_WATCH_DELTA) != 0 ||
+        PyModule_AddIntConstant(module, "WATCH_VALUE", CHIP8_WATCH_VALUE) != 0 ||
+        PyModule_AddIntConstant(module, "WATCH_END_EQUAL", CHIP8_WATCH_END_EQUAL) != 0)
+    {
+        Py_DECREF(module);
+        return nullptr;
+    }
+    return module;
+}
@@ -0,0 +1,114 @@
+// Streaming server: hosts a CHIP-8 session for every WebSocket client and
+// sends each one delta-encoded frames of its screen, taking its keys back
+// the same way, and lets spectators follow any session from its machine
+// and key stream; see stream_server.h for the protocol, web/chip8_stream.js
+// for a browser client and Chip8Web.spectate for a spectator. Runs until
+// interrupted.
+//
+//   chip8-server [options]
+//     --port N       TCP port to listen on (default 8068)
+//     --roms DIR     folder clients pick ROMs from by name (default roms)
+//     --ipf N        instructions per frame (default 10)
+//     --threads N    worker threads stepping sessions (default: all
+//                    hardware threads)
+//     --max N        sessions at most (default 10000)
+//     --idle N       seconds without keys before a session is parked
+//                    (default 60, 0 never)
+//     --budget-insns N   instructions a session may run per second
+//                        (default 0, no limit beyond the frame rate)
+//     --budget-cpu N     host microseconds a session may take per second
+//                        (default 20000, 0 no limit)
+//     --budget-output N  frame bytes a session may be sent per second
+//                        (default 262144, 0 no limit)
+//     --strikes N        seconds in a row over --budget-cpu before a
+//                        session is closed (default 10, 0 never)
+//     --sandbox N        run sessions in N worker processes (default 0,
+//                        in this one)
+//     --sandbox-slots N  sessions per worker process (default 256)
+
+#include "stream_server.h"
+#include <atomic>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+    std::atomic<bool> stopRequested{false};
+
+    void usage()
+    {
+        std::fprintf(stderr, "usage: chip8-server [--port N] [--roms DIR] [--ipf N] [--threads N] [--max N] [--idle N]\n"
+                             "       [--budget-insns N] [--budget-cpu N] [--budget-output N] [--strikes N]\n"
+                             "       [--sandbox N] [--sandbox-slots N]\n");
+    }
+
+    void onSignal(int)
+    {
+        stopRequested.store(true);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    // Started again by the sandbox pool as one of its workers
+    if (argc == 4 && std::string(argv[1]) == "--sandbox-worker")
+        return SandboxPool::workerMain(argv[2], static_cast<unsigned>(std::atoi(argv[3])));
+
+    StreamServer::Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--port" && hasValue)
+            options.port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        else if (arg == "--roms" && hasValue)
+            options.romFolder = argv[++i];
+        else if (arg == "--ipf" && hasValue)
+            options.ipf = std::atoi(argv[++i]);
+        else if (arg == "--threads" && hasValue)
+            options.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (arg == "--max" && hasValue)
+            options.maxSessions = static_cast<size_t>(std::atoll(argv[++i]));
+        else if (arg == "--idle" && hasValue)
+            options.idleSeconds = std::atoi(argv[++i]);
+        else if (arg == "--budget-insns" && hasValue)
+            options.instructionBudget = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--budget-cpu" && hasValue)
+            options.cpuMicrosBudget = std::atoll(argv[++i]);
+        else if (arg == "--budget-output" && hasValue)
+            options.outputBudget = static_cast<size_t>(std::atoll(argv[++i]));
+        else if (arg == "--strikes" && hasValue)
+            options.strikeSeconds = std::atoi(argv[++i]);
+        else if (arg == "--sandbox" && hasValue)
+            options.sandboxWorkers = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (arg == "--sandbox-slots" && hasValue)
+            options.sandboxSlots = static_cast<size_t>(std::atoll(argv[++i]));
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (options.ipf <= 0 || options.maxSessions == 0 || options.idleSeconds < 0 || options.cpuMicrosBudget < 0 ||
+        options.strikeSeconds < 0 || options.sandboxSlots == 0)
+    {
+        usage();
+        return 1;
+    }
+
+    StreamServer server(options);
+    if (!server.listen())
+    {
+        std::fprintf(stderr, "chip8-server: can't listen on port %u%s\n", static_cast<unsigned>(options.port),
+                     options.sandboxWorkers ? " or start the sandbox workers" : "");
+        return 1;
+    }
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    std::printf("serving %s on port %u\n", options.romFolder.c_str(), static_cast<unsigned>(options.port));
+    std::fflush(stdout);
+    server.run(stopRequested);
+    return 0;
+}
@@ -0,0 +1,795 @@
+#include "chip8_simd.h"
+#include <bitset>  // For counting mask bits
+#include <cstdlib> // For std::getenv
+#include <cstring> // For std::memcpy, std::strcmp
+#include <iterator> // For std::size
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define CHIP8_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h> // For __cpuidex
+#define CHIP8_TARGET(isa) // MSVC compiles any instruction set's intrinsics
+#else
+#define CHIP8_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+namespace simd
+{
+    namespace
+    {
+        bool xorBlitScalar(uint64_t *dst, const uint64_t *src, size_t count)
+        {
+            uint64_t hit = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                hit |= dst[i] & src[i];
+                dst[i] ^= src[i];
+            }
+            return hit != 0;
+        }
+
+        bool blitBytesScalar(uint8_t *dst, const uint8_t *src, size_t count, uint8_t collide)
+        {
+            bool hit = false;
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (src[i] == 0)
+                    continue;
+                hit |= dst[i] == collide;
+                dst[i] = src[i];
+            }
+            return hit;
+        }
+
+        bool passes(uint8_t a, uint8_t b, ByteTest test)
+        {
+            switch (test)
+            {
+            case ByteTest::Equal:
+                return a == b;
+            case ByteTest::NotEqual:
+                return a != b;
+            case ByteTest::Greater:
+                return a > b;
+            default:
+                return a < b;
+            }
+        }
+
+        size_t filterBytesScalar(uint8_t *keep, const uint8_t *a, const uint8_t *b, size_t count, ByteTest test)
+        {
+            size_t kept = 0;
+            for (size_t i = 0; i < count; ++i)
+            {
+                if (keep[i] && !passes(a[i], b[i], test))
+                    keep[i] = 0;
+                kept += keep[i] != 0;
+            }
+            return kept;
+        }
+
+        const uint64_t prime32_1 = 0x9E3779B1;
+        const uint64_t prime32_2 = 0x85EBCA77;
+        const uint64_t prime32_3 = 0xC2B2AE3D;
+        const uint64_t prime64_1 = 0x9E3779B185EBCA87;
+        const uint64_t prime64_2 = 0xC2B2AE3D27D4EB4F;
+        const uint64_t prime64_3 = 0x165667B19E3779F9;
+        const uint64_t prime64_4 = 0x85EBCA77C2B2AE63;
+        const uint64_t prime64_5 = 0x27D4EB2F165667C5;
+
+        // Mixed into each lane's word before the multiply
+        const uint64_t laneKeys[8] = {0xBE4BA423396CFEB8, 0x1CAD21F72C81017C, 0xDB979083E96DD4DE, 0x1F67B3B7A4A44072,
+                                      0x78E5C0CC4EE679CB, 0x2172FFCC7DD05A82, 0x8E2443F7744608B8, 0x4C263A81E69035E0};
+
+        // Added to the keys after every stripe, so the same bytes hash
+        // differently at another offset
+        const uint64_t keySteps[8] = {0xCB00C391BB52283D, 0xA32E531B8B65D088, 0x4EF90DA297486471, 0xD8ACDEA946EF1938,
+                                      0x3F349CE33F76FAA8, 0x1D4F0BC7C7BBDCF9, 0x3159B4CD4BE0518A, 0x647378D9C97E9FC8};
+
+        uint64_t foldedMultiply(uint64_t a, uint64_t b)
+        {
+#if defined(__SIZEOF_INT128__)
+            const unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+            return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+            const uint64_t aLow = a & 0xFFFFFFFF, aHigh = a >> 32, bLow = b & 0xFFFFFFFF, bHigh = b >> 32;
+            const uint64_t lowLow = aLow * bLow, highLow = aHigh * bLow, lowHigh = aLow * bHigh, highHigh = aHigh * bHigh;
+            const uint64_t cross = (lowLow >> 32) + (highLow & 0xFFFFFFFF) + lowHigh;
+            const uint64_t low = (cross << 32) | (lowLow & 0xFFFFFFFF);
+            const uint64_t high = (highLow >> 32) + (cross >> 32) + highHigh;
+            return low ^ high;
+#endif
+        }
+
+        // One stripe: lane i adds the halves of its keyed word multiplied
+        // together, and its neighbour gets the word itself
+        void accumulateStripe(uint64_t *acc, const uint8_t *stripe, uint64_t *keys)
+        {
+            for (int i = 0; i < 8; ++i)
+            {
+                uint64_t word;
+                std::memcpy(&word, stripe + 8 * i, sizeof word);
+                const uint64_t keyed = word ^ keys[i];
+                acc[i ^ 1] += word;
+                acc[i] += (keyed & 0xFFFFFFFF) * (keyed >> 32);
+                keys[i] += keySteps[i];
+            }
+        }
+
+        // The whole stripes of size bytes into acc and keys; the bytes used
+        size_t hashStripesScalar(uint64_t *acc, uint64_t *keys, const uint8_t *bytes, size_t size)
+        {
+            size_t i = 0;
+            for (; i + 64 <= size; i += 64)
+                accumulateStripe(acc, bytes + i, keys);
+            return i;
+        }
+
+        // Pixels from through count of a bit-packed row, one at a time
+        template <typename Pixel>
+        void expandTail(Pixel *out, const uint64_t *bits, size_t from, size_t count, Pixel off, Pixel on)
+        {
+            for (size_t i = from; i < count; ++i)
+                out[i] = ((bits[i >> 6] >> (63 - (i & 63))) & 1) ? on : off;
+        }
+
+        void expand8Scalar(uint8_t *out, const uint64_t *bits, size_t count, uint8_t off, uint8_t on)
+        {
+            expandTail(out, bits, 0, count, off, on);
+        }
+
+        void expand32Scalar(uint32_t *out, const uint64_t *bits, size_t count, uint32_t off, uint32_t on)
+        {
+            expandTail(out, bits, 0, count, off, on);
+        }
+
+        // Bit k of a word's bytes for pixel k, leftmost first
+        alignas(64) const uint8_t pixelBits[64] = {
+            0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1, 0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1, 0x80, 0x40, 0x20, 0x10, 8, 4,
+            2, 1, 0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1, 0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1, 0x80, 0x40, 0x20, 0x10,
+            8, 4, 2, 1, 0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1, 0x80, 0x40, 0x20, 0x10, 8, 4, 2, 1};
+
+        // The byte of a little-endian word holding pixel k: the top one first
+        alignas(64) const uint8_t pixelBytes[64] = {
+            7, 7, 7, 7, 7, 7, 7, 7, 6, 6, 6, 6, 6, 6, 6, 6, 5, 5, 5, 5, 5, 5, 5, 5, 4, 4, 4, 4, 4, 4, 4, 4,
+            3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0};
+
+#if defined(CHIP8_SIMD_X86)
+        CHIP8_TARGET("sse2")
+        bool xorBlitSse2(uint64_t *dst, const uint64_t *src, size_t count)
+        {
+            size_t i = 0;
+            __m128i acc = _mm_setzero_si128();
+            for (; i + 2 <= count; i += 2)
+            {
+                __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+                __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                acc = _mm_or_si128(acc, _mm_and_si128(d, s));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(d, s));
+            }
+            const bool hit = _mm_movemask_epi8(_mm_cmpeq_epi8(acc, _mm_setzero_si128())) != 0xFFFF;
+            return xorBlitScalar(dst + i, src + i, count - i) || hit;
+        }
+
+        CHIP8_TARGET("avx2")
+        bool xorBlitAvx2(uint64_t *dst, const uint64_t *src, size_t count)
+        {
+            size_t i = 0;
+            __m256i acc = _mm256_setzero_si256();
+            for (; i + 4 <= count; i += 4)
+            {
+                __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+                __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                acc = _mm256_or_si256(acc, _mm256_and_si256(d, s));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_xor_si256(d, s));
+            }
+            const bool hit = !_mm256_testz_si256(acc, acc);
+            return xorBlitScalar(dst + i, src + i, count - i) || hit;
+        }
+
+        // The opaque bytes are the ones not equal to zero; and/andnot/or
+        // stands in for the blend SSE2 lacks
+        CHIP8_TARGET("sse2")
+        bool blitBytesSse2(uint8_t *dst, const uint8_t *src, size_t count, uint8_t collide)
+        {
+            const __m128i zero = _mm_setzero_si128();
+            const __m128i collides = _mm_set1_epi8(static_cast<char>(collide));
+            __m128i hits = zero;
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16)
+            {
+                const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+                const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+                const __m128i clear = _mm_cmpeq_epi8(s, zero);
+                hits = _mm_or_si128(hits, _mm_andnot_si128(clear, _mm_cmpeq_epi8(d, collides)));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_or_si128(_mm_and_si128(clear, d), s));
+            }
+            const bool hit = _mm_movemask_epi8(hits) != 0;
+            return blitBytesScalar(dst + i, src + i, count - i, collide) || hit;
+        }
+
+        CHIP8_TARGET("avx2")
+        bool blitBytesAvx2(uint8_t *dst, const uint8_t *src, size_t count, uint8_t collide)
+        {
+            const __m256i zero = _mm256_setzero_si256();
+            const __m256i collides = _mm256_set1_epi8(static_cast<char>(collide));
+            __m256i hits = zero;
+            size_t i = 0;
+            for (; i + 32 <= count; i += 32)
+            {
+                const __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(dst + i));
+                const __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+                const __m256i clear = _mm256_cmpeq_epi8(s, zero);
+                hits = _mm256_or_si256(hits, _mm256_andnot_si256(clear, _mm256_cmpeq_epi8(d, collides)));
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_blendv_epi8(s, d, clear));
+            }
+            const bool hit = !_mm256_testz_si256(hits, hits);
+            return blitBytesScalar(dst + i, src + i, count - i, collide) || hit;
+        }
+
+        // 16 pixels a step: their two bytes broadcast over eight lanes
+        // each, each lane tested against its own bit, the compare picking
+        // between off and on
+        CHIP8_TARGET("sse2")
+        __m128i litSse2(const uint64_t *bits, size_t i)
+        {
+            const uint64_t word = bits[i >> 6] >> (48 - (i & 63));
+            const __m128i spread = _mm_unpacklo_epi64(_mm_set1_epi8(static_cast<char>(word >> 8)),
+                                                      _mm_set1_epi8(static_cast<char>(word)));
+            const __m128i select = _mm_load_si128(reinterpret_cast<const __m128i *>(pixelBits));
+            return _mm_cmpeq_epi8(_mm_and_si128(spread, select), select);
+        }
+
+        CHIP8_TARGET("sse2")
+        void expand8Sse2(uint8_t *out, const uint64_t *bits, size_t count, uint8_t off, uint8_t on)
+        {
+            const __m128i offs = _mm_set1_epi8(static_cast<char>(off));
+            const __m128i flip = _mm_set1_epi8(static_cast<char>(off ^ on));
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16)
+            {
+                const __m128i lit = litSse2(bits, i);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_xor_si128(offs, _mm_and_si128(flip, lit)));
+            }
+            expandTail(out, bits, i, count, off, on);
+        }
+
+        // The byte masks unpacked to 32 bits, four pixels a store
+        CHIP8_TARGET("sse2")
+        void expand32Sse2(uint32_t *out, const uint64_t *bits, size_t count, uint32_t off, uint32_t on)
+        {
+            const __m128i offs = _mm_set1_epi32(static_cast<int>(off));
+            const __m128i flip = _mm_set1_epi32(static_cast<int>(off ^ on));
+            size_t i = 0;
+            for (; i + 16 <= count; i += 16)
+            {
+                const __m128i lit = litSse2(bits, i);
+                const __m128i low = _mm_unpacklo_epi8(lit, lit), high = _mm_unpackhi_epi8(lit, lit);
+                const __m128i quads[4] = {_mm_unpacklo_epi16(low, low), _mm_unpackhi_epi16(low, low),
+                                          _mm_unpacklo_epi16(high, high), _mm_unpackhi_epi16(high, high)};
+                for (int q = 0; q < 4; ++q)
+                    _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 4 * q),
+                                     _mm_xor_si128(offs, _mm_and_si128(flip, quads[q])));
+            }
+            expandTail(out, bits, i, count, off, on);
+        }
+
+        // 32 pixels a step: pshufb spreads their four bytes over eight
+        // lanes each
+        CHIP8_TARGET("avx2")
+        __m256i litAvx2(const uint64_t *bits, size_t i)
+        {
+            const uint32_t quad = static_cast<uint32_t>(bits[i >> 6] >> (32 - (i & 63)));
+            const __m256i index = _mm256_setr_epi8(3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2,
+                                                   1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0);
+            const __m256i spread = _mm256_shuffle_epi8(_mm256_set1_epi32(static_cast<int>(quad)), index);
+            const __m256i select = _mm256_load_si256(reinterpret_cast<const __m256i *>(pixelBits));
+            return _mm256_cmpeq_epi8(_mm256_and_si256(spread, select), select);
+        }
+
+        CHIP8_TARGET("avx2")
+        void expand8Avx2(uint8_t *out, const uint64_t *bits, size_t count, uint8_t off, uint8_t on)
+        {
+            const __m256i offs = _mm256_set1_epi8(static_cast<char>(off));
+            const __m256i ons = _mm256_set1_epi8(static_cast<char>(on));
+            size_t i = 0;
+            for (; i + 32 <= count; i += 32)
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_blendv_epi8(offs, ons, litAvx2(bits, i)));
+            expandTail(out, bits, i, count, off, on);
+        }
+
+        // Sign extension widens the 0/-1 byte masks, eight pixels a store
+        CHIP8_TARGET("avx2")
+        void expand32Avx2(uint32_t *out, const uint64_t *bits, size_t count, uint32_t off, uint32_t on)
+        {
+            const __m256i offs = _mm256_set1_epi32(static_cast<int>(off));
+            const __m256i ons = _mm256_set1_epi32(static_cast<int>(on));
+            size_t i = 0;
+            for (; i + 32 <= count; i += 32)
+            {
+                const __m256i lit = litAvx2(bits, i);
+                const __m128i low = _mm256_castsi256_si128(lit), high = _mm256_extracti128_si256(lit, 1);
+                const __m128i octets[4] = {low, _mm_srli_si128(low, 8), high, _mm_srli_si128(high, 8)};
+                for (int q = 0; q < 4; ++q)
+                    _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + 8 * q),
+                                        _mm256_blendv_epi8(offs, ons, _mm256_cvtepi8_epi32(octets[q])));
+            }
+            expandTail(out, bits, i, count, off, on);
+        }
+
+        // GCC 12's AVX-512 headers trip this on their own undefined vectors
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+        // Masked loads and stores take the last partial vector too
+        CHIP8_TARGET("avx512f")
+        bool xorBlitAvx512(uint64_t *dst, const uint64_t *src, size_t count)
+        {
+            __m512i acc = _mm512_setzero_si512();
+            for (size_t i = 0; i < count; i += 8)
+            {
+                const __mmask8 lanes = count - i >= 8 ? 0xFF : static_cast<__mmask8>((1u << (count - i)) - 1);
+                __m512i d = _mm512_maskz_loadu_epi64(lanes, dst + i);
+                __m512i s = _mm512_maskz_loadu_epi64(lanes, src + i);
+                acc = _mm512_or_si512(acc, _mm512_and_si512(d, s));
+                _mm512_mask_storeu_epi64(dst + i, lanes, _mm512_xor_si512(d, s));
+            }
+            return _mm512_test_epi64_mask(acc, acc) != 0;
+        }
+
+        // The opaque bytes are a mask register, and a masked store writes
+        // only them, the last partial vector included
+        CHIP8_TARGET("avx512f,avx512bw")
+        bool blitBytesAvx512(uint8_t *dst, const uint8_t *src, size_t count, uint8_t collide)
+        {
+            const __m512i collides = _mm512_set1_epi8(static_cast<char>(collide));
+            __mmask64 hits = 0;
+            for (size_t i = 0; i < count; i += 64)
+            {
+                const __mmask64 lanes = count - i >= 64 ? ~0ull : (1ull << (count - i)) - 1;
+                const __m512i d = _mm512_maskz_loadu_epi8(lanes, dst + i);
+                const __m512i s = _mm512_maskz_loadu_epi8(lanes, src + i);
+                const __mmask64 opaque = _mm512_test_epi8_mask(s, s);
+                hits |= _mm512_mask_cmpeq_epu8_mask(opaque, d, collides);
+                _mm512_mask_storeu_epi8(dst + i, opaque, s);
+            }
+            return hits != 0;
+        }
+
+        // Unsigned order through min/max: a > b exactly when min(a, b) isn't a
+        CHIP8_TARGET("sse2")
+        size_t filterBytesSse2(uint8_t *keep, const uint8_t *a, const uint8_t *b, size_t count, ByteTest test)
+        {
+            size_t i = 0;
+            size_t kept = 0;
+            for (; i + 16 <= count; i += 16)
+            {
+                __m128i k = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keep + i));
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i));
+                __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i));
+                if (test == ByteTest::Equal)
+                    k = _mm_and_si128(k, _mm_cmpeq_epi8(x, y));
+                else if (test == ByteTest::NotEqual)
+                    k = _mm_andnot_si128(_mm_cmpeq_epi8(x, y), k);
+                else if (test == ByteTest::Greater)
+                    k = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_min_epu8(x, y), x), k);
+                else
+                    k = _mm_andnot_si128(_mm_cmpeq_epi8(_mm_max_epu8(x, y), x), k);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(keep + i), k);
+                kept += std::bitset<16>(static_cast<uint32_t>(_mm_movemask_epi8(k))).count();
+            }
+            return kept + filterBytesScalar(keep + i, a + i, b + i, count - i, test);
+        }
+
+        CHIP8_TARGET("avx2")
+        size_t filterBytesAvx2(uint8_t *keep, const uint8_t *a, const uint8_t *b, size_t count, ByteTest test)
+        {
+            size_t i = 0;
+            size_t kept = 0;
+            for (; i + 32 <= count; i += 32)
+            {
+                __m256i k = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keep + i));
+                __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i));
+                __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i));
+                if (test == ByteTest::Equal)
+                    k = _mm256_and_si256(k, _mm256_cmpeq_epi8(x, y));
+                else if (test == ByteTest::NotEqual)
+                    k = _mm256_andnot_si256(_mm256_cmpeq_epi8(x, y), k);
+                else if (test == ByteTest::Greater)
+                    k = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_min_epu8(x, y), x), k);
+                else
+                    k = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(x, y), x), k);
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(keep + i), k);
+                kept += std::bitset<32>(static_cast<uint32_t>(_mm256_movemask_epi8(k))).count();
+            }
+            return kept + filterBytesScalar(keep + i, a + i, b + i, count - i, test);
+        }
+
+        // Compares straight into mask registers, which AVX-512 has for
+        // unsigned bytes
+        CHIP8_TARGET("avx512f,avx512bw")
+        size_t filterBytesAvx512(uint8_t *keep, const uint8_t *a, const uint8_t *b, size_t count, ByteTest test)
+        {
+            size_t i = 0;
+            size_t kept = 0;
+            for (; i + 64 <= count; i += 64)
+            {
+                const __m512i k = _mm512_loadu_si512(keep + i);
+                const __m512i x = _mm512_loadu_si512(a + i);
+                const __m512i y = _mm512_loadu_si512(b + i);
+                __mmask64 pass;
+                if (test == ByteTest::Equal)
+                    pass = _mm512_cmpeq_epu8_mask(x, y);
+                else if (test == ByteTest::NotEqual)
+                    pass = _mm512_cmpneq_epu8_mask(x, y);
+                else if (test == ByteTest::Greater)
+                    pass = _mm512_cmpgt_epu8_mask(x, y);
+                else
+                    pass = _mm512_cmplt_epu8_mask(x, y);
+                const __mmask64 still = _mm512_test_epi8_mask(k, k) & pass;
+                _mm512_storeu_si512(keep + i, _mm512_maskz_mov_epi8(still, k));
+                kept += std::bitset<64>(static_cast<uint64_t>(still)).count();
+            }
+            return kept + filterBytesScalar(keep + i, a + i, b + i, count - i, test);
+        }
+
+        CHIP8_TARGET("sse2")
+        size_t hashStripesSse2(uint64_t *acc, uint64_t *keys, const uint8_t *bytes, size_t size)
+        {
+            size_t i = 0;
+            __m128i a[4], k[4], step[4];
+            for (int j = 0; j < 4; ++j)
+            {
+                a[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(acc + 2 * j));
+                k[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys + 2 * j));
+                step[j] = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keySteps + 2 * j));
+            }
+            for (; i + 64 <= size; i += 64)
+            {
+                for (int j = 0; j < 4; ++j)
+                {
+                    const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes + i + 16 * j));
+                    const __m128i x = _mm_xor_si128(d, k[j]);
+                    a[j] = _mm_add_epi64(a[j], _mm_shuffle_epi32(d, _MM_SHUFFLE(1, 0, 3, 2)));
+                    a[j] = _mm_add_epi64(a[j], _mm_mul_epu32(x, _mm_shuffle_epi32(x, _MM_SHUFFLE(0, 3, 0, 1))));
+                    k[j] = _mm_add_epi64(k[j], step[j]);
+                }
+            }
+            for (int j = 0; j < 4; ++j)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(acc + 2 * j), a[j]);
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(keys + 2 * j), k[j]);
+            }
+            return i;
+        }
+
+        CHIP8_TARGET("avx2")
+        size_t hashStripesAvx2(uint64_t *acc, uint64_t *keys, const uint8_t *bytes, size_t size)
+        {
+            size_t i = 0;
+            __m256i a0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(acc));
+            __m256i a1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(acc + 4));
+            __m256i k0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys));
+            __m256i k1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keys + 4));
+            const __m256i s0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keySteps));
+            const __m256i s1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(keySteps + 4));
+            for (; i + 64 <= size; i += 64)
+            {
+                const __m256i d0 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + i));
+                const __m256i d1 = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(bytes + i + 32));
+                const __m256i x0 = _mm256_xor_si256(d0, k0);
+                const __m256i x1 = _mm256_xor_si256(d1, k1);
+                a0 = _mm256_add_epi64(a0, _mm256_shuffle_epi32(d0, _MM_SHUFFLE(1, 0, 3, 2)));
+                a1 = _mm256_add_epi64(a1, _mm256_shuffle_epi32(d1, _MM_SHUFFLE(1, 0, 3, 2)));
+                a0 = _mm256_add_epi64(a0, _mm256_mul_epu32(x0, _mm256_shuffle_epi32(x0, _MM_SHUFFLE(0, 3, 0, 1))));
+                a1 = _mm256_add_epi64(a1, _mm256_mul_epu32(x1, _mm256_shuffle_epi32(x1, _MM_SHUFFLE(0, 3, 0, 1))));
+                k0 = _mm256_add_epi64(k0, s0);
+                k1 = _mm256_add_epi64(k1, s1);
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc), a0);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(acc + 4), a1);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(keys), k0);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(keys + 4), k1);
+            return i;
+        }
+
+        // A whole stripe is one register. The words go to the neighbouring
+        // lanes, so they are summed as they are and swapped over once.
+        CHIP8_TARGET("avx512f")
+        size_t hashStripesAvx512(uint64_t *acc, uint64_t *keys, const uint8_t *bytes, size_t size)
+        {
+            size_t i = 0;
+            __m512i a = _mm512_loadu_si512(acc);
+            __m512i k = _mm512_loadu_si512(keys);
+            __m512i words = _mm512_setzero_si512();
+            const __m512i step = _mm512_loadu_si512(keySteps);
+            for (; i + 64 <= size; i += 64)
+            {
+                const __m512i d = _mm512_loadu_si512(bytes + i);
+                const __m512i x = _mm512_xor_si512(d, k);
+                words = _mm512_add_epi64(words, d);
+                a = _mm512_add_epi64(a, _mm512_mul_epu32(x, _mm512_srli_epi64(x, 32)));
+                k = _mm512_add_epi64(k, step);
+            }
+            uint64_t sums[8];
+            _mm512_storeu_si512(acc, a);
+            _mm512_storeu_si512(keys, k);
+            _mm512_storeu_si512(sums, words);
+            for (int j = 0; j < 8; ++j)
+                acc[j ^ 1] += sums[j];
+            return i;
+        }
+
+        // A whole word a step: pshufb spreads its bytes over the 64 lanes,
+        // and the bit tests land in a mask register that blends directly
+        CHIP8_TARGET("avx512f,avx512bw")
+        __mmask64 litAvx512(const uint64_t *bits, size_t i)
+        {
+            const __m512i spread = _mm512_shuffle_epi8(_mm512_set1_epi64(static_cast<long long>(bits[i >> 6])),
+                                                       _mm512_load_si512(pixelBytes));
+            return _mm512_test_epi8_mask(spread, _mm512_load_si512(pixelBits));
+        }
+
+        CHIP8_TARGET("avx512f,avx512bw")
+        void expand8Avx512(uint8_t *out, const uint64_t *bits, size_t count, uint8_t off, uint8_t on)
+        {
+            const __m512i offs = _mm512_set1_epi8(static_cast<char>(off));
+            const __m512i ons = _mm512_set1_epi8(static_cast<char>(on));
+            size_t i = 0;
+            for (; i + 64 <= count; i += 64)
+                _mm512_storeu_si512(out + i, _mm512_mask_blend_epi8(litAvx512(bits, i), offs, ons));
+            expandTail(out, bits, i, count, off, on);
+        }
+
+        CHIP8_TARGET("avx512f,avx512bw")
+        void expand32Avx512(uint32_t *out, const uint64_t *bits, size_t count, uint32_t off, uint32_t on)
+        {
+            const __m512i offs = _mm512_set1_epi32(static_cast<int>(off));
+            const __m512i ons = _mm512_set1_epi32(static_cast<int>(on));
+            size_t i = 0;
+            for (; i + 64 <= count; i += 64)
+            {
+                const __mmask64 lit = litAvx512(bits, i);
+                for (int q = 0; q < 4; ++q)
+                    _mm512_storeu_si512(out + i + 16 * q,
+                                        _mm512_mask_blend_epi32(static_cast<__mmask16>(lit >> (16 * q)), offs, ons));
+            }
+            expandTail(out, bits, i, count, off, on);
+        }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+        struct Kernels
+        {
+            bool (*xorBlit)(uint64_t *, const uint64_t *, size_t);
+            bool (*blitBytes)(uint8_t *, const uint8_t *, size_t, uint8_t);
+            size_t (*filterBytes)(uint8_t *, const uint8_t *, const uint8_t *, size_t, ByteTest);
+            size_t (*hashStripes)(uint64_t *, uint64_t *, const uint8_t *, size_t);
+            void (*expand8)(uint8_t *, const uint64_t *, size_t, uint8_t, uint8_t);
+            void (*expand32)(uint32_t *, const uint64_t *, size_t, uint32_t, uint32_t);
+        };
+
+        // By Level; hosts without the x86 paths run the scalar loops at every level
+        const Kernels kernelSets[] = {
+            {xorBlitScalar, blitBytesScalar, filterBytesScalar, hashStripesScalar, expand8Scalar, expand32Scalar},
+#if defined(CHIP8_SIMD_X86)
+            {xorBlitSse2, blitBytesSse2, filterBytesSse2, hashStripesSse2, expand8Sse2, expand32Sse2},
+            {xorBlitAvx2, blitBytesAvx2, filterBytesAvx2, hashStripesAvx2, expand8Avx2, expand32Avx2},
+            {xorBlitAvx512, blitBytesAvx512, filterBytesAvx512, hashStripesAvx512, expand8Avx512, expand32Avx512},
+#endif
+        };
+
+        Level detectLevel()
+        {
+#if !defined(CHIP8_SIMD_X86)
+            return Level::Scalar;
+#elif defined(_MSC_VER) && !defined(__clang__)
+            int info[4];
+            __cpuid(info, 0);
+            const int leaves = info[0];
+            __cpuid(info, 1);
+            if (!(info[3] & (1 << 26))) // SSE2
+                return Level::Scalar;
+            // AVX needs the OS to save the upper halves: OSXSAVE, then XCR0
+            if (!(info[2] & (1 << 27)) || leaves < 7 || (_xgetbv(0) & 0x6) != 0x6)
+                return Level::Sse2;
+            __cpuidex(info, 7, 0);
+            if (!(info[1] & (1 << 5))) // AVX2
+                return Level::Sse2;
+            const bool avx512 = (info[1] & (1 << 16)) && (info[1] & (1 << 30)); // F and BW
+            return avx512 && (_xgetbv(0) & 0xE6) == 0xE6 ? Level::Avx512 : Level::Avx2;
+#else
+            __builtin_cpu_init();
+            if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw"))
+                return Level::Avx512;
+            if (__builtin_cpu_supports("avx2"))
+                return Level::Avx2;
+            if (__builtin_cpu_supports("sse2"))
+                return Level::Sse2;
+            return Level::Scalar;
+#endif
+        }
+
+        struct Dispatch
+        {
+            Level supported = detectLevel();
+            Level active = supported;
+            const Kernels *kernels = nullptr;
+
+            Dispatch()
+            {
+                Level wanted = supported;
+                const char *forced = std::getenv("CHIP8_SIMD");
+                if (!forced || !parseLevel(forced, wanted))
+                    wanted = supported;
+                select(wanted);
+            }
+
+            void select(Level level)
+            {
+                active = level < supported ? level : supported;
+                const size_t index = static_cast<size_t>(active);
+                kernels = &kernelSets[index < std::size(kernelSets) ? index : 0];
+            }
+        };
+
+        // Picked on first use, so static constructors elsewhere can hash too
+        Dispatch &dispatch()
+        {
+            static Dispatch chosen;
+            return chosen;
+        }
+
+        // Output pixels first through first + count of a row stretched by
+        // scale, as bits in the same layout
+        void stretchBits(uint64_t *wide, const uint64_t *bits, size_t first, size_t count, int scale)
+        {
+            std::memset(wide, 0, (count + 63) / 64 * sizeof *wide);
+            for (size_t o = 0; o < count; ++o)
+            {
+                const size_t i = (first + o) / scale;
+                if ((bits[i >> 6] >> (63 - (i & 63))) & 1)
+                    wide[o >> 6] |= uint64_t(1) << (63 - (o & 63));
+            }
+        }
+
+        // Scaled rows go through the kernel 512 pixels at a time from a
+        // stretched copy on the stack
+        template <typename Pixel, typename Kernel>
+        void expandScaled(Pixel *out, const uint64_t *bits, size_t width, Pixel off, Pixel on, int scale, Kernel kernel)
+        {
+            if (scale <= 1)
+            {
+                kernel(out, bits, width, off, on);
+                return;
+            }
+            uint64_t wide[8];
+            const size_t total = width * scale;
+            for (size_t done = 0; done < total; done += 512)
+            {
+                const size_t count = total - done < 512 ? total - done : 512;
+                stretchBits(wide, bits, done, count, scale);
+                kernel(out + done, wide, count, off, on);
+            }
+        }
+
+        template <typename Pixel>
+        void expandRows(Pixel *out, size_t pitch, const uint64_t *gfx, size_t rowWords, size_t width, size_t height,
+                        Pixel off, Pixel on, int scale)
+        {
+            const int rows = scale < 1 ? 1 : scale;
+            for (size_t y = 0; y < height; ++y)
+            {
+                Pixel *row = out + y * rows * pitch;
+                expandBits(row, gfx + y * rowWords, width, off, on, rows);
+                for (int copy = 1; copy < rows; ++copy)
+                    std::memcpy(row + copy * pitch, row, width * rows * sizeof *row);
+            }
+        }
+    }
+
+    Level supportedLevel() { return dispatch().supported; }
+    Level activeLevel() { return dispatch().active; }
+
+    Level setLevel(Level level)
+    {
+        dispatch().select(level);
+        return dispatch().active;
+    }
+
+    const char *levelName(Level level)
+    {
+        switch (level)
+        {
+        case Level::Sse2:
+            return "sse2";
+        case Level::Avx2:
+            return "avx2";
+        case Level::Avx512:
+            return "avx512";
+        default:
+            return "scalar";
+        }
+    }
+
+    bool parseLevel(const char *name, Level &level)
+    {
+        for (Level known : {Level::Scalar, Level::Sse2, Level::Avx2, Level::Avx512})
+        {
+            if (std::strcmp(name, levelName(known)) == 0)
+            {
+                level = known;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool xorBlit(uint64_t *dst, const uint64_t *src, size_t count)
+    {
+        return dispatch().kernels->xorBlit(dst, src, count);
+    }
+
+    bool blitBytes(uint8_t *dst, const uint8_t *src, size_t count, uint8_t collide)
+    {
+        return dispatch().kernels->blitBytes(dst, src, count, collide);
+    }
+
+    size_t filterBytes(uint8_t *keep, const uint8_t *a, const uint8_t *b, size_t count, ByteTest test)
+    {
+        return dispatch().kernels->filterBytes(keep, a, b, count, test);
+    }
+
+    uint64_t hashBytes(const void *data, size_t size, uint64_t seed)
+    {
+        const uint8_t *bytes = static_cast<const uint8_t *>(data);
+        uint64_t keys[8];
+        for (int i = 0; i < 8; ++i)
+            keys[i] = laneKeys[i] + ((i & 1) ? 0 - seed : seed);
+        uint64_t acc[8] = {prime32_3, prime64_1, prime64_2, prime64_3, prime64_4, prime32_2, prime64_5, prime32_1};
+
+        size_t i = dispatch().kernels->hashStripes(acc, keys, bytes, size);
+        if (i < size)
+        {
+            uint8_t last[64] = {};
+            std::memcpy(last, bytes + i, size - i);
+            accumulateStripe(acc, last, keys);
+        }
+
+        uint64_t hash = size * prime64_1;
+        for (int j = 0; j < 4; ++j)
+            hash += foldedMultiply(acc[2 * j] ^ keys[(2 * j + 3) & 7], acc[2 * j + 1] ^ keys[(2 * j + 6) & 7]);
+        hash ^= hash >> 37;
+        hash *= prime64_3;
+        return hash ^ (hash >> 32);
+    }
+
+    void expandBits(uint8_t *out, const uint64_t *bits, size_t width, uint8_t off, uint8_t on, int scale)
+    {
+        expandScaled(out, bits, width, off, on, scale, dispatch().kernels->expand8);
+    }
+
+    void expandBits(uint32_t *out, const uint64_t *bits, size_t width, uint32_t off, uint32_t on, int scale)
+    {
+        expandScaled(out, bits, width, off, on, scale, dispatch().kernels->expand32);
+    }
+
+    void expandFrame(uint8_t *out, size_t pitch, const uint64_t *gfx, size_t rowWords, size_t width, size_t height,
+                     uint8_t off, uint8_t on, int scale)
+    {
+        expandRows(out, pitch, gfx, rowWords, width, height, off, on, scale);
+    }
+
+    void expandFrame(uint32_t *out, size_t pitch, const uint64_t *gfx, size_t rowWords, size_t width, size_t height,
+                     uint32_t off, uint32_t on, int scale)
+    {
+        expandRows(out, pitch, gfx, rowWords, width, height, off, on, scale);
+    }
+}
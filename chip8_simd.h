@@ -0,0 +1,84 @@
+#ifndef CHIP8_SIMD_H
+#define CHIP8_SIMD_H
+
+#include <cstdint> // For uint8_t, uint64_t
+#include <cstddef> // For size_t
+
+// Vector kernels over the bit-packed framebuffer and memory. Each is built
+// for SSE2, AVX2 and AVX-512 whatever the compiler targets, and the widest
+// the CPU runs is picked on first use through cpuid; all end in a scalar
+// loop for the remainder, the only path on other hosts.
+namespace simd
+{
+    // Instruction sets the kernels come in, narrowest first
+    enum class Level
+    {
+        Scalar,
+        Sse2,
+        Avx2,
+        Avx512 // F and BW
+    };
+
+    // The widest level this CPU and OS run, and the one in use. The
+    // CHIP8_SIMD environment variable (scalar, sse2, avx2, avx512) caps
+    // the starting choice, for benchmarks and to rule out a bad path.
+    Level supportedLevel();
+    Level activeLevel();
+
+    // Use level from now on, capped at supportedLevel(); returns the level
+    // in effect. Not for while other threads run kernels.
+    Level setLevel(Level level);
+
+    const char *levelName(Level level);
+    bool parseLevel(const char *name, Level &level); // False if unknown
+
+    // value rotated right by bits (0-63), one ror instruction: a sprite
+    // row past the right edge comes back in on the left
+    inline uint64_t rotr(uint64_t value, unsigned bits)
+    {
+        return (value >> (bits & 63)) | (value << ((64 - bits) & 63));
+    }
+
+    // dst[i] ^= src[i] for count words; true if any set bit of src was
+    // already set in dst (the DXYN collision flag)
+    bool xorBlit(uint64_t *dst, const uint64_t *src, size_t count);
+
+    // dst[i] = src[i] wherever src[i] isn't 0 (transparent), for count
+    // bytes of palette indices; true if any pixel written over held
+    // collide (the MEGA-CHIP collision colour)
+    bool blitBytes(uint8_t *dst, const uint8_t *src, size_t count, uint8_t collide);
+
+    enum class ByteTest
+    {
+        Equal,
+        NotEqual,
+        Greater, // Unsigned
+        Less
+    };
+
+    // Clears keep[i] (0xFF or 0) where a[i] fails the test against b[i],
+    // for count bytes; the number of bytes still kept
+    size_t filterBytes(uint8_t *keep, const uint8_t *a, const uint8_t *b, size_t count, ByteTest test);
+
+    // 64-bit hash of size bytes, after XXH3's long-input loop: eight
+    // 64-bit lanes each take one word of every 64-byte stripe, then fold
+    // together. Not XXH3's values, but the same on every path and host.
+    uint64_t hashBytes(const void *data, size_t size, uint64_t seed = 0);
+
+    // One byte or 32-bit pixel per bit of a framebuffer row (leftmost in
+    // the top bit of each word), on for set bits and off for clear ones,
+    // each pixel repeated scale times across: 0/255 for an alpha texture,
+    // palette indices for a GIF, RGBA words for a bitmap
+    void expandBits(uint8_t *out, const uint64_t *bits, size_t width, uint8_t off, uint8_t on, int scale = 1);
+    void expandBits(uint32_t *out, const uint64_t *bits, size_t width, uint32_t off, uint32_t on, int scale = 1);
+
+    // height rows of width pixels, rowWords words apart in gfx, each
+    // expanded once and copied down to fill scale output rows; pitch is
+    // in pixels between output rows
+    void expandFrame(uint8_t *out, size_t pitch, const uint64_t *gfx, size_t rowWords, size_t width, size_t height,
+                     uint8_t off, uint8_t on, int scale = 1);
+    void expandFrame(uint32_t *out, size_t pitch, const uint64_t *gfx, size_t rowWords, size_t width, size_t height,
+                     uint32_t off, uint32_t on, int scale = 1);
+}
+
+#endif
@@ -0,0 +1,133 @@
+// WebAssembly entry points to the core, driven by web/chip8_worker.js in a
+// Web Worker. Built with shared memory, the wasm heap is a
+// SharedArrayBuffer the page maps as well, so it reads the published frame
+// straight out of the worker's memory; see the README for the em++ line.
+//
+//   chip8_wasm_rom_buffer()  where the worker copies a ROM before loading it
+//   chip8_wasm_load(size, ipf, seed)
+//   chip8_wasm_state_buffer()  the same for a save state
+//   chip8_wasm_load_state(size, ipf, keys)  a spectated machine, see
+//                            stream_server.h
+//   chip8_wasm_step(frames, keys)  runs frames, then publishes the screen
+//   chip8_wasm_frame()       address of the published WasmFrame
+
+#include "chip8.h"
+#include <atomic>  // For the frame sequence
+#include <cstddef> // For offsetof
+#include <cstdint> // For the exported types
+#include <memory>  // For the machine
+
+#if defined(__EMSCRIPTEN__)
+#include <emscripten/emscripten.h>
+#define CHIP8_WASM_API extern "C" EMSCRIPTEN_KEEPALIVE
+#else
+#define CHIP8_WASM_API extern "C"
+#endif
+
+namespace
+{
+    // Screen as the page reads it. sequence is odd while the worker writes;
+    // a reader that sees it change, or odd, waits for the next frame.
+    struct WasmFrame
+    {
+        std::atomic<uint32_t> sequence{0};
+        uint32_t hires = 0;
+        uint32_t sound = 0; // Buzzer on
+        uint32_t reserved = 0;
+        uint64_t gfx[64 * Chip8::rowWords]; // As Chip8::gfx
+    };
+    static_assert(sizeof(std::atomic<uint32_t>) == 4 && std::atomic<uint32_t>::is_always_lock_free,
+                  "JS reads the sequence with Atomics.load");
+    static_assert(offsetof(WasmFrame, gfx) == 16, "web/chip8_web.js reads gfx at offset 16");
+
+    WasmFrame frame;
+    uint8_t romBuffer[4096 - 0x200];
+    uint8_t stateBuffer[16384]; // A saveState() blob is about 5 KB
+    std::unique_ptr<Chip8> machine;
+    int instructionsPerFrame = 10;
+
+    void publish()
+    {
+        const uint32_t seq = frame.sequence.load(std::memory_order_relaxed);
+        frame.sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        frame.hires = machine->isHires();
+        frame.sound = machine->beepFlag;
+        for (size_t i = 0; i < machine->gfx.size(); ++i)
+            frame.gfx[i] = machine->gfx[i];
+        frame.sequence.store(seq + 2, std::memory_order_release);
+    }
+}
+
+CHIP8_WASM_API uint8_t *chip8_wasm_rom_buffer()
+{
+    return romBuffer;
+}
+
+CHIP8_WASM_API int chip8_wasm_rom_capacity()
+{
+    return static_cast<int>(sizeof romBuffer);
+}
+
+// 1 once the ROM in the buffer is loaded, 0 if it doesn't fit
+CHIP8_WASM_API int chip8_wasm_load(int size, int ipf, uint32_t seed)
+{
+    if (size <= 0 || size > static_cast<int>(sizeof romBuffer))
+        return 0;
+    if (!machine)
+        machine = std::make_unique<Chip8>(); // The table core, wasm can't run the JIT
+    if (!machine->loadROM(romBuffer, static_cast<size_t>(size)))
+        return 0;
+    machine->seedRandom(seed);
+    instructionsPerFrame = ipf > 0 ? ipf : 10;
+    publish();
+    return 1;
+}
+
+CHIP8_WASM_API uint8_t *chip8_wasm_state_buffer()
+{
+    return stateBuffer;
+}
+
+CHIP8_WASM_API int chip8_wasm_state_capacity()
+{
+    return static_cast<int>(sizeof stateBuffer);
+}
+
+// 1 once the save state in the buffer is loaded with keys held, 0 if it
+// isn't one
+CHIP8_WASM_API int chip8_wasm_load_state(int size, int ipf, uint32_t keys)
+{
+    if (size <= 0 || size > static_cast<int>(sizeof stateBuffer))
+        return 0;
+    if (!machine)
+        machine = std::make_unique<Chip8>();
+    if (!machine->loadState(stateBuffer, static_cast<size_t>(size)))
+        return 0;
+    machine->setKeyMask(static_cast<uint16_t>(keys));
+    instructionsPerFrame = ipf > 0 ? ipf : 10;
+    publish();
+    return 1;
+}
+
+// Holds keys (bit k = key k) for frames frames of ipf instructions and a
+// timer tick each
+CHIP8_WASM_API void chip8_wasm_step(int frames, uint32_t keys)
+{
+    if (!machine)
+        return;
+    const uint16_t changed = static_cast<uint16_t>(keys ^ machine->keyMask());
+    for (int k = 0; k < 16; ++k)
+    {
+        if (changed & (1u << k))
+            machine->setKey(k, (keys >> k) & 1);
+    }
+    for (int f = 0; f < frames; ++f)
+        machine->runFrame(instructionsPerFrame);
+    publish();
+}
+
+CHIP8_WASM_API const WasmFrame *chip8_wasm_frame()
+{
+    return &frame;
+}
@@ -0,0 +1,140 @@
+// chip8core.h over the machine variants. Each handle holds one of them
+// behind a small virtual interface, so the C calls stay the same whatever
+// the variant compiles to.
+
+#include "chip8core.h"
+#include "chip8.h"
+#include <cstring> // For memcpy
+#include <new>     // For std::nothrow
+
+struct chip8core
+{
+    virtual ~chip8core() = default;
+    virtual bool loadROM(const uint8_t *rom, size_t size) = 0;
+    virtual void reset() = 0;
+    virtual void seedRandom(uint64_t seed) = 0;
+    virtual int runFrames(int frames) = 0;
+    virtual void setKeys(uint16_t keys) = 0;
+    virtual const uint64_t *framebuffer() const = 0;
+    virtual int planes() const = 0;
+    virtual int width() const = 0;
+    virtual int height() const = 0;
+    virtual bool soundOn() const = 0;
+    virtual size_t snapshotSize() const = 0;
+    virtual size_t saveSnapshot(void *out, size_t size) const = 0;
+    virtual bool loadSnapshot(const void *in, size_t size) = 0;
+};
+
+namespace
+{
+    template <typename Machine>
+    class Core final : public chip8core
+    {
+    public:
+        Core(int instructionsPerFrame, Chip8::Core core) : machine(core), ipf(instructionsPerFrame), stateSize(machine.saveState().size()) {}
+
+        bool loadROM(const uint8_t *rom, size_t size) override { return machine.loadROM(rom, size); }
+        void reset() override { machine.reset(); }
+        void seedRandom(uint64_t seed) override { machine.seedRandom(seed); }
+
+        int runFrames(int frames) override
+        {
+            int drawn = 0;
+            for (int f = 0; f < frames; ++f)
+                drawn += (ipf > 0 ? machine.runFrame(ipf) : machine.runVipFrame()) ? 1 : 0;
+            return drawn;
+        }
+
+        void setKeys(uint16_t keys) override
+        {
+            const uint16_t changed = keys ^ machine.keyMask();
+            for (int k = 0; k < 16; ++k)
+            {
+                if (changed & (1u << k))
+                    machine.setKey(k, (keys >> k) & 1);
+            }
+        }
+
+        const uint64_t *framebuffer() const override { return machine.gfx.data(); }
+        int planes() const override { return Machine::planes; }
+        int width() const override { return machine.width(); }
+        int height() const override { return machine.height(); }
+        bool soundOn() const override { return machine.getSoundTimer() > 0; }
+        size_t snapshotSize() const override { return stateSize; }
+
+        size_t saveSnapshot(void *out, size_t size) const override
+        {
+            if (size < stateSize)
+                return 0;
+            const std::vector<uint8_t> state = machine.saveState();
+            std::memcpy(out, state.data(), state.size());
+            return state.size();
+        }
+
+        bool loadSnapshot(const void *in, size_t size) override
+        {
+            return machine.loadState(static_cast<const uint8_t *>(in), size);
+        }
+
+    private:
+        Machine machine;
+        int ipf;
+        size_t stateSize;
+    };
+}
+
+int chip8core_abi_version(void) { return CHIP8CORE_ABI_VERSION; }
+
+chip8core *chip8core_create(int variant, int ipf) { return chip8core_create_backend(variant, ipf, CHIP8CORE_TABLE); }
+
+chip8core *chip8core_create_backend(int variant, int ipf, int backend)
+{
+    if (backend < CHIP8CORE_SWITCH || backend > CHIP8CORE_TIERED)
+        return nullptr;
+    static_assert(static_cast<int>(Chip8::Core::Switch) == CHIP8CORE_SWITCH && static_cast<int>(Chip8::Core::Tiered) == CHIP8CORE_TIERED,
+                  "backends number as Chip8::Core");
+    const Chip8::Core core = static_cast<Chip8::Core>(backend);
+    switch (variant)
+    {
+    case CHIP8CORE_CHIP8:
+        return new (std::nothrow) Core<Chip8>(ipf, core);
+    case CHIP8CORE_COSMAC_VIP:
+        return new (std::nothrow) Core<VipChip8>(ipf, core);
+    case CHIP8CORE_CHIP48:
+        return new (std::nothrow) Core<Chip48>(ipf, core);
+    case CHIP8CORE_SUPER_CHIP:
+        return new (std::nothrow) Core<SuperChip8>(ipf, core);
+    case CHIP8CORE_XO_CHIP:
+        return new (std::nothrow) Core<XoChip8>(ipf, core);
+    default:
+        return nullptr;
+    }
+}
+
+void chip8core_destroy(chip8core *core) { delete core; }
+
+int chip8core_load_rom(chip8core *core, const uint8_t *rom, size_t size) { return core->loadROM(rom, size) ? 1 : 0; }
+
+void chip8core_reset(chip8core *core) { core->reset(); }
+
+void chip8core_seed_random(chip8core *core, uint64_t seed) { core->seedRandom(seed); }
+
+int chip8core_run_frames(chip8core *core, int frames) { return core->runFrames(frames); }
+
+void chip8core_set_keys(chip8core *core, uint16_t keys) { core->setKeys(keys); }
+
+const uint64_t *chip8core_framebuffer(const chip8core *core) { return core->framebuffer(); }
+
+int chip8core_planes(const chip8core *core) { return core->planes(); }
+
+int chip8core_width(const chip8core *core) { return core->width(); }
+
+int chip8core_height(const chip8core *core) { return core->height(); }
+
+int chip8core_sound_on(const chip8core *core) { return core->soundOn() ? 1 : 0; }
+
+size_t chip8core_snapshot_size(const chip8core *core) { return core->snapshotSize(); }
+
+size_t chip8core_snapshot_save(const chip8core *core, void *out, size_t size) { return core->saveSnapshot(out, size); }
+
+int chip8core_snapshot_load(chip8core *core, const void *in, size_t size) { return core->loadSnapshot(in, size) ? 1 : 0; }
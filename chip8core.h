@@ -0,0 +1,100 @@
+#ifndef CHIP8CORE_H
+#define CHIP8CORE_H
+
+/* Stable C interface to the emulator core, built as its own shared library
+   (chip8core.dll, libchip8core.so, see the README) so frontends, bindings
+   and the server link one optimized core and can take a newer one without
+   being rebuilt. Handles are opaque and every struct crosses the boundary
+   as plain bytes: snapshots are the versioned save-state format, which
+   later libraries keep reading. Calls on one handle are not thread-safe. */
+
+#include <stddef.h> /* For size_t */
+#include <stdint.h> /* For the fixed-width types */
+
+#if defined(_WIN32) && defined(CHIP8CORE_BUILD)
+#define CHIP8CORE_API __declspec(dllexport)
+#elif defined(_WIN32)
+#define CHIP8CORE_API __declspec(dllimport)
+#else
+#define CHIP8CORE_API
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/* Bumped only when an existing call changes; new calls leave it alone */
+#define CHIP8CORE_ABI_VERSION 1
+
+    /* Machine variants, as the GUI's Machine menu offers them */
+    enum chip8core_variant
+    {
+        CHIP8CORE_CHIP8 = 0,     /* The emulator's own quirks */
+        CHIP8CORE_COSMAC_VIP = 1,
+        CHIP8CORE_CHIP48 = 2,
+        CHIP8CORE_SUPER_CHIP = 3,
+        CHIP8CORE_XO_CHIP = 4    /* 64 KB, two planes */
+    };
+
+    /* Interpreter cores, as Chip8::Core; all run the same machine */
+    enum chip8core_backend
+    {
+        CHIP8CORE_SWITCH = 0,     /* Reference decoder */
+        CHIP8CORE_TABLE = 1,      /* chip8core_create's */
+        CHIP8CORE_PREDECODED = 2,
+        CHIP8CORE_JIT = 3,        /* x86-64 only, the table core elsewhere */
+        CHIP8CORE_AOT = 4,
+        CHIP8CORE_TIERED = 5
+    };
+
+    typedef struct chip8core chip8core;
+
+    /* The library's CHIP8CORE_ABI_VERSION, to check against the header */
+    CHIP8CORE_API int chip8core_abi_version(void);
+
+    /* NULL for an unknown variant; ipf instructions per frame, or 0 for
+       COSMAC VIP cycle timing */
+    CHIP8CORE_API chip8core *chip8core_create(int variant, int ipf);
+
+    /* The same on one of the chip8core_backend cores; NULL for an unknown
+       variant or backend */
+    CHIP8CORE_API chip8core *chip8core_create_backend(int variant, int ipf, int backend);
+    CHIP8CORE_API void chip8core_destroy(chip8core *core);
+
+    /* Copies the ROM into memory at 0x200 and resets; 0 if it doesn't fit */
+    CHIP8CORE_API int chip8core_load_rom(chip8core *core, const uint8_t *rom, size_t size);
+    CHIP8CORE_API void chip8core_reset(chip8core *core);
+    CHIP8CORE_API void chip8core_seed_random(chip8core *core, uint64_t seed);
+
+    /* frames frames, each ipf instructions and a 60 Hz timer tick; returns
+       how many of them drew or cleared anything */
+    CHIP8CORE_API int chip8core_run_frames(chip8core *core, int frames);
+
+    /* All 16 keys, bit k = key k. Keys that changed go down or up as real
+       presses, so FX0A sees them. */
+    CHIP8CORE_API void chip8core_set_keys(chip8core *core, uint16_t keys);
+
+    /* Planes of 128 words each, two per row, bit 63 of a row's first word
+       leftmost; lo-res uses the first word of the top 32 rows. Valid until
+       the handle is destroyed, and changes as frames run. */
+    CHIP8CORE_API const uint64_t *chip8core_framebuffer(const chip8core *core);
+    CHIP8CORE_API int chip8core_planes(const chip8core *core);
+    CHIP8CORE_API int chip8core_width(const chip8core *core);
+    CHIP8CORE_API int chip8core_height(const chip8core *core);
+
+    /* Nonzero while the sound timer runs */
+    CHIP8CORE_API int chip8core_sound_on(const chip8core *core);
+
+    /* Save states: the size is fixed per variant. save returns the bytes
+       written, 0 if size is too small; load returns 0 for a blob that isn't
+       a state of this variant, leaving the machine as it was. */
+    CHIP8CORE_API size_t chip8core_snapshot_size(const chip8core *core);
+    CHIP8CORE_API size_t chip8core_snapshot_save(const chip8core *core, void *out, size_t size);
+    CHIP8CORE_API int chip8core_snapshot_load(chip8core *core, const void *in, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
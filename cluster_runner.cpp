@@ -0,0 +1,1012 @@
+// Cluster runner: spreads a ROM-corpus sweep over several computers. The
+// coordinator holds the job list (every ROM under each quirk profile, CXNN
+// seed and key script) and hands it out over TCP to workers, which run
+// their jobs on all hardware threads as the regression runner does and
+// send back only the checkpoint hashes. Jobs are dealt into one shard per
+// worker up front, a ROM's jobs kept together so its image is sent once.
+// Each worker is kept two jobs per thread ahead; one that runs out of its
+// own shard takes the unsent half of the fullest one, and the jobs of a
+// worker that drops out go to whoever asks next. Workers may join late
+// and start by stealing. The results are written in the regression
+// runner's golden format, a line per job.
+//
+//   chip8-cluster coordinate [options] <rom files or folders...>
+//     --port N         TCP port to listen on (default 8069)
+//     --workers N      workers to wait for before dealing (default 1)
+//     --machines LIST  comma separated quirk profiles, chip8 | vip | chip48
+//                      | schip | xochip (default chip8)
+//     --seeds N        CXNN seeds 1..N for each ROM and profile (default 1)
+//     --scripts N      key scripts 1..N for each seed (default 1)
+//     --frames N       frames to run per job (default 600)
+//     --every N        frames between checkpoints (default 60)
+//     --ipf N          instructions per frame (default 10)
+//     --out FILE       results (default cluster_results.txt)
+//
+//   chip8-cluster work [options] host[:port]
+//     --threads N      worker threads (default: all hardware threads)
+//
+// A result line is the ROM's file name, then |machine|seed|script, a tab
+// and the hashes. Exits with 1 if any ROM fails to load.
+//
+// Every message is a 32-bit little-endian payload length, a type byte
+// (MessageType) and the payload, integers little-endian throughout.
+
+#include "chip8.h"
+#include "chip8_simd.h"
+#include "rom_cache.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const uint32_t magic = 0x4C433843; // "C8CL"
+    const uint16_t protocolVersion = 1;
+    const uint16_t defaultPort = 8069;
+    const uint32_t maxMessage = 1 << 20;
+
+    enum MessageType : uint8_t
+    {
+        Hello = 1,  // Worker: magic u32, version u16, threads u16
+        Config = 2, // Coordinator: frames u64, every u32, ipf u32
+        Rom = 3,    // Coordinator: id u32, the image
+        Job = 4,    // Coordinator: id u32, rom u32, machine u8, seed u64, script u64
+        Result = 5, // Worker: id u32, loaded u8, micros u64, count u32, the hashes u64
+        Done = 6    // Coordinator: no more jobs, the worker exits
+    };
+
+    const char *const machineNames[] = {"chip8", "vip", "chip48", "schip", "xochip"};
+
+#if defined(_WIN32)
+    using SocketType = SOCKET;
+    const intptr_t noSocket = static_cast<intptr_t>(INVALID_SOCKET);
+    void closeSocket(intptr_t s) { closesocket(static_cast<SOCKET>(s)); }
+    bool setNonBlocking(SocketType s)
+    {
+        u_long nonBlocking = 1;
+        return ioctlsocket(s, FIONBIO, &nonBlocking) == 0;
+    }
+    bool wouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+    int pollSockets(std::vector<WSAPOLLFD> &fds, int timeout) { return WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeout); }
+    using PollEntry = WSAPOLLFD;
+    const int sendFlags = 0;
+#else
+    using SocketType = int;
+    const intptr_t noSocket = -1;
+    void closeSocket(intptr_t s) { close(static_cast<int>(s)); }
+    bool setNonBlocking(SocketType s) { return fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK) == 0; }
+    bool wouldBlock() { return errno == EWOULDBLOCK || errno == EAGAIN; }
+    int pollSockets(std::vector<pollfd> &fds, int timeout) { return poll(fds.data(), fds.size(), timeout); }
+    using PollEntry = pollfd;
+    const int sendFlags = MSG_NOSIGNAL;
+#endif
+
+    // Winsock has to be started before the first socket
+    struct Network
+    {
+#if defined(_WIN32)
+        Network()
+        {
+            WSADATA data;
+            WSAStartup(MAKEWORD(2, 2), &data);
+        }
+        ~Network() { WSACleanup(); }
+#else
+        Network() {}
+#endif
+    };
+
+    // One message being built: the length is filled in by finish()
+    struct Writer
+    {
+        std::vector<uint8_t> bytes;
+
+        explicit Writer(MessageType type) : bytes(5, 0) { bytes[4] = type; }
+        void put8(uint8_t value) { bytes.push_back(value); }
+        void put16(uint16_t value) { putLittle(value, 2); }
+        void put32(uint32_t value) { putLittle(value, 4); }
+        void put64(uint64_t value) { putLittle(value, 8); }
+        void putLittle(uint64_t value, int size)
+        {
+            for (int i = 0; i < size; ++i)
+                bytes.push_back(static_cast<uint8_t>(value >> (8 * i)));
+        }
+
+        const std::vector<uint8_t> &finish()
+        {
+            const uint32_t length = static_cast<uint32_t>(bytes.size() - 5);
+            for (int i = 0; i < 4; ++i)
+                bytes[i] = static_cast<uint8_t>(length >> (8 * i));
+            return bytes;
+        }
+    };
+
+    // A received payload; every read fails once past the end
+    struct Reader
+    {
+        const uint8_t *data;
+        size_t size;
+        size_t at = 0;
+
+        bool get(uint64_t &value, int bytes)
+        {
+            if (size - at < static_cast<size_t>(bytes))
+                return false;
+            value = 0;
+            for (int i = 0; i < bytes; ++i)
+                value |= static_cast<uint64_t>(data[at + i]) << (8 * i);
+            at += bytes;
+            return true;
+        }
+        template <typename T>
+        bool get(T &value)
+        {
+            uint64_t wide = 0;
+            if (!get(wide, sizeof(T)))
+                return false;
+            value = static_cast<T>(wide);
+            return true;
+        }
+        std::vector<uint8_t> rest() const { return std::vector<uint8_t>(data + at, data + size); }
+    };
+
+    // Splits complete messages off the front of in; false on a malformed one
+    template <typename Handler>
+    bool takeMessages(std::vector<uint8_t> &in, Handler &&handle)
+    {
+        size_t at = 0;
+        bool ok = true;
+        while (ok && in.size() - at >= 5)
+        {
+            const uint32_t length = in[at] | in[at + 1] << 8 | in[at + 2] << 16 | static_cast<uint32_t>(in[at + 3]) << 24;
+            if (length > maxMessage)
+                return false;
+            if (in.size() - at - 5 < length)
+                break;
+            ok = handle(static_cast<MessageType>(in[at + 4]), Reader{in.data() + at + 5, length});
+            at += 5 + length;
+        }
+        in.erase(in.begin(), in.begin() + at);
+        return ok;
+    }
+
+    // What a job runs, the same on both ends
+    struct Settings
+    {
+        long long frames = 600;
+        int every = 60;
+        int ipf = 10;
+    };
+
+    struct JobSpec
+    {
+        uint32_t rom;
+        uint8_t machine;
+        uint64_t seed;
+        uint64_t script;
+    };
+
+    // Every 6 frames one key goes down or the held one comes up, as the
+    // regression runner scripts them, from the script number
+    template <typename Machine>
+    void applyKeys(Machine &chip8, uint64_t seed, long long frame)
+    {
+        if (frame % 6 != 0)
+            return;
+        uint64_t z = seed + static_cast<uint64_t>(frame / 12) * 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        chip8.setKey(static_cast<int>((z ^ (z >> 31)) & 0xF), frame % 12 == 0);
+    }
+
+    template <typename Machine>
+    bool runJob(const Settings &settings, const std::vector<uint8_t> &rom, const JobSpec &job, std::vector<uint64_t> &hashes)
+    {
+        auto chip8 = std::make_unique<Machine>();
+        if (!chip8->loadROM(rom.data(), rom.size()))
+            return false;
+        chip8->seedRandom(job.seed);
+        for (long long frame = 0; frame < settings.frames; ++frame)
+        {
+            applyKeys(*chip8, job.script, frame);
+            chip8->runFrame(settings.ipf);
+            if ((frame + 1) % settings.every == 0)
+                hashes.push_back(simd::hashBytes(chip8->gfx.data(), sizeof chip8->gfx, chip8->isHires()));
+        }
+        return true;
+    }
+
+    bool runAnyJob(const Settings &settings, const std::vector<uint8_t> &rom, const JobSpec &job, std::vector<uint64_t> &hashes)
+    {
+        switch (job.machine)
+        {
+        case 0:
+            return runJob<Chip8>(settings, rom, job, hashes);
+        case 1:
+            return runJob<VipChip8>(settings, rom, job, hashes);
+        case 2:
+            return runJob<Chip48>(settings, rom, job, hashes);
+        case 3:
+            return runJob<SuperChip8>(settings, rom, job, hashes);
+        case 4:
+            return runJob<XoChip8>(settings, rom, job, hashes);
+        }
+        return false;
+    }
+
+    std::string hashLine(const std::vector<uint64_t> &hashes)
+    {
+        std::string line;
+        char hex[24];
+        for (uint64_t hash : hashes)
+        {
+            std::snprintf(hex, sizeof hex, "%s%016llx", line.empty() ? "" : " ", static_cast<unsigned long long>(hash));
+            line += hex;
+        }
+        return line;
+    }
+
+    void usage()
+    {
+        std::fprintf(stderr, "usage: chip8-cluster coordinate [--port N] [--workers N] [--machines LIST] [--seeds N] [--scripts N] "
+                             "[--frames N] [--every N] [--ipf N] [--out FILE] <rom files or folders...>\n"
+                             "       chip8-cluster work [--threads N] host[:port]\n");
+    }
+
+    void collectRoms(const fs::path &path, std::vector<std::string> &roms)
+    {
+        std::error_code ec;
+        if (!fs::is_directory(path, ec))
+        {
+            roms.push_back(path.string());
+            return;
+        }
+        for (const fs::directory_entry &entry : fs::directory_iterator(path, ec))
+        {
+            std::string ext = entry.path().extension().string();
+            if (entry.is_regular_file() && (ext == ".ch8" || ext == ".rom" || ext == ".xo8"))
+                roms.push_back(entry.path().string());
+        }
+    }
+
+    bool parseMachines(const std::string &list, std::vector<uint8_t> &machines)
+    {
+        std::stringstream ss(list);
+        std::string name;
+        while (std::getline(ss, name, ','))
+        {
+            const auto known = std::find_if(std::begin(machineNames), std::end(machineNames), [&](const char *machine)
+                                            { return name == machine; });
+            if (known == std::end(machineNames))
+                return false;
+            machines.push_back(static_cast<uint8_t>(known - std::begin(machineNames)));
+        }
+        return !machines.empty();
+    }
+
+    // ---- Coordinator ----
+
+    struct Peer
+    {
+        intptr_t socket = noSocket;
+        std::string address;
+        std::vector<uint8_t> in;
+        std::vector<uint8_t> out;
+        bool greeted = false; // Hello received
+        bool closing = false;
+        unsigned threads = 1;
+        std::deque<uint32_t> shard;    // Jobs dealt to this worker, not sent yet
+        std::vector<uint32_t> pending; // Sent, no result yet
+        std::vector<bool> romSent;
+        size_t finished = 0;
+        double seconds = 0; // Spent in its jobs, as it reports
+    };
+
+    class Coordinator
+    {
+    public:
+        Coordinator(const Settings &settings, std::vector<std::string> roms, std::vector<JobSpec> jobs, unsigned expected)
+            : settings(settings), roms(std::move(roms)), jobs(std::move(jobs)), expected(expected), results(this->jobs.size()),
+              loaded(this->jobs.size(), false), done(this->jobs.size(), false)
+        {
+        }
+
+        ~Coordinator()
+        {
+            for (auto &peer : peers)
+                closeSocket(peer->socket);
+            if (listener != noSocket)
+                closeSocket(listener);
+        }
+
+        bool listen(uint16_t port)
+        {
+            SocketType s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+            if (static_cast<intptr_t>(s) == noSocket)
+                return false;
+            int reuse = 1;
+            setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof reuse);
+            sockaddr_in address{};
+            address.sin_family = AF_INET;
+            address.sin_addr.s_addr = htonl(INADDR_ANY);
+            address.sin_port = htons(port);
+            if (bind(s, reinterpret_cast<sockaddr *>(&address), sizeof address) != 0 || ::listen(s, SOMAXCONN) != 0 ||
+                !setNonBlocking(s))
+            {
+                closeSocket(static_cast<intptr_t>(s));
+                return false;
+            }
+            listener = static_cast<intptr_t>(s);
+            return true;
+        }
+
+        // Until every job has a result
+        void run()
+        {
+            std::vector<PollEntry> fds;
+            while (finishedJobs < jobs.size())
+            {
+                fds.clear();
+                PollEntry entry{};
+                entry.fd = static_cast<SocketType>(listener);
+                entry.events = POLLIN;
+                fds.push_back(entry);
+                for (auto &peer : peers)
+                {
+                    entry.fd = static_cast<SocketType>(peer->socket);
+                    entry.events = static_cast<short>(POLLIN | (peer->out.empty() ? 0 : POLLOUT));
+                    entry.revents = 0;
+                    fds.push_back(entry);
+                }
+                if (pollSockets(fds, 1000) > 0)
+                {
+                    if (fds[0].revents & POLLIN)
+                        accept();
+                    const size_t polled = fds.size() - 1;
+                    for (size_t i = 0; i < polled; ++i)
+                    {
+                        Peer &peer = *peers[i];
+                        const short events = fds[i + 1].revents;
+                        if (events & POLLIN)
+                            receive(peer);
+                        if (events & (POLLERR | POLLHUP | POLLNVAL))
+                            peer.closing = true;
+                        if (events & POLLOUT)
+                            flush(peer);
+                    }
+                }
+                dropClosed();
+                for (auto &peer : peers)
+                {
+                    feed(*peer);
+                    flush(*peer);
+                }
+            }
+            for (auto &peer : peers)
+            {
+                Writer done(Done);
+                queue(*peer, done.finish());
+                setBlocking(*peer);
+                flush(*peer);
+            }
+        }
+
+        bool writeResults(const std::string &path, int &failures) const
+        {
+            std::ofstream out(path, std::ios::trunc);
+            failures = 0;
+            for (size_t j = 0; j < jobs.size(); ++j)
+            {
+                const JobSpec &job = jobs[j];
+                if (!loaded[j])
+                {
+                    ++failures;
+                    std::printf("%-11s %s (%s)\n", "LOAD FAILED", roms[job.rom].c_str(), machineNames[job.machine]);
+                    continue;
+                }
+                out << fs::path(roms[job.rom]).filename().string() << '|' << machineNames[job.machine] << '|' << job.seed << '|'
+                    << job.script << '\t' << results[j] << '\n';
+            }
+            return static_cast<bool>(out);
+        }
+
+        void printWorkers(double wall) const
+        {
+            for (const Summary &worker : summaries)
+                std::printf("%-21s %2u threads %7zu jobs %8.2f M cycles/s\n", worker.address.c_str(), worker.threads,
+                            worker.finished, wall > 0 ? worker.finished * cyclesPerJob() / wall / 1e6 : 0.0);
+        }
+
+    private:
+        struct Summary
+        {
+            std::string address;
+            unsigned threads;
+            size_t finished;
+        };
+
+        double cyclesPerJob() const { return static_cast<double>(settings.frames) * settings.ipf; }
+
+        void accept()
+        {
+            for (;;)
+            {
+                sockaddr_in from{};
+                socklen_t fromSize = sizeof from;
+                SocketType s = ::accept(static_cast<SocketType>(listener), reinterpret_cast<sockaddr *>(&from), &fromSize);
+                if (static_cast<intptr_t>(s) == noSocket)
+                    return;
+                if (!setNonBlocking(s))
+                {
+                    closeSocket(static_cast<intptr_t>(s));
+                    continue;
+                }
+                int noDelay = 1;
+                setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&noDelay), sizeof noDelay);
+                auto peer = std::make_unique<Peer>();
+                peer->socket = static_cast<intptr_t>(s);
+                char host[INET_ADDRSTRLEN] = "?";
+                inet_ntop(AF_INET, &from.sin_addr, host, sizeof host);
+                peer->address = std::string(host) + ":" + std::to_string(ntohs(from.sin_port));
+                peer->romSent.assign(roms.size(), false);
+                peers.push_back(std::move(peer));
+            }
+        }
+
+        void receive(Peer &peer)
+        {
+            uint8_t buffer[16384];
+            for (;;)
+            {
+                const auto got = recv(static_cast<SocketType>(peer.socket), reinterpret_cast<char *>(buffer), sizeof buffer, 0);
+                if (got > 0)
+                {
+                    peer.in.insert(peer.in.end(), buffer, buffer + got);
+                    continue;
+                }
+                if (got == 0 || !wouldBlock())
+                    peer.closing = true;
+                break;
+            }
+            if (!takeMessages(peer.in, [&](MessageType type, Reader message)
+                              { return handle(peer, type, message); }))
+                peer.closing = true;
+        }
+
+        bool handle(Peer &peer, MessageType type, Reader message)
+        {
+            if (type == Hello)
+            {
+                uint32_t gotMagic = 0;
+                uint16_t version = 0, threads = 0;
+                if (peer.greeted || !message.get(gotMagic) || !message.get(version) || !message.get(threads) ||
+                    gotMagic != magic || version != protocolVersion)
+                    return false;
+                peer.greeted = true;
+                peer.threads = std::max<unsigned>(1, threads);
+                Writer config(Config);
+                config.put64(static_cast<uint64_t>(settings.frames));
+                config.put32(static_cast<uint32_t>(settings.every));
+                config.put32(static_cast<uint32_t>(settings.ipf));
+                queue(peer, config.finish());
+                std::printf("worker %s joined with %u threads\n", peer.address.c_str(), peer.threads);
+                if (!dealt && greetedPeers() >= expected)
+                    deal();
+                return true;
+            }
+            if (type == Result && peer.greeted)
+            {
+                uint32_t id = 0, count = 0;
+                uint8_t ok = 0;
+                uint64_t micros = 0;
+                if (!message.get(id) || !message.get(ok) || !message.get(micros) || !message.get(count) || id >= jobs.size())
+                    return false;
+                const auto sent = std::find(peer.pending.begin(), peer.pending.end(), id);
+                if (sent == peer.pending.end())
+                    return false;
+                peer.pending.erase(sent);
+                std::vector<uint64_t> hashes(count);
+                for (uint64_t &hash : hashes)
+                {
+                    if (!message.get(hash))
+                        return false;
+                }
+                if (!done[id])
+                {
+                    done[id] = true;
+                    loaded[id] = ok != 0;
+                    results[id] = hashLine(hashes);
+                    ++finishedJobs;
+                    ++peer.finished;
+                    peer.seconds += micros / 1e6;
+                    if (finishedJobs % 1000 == 0 || finishedJobs == jobs.size())
+                        std::printf("%zu of %zu jobs done\n", finishedJobs, jobs.size());
+                }
+                return true;
+            }
+            return false;
+        }
+
+        unsigned greetedPeers() const
+        {
+            unsigned count = 0;
+            for (const auto &peer : peers)
+                count += peer->greeted ? 1 : 0;
+            return count;
+        }
+
+        // Contiguous blocks, one per worker there now, so each ROM's jobs
+        // stay with one worker where the list allows
+        void deal()
+        {
+            dealt = true;
+            std::vector<Peer *> workers;
+            for (auto &peer : peers)
+            {
+                if (peer->greeted)
+                    workers.push_back(peer.get());
+            }
+            for (uint32_t j = 0; j < jobs.size(); ++j)
+                workers[static_cast<size_t>(j) * workers.size() / jobs.size()]->shard.push_back(j);
+            std::printf("dealt %zu jobs to %zu workers\n", jobs.size(), workers.size());
+        }
+
+        // Tops the worker up to two jobs per thread: its own shard first,
+        // then jobs left by workers that dropped out, then half of what the
+        // fullest shard hasn't sent yet
+        void feed(Peer &peer)
+        {
+            if (!dealt || !peer.greeted || peer.closing)
+                return;
+            while (peer.pending.size() < peer.threads * 2)
+            {
+                if (peer.shard.empty())
+                {
+                    if (!orphans.empty())
+                    {
+                        peer.shard.push_back(orphans.front());
+                        orphans.pop_front();
+                    }
+                    else if (!steal(peer))
+                        return;
+                }
+                const uint32_t id = peer.shard.front();
+                peer.shard.pop_front();
+                send(peer, id);
+            }
+        }
+
+        bool steal(Peer &thief)
+        {
+            Peer *victim = nullptr;
+            for (auto &peer : peers)
+            {
+                if (peer.get() != &thief && (!victim || peer->shard.size() > victim->shard.size()))
+                    victim = peer.get();
+            }
+            if (!victim || victim->shard.empty())
+                return false;
+            const size_t take = (victim->shard.size() + 1) / 2;
+            thief.shard.insert(thief.shard.end(), victim->shard.end() - take, victim->shard.end());
+            victim->shard.erase(victim->shard.end() - take, victim->shard.end());
+            return true;
+        }
+
+        void send(Peer &peer, uint32_t id)
+        {
+            const JobSpec &job = jobs[id];
+            if (!peer.romSent[job.rom])
+            {
+                // An unreadable file goes as an empty image, which fails to load
+                Writer rom(Rom);
+                rom.put32(job.rom);
+                if (std::shared_ptr<const RomCache::Image> image = RomCache::shared().get(roms[job.rom]))
+                    rom.bytes.insert(rom.bytes.end(), image->data(), image->data() + image->size());
+                queue(peer, rom.finish());
+                peer.romSent[job.rom] = true;
+            }
+            Writer message(Job);
+            message.put32(id);
+            message.put32(job.rom);
+            message.put8(job.machine);
+            message.put64(job.seed);
+            message.put64(job.script);
+            queue(peer, message.finish());
+            peer.pending.push_back(id);
+        }
+
+        void queue(Peer &peer, const std::vector<uint8_t> &bytes) { peer.out.insert(peer.out.end(), bytes.begin(), bytes.end()); }
+
+        void flush(Peer &peer)
+        {
+            size_t sentTotal = 0;
+            while (sentTotal < peer.out.size())
+            {
+                const auto sent = ::send(static_cast<SocketType>(peer.socket), reinterpret_cast<const char *>(peer.out.data() + sentTotal),
+                                         static_cast<int>(peer.out.size() - sentTotal), sendFlags);
+                if (sent <= 0)
+                {
+                    if (!wouldBlock())
+                        peer.closing = true;
+                    break;
+                }
+                sentTotal += static_cast<size_t>(sent);
+            }
+            peer.out.erase(peer.out.begin(), peer.out.begin() + sentTotal);
+        }
+
+        static void setBlocking(Peer &peer)
+        {
+#if defined(_WIN32)
+            u_long nonBlocking = 0;
+            ioctlsocket(static_cast<SOCKET>(peer.socket), FIONBIO, &nonBlocking);
+#else
+            const int s = static_cast<int>(peer.socket);
+            fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) & ~O_NONBLOCK);
+#endif
+        }
+
+        // A worker that left hands its unfinished jobs to the others
+        void dropClosed()
+        {
+            peers.erase(std::remove_if(peers.begin(), peers.end(), [this](const std::unique_ptr<Peer> &peer)
+                                       {
+                                           if (!peer->closing)
+                                               return false;
+                                           closeSocket(peer->socket);
+                                           orphans.insert(orphans.end(), peer->pending.begin(), peer->pending.end());
+                                           orphans.insert(orphans.end(), peer->shard.begin(), peer->shard.end());
+                                           if (peer->greeted)
+                                           {
+                                               std::printf("worker %s left, %zu jobs to redo\n", peer->address.c_str(),
+                                                           peer->pending.size() + peer->shard.size());
+                                               summaries.push_back({peer->address, peer->threads, peer->finished});
+                                           }
+                                           return true; }),
+                        peers.end());
+            if (finishedJobs == jobs.size())
+            {
+                for (const auto &peer : peers)
+                {
+                    if (peer->greeted)
+                        summaries.push_back({peer->address, peer->threads, peer->finished});
+                }
+            }
+        }
+
+        Settings settings;
+        std::vector<std::string> roms;
+        std::vector<JobSpec> jobs;
+        unsigned expected;
+        std::vector<std::string> results; // Hash line per job
+        std::vector<bool> loaded;
+        std::vector<bool> done;
+        size_t finishedJobs = 0;
+        bool dealt = false;
+        intptr_t listener = noSocket;
+        std::vector<std::unique_ptr<Peer>> peers;
+        std::deque<uint32_t> orphans; // Jobs of workers that left
+        std::vector<Summary> summaries;
+    };
+
+    int coordinate(int argc, char **argv)
+    {
+        Settings settings;
+        uint16_t port = defaultPort;
+        unsigned expected = 1;
+        std::vector<uint8_t> machines;
+        long long seeds = 1, scripts = 1;
+        std::string outPath = "cluster_results.txt";
+        std::vector<std::string> roms;
+        for (int i = 2; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--port" && hasValue)
+                port = static_cast<uint16_t>(std::atoi(argv[++i]));
+            else if (arg == "--workers" && hasValue)
+                expected = static_cast<unsigned>(std::atoi(argv[++i]));
+            else if (arg == "--machines" && hasValue)
+            {
+                if (!parseMachines(argv[++i], machines))
+                {
+                    usage();
+                    return 1;
+                }
+            }
+            else if (arg == "--seeds" && hasValue)
+                seeds = std::atoll(argv[++i]);
+            else if (arg == "--scripts" && hasValue)
+                scripts = std::atoll(argv[++i]);
+            else if (arg == "--frames" && hasValue)
+                settings.frames = std::atoll(argv[++i]);
+            else if (arg == "--every" && hasValue)
+                settings.every = std::atoi(argv[++i]);
+            else if (arg == "--ipf" && hasValue)
+                settings.ipf = std::atoi(argv[++i]);
+            else if (arg == "--out" && hasValue)
+                outPath = argv[++i];
+            else if (arg[0] != '-')
+                collectRoms(arg, roms);
+            else
+            {
+                usage();
+                return 1;
+            }
+        }
+        if (roms.empty() || expected == 0 || seeds <= 0 || scripts <= 0 || settings.frames < 0 || settings.every <= 0 ||
+            settings.ipf <= 0)
+        {
+            usage();
+            return 1;
+        }
+        if (machines.empty())
+            machines.push_back(0);
+        std::sort(roms.begin(), roms.end());
+
+        std::vector<JobSpec> jobs;
+        for (uint32_t r = 0; r < roms.size(); ++r)
+        {
+            for (uint8_t machine : machines)
+            {
+                for (long long seed = 1; seed <= seeds; ++seed)
+                {
+                    for (long long script = 1; script <= scripts; ++script)
+                        jobs.push_back({r, machine, static_cast<uint64_t>(seed), static_cast<uint64_t>(script)});
+                }
+            }
+        }
+
+        Network network;
+        Coordinator coordinator(settings, roms, std::move(jobs), expected);
+        if (!coordinator.listen(port))
+        {
+            std::fprintf(stderr, "Can't listen on port %u\n", port);
+            return 1;
+        }
+        std::printf("%zu ROMs, %zu jobs, waiting for %u workers on port %u\n", roms.size(),
+                    static_cast<size_t>(roms.size() * machines.size() * seeds * scripts), expected, port);
+        const auto start = Clock::now();
+        coordinator.run();
+        const double wall = std::chrono::duration<double>(Clock::now() - start).count();
+
+        int failures = 0;
+        if (!coordinator.writeResults(outPath, failures))
+        {
+            std::fprintf(stderr, "Failed to write results: %s\n", outPath.c_str());
+            return 1;
+        }
+        std::printf("\n");
+        coordinator.printWorkers(wall);
+        std::printf("All jobs done in %.3f s, results in %s, %d load failures\n", wall, outPath.c_str(), failures);
+        return failures ? 1 : 0;
+    }
+
+    // ---- Worker ----
+
+    intptr_t connectTo(const std::string &target)
+    {
+        std::string host = target, port = std::to_string(defaultPort);
+        const size_t colon = target.rfind(':');
+        if (colon != std::string::npos)
+        {
+            host = target.substr(0, colon);
+            port = target.substr(colon + 1);
+        }
+        addrinfo hints{};
+        hints.ai_family = AF_INET;
+        hints.ai_socktype = SOCK_STREAM;
+        addrinfo *found = nullptr;
+        if (getaddrinfo(host.c_str(), port.c_str(), &hints, &found) != 0)
+            return noSocket;
+        intptr_t connected = noSocket;
+        for (addrinfo *at = found; at && connected == noSocket; at = at->ai_next)
+        {
+            SocketType s = socket(at->ai_family, at->ai_socktype, at->ai_protocol);
+            if (static_cast<intptr_t>(s) == noSocket)
+                continue;
+            if (::connect(s, at->ai_addr, static_cast<int>(at->ai_addrlen)) == 0)
+                connected = static_cast<intptr_t>(s);
+            else
+                closeSocket(static_cast<intptr_t>(s));
+        }
+        freeaddrinfo(found);
+        return connected;
+    }
+
+    bool sendAll(intptr_t s, const std::vector<uint8_t> &bytes)
+    {
+        size_t at = 0;
+        while (at < bytes.size())
+        {
+            const auto sent = ::send(static_cast<SocketType>(s), reinterpret_cast<const char *>(bytes.data() + at),
+                                     static_cast<int>(bytes.size() - at), sendFlags);
+            if (sent <= 0)
+                return false;
+            at += static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    int work(int argc, char **argv)
+    {
+        unsigned threads = 0;
+        std::string target;
+        for (int i = 2; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            if (arg == "--threads" && i + 1 < argc)
+                threads = static_cast<unsigned>(std::atoi(argv[++i]));
+            else if (arg[0] != '-' && target.empty())
+                target = arg;
+            else
+            {
+                usage();
+                return 1;
+            }
+        }
+        if (target.empty())
+        {
+            usage();
+            return 1;
+        }
+
+        Network network;
+        const intptr_t s = connectTo(target);
+        if (s == noSocket)
+        {
+            std::fprintf(stderr, "Can't connect to %s\n", target.c_str());
+            return 1;
+        }
+        int noDelay = 1;
+        setsockopt(static_cast<SocketType>(s), IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&noDelay), sizeof noDelay);
+
+        ThreadPool pool(threads);
+        Writer hello(Hello);
+        hello.put32(magic);
+        hello.put16(protocolVersion);
+        hello.put16(static_cast<uint16_t>(std::min(pool.size(), 65535u)));
+        bool ok = sendAll(s, hello.finish());
+        std::printf("connected to %s, %u threads\n", target.c_str(), pool.size());
+
+        // Results finished by the pool, sent by this thread
+        std::mutex outMutex;
+        std::vector<uint8_t> outbox;
+        Settings settings;
+        std::vector<std::shared_ptr<const std::vector<uint8_t>>> roms;
+        size_t jobsRun = 0;
+        bool finished = false;
+
+        std::vector<uint8_t> in;
+        std::vector<PollEntry> fds(1);
+        while (ok && !finished)
+        {
+            fds[0] = PollEntry{};
+            fds[0].fd = static_cast<SocketType>(s);
+            fds[0].events = POLLIN;
+            if (pollSockets(fds, 20) > 0 && (fds[0].revents & (POLLIN | POLLERR | POLLHUP)))
+            {
+                uint8_t buffer[16384];
+                const auto got = recv(static_cast<SocketType>(s), reinterpret_cast<char *>(buffer), sizeof buffer, 0);
+                if (got <= 0)
+                    break;
+                in.insert(in.end(), buffer, buffer + got);
+                ok = takeMessages(in, [&](MessageType type, Reader message)
+                                  {
+                                      if (type == Config)
+                                      {
+                                          uint64_t frames = 0;
+                                          uint32_t every = 0, ipf = 0;
+                                          if (!message.get(frames) || !message.get(every) || !message.get(ipf) || every == 0 || ipf == 0)
+                                              return false;
+                                          settings.frames = static_cast<long long>(frames);
+                                          settings.every = static_cast<int>(every);
+                                          settings.ipf = static_cast<int>(ipf);
+                                          return true;
+                                      }
+                                      if (type == Rom)
+                                      {
+                                          uint32_t id = 0;
+                                          if (!message.get(id) || id > 1000000)
+                                              return false;
+                                          if (roms.size() <= id)
+                                              roms.resize(id + 1);
+                                          roms[id] = std::make_shared<const std::vector<uint8_t>>(message.rest());
+                                          return true;
+                                      }
+                                      if (type == Job)
+                                      {
+                                          uint32_t id = 0;
+                                          JobSpec job{};
+                                          if (!message.get(id) || !message.get(job.rom) || !message.get(job.machine) ||
+                                              !message.get(job.seed) || !message.get(job.script) || job.rom >= roms.size() || !roms[job.rom])
+                                              return false;
+                                          ++jobsRun;
+                                          pool.submit([&, id, job, rom = roms[job.rom], jobSettings = settings]
+                                                      {
+                                                          const auto t0 = Clock::now();
+                                                          std::vector<uint64_t> hashes;
+                                                          const bool loaded = runAnyJob(jobSettings, *rom, job, hashes);
+                                                          const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - t0).count();
+                                                          Writer result(Result);
+                                                          result.put32(id);
+                                                          result.put8(loaded ? 1 : 0);
+                                                          result.put64(static_cast<uint64_t>(micros));
+                                                          result.put32(static_cast<uint32_t>(hashes.size()));
+                                                          for (uint64_t hash : hashes)
+                                                              result.put64(hash);
+                                                          const std::vector<uint8_t> &bytes = result.finish();
+                                                          std::lock_guard<std::mutex> lock(outMutex);
+                                                          outbox.insert(outbox.end(), bytes.begin(), bytes.end());
+                                                      });
+                                          return true;
+                                      }
+                                      if (type == Done)
+                                      {
+                                          finished = true;
+                                          return true;
+                                      }
+                                      return false;
+                                  });
+            }
+
+            std::vector<uint8_t> ready;
+            {
+                std::lock_guard<std::mutex> lock(outMutex);
+                ready.swap(outbox);
+            }
+            if (!ready.empty())
+                ok = sendAll(s, ready);
+        }
+        pool.wait();
+        closeSocket(s);
+        if (!finished)
+        {
+            std::fprintf(stderr, "Lost the coordinator after %zu jobs\n", jobsRun);
+            return 1;
+        }
+        std::printf("ran %zu jobs\n", jobsRun);
+        return 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const std::string mode = argc > 1 ? argv[1] : "";
+    if (mode == "coordinate")
+        return coordinate(argc, argv);
+    if (mode == "work")
+        return work(argc, argv);
+    usage();
+    return 1;
+}
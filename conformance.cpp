@@ -0,0 +1,400 @@
+// Conformance runner: checks the ALU flags and the quirks of every machine
+// profile against small built-in programs, then, for any ROMs given, runs
+// each under every profile and reports its instructions per second.
+//
+// Each built-in check is a few instructions ending in a jump to itself;
+// its expected registers, I and pixels follow from that profile's quirks.
+// The flag checks include VF as the destination of 8XY4-8XYE, where the
+// flag has to win over the result as on the VIP.
+//
+//   chip8-conformance [options] [rom files or folders...]
+//     --core NAME    switch | table | predecoded | jit | aot | tiered
+//                    (default table)
+//     --frames N     frames to run each ROM (default 600)
+//     --ipf N        instructions per frame for ROMs (default 1000)
+//     --preset N     write N to 0x1FF before starting each ROM, which the
+//                    community test suite reads to skip its menu
+//     --show         print each ROM's final screen
+//
+// Exits with 1 if any built-in check fails.
+
+#include "chip8.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // The quirks of one profile, as values the expectations can test
+    struct QuirkSet
+    {
+        quirks::IndexStep loadStoreIndex;
+        bool shiftUsesVy;
+        bool jumpUsesVx;
+        bool logicResetsVF;
+        bool wrapSprites;
+        bool longSkip; // Skips step over all 4 bytes of F000 NNNN
+    };
+
+    template <typename Machine>
+    QuirkSet quirkSet()
+    {
+        using Q = typename Machine::QuirkProfile;
+        return {Q::loadStoreIndex, Q::shiftUsesVy, Q::jumpUsesVx, Q::logicResetsVF, Q::wrapSprites, Machine::xoChip};
+    }
+
+    struct Expect
+    {
+        std::vector<std::pair<int, uint8_t>> registers; // Vx and the value it must hold
+        int index = -1;                                   // I, -1 to leave it
+        std::vector<std::pair<int, int>> litPixels{};     // (x, y) that must be on
+        std::vector<std::pair<int, int>> darkPixels{};    // (x, y) that must be off
+    };
+
+    struct Check
+    {
+        const char *name;
+        std::vector<uint16_t> program; // From 0x200, a jump to itself is added
+        Expect (*expect)(const QuirkSet &);
+    };
+
+    // 8XY6/8XYE expectations: what the shift reads, what it leaves, and its flag
+    uint8_t shifted(bool left, uint8_t value) { return left ? static_cast<uint8_t>(value << 1) : value >> 1; }
+    uint8_t shiftFlag(bool left, uint8_t value) { return left ? value >> 7 : value & 1; }
+
+    uint16_t indexAfter(const QuirkSet &q, uint16_t start, int x)
+    {
+        switch (q.loadStoreIndex)
+        {
+        case quirks::IndexStep::PlusXPlusOne:
+            return static_cast<uint16_t>(start + x + 1);
+        case quirks::IndexStep::PlusX:
+            return static_cast<uint16_t>(start + x);
+        default:
+            return start;
+        }
+    }
+
+    const Check checks[] = {
+        {"8XY4 carry", {0x60FF, 0x6102, 0x8014, 0x8AF0}, [](const QuirkSet &)
+         { return Expect{{{0x0, 0x01}, {0xA, 1}}}; }},
+        {"8XY4 no carry", {0x6001, 0x6102, 0x8014, 0x8AF0}, [](const QuirkSet &)
+         { return Expect{{{0x0, 0x03}, {0xA, 0}}}; }},
+        {"8XY5 no borrow", {0x6007, 0x6105, 0x8015, 0x8AF0}, [](const QuirkSet &)
+         { return Expect{{{0x0, 0x02}, {0xA, 1}}}; }},
+        {"8XY5 borrow", {0x6005, 0x6107, 0x8015, 0x8AF0}, [](const QuirkSet &)
+         { return Expect{{{0x0, 0xFE}, {0xA, 0}}}; }},
+        {"8XY5 equal", {0x6007, 0x6107, 0x8015, 0x8AF0}, [](const QuirkSet &)
+         { return Expect{{{0x0, 0x00}, {0xA, 1}}}; }},
+        {"8XY7 no borrow", {0x6005, 0x6107, 0x8017, 0x8AF0}, [](const QuirkSet &)
+         { return Expect{{{0x0, 0x02}, {0xA, 1}}}; }},
+        {"8XY7 borrow", {0x6007, 0x6105, 0x8017, 0x8AF0}, [](const QuirkSet &)
+         { return Expect{{{0x0, 0xFE}, {0xA, 0}}}; }},
+        {"8XY6", {0x6005, 0x6102, 0x8016, 0x8AF0}, [](const QuirkSet &q)
+         {
+             const uint8_t src = q.shiftUsesVy ? 0x02 : 0x05;
+             return Expect{{{0x0, shifted(false, src)}, {0xA, shiftFlag(false, src)}}};
+         }},
+        {"8XYE", {0x6081, 0x6140, 0x801E, 0x8AF0}, [](const QuirkSet &q)
+         {
+             const uint8_t src = q.shiftUsesVy ? 0x40 : 0x81;
+             return Expect{{{0x0, shifted(true, src)}, {0xA, shiftFlag(true, src)}}};
+         }},
+        {"8XY4 into VF", {0x6FFF, 0x6103, 0x8F14}, [](const QuirkSet &)
+         { return Expect{{{0xF, 1}}}; }},
+        {"8XY5 into VF", {0x6F07, 0x6105, 0x8F15}, [](const QuirkSet &)
+         { return Expect{{{0xF, 1}}}; }},
+        {"8XY7 into VF", {0x6F05, 0x6107, 0x8F17}, [](const QuirkSet &)
+         { return Expect{{{0xF, 1}}}; }},
+        {"8XY6 into VF", {0x6F05, 0x6102, 0x8F16}, [](const QuirkSet &q)
+         { return Expect{{{0xF, shiftFlag(false, q.shiftUsesVy ? 0x02 : 0x05)}}}; }},
+        {"8XYE into VF", {0x6F81, 0x6140, 0x8F1E}, [](const QuirkSet &q)
+         { return Expect{{{0xF, shiftFlag(true, q.shiftUsesVy ? 0x40 : 0x81)}}}; }},
+        {"7XNN leaves VF", {0x6F05, 0x60FF, 0x7002}, [](const QuirkSet &)
+         { return Expect{{{0x0, 0x01}, {0xF, 0x05}}}; }},
+        {"8XY1-3 and VF", {0x6001, 0x6102, 0x6F05, 0x8011, 0x8AF0, 0x6F05, 0x8012, 0x8BF0, 0x6F05, 0x8013, 0x8CF0}, [](const QuirkSet &q)
+         {
+             const uint8_t vf = q.logicResetsVF ? 0 : 5;
+             return Expect{{{0x0, 0x00}, {0xA, vf}, {0xB, vf}, {0xC, vf}}};
+         }},
+        {"FX55 and I", {0xA300, 0x6011, 0x6122, 0x6233, 0xF255}, [](const QuirkSet &q)
+         {
+             Expect e;
+             e.index = indexAfter(q, 0x300, 2);
+             return e;
+         }},
+        {"FX65 and I", {0xA300, 0xF265}, [](const QuirkSet &q)
+         {
+             Expect e;
+             e.index = indexAfter(q, 0x300, 2);
+             return e;
+         }},
+        {"FX33 and FX65", {0x60FE, 0xA300, 0xF033, 0xA300, 0xF265}, [](const QuirkSet &)
+         { return Expect{{{0x0, 2}, {0x1, 5}, {0x2, 4}}}; }},
+        {"FX1E", {0xA0FF, 0x6001, 0xF01E}, [](const QuirkSet &)
+         {
+             Expect e;
+             e.index = 0x100;
+             return e;
+         }},
+        // B20A lands on 6A01 at 0x20A, or with Vx added on 6A02 at 0x20E
+        {"BNNN", {0x6000, 0x6204, 0xB20A, 0x0000, 0x0000, 0x6A01, 0x1210, 0x6A02}, [](const QuirkSet &q)
+         { return Expect{{{0xA, static_cast<uint8_t>(q.jumpUsesVx ? 2 : 1)}}}; }},
+        // Skipping F000 lands on 7A01 twice, or once where the skip takes all of it
+        {"3XNN over F000", {0x6000, 0x3000, 0xF000, 0x7A01, 0x7A01}, [](const QuirkSet &q)
+         { return Expect{{{0xA, static_cast<uint8_t>(q.longSkip ? 1 : 2)}}}; }},
+        {"2NNN and 00EE", {0x2206, 0x6A01, 0x120A, 0x6B02, 0x00EE}, [](const QuirkSet &)
+         { return Expect{{{0xA, 1}, {0xB, 2}}}; }},
+        {"FX15 and FX07", {0x6005, 0xF015, 0xF107}, [](const QuirkSet &)
+         { return Expect{{{0x1, 5}}}; }},
+        // The font's 0 is F0 90 90 90 F0: drawn twice it sets VF and leaves nothing
+        {"DXYN collision", {0x6000, 0x6100, 0xF029, 0xD015, 0xD015}, [](const QuirkSet &)
+         {
+             Expect e{{{0xF, 1}}};
+             e.darkPixels = {{0, 0}, {3, 1}};
+             return e;
+         }},
+        // The sprite byte changes from 80 to C0 between two draws
+        {"DXYN after a store", {0x6080, 0xA300, 0xF055, 0x6100, 0xA300, 0xD111, 0x60C0, 0xA300, 0xF055, 0xA300, 0xD111}, [](const QuirkSet &)
+         {
+             Expect e{{{0xF, 1}}};
+             e.litPixels = {{1, 0}};
+             e.darkPixels = {{0, 0}};
+             return e;
+         }},
+        // Row 1 (90) at x = 61 has pixels at 61 and 64, which wraps to 0
+        {"DXYN at the edge", {0x603D, 0x6100, 0x6200, 0xF229, 0xD015}, [](const QuirkSet &q)
+         {
+             Expect e{{{0xF, 0}}};
+             e.litPixels = {{61, 1}};
+             (q.wrapSprites ? e.litPixels : e.darkPixels).push_back({0, 1});
+             return e;
+         }},
+    };
+
+    struct Options
+    {
+        Chip8::Core core = Chip8::Core::Table;
+        int frames = 600;
+        int ipf = 1000;
+        int preset = -1;
+        bool show = false;
+        std::vector<std::string> roms;
+    };
+
+    void usage()
+    {
+        std::fprintf(stderr, "usage: chip8-conformance [--core switch|table|predecoded|jit|aot|tiered] [--frames N] [--ipf N] "
+                             "[--preset N] [--show] [rom files or folders...]\n");
+    }
+
+    bool parseCore(const char *name, Chip8::Core &core)
+    {
+        static const struct
+        {
+            const char *name;
+            Chip8::Core core;
+        } cores[] = {{"switch", Chip8::Core::Switch},
+                     {"table", Chip8::Core::Table},
+                     {"predecoded", Chip8::Core::Predecoded},
+                     {"jit", Chip8::Core::Jit},
+                     {"aot", Chip8::Core::Aot},
+                     {"tiered", Chip8::Core::Tiered}};
+        for (const auto &known : cores)
+        {
+            if (std::strcmp(name, known.name) == 0)
+            {
+                core = known.core;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void collectRoms(const fs::path &path, std::vector<std::string> &roms)
+    {
+        std::error_code ec;
+        if (!fs::is_directory(path, ec))
+        {
+            roms.push_back(path.string());
+            return;
+        }
+        for (const fs::directory_entry &entry : fs::directory_iterator(path, ec))
+        {
+            std::string ext = entry.path().extension().string();
+            if (entry.is_regular_file() && (ext == ".ch8" || ext == ".rom" || ext == ".xo8"))
+                roms.push_back(entry.path().string());
+        }
+    }
+
+    // A few frames are plenty for every check; DXYN waits for the tick on
+    // some profiles, so it takes more than one
+    template <typename Machine>
+    void runToEnd(Machine &chip8)
+    {
+        for (int frame = 0; frame < 8; ++frame)
+            chip8.runFrame(100);
+    }
+
+    // The reasons it failed, empty if it passed
+    template <typename Machine>
+    std::string runCheck(const Check &check, Chip8::Core core)
+    {
+        std::vector<uint8_t> image;
+        for (uint16_t op : check.program)
+        {
+            image.push_back(static_cast<uint8_t>(op >> 8));
+            image.push_back(static_cast<uint8_t>(op));
+        }
+        const uint16_t end = static_cast<uint16_t>(0x200 + image.size());
+        image.push_back(static_cast<uint8_t>(0x10 | end >> 8));
+        image.push_back(static_cast<uint8_t>(end));
+
+        Machine chip8(core);
+        chip8.loadROM(image.data(), image.size());
+        chip8.seedRandom(1);
+        runToEnd(chip8);
+
+        const Expect expect = check.expect(quirkSet<Machine>());
+        std::string failed;
+        char reason[64];
+        if (chip8.getPC() != end)
+        {
+            std::snprintf(reason, sizeof reason, " PC=%03X", chip8.getPC());
+            failed += reason;
+        }
+        for (const auto &reg : expect.registers)
+        {
+            if (chip8.getV()[reg.first] != reg.second)
+            {
+                std::snprintf(reason, sizeof reason, " V%X=%02X (want %02X)", reg.first, chip8.getV()[reg.first], reg.second);
+                failed += reason;
+            }
+        }
+        if (expect.index >= 0 && chip8.getI() != expect.index)
+        {
+            std::snprintf(reason, sizeof reason, " I=%03X (want %03X)", chip8.getI(), expect.index);
+            failed += reason;
+        }
+        for (const auto &at : expect.litPixels)
+        {
+            if (!chip8.pixel(at.first, at.second))
+            {
+                std::snprintf(reason, sizeof reason, " (%d,%d) off", at.first, at.second);
+                failed += reason;
+            }
+        }
+        for (const auto &at : expect.darkPixels)
+        {
+            if (chip8.pixel(at.first, at.second))
+            {
+                std::snprintf(reason, sizeof reason, " (%d,%d) on", at.first, at.second);
+                failed += reason;
+            }
+        }
+        return failed;
+    }
+
+    template <typename Machine>
+    void printScreen(const Machine &chip8)
+    {
+        for (int y = 0; y < chip8.height(); ++y)
+        {
+            std::string line;
+            for (int x = 0; x < chip8.width(); ++x)
+                line += chip8.pixel(x, y) ? '#' : '.';
+            std::printf("    %s\n", line.c_str());
+        }
+    }
+
+    template <typename Machine>
+    int runProfile(const char *name, const Options &opt)
+    {
+        int failures = 0;
+        for (const Check &check : checks)
+        {
+            const std::string failed = runCheck<Machine>(check, opt.core);
+            if (!failed.empty())
+            {
+                std::printf("%-7s %-19s FAIL%s\n", name, check.name, failed.c_str());
+                ++failures;
+            }
+        }
+        std::printf("%-7s %zu of %zu checks passed\n", name, std::size(checks) - failures, std::size(checks));
+
+        for (const std::string &path : opt.roms)
+        {
+            Machine chip8(opt.core);
+            if (!chip8.loadROM(path))
+            {
+                std::printf("%-7s LOAD FAILED %s\n", name, path.c_str());
+                continue;
+            }
+            chip8.seedRandom(1);
+            if (opt.preset >= 0)
+                chip8.pokeMemory(0x1FF, static_cast<uint8_t>(opt.preset));
+            const auto start = std::chrono::steady_clock::now();
+            for (int frame = 0; frame < opt.frames; ++frame)
+                chip8.runFrame(opt.ipf);
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::printf("%-7s %8.2f M instructions/s  %s\n", name, seconds > 0 ? chip8.getCycleCount() / seconds / 1e6 : 0.0,
+                        path.c_str());
+            if (opt.show)
+                printScreen(chip8);
+        }
+        return failures;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--core" && hasValue)
+        {
+            if (!parseCore(argv[++i], opt.core))
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if (arg == "--frames" && hasValue)
+            opt.frames = std::atoi(argv[++i]);
+        else if (arg == "--ipf" && hasValue)
+            opt.ipf = std::atoi(argv[++i]);
+        else if (arg == "--preset" && hasValue)
+            opt.preset = std::atoi(argv[++i]);
+        else if (arg == "--show")
+            opt.show = true;
+        else if (arg[0] != '-')
+            collectRoms(arg, opt.roms);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (opt.frames < 0 || opt.ipf <= 0)
+    {
+        usage();
+        return 1;
+    }
+
+    int failures = 0;
+    failures += runProfile<Chip8>("chip8", opt);
+    failures += runProfile<VipChip8>("vip", opt);
+    failures += runProfile<Chip48>("chip48", opt);
+    failures += runProfile<SuperChip8>("schip", opt);
+    failures += runProfile<XoChip8>("xochip", opt);
+    std::printf("\n%d checks failed\n", failures);
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,461 @@
+// Differential tester: runs every ROM on two interpreter backends in
+// lockstep, compares their whole machine state every K instructions and
+// reports the first divergence, narrowed down to the instruction that
+// caused it. ROMs are spread over all hardware threads.
+//
+//   chip8-diff [options] <rom files or folders...>
+//     --cores A,B    backends to compare (default table,jit): switch, table,
+//                    predecoded, jit, aot, tiered, or batch for a Chip8Batch
+//                    lane
+//     --every K      instructions between comparisons (default 10)
+//     --frames N     frames to run per ROM (default 3000)
+//     --ipf N        instructions per frame (default 10)
+//     --threads N    worker threads (default: all hardware threads)
+//     --seed N       CXNN seed and key script seed (default 1)
+
+#include "chip8.h"
+#include "chip8_batch.h"
+#include "chip8_disasm.h"
+#include "rom_cache.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // What every backend has in common, for comparing them
+    struct State
+    {
+        std::array<uint8_t, 4096> memory;
+        std::array<uint64_t, 128> gfx;
+        std::array<uint8_t, 16> V;
+        std::array<uint16_t, 16> stack;
+        std::array<uint8_t, 16> rplFlags;
+        uint16_t I;
+        uint16_t PC;
+        uint8_t sp;
+        uint8_t delayTimer;
+        uint8_t soundTimer;
+        bool hires;
+        int8_t keyWaitReg;
+        int8_t keyWaitKey;
+        uint64_t rngState;
+    };
+
+    // One machine under test. mark() remembers the current state and
+    // rewind() goes back to it, so a divergence can be replayed one
+    // instruction at a time.
+    class Backend
+    {
+    public:
+        virtual ~Backend() = default;
+        virtual bool load(const uint8_t *rom, size_t size, uint64_t seed) = 0;
+        virtual void run(int count) = 0;
+        virtual void tick() = 0;
+        virtual void setKey(int key, bool pressed) = 0;
+        virtual void capture(State &out) const = 0;
+        virtual void mark() = 0;
+        virtual void rewind() = 0;
+    };
+
+    class MachineBackend : public Backend
+    {
+    public:
+        explicit MachineBackend(Chip8::Core core) : chip8(core) {}
+
+        bool load(const uint8_t *rom, size_t size, uint64_t seed) override
+        {
+            if (!chip8.loadROM(rom, size))
+                return false;
+            chip8.seedRandom(seed);
+            return true;
+        }
+        void run(int count) override { chip8.emulateCycles(count); }
+        void tick() override { chip8.decrementTimers(); }
+        void setKey(int key, bool pressed) override { chip8.setKey(key, pressed); }
+
+        void capture(State &out) const override
+        {
+            chip8.snapshot(scratch);
+            out.memory = scratch.memory;
+            out.gfx = scratch.gfx;
+            out.V = scratch.V;
+            out.stack = scratch.stack;
+            out.rplFlags = scratch.rplFlags;
+            out.I = scratch.I;
+            out.PC = scratch.PC;
+            out.sp = scratch.sp;
+            out.delayTimer = chip8.getDelayTimer();
+            out.soundTimer = chip8.getSoundTimer();
+            out.hires = scratch.hires;
+            out.keyWaitReg = scratch.keyWaitReg;
+            out.keyWaitKey = scratch.keyWaitKey;
+            out.rngState = scratch.rngState;
+        }
+
+        void mark() override { chip8.snapshot(saved); }
+        void rewind() override { chip8.restore(saved); }
+
+    private:
+        Chip8 chip8;
+        Chip8::Snapshot saved;
+        mutable Chip8::Snapshot scratch;
+    };
+
+    // Lane 0 of a one-lane batch, stepped with run like a Chip8
+    class BatchBackend : public Backend
+    {
+    public:
+        BatchBackend() : batch(1) {}
+
+        bool load(const uint8_t *rom, size_t size, uint64_t seed) override
+        {
+            if (!batch.loadROM(rom, size))
+                return false;
+            batch.seedRandom(0, seed);
+            return true;
+        }
+        void run(int count) override { batch.run(0, count); }
+        void tick() override { batch.decrementTimers(0); }
+        void setKey(int key, bool pressed) override { batch.setKey(0, key, pressed); }
+
+        void capture(State &out) const override
+        {
+            batch.get(0, scratch);
+            const Chip8Batch::Registers &r = scratch.regs;
+            out.memory = scratch.memory;
+            out.gfx = scratch.gfx;
+            out.V = r.V;
+            out.stack = scratch.stack;
+            out.rplFlags = scratch.rplFlags;
+            out.I = r.I;
+            out.PC = r.PC;
+            out.sp = r.sp;
+            out.delayTimer = r.delayTimer;
+            out.soundTimer = r.soundTimer;
+            out.hires = r.hires;
+            out.keyWaitReg = r.keyWaitReg;
+            out.keyWaitKey = r.keyWaitKey;
+            out.rngState = r.rngState;
+        }
+
+        void mark() override { batch.get(0, saved); }
+        void rewind() override { batch.set(0, saved); }
+
+    private:
+        Chip8Batch batch;
+        Chip8Batch::Machine saved;
+        mutable Chip8Batch::Machine scratch;
+    };
+
+    struct BackendConfig
+    {
+        const char *name;
+        bool batch;
+        Chip8::Core core;
+    };
+
+    const BackendConfig knownBackends[] = {
+        {"switch", false, Chip8::Core::Switch},
+        {"table", false, Chip8::Core::Table},
+        {"predecoded", false, Chip8::Core::Predecoded},
+        {"jit", false, Chip8::Core::Jit},
+        {"aot", false, Chip8::Core::Aot},
+        {"tiered", false, Chip8::Core::Tiered},
+        {"batch", true, Chip8::Core::Table},
+    };
+
+    std::unique_ptr<Backend> makeBackend(const BackendConfig &config)
+    {
+        if (config.batch)
+            return std::make_unique<BatchBackend>();
+        return std::make_unique<MachineBackend>(config.core);
+    }
+
+    struct Options
+    {
+        BackendConfig first = knownBackends[1];
+        BackendConfig second = knownBackends[3];
+        int every = 10;
+        long long frames = 3000;
+        int ipf = 10;
+        unsigned threads = 0;
+        uint64_t seed = 1;
+    };
+
+    struct alignas(64) Result
+    {
+        bool loaded = false;
+        bool diverged = false;
+        std::string report; // Where and how, when diverged
+    };
+
+    bool same(const State &a, const State &b)
+    {
+        return a.PC == b.PC && a.I == b.I && a.sp == b.sp && a.V == b.V && a.delayTimer == b.delayTimer &&
+               a.soundTimer == b.soundTimer && a.hires == b.hires && a.keyWaitReg == b.keyWaitReg &&
+               a.keyWaitKey == b.keyWaitKey && a.rngState == b.rngState && a.stack == b.stack &&
+               a.rplFlags == b.rplFlags && a.gfx == b.gfx && a.memory == b.memory;
+    }
+
+    // Up to a few fields that differ, for the report
+    std::string differences(const State &a, const State &b)
+    {
+        std::string out;
+        int listed = 0;
+        auto add = [&](const std::string &name, unsigned x, unsigned y)
+        {
+            if (x == y || listed++ >= 6)
+                return;
+            char text[64];
+            std::snprintf(text, sizeof text, "%s%s %X/%X", out.empty() ? "" : ", ", name.c_str(), x, y);
+            out += text;
+        };
+        add("PC", a.PC, b.PC);
+        add("I", a.I, b.I);
+        add("SP", a.sp, b.sp);
+        for (int i = 0; i < 16; ++i)
+            add("V" + std::string(1, "0123456789ABCDEF"[i]), a.V[i], b.V[i]);
+        add("DT", a.delayTimer, b.delayTimer);
+        add("ST", a.soundTimer, b.soundTimer);
+        add("hires", a.hires, b.hires);
+        add("FX0A reg", static_cast<uint8_t>(a.keyWaitReg), static_cast<uint8_t>(b.keyWaitReg));
+        add("FX0A key", static_cast<uint8_t>(a.keyWaitKey), static_cast<uint8_t>(b.keyWaitKey));
+        if (a.rngState != b.rngState)
+            add("RNG", 0, 1);
+        for (int i = 0; i < 16; ++i)
+            add("stack[" + std::to_string(i) + "]", a.stack[i], b.stack[i]);
+        for (int i = 0; i < 16; ++i)
+            add("flags[" + std::to_string(i) + "]", a.rplFlags[i], b.rplFlags[i]);
+        for (size_t addr = 0; addr < a.memory.size(); ++addr)
+        {
+            if (a.memory[addr] == b.memory[addr])
+                continue;
+            char name[16];
+            std::snprintf(name, sizeof name, "mem[%03zX]", addr);
+            add(name, a.memory[addr], b.memory[addr]);
+        }
+        for (size_t w = 0; w < a.gfx.size(); ++w)
+        {
+            if (a.gfx[w] != b.gfx[w])
+            {
+                add("screen row " + std::to_string(w / 2), 0, 1);
+                break;
+            }
+        }
+        if (listed > 6)
+            out += ", ...";
+        return out;
+    }
+
+    // Same inputs for both backends: every 6 frames one key goes down or
+    // the held one comes up, picked from the seed
+    void applyKeys(Backend &a, Backend &b, uint64_t seed, long long frame)
+    {
+        if (frame % 6 != 0)
+            return;
+        uint64_t z = seed + static_cast<uint64_t>(frame / 12) * 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        int key = static_cast<int>((z ^ (z >> 31)) & 0xF);
+        bool pressed = frame % 12 == 0;
+        a.setKey(key, pressed);
+        b.setKey(key, pressed);
+    }
+
+    // Backends agreed at their marks and disagree after count more
+    // instructions; step both from the marks to find the first one
+    std::string narrow(Backend &a, Backend &b, int count, uint64_t executed, long long frame)
+    {
+        State sa, sb;
+        a.rewind();
+        b.rewind();
+        for (int i = 0; i < count; ++i)
+        {
+            a.capture(sa);
+            uint16_t pc = sa.PC;
+            uint16_t opcode = static_cast<uint16_t>((sa.memory[pc & 0xFFF] << 8) | sa.memory[(pc + 1) & 0xFFF]);
+            a.run(1);
+            b.run(1);
+            a.capture(sa);
+            b.capture(sb);
+            if (!same(sa, sb))
+            {
+                char where[96];
+                std::snprintf(where, sizeof where, "frame %lld, instruction %llu, %03X %04X %s: ", frame,
+                              static_cast<unsigned long long>(executed + i), pc, opcode,
+                              Chip8Disassembler::text(opcode).c_str());
+                return where + differences(sa, sb);
+            }
+        }
+
+        // Only shows when the backends run several instructions at once
+        a.rewind();
+        b.rewind();
+        a.run(count);
+        b.run(count);
+        a.capture(sa);
+        b.capture(sb);
+        char where[96];
+        std::snprintf(where, sizeof where, "frame %lld, within %d instructions of %llu, not when single-stepped: ",
+                      frame, count, static_cast<unsigned long long>(executed));
+        return where + differences(sa, sb);
+    }
+
+    void compareRom(const Options &opt, const std::string &path, Result &result)
+    {
+        std::shared_ptr<const RomCache::Image> image = RomCache::shared().get(path);
+        std::unique_ptr<Backend> a = makeBackend(opt.first);
+        std::unique_ptr<Backend> b = makeBackend(opt.second);
+        if (!image || !a->load(image->data(), image->size(), opt.seed) ||
+            !b->load(image->data(), image->size(), opt.seed))
+            return;
+        result.loaded = true;
+
+        State sa, sb;
+        uint64_t executed = 0;
+        for (long long frame = 0; frame < opt.frames && !result.diverged; ++frame)
+        {
+            applyKeys(*a, *b, opt.seed, frame);
+            for (int done = 0; done < opt.ipf;)
+            {
+                int count = std::min(opt.every, opt.ipf - done);
+                a->mark();
+                b->mark();
+                a->run(count);
+                b->run(count);
+                a->capture(sa);
+                b->capture(sb);
+                if (!same(sa, sb))
+                {
+                    result.diverged = true;
+                    result.report = narrow(*a, *b, count, executed, frame);
+                    break;
+                }
+                done += count;
+                executed += count;
+            }
+            a->tick();
+            b->tick();
+        }
+    }
+
+    void usage()
+    {
+        std::fprintf(stderr, "usage: chip8-diff [--cores A,B] [--every K] [--frames N] [--ipf N] [--threads N] "
+                             "[--seed N] <rom files or folders...>\n");
+    }
+
+    bool parseBackend(const std::string &name, BackendConfig &config)
+    {
+        for (const BackendConfig &known : knownBackends)
+        {
+            if (name == known.name)
+            {
+                config = known;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool parseCores(const std::string &list, Options &opt)
+    {
+        size_t comma = list.find(',');
+        return comma != std::string::npos && parseBackend(list.substr(0, comma), opt.first) &&
+               parseBackend(list.substr(comma + 1), opt.second);
+    }
+
+    void collectRoms(const fs::path &path, std::vector<std::string> &roms)
+    {
+        std::error_code ec;
+        if (!fs::is_directory(path, ec))
+        {
+            roms.push_back(path.string());
+            return;
+        }
+        for (const fs::directory_entry &entry : fs::directory_iterator(path, ec))
+        {
+            std::string ext = entry.path().extension().string();
+            if (entry.is_regular_file() && (ext == ".ch8" || ext == ".rom"))
+                roms.push_back(entry.path().string());
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    std::vector<std::string> roms;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--every" && hasValue)
+            opt.every = std::atoi(argv[++i]);
+        else if (arg == "--frames" && hasValue)
+            opt.frames = std::atoll(argv[++i]);
+        else if (arg == "--ipf" && hasValue)
+            opt.ipf = std::atoi(argv[++i]);
+        else if (arg == "--threads" && hasValue)
+            opt.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (arg == "--seed" && hasValue)
+            opt.seed = std::strtoull(argv[++i], nullptr, 0);
+        else if (arg == "--cores" && hasValue)
+        {
+            if (!parseCores(argv[++i], opt))
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if (arg[0] != '-')
+            collectRoms(arg, roms);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (roms.empty() || opt.every <= 0 || opt.ipf <= 0 || opt.frames < 0)
+    {
+        usage();
+        return 1;
+    }
+
+    std::vector<Result> results(roms.size());
+    ThreadPool pool(opt.threads);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < roms.size(); ++r)
+        pool.submit([&, r]
+                    { compareRom(opt, roms[r], results[r]); });
+    pool.wait();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int divergent = 0;
+    int failures = 0;
+    for (size_t r = 0; r < roms.size(); ++r)
+    {
+        const Result &result = results[r];
+        failures += result.loaded ? 0 : 1;
+        divergent += result.diverged ? 1 : 0;
+        const char *status = !result.loaded ? "LOAD FAILED" : result.diverged ? "DIVERGED" : "ok";
+        std::printf("%-11s %s\n", status, roms[r].c_str());
+        if (result.diverged)
+            std::printf("            %s\n", result.report.c_str());
+    }
+    std::printf("\n%s vs %s on %zu ROMs, compared every %d instructions, in %.3f s on %u threads\n",
+                opt.first.name, opt.second.name, roms.size(), opt.every, wall, pool.size());
+    std::printf("%d ROMs diverged, %d load failures\n", divergent, failures);
+    return (failures || divergent) ? 1 : 0;
+}
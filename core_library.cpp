@@ -0,0 +1,114 @@
+#include "core_library.h"
+#include <utility> // For std::exchange
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+namespace
+{
+    void *openLibrary(const std::string &path, std::string &error)
+    {
+#if defined(_WIN32)
+        const int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+        std::wstring wide(length > 0 ? length - 1 : 0, L'\0');
+        MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, wide.data(), length);
+        void *library = reinterpret_cast<void *>(LoadLibraryW(wide.c_str()));
+        if (!library)
+            error = "Can't load " + path + " (error " + std::to_string(GetLastError()) + ")";
+        return library;
+#else
+        void *library = dlopen(path.c_str(), RTLD_NOW | RTLD_LOCAL);
+        if (!library)
+            error = dlerror();
+        return library;
+#endif
+    }
+
+    void *lookup(void *library, const char *name)
+    {
+#if defined(_WIN32)
+        return reinterpret_cast<void *>(GetProcAddress(static_cast<HMODULE>(library), name));
+#else
+        return dlsym(library, name);
+#endif
+    }
+
+    void closeLibrary(void *library)
+    {
+#if defined(_WIN32)
+        FreeLibrary(static_cast<HMODULE>(library));
+#else
+        dlclose(library);
+#endif
+    }
+}
+
+CoreLibrary::CoreLibrary(CoreLibrary &&other) noexcept
+    : handle(std::exchange(other.handle, nullptr)), functions(std::exchange(other.functions, Api())), opened(std::move(other.opened))
+{
+}
+
+CoreLibrary &CoreLibrary::operator=(CoreLibrary &&other) noexcept
+{
+    if (this != &other)
+    {
+        close();
+        handle = std::exchange(other.handle, nullptr);
+        functions = std::exchange(other.functions, Api());
+        opened = std::move(other.opened);
+    }
+    return *this;
+}
+
+bool CoreLibrary::open(const std::string &path, std::string &error)
+{
+    close();
+    void *library = openLibrary(path, error);
+    if (!library)
+        return false;
+    Api found;
+#define CORE_LIBRARY_LOOKUP(name)                                                \
+    found.name = reinterpret_cast<decltype(found.name)>(lookup(library, #name)); \
+    if (!found.name)                                                             \
+    {                                                                            \
+        error = path + " has no " #name;                                         \
+        closeLibrary(library);                                                   \
+        return false;                                                            \
+    }
+    CORE_LIBRARY_FUNCTIONS(CORE_LIBRARY_LOOKUP)
+#undef CORE_LIBRARY_LOOKUP
+#define CORE_LIBRARY_LOOKUP_LATER(name) found.name = reinterpret_cast<decltype(found.name)>(lookup(library, #name));
+    CORE_LIBRARY_LATER_FUNCTIONS(CORE_LIBRARY_LOOKUP_LATER)
+#undef CORE_LIBRARY_LOOKUP_LATER
+    if (found.chip8core_abi_version() != CHIP8CORE_ABI_VERSION)
+    {
+        error = path + " has chip8core ABI version " + std::to_string(found.chip8core_abi_version()) + ", not " +
+                std::to_string(CHIP8CORE_ABI_VERSION);
+        closeLibrary(library);
+        return false;
+    }
+    handle = library;
+    functions = found;
+    opened = path;
+    return true;
+}
+
+chip8core *CoreLibrary::create(int variant, int ipf, int backend) const
+{
+    if (!handle)
+        return nullptr;
+    if (functions.chip8core_create_backend)
+        return functions.chip8core_create_backend(variant, ipf, backend);
+    return backend == CHIP8CORE_TABLE ? functions.chip8core_create(variant, ipf) : nullptr;
+}
+
+void CoreLibrary::close()
+{
+    if (handle)
+        closeLibrary(handle);
+    handle = nullptr;
+    functions = Api();
+    opened.clear();
+}
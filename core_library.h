@@ -0,0 +1,72 @@
+#ifndef CORE_LIBRARY_H
+#define CORE_LIBRARY_H
+
+#include "chip8core.h"
+#include <string> // For paths and errors
+
+// Every chip8core.h call a loaded library has to export
+#define CORE_LIBRARY_FUNCTIONS(X) \
+    X(chip8core_abi_version)      \
+    X(chip8core_create)           \
+    X(chip8core_destroy)          \
+    X(chip8core_load_rom)         \
+    X(chip8core_reset)            \
+    X(chip8core_seed_random)      \
+    X(chip8core_run_frames)       \
+    X(chip8core_set_keys)         \
+    X(chip8core_framebuffer)      \
+    X(chip8core_planes)           \
+    X(chip8core_width)            \
+    X(chip8core_height)           \
+    X(chip8core_sound_on)         \
+    X(chip8core_snapshot_size)    \
+    X(chip8core_snapshot_save)    \
+    X(chip8core_snapshot_load)
+
+// Calls added since ABI version 1, null in libraries from before them
+#define CORE_LIBRARY_LATER_FUNCTIONS(X) \
+    X(chip8core_create_backend)
+
+// A chip8core library (chip8core.dll, libchip8core.so or a build of it
+// under another name) opened at run time instead of linked, so a tool can
+// hold several builds side by side and run them on the same ROM. Every
+// call is looked up when the library opens; one without all of version
+// 1's, or with another CHIP8CORE_ABI_VERSION, is refused. Machines
+// created through a library must be destroyed before it closes.
+class CoreLibrary
+{
+public:
+    struct Api
+    {
+#define CORE_LIBRARY_POINTER(name) decltype(&::name) name = nullptr;
+        CORE_LIBRARY_FUNCTIONS(CORE_LIBRARY_POINTER)
+        CORE_LIBRARY_LATER_FUNCTIONS(CORE_LIBRARY_POINTER)
+#undef CORE_LIBRARY_POINTER
+    };
+
+    CoreLibrary() = default;
+    ~CoreLibrary() { close(); }
+    CoreLibrary(const CoreLibrary &) = delete;
+    CoreLibrary &operator=(const CoreLibrary &) = delete;
+    CoreLibrary(CoreLibrary &&other) noexcept;
+    CoreLibrary &operator=(CoreLibrary &&other) noexcept;
+
+    // False with the reason in error, and nothing open
+    bool open(const std::string &path, std::string &error);
+    void close();
+    bool isOpen() const { return handle != nullptr; }
+
+    const Api &api() const { return functions; }
+
+    // A machine on backend, one of chip8core_backend; a library without
+    // chip8core_create_backend only has the table core. NULL if it can't.
+    chip8core *create(int variant, int ipf, int backend) const;
+    const std::string &path() const { return opened; }
+
+private:
+    void *handle = nullptr;
+    Api functions;
+    std::string opened;
+};
+
+#endif
@@ -0,0 +1,261 @@
+#include "d3d11_screen_renderer.h"
+#if defined(_WIN32)
+#include <d3d11.h>
+#include <d3dcompiler.h>
+#include <dxgi1_2.h>
+#include <cstring> // For std::strlen
+
+namespace
+{
+    // A strip over the whole target from SV_VertexID, no vertex buffer.
+    // Rows are two 64-bit words with the leftmost pixel in the top bit;
+    // as 32-bit texels the halves of each word swap, hence group ^ 1.
+    const char *shaderSource = R"(
+Texture2D<uint> screen : register(t0);
+cbuffer Params : register(b0)
+{
+    float2 extent;
+    float2 unused;
+    float4 off;
+    float4 on;
+};
+struct Vertex
+{
+    float4 position : SV_Position;
+    float2 uv : TEXCOORD0;
+};
+Vertex vs(uint id : SV_VertexID)
+{
+    Vertex v;
+    v.uv = float2(id & 1, id >> 1);
+    v.position = float4(v.uv.x * 2.0 - 1.0, 1.0 - v.uv.y * 2.0, 0.0, 1.0);
+    return v;
+}
+float4 ps(Vertex v) : SV_Target
+{
+    int2 p = min(int2(v.uv * extent), int2(extent) - 1);
+    uint bits = screen.Load(int3((p.x >> 5) ^ 1, p.y, 0));
+    return ((bits >> (31 - (p.x & 31))) & 1) ? on : off;
+}
+)";
+
+    struct Params
+    {
+        float extent[2];
+        float unused[2];
+        float off[4];
+        float on[4];
+    };
+
+    template <typename T>
+    void release(T *&object)
+    {
+        if (object)
+        {
+            object->Release();
+            object = nullptr;
+        }
+    }
+
+    ID3DBlob *compile(const char *entry, const char *profile)
+    {
+        ID3DBlob *code = nullptr;
+        ID3DBlob *errors = nullptr;
+        HRESULT hr = D3DCompile(shaderSource, std::strlen(shaderSource), "screen", nullptr, nullptr, entry, profile,
+                                D3DCOMPILE_OPTIMIZATION_LEVEL3, 0, &code, &errors);
+        release(errors);
+        return SUCCEEDED(hr) ? code : nullptr;
+    }
+}
+
+D3D11ScreenRenderer::D3D11ScreenRenderer(void *windowHandle)
+    : window(windowHandle)
+{
+}
+
+D3D11ScreenRenderer::~D3D11ScreenRenderer()
+{
+    // A swap chain can't be released while it holds the monitor
+    if (exclusive)
+        swapChain->SetFullscreenState(FALSE, nullptr);
+    if (context)
+        context->ClearState();
+    release(constants);
+    release(screenView);
+    release(screen);
+    release(pixelShader);
+    release(vertexShader);
+    release(target);
+    release(swapChain);
+    release(context);
+    release(device);
+}
+
+bool D3D11ScreenRenderer::init()
+{
+    // Shader model 4 covers integer loads, so 10.0 hardware is enough
+    const D3D_FEATURE_LEVEL levels[] = {D3D_FEATURE_LEVEL_11_0, D3D_FEATURE_LEVEL_10_1, D3D_FEATURE_LEVEL_10_0};
+    if (FAILED(D3D11CreateDevice(nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, D3D11_CREATE_DEVICE_BGRA_SUPPORT,
+                                 levels, 3, D3D11_SDK_VERSION, &device, nullptr, &context)))
+        return false;
+
+    IDXGIDevice1 *dxgiDevice = nullptr;
+    IDXGIAdapter *adapter = nullptr;
+    IDXGIFactory2 *factory = nullptr;
+    bool found = SUCCEEDED(device->QueryInterface(__uuidof(IDXGIDevice1), reinterpret_cast<void **>(&dxgiDevice))) &&
+                 SUCCEEDED(dxgiDevice->GetAdapter(&adapter)) &&
+                 SUCCEEDED(adapter->GetParent(__uuidof(IDXGIFactory2), reinterpret_cast<void **>(&factory)));
+    if (found)
+    {
+        // Present blocks once a frame is queued: the lowest latency vsync allows
+        dxgiDevice->SetMaximumFrameLatency(1);
+
+        DXGI_SWAP_CHAIN_DESC1 desc{};
+        desc.Format = DXGI_FORMAT_B8G8R8A8_UNORM;
+        desc.SampleDesc.Count = 1;
+        desc.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+        desc.BufferCount = 2;
+        desc.Scaling = DXGI_SCALING_STRETCH;
+        desc.AlphaMode = DXGI_ALPHA_MODE_IGNORE;
+
+        // FLIP_DISCARD needs Windows 10, FLIP_SEQUENTIAL is the Windows 8 flip model
+        HWND hwnd = static_cast<HWND>(window);
+        desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+        if (FAILED(factory->CreateSwapChainForHwnd(device, hwnd, &desc, nullptr, nullptr, &swapChain)))
+        {
+            desc.SwapEffect = DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL;
+            if (FAILED(factory->CreateSwapChainForHwnd(device, hwnd, &desc, nullptr, nullptr, &swapChain)))
+                swapChain = nullptr;
+        }
+        if (swapChain)
+            factory->MakeWindowAssociation(hwnd, DXGI_MWA_NO_ALT_ENTER);
+    }
+    release(factory);
+    release(adapter);
+    release(dxgiDevice);
+    if (!swapChain || !createTarget())
+        return false;
+
+    ID3DBlob *vertexCode = compile("vs", "vs_4_0");
+    ID3DBlob *pixelCode = compile("ps", "ps_4_0");
+    bool built = vertexCode && pixelCode &&
+                 SUCCEEDED(device->CreateVertexShader(vertexCode->GetBufferPointer(), vertexCode->GetBufferSize(), nullptr, &vertexShader)) &&
+                 SUCCEEDED(device->CreatePixelShader(pixelCode->GetBufferPointer(), pixelCode->GetBufferSize(), nullptr, &pixelShader));
+    release(vertexCode);
+    release(pixelCode);
+    if (!built)
+        return false;
+
+    // 128x64 pixels as 4x64 32-bit texels
+    D3D11_TEXTURE2D_DESC textureDesc{};
+    textureDesc.Width = 4;
+    textureDesc.Height = 64;
+    textureDesc.MipLevels = 1;
+    textureDesc.ArraySize = 1;
+    textureDesc.Format = DXGI_FORMAT_R32_UINT;
+    textureDesc.SampleDesc.Count = 1;
+    textureDesc.Usage = D3D11_USAGE_DEFAULT;
+    textureDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    if (FAILED(device->CreateTexture2D(&textureDesc, nullptr, &screen)) ||
+        FAILED(device->CreateShaderResourceView(screen, nullptr, &screenView)))
+        return false;
+
+    D3D11_BUFFER_DESC bufferDesc{};
+    bufferDesc.ByteWidth = sizeof(Params);
+    bufferDesc.Usage = D3D11_USAGE_DEFAULT;
+    bufferDesc.BindFlags = D3D11_BIND_CONSTANT_BUFFER;
+    if (FAILED(device->CreateBuffer(&bufferDesc, nullptr, &constants)))
+        return false;
+
+    stale = true;
+    return true;
+}
+
+bool D3D11ScreenRenderer::createTarget()
+{
+    ID3D11Texture2D *backBuffer = nullptr;
+    if (FAILED(swapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), reinterpret_cast<void **>(&backBuffer))))
+        return false;
+    HRESULT hr = device->CreateRenderTargetView(backBuffer, nullptr, &target);
+    D3D11_TEXTURE2D_DESC desc;
+    backBuffer->GetDesc(&desc);
+    width = static_cast<int>(desc.Width);
+    height = static_cast<int>(desc.Height);
+    release(backBuffer);
+    return SUCCEEDED(hr);
+}
+
+void D3D11ScreenRenderer::resize(int newWidth, int newHeight)
+{
+    if (!swapChain || newWidth <= 0 || newHeight <= 0 || (newWidth == width && newHeight == height))
+        return;
+
+    // The buffers can only be resized with no views onto them left
+    context->OMSetRenderTargets(0, nullptr, nullptr);
+    release(target);
+    if (SUCCEEDED(swapChain->ResizeBuffers(0, static_cast<UINT>(newWidth), static_cast<UINT>(newHeight), DXGI_FORMAT_UNKNOWN, 0)))
+        createTarget();
+}
+
+void D3D11ScreenRenderer::upload(const Framebuffer &gfx)
+{
+    if (!stale && gfx == uploaded)
+        return;
+    uploaded = gfx;
+    stale = false;
+    context->UpdateSubresource(screen, 0, nullptr, uploaded.data(), 4 * sizeof(uint32_t), 0);
+}
+
+void D3D11ScreenRenderer::draw(bool hires, const Color &off, const Color &on, bool)
+{
+    if (!target)
+        return;
+
+    Params params = {{hires ? 128.0f : 64.0f, hires ? 64.0f : 32.0f}, {0.0f, 0.0f},
+                     {off[0], off[1], off[2], 1.0f}, {on[0], on[1], on[2], 1.0f}};
+    context->UpdateSubresource(constants, 0, nullptr, &params, 0, 0);
+
+    D3D11_VIEWPORT viewport = {0.0f, 0.0f, static_cast<float>(width), static_cast<float>(height), 0.0f, 1.0f};
+    if (integerScale)
+    {
+        const float black[4] = {0.0f, 0.0f, 0.0f, 1.0f};
+        context->ClearRenderTargetView(target, black);
+        const Viewport picture = integerViewport(width, height, hires);
+        viewport = {static_cast<float>(picture.x), static_cast<float>(picture.y), static_cast<float>(picture.width),
+                    static_cast<float>(picture.height), 0.0f, 1.0f};
+    }
+    context->OMSetRenderTargets(1, &target, nullptr);
+    context->RSSetViewports(1, &viewport);
+    context->IASetInputLayout(nullptr);
+    context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+    context->VSSetShader(vertexShader, nullptr, 0);
+    context->PSSetShader(pixelShader, nullptr, 0);
+    context->PSSetShaderResources(0, 1, &screenView);
+    context->PSSetConstantBuffers(0, 1, &constants);
+    context->Draw(4, 0);
+}
+
+bool D3D11ScreenRenderer::setExclusive(bool on)
+{
+    if (!swapChain || on == exclusive)
+        return exclusive;
+    if (FAILED(swapChain->SetFullscreenState(on ? TRUE : FALSE, nullptr)))
+        return false;
+    exclusive = on;
+    return exclusive;
+}
+
+bool D3D11ScreenRenderer::present()
+{
+    HRESULT hr = swapChain->Present(1, 0);
+    hidden = hr == DXGI_STATUS_OCCLUDED;
+    return hr != DXGI_ERROR_DEVICE_REMOVED && hr != DXGI_ERROR_DEVICE_RESET;
+}
+
+bool D3D11ScreenRenderer::occluded()
+{
+    if (hidden)
+        hidden = swapChain->Present(0, DXGI_PRESENT_TEST) == DXGI_STATUS_OCCLUDED;
+    return hidden;
+}
+#endif
@@ -0,0 +1,70 @@
+#ifndef D3D11_SCREEN_RENDERER_H
+#define D3D11_SCREEN_RENDERER_H
+
+#include "screen_backend.h"
+
+struct ID3D11Device;
+struct ID3D11DeviceContext;
+struct ID3D11RenderTargetView;
+struct ID3D11VertexShader;
+struct ID3D11PixelShader;
+struct ID3D11Texture2D;
+struct ID3D11ShaderResourceView;
+struct ID3D11Buffer;
+struct IDXGISwapChain1;
+
+// Direct3D 11 backend for Windows. Presents through a flip-model swap
+// chain with a frame latency of one, so frames skip the compositor's extra
+// copy and input reaches the screen a frame sooner than with blt-model GL.
+// The screen words go into an R32_UINT texture and the pixel shader maps
+// bits to the palette, as in the GL 3.3 renderer. No effects.
+class D3D11ScreenRenderer : public ScreenBackend
+{
+public:
+    explicit D3D11ScreenRenderer(void *windowHandle);
+    ~D3D11ScreenRenderer() override;
+
+    D3D11ScreenRenderer(const D3D11ScreenRenderer &) = delete;
+    D3D11ScreenRenderer &operator=(const D3D11ScreenRenderer &) = delete;
+
+    bool init() override;
+    const char *name() const override { return "Direct3D 11"; }
+
+    void resize(int width, int height) override;
+    void upload(const Framebuffer &gfx) override;
+    void draw(bool hires, const Color &off, const Color &on, bool newFrame) override;
+    void setIntegerScale(bool on) override { integerScale = on; }
+
+    // DXGI's exclusive mode at the desktop's resolution and refresh rate;
+    // the canvas gets a WM_SIZE and resizes the buffers to match
+    bool setExclusive(bool on) override;
+
+    // Waits for the next refresh, which paces the canvas like GL vsync
+    bool present() override;
+
+    // Present said nothing would be seen; a test present checks again
+    bool occluded() override;
+
+private:
+    bool createTarget();
+
+    void *window;
+    ID3D11Device *device = nullptr;
+    ID3D11DeviceContext *context = nullptr;
+    IDXGISwapChain1 *swapChain = nullptr;
+    ID3D11RenderTargetView *target = nullptr;
+    ID3D11VertexShader *vertexShader = nullptr;
+    ID3D11PixelShader *pixelShader = nullptr;
+    ID3D11Texture2D *screen = nullptr;
+    ID3D11ShaderResourceView *screenView = nullptr;
+    ID3D11Buffer *constants = nullptr;
+    int width = 0;
+    int height = 0;
+    Framebuffer uploaded{};
+    bool stale = true; // Texture contents undefined until the first upload
+    bool integerScale = false;
+    bool exclusive = false;
+    bool hidden = false; // The last present returned DXGI_STATUS_OCCLUDED
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "emulation_scheduler.h"
+#include "emulation_thread.h"
+#include "thread_tuning.h"
+#include <algorithm> // For std::find and std::clamp
+#include <chrono>    // For the frame clock
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <mmsystem.h> // For timeBeginPeriod, the fallback
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#endif
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::duration maxLag = EmulationThread::framePeriod * 4; // Further behind than this, stop catching up
+
+    // Sleeps the clock thread most of the way to a deadline, then yields
+    // until it. Windows' default sleep rounds up to the 15.6 ms system tick,
+    // so there it sleeps on a high-resolution waitable timer (Windows 10
+    // 1803 on), or on an ordinary one with the tick raised to 1 ms before
+    // that. The yielding window follows how late the sleeps have woken, so
+    // frames start within a fraction of a millisecond of their deadline
+    // without spinning through more of the frame than the timer needs.
+    class Pacer
+    {
+    public:
+        Pacer()
+        {
+#if defined(_WIN32)
+            timer = CreateWaitableTimerExW(nullptr, nullptr, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+            if (!timer)
+            {
+                timer = CreateWaitableTimerExW(nullptr, nullptr, 0, TIMER_ALL_ACCESS);
+                raisedResolution = timeBeginPeriod(1) == TIMERR_NOERROR;
+            }
+#endif
+        }
+
+        ~Pacer()
+        {
+#if defined(_WIN32)
+            if (timer)
+                CloseHandle(timer);
+            if (raisedResolution)
+                timeEndPeriod(1);
+#endif
+        }
+
+        Pacer(const Pacer &) = delete;
+        Pacer &operator=(const Pacer &) = delete;
+
+        void waitUntil(Clock::time_point deadline)
+        {
+            const Clock::time_point wake = deadline - spinWindow;
+            if (wake > Clock::now())
+            {
+                sleepUntil(wake);
+                // Average lateness over the last few frames; twice that,
+                // within bounds, covers nearly every wake-up
+                const Clock::duration late = std::max(Clock::now() - wake, Clock::duration::zero());
+                lateness += (late - lateness) / 8;
+                spinWindow = std::clamp<Clock::duration>(lateness * 2 + std::chrono::microseconds(250), minSpin, maxSpin);
+            }
+            while (Clock::now() < deadline)
+                std::this_thread::yield();
+        }
+
+    private:
+        void sleepUntil(Clock::time_point wake)
+        {
+#if defined(_WIN32)
+            if (timer)
+            {
+                // Relative, in 100 ns units
+                LARGE_INTEGER due;
+                due.QuadPart = -static_cast<LONGLONG>(std::chrono::duration_cast<std::chrono::nanoseconds>(wake - Clock::now()).count() / 100);
+                if (due.QuadPart < 0 && SetWaitableTimerEx(timer, &due, 0, nullptr, nullptr, nullptr, 0))
+                {
+                    WaitForSingleObject(timer, INFINITE);
+                    return;
+                }
+            }
+#endif
+            std::this_thread::sleep_until(wake);
+        }
+
+        static constexpr Clock::duration minSpin = std::chrono::microseconds(250);
+        static constexpr Clock::duration maxSpin = std::chrono::milliseconds(2);
+        Clock::duration spinWindow = maxSpin;
+        Clock::duration lateness = std::chrono::microseconds(500);
+#if defined(_WIN32)
+        HANDLE timer = nullptr;
+        bool raisedResolution = false;
+#endif
+    };
+}
+
+EmulationScheduler &EmulationScheduler::shared()
+{
+    static EmulationScheduler scheduler;
+    return scheduler;
+}
+
+EmulationScheduler::~EmulationScheduler()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_one();
+    if (clock.joinable())
+        clock.join();
+}
+
+void EmulationScheduler::add(EmulationThread &machine)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (std::find(machines.begin(), machines.end(), &machine) != machines.end())
+            return;
+        machines.push_back(&machine);
+        if (!pool)
+        {
+            pool = std::make_unique<ThreadPool>();
+            clock = std::thread(&EmulationScheduler::run, this);
+        }
+    }
+    changed.notify_one();
+}
+
+void EmulationScheduler::remove(EmulationThread &machine)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    machines.erase(std::remove(machines.begin(), machines.end(), &machine), machines.end());
+}
+
+void EmulationScheduler::run()
+{
+    Pacer pacer;
+    Clock::time_point next = Clock::now();
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping)
+    {
+        ThreadTuning::shared().apply(ThreadTuning::Role::Emulation);
+        if (machines.empty())
+        {
+            changed.wait(lock, [this]
+                         { return stopping || !machines.empty(); });
+            next = Clock::now();
+            continue;
+        }
+
+        // Every machine gets the same frame; the slowest one sets when it ends
+        next += EmulationThread::framePeriod;
+        for (EmulationThread *machine : machines)
+            pool->submit([machine, next]
+                         {
+                             ThreadTuning::shared().apply(ThreadTuning::Role::Emulation);
+                             machine->tick(next);
+                         });
+        pool->wait();
+
+        lock.unlock();
+        Clock::time_point now = Clock::now();
+        if (now - next > maxLag)
+            next = now;
+        pacer.waitUntil(next);
+        lock.lock();
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef EMULATION_SCHEDULER_H
+#define EMULATION_SCHEDULER_H
+
+#include "thread_pool.h"
+#include <condition_variable> // For waking the clock when machines arrive
+#include <memory>             // For the lazily created pool
+#include <mutex>              // For the machine list
+#include <thread>             // For the clock thread
+#include <vector>             // For the machine list
+
+class EmulationThread;
+
+// Steps every started EmulationThread once per 1/60 s frame on a shared
+// worker pool. One clock thread paces them all, so a wall of games costs
+// a worker per hardware thread instead of a thread per game, and games
+// waiting in FX0A take no worker at all.
+class EmulationScheduler
+{
+public:
+    static EmulationScheduler &shared();
+    ~EmulationScheduler();
+
+    EmulationScheduler(const EmulationScheduler &) = delete;
+    EmulationScheduler &operator=(const EmulationScheduler &) = delete;
+
+    void add(EmulationThread &machine);
+
+    // Returns once machine is no longer being stepped
+    void remove(EmulationThread &machine);
+
+private:
+    EmulationScheduler() = default;
+    void run();
+
+    std::mutex mutex; // Held through each frame, so remove() waits one out
+    std::condition_variable changed;
+    std::vector<EmulationThread *> machines;
+    std::unique_ptr<ThreadPool> pool; // Started with the first machine
+    std::thread clock;
+    bool stopping = false;
+};
+
+#endif
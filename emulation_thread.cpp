@@ -0,0 +1,725 @@
+#include "emulation_thread.h"
+#include "emulation_scheduler.h"
+#include "profile_zones.h"
+#include <algorithm> // For std::min
+#include <chrono>    // For the frame clock
+#include <cmath>     // For std::ceil and std::lround
+#include <filesystem> // For ROM file names in the event log
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const int unthrottledSlice = 10000; // Cycles between deadline checks when unthrottled
+}
+
+EmulationThread::EmulationThread(Chip8 &chip8Ref)
+    : chip8(chip8Ref)
+{
+}
+
+EmulationThread::~EmulationThread()
+{
+    stop();
+}
+
+void EmulationThread::start()
+{
+    if (started)
+        return;
+    started = true;
+    windowStart = Clock::now();
+    cycleBudget = 0;
+    EmulationScheduler::shared().add(*this);
+}
+
+void EmulationThread::stop()
+{
+    if (!started)
+        return;
+    started = false;
+    EmulationScheduler::shared().remove(*this);
+    sound.tone.store(false);
+}
+
+void EmulationThread::clearRewind()
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    history.clear();
+}
+
+void EmulationThread::loadROMAsync(const std::string &path, std::function<void(LoadResult)> done, bool keepState)
+{
+    uint64_t request;
+    {
+        std::lock_guard<std::mutex> lock(pendingLoad->mutex);
+        request = ++pendingLoad->latest;
+        pendingLoad->ready = false;
+        pendingLoad->image.reset();
+        pendingLoad->keepState = keepState;
+        pendingLoad->path = path;
+        pendingLoad->requested = Clock::now();
+        pendingLoad->done = std::move(done);
+    }
+    std::weak_ptr<PendingLoad> slot = pendingLoad;
+    RomCache::shared().getAsync(path, [slot, request](std::shared_ptr<const RomCache::Image> image)
+                                {
+                                    std::shared_ptr<PendingLoad> pending = slot.lock();
+                                    if (!pending)
+                                        return;
+                                    std::lock_guard<std::mutex> lock(pending->mutex);
+                                    if (pending->latest != request)
+                                        return;
+                                    pending->image = std::move(image);
+                                    pending->ready = true; });
+}
+
+// A ROM the I/O thread has read, at the start of a frame
+void EmulationThread::installPendingLoad()
+{
+    std::shared_ptr<const RomCache::Image> image;
+    std::function<void(LoadResult)> done;
+    bool keepState;
+    std::string path;
+    Clock::time_point requested;
+    {
+        std::lock_guard<std::mutex> lock(pendingLoad->mutex);
+        if (!pendingLoad->ready)
+            return;
+        pendingLoad->ready = false;
+        image = std::move(pendingLoad->image);
+        done = std::move(pendingLoad->done);
+        keepState = pendingLoad->keepState;
+        path = std::move(pendingLoad->path);
+        requested = pendingLoad->requested;
+    }
+    LoadResult result = LoadResult::Failed;
+    {
+        CHIP8_ZONE("ROM install");
+        std::lock_guard<std::mutex> lock(coreMutex);
+        if (image && keepState && chip8.patchROM(image->data(), image->size()))
+            result = LoadResult::Patched;
+        else if (image && chip8.loadROM(image->data(), image->size()))
+            result = LoadResult::Loaded;
+        history.setBoot(chip8.state()); // Rewinding would bring back the old code
+    }
+    if (EventLog::shared().isOpen())
+    {
+        const auto micros = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - requested).count();
+        EventLog::shared().record(EventLog::Kind::RomLoad, micros, image ? static_cast<int64_t>(image->size()) : 0, static_cast<int64_t>(result),
+                                  std::filesystem::u8path(path).filename().u8string().c_str());
+    }
+    if (done)
+        done(result);
+}
+
+bool EmulationThread::startRecording(const std::string &romPath, uint64_t seed)
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    if (netplaying.load())
+        return false; // Reloading would split the two sides
+    recording.store(false);
+    history.clear();
+    if (!chip8.loadROM(romPath))
+        return false;
+    chip8.seedRandom(seed);
+    history.setBoot(chip8.state());
+
+    movie = Movie();
+    movie.seed = seed;
+    movie.imageHash = Movie::hashImage(chip8);
+    movie.addKeyframe(chip8);
+    recording.store(true);
+    return true;
+}
+
+bool EmulationThread::stopRecording(const std::string &moviePath)
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    if (!recording.exchange(false))
+        return false;
+    movie.endCycle = chip8.getCycleCount();
+    movie.endHash = chip8.stateHash();
+    return movie.save(moviePath);
+}
+
+#if defined(CHIP8_LUA)
+bool EmulationThread::loadScript(const std::string &path, int budget, std::string &error)
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    script.setBudget(budget);
+    scriptStopped.clear();
+    const bool loaded = script.load(path, chip8, error);
+    if (script.touchedMachine())
+        debugger.clearHistory();
+    return loaded;
+}
+
+void EmulationThread::stopScript()
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    script.unload();
+}
+
+bool EmulationThread::hasScript()
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    return script.isLoaded();
+}
+
+std::vector<std::string> EmulationThread::takeScriptOutput()
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    std::vector<std::string> lines = script.takeOutput();
+    if (!scriptStopped.empty())
+        lines.push_back(std::move(scriptStopped));
+    scriptStopped.clear();
+    return lines;
+}
+#endif
+
+bool EmulationThread::startNetplay(const std::string &romPath, uint64_t seed, std::unique_ptr<NetplaySession> session)
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    if (recording.load() || !chip8.loadROM(romPath))
+        return false;
+    if (netplay)
+        netplay->disconnect();
+    history.setBoot(chip8.state());
+
+    // Both sides need the same instructions per frame, the host's are used
+    const double hz = clockHz.load(std::memory_order_relaxed);
+    netplayOffer.seed = seed;
+    netplayOffer.imageHash = Movie::hashImage(chip8);
+    if (vipTiming.load(std::memory_order_relaxed))
+        netplayOffer.cyclesPerFrame = 0;
+    else
+        netplayOffer.cyclesPerFrame = hz > 0 ? std::max(1, static_cast<int>(std::lround(hz / 60))) : 1000000 / 60;
+    netplayRom = romPath;
+    netplayKeys = 0;
+    netplay = std::move(session);
+    netplaying.store(true);
+    return true;
+}
+
+void EmulationThread::stopNetplay()
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    netplaying.store(false);
+    if (netplay)
+        netplay->disconnect();
+    netplay.reset();
+}
+
+bool EmulationThread::startFrameShare(const std::string &name)
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    bool created = frameShare.create(name);
+    sharingFrames.store(created);
+    return created;
+}
+
+void EmulationThread::stopFrameShare()
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    sharingFrames.store(false);
+    frameShare.close();
+}
+
+bool EmulationThread::startVideo(const std::string &path)
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    bool opened = video.start(path);
+    videoStart = Clock::now();
+    videoTone = false;
+    recordingVideo.store(opened);
+    return opened;
+}
+
+bool EmulationThread::stopVideo()
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    recordingVideo.store(false);
+    return video.stop();
+}
+
+void EmulationThread::debugStep()
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    const uint64_t before = chip8.getCycleCount();
+    debugger.step(chip8);
+    instructionsRun += chip8.getCycleCount() - before;
+    publishFrame();
+}
+
+bool EmulationThread::debugStepBack()
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    if (!debugger.stepBack(chip8))
+        return false;
+    publishSound();
+    publishFrame();
+    return true;
+}
+
+bool EmulationThread::debugRunBack()
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    if (!debugger.runBack(chip8))
+        return false;
+    publishSound();
+    publishFrame();
+    return true;
+}
+
+bool EmulationThread::postKey(int key, bool pressed)
+{
+    return keyEvents.push({Clock::now(), static_cast<uint8_t>(key & 0xF), pressed});
+}
+
+bool EmulationThread::postRawKey(int key, bool pressed)
+{
+    return rawKeyEvents.push({Clock::now(), static_cast<uint8_t>(key & 0xF), pressed});
+}
+
+void EmulationThread::setGamepad(bool enabled, const GamepadProfile &profile)
+{
+    std::lock_guard<std::mutex> lock(coreMutex);
+    gamepadEnabled = enabled;
+    gamepadProfile = profile;
+}
+
+// Controller keys that went down or up since the last poll
+uint16_t EmulationThread::gamepadChanges()
+{
+    const uint16_t held = gamepadEnabled ? Gamepads::shared().keys(gamepadProfile) : 0;
+    const uint16_t changed = held ^ gamepadKeys;
+    gamepadKeys = held;
+    return changed;
+}
+
+// The queue holding the oldest key event, nullptr if both are empty
+EmulationThread::KeyQueue *EmulationThread::nextKeyQueue()
+{
+    const KeyEvent *gui = keyEvents.front();
+    const KeyEvent *raw = rawKeyEvents.front();
+    if (!raw)
+        return gui ? &keyEvents : nullptr;
+    return !gui || raw->time < gui->time ? &rawKeyEvents : &keyEvents;
+}
+
+// Halted in FX0A with both timers stopped, frames would change nothing.
+// Recordings keep running so their timer ticks follow the wall clock.
+bool EmulationThread::haltedForKey()
+{
+    if (recording.load(std::memory_order_relaxed) || nextKeyQueue() != nullptr)
+        return false;
+    std::lock_guard<std::mutex> lock(coreMutex);
+    if (gamepadEnabled && Gamepads::shared().keys(gamepadProfile) != gamepadKeys)
+        return false;
+#if defined(CHIP8_LUA)
+    if (script.isLoaded())
+        return false;
+#endif
+    return chip8.isWaitingForKey() && chip8.getDelayTimer() == 0 && chip8.getSoundTimer() == 0;
+}
+
+// Runs cycles over the wall-clock window [frameStart, frameEnd). Key
+// events from that window land on the cycle proportional to their timestamp,
+// so presses shorter than a frame still reach the program. With vip set
+// the cycles are VIP machine cycles rather than instructions. With a clock
+// rate hz the timers tick in here, every hz / 60 instructions to the one.
+void EmulationThread::runFrame(int cycles, bool vip, double hz, Clock::time_point frameStart, Clock::time_point frameEnd)
+{
+    auto advance = [&](int count)
+    {
+        if (debugging.load(std::memory_order_relaxed))
+        {
+            // Nothing more runs this frame once the debugger stopped
+            if (!paused.load(std::memory_order_relaxed) && debugger.run(chip8, count, vip))
+            {
+                paused.store(true, std::memory_order_relaxed);
+                debugBreak.store(true, std::memory_order_relaxed);
+            }
+        }
+        else if (vip)
+            chip8.emulateVipCycles(count);
+        else
+            chip8.emulateCycles(count);
+    };
+
+    const uint64_t before = chip8.getCycleCount();
+    const double window = std::chrono::duration<double>(frameEnd - frameStart).count();
+    int done = 0;
+    // The PC sample, if taken, and the timer ticks split the run further.
+    // Ticks go by the machine's own count, which a debugger break stops.
+    int sampleAt = samplingPc.load(std::memory_order_relaxed) ? pcSampler.sampleOffset(cycles) : -1;
+    if (hz > 0 && (hz != tickHz || before != tickSeen))
+    {
+        // A new clock, or the machine was moved under us: restart the period
+        tickHz = hz;
+        tickAt = static_cast<double>(before) + hz / 60;
+    }
+    auto advanceTo = [&](int target)
+    {
+        while (done < target)
+        {
+            int stop = target;
+            if (sampleAt >= done && sampleAt < stop)
+                stop = sampleAt;
+            if (hz > 0)
+            {
+                const double due = std::ceil(tickAt) - static_cast<double>(chip8.getCycleCount());
+                if (due < stop - done)
+                    stop = done + std::max(0, static_cast<int>(due));
+            }
+            if (stop > done)
+                advance(stop - done);
+            done = stop;
+            if (sampleAt == done)
+            {
+                pcSampler.record(chip8.getPC());
+                sampleAt = -1;
+            }
+            for (; hz > 0 && static_cast<double>(chip8.getCycleCount()) >= std::ceil(tickAt); tickAt += hz / 60)
+                timerTick();
+        }
+    };
+    if (uint16_t changed = gamepadChanges())
+    {
+        for (int key = 0; key < 16; ++key)
+        {
+            if (!((changed >> key) & 1))
+                continue;
+            const bool pressed = (gamepadKeys >> key) & 1;
+            chip8.setKey(key, pressed);
+            if (debugging.load(std::memory_order_relaxed))
+                debugger.noteKey(chip8, key, pressed);
+            if (pressed && latency.isEnabled() && latency.keyPressed(frameStart, chip8.getCycleCount()))
+                chip8.watchKeyRead(key);
+            if (recording.load(std::memory_order_relaxed))
+                movie.events.push_back({chip8.getCycleCount(), static_cast<uint8_t>((pressed ? Movie::KeyDown : Movie::KeyUp) | key)});
+        }
+    }
+    KeyQueue *queue;
+    while ((queue = nextKeyQueue()) != nullptr && queue->front()->time <= frameEnd)
+    {
+        const KeyEvent *event = queue->front();
+        int at = 0;
+        if (window > 0 && event->time > frameStart)
+            at = static_cast<int>(cycles * std::chrono::duration<double>(event->time - frameStart).count() / window);
+        at = std::min(at, cycles);
+        if (at > done)
+            advanceTo(at);
+        chip8.setKey(event->key, event->pressed);
+        if (debugging.load(std::memory_order_relaxed))
+            debugger.noteKey(chip8, event->key, event->pressed);
+        if (event->pressed && latency.isEnabled() && latency.keyPressed(event->time, chip8.getCycleCount()))
+            chip8.watchKeyRead(event->key);
+        if (recording.load(std::memory_order_relaxed))
+            movie.events.push_back({chip8.getCycleCount(), static_cast<uint8_t>((event->pressed ? Movie::KeyDown : Movie::KeyUp) | event->key)});
+        queue->pop();
+    }
+    advanceTo(cycles);
+    tickSeen = chip8.getCycleCount();
+    instructionsRun += tickSeen - before;
+}
+
+// One 60 Hz tick of the delay and sound timers, call with coreMutex held
+void EmulationThread::timerTick()
+{
+    chip8.decrementTimers();
+    if (debugging.load(std::memory_order_relaxed))
+        debugger.noteTimerTick(chip8);
+    if (recording.load(std::memory_order_relaxed))
+        movie.tick(chip8);
+}
+
+// Emulates one 1/60 s frame including its timer tick. Unthrottled frames
+// run slices until the deadline, at least one.
+void EmulationThread::emulateFrame(double hz, bool vip, Clock::time_point deadline)
+{
+    CHIP8_ZONE("Emulate frame");
+    if (vip)
+    {
+        // The VIP's CPU time per frame is whatever the display leaves over
+        Clock::time_point windowEnd = Clock::now();
+        std::lock_guard<std::mutex> lock(coreMutex);
+        runFrame(Chip8::vipCyclesPerFrame - Chip8::vipDisplayCycles, true, 0, windowStart, windowEnd);
+        windowStart = windowEnd;
+    }
+    else if (hz > 0)
+    {
+        // Every frame is exactly 1/60 s of emulated time
+        cycleBudget += hz / 60;
+        int cycles = static_cast<int>(cycleBudget);
+        cycleBudget -= cycles;
+
+        Clock::time_point windowEnd = Clock::now();
+        std::lock_guard<std::mutex> lock(coreMutex);
+        runFrame(cycles, false, hz, windowStart, windowEnd);
+        windowStart = windowEnd;
+    }
+    else
+    {
+        // Release the core between slices so the GUI isn't held for a whole frame
+        do
+        {
+            Clock::time_point windowEnd = Clock::now();
+            std::lock_guard<std::mutex> lock(coreMutex);
+            runFrame(unthrottledSlice, false, 0, windowStart, windowEnd);
+            windowStart = windowEnd;
+        } while (Clock::now() < deadline);
+    }
+
+    // At a set clock the frame's cycles ticked the timers; VIP frames are
+    // one tick each, and unthrottled ones have no clock to go by
+    std::lock_guard<std::mutex> lock(coreMutex);
+    if (vip || hz <= 0)
+        timerTick();
+    if (!recording.load(std::memory_order_relaxed) && !cheats.empty())
+    {
+        // Writes the debugger's history can't replay
+        cheats.apply(chip8);
+        debugger.clearHistory();
+    }
+#if defined(CHIP8_LUA)
+    if (!recording.load(std::memory_order_relaxed) && script.isLoaded())
+    {
+        std::string error;
+        if (!script.runFrame(chip8, framesPublished, error))
+            scriptStopped = "Script stopped: " + error;
+        if (script.touchedMachine())
+            debugger.clearHistory();
+    }
+#endif
+    const Chip8::UnknownOpcodes &unknown = chip8.getUnknownOpcodes();
+    if (unknown.count != unknownLogged)
+    {
+        // Once a frame at most however often the ROM runs them
+        if (unknown.count > unknownLogged)
+            EventLog::shared().record(EventLog::Kind::UnknownOpcode, unknown.lastOpcode, unknown.lastPC, static_cast<int64_t>(unknown.count - unknownLogged));
+        unknownLogged = unknown.count;
+    }
+    const int session = autosaveSession.load(std::memory_order_relaxed);
+    if (session >= 0 && ++framesSinceAutosave >= autosaveFrames && Autosaver::shared().submit(session, chip8.state()))
+        framesSinceAutosave = 0; // Or the writer was busy, the next frame tries again
+    publishSound();
+}
+
+// Hands the current screen to the GUI, call with coreMutex held. The core
+// copies its last complete picture to the front buffer first, see
+// Chip8::presentFrame.
+void EmulationThread::publishFrame()
+{
+    chip8.presentFrame();
+    const auto &shown = chip8.frontBuffer();
+    EmulatedFrame &frame = frameBuffer.back();
+    frame.gfx = shown;
+    frame.hires = chip8.isFrontHires();
+    frame.keys = chip8.keyMask();
+
+    // Whole words at a time, skipped across a resolution switch
+    if (frameBlend.load(std::memory_order_relaxed) && previousFrame.hires == frame.hires)
+    {
+        for (size_t i = 0; i < frame.gfx.size(); ++i)
+            frame.gfx[i] |= previousFrame.gfx[i];
+    }
+    if (latency.isEnabled())
+    {
+        latency.keyRead(chip8.keyReadCycle());
+        latency.framePublished(framesPublished, previousFrame.gfx != shown || previousFrame.hires != frame.hires);
+    }
+    previousFrame.gfx = shown;
+    previousFrame.hires = frame.hires;
+    frame.sequence = framesPublished++;
+    frame.instructions = instructionsRun;
+    frameBuffer.publish();
+    if (frameShare.isOpen())
+        frameShare.publish(shown, frame.hires, frame.sequence);
+    if (video.isRecording())
+    {
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - videoStart);
+        video.push({shown, frame.hires, static_cast<uint64_t>(elapsed.count()), chip8.getCycleCount()});
+    }
+}
+
+// Emulates frames past the state saved in scratch and publishes the screen
+// they end on, then rolls back. Key events stay queued for the real frames
+// and nothing reaches the sound or the movie. Call with coreMutex held.
+void EmulationThread::publishAhead(int frames, double hz, bool vip)
+{
+    double budget = cycleBudget;
+    for (int i = 0; i < frames; ++i)
+    {
+        if (vip)
+        {
+            chip8.runVipFrame();
+        }
+        else
+        {
+            budget += hz / 60;
+            int cycles = static_cast<int>(budget);
+            budget -= cycles;
+            chip8.runFrame(cycles);
+        }
+    }
+    publishFrame();
+    chip8.restore(scratch);
+}
+
+// One tick of a netplay session. Key events only update the local mask;
+// the session puts them on frame boundaries so both sides agree.
+void EmulationThread::netplayFrame()
+{
+    KeyQueue *queue;
+    while ((queue = nextKeyQueue()) != nullptr)
+    {
+        const KeyEvent *event = queue->front();
+        const uint16_t bit = static_cast<uint16_t>(1u << event->key);
+        netplayKeys = event->pressed ? netplayKeys | bit : netplayKeys & ~bit;
+        queue->pop();
+    }
+
+    std::lock_guard<std::mutex> lock(coreMutex);
+    if (uint16_t changed = gamepadChanges())
+        netplayKeys = static_cast<uint16_t>((netplayKeys & ~changed) | (gamepadKeys & changed));
+    if (!netplay)
+        return;
+    if (netplay->status() == NetplaySession::Status::Connecting)
+    {
+        if (!netplay->connect(netplayOffer))
+            return;
+
+        // Start both sides from the same freshly loaded machine
+        chip8.loadROM(netplayRom);
+        chip8.seedRandom(netplay->settings().seed);
+        chip8.setKeyMask(0);
+    }
+
+    const uint64_t before = chip8.getCycleCount();
+    if (netplay->advance(chip8, netplayKeys))
+    {
+        instructionsRun += chip8.getCycleCount() - before;
+        publishSound();
+        publishFrame();
+    }
+    else if (netplay->status() != NetplaySession::Status::Running)
+    {
+        sound.tone.store(false, std::memory_order_relaxed);
+    }
+}
+
+void EmulationThread::publishSound()
+{
+    const auto &pattern = chip8.getAudioPattern();
+    uint64_t high = 0;
+    uint64_t low = 0;
+    for (int i = 0; i < 8; ++i)
+    {
+        high = (high << 8) | pattern[i];
+        low = (low << 8) | pattern[i + 8];
+    }
+
+    uint32_t seq = sound.sequence.load(std::memory_order_relaxed);
+    sound.sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    sound.patternHigh.store(high, std::memory_order_relaxed);
+    sound.patternLow.store(low, std::memory_order_relaxed);
+    sound.pitch.store(chip8.getPitch(), std::memory_order_relaxed);
+    sound.patterned.store(chip8.hasAudioPattern(), std::memory_order_relaxed);
+    if (chip8.beepFlag && !sound.tone.load(std::memory_order_relaxed))
+    {
+        const auto now = std::chrono::steady_clock::now().time_since_epoch();
+        sound.toneSince.store(std::chrono::duration_cast<std::chrono::microseconds>(now).count(), std::memory_order_relaxed);
+    }
+    sound.tone.store(chip8.beepFlag, std::memory_order_relaxed);
+    sound.sequence.store(seq + 2, std::memory_order_release);
+
+    // The buzzer only changes in decrementTimers and restores, both followed by this
+    if (video.isRecording() && chip8.beepFlag != videoTone)
+    {
+        videoTone = chip8.beepFlag;
+        auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - videoStart);
+        video.pushTone({static_cast<uint64_t>(elapsed.count()), chip8.getCycleCount(), videoTone});
+    }
+}
+
+// Runs the frame that ends at deadline
+void EmulationThread::tick(Clock::time_point deadline)
+{
+    const double hz = clockHz.load(std::memory_order_relaxed);
+    const bool vip = vipTiming.load(std::memory_order_relaxed);
+    const int turbo = fastForward.load(std::memory_order_relaxed);
+
+    installPendingLoad();
+    if (netplaying.load(std::memory_order_relaxed))
+    {
+        netplayFrame();
+    }
+    else if (paused.load(std::memory_order_relaxed))
+    {
+        // Keep the key state current, there are no cycles to place events on
+        sound.tone.store(false, std::memory_order_relaxed);
+        Clock::time_point windowEnd = Clock::now();
+        std::lock_guard<std::mutex> lock(coreMutex);
+        runFrame(0, false, 0, windowStart, windowEnd);
+        windowStart = windowEnd;
+    }
+    else if (rewinding.load(std::memory_order_relaxed) && !recording.load(std::memory_order_relaxed))
+    {
+        Clock::time_point windowEnd = Clock::now();
+        std::lock_guard<std::mutex> lock(coreMutex);
+        runFrame(0, false, 0, windowStart, windowEnd);
+        windowStart = windowEnd;
+
+        // Step back one recorded frame, stay on the oldest once history runs out
+        if (history.pop(scratch))
+        {
+            chip8.restore(scratch);
+            publishSound();
+            publishFrame();
+        }
+    }
+    else if (!haltedForKey())
+    {
+        // Fast-forward runs several frames per presented one and skips showing the rest
+        int emulated = 0;
+        do
+        {
+            Clock::time_point frameDeadline = deadline;
+            if (turbo != 1)
+                frameDeadline = turbo > 1 ? Clock::now() + framePeriod / turbo : Clock::now();
+            emulateFrame(hz, vip, frameDeadline);
+            ++emulated;
+        } while (turbo == 0 ? Clock::now() < deadline : emulated < turbo);
+
+        std::lock_guard<std::mutex> lock(coreMutex);
+        chip8.snapshot(scratch);
+        history.push(scratch);
+        const int ahead = runAhead.load(std::memory_order_relaxed);
+        if (ahead > 0 && turbo == 1 && (vip || hz > 0))
+            publishAhead(ahead, hz, vip);
+        else
+            publishFrame();
+
+        // Late frames go to the event log once a second at most, the
+        // worst with how many there were; fast-forward has no deadline
+        if (turbo == 1 && (vip || hz > 0))
+        {
+            const int64_t late = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - deadline).count();
+            if (late > 0)
+            {
+                ++lateFrames;
+                worstLate = std::max(worstLate, late);
+            }
+            if (lateFrames > 0 && framesPublished - overrunLogged >= 60)
+            {
+                EventLog::shared().record(EventLog::Kind::FrameOverrun, worstLate, lateFrames);
+                overrunLogged = framesPublished;
+                lateFrames = 0;
+                worstLate = 0;
+            }
+        }
+    }
+}
@@ -0,0 +1,372 @@
+#ifndef EMULATION_THREAD_H
+#define EMULATION_THREAD_H
+
+#include "autosave.h"
+#include "cheat_engine.h"
+#include "chip8.h"
+#include "chip8_debugger.h"
+#include "event_log.h"
+#include "frame_share.h"
+#include "gamepad.h"
+#include "input_latency.h"
+#if defined(CHIP8_LUA)
+#include "lua_script.h"
+#endif
+#include "movie.h"
+#include "netplay.h"
+#include "pc_sampler.h"
+#include "rewind_buffer.h"
+#include "rom_cache.h"
+#include "sound_state.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+#include "video_recorder.h"
+#include <array>              // For the frame copy
+#include <atomic>             // For settings shared with the GUI
+#include <chrono>             // For key event timestamps
+#include <functional>         // For ROM load completions
+#include <memory>             // For the netplay session
+#include <mutex>              // For core access from other threads
+#include <string>             // For ROM paths
+#include <vector>             // For script output
+
+// Snapshot of the display handed from the emulation thread to the GUI
+struct EmulatedFrame
+{
+    std::array<uint64_t, 64 * Chip8::rowWords> gfx{};
+    bool hires = false;
+    uint64_t sequence = 0;     // Frames published before this one
+    uint64_t instructions = 0; // Instructions emulated since the thread started
+    uint16_t keys = 0;         // Held as the frame ended, bit k for key k
+};
+
+// Runs a Chip8 at 60 frames per second off the GUI thread, independent of
+// GUI stalls, and publishes every finished frame to a triple buffer. The
+// frames run on EmulationScheduler's workers, shared by every machine.
+class EmulationThread
+{
+public:
+    static constexpr std::chrono::steady_clock::duration framePeriod =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / 60));
+
+    explicit EmulationThread(Chip8 &chip8Ref);
+    ~EmulationThread();
+
+    EmulationThread(const EmulationThread &) = delete;
+    EmulationThread &operator=(const EmulationThread &) = delete;
+
+    // Stepping begins with the scheduler's next frame. stop() returns
+    // once no frame of this machine is running.
+    void start();
+    void stop();
+
+    // Target instruction rate in Hz, 0 runs as fast as the host allows.
+    // Frames stay at 60 Hz either way. The timers tick every hz / 60
+    // instructions, wherever that falls in a frame, so FX07 reads the same
+    // at any rate and fast-forward factor; unthrottled they tick once a frame.
+    void setClockRate(double hz) { clockHz.store(hz, std::memory_order_relaxed); }
+    double clockRate() const { return clockHz.load(std::memory_order_relaxed); }
+
+    // Charge every opcode its COSMAC VIP cost instead of running a fixed
+    // count per frame, overrides the clock rate while set
+    void setVipTiming(bool vip) { vipTiming.store(vip, std::memory_order_relaxed); }
+    bool isVipTiming() const { return vipTiming.load(std::memory_order_relaxed); }
+
+    // Emulated frames per presented frame: 1 is real time, N runs N times
+    // faster and only shows every Nth frame, 0 runs as many as the host allows
+    void setFastForward(int factor) { fastForward.store(factor, std::memory_order_relaxed); }
+    int fastForwardFactor() const { return fastForward.load(std::memory_order_relaxed); }
+    void setPaused(bool pause) { paused.store(pause, std::memory_order_relaxed); }
+    bool isPaused() const { return paused.load(std::memory_order_relaxed); }
+
+    // OR each published frame with the one before, so sprites that are
+    // erased and redrawn on alternate frames stop flickering
+    void setFrameBlend(bool blend) { frameBlend.store(blend, std::memory_order_relaxed); }
+    bool isFrameBlend() const { return frameBlend.load(std::memory_order_relaxed); }
+
+    // Show a program that clears and redraws only once it finished the
+    // picture, see Chip8::PresentPoint
+    void setWholePictures(bool whole)
+    {
+        std::lock_guard<std::mutex> lock(coreMutex);
+        chip8.setPresentPoint(whole ? Chip8::PresentPoint::BeforeClear : Chip8::PresentPoint::FrameEnd);
+    }
+
+    // Show the screen this many frames past the real state, as if the keys
+    // held now stay held, then carry on from the real state. Cuts input
+    // latency for games that react a frame or two after a key press.
+    // 0 is off; ignored while fast-forwarding or unthrottled.
+    void setRunAhead(int frames) { runAhead.store(frames, std::memory_order_relaxed); }
+    int runAheadFrames() const { return runAhead.load(std::memory_order_relaxed); }
+
+    // While set, every presented frame steps one frame back through the
+    // recorded history instead of emulating
+    void setRewinding(bool rewind) { rewinding.store(rewind, std::memory_order_relaxed); }
+
+    // Forget the recorded history, e.g. after loading another ROM
+    void clearRewind();
+
+    enum class LoadResult
+    {
+        Failed,
+        Loaded,
+        Patched // Into the running machine, see Chip8::patchROM
+    };
+
+    // Reads the ROM on RomCache's I/O thread, so the caller never waits on
+    // the disk, and loads it between two frames with the history cleared.
+    // With keepState a ROM of the same length is patched into the running
+    // machine instead. done is then called on the emulation thread. A
+    // request still reading is superseded by the next one and never calls
+    // back. Frames only run once started, so neither does the load.
+    void loadROMAsync(const std::string &path, std::function<void(LoadResult)> done, bool keepState = false);
+
+    // Reload the ROM with a fixed RNG seed and record every input from
+    // there. Rewinding is ignored while recording. False if the ROM failed
+    // or netplay is running.
+    bool startRecording(const std::string &romPath, uint64_t seed);
+    bool stopRecording(const std::string &moviePath); // Writes the movie file
+    bool isRecording() const { return recording.load(std::memory_order_relaxed); }
+
+    // Reload the ROM and play it against the peer of a session on which
+    // host() or join() succeeded. Frames wait until the peer answers; pause,
+    // rewind, fast-forward and run-ahead are ignored meanwhile. seed is used
+    // if this side hosts. False if the ROM failed or a movie is recording.
+    bool startNetplay(const std::string &romPath, uint64_t seed, std::unique_ptr<NetplaySession> session);
+    void stopNetplay();
+    bool isNetplaying() const { return netplaying.load(std::memory_order_relaxed); }
+
+    // The running session for status display, GUI thread only; null when
+    // none. Valid until the next stopNetplay() or startNetplay().
+    const NetplaySession *netplaySession() const { return netplay.get(); }
+
+    // Also publish every frame, unblended, to the shared-memory ring of
+    // that name for other processes, see FrameShare. False if the mapping
+    // couldn't be created.
+    bool startFrameShare(const std::string &name);
+    void stopFrameShare();
+    bool isSharingFrames() const { return sharingFrames.load(std::memory_order_relaxed); }
+
+    // Records every published frame, unblended, and every buzzer change as
+    // a .c8v video with wall clock and cycle timestamps; compression and
+    // writing run on the recorder's own thread. stopVideo returns false if
+    // the file couldn't be written.
+    bool startVideo(const std::string &path);
+    bool stopVideo();
+    bool isRecordingVideo() const { return recordingVideo.load(std::memory_order_relaxed); }
+    uint64_t droppedVideoFrames() const { return video.droppedFrames(); }
+
+    // Queue a key change from the GUI thread, applied at the matching cycle
+    // of the next frame. False if the queue is full and the event was dropped.
+    bool postKey(int key, bool pressed);
+
+    // The same from one other thread, the raw keyboard input thread. Both
+    // queues are applied in timestamp order.
+    bool postRawKey(int key, bool pressed);
+
+    // Poll the game controllers at the start of every frame, keys they
+    // press or release taking effect at the frame's first cycle. Off until
+    // a profile is set.
+    void setGamepad(bool enabled, const GamepadProfile &profile);
+
+    // Runs fn with the core stopped between two frames (ROM loads, resets)
+    template <typename F>
+    void withCore(F &&fn)
+    {
+        std::lock_guard<std::mutex> lock(coreMutex);
+        fn();
+    }
+
+    // While debugging every instruction goes through the debugger, which
+    // pauses the machine in front of a breakpoint. Netplay frames are not
+    // stepped through it.
+    void setDebugging(bool debug) { debugging.store(debug, std::memory_order_relaxed); }
+    bool isDebugging() const { return debugging.load(std::memory_order_relaxed); }
+
+    // True once after each break, for the GUI to poll
+    bool takeDebugBreak() { return debugBreak.exchange(false, std::memory_order_relaxed); }
+
+    // Runs fn(debugger, chip8) with the core stopped, like withCore
+    template <typename F>
+    void withDebugger(F &&fn)
+    {
+        std::lock_guard<std::mutex> lock(coreMutex);
+        fn(debugger, static_cast<const Chip8 &>(chip8));
+    }
+
+    // One instruction while paused, shown at once
+    void debugStep();
+
+    // Back one instruction, or back to the last breakpoint hit, through
+    // the debugger's history; see Chip8Debugger::stepBack. False with no
+    // history to go back through.
+    bool debugStepBack();
+    bool debugRunBack();
+
+    // Logged watch writes, drained by the GUI without the core lock
+    SpscQueue<Chip8Debugger::WriteEvent, Chip8Debugger::writeLogCapacity> &debugWrites() { return debugger.writeLog(); }
+
+    // Cheats held at the end of every frame, after the timer tick. Not
+    // while recording a movie or netplaying, where the other side or the
+    // replay wouldn't make the same writes.
+    void setCheats(const CheatList &list)
+    {
+        std::lock_guard<std::mutex> lock(coreMutex);
+        cheats = list;
+    }
+
+    // Every autosaveFrames emulated frames, hand the machine's state to
+    // Autosaver::shared() for session (see Autosaver::open), -1 for none.
+    // Netplay frames aren't saved, the peer's machine is half the state.
+    static constexpr int autosaveFrames = 120; // Two seconds
+    void setAutosave(int session) { autosaveSession.store(session, std::memory_order_relaxed); }
+
+    // Follows key presses through the core to the screen; the GUI reports
+    // each presented frame to it
+    InputLatencyMeter &latencyMeter() { return latency; }
+    const InputLatencyMeter &latencyMeter() const { return latency; }
+
+    // Samples PC at a random instruction of every run of the core, see
+    // PcSampler; cheap enough to leave on. Turning it on starts over,
+    // turning it off keeps the samples for pcSampleListing.
+    void setSamplingPc(bool on)
+    {
+        std::lock_guard<std::mutex> lock(coreMutex);
+        if (on)
+            pcSampler.reset();
+        samplingPc.store(on, std::memory_order_relaxed);
+    }
+    bool isSamplingPc() const { return samplingPc.load(std::memory_order_relaxed); }
+
+    // The n most sampled addresses, disassembled from the machine's memory
+    std::string pcSampleListing(size_t topN)
+    {
+        std::lock_guard<std::mutex> lock(coreMutex);
+        return pcSampler.listing(chip8.getMemory().data(), topN);
+    }
+
+#if defined(CHIP8_LUA)
+    // A Lua script whose on_frame runs at the end of every frame, after the
+    // cheats and under its instruction budget, see LuaScript. Loading runs
+    // its top level with the core held. Like the cheats, not while
+    // recording a movie or netplaying. A machine waiting for a key keeps
+    // running frames while one is loaded, as the script may press it.
+    bool loadScript(const std::string &path, int budget, std::string &error);
+    void stopScript();
+    bool hasScript();
+
+    // Lines the script printed since the last call, then why it stopped
+    // if it did
+    std::vector<std::string> takeScriptOutput();
+#endif
+
+    // Buzzer state for the audio callback to poll
+    const SoundState &soundState() const { return sound; }
+
+    // Consumer end of the frame handoff, for the GUI thread only
+    TripleBuffer<EmulatedFrame> &frames() { return frameBuffer; }
+
+private:
+    friend class EmulationScheduler;
+
+    struct KeyEvent
+    {
+        std::chrono::steady_clock::time_point time;
+        uint8_t key;
+        bool pressed;
+    };
+    using KeyQueue = SpscQueue<KeyEvent, 256>; // One per producer thread
+
+    // Where the I/O thread leaves a read ROM, shared with it so a read
+    // finishing after this is gone has somewhere to go
+    struct PendingLoad
+    {
+        std::mutex mutex;
+        uint64_t latest = 0; // Request whose result is wanted
+        bool ready = false;
+        bool keepState = false;
+        std::string path; // And when it was asked for, for the event log
+        std::chrono::steady_clock::time_point requested;
+        std::shared_ptr<const RomCache::Image> image;
+        std::function<void(LoadResult)> done;
+    };
+
+    void tick(std::chrono::steady_clock::time_point deadline); // One frame, called by the scheduler
+    void installPendingLoad();
+    bool haltedForKey();
+    KeyQueue *nextKeyQueue();
+    uint16_t gamepadChanges(); // Call with coreMutex held
+    void emulateFrame(double hz, bool vip, std::chrono::steady_clock::time_point deadline);
+    void publishSound();
+    void runFrame(int cycles, bool vip, double hz, std::chrono::steady_clock::time_point frameStart, std::chrono::steady_clock::time_point frameEnd);
+    void timerTick();
+    void publishFrame();
+    void publishAhead(int frames, double hz, bool vip);
+    void netplayFrame();
+
+    Chip8 &chip8;
+    std::mutex coreMutex;
+    TripleBuffer<EmulatedFrame> frameBuffer;
+    KeyQueue keyEvents;    // From the GUI thread
+    KeyQueue rawKeyEvents; // From the raw keyboard thread
+
+    std::atomic<double> clockHz{300};
+    std::atomic<bool> vipTiming{false};
+    std::atomic<bool> frameBlend{false};
+    std::atomic<int> fastForward{1};
+    std::atomic<int> runAhead{0};
+    std::atomic<bool> paused{false};
+    std::atomic<bool> rewinding{false};
+    std::atomic<bool> recording{false};
+    std::atomic<bool> netplaying{false};
+    std::atomic<bool> sharingFrames{false};
+    std::atomic<bool> recordingVideo{false};
+    std::atomic<bool> debugging{false};
+    std::atomic<bool> debugBreak{false};
+    std::atomic<bool> samplingPc{false};
+    std::atomic<int> autosaveSession{-1};
+    bool started = false; // GUI thread only
+    std::shared_ptr<PendingLoad> pendingLoad = std::make_shared<PendingLoad>();
+    SoundState sound;
+    InputLatencyMeter latency;
+
+    // Owned by whichever worker steps the machine, one frame at a time
+    std::chrono::steady_clock::time_point windowStart; // Start of the wall-clock span not emulated yet
+    double cycleBudget = 0;                            // Fractional cycles carried between frames
+    double tickHz = 0;                                 // Clock the timer period was set for
+    double tickAt = 0;                                 // Cycle count the next timer tick is due at, ticks on reaching its ceiling
+    uint64_t tickSeen = 0;                             // Cycle count the last frame ended on
+    uint64_t framesPublished = 0;
+    uint64_t instructionsRun = 0;
+    EmulatedFrame previousFrame; // Unblended screen of the last publish
+    uint16_t netplayKeys = 0;    // Local keys while netplaying, the session applies them
+    uint16_t gamepadKeys = 0;    // Keys the controllers held at the last poll
+    int framesSinceAutosave = 0;
+    uint64_t unknownLogged = 0; // Unknown opcodes counted at the last event log entry
+    uint64_t overrunLogged = 0; // Frame of the last overrun entry
+    int lateFrames = 0;         // Frames past their deadline since then
+    int64_t worstLate = 0;      // And the latest of them, in microseconds
+
+    // Guarded by coreMutex
+    RewindBuffer history;      // One snapshot per presented frame, about a minute
+    Chip8::Snapshot scratch{}; // Staging for rewind pushes and pops, and the real state during run-ahead
+    Movie movie;               // Input log while recording
+    std::unique_ptr<NetplaySession> netplay;
+    std::string netplayRom;
+    NetplaySession::Settings netplayOffer; // What this side proposes in the handshake
+    FrameShare frameShare;
+    Chip8Debugger debugger;
+    PcSampler pcSampler{Chip8::memorySize};
+    CheatList cheats;
+#if defined(CHIP8_LUA)
+    LuaScript script;
+    std::string scriptStopped; // The error that stopped the script, until taken
+#endif
+    bool gamepadEnabled = false;
+    GamepadProfile gamepadProfile;
+    VideoRecorder video;
+    std::chrono::steady_clock::time_point videoStart;
+    bool videoTone = false; // Buzzer state the video last recorded
+};
+
+#endif
@@ -0,0 +1,212 @@
+#include "event_log.h"
+#include <cstring> // For the text
+#include <ctime>   // For the wall-clock time at open
+
+namespace
+{
+    // Name and field formats of each kind, in Kind order; a, b and c each
+    // fill the next format, and a kind with fewer fields ends at nullptr
+    const struct
+    {
+        const char *name;
+        const char *fields[3];
+    } kinds[] = {
+        {"rom_load", {",\"load_us\":%lld", ",\"bytes\":%lld", ",\"result\":%lld"}},
+        {"unknown_opcode", {",\"opcode\":\"%04llX\"", ",\"pc\":\"%03llX\"", ",\"count\":%lld"}},
+        {"audio_underrun", {",\"gap_us\":%lld", ",\"buffer_us\":%lld", ",\"count\":%lld"}},
+        {"frame_overrun", {",\"late_us\":%lld", ",\"frames\":%lld", nullptr}},
+        {"snapshot", {",\"bytes\":%lld", ",\"write_us\":%lld", ",\"written\":%lld"}}};
+
+    // text as a JSON string body
+    std::string escaped(const char *text)
+    {
+        std::string out;
+        for (const char *p = text; *p; ++p)
+        {
+            const unsigned char c = static_cast<unsigned char>(*p);
+            if (c == '"' || c == '\\')
+            {
+                out += '\\';
+                out += *p;
+            }
+            else if (c < 0x20)
+            {
+                char code[8];
+                std::snprintf(code, sizeof code, "\\u%04X", c);
+                out += code;
+            }
+            else
+            {
+                out += *p;
+            }
+        }
+        return out;
+    }
+
+    // The calling thread's ring, given back when the thread ends
+    struct RingOwner
+    {
+        std::atomic<bool> *owned = nullptr;
+        void *ring = nullptr;
+        ~RingOwner()
+        {
+            if (owned)
+                owned->store(false, std::memory_order_release);
+        }
+    };
+    thread_local RingOwner ringOwner;
+}
+
+EventLog::~EventLog()
+{
+    close();
+}
+
+EventLog &EventLog::shared()
+{
+    static EventLog log;
+    return log;
+}
+
+bool EventLog::open(const std::string &path)
+{
+    close();
+    std::FILE *out = std::fopen(path.c_str(), "a");
+    if (!out)
+        return false;
+
+    char when[32] = "";
+    const std::time_t now = std::time(nullptr);
+    if (const std::tm *local = std::localtime(&now))
+        std::strftime(when, sizeof when, "%Y-%m-%d %H:%M:%S", local);
+    std::fprintf(out, "{\"t\":0,\"event\":\"open\",\"time\":\"%s\"}\n", when);
+    std::fflush(out);
+
+    file = out;
+    stopping = false;
+    start = Clock::now();
+    writer = std::thread(&EventLog::writeLoop, this);
+    enabled.store(true, std::memory_order_release);
+    return true;
+}
+
+void EventLog::close()
+{
+    if (!writer.joinable())
+        return;
+    enabled.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+    std::fclose(file);
+    file = nullptr;
+}
+
+uint64_t EventLog::dropped() const
+{
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    uint64_t total = 0;
+    for (const Ring *ring : rings)
+        total += ring->dropped.load(std::memory_order_relaxed);
+    return total;
+}
+
+void EventLog::push(Kind kind, int64_t a, int64_t b, int64_t c, const char *text)
+{
+    Ring *ring = static_cast<Ring *>(ringOwner.ring);
+    if (!ring)
+        ring = claimRing();
+
+    Event event;
+    event.micros = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+    event.a = a;
+    event.b = b;
+    event.c = c;
+    event.kind = kind;
+    event.text[0] = '\0';
+    if (text)
+    {
+        std::strncpy(event.text, text, sizeof event.text - 1);
+        event.text[sizeof event.text - 1] = '\0';
+    }
+    if (!ring->queue.push(event))
+        ring->dropped.store(ring->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+// A ring an ended thread gave back, or a new one
+EventLog::Ring *EventLog::claimRing()
+{
+    std::lock_guard<std::mutex> lock(ringsMutex);
+    Ring *ring = nullptr;
+    for (Ring *candidate : rings)
+    {
+        if (!candidate->owned.exchange(true, std::memory_order_acquire))
+        {
+            ring = candidate;
+            break;
+        }
+    }
+    if (!ring)
+    {
+        ring = new Ring;
+        ring->owned.store(true, std::memory_order_relaxed);
+        ring->thread = static_cast<int>(rings.size()) + 1;
+        rings.push_back(ring);
+    }
+    ringOwner.owned = &ring->owned;
+    ringOwner.ring = ring;
+    return ring;
+}
+
+void EventLog::writeLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    while (!stopping)
+    {
+        wake.wait_for(lock, flushInterval, [this]
+                      { return stopping; });
+        lock.unlock();
+        if (drain())
+            std::fflush(file);
+        lock.lock();
+    }
+}
+
+bool EventLog::drain()
+{
+    std::vector<Ring *> snapshot;
+    {
+        std::lock_guard<std::mutex> lock(ringsMutex);
+        snapshot = rings;
+    }
+    bool wrote = false;
+    for (Ring *ring : snapshot)
+    {
+        while (const Event *event = ring->queue.front())
+        {
+            const auto &kind = kinds[static_cast<size_t>(event->kind)];
+            std::fprintf(file, "{\"t\":%lld.%06lld,\"thread\":%d,\"event\":\"%s\"", static_cast<long long>(event->micros / 1000000),
+                         static_cast<long long>(event->micros % 1000000), ring->thread, kind.name);
+            const int64_t values[3] = {event->a, event->b, event->c};
+            for (int i = 0; i < 3 && kind.fields[i]; ++i)
+                std::fprintf(file, kind.fields[i], static_cast<long long>(values[i]));
+            if (event->text[0])
+                std::fprintf(file, ",\"text\":\"%s\"", escaped(event->text).c_str());
+            std::fputs("}\n", file);
+            ring->queue.pop();
+            wrote = true;
+        }
+        const uint64_t dropped = ring->dropped.load(std::memory_order_relaxed);
+        if (dropped != ring->droppedWritten)
+        {
+            std::fprintf(file, "{\"thread\":%d,\"event\":\"dropped\",\"count\":%llu}\n", ring->thread,
+                         static_cast<unsigned long long>(dropped - ring->droppedWritten));
+            ring->droppedWritten = dropped;
+            wrote = true;
+        }
+    }
+    return wrote;
+}
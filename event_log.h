@@ -0,0 +1,104 @@
+#ifndef EVENT_LOG_H
+#define EVENT_LOG_H
+
+#include "spsc_queue.h"
+#include <atomic>             // For the switch and the drop counts
+#include <chrono>             // For timestamps and the flush interval
+#include <condition_variable> // For the idle writer
+#include <cstdint>            // For the fields
+#include <cstdio>             // For the file
+#include <mutex>              // For the ring list and the writer
+#include <string>             // For paths
+#include <thread>             // For the writer thread
+#include <vector>             // For the rings
+
+// Structured diagnostics for machines nobody watches, such as kiosks: ROM
+// loads with their timings, unknown opcodes, audio underruns, late frames
+// and autosave sizes, appended to a file as one JSON object per line:
+//
+//   {"t":12.003417,"thread":2,"event":"frame_overrun","late_us":2210,"frames":3}
+//
+// Every thread that records gets a ring of its own the first time, so
+// recording is a push onto a single-producer queue and never waits or
+// allocates; a full ring drops the event and counts it. A writer thread
+// empties the rings into the file every flushInterval. With the log
+// closed, record() is one load and a branch.
+class EventLog
+{
+public:
+    enum class Kind : uint8_t
+    {
+        RomLoad,       // micros to load, bytes, LoadResult (0 failed, 1 loaded, 2 patched); text the file
+        UnknownOpcode, // opcode, PC after it, times run since the last event
+        AudioUnderrun, // longest gap between device callbacks and the buffer's length in microseconds, gaps
+        FrameOverrun,  // microseconds the latest frame ended past its deadline, late frames
+        Snapshot       // bytes, micros to write, 1 if written; text the file
+    };
+
+    static constexpr size_t ringEvents = 1024; // Per thread
+    static constexpr std::chrono::milliseconds flushInterval{1000};
+
+    ~EventLog(); // Writes what is still in the rings
+    EventLog(const EventLog &) = delete;
+    EventLog &operator=(const EventLog &) = delete;
+
+    static EventLog &shared();
+
+    // Appends to path and starts recording. False if it can't be opened.
+    bool open(const std::string &path);
+    void close(); // Writes what is left, then stops recording
+    bool isOpen() const { return enabled.load(std::memory_order_relaxed); }
+
+    // From any thread, never waits. a, b and c are the kind's fields, text
+    // a name cut to fit an event.
+    void record(Kind kind, int64_t a, int64_t b = 0, int64_t c = 0, const char *text = nullptr)
+    {
+        if (enabled.load(std::memory_order_acquire))
+            push(kind, a, b, c, text);
+    }
+
+    uint64_t dropped() const; // Events lost to full rings since startup
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Event
+    {
+        int64_t micros; // Since open()
+        int64_t a, b, c;
+        Kind kind;
+        char text[47];
+    };
+
+    // A thread's ring. Rings are never freed: a thread may end after the
+    // log, and one that ends gives its ring to the next thread to record.
+    struct Ring
+    {
+        SpscQueue<Event, ringEvents> queue;
+        std::atomic<bool> owned{false};
+        std::atomic<uint64_t> dropped{0}; // Written by the owner only
+        uint64_t droppedWritten = 0;      // Writer thread only
+        int thread = 0;                   // Number in the log, from 1
+    };
+
+    void push(Kind kind, int64_t a, int64_t b, int64_t c, const char *text);
+    Ring *claimRing();
+    void writeLoop();
+    bool drain(); // Writer thread: true if anything was written
+
+    std::atomic<bool> enabled{false};
+    Clock::time_point start;
+
+    EventLog() = default; // Threads keep their ring, so there is only the shared log
+
+    mutable std::mutex ringsMutex;
+    std::vector<Ring *> rings;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::FILE *file = nullptr;
+    std::thread writer;
+};
+
+#endif
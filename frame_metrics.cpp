@@ -0,0 +1,100 @@
+#include "frame_metrics.h"
+#include <algorithm> // For std::max
+#include <cstdio>    // For writing the CSV
+
+void FrameMetricsLog::push(const FrameMetrics &metrics)
+{
+    uint64_t index = written.load(std::memory_order_relaxed);
+    Slot &slot = slots[index % capacity];
+
+    slot.stamp.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timeMicros.store(metrics.timeMicros, std::memory_order_relaxed);
+    slot.frameMicros.store(metrics.frameMicros, std::memory_order_relaxed);
+    slot.renderMicros.store(metrics.renderMicros, std::memory_order_relaxed);
+    slot.audioGapMicros.store(metrics.audioGapMicros, std::memory_order_relaxed);
+    slot.instructions.store(metrics.instructions, std::memory_order_relaxed);
+    slot.dropped.store(metrics.dropped, std::memory_order_relaxed);
+    slot.stamp.store(2 * (index + 1), std::memory_order_release);
+
+    written.store(index + 1, std::memory_order_release);
+}
+
+std::vector<FrameMetrics> FrameMetricsLog::recent(uint64_t spanMicros) const
+{
+    uint64_t end = written.load(std::memory_order_acquire);
+    uint64_t begin = end > capacity ? end - capacity : 0;
+
+    std::vector<FrameMetrics> frames;
+    frames.reserve(end - begin);
+    for (uint64_t index = begin; index < end; ++index)
+    {
+        const Slot &slot = slots[index % capacity];
+        uint64_t stamp = slot.stamp.load(std::memory_order_acquire);
+        if (stamp != 2 * (index + 1))
+            continue; // Already reused for a newer frame
+
+        FrameMetrics m;
+        m.timeMicros = slot.timeMicros.load(std::memory_order_relaxed);
+        m.frameMicros = slot.frameMicros.load(std::memory_order_relaxed);
+        m.renderMicros = slot.renderMicros.load(std::memory_order_relaxed);
+        m.audioGapMicros = slot.audioGapMicros.load(std::memory_order_relaxed);
+        m.instructions = slot.instructions.load(std::memory_order_relaxed);
+        m.dropped = slot.dropped.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.stamp.load(std::memory_order_relaxed) != stamp)
+            continue; // Overwritten while we read it
+        frames.push_back(m);
+    }
+
+    if (!frames.empty())
+    {
+        uint64_t newest = frames.back().timeMicros;
+        size_t first = 0;
+        while (first < frames.size() && newest - frames[first].timeMicros > spanMicros)
+            ++first;
+        frames.erase(frames.begin(), frames.begin() + first);
+    }
+    return frames;
+}
+
+FrameMetricsSummary FrameMetricsLog::summarize(const std::vector<FrameMetrics> &frames)
+{
+    FrameMetricsSummary summary;
+    summary.frames = frames.size();
+    if (frames.empty())
+        return summary;
+
+    uint64_t frameMicros = 0;
+    uint64_t renderMicros = 0;
+    uint64_t instructions = 0;
+    for (const FrameMetrics &m : frames)
+    {
+        frameMicros += m.frameMicros;
+        renderMicros += m.renderMicros;
+        instructions += m.instructions;
+        summary.worstFrameMs = std::max(summary.worstFrameMs, m.frameMicros / 1000.0);
+        summary.worstAudioGapMs = std::max(summary.worstAudioGapMs, m.audioGapMicros / 1000.0);
+        summary.dropped += m.dropped;
+    }
+    summary.averageFrameMs = frameMicros / 1000.0 / frames.size();
+    summary.averageRenderMs = renderMicros / 1000.0 / frames.size();
+    if (frameMicros > 0)
+        summary.instructionsPerSecond = instructions * 1e6 / frameMicros;
+    return summary;
+}
+
+bool FrameMetricsLog::save(const std::string &path) const
+{
+    FILE *file = std::fopen(path.c_str(), "w");
+    if (!file)
+        return false;
+
+    std::fprintf(file, "time_us,frame_us,render_us,audio_gap_us,instructions,dropped\n");
+    for (const FrameMetrics &m : recent(UINT64_MAX))
+    {
+        std::fprintf(file, "%llu,%u,%u,%u,%u,%u\n", static_cast<unsigned long long>(m.timeMicros),
+                     m.frameMicros, m.renderMicros, m.audioGapMicros, m.instructions, m.dropped);
+    }
+    return std::fclose(file) == 0;
+}
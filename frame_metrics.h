@@ -0,0 +1,70 @@
+#ifndef FRAME_METRICS_H
+#define FRAME_METRICS_H
+
+#include <array>   // For the ring slots
+#include <atomic>  // For lock-free slots
+#include <cstddef> // For size_t
+#include <cstdint> // For the counters
+#include <string>  // For the dump path
+#include <vector>  // For copies of the history
+
+// Host-side measurements for one presented frame
+struct FrameMetrics
+{
+    uint64_t timeMicros = 0;     // When it was presented, since the log started
+    uint32_t frameMicros = 0;    // Since the previous presented frame
+    uint32_t renderMicros = 0;   // Texture upload and draw, not the wait for vsync
+    uint32_t audioGapMicros = 0; // Longest wait between two audio callbacks
+    uint32_t instructions = 0;   // Emulated since the previous presented frame
+    uint32_t dropped = 0;        // Frames the emulation published that were never shown
+};
+
+// Averages and worst cases over a span of frames
+struct FrameMetricsSummary
+{
+    double instructionsPerSecond = 0;
+    double averageFrameMs = 0;
+    double worstFrameMs = 0;
+    double averageRenderMs = 0;
+    double worstAudioGapMs = 0;
+    uint32_t dropped = 0;
+    size_t frames = 0;
+};
+
+// The last minute or so of frame metrics. One thread pushes; any thread
+// can copy out the recent history, e.g. to dump it when a user reports a
+// stutter. Each slot carries a sequence stamp, so a reader skips slots
+// that were overwritten while it copied them and nobody ever waits.
+class FrameMetricsLog
+{
+public:
+    static constexpr size_t capacity = 4096; // About 68 s at 60 Hz
+
+    // Writer side
+    void push(const FrameMetrics &metrics);
+
+    // Frames from the last span microseconds, oldest first
+    std::vector<FrameMetrics> recent(uint64_t spanMicros) const;
+
+    static FrameMetricsSummary summarize(const std::vector<FrameMetrics> &frames);
+
+    // Writes the whole history as CSV, false if the file can't be written
+    bool save(const std::string &path) const;
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> stamp{0}; // 2 * (index + 1) once written, odd while writing
+        std::atomic<uint64_t> timeMicros{0};
+        std::atomic<uint32_t> frameMicros{0};
+        std::atomic<uint32_t> renderMicros{0};
+        std::atomic<uint32_t> audioGapMicros{0};
+        std::atomic<uint32_t> instructions{0};
+        std::atomic<uint32_t> dropped{0};
+    };
+
+    std::array<Slot, capacity> slots;
+    std::atomic<uint64_t> written{0}; // Frames pushed so far
+};
+
+#endif
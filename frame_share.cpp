@@ -0,0 +1,163 @@
+#include "frame_share.h"
+#include <cstring> // For std::memcpy
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const int readAttempts = 4; // A writer at 60 Hz can't lap a reader this often
+}
+
+bool FrameShare::create(const std::string &name)
+{
+    close();
+#if defined(_WIN32)
+    std::string path = "Local\\" + name;
+    HANDLE handle = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, 0,
+                                       static_cast<DWORD>(mappingSize), path.c_str());
+    if (!handle)
+        return false;
+    void *view = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, mappingSize);
+    if (!view)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+    mapping = handle;
+#else
+    std::string path = "/" + name;
+    int fd = shm_open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+    void *view = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(mappingSize)) == 0)
+        view = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+    {
+        shm_unlink(path.c_str());
+        return false;
+    }
+#endif
+    header = static_cast<Header *>(view);
+    mappedName = name;
+    owner = true;
+
+    // A mapping left by an earlier writer is started over
+    header->published.store(0, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < slotCount; ++i)
+        slot(i)->seq.store(0, std::memory_order_relaxed);
+    header->version = version;
+    header->slotCount = slotCount;
+    header->slotSize = sizeof(Slot);
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = magic;
+    return true;
+}
+
+bool FrameShare::attach(const std::string &name)
+{
+    close();
+#if defined(_WIN32)
+    std::string path = "Local\\" + name;
+    HANDLE handle = OpenFileMappingA(FILE_MAP_READ, FALSE, path.c_str());
+    if (!handle)
+        return false;
+    void *view = MapViewOfFile(handle, FILE_MAP_READ, 0, 0, mappingSize);
+    if (!view)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+    mapping = handle;
+#else
+    std::string path = "/" + name;
+    int fd = shm_open(path.c_str(), O_RDONLY, 0);
+    if (fd < 0)
+        return false;
+    void *view = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (view == MAP_FAILED)
+        return false;
+#endif
+    header = static_cast<Header *>(view);
+    mappedName = name;
+    owner = false;
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (header->magic != magic || header->version != version || header->slotCount != slotCount ||
+        header->slotSize != sizeof(Slot))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void FrameShare::close()
+{
+    if (!header)
+        return;
+#if defined(_WIN32)
+    UnmapViewOfFile(header);
+    CloseHandle(static_cast<HANDLE>(mapping));
+    mapping = nullptr;
+#else
+    munmap(header, mappingSize);
+    if (owner)
+        shm_unlink(("/" + mappedName).c_str());
+#endif
+    header = nullptr;
+    mappedName.clear();
+    owner = false;
+}
+
+void FrameShare::publish(const std::array<uint64_t, 128> &gfx, bool hires, uint64_t frame)
+{
+    uint64_t n = header->published.load(std::memory_order_relaxed);
+    Slot *s = slot(n);
+
+    // Odd first, so a reader copying this slot sees the sequence move
+    uint64_t seq = s->seq.load(std::memory_order_relaxed);
+    s->seq.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    s->frame = frame;
+    s->flags = hires ? hiresFlag : 0;
+    std::memcpy(s->gfx, gfx.data(), sizeof s->gfx);
+    s->seq.store(seq + 2, std::memory_order_release);
+    header->published.store(n + 1, std::memory_order_release);
+}
+
+bool FrameShare::read(Frame &out) const
+{
+    for (int attempt = 0; attempt < readAttempts; ++attempt)
+    {
+        uint64_t n = header->published.load(std::memory_order_acquire);
+        if (n == 0)
+            return false;
+        const Slot *s = slot(n - 1);
+        uint64_t before = s->seq.load(std::memory_order_acquire);
+        if (before & 1)
+            continue;
+        out.frame = s->frame;
+        out.hires = (s->flags & hiresFlag) != 0;
+        std::memcpy(out.gfx.data(), s->gfx, sizeof s->gfx);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (s->seq.load(std::memory_order_relaxed) == before)
+            return true;
+    }
+    return false;
+}
+
+FrameShare::Slot *FrameShare::slot(uint64_t index) const
+{
+    auto *base = reinterpret_cast<uint8_t *>(header + 1);
+    return reinterpret_cast<Slot *>(base + (index % slotCount) * sizeof(Slot));
+}
@@ -0,0 +1,100 @@
+#ifndef FRAME_SHARE_H
+#define FRAME_SHARE_H
+
+#include <array>   // For the frame copy
+#include <atomic>  // For the sequence counters
+#include <cstdint> // For the fixed-width layout
+#include <string>  // For the mapping name
+
+// Publishes the screen to a named shared-memory ring so recorders, agents
+// and overlays in other processes can read frames in place, with no
+// socket or pipe round-trip. The mapping is a Header followed by
+// slotCount Slots; frame n goes to slot n % slotCount. Each slot is a
+// seqlock: its seq is odd while the writer is inside, so a reader that
+// sees the same even seq before and after its read has a whole frame.
+//
+// Reader protocol, also what read() does:
+//   n = header.published; if n == 0 nothing is there yet
+//   slot = slots[(n - 1) % slotCount]
+//   s1 = slot.seq (acquire); if odd, retry
+//   use slot.gfx, slot.frame, slot.flags
+//   acquire fence; s2 = slot.seq; if s1 != s2, retry
+//
+// The name is the same on every platform; Windows maps it as
+// "Local\<name>", POSIX as "/<name>" under shm_open.
+class FrameShare
+{
+public:
+    static constexpr uint32_t magic = 0x42463843; // "C8FB" in memory order
+    static constexpr uint32_t version = 1;
+    static constexpr uint32_t slotCount = 8; // Readers have this many frames before a slot is reused
+    static constexpr uint32_t hiresFlag = 1;
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t slotCount;
+        uint32_t slotSize;                // sizeof(Slot), the stride between slots
+        std::atomic<uint64_t> published;  // Frames written so far
+        uint8_t padding[40];              // Slots start on a cache line
+    };
+
+    // gfx has Chip8::gfx's layout: two words per row, bit 63 of a row's
+    // first word leftmost, lo-res in the first word of the top 32 rows
+    struct Slot
+    {
+        std::atomic<uint64_t> seq; // Odd while being written
+        uint64_t frame;            // EmulatedFrame::sequence
+        uint32_t flags;            // hiresFlag
+        uint32_t reserved;
+        uint64_t gfx[128];
+        uint8_t padding[40];
+    };
+
+    struct Frame
+    {
+        uint64_t frame = 0;
+        bool hires = false;
+        std::array<uint64_t, 128> gfx{};
+    };
+
+    static_assert(sizeof(Header) == 64 && sizeof(Slot) % 64 == 0, "shared layout");
+    static constexpr size_t mappingSize = sizeof(Header) + slotCount * sizeof(Slot);
+
+    FrameShare() = default;
+    ~FrameShare() { close(); }
+
+    FrameShare(const FrameShare &) = delete;
+    FrameShare &operator=(const FrameShare &) = delete;
+
+    // Writer side: creates the mapping, or takes over one of that name
+    bool create(const std::string &name);
+
+    // Reader side: opens a mapping a writer created; false if there is
+    // none or its header doesn't match this layout
+    bool attach(const std::string &name);
+
+    void close();
+    bool isOpen() const { return header != nullptr; }
+    const std::string &name() const { return mappedName; }
+
+    // Writer only, one thread at a time
+    void publish(const std::array<uint64_t, 128> &gfx, bool hires, uint64_t frame);
+
+    // Copies the newest whole frame; false if nothing was published yet
+    // or the writer kept overwriting it
+    bool read(Frame &out) const;
+
+private:
+    Slot *slot(uint64_t index) const;
+
+    Header *header = nullptr;
+    std::string mappedName;
+    bool owner = false; // POSIX: the writer unlinks the name on close
+#if defined(_WIN32)
+    void *mapping = nullptr;
+#endif
+};
+
+#endif
@@ -0,0 +1,152 @@
+#include "gamepad.h"
+#include "sdl_init.h"
+#include <SDL2/SDL.h>
+#include <cctype>  // For std::isxdigit
+#include <sstream> // For parsing profiles
+
+GamepadProfile GamepadProfile::defaults()
+{
+    GamepadProfile profile;
+    profile.keys[SDL_CONTROLLER_BUTTON_DPAD_UP] = 0x2;
+    profile.keys[SDL_CONTROLLER_BUTTON_DPAD_DOWN] = 0x8;
+    profile.keys[SDL_CONTROLLER_BUTTON_DPAD_LEFT] = 0x4;
+    profile.keys[SDL_CONTROLLER_BUTTON_DPAD_RIGHT] = 0x6;
+    profile.keys[SDL_CONTROLLER_BUTTON_A] = 0x5;
+    profile.keys[SDL_CONTROLLER_BUTTON_B] = 0x6;
+    profile.keys[SDL_CONTROLLER_BUTTON_X] = 0x4;
+    profile.keys[SDL_CONTROLLER_BUTTON_Y] = 0x0;
+    return profile;
+}
+
+bool GamepadProfile::parse(const std::string &text, GamepadProfile &out)
+{
+    GamepadProfile profile;
+    std::istringstream in(text);
+    std::string entry;
+    while (in >> entry)
+    {
+        size_t equals = entry.find('=');
+        if (equals == std::string::npos || equals + 2 != entry.size() || !std::isxdigit(static_cast<unsigned char>(entry.back())))
+            return false;
+        SDL_GameControllerButton button = SDL_GameControllerGetButtonFromString(entry.substr(0, equals).c_str());
+        if (button == SDL_CONTROLLER_BUTTON_INVALID || button >= buttonCount)
+            return false;
+        profile.keys[button] = static_cast<int8_t>(std::stoi(entry.substr(equals + 1), nullptr, 16));
+    }
+    out = profile;
+    return true;
+}
+
+std::string GamepadProfile::text() const
+{
+    static const char digits[] = "0123456789abcdef";
+    std::string out;
+    for (int button = 0; button < buttonCount; ++button)
+    {
+        const char *name = SDL_GameControllerGetStringForButton(static_cast<SDL_GameControllerButton>(button));
+        if (keys[button] < 0 || !name)
+            continue;
+        if (!out.empty())
+            out += ' ';
+        out += name;
+        out += '=';
+        out += digits[keys[button] & 0xF];
+    }
+    return out;
+}
+
+Gamepads &Gamepads::shared()
+{
+    static Gamepads gamepads;
+    return gamepads;
+}
+
+Gamepads::Gamepads()
+{
+    // Polled from the emulation workers: no events, and a thread of SDL's
+    // own for the device messages the GUI loop would otherwise have to pump
+    SDL_SetHint(SDL_HINT_JOYSTICK_THREAD, "1");
+    SDL_SetHint(SDL_HINT_JOYSTICK_ALLOW_BACKGROUND_EVENTS, "1");
+    {
+        std::lock_guard<std::mutex> lock(sdlSubsystemMutex());
+        if (SDL_InitSubSystem(SDL_INIT_GAMECONTROLLER) != 0)
+            return;
+    }
+    SDL_GameControllerEventState(SDL_IGNORE);
+    available = true;
+}
+
+Gamepads::~Gamepads()
+{
+    if (!available)
+        return;
+    for (void *controller : controllers)
+        SDL_GameControllerClose(static_cast<SDL_GameController *>(controller));
+    std::lock_guard<std::mutex> lock(sdlSubsystemMutex());
+    SDL_QuitSubSystem(SDL_INIT_GAMECONTROLLER);
+}
+
+void Gamepads::poll()
+{
+    SDL_GameControllerUpdate();
+
+    // A device came or went, open whatever is there now
+    const int devices = SDL_NumJoysticks();
+    if (devices != knownDevices)
+    {
+        for (void *controller : controllers)
+            SDL_GameControllerClose(static_cast<SDL_GameController *>(controller));
+        controllers.clear();
+        for (int i = 0; i < devices; ++i)
+        {
+            if (!SDL_IsGameController(i))
+                continue;
+            if (SDL_GameController *controller = SDL_GameControllerOpen(i))
+                controllers.push_back(controller);
+        }
+        knownDevices = devices;
+    }
+
+    uint32_t held = 0;
+    for (void *controller : controllers)
+    {
+        SDL_GameController *c = static_cast<SDL_GameController *>(controller);
+        for (int button = 0; button < SDL_CONTROLLER_BUTTON_MAX && button < GamepadProfile::buttonCount; ++button)
+        {
+            if (SDL_GameControllerGetButton(c, static_cast<SDL_GameControllerButton>(button)))
+                held |= 1u << button;
+        }
+    }
+    buttons = held;
+}
+
+uint16_t Gamepads::keys(const GamepadProfile &profile)
+{
+    if (!available)
+        return 0;
+    uint32_t held;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto now = std::chrono::steady_clock::now();
+        if (now - lastPoll >= pollInterval)
+        {
+            poll();
+            lastPoll = now;
+        }
+        held = buttons;
+    }
+
+    uint16_t mask = 0;
+    for (int button = 0; held != 0; ++button, held >>= 1)
+    {
+        if ((held & 1) && profile.keys[button] >= 0)
+            mask |= static_cast<uint16_t>(1u << profile.keys[button]);
+    }
+    return mask;
+}
+
+int Gamepads::count()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return static_cast<int>(controllers.size());
+}
@@ -0,0 +1,68 @@
+#ifndef GAMEPAD_H
+#define GAMEPAD_H
+
+#include <array>   // For the button map
+#include <chrono>  // For limiting the polls
+#include <cstdint> // For the key and button masks
+#include <mutex>   // For polls from several workers
+#include <string>  // For profile text
+#include <vector>  // For the open controllers
+
+// Which CHIP-8 key each controller button presses, by SDL game controller
+// button; -1 presses none
+struct GamepadProfile
+{
+    static constexpr int buttonCount = 32;
+    std::array<int8_t, buttonCount> keys;
+
+    GamepadProfile() { keys.fill(-1); }
+
+    // D-pad on 2/4/6/8, the usual movement keys, and the face buttons on
+    // 5 (the usual action key), 4, 6 and 0
+    static GamepadProfile defaults();
+
+    // Text form, SDL button names with the key as a hex digit:
+    // "dpup=2 dpdown=8 a=5". False, with out unchanged, on anything else.
+    static bool parse(const std::string &text, GamepadProfile &out);
+    std::string text() const;
+};
+
+// Game controllers through SDL's GameController API, shared by every
+// machine. Controllers are polled when a machine asks at the start of its
+// frame, not through the GUI's event loop, at most once every
+// pollInterval however many machines ask; plugged-in controllers are
+// opened as they appear. Buttons on every controller count.
+class Gamepads
+{
+public:
+    static constexpr std::chrono::microseconds pollInterval{1000};
+
+    // Initialises SDL's game controller subsystem on first use. Call it
+    // from the GUI thread first, where SDL expects that.
+    static Gamepads &shared();
+
+    ~Gamepads();
+    Gamepads(const Gamepads &) = delete;
+    Gamepads &operator=(const Gamepads &) = delete;
+
+    bool isAvailable() const { return available; }
+
+    // CHIP-8 keys (bit k = key k) the held buttons press under profile
+    uint16_t keys(const GamepadProfile &profile);
+
+    // Controllers currently open
+    int count();
+
+private:
+    Gamepads();
+    void poll(); // With mutex held
+
+    std::mutex mutex;
+    bool available = false;
+    std::vector<void *> controllers; // SDL_GameController
+    uint32_t buttons = 0;            // Held on any controller, bit per button
+    int knownDevices = -1;           // Joystick count the controller list was built for
+    std::chrono::steady_clock::time_point lastPoll;
+};
+
+#endif
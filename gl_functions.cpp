@@ -0,0 +1,72 @@
+#include "gl_functions.h"
+#if !defined(_WIN32)
+#include <GL/glx.h>
+#endif
+
+GlFunctions gl;
+
+namespace
+{
+    void *lookup(const char *name)
+    {
+#if defined(_WIN32)
+        return reinterpret_cast<void *>(wglGetProcAddress(name));
+#else
+        return reinterpret_cast<void *>(glXGetProcAddressARB(reinterpret_cast<const GLubyte *>(name)));
+#endif
+    }
+
+    unsigned compile(GLenum type, const char *source)
+    {
+        GLuint shader = gl.CreateShader(type);
+        gl.ShaderSource(shader, 1, &source, nullptr);
+        gl.CompileShader(shader);
+        GLint ok = GL_FALSE;
+        gl.GetShaderiv(shader, GL_COMPILE_STATUS, &ok);
+        if (ok != GL_TRUE)
+        {
+            gl.DeleteShader(shader);
+            return 0;
+        }
+        return shader;
+    }
+}
+
+bool loadGlFunctions()
+{
+    bool complete = true;
+#define RENDERER_GL_LOAD(type, name)                      \
+    gl.name = reinterpret_cast<type>(lookup("gl" #name)); \
+    complete = complete && gl.name != nullptr;
+    RENDERER_GL_FUNCTIONS(RENDERER_GL_LOAD)
+#undef RENDERER_GL_LOAD
+    return complete;
+}
+
+unsigned linkGlProgram(const char *vertexSource, const char *fragmentSource)
+{
+    GLuint vertex = compile(GL_VERTEX_SHADER, vertexSource);
+    GLuint fragment = compile(GL_FRAGMENT_SHADER, fragmentSource);
+    if (vertex == 0 || fragment == 0)
+    {
+        if (vertex)
+            gl.DeleteShader(vertex);
+        if (fragment)
+            gl.DeleteShader(fragment);
+        return 0;
+    }
+    GLuint program = gl.CreateProgram();
+    gl.AttachShader(program, vertex);
+    gl.AttachShader(program, fragment);
+    gl.LinkProgram(program);
+    gl.DeleteShader(vertex); // Freed with the program from here on
+    gl.DeleteShader(fragment);
+    GLint linked = GL_FALSE;
+    gl.GetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (linked != GL_TRUE)
+    {
+        gl.DeleteProgram(program);
+        return 0;
+    }
+    return program;
+}
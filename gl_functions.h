@@ -0,0 +1,63 @@
+#ifndef GL_FUNCTIONS_H
+#define GL_FUNCTIONS_H
+
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+// Entry points past OpenGL 1.1 have to be looked up at run time. Shared by
+// the shader renderers; loadGlFunctions() needs a current context.
+#define RENDERER_GL_FUNCTIONS(X)                                 \
+    X(PFNGLGENBUFFERSPROC, GenBuffers)                           \
+    X(PFNGLBINDBUFFERPROC, BindBuffer)                           \
+    X(PFNGLBUFFERDATAPROC, BufferData)                           \
+    X(PFNGLDELETEBUFFERSPROC, DeleteBuffers)                     \
+    X(PFNGLGENVERTEXARRAYSPROC, GenVertexArrays)                 \
+    X(PFNGLBINDVERTEXARRAYPROC, BindVertexArray)                 \
+    X(PFNGLDELETEVERTEXARRAYSPROC, DeleteVertexArrays)           \
+    X(PFNGLVERTEXATTRIBPOINTERPROC, VertexAttribPointer)         \
+    X(PFNGLENABLEVERTEXATTRIBARRAYPROC, EnableVertexAttribArray) \
+    X(PFNGLCREATESHADERPROC, CreateShader)                       \
+    X(PFNGLSHADERSOURCEPROC, ShaderSource)                       \
+    X(PFNGLCOMPILESHADERPROC, CompileShader)                     \
+    X(PFNGLGETSHADERIVPROC, GetShaderiv)                         \
+    X(PFNGLDELETESHADERPROC, DeleteShader)                       \
+    X(PFNGLCREATEPROGRAMPROC, CreateProgram)                     \
+    X(PFNGLATTACHSHADERPROC, AttachShader)                       \
+    X(PFNGLLINKPROGRAMPROC, LinkProgram)                         \
+    X(PFNGLGETPROGRAMIVPROC, GetProgramiv)                       \
+    X(PFNGLUSEPROGRAMPROC, UseProgram)                           \
+    X(PFNGLDELETEPROGRAMPROC, DeleteProgram)                     \
+    X(PFNGLGETUNIFORMLOCATIONPROC, GetUniformLocation)           \
+    X(PFNGLUNIFORM1IPROC, Uniform1i)                             \
+    X(PFNGLUNIFORM1FPROC, Uniform1f)                             \
+    X(PFNGLUNIFORM2IPROC, Uniform2i)                             \
+    X(PFNGLUNIFORM2FPROC, Uniform2f)                             \
+    X(PFNGLUNIFORM3FVPROC, Uniform3fv)                           \
+    X(PFNGLACTIVETEXTUREPROC, ActiveTexture)                     \
+    X(PFNGLGENFRAMEBUFFERSPROC, GenFramebuffers)                 \
+    X(PFNGLBINDFRAMEBUFFERPROC, BindFramebuffer)                 \
+    X(PFNGLFRAMEBUFFERTEXTURE2DPROC, FramebufferTexture2D)       \
+    X(PFNGLCHECKFRAMEBUFFERSTATUSPROC, CheckFramebufferStatus)   \
+    X(PFNGLDELETEFRAMEBUFFERSPROC, DeleteFramebuffers)           \
+    X(PFNGLTEXIMAGE3DPROC, TexImage3D)                           \
+    X(PFNGLTEXSUBIMAGE3DPROC, TexSubImage3D)                     \
+    X(PFNGLDRAWARRAYSINSTANCEDPROC, DrawArraysInstanced)
+
+struct GlFunctions
+{
+#define RENDERER_GL_DECLARE(type, name) type name = nullptr;
+    RENDERER_GL_FUNCTIONS(RENDERER_GL_DECLARE)
+#undef RENDERER_GL_DECLARE
+};
+extern GlFunctions gl;
+
+// False if the driver lacks any of them
+bool loadGlFunctions();
+
+// Program from a vertex and a fragment shader, 0 if either fails to build
+unsigned linkGlProgram(const char *vertexSource, const char *fragmentSource);
+
+#endif
@@ -0,0 +1,297 @@
+// GPU batch runner: runs thousands of copies of one ROM on the graphics
+// card with Chip8Gpu, each lane holding its own pseudo-random keys, and
+// reports throughput. With --check the first lanes are replayed on a
+// Chip8Batch with the same seeds and keys and have to end in the same
+// state, rewards included. The context comes from EGL without a window on
+// Linux, so it runs on headless servers, and from a hidden SDL window on
+// Windows.
+//
+//   chip8-gpu [options] <rom file>
+//     --lanes N      machines on the card (default 4096)
+//     --frames N     frames per dispatch (default 60)
+//     --steps N      dispatches, new keys before each (default 10)
+//     --ipf N        instructions per frame (default 10)
+//     --seed N       lane l is seeded with N + l (default 1)
+//     --reward ADDR  BCD score at ADDR as a delta watch, summed over lanes
+//     --check N      lanes replayed on the CPU and compared (default 64)
+
+#include "chip8_batch.h"
+#include "chip8_gpu.h"
+#include "rom_cache.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(_WIN32)
+#include <SDL2/SDL.h>
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif
+
+namespace
+{
+    // A current OpenGL 4.3 core context for the run
+    class GpuContext
+    {
+    public:
+        bool create()
+        {
+#if defined(_WIN32)
+            if (SDL_Init(SDL_INIT_VIDEO) != 0)
+                return false;
+            SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 4);
+            SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 3);
+            SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+            window = SDL_CreateWindow("chip8-gpu", 0, 0, 16, 16, SDL_WINDOW_OPENGL | SDL_WINDOW_HIDDEN);
+            if (!window)
+                return false;
+            context = SDL_GL_CreateContext(window);
+            return context != nullptr;
+#else
+            // Mesa's surfaceless platform needs no display server
+            auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(eglGetProcAddress("eglGetPlatformDisplayEXT"));
+            display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr)
+                                         : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+                return false;
+            eglBindAPI(EGL_OPENGL_API);
+            const EGLint attributes[] = {EGL_CONTEXT_MAJOR_VERSION, 4, EGL_CONTEXT_MINOR_VERSION, 3,
+                                         EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT, EGL_NONE};
+            context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+            return context != EGL_NO_CONTEXT && eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+#endif
+        }
+
+        ~GpuContext()
+        {
+#if defined(_WIN32)
+            if (context)
+                SDL_GL_DeleteContext(context);
+            if (window)
+                SDL_DestroyWindow(window);
+            SDL_Quit();
+#else
+            if (context != EGL_NO_CONTEXT)
+            {
+                eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+                eglDestroyContext(display, context);
+            }
+            if (display != EGL_NO_DISPLAY)
+                eglTerminate(display);
+#endif
+        }
+
+        static void *lookup(const char *name)
+        {
+#if defined(_WIN32)
+            return SDL_GL_GetProcAddress(name);
+#else
+            return reinterpret_cast<void *>(eglGetProcAddress(name));
+#endif
+        }
+
+    private:
+#if defined(_WIN32)
+        SDL_Window *window = nullptr;
+        SDL_GLContext context = nullptr;
+#else
+        EGLDisplay display = EGL_NO_DISPLAY;
+        EGLContext context = EGL_NO_CONTEXT;
+#endif
+    };
+
+    // One key or none for a lane's step, the same on both sides
+    uint16_t keysFor(uint64_t seed, size_t lane, int step)
+    {
+        uint64_t h = seed * 0x9E3779B97F4A7C15ull ^ (uint64_t(lane) << 20) ^ static_cast<uint64_t>(step);
+        h ^= h >> 31;
+        h *= 0xBF58476D1CE4E5B9ull;
+        h ^= h >> 29;
+        const unsigned key = static_cast<unsigned>(h % 17);
+        return key == 16 ? 0 : static_cast<uint16_t>(1u << key);
+    }
+
+    int32_t bcdAt(const Chip8Batch &batch, size_t lane, uint16_t addr)
+    {
+        return batch.read(lane, addr & 0xFFF) * 100 + batch.read(lane, (addr + 1) & 0xFFF) * 10 + batch.read(lane, (addr + 2) & 0xFFF);
+    }
+
+    // The first field of b that differs from a, nullptr if none
+    const char *difference(const Chip8Batch::Machine &a, const Chip8Batch::Machine &b)
+    {
+        if (a.regs.V != b.regs.V)
+            return "V";
+        if (a.regs.PC != b.regs.PC)
+            return "PC";
+        if (a.regs.I != b.regs.I)
+            return "I";
+        if (a.regs.keys != b.regs.keys)
+            return "keys";
+        if (a.regs.sp != b.regs.sp || a.stack != b.stack)
+            return "stack";
+        if (a.regs.delayTimer != b.regs.delayTimer || a.regs.soundTimer != b.regs.soundTimer)
+            return "timers";
+        if (a.regs.hires != b.regs.hires)
+            return "resolution";
+        if (a.regs.keyWaitReg != b.regs.keyWaitReg || a.regs.keyWaitKey != b.regs.keyWaitKey)
+            return "FX0A wait";
+        if (a.regs.rngState != b.regs.rngState)
+            return "random generator";
+        if (a.rplFlags != b.rplFlags)
+            return "flags";
+        if (a.gfx != b.gfx)
+            return "screen";
+        if (a.memory != b.memory)
+            return "memory";
+        return nullptr;
+    }
+
+    void usage()
+    {
+        std::fprintf(stderr, "usage: chip8-gpu [--lanes N] [--frames N] [--steps N] [--ipf N] [--seed N] [--reward ADDR] "
+                             "[--check N] <rom file>\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t lanes = 4096;
+    int frames = 60;
+    int steps = 10;
+    int ipf = 10;
+    uint64_t seed = 1;
+    long reward = -1;
+    size_t check = 64;
+    std::string romPath;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--lanes" && hasValue)
+            lanes = std::strtoull(argv[++i], nullptr, 0);
+        else if (arg == "--frames" && hasValue)
+            frames = std::atoi(argv[++i]);
+        else if (arg == "--steps" && hasValue)
+            steps = std::atoi(argv[++i]);
+        else if (arg == "--ipf" && hasValue)
+            ipf = std::atoi(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            seed = std::strtoull(argv[++i], nullptr, 0);
+        else if (arg == "--reward" && hasValue)
+            reward = std::strtol(argv[++i], nullptr, 0) & 0xFFF;
+        else if (arg == "--check" && hasValue)
+            check = std::strtoull(argv[++i], nullptr, 0);
+        else if (arg[0] != '-' && romPath.empty())
+            romPath = arg;
+        else
+        {
+            usage();
+            return 2;
+        }
+    }
+    if (romPath.empty() || lanes == 0 || frames < 0 || steps < 1 || ipf < 1)
+    {
+        usage();
+        return 2;
+    }
+    check = std::min(check, lanes);
+
+    std::shared_ptr<const RomCache::Image> rom = RomCache::shared().get(romPath);
+    if (!rom)
+    {
+        std::fprintf(stderr, "chip8-gpu: can't read %s\n", romPath.c_str());
+        return 1;
+    }
+
+    GpuContext context;
+    if (!context.create())
+    {
+        std::fprintf(stderr, "chip8-gpu: no OpenGL 4.3 context\n");
+        return 1;
+    }
+    Chip8Gpu gpu(&GpuContext::lookup, lanes, ipf);
+    if (!gpu.isReady())
+    {
+        std::fprintf(stderr, "chip8-gpu: %s\n", gpu.error().c_str());
+        return 1;
+    }
+    if (!gpu.loadROM(rom->data(), rom->size()))
+    {
+        std::fprintf(stderr, "chip8-gpu: %s doesn't fit in memory\n", romPath.c_str());
+        return 1;
+    }
+    chip8_watch watch{CHIP8_WATCH_BCD, CHIP8_WATCH_DELTA, static_cast<uint16_t>(reward), 0, 1.0f};
+    if (reward >= 0)
+        gpu.addWatch(watch);
+    for (size_t lane = 0; lane < lanes; ++lane)
+        gpu.reset(lane, seed + lane);
+
+    // The CPU side of the check, stepped alongside
+    Chip8Batch batch(check);
+    batch.loadROM(rom->data(), rom->size());
+    for (size_t lane = 0; lane < check; ++lane)
+        batch.seedRandom(lane, seed + lane);
+    std::vector<int32_t> scores(check);
+    for (size_t lane = 0; lane < check && reward >= 0; ++lane)
+        scores[lane] = bcdAt(batch, lane, static_cast<uint16_t>(reward));
+
+    double total = 0.0;
+    double seconds = 0.0;
+    int failures = 0;
+    for (int step = 0; step < steps; ++step)
+    {
+        for (size_t lane = 0; lane < lanes; ++lane)
+            gpu.setKeys(lane, keysFor(seed, lane, step));
+        const auto start = std::chrono::steady_clock::now();
+        gpu.step(frames);
+        seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        for (float r : gpu.rewards())
+            total += r;
+
+        for (size_t lane = 0; lane < check; ++lane)
+        {
+            const uint16_t keys = keysFor(seed, lane, step);
+            const uint16_t changed = keys ^ batch.keyMask(lane);
+            for (int k = 0; k < 16; ++k)
+            {
+                if (changed & (1u << k))
+                    batch.setKey(lane, k, (keys >> k) & 1);
+            }
+        }
+        batch.runFrames(frames, ipf);
+        for (size_t lane = 0; lane < check && reward >= 0; ++lane)
+        {
+            const int32_t score = bcdAt(batch, lane, static_cast<uint16_t>(reward));
+            if (static_cast<float>(score - scores[lane]) != gpu.rewards()[lane] && failures++ < 10)
+                std::printf("lane %zu step %d: reward %g, expected %d\n", lane, step, gpu.rewards()[lane], score - scores[lane]);
+            scores[lane] = score;
+        }
+    }
+
+    for (size_t lane = 0; lane < check; ++lane)
+    {
+        Chip8Batch::Machine expected, actual;
+        batch.get(lane, expected);
+        gpu.get(lane, actual);
+        if (const char *field = difference(expected, actual))
+        {
+            if (failures++ < 10)
+                std::printf("lane %zu: %s differs from Chip8Batch (keys %x/%x wait %d,%d/%d,%d pc %x/%x)\n", lane, field, expected.regs.keys, actual.regs.keys, expected.regs.keyWaitReg, expected.regs.keyWaitKey, actual.regs.keyWaitReg, actual.regs.keyWaitKey, expected.regs.PC, actual.regs.PC);
+        }
+    }
+
+    const double instructions = double(lanes) * frames * steps * ipf;
+    std::printf("%zu lanes, %d steps of %d frames: %.1f ms on the card, %.1f M instructions/s, %.0f frames/s\n", lanes, steps,
+                frames, seconds * 1000.0, instructions / seconds / 1e6, double(lanes) * frames * steps / seconds);
+    if (reward >= 0)
+        std::printf("total reward %.0f\n", total);
+    if (check)
+        std::printf("%zu lanes checked against Chip8Batch: %s\n", check, failures ? "MISMATCH" : "identical");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,681 @@
+// Headless runner: executes a ROM without wxWidgets, OpenGL or SDL and
+// prints the final machine state.
+//
+//   chip8-headless [options] rom.ch8
+//     --cycles N     run N instructions (default 1000000)
+//     --frames N     run N frames of --ipf instructions plus a timer tick
+//     --ipf N        instructions per frame (default 5, the GUI's Normal)
+//     --vip-timing   with --frames, charge COSMAC VIP cycle costs per
+//                    opcode instead of running --ipf instructions
+//     --core NAME    switch | table | predecoded | jit | aot | tiered
+//                    (default table)
+//     --whole-blocks with jit or tiered, run compiled blocks whole past the
+//                    end of a budget and charge the excess to the next
+//     --machine NAME chip8 | vip | chip48 | schip | xochip | hires | chip8x
+//                    quirk profile (default chip8, the GUI's behaviour;
+//                    hires is the VIP's 64x64 HIRES CHIP-8, chip8x the
+//                    VIP with colour zones), or auto to pick
+//                    it and the default --ipf from the ROM database;
+//                    megachip runs MEGA-CHIP on its own interpreter, with
+//                    only --cycles, --frames, --ipf and --quiet
+//     --load-state F start from a save state instead of the ROM's boot
+//     --save-state F write a save state when the run ends
+//     --movie F      replay a recorded movie instead of --cycles/--frames
+//     --seek N       with --movie, stop right after its frame N, restored
+//                    from the nearest keyframe rather than replayed
+//     --video F      with --frames, record every frame as a .c8v video
+//                    timed at 60 frames per second
+//     --gif F        with --video, also export it as an animated GIF
+//     --wav F        with --video, also rebuild its buzzer track as a WAV
+//     --trace F      write every instruction run to a .c8tr execution
+//                    trace (not with --vip-timing or --movie), see
+//                    trace_dump.cpp for a text listing
+//     --coverage F   write the addresses run as code and read as data
+//                    to a .c8cv coverage file (same limits as --trace)
+//     --coverage-image F
+//                    and draw them as a BMP
+//     --warm F       predecode the code a coverage file saw run first
+//     --quiet        only print the timing line
+//     --sample N     sample PC at one random instruction a frame and
+//                    print the N most sampled addresses, disassembled
+//                    (not with --vip-timing or --movie)
+//     --profile N    print the opcode profile and the N hottest addresses
+//                    (builds with -DCHIP8_PROFILE only)
+//     --calls N      print the N subroutines with the most inclusive
+//                    instructions, with their exclusive share (same)
+//     --flame F      write the call paths as collapsed stacks weighted by
+//                    instructions, for flamegraph.pl (same)
+//     --flame-time F the same weighted by host nanoseconds (same)
+//     --script F     run a Lua script's on_frame(frame) after every frame
+//                    (--frames on chip8 only, builds with -DCHIP8_LUA
+//                    only), printing what it prints
+//     --script-budget N
+//                    Lua instructions the script may run a frame
+
+#include "chip8.h"
+#include "chip8_coverage.h"
+#if defined(CHIP8_LUA)
+#include "lua_script.h"
+#endif
+#include "megachip.h"
+#include "movie.h"
+#include "pc_sampler.h"
+#include "rom_database.h"
+#include "trace_log.h"
+#include "video_recorder.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <type_traits>
+
+namespace
+{
+    void usage()
+    {
+        std::fprintf(stderr, "usage: chip8-headless [--cycles N | --frames N] [--ipf N | --vip-timing] "
+                             "[--core switch|table|predecoded|jit|aot|tiered] [--whole-blocks] [--machine auto|chip8|vip|chip48|schip|xochip|hires|chip8x|megachip] [--load-state FILE] [--save-state FILE] "
+                             "[--movie FILE [--seek N]] [--video FILE [--gif FILE] [--wav FILE]] [--trace FILE] [--coverage FILE] [--coverage-image FILE] [--warm FILE] [--quiet] [--sample N] [--script FILE [--script-budget N]] rom.ch8\n");
+    }
+
+#if defined(CHIP8_PROFILE)
+    bool writeText(const char *path, const std::string &text)
+    {
+        std::FILE *file = std::fopen(path, "wb");
+        if (!file)
+            return false;
+        bool ok = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+        return std::fclose(file) == 0 && ok;
+    }
+#endif
+
+    bool parseCore(const char *name, Chip8::Core &core)
+    {
+        if (std::strcmp(name, "switch") == 0)
+            core = Chip8::Core::Switch;
+        else if (std::strcmp(name, "table") == 0)
+            core = Chip8::Core::Table;
+        else if (std::strcmp(name, "predecoded") == 0)
+            core = Chip8::Core::Predecoded;
+        else if (std::strcmp(name, "jit") == 0)
+            core = Chip8::Core::Jit;
+        else if (std::strcmp(name, "aot") == 0)
+            core = Chip8::Core::Aot;
+        else if (std::strcmp(name, "tiered") == 0)
+            core = Chip8::Core::Tiered;
+        else
+            return false;
+        return true;
+    }
+
+    struct Options
+    {
+        long long cycles = 1000000;
+        long long frames = -1;
+        long long seekFrame = -1;
+        int ipf = 5;
+        bool vipTiming = false;
+        bool wholeBlocks = false;
+        bool quiet = false;
+        int profileTop = 0;
+        int sampleTop = 0;
+        int callsTop = 0;
+        int scriptBudget = 0;
+        const char *flamePath = nullptr;
+        const char *flameTimePath = nullptr;
+        std::string machine = "chip8";
+        Chip8::Core core = Chip8::Core::Table;
+        const char *romPath = nullptr;
+        const char *loadStatePath = nullptr;
+        const char *saveStatePath = nullptr;
+        const char *moviePath = nullptr;
+        const char *videoPath = nullptr;
+        const char *gifPath = nullptr;
+        const char *wavPath = nullptr;
+        const char *tracePath = nullptr;
+        const char *coveragePath = nullptr;
+        const char *coverageImagePath = nullptr;
+        const char *warmPath = nullptr;
+        const char *scriptPath = nullptr;
+    };
+
+    template <typename Machine>
+    void dumpState(const Machine &chip8)
+    {
+        std::printf("PC=%03X I=%03X SP=%X DT=%02X ST=%02X\n", chip8.getPC(), chip8.getI(),
+                    chip8.getSP(), chip8.getDelayTimer(), chip8.getSoundTimer());
+        for (int i = 0; i < 16; ++i)
+            std::printf("V%X=%02X%c", i, chip8.getV()[i], i % 8 == 7 ? '\n' : ' ');
+        std::printf("Stack:");
+        for (int i = 0; i < chip8.getSP() && i < Chip8::stackDepth; ++i)
+            std::printf(" %03X", chip8.getStack()[i]);
+        std::printf("\n");
+
+        for (int y = 0; y < chip8.height(); ++y)
+        {
+            char line[128 + 1];
+            for (int x = 0; x < chip8.width(); ++x)
+            {
+                // Planes add up to one shade per pixel, '#' for the first
+                int shade = 0;
+                for (int p = 0; p < Machine::planes; ++p)
+                    shade |= chip8.pixel(x, y, p) << p;
+                line[x] = ".#o@"[shade];
+            }
+            line[chip8.width()] = '\0';
+            std::printf("%s\n", line);
+        }
+
+        // CHIP-8X: each 8x1 cell's foreground colour as a digit
+        if constexpr (Machine::QuirkProfile::colourZones)
+        {
+            std::printf("Background %d, foreground:\n", chip8.getBackground());
+            for (int y = 0; y < chip8.height(); ++y)
+            {
+                for (int x = 0; x < chip8.width(); x += 8)
+                    std::printf("%d", chip8.foregroundAt(x, y));
+                std::printf("\n");
+            }
+        }
+    }
+
+    // Movie hooks, only reachable for the classic machine
+    template <typename Machine>
+    uint64_t hashImage(const Machine &chip8)
+    {
+        if constexpr (std::is_same<Machine, Chip8>::value)
+            return Movie::hashImage(chip8);
+        return 0;
+    }
+
+    template <typename Machine>
+    void playMovie(const Movie &movie, Machine &chip8)
+    {
+        if constexpr (std::is_same<Machine, Chip8>::value)
+            movie.play(chip8);
+    }
+
+    template <typename Machine>
+    bool seekMovie(const Movie &movie, Machine &chip8, long long frame)
+    {
+        if constexpr (std::is_same<Machine, Chip8>::value)
+            return movie.seek(chip8, static_cast<uint64_t>(frame));
+        return false;
+    }
+
+#if defined(CHIP8_LUA)
+    // Script hooks, only reachable for the classic machine. What the
+    // script printed goes to stdout as it comes.
+    void printScriptOutput(LuaScript &script)
+    {
+        for (const std::string &line : script.takeOutput())
+            std::printf("%s\n", line.c_str());
+    }
+
+    template <typename Machine>
+    bool loadScript(LuaScript &script, const char *path, Machine &chip8)
+    {
+        if constexpr (std::is_same<Machine, Chip8>::value)
+        {
+            std::string error;
+            const bool ok = script.load(path, chip8, error);
+            printScriptOutput(script);
+            if (!ok)
+                std::fprintf(stderr, "Failed to load script: %s\n", error.c_str());
+            return ok;
+        }
+        return false;
+    }
+
+    template <typename Machine>
+    bool runScript(LuaScript &script, Machine &chip8, long long frame)
+    {
+        if constexpr (std::is_same<Machine, Chip8>::value)
+        {
+            std::string error;
+            const bool ok = script.runFrame(chip8, static_cast<uint64_t>(frame), error);
+            printScriptOutput(script);
+            if (!ok)
+                std::fprintf(stderr, "Script stopped at frame %lld: %s\n", frame, error.c_str());
+            return ok;
+        }
+        return false;
+    }
+#endif
+
+    // One frame every 1/60 s of emulated time, after the buzzer if it
+    // changed; single-plane machines only
+    template <typename Machine>
+    void recordFrame(VideoRecorder &video, const Machine &chip8, long long frame, bool &tone)
+    {
+        if constexpr (Machine::planes == 1)
+        {
+            // Offline, so wait for the encoder instead of dropping
+            const uint64_t micros = static_cast<uint64_t>(frame) * 1000000 / 60;
+            if (chip8.beepFlag != tone)
+            {
+                tone = chip8.beepFlag;
+                while (!video.pushTone({micros, chip8.getCycleCount(), tone}))
+                    std::this_thread::yield();
+            }
+            VideoFrame out;
+            out.gfx = chip8.gfx;
+            out.hires = chip8.isHires();
+            out.micros = micros;
+            out.cycle = chip8.getCycleCount();
+            while (!video.push(out))
+                std::this_thread::yield();
+        }
+    }
+
+    // An instruction at a time for --trace and --coverage, each one that
+    // runs recorded with the state it leaves. The FX0A and DXYN halts keep
+    // PC where it is and aren't instructions; a jump to itself is.
+    template <typename Machine>
+    void stepCycles(Machine &chip8, TraceWriter *trace, Chip8Coverage *coverage, int count)
+    {
+        const auto &memory = chip8.getMemory();
+        for (int i = 0; i < count; ++i)
+        {
+            const uint16_t pc = chip8.getPC();
+            const uint16_t opcode = static_cast<uint16_t>(memory[pc % memory.size()] << 8 | memory[(pc + 1) % memory.size()]);
+            const uint16_t index = chip8.getI();
+            chip8.emulateCycle();
+            if (chip8.getPC() == pc && opcode != (0x1000 | pc))
+                continue;
+            if (trace)
+                trace->record(chip8.getCycleCount(), pc, opcode, chip8.getI(), chip8.getV());
+            if (coverage)
+                coverage->mark(pc, opcode, index);
+        }
+    }
+
+    // MEGA-CHIP has no cores, states or recordings, only the run itself
+    int runMega(const Options &opt)
+    {
+        MegaChip8 machine;
+        if (!machine.loadROM(opt.romPath))
+        {
+            std::fprintf(stderr, "Failed to load ROM: %s\n", opt.romPath);
+            return 1;
+        }
+        const long long cycles = opt.frames >= 0 ? opt.frames * opt.ipf : opt.cycles;
+        long long frameCount = 0;
+        const auto start = std::chrono::steady_clock::now();
+        while (static_cast<long long>(machine.getCycleCount()) < cycles && !machine.isWaitingForKey())
+        {
+            const long long left = cycles - static_cast<long long>(machine.getCycleCount());
+            if (left < opt.ipf)
+            {
+                for (long long i = 0; i < left; ++i)
+                    machine.emulateCycle();
+                break;
+            }
+            machine.runFrame(opt.ipf);
+            ++frameCount;
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        const long long executed = static_cast<long long>(machine.getCycleCount());
+
+        std::printf("Ran %lld cycles (%lld frames) in %.3f s: %.2f M cycles/s\n", executed, frameCount,
+                    seconds, seconds > 0 ? executed / seconds / 1e6 : 0.0);
+        if (opt.quiet)
+            return 0;
+        std::printf("PC=%06X I=%06X SP=%X DT=%02X ST=%02X\n", machine.getPC(), machine.getI(),
+                    machine.getSP(), machine.getDelayTimer(), machine.getSoundTimer());
+        for (int i = 0; i < 16; ++i)
+            std::printf("V%X=%02X%c", i, machine.getV()[i], i % 8 == 7 ? '\n' : ' ');
+        std::printf("Mode: %s %dx%d, state hash %016llx\n", machine.isMega() ? "mega" : machine.isHires() ? "hires" : "lores",
+                    machine.width(), machine.height(), static_cast<unsigned long long>(machine.stateHash()));
+        return 0;
+    }
+
+    template <typename Machine>
+    int run(const Options &opt)
+    {
+        long long cycles = opt.cycles;
+        const long long frames = opt.frames;
+        const int ipf = opt.ipf;
+        const char *romPath = opt.romPath;
+        const char *loadStatePath = opt.loadStatePath;
+        const char *saveStatePath = opt.saveStatePath;
+        const char *moviePath = opt.moviePath;
+
+        Machine chip8(opt.core);
+        chip8.setWholeBlocks(opt.wholeBlocks);
+        if (!chip8.loadROM(romPath))
+        {
+            std::fprintf(stderr, "Failed to load ROM: %s\n", romPath);
+            return 1;
+        }
+        // Movies start from the freshly loaded ROM
+        Movie movie;
+        if (moviePath)
+        {
+            if (!movie.load(moviePath))
+            {
+                std::fprintf(stderr, "Failed to load movie: %s\n", moviePath);
+                return 1;
+            }
+            if (movie.imageHash != hashImage(chip8))
+            {
+                std::fprintf(stderr, "Movie was recorded with a different ROM\n");
+                return 1;
+            }
+        }
+        if (loadStatePath && !chip8.loadStateFile(loadStatePath))
+        {
+            std::fprintf(stderr, "Failed to load state: %s\n", loadStatePath);
+            return 1;
+        }
+
+        VideoRecorder video;
+        bool videoTone = false;
+        if (opt.videoPath && !video.start(opt.videoPath))
+        {
+            std::fprintf(stderr, "Failed to create video: %s\n", opt.videoPath);
+            return 1;
+        }
+
+        Chip8Coverage coverage(chip8.getMemory().size());
+        if (opt.warmPath)
+        {
+            Chip8Coverage seen;
+            if (!seen.load(opt.warmPath) || seen.size() != chip8.getMemory().size())
+            {
+                std::fprintf(stderr, "Failed to load coverage: %s\n", opt.warmPath);
+                return 1;
+            }
+            seen.warm(chip8);
+        }
+        TraceWriter trace;
+        if (opt.tracePath && !trace.start(opt.tracePath, chip8.getCycleCount(), chip8.getPC(), chip8.getI(), chip8.getV()))
+        {
+            std::fprintf(stderr, "Failed to create trace: %s\n", opt.tracePath);
+            return 1;
+        }
+
+#if defined(CHIP8_LUA)
+        LuaScript script;
+        script.setBudget(opt.scriptBudget);
+        if (opt.scriptPath && !loadScript(script, opt.scriptPath, chip8))
+            return 1;
+#endif
+
+        // Timers tick once every ipf instructions in both modes, like the GUI
+        if (frames >= 0)
+            cycles = frames * ipf;
+        long long executed = 0;
+        long long frameCount = 0;
+        auto start = std::chrono::steady_clock::now();
+        if (moviePath && opt.seekFrame >= 0)
+        {
+            if (!seekMovie(movie, chip8, opt.seekFrame))
+            {
+                std::fprintf(stderr, "Movie has no frame %lld\n", opt.seekFrame);
+                return 1;
+            }
+            executed = static_cast<long long>(chip8.getCycleCount());
+            frameCount = opt.seekFrame;
+        }
+        else if (moviePath)
+        {
+            playMovie(movie, chip8);
+            executed = static_cast<long long>(chip8.getCycleCount());
+            frameCount = static_cast<long long>(movie.frameCount);
+        }
+        while (!moviePath && opt.vipTiming && frameCount < frames)
+        {
+            chip8.runVipFrame();
+            ++frameCount;
+            executed = static_cast<long long>(chip8.getCycleCount());
+            if (opt.videoPath)
+                recordFrame(video, chip8, frameCount, videoTone);
+        }
+        PcSampler sampler(chip8.getMemory().size());
+        auto run = [&](int count)
+        {
+            if (opt.tracePath || opt.coveragePath || opt.coverageImagePath)
+                stepCycles(chip8, opt.tracePath ? &trace : nullptr, &coverage, count);
+            else
+                chip8.emulateCycles(count);
+        };
+        while (!moviePath && !opt.vipTiming && executed < cycles)
+        {
+            int step = static_cast<int>(std::min<long long>(ipf, cycles - executed));
+            if (opt.sampleTop > 0)
+            {
+                const int at = sampler.sampleOffset(step);
+                run(at);
+                sampler.record(chip8.getPC());
+                run(step - at);
+            }
+            else
+                run(step);
+            executed += step;
+            if (step == ipf)
+            {
+                chip8.decrementTimers();
+                ++frameCount;
+                if (opt.videoPath)
+                    recordFrame(video, chip8, frameCount, videoTone);
+#if defined(CHIP8_LUA)
+                if (opt.scriptPath && !runScript(script, chip8, frameCount))
+                    return 1;
+#endif
+            }
+        }
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::printf("Ran %lld cycles (%lld frames) in %.3f s: %.2f M cycles/s\n", executed, frameCount,
+                    seconds, seconds > 0 ? executed / seconds / 1e6 : 0.0);
+        if (!opt.quiet)
+            dumpState(chip8);
+#if defined(CHIP8_PROFILE)
+        if (opt.profileTop > 0)
+            std::printf("\n%s", chip8.getProfile().report(static_cast<size_t>(opt.profileTop)).c_str());
+        if (opt.callsTop > 0)
+            std::printf("\n%s", chip8.getProfile().callReport(static_cast<size_t>(opt.callsTop)).c_str());
+        for (int byTime = 0; byTime < 2; ++byTime)
+        {
+            const char *path = byTime ? opt.flameTimePath : opt.flamePath;
+            if (path && !writeText(path, chip8.getProfile().collapsedStacks(byTime != 0)))
+            {
+                std::fprintf(stderr, "Failed to write collapsed stacks: %s\n", path);
+                return 1;
+            }
+        }
+#endif
+        if (opt.sampleTop > 0)
+            std::printf("\n%s", sampler.listing(chip8.getMemory().data(), static_cast<size_t>(opt.sampleTop)).c_str());
+        const auto &idle = chip8.getIdleStats();
+        if (idle.total() && chip8.getCycleCount())
+        {
+            const double share = 100.0 / static_cast<double>(chip8.getCycleCount());
+            std::printf("Idle: %.1f%% of instructions (key wait %.1f%%, delay timer polls %.1f%%, jumps to self %.1f%%, display wait %.1f%%)\n",
+                        share * idle.total(), share * idle.keyWait, share * idle.timerPoll, share * idle.selfJump, share * idle.displayWait);
+        }
+#if defined(CHIP8_LUA)
+        if (script.overruns())
+            std::printf("Script: %llu frames cut off at the budget of %d instructions\n", static_cast<unsigned long long>(script.overruns()), script.getBudget());
+#endif
+        const auto cache = chip8.getCodeCacheStats();
+        if (cache.codeWrites)
+            std::printf("Code cache: %llu writes into code, %llu invalidations, %llu recompiles\n", static_cast<unsigned long long>(cache.codeWrites),
+                        static_cast<unsigned long long>(cache.invalidations), static_cast<unsigned long long>(cache.recompiles));
+        if (opt.coveragePath || opt.coverageImagePath)
+            std::printf("Coverage: %zu instructions run, %zu bytes read as data\n", coverage.codeCount(), coverage.dataCount());
+        if (opt.coveragePath && !coverage.save(opt.coveragePath))
+        {
+            std::fprintf(stderr, "Failed to write coverage: %s\n", opt.coveragePath);
+            return 1;
+        }
+        if (opt.coverageImagePath && !coverage.writeImage(opt.coverageImagePath, chip8.getRomSize()))
+        {
+            std::fprintf(stderr, "Failed to write coverage image: %s\n", opt.coverageImagePath);
+            return 1;
+        }
+        if (opt.tracePath && !trace.stop())
+        {
+            std::fprintf(stderr, "Failed to write trace: %s\n", opt.tracePath);
+            return 1;
+        }
+        if (opt.videoPath && !video.stop())
+        {
+            std::fprintf(stderr, "Failed to write video: %s\n", opt.videoPath);
+            return 1;
+        }
+        if (opt.gifPath && !exportGif(opt.videoPath, opt.gifPath))
+        {
+            std::fprintf(stderr, "Failed to export GIF: %s\n", opt.gifPath);
+            return 1;
+        }
+        if (opt.wavPath && !exportWav(opt.videoPath, opt.wavPath))
+        {
+            std::fprintf(stderr, "Failed to export WAV: %s\n", opt.wavPath);
+            return 1;
+        }
+        if (saveStatePath && !chip8.saveStateFile(saveStatePath))
+        {
+            std::fprintf(stderr, "Failed to save state: %s\n", saveStatePath);
+            return 1;
+        }
+        return 0;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    bool ipfGiven = false;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--cycles" && hasValue)
+            opt.cycles = std::atoll(argv[++i]);
+        else if (arg == "--frames" && hasValue)
+            opt.frames = std::atoll(argv[++i]);
+        else if (arg == "--ipf" && hasValue)
+        {
+            opt.ipf = std::atoi(argv[++i]);
+            ipfGiven = true;
+        }
+        else if (arg == "--vip-timing")
+            opt.vipTiming = true;
+        else if (arg == "--core" && hasValue)
+        {
+            if (!parseCore(argv[++i], opt.core))
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if (arg == "--machine" && hasValue)
+            opt.machine = argv[++i];
+        else if (arg == "--load-state" && hasValue)
+            opt.loadStatePath = argv[++i];
+        else if (arg == "--save-state" && hasValue)
+            opt.saveStatePath = argv[++i];
+        else if (arg == "--movie" && hasValue)
+            opt.moviePath = argv[++i];
+        else if (arg == "--seek" && hasValue)
+            opt.seekFrame = std::atoll(argv[++i]);
+        else if (arg == "--video" && hasValue)
+            opt.videoPath = argv[++i];
+        else if (arg == "--gif" && hasValue)
+            opt.gifPath = argv[++i];
+        else if (arg == "--wav" && hasValue)
+            opt.wavPath = argv[++i];
+        else if (arg == "--trace" && hasValue)
+            opt.tracePath = argv[++i];
+        else if (arg == "--coverage" && hasValue)
+            opt.coveragePath = argv[++i];
+        else if (arg == "--coverage-image" && hasValue)
+            opt.coverageImagePath = argv[++i];
+        else if (arg == "--warm" && hasValue)
+            opt.warmPath = argv[++i];
+        else if (arg == "--quiet")
+            opt.quiet = true;
+        else if (arg == "--sample" && hasValue)
+            opt.sampleTop = std::atoi(argv[++i]);
+        else if (arg == "--whole-blocks")
+            opt.wholeBlocks = true;
+#if defined(CHIP8_PROFILE)
+        else if (arg == "--profile" && hasValue)
+            opt.profileTop = std::atoi(argv[++i]);
+        else if (arg == "--calls" && hasValue)
+            opt.callsTop = std::atoi(argv[++i]);
+        else if (arg == "--flame" && hasValue)
+            opt.flamePath = argv[++i];
+        else if (arg == "--flame-time" && hasValue)
+            opt.flameTimePath = argv[++i];
+#endif
+#if defined(CHIP8_LUA)
+        else if (arg == "--script" && hasValue)
+            opt.scriptPath = argv[++i];
+        else if (arg == "--script-budget" && hasValue)
+            opt.scriptBudget = std::atoi(argv[++i]);
+#endif
+        else if (arg[0] != '-' && !opt.romPath)
+            opt.romPath = argv[i];
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+
+    if (opt.machine == "auto" && opt.romPath)
+    {
+        opt.machine = "chip8";
+        if (const RomInfo *info = RomDatabase::findFile(opt.romPath))
+        {
+            const char *names[] = {"chip8", "vip", "chip48", "schip", "xochip"};
+            opt.machine = names[static_cast<int>(info->platform)];
+            if (!ipfGiven)
+                opt.ipf = info->ipf;
+            std::printf("Known ROM: %s (%s, %d IPF)\n", info->title, RomDatabase::platformName(info->platform), info->ipf);
+        }
+    }
+
+    // Movies are recorded on the classic machine only, videos on one-plane machines with 32 lo-res rows
+    if (!opt.romPath || opt.ipf <= 0 || (opt.moviePath && (opt.loadStatePath || opt.machine != "chip8")) || (opt.seekFrame >= 0 && !opt.moviePath) ||
+        (opt.vipTiming && (opt.frames < 0 || opt.moviePath)) ||
+        (opt.videoPath && (opt.frames < 0 || opt.moviePath || opt.machine == "xochip" || opt.machine == "hires")) || ((opt.gifPath || opt.wavPath) && !opt.videoPath) ||
+        ((opt.tracePath || opt.coveragePath || opt.coverageImagePath || opt.sampleTop > 0) && (opt.vipTiming || opt.moviePath)) ||
+        (opt.scriptPath && (opt.frames < 0 || opt.vipTiming || opt.moviePath || opt.machine != "chip8")))
+    {
+        usage();
+        return 1;
+    }
+    if (opt.machine == "megachip")
+    {
+        if (opt.vipTiming || opt.loadStatePath || opt.saveStatePath || opt.moviePath || opt.videoPath || opt.tracePath ||
+            opt.coveragePath || opt.coverageImagePath || opt.warmPath || opt.sampleTop > 0)
+        {
+            usage();
+            return 1;
+        }
+        return runMega(opt);
+    }
+    if (opt.machine == "chip8")
+        return run<Chip8>(opt);
+    if (opt.machine == "vip")
+        return run<VipChip8>(opt);
+    if (opt.machine == "chip48")
+        return run<Chip48>(opt);
+    if (opt.machine == "schip")
+        return run<SuperChip8>(opt);
+    if (opt.machine == "xochip")
+        return run<XoChip8>(opt);
+    if (opt.machine == "hires")
+        return run<HiresChip8>(opt);
+    if (opt.machine == "chip8x")
+        return run<Chip8X>(opt);
+    usage();
+    return 1;
+}
@@ -0,0 +1,105 @@
+#include "input_latency.h"
+#include <algorithm> // For std::sort
+#include <utility>   // For std::move
+
+namespace
+{
+    uint32_t micros(InputLatencyMeter::Clock::duration d)
+    {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    }
+
+    // Nearest-rank percentiles of values
+    InputLatencyPercentiles percentiles(std::vector<double> values)
+    {
+        InputLatencyPercentiles p;
+        if (values.empty())
+            return p;
+        std::sort(values.begin(), values.end());
+        auto rank = [&](double q)
+        {
+            size_t index = static_cast<size_t>(q * values.size());
+            return values[std::min(index, values.size() - 1)];
+        };
+        p.p50 = rank(0.50);
+        p.p90 = rank(0.90);
+        p.p99 = rank(0.99);
+        p.max = values.back();
+        return p;
+    }
+}
+
+void InputLatencyMeter::setEnabled(bool on)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (on && !enabled.load(std::memory_order_relaxed))
+        done.clear();
+    stage = Stage::Idle;
+    enabled.store(on, std::memory_order_relaxed);
+}
+
+bool InputLatencyMeter::keyPressed(Clock::time_point time, uint64_t cycle)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stage != Stage::Idle && time - pressTime < timeout)
+        return false;
+    stage = Stage::Pressed;
+    pressTime = time;
+    pressCycle = cycle;
+    probe = InputLatencySample();
+    return true;
+}
+
+void InputLatencyMeter::keyRead(int64_t cycle)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stage != Stage::Pressed || cycle < 0)
+        return;
+    probe.readCycles = static_cast<uint64_t>(cycle) >= pressCycle ? static_cast<uint64_t>(cycle) - pressCycle : 0;
+    stage = Stage::Read;
+}
+
+void InputLatencyMeter::framePublished(uint64_t sequence, bool changed)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stage != Stage::Read || !changed)
+        return;
+    probe.frameMicros = micros(Clock::now() - pressTime);
+    changedSequence = sequence;
+    stage = Stage::Changed;
+}
+
+void InputLatencyMeter::presented(uint64_t sequence)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stage != Stage::Changed || sequence < changedSequence)
+        return;
+    probe.presentMicros = micros(Clock::now() - pressTime);
+    done.push_back(probe);
+    stage = Stage::Idle;
+}
+
+std::vector<InputLatencySample> InputLatencyMeter::samples() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return done;
+}
+
+InputLatencySummary InputLatencyMeter::summary() const
+{
+    std::vector<InputLatencySample> all = samples();
+    std::vector<double> cycles, frame, present;
+    for (const InputLatencySample &s : all)
+    {
+        cycles.push_back(static_cast<double>(s.readCycles));
+        frame.push_back(s.frameMicros / 1000.0);
+        present.push_back(s.presentMicros / 1000.0);
+    }
+
+    InputLatencySummary summary;
+    summary.samples = all.size();
+    summary.readCycles = percentiles(std::move(cycles));
+    summary.frameMs = percentiles(std::move(frame));
+    summary.presentMs = percentiles(std::move(present));
+    return summary;
+}
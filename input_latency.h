@@ -0,0 +1,83 @@
+#ifndef INPUT_LATENCY_H
+#define INPUT_LATENCY_H
+
+#include <atomic>  // For the enabled flag
+#include <chrono>  // For the probe timestamps
+#include <cstddef> // For size_t
+#include <cstdint> // For the counters
+#include <mutex>   // For the probe shared by both threads
+#include <vector>  // For the samples
+
+// One key press followed to the screen
+struct InputLatencySample
+{
+    uint64_t readCycles = 0;    // Instructions from applying the key to the core first reading it
+    uint32_t frameMicros = 0;   // Key event to publishing the first frame that changed after the read
+    uint32_t presentMicros = 0; // Key event to that frame's present returning
+};
+
+struct InputLatencyPercentiles
+{
+    double p50 = 0;
+    double p90 = 0;
+    double p99 = 0;
+    double max = 0;
+};
+
+struct InputLatencySummary
+{
+    size_t samples = 0;
+    InputLatencyPercentiles readCycles;
+    InputLatencyPercentiles frameMs;
+    InputLatencyPercentiles presentMs;
+};
+
+// Measures input-to-photon latency one key press at a time. A press with
+// no probe in flight starts one: the emulation thread reports when the
+// core first reads the key (EX9E, EXA1 or FX0A) and the first published
+// frame whose screen changed after that, and the GUI thread reports when
+// it presented that frame or a newer one. Presses while a probe is in
+// flight are not measured; a probe nothing answers within timeout is
+// dropped. Probes are a few per second, so a mutex is cheap enough.
+class InputLatencyMeter
+{
+public:
+    using Clock = std::chrono::steady_clock;
+    static constexpr Clock::duration timeout = std::chrono::seconds(1);
+
+    // Turning it on starts over with no samples
+    void setEnabled(bool on);
+    bool isEnabled() const { return enabled.load(std::memory_order_relaxed); }
+
+    // Emulation thread. keyPressed returns true if it started a probe, for
+    // which the caller watches the core's reads of the key.
+    bool keyPressed(Clock::time_point time, uint64_t cycle);
+    void keyRead(int64_t cycle);
+    void framePublished(uint64_t sequence, bool changed);
+
+    // GUI thread, after the frame with this sequence went to the screen
+    void presented(uint64_t sequence);
+
+    std::vector<InputLatencySample> samples() const;
+    InputLatencySummary summary() const;
+
+private:
+    enum class Stage
+    {
+        Idle,
+        Pressed, // Waiting for the core to read the key
+        Read,    // Waiting for the screen to change
+        Changed  // Waiting for the GUI to present the changed frame
+    };
+
+    std::atomic<bool> enabled{false};
+    mutable std::mutex mutex;
+    Stage stage = Stage::Idle;
+    Clock::time_point pressTime;
+    uint64_t pressCycle = 0;
+    InputLatencySample probe;
+    uint64_t changedSequence = 0;
+    std::vector<InputLatencySample> done;
+};
+
+#endif
@@ -0,0 +1,131 @@
+#include "legacy_screen_renderer.h"
+#include "chip8_simd.h"
+#include <utility> // For std::move
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+
+LegacyScreenRenderer::LegacyScreenRenderer(std::function<void()> swap)
+    : swapBuffers(std::move(swap))
+{
+}
+
+LegacyScreenRenderer::~LegacyScreenRenderer()
+{
+    if (screenTexture != 0)
+        glDeleteTextures(1, &screenTexture);
+}
+
+// False without a working context, which broken drivers give as no
+// version string or an error on the first texture
+bool LegacyScreenRenderer::init()
+{
+    if (!glGetString(GL_VERSION))
+        return false;
+    glGenTextures(1, &screenTexture);
+    glBindTexture(GL_TEXTURE_2D, screenTexture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, 128, 64, 0, GL_ALPHA, GL_UNSIGNED_BYTE, nullptr);
+    textureStale = true;
+    return glGetError() == GL_NO_ERROR;
+}
+
+void LegacyScreenRenderer::resize(int width, int height)
+{
+    windowWidth = width;
+    windowHeight = height;
+    glViewport(0, 0, width, height);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0, 64, 32, 0, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+}
+
+// Expand changed rows to one alpha byte per pixel, one upload per run of rows
+void LegacyScreenRenderer::upload(const Framebuffer &gfx)
+{
+    const int words = Chip8::rowWords;
+    uint64_t dirty = 0;
+    for (int y = 0; y < 64; ++y)
+    {
+        if (textureStale || gfx[y * words] != uploaded[y * words] || gfx[y * words + 1] != uploaded[y * words + 1])
+            dirty |= 1ull << y;
+    }
+    textureStale = false;
+    uploaded = gfx;
+    if (dirty == 0)
+        return;
+
+    std::array<uint8_t, 128 * 64> texels;
+    glBindTexture(GL_TEXTURE_2D, screenTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    int y = 0;
+    while (y < 64)
+    {
+        if (!(dirty & (1ull << y)))
+        {
+            ++y;
+            continue;
+        }
+        int first = y;
+        for (; y < 64 && (dirty & (1ull << y)); ++y)
+            simd::expandBits(&texels[y * 128], &gfx[y * words], 128, 0, 255);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, first, 128, y - first, GL_ALPHA, GL_UNSIGNED_BYTE, &texels[first * 128]);
+    }
+}
+
+void LegacyScreenRenderer::draw(bool hires, const Color &off, const Color &on, bool)
+{
+    // Black bars around a whole-number scale, the unlit colour under the picture
+    glDisable(GL_SCISSOR_TEST);
+    glViewport(0, 0, windowWidth, windowHeight);
+    if (integerScale)
+    {
+        const Viewport picture = integerViewport(windowWidth, windowHeight, hires);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glViewport(picture.x, picture.y, picture.width, picture.height);
+        glScissor(picture.x, picture.y, picture.width, picture.height);
+        glEnable(GL_SCISSOR_TEST);
+    }
+    glClearColor(off[0], off[1], off[2], 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+
+    // Lo-res screens sit in the texture's top-left quarter
+    float texExtent = hires ? 1.0f : 0.5f;
+
+    // Lit pixels take the lit colour, unlit ones let the clear colour through
+    glColor3f(on[0], on[1], on[2]);
+    glBindTexture(GL_TEXTURE_2D, screenTexture);
+    glEnable(GL_TEXTURE_2D);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_MODULATE);
+
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 0.0f);
+    glVertex2f(0.0f, 0.0f);
+    glTexCoord2f(texExtent, 0.0f);
+    glVertex2f(64.0f, 0.0f);
+    glTexCoord2f(texExtent, texExtent);
+    glVertex2f(64.0f, 32.0f);
+    glTexCoord2f(0.0f, texExtent);
+    glVertex2f(0.0f, 32.0f);
+    glEnd();
+
+    glDisable(GL_BLEND);
+    glDisable(GL_TEXTURE_2D);
+}
+
+bool LegacyScreenRenderer::present()
+{
+    swapBuffers();
+    return true;
+}
@@ -0,0 +1,38 @@
+#ifndef LEGACY_SCREEN_RENDERER_H
+#define LEGACY_SCREEN_RENDERER_H
+
+#include "screen_backend.h"
+#include <functional> // For the swap callback
+
+// Fixed-function OpenGL fallback for contexts without 3.3 core: an alpha
+// texture of the display drawn as one modulated quad. Changed rows are
+// expanded to a byte per pixel and uploaded in runs. No effects.
+class LegacyScreenRenderer : public ScreenBackend
+{
+public:
+    explicit LegacyScreenRenderer(std::function<void()> swap);
+    ~LegacyScreenRenderer() override;
+
+    LegacyScreenRenderer(const LegacyScreenRenderer &) = delete;
+    LegacyScreenRenderer &operator=(const LegacyScreenRenderer &) = delete;
+
+    bool init() override;
+    const char *name() const override { return "OpenGL fixed function"; }
+
+    void resize(int width, int height) override;
+    void setIntegerScale(bool on) override { integerScale = on; }
+    void upload(const Framebuffer &gfx) override;
+    void draw(bool hires, const Color &off, const Color &on, bool newFrame) override;
+    bool present() override;
+
+private:
+    std::function<void()> swapBuffers;
+    unsigned screenTexture = 0; // 128x64 alpha texture of the display
+    Framebuffer uploaded{};     // Frame the texture currently holds
+    bool textureStale = true;   // Texture was just created, upload everything
+    int windowWidth = 0;
+    int windowHeight = 0;
+    bool integerScale = false;
+};
+
+#endif
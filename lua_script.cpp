@@ -0,0 +1,290 @@
+#include "lua_script.h"
+#include <lua.hpp>
+
+// The script's LuaScript sits in the state's extra space, which threads
+// the script creates inherit
+LuaScript &LuaScript::self(lua_State *L)
+{
+    return **static_cast<LuaScript **>(lua_getextraspace(L));
+}
+
+LuaScript::~LuaScript()
+{
+    unload();
+}
+
+bool LuaScript::load(const std::string &path, Chip8 &chip8, std::string &error)
+{
+    unload();
+    overBudget = 0;
+    output.clear();
+    L = luaL_newstate();
+    if (!L)
+    {
+        error = "Out of memory";
+        return false;
+    }
+    *static_cast<LuaScript **>(lua_getextraspace(L)) = this;
+    luaL_openlibs(L);
+    lua_pushcfunction(L, print);
+    lua_setglobal(L, "print");
+
+    static const luaL_Reg functions[] = {
+        {"pc", pc},
+        {"i", index},
+        {"sp", sp},
+        {"delay", delay},
+        {"sound", sound},
+        {"cycles", cycles},
+        {"pixel", pixel},
+        {"width", width},
+        {"height", height},
+        {"key", key},
+        {"press", press},
+        {"release", release},
+        {nullptr, nullptr}};
+    luaL_newlib(L, functions);
+
+    // Views: empty tables whose metatables index the machine
+    static const luaL_Reg memoryView[] = {{"__index", memoryIndex}, {"__newindex", memoryNewIndex}, {"__len", memoryLength}, {nullptr, nullptr}};
+    static const luaL_Reg registerView[] = {{"__index", registerIndex}, {"__newindex", readOnly}, {nullptr, nullptr}};
+    lua_newtable(L);
+    luaL_newlib(L, memoryView);
+    lua_setmetatable(L, -2);
+    lua_setfield(L, -2, "memory");
+    lua_newtable(L);
+    luaL_newlib(L, registerView);
+    lua_setmetatable(L, -2);
+    lua_setfield(L, -2, "V");
+    lua_setglobal(L, "chip8");
+
+    int status = luaL_loadfilex(L, path.c_str(), "t");
+    if (status == LUA_OK)
+    {
+        machine = &chip8;
+        if (call(0, error))
+        {
+            loaded = true;
+            return true;
+        }
+    }
+    else
+    {
+        error = lua_tostring(L, -1);
+    }
+    unload();
+    return false;
+}
+
+void LuaScript::unload()
+{
+    if (L)
+        lua_close(L);
+    L = nullptr;
+    loaded = false;
+}
+
+bool LuaScript::runFrame(Chip8 &chip8, uint64_t frame, std::string &error)
+{
+    if (!loaded)
+    {
+        error = "No script loaded";
+        return false;
+    }
+    if (lua_getglobal(L, "on_frame") != LUA_TFUNCTION)
+    {
+        lua_pop(L, 1);
+        return true;
+    }
+    lua_pushinteger(L, static_cast<lua_Integer>(frame));
+    machine = &chip8;
+    if (call(1, error))
+        return true;
+    if (cutOff)
+    {
+        ++overBudget;
+        return true;
+    }
+    unload();
+    return false;
+}
+
+std::vector<std::string> LuaScript::takeOutput()
+{
+    std::vector<std::string> lines;
+    lines.swap(output);
+    return lines;
+}
+
+// The function and its arguments are on the stack
+bool LuaScript::call(int args, std::string &error)
+{
+    touched = false;
+    cutOff = false;
+    lua_sethook(L, budgetHook, LUA_MASKCOUNT, budget);
+    const int status = lua_pcall(L, args, 0, 0);
+    lua_sethook(L, nullptr, 0, 0);
+    machine = nullptr;
+    if (status == LUA_OK)
+        return true;
+    const char *message = lua_tostring(L, -1);
+    error = message ? message : "Script error";
+    lua_pop(L, 1);
+    return false;
+}
+
+// Fires once the call has run its budget. From then on it fires on every
+// instruction, so a pcall in the script can't catch the error and go on.
+void LuaScript::budgetHook(lua_State *L, lua_Debug *)
+{
+    LuaScript &script = self(L);
+    if (!script.cutOff)
+    {
+        script.cutOff = true;
+        lua_sethook(L, budgetHook, LUA_MASKCOUNT, 1);
+    }
+    luaL_error(L, "ran past its budget of %d instructions", script.budget);
+}
+
+namespace
+{
+    int checkRange(lua_State *L, int arg, size_t size, const char *what)
+    {
+        const lua_Integer value = luaL_checkinteger(L, arg);
+        luaL_argcheck(L, value >= 0 && static_cast<uint64_t>(value) < size, arg, what);
+        return static_cast<int>(value);
+    }
+}
+
+int LuaScript::memoryIndex(lua_State *L)
+{
+    const auto &memory = self(L).machine->getMemory();
+    lua_pushinteger(L, memory[checkRange(L, 2, memory.size(), "address out of range")]);
+    return 1;
+}
+
+int LuaScript::memoryNewIndex(lua_State *L)
+{
+    LuaScript &script = self(L);
+    const int addr = checkRange(L, 2, Chip8::memorySize, "address out of range");
+    script.machine->pokeMemory(static_cast<uint16_t>(addr), static_cast<uint8_t>(luaL_checkinteger(L, 3)));
+    script.touched = true;
+    return 0;
+}
+
+int LuaScript::memoryLength(lua_State *L)
+{
+    lua_pushinteger(L, static_cast<lua_Integer>(Chip8::memorySize));
+    return 1;
+}
+
+int LuaScript::registerIndex(lua_State *L)
+{
+    lua_pushinteger(L, self(L).machine->getV()[checkRange(L, 2, 16, "no such register")]);
+    return 1;
+}
+
+int LuaScript::readOnly(lua_State *L)
+{
+    return luaL_error(L, "registers are read-only");
+}
+
+int LuaScript::pc(lua_State *L)
+{
+    lua_pushinteger(L, self(L).machine->getPC());
+    return 1;
+}
+
+int LuaScript::index(lua_State *L)
+{
+    lua_pushinteger(L, self(L).machine->getI());
+    return 1;
+}
+
+int LuaScript::sp(lua_State *L)
+{
+    lua_pushinteger(L, self(L).machine->getSP());
+    return 1;
+}
+
+int LuaScript::delay(lua_State *L)
+{
+    lua_pushinteger(L, self(L).machine->getDelayTimer());
+    return 1;
+}
+
+int LuaScript::sound(lua_State *L)
+{
+    lua_pushinteger(L, self(L).machine->getSoundTimer());
+    return 1;
+}
+
+int LuaScript::cycles(lua_State *L)
+{
+    lua_pushinteger(L, static_cast<lua_Integer>(self(L).machine->getCycleCount()));
+    return 1;
+}
+
+int LuaScript::pixel(lua_State *L)
+{
+    const Chip8 &chip8 = *self(L).machine;
+    const int x = checkRange(L, 1, static_cast<size_t>(chip8.width()), "x out of range");
+    const int y = checkRange(L, 2, static_cast<size_t>(chip8.height()), "y out of range");
+    lua_pushboolean(L, chip8.pixel(x, y));
+    return 1;
+}
+
+int LuaScript::width(lua_State *L)
+{
+    lua_pushinteger(L, self(L).machine->width());
+    return 1;
+}
+
+int LuaScript::height(lua_State *L)
+{
+    lua_pushinteger(L, self(L).machine->height());
+    return 1;
+}
+
+int LuaScript::key(lua_State *L)
+{
+    lua_pushboolean(L, self(L).machine->keys[checkRange(L, 1, 16, "no such key")]);
+    return 1;
+}
+
+int LuaScript::press(lua_State *L)
+{
+    LuaScript &script = self(L);
+    script.machine->setKey(checkRange(L, 1, 16, "no such key"), true);
+    script.touched = true;
+    return 0;
+}
+
+int LuaScript::release(lua_State *L)
+{
+    LuaScript &script = self(L);
+    script.machine->setKey(checkRange(L, 1, 16, "no such key"), false);
+    script.touched = true;
+    return 0;
+}
+
+// Like the standard print, tab-separated, into a line for the host. The
+// text is built in a Lua buffer: a __tostring error unwinds past it.
+int LuaScript::print(lua_State *L)
+{
+    const int n = lua_gettop(L);
+    luaL_Buffer line;
+    luaL_buffinit(L, &line);
+    for (int i = 1; i <= n; ++i)
+    {
+        if (i > 1)
+            luaL_addchar(&line, '\t');
+        luaL_tolstring(L, i, nullptr);
+        luaL_addvalue(&line);
+    }
+    luaL_pushresult(&line);
+    size_t length = 0;
+    const char *text = lua_tolstring(L, -1, &length);
+    self(L).output.emplace_back(text, length);
+    return 0;
+}
@@ -0,0 +1,106 @@
+#ifndef LUA_SCRIPT_H
+#define LUA_SCRIPT_H
+
+#include "chip8.h"
+#include <cstdint> // For the frame number and counters
+#include <string>  // For paths, errors and output
+#include <vector>  // For the printed lines
+
+struct lua_State;
+struct lua_Debug;
+
+// A Lua 5.4 script run at frame boundaries, for memory watches, bots and
+// status text. Loading runs the file once; after that the emulator calls
+// its global on_frame(frame) at the end of every frame, with the machine
+// stopped between instructions. The script sees the machine through the
+// global chip8 table:
+//
+//   chip8.memory[addr]        a byte of memory, read in place; assigning
+//                             one writes it as a cheat would (pokeMemory)
+//   chip8.V[x]                register Vx, read-only
+//   chip8.pc() chip8.i() chip8.sp() chip8.delay() chip8.sound()
+//   chip8.cycles()            instructions run since reset
+//   chip8.pixel(x, y)         true if the pixel is lit
+//   chip8.width() chip8.height()
+//   chip8.key(k) chip8.press(k) chip8.release(k)
+//
+// The views are tables with metamethods that index the machine's own
+// arrays, so nothing is copied into the VM per frame. print() collects
+// lines for the host rather than writing to stdout.
+//
+// Every call into the script, loading included, runs under a budget of
+// VM instructions. A frame that runs past it is cut off where it stands,
+// so a slow or stuck script costs the emulation thread at most the budget
+// per frame; the script stays loaded and the next frame starts afresh.
+// Any other error stops it. Built only with CHIP8_LUA.
+class LuaScript
+{
+public:
+    static constexpr int defaultBudget = 100000; // Well under a millisecond
+
+    LuaScript() = default;
+    ~LuaScript();
+    LuaScript(const LuaScript &) = delete;
+    LuaScript &operator=(const LuaScript &) = delete;
+
+    // Replaces any script with the file and runs its top level. False with
+    // the reason in error, and no script is loaded.
+    bool load(const std::string &path, Chip8 &machine, std::string &error);
+    bool isLoaded() const { return loaded; }
+
+    // Drops the script and everything it kept; its output stays to take
+    void unload();
+
+    void setBudget(int instructions) { budget = instructions > 0 ? instructions : defaultBudget; }
+    int getBudget() const { return budget; }
+
+    // Calls on_frame(frame), if the script defines it. False once the
+    // script has stopped, with the reason in error; a frame cut off at the
+    // budget still returns true.
+    bool runFrame(Chip8 &machine, uint64_t frame, std::string &error);
+
+    // Whether the last call wrote memory or changed a key, which the
+    // debugger's history can't replay
+    bool touchedMachine() const { return touched; }
+
+    // Frames cut off at the budget since loading
+    uint64_t overruns() const { return overBudget; }
+
+    // Lines printed since the last call, oldest first
+    std::vector<std::string> takeOutput();
+
+private:
+    bool call(int args, std::string &error);
+
+    static int memoryIndex(lua_State *L);
+    static int memoryNewIndex(lua_State *L);
+    static int memoryLength(lua_State *L);
+    static int registerIndex(lua_State *L);
+    static int readOnly(lua_State *L);
+    static int pc(lua_State *L);
+    static int index(lua_State *L);
+    static int sp(lua_State *L);
+    static int delay(lua_State *L);
+    static int sound(lua_State *L);
+    static int cycles(lua_State *L);
+    static int pixel(lua_State *L);
+    static int width(lua_State *L);
+    static int height(lua_State *L);
+    static int key(lua_State *L);
+    static int press(lua_State *L);
+    static int release(lua_State *L);
+    static int print(lua_State *L);
+    static void budgetHook(lua_State *L, lua_Debug *ar);
+    static LuaScript &self(lua_State *L);
+
+    lua_State *L = nullptr;
+    Chip8 *machine = nullptr; // Set for the length of each call
+    int budget = defaultBudget;
+    bool loaded = false;
+    bool touched = false;
+    bool cutOff = false; // The budget hook raised the error unwinding the call
+    uint64_t overBudget = 0;
+    std::vector<std::string> output;
+};
+
+#endif
@@ -1,10 +1,57 @@
+#include "boot_cache.h"
+#include "cheat_engine.h"
 #include "chip8.h"
-#include <SDL2/SDL.h>
+#include "chip8_disasm.h"
+#include "emulation_thread.h"
+#include "event_log.h"
+#include "audio_output.h"
+#include "frame_metrics.h"
+#include "gamepad.h"
+#include "screen_renderer.h"
+#include "settings_store.h"
+#include "speed_tuner.h"
+#include "thread_tuning.h"
+#include "legacy_screen_renderer.h"
+#include "memory_map_renderer.h"
+#include "profile_zones.h"
+#include "software_screen_renderer.h"
+#include "raw_keyboard.h"
+#if defined(_WIN32)
+#include "d3d11_screen_renderer.h"
+#endif
+#include "rom_archive.h"
+#include "rom_cache.h"
+#include "rom_database.h"
+#include "rom_prefetch.h"
+#include "rom_scanner.h"
+#include "screenshot_writer.h"
+#include "wall_renderer.h"
 #include <wx/wx.h>
 #include <wx/glcanvas.h>
 #include <wx/dir.h>
-#include <vector>
+#include <wx/numdlg.h>
+#include <wx/textdlg.h>
+#include <wx/filename.h>
+#include <wx/stdpaths.h>
+#include <wx/listctrl.h>
+#include <wx/srchctrl.h>
+#include <wx/config.h>
+#include <wx/checklst.h>
+#include <wx/cmdline.h>
+#include <wx/ffile.h>
+#include <wx/fswatcher.h>
+#include <wx/datetime.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <functional>
 #include <memory>
+#include <random>
+#include <thread>
+#include <unordered_map>
+#include <vector>
 
 // -------------------------
 // IDs for speed menu items
@@ -14,18 +61,161 @@ enum
     ID_SPEED_FASTEST = wxID_HIGHEST + 1,
     ID_SPEED_FAST,
     ID_SPEED_NORMAL,
-    ID_SPEED_SLOW
+    ID_SPEED_SLOW,
+    ID_SPEED_1MHZ,
+    ID_SPEED_UNTHROTTLED,
+    ID_SPEED_VIP,
+    ID_SPEED_CUSTOM
 };
 
 enum
 {
     ID_SCREEN_CLASSIC = wxID_HIGHEST + 10,
-    ID_SCREEN_GREEN
+    ID_SCREEN_GREEN,
+    ID_SCREEN_SCANLINES,
+    ID_SCREEN_PHOSPHOR,
+    ID_SCREEN_BLOOM,
+    ID_SCREEN_BLEND,
+    ID_RENDERER_OPENGL,
+    ID_RENDERER_D3D11,
+    ID_RENDERER_SOFTWARE,
+    ID_SCREEN_WHOLE
+};
+
+enum
+{
+    ID_FF_OFF = wxID_HIGHEST + 20,
+    ID_FF_10X,
+    ID_FF_100X,
+    ID_FF_UNLIMITED,
+    ID_RUN_AHEAD_OFF,
+    ID_RUN_AHEAD_1,
+    ID_RUN_AHEAD_2
+};
+
+enum
+{
+    ID_SAVE_STATE = wxID_HIGHEST + 30,
+    ID_LOAD_STATE,
+    ID_RECORD_MOVIE,
+    ID_STOP_MOVIE,
+    ID_HOST_NETPLAY,
+    ID_JOIN_NETPLAY,
+    ID_STOP_NETPLAY,
+    ID_AUTOSAVE
+};
+
+enum
+{
+    ID_SHOW_METRICS = wxID_HIGHEST + 40,
+    ID_SAVE_METRICS,
+    ID_METRICS_TIMER,
+    ID_NETPLAY_TIMER,
+    ID_MEASURE_LATENCY,
+    ID_SAMPLE_PC,
+    ID_SAVE_PC_SAMPLES
+};
+
+enum
+{
+    ID_OPEN_WALL = wxID_HIGHEST + 50,
+    ID_SHARE_FRAMES,
+    ID_RECORD_VIDEO,
+    ID_STOP_VIDEO,
+    ID_EXPORT_VIDEO,
+    ID_DEBUGGER,
+    ID_RAW_KEYBOARD,
+    ID_GAMEPAD,
+    ID_GAMEPAD_MAPPING,
+    ID_KEYBOARD_MAPPING
+};
+
+enum
+{
+    ID_BOOT_OFF = wxID_HIGHEST + 60,
+    ID_BOOT_ON,
+    ID_BOOT_SAME_SEED
+};
+
+enum
+{
+    ID_WATCH_ROM = wxID_HIGHEST + 70,
+    ID_WATCH_KEEP_STATE,
+    ID_RELOAD_TIMER
+};
+
+enum
+{
+    ID_AUTO_TUNE = wxID_HIGHEST + 80,
+    ID_AUTO_TUNE_NEW
+};
+
+enum
+{
+    ID_AUDIO_128 = wxID_HIGHEST + 85,
+    ID_AUDIO_256,
+    ID_AUDIO_512,
+    ID_AUDIO_1024
+};
+
+enum
+{
+    ID_CHEATS = wxID_HIGHEST + 90,
+    ID_LOAD_SCRIPT,
+    ID_STOP_SCRIPT,
+    ID_SCRIPT_TIMER
+};
+
+enum
+{
+    ID_UPSCALE_NONE = wxID_HIGHEST + 95,
+    ID_UPSCALE_SCALE2X,
+    ID_UPSCALE_XBR,
+    ID_FULLSCREEN,
+    ID_FULLSCREEN_EXCLUSIVE
+};
+
+enum
+{
+    ID_RUN_HIDDEN = wxID_HIGHEST + 100,
+    ID_THREAD_PRIORITY,
+    ID_THREAD_CORES
+};
+
+enum
+{
+    ID_KEYS_PRESET = wxID_HIGHEST + 105 // One per KeyMap preset from here
+};
+
+enum
+{
+    ID_SCREENSHOT = wxID_HIGHEST + 115,
+    ID_SCREENSHOT_1X,
+    ID_SCREENSHOT_2X,
+    ID_SCREENSHOT_4X,
+    ID_SCREENSHOT_8X
+};
+
+enum
+{
+    ID_WALL_SOUND_OFF = wxID_HIGHEST + 120,
+    ID_WALL_SOUND_SELECTED,
+    ID_WALL_SOUND_ALL
 };
 
 // Forward declare our GLCanvas
 class Chip8Canvas;
 
+// Settings from the command line for a game started without the launcher
+struct LaunchOptions
+{
+    double clockHz = -1; // Instructions per second, -1 for the default or the ROM database's speed
+    bool vipTiming = false;
+    wxString palette; // "classic" or "green", empty for the default
+    bool fullscreen = false;
+    bool autosave = false; // Resume and keep saving whatever the menu says
+};
+
 // -------------------------
 // Main application class
 // -------------------------
@@ -33,62 +223,224 @@ class Chip8App : public wxApp
 {
 public:
     virtual bool OnInit() override;
+    virtual void OnInitCmdLine(wxCmdLineParser &parser) override;
+    virtual bool OnCmdLineParsed(wxCmdLineParser &parser) override;
+
+private:
+    wxString romPath; // Empty opens the launcher
+    LaunchOptions launch;
+};
+
+// Host key of each CHIP-8 key 0-F: the 4x4 block from 1 to V stands in
+// for the keypad
+static const char defaultKeyLayout[] = "X123QWEASDZC4RFV";
+
+// CHIP-8 key of every host key code, so translating a key event is one
+// table load. Codes are wx key codes: letters and digits as upper-case
+// ASCII, the keypad, arrows and the rest their WXK_ values, all under
+// 512. Set on the GUI thread, read by the raw keyboard thread too.
+class KeyMap
+{
+public:
+    static constexpr int codes = 512;
+    using Layout = std::array<uint16_t, 16>; // wx key code of each CHIP-8 key, 0 for the default's
+
+    struct Preset
+    {
+        const char *name;
+        Layout keys;
+    };
+
+    // The same hand positions on other keyboards, and the numeric keypad
+    // with / * - + . and Enter for A to F
+    static const std::array<Preset, 4> &presets()
+    {
+        static const std::array<Preset, 4> list = {{
+            {"QWERTY", fromText(defaultKeyLayout)},
+            {"AZERTY", fromText("X123AZEQSDWC4RFV")},
+            {"QWERTZ", fromText("X123QWEASDYC4RFV")},
+            {"Numeric Keypad", {WXK_NUMPAD0, WXK_NUMPAD1, WXK_NUMPAD2, WXK_NUMPAD3, WXK_NUMPAD4, WXK_NUMPAD5, WXK_NUMPAD6,
+                                WXK_NUMPAD7, WXK_NUMPAD8, WXK_NUMPAD9, WXK_NUMPAD_DIVIDE, WXK_NUMPAD_MULTIPLY, WXK_NUMPAD_SUBTRACT,
+                                WXK_NUMPAD_ADD, WXK_NUMPAD_DECIMAL, WXK_NUMPAD_ENTER}},
+        }};
+        return list;
+    }
+
+    // 16 letters and digits, as the Keyboard Mapping dialog takes them
+    static Layout fromText(const char *text)
+    {
+        Layout keys{};
+        for (int key = 0; key < 16 && text[key]; ++key)
+            keys[key] = static_cast<uint8_t>(text[key]);
+        return keys;
+    }
+
+#if defined(_WIN32)
+    // The wx code of a Windows virtual-key code; only the keypad and the
+    // arrows differ. Raw input doesn't tell the two Enter keys apart, so
+    // either is the keypad's.
+    static int fromVirtualKey(int vk)
+    {
+        if (vk >= 0x60 && vk <= 0x69) // VK_NUMPAD0-9
+            return WXK_NUMPAD0 + (vk - 0x60);
+        switch (vk)
+        {
+        case 0x0D: return WXK_NUMPAD_ENTER;    // VK_RETURN
+        case 0x25: return WXK_LEFT;            // VK_LEFT
+        case 0x26: return WXK_UP;              // VK_UP
+        case 0x27: return WXK_RIGHT;           // VK_RIGHT
+        case 0x28: return WXK_DOWN;            // VK_DOWN
+        case 0x6A: return WXK_NUMPAD_MULTIPLY; // VK_MULTIPLY
+        case 0x6B: return WXK_NUMPAD_ADD;      // VK_ADD
+        case 0x6D: return WXK_NUMPAD_SUBTRACT; // VK_SUBTRACT
+        case 0x6E: return WXK_NUMPAD_DECIMAL;  // VK_DECIMAL
+        case 0x6F: return WXK_NUMPAD_DIVIDE;   // VK_DIVIDE
+        }
+        return vk;
+    }
+#endif
+
+    KeyMap() { set({}); }
+
+    void set(const Layout &keys)
+    {
+        for (std::atomic<int8_t> &key : table)
+            key.store(-1, std::memory_order_relaxed);
+        for (int key = 0; key < 16; ++key)
+        {
+            const uint16_t code = keys[key] ? keys[key] : static_cast<uint8_t>(defaultKeyLayout[key]);
+            if (code < codes)
+                table[code].store(static_cast<int8_t>(key), std::memory_order_relaxed);
+        }
+    }
+
+    // -1 if code presses no CHIP-8 key
+    int keyFor(int code) const { return code >= 0 && code < codes ? table[code].load(std::memory_order_relaxed) : -1; }
+
+private:
+    std::array<std::atomic<int8_t>, codes> table;
+};
+
+static_assert(WXK_NUMPAD_DIVIDE < KeyMap::codes && WXK_NUMPAD_ENTER < KeyMap::codes, "keypad codes fit the table");
+
+// Global and per-ROM preferences, read once at startup (see Chip8App::OnInit)
+static SettingsStore &Preferences()
+{
+    static SettingsStore store;
+    return store;
+}
+
+// One GL context for every window that draws with OpenGL. A wxGLContext
+// can be made current on any canvas with the same pixel format, which all
+// of ours have, so shader programs, buffers and vertex arrays made on it
+// serve every window, and another game window costs only its textures.
+// The first canvas to need it creates it and the last one deletes it.
+struct SharedGlContext
+{
+    std::unique_ptr<wxGLContext> context;
+    ScreenRenderer::SharedCache screenPrograms; // Built by the first game window's renderer
 };
 
+// The 3.3 core context, or the compatibility one drivers without it fall
+// back to, created on canvas if no window holds it yet. Check IsOK().
+static std::shared_ptr<SharedGlContext> AcquireGlContext(wxGLCanvas *canvas, bool core)
+{
+    static std::weak_ptr<SharedGlContext> alive[2];
+    std::weak_ptr<SharedGlContext> &slot = alive[core ? 1 : 0];
+    if (std::shared_ptr<SharedGlContext> shared = slot.lock())
+        return shared;
+    std::shared_ptr<SharedGlContext> shared = std::make_shared<SharedGlContext>();
+    if (core)
+    {
+        wxGLContextAttrs attrs;
+        attrs.CoreProfile().OGLVersion(3, 3).EndList();
+        shared->context = std::make_unique<wxGLContext>(canvas, nullptr, &attrs);
+    }
+    else
+        shared->context = std::make_unique<wxGLContext>(canvas);
+    slot = shared;
+    return shared;
+}
+
 // -------------------------
-// OpenGL canvas
+// Display canvas (OpenGL, or Direct3D on Windows)
 // -------------------------
 class Chip8Canvas : public wxGLCanvas
 {
 public:
-    Chip8Canvas(wxWindow *parent, Chip8 &chip8Ref)
+    // Every canvas runs its own machine, so game windows never share state
+    explicit Chip8Canvas(wxWindow *parent)
         : wxGLCanvas(parent, wxID_ANY, nullptr),
-          chip8(chip8Ref)
+          machine(std::make_unique<Chip8>()),
+          emulation(*machine),
+          audio(emulation.soundState(), static_cast<int>(wxConfigBase::Get()->ReadLong("/Audio/BufferSamples", AudioOutput::defaultBufferSamples)))
     {
-        context = new wxGLContext(this);
-
-        // Default speed: Normal
-        emulationDelay = 2;
+        // Shader renderer on a 3.3 core context, fixed function where that's
+        // missing. Direct3D, if chosen, leaves the context unused.
+        sharedGl = AcquireGlContext(this, true);
+        coreContext = sharedGl->context->IsOK();
+        if (!coreContext)
+            sharedGl = AcquireGlContext(this, false);
+        context = sharedGl->context.get();
 
-        // Timer for updates
+        // Emulation runs on the scheduler's workers (see StartEmulation)
+        // against their own clock. Presentation follows the monitor once vsync is on (see
+        // OnIdle); until then, or without it, the timer polls for frames
+        // several times per refresh so none waits long or beats against it.
         timer.SetOwner(this);
-        timer.Start(1000 / 60); // 60 Hz
+        timer.Start(4);
         Bind(wxEVT_TIMER, &Chip8Canvas::OnTimer, this);
+        Bind(wxEVT_IDLE, &Chip8Canvas::OnIdle, this);
         Bind(wxEVT_PAINT, &Chip8Canvas::OnPaint, this);
         Bind(wxEVT_KEY_DOWN, &Chip8Canvas::OnKeyDown, this);
         Bind(wxEVT_KEY_UP, &Chip8Canvas::OnKeyUp, this);
         Bind(wxEVT_SIZE, &Chip8Canvas::OnSize, this); // handle resizing
 
+        SetKeyMap({});
         SetFocus(); // Receive keyboard events
+        Gamepads::shared(); // SDL's controller subsystem starts on the GUI thread, audio on its own
+    }
 
-        // ---- SDL audio setup ----
-        if (SDL_Init(SDL_INIT_AUDIO) == 0)
-        {
-            SDL_zero(audioSpec);
-            audioSpec.freq = 44100;
-            audioSpec.format = AUDIO_F32SYS;
-            audioSpec.channels = 1;
-            audioSpec.samples = 1024;
-            audioSpec.callback = nullptr;
+    ~Chip8Canvas()
+    {
+        SetRawKeyboard(false);
+        emulation.stop();
+        StopBackend();
+    }
 
-            audioDevice = SDL_OpenAudioDevice(nullptr, 0, &audioSpec, nullptr, 0);
-            if (audioDevice != 0)
-            {
-                SDL_PauseAudioDevice(audioDevice, 0);
-                audioInitialized = true;
-            }
-        }
+    enum class Backend
+    {
+        OpenGL,
+        Direct3D11, // Windows only, falls back to OpenGL elsewhere or on failure
+        Software    // Bitmap blits, what OpenGL falls back to without a working context
+    };
+
+    // Switches graphics API, the new backend starts on the next paint
+    void SetBackend(Backend kind)
+    {
+        if (kind == backendKind)
+            return;
+        StopBackend();
+        backendKind = kind;
+        Refresh();
     }
+    Backend GetBackend() const { return backendKind; }
 
-    ~Chip8Canvas()
+    // Full screen draws at a whole-number scale, and exclusive takes the
+    // monitor over where the backend can (Direct3D 11). Kept across backend
+    // changes; see Chip8FrameWithCanvas::SetFullScreen.
+    void SetFullScreen(bool on, bool exclusive)
     {
-        if (audioInitialized)
-        {
-            SDL_CloseAudioDevice(audioDevice);
-            SDL_QuitSubSystem(SDL_INIT_AUDIO);
-        }
-        delete context;
+        fullScreen = on;
+        exclusiveWanted = on && exclusive;
+        if (backend)
+            ApplyFullScreen();
+        Refresh();
     }
+    bool IsExclusive() const { return exclusiveActive; }
+
+    // Graphics API actually drawing, empty before the first paint
+    wxString GetBackendName() const { return backend ? wxString(backend->name()) : wxString(); }
 
     enum class ScreenFilter
     {
@@ -98,275 +450,633 @@ public:
 
     ScreenFilter filter = ScreenFilter::Classic;
 
+    // Host key code of each CHIP-8 key, see KeyMap. Read by the raw
+    // keyboard thread too.
+    void SetKeyMap(const KeyMap::Layout &keys) { keyMap.set(keys); }
+
+    // CHIP-8 key for a host key code, -1 if none
+    int KeyForCode(int code) const { return keyMap.keyFor(code); }
+
+    // CRT passes, only drawn by the OpenGL 3.3 renderer
+    void SetEffects(const ScreenBackend::Effects &newEffects)
+    {
+        effects = newEffects;
+        if (backend)
+            backend->setEffects(effects);
+        Refresh();
+    }
+    const ScreenBackend::Effects &GetEffects() const { return effects; }
+
     void OnSize(wxSizeEvent &)
     {
+        if (!backend)
+            return;
         int w, h;
         GetClientSize(&w, &h);
-
-        // calculate scale to fit 64x32 while keeping aspect ratio
-        int scaleX = w / 64;
-        int scaleY = h / 32;
-        int scale = std::max(1, std::min(scaleX, scaleY));
-
-        // calculate actual viewport size
-        int viewW = 64 * scale;
-        int viewH = 32 * scale;
-
-        // center the viewport
-        int offsetX = (w - viewW) / 2;
-        int offsetY = (h - viewH) / 2;
-
-        SetCurrent(*context);
-        glViewport(offsetX, offsetY, viewW, viewH);
-
-        // Update projection matrix
-        glMatrixMode(GL_PROJECTION);
-        glLoadIdentity();
-        glOrtho(0, 64, 32, 0, -1, 1);
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
+        if (usingGl)
+            SetCurrent(*context);
+        backend->resize(w, h);
     }
 
     void OnPaint(wxPaintEvent &)
     {
         wxPaintDC dc(this);
-        SetCurrent(*context);
-        Render();
-        SwapBuffers();
+        if (!backend)
+            StartBackend();
+        Present();
     }
 
     void OnTimer(wxTimerEvent &)
     {
-        if (paused)
-            return; // do nothing if paused
+        if (UpdateHidden())
+            return;
+        // Nothing to present unless the screen changed, or a trail is still fading
+        const EmulatedFrame *frame = PickUpFrame();
+        if (frame && (frame->gfx != shownGfx || frame->hires != shownHires || effects.phosphor))
+            Refresh();
+    }
 
-        int cyclesToRun = 1; // default
-        switch (emuSpeed)
-        {
-        case Speed::Slow:
-            cyclesToRun = 2;
-            break;
-        case Speed::Normal:
-            cyclesToRun = 5;
-            break;
-        case Speed::Fast:
-            cyclesToRun = 10;
-            break;
-        case Speed::Fastest:
-            cyclesToRun = 20;
-            break;
-        }
+    // With vsync, every idle pass draws and presenting blocks until the
+    // next refresh, so frames go out in step with the monitor
+    void OnIdle(wxIdleEvent &event)
+    {
+        if (!vsync || !backend || hidden)
+            return;
+        if (UpdateHidden())
+            return;
+        PickUpFrame();
+        Present();
+        event.RequestMore();
+    }
 
-        for (int i = 0; i < cyclesToRun; ++i)
-            chip8.emulateCycle();
+    void OnKeyDown(wxKeyEvent &event) { MapKey(event, true); }
+    void OnKeyUp(wxKeyEvent &event) { MapKey(event, false); }
 
-        chip8.decrementTimers();
+    // Instructions per second, 0 = unthrottled
+    void SetClockRate(double hz) { emulation.setClockRate(hz); }
+    double GetClockRate() const { return emulation.clockRate(); }
 
-        // Beep handling (unchanged)
-        if (chip8.beepFlag && audioInitialized)
-        {
-            const int durationMs = 50;
-            const int sampleCount = (audioSpec.freq * durationMs) / 1000;
-            std::vector<float> buffer(sampleCount);
-            for (int i = 0; i < sampleCount; ++i)
-                buffer[i] = (i % (audioSpec.freq / 440) < (audioSpec.freq / 880)) ? 0.25f : -0.25f;
+    // Per-opcode COSMAC VIP timing in place of the clock rate
+    void SetVipTiming(bool vip) { emulation.setVipTiming(vip); }
+    bool IsVipTiming() const { return emulation.isVipTiming(); }
 
-            SDL_QueueAudio(audioDevice, buffer.data(), buffer.size() * sizeof(float));
-        }
+    // Publish each frame ORed with the previous one, see EmulationThread
+    void SetFrameBlend(bool blend) { emulation.setFrameBlend(blend); }
+    void SetWholePictures(bool whole) { emulation.setWholePictures(whole); }
 
-        Refresh();
-    }
+    // Emulated frames per presented frame, 1 = off, 0 = as fast as possible
+    void SetFastForward(int factor) { emulation.setFastForward(factor); }
 
-    void OnKeyDown(wxKeyEvent &event) { MapKey(event, true); }
-    void OnKeyUp(wxKeyEvent &event) { MapKey(event, false); }
+    // Frames shown ahead of the real state, 0 = off, see EmulationThread
+    void SetRunAhead(int frames) { emulation.setRunAhead(frames); }
 
-    void SetSpeed(int delayMs)
+    // Autosaver session the machine saves to, -1 for none
+    void SetAutosave(int session) { emulation.setAutosave(session); }
+
+    Chip8 &GetChip8() { return *machine; }
+
+    // Start stepping the core once the first ROM is in memory
+    void StartEmulation() { emulation.start(); }
+
+    // Holding Backspace plays recorded history backwards
+    void SetRewinding(bool rewind) { emulation.setRewinding(rewind); }
+    void ClearRewind() { emulation.clearRewind(); }
+
+    // done runs on the emulation thread, see EmulationThread::loadROMAsync
+    void LoadROMAsync(const wxString &path, std::function<void(EmulationThread::LoadResult)> done, bool keepState = false)
     {
-        emulationDelay = delayMs;
+        emulation.loadROMAsync(std::string(path.mb_str()), std::move(done), keepState);
     }
 
-    enum class Speed
+    // Movie recording restarts the ROM, see EmulationThread::startRecording
+    bool StartRecording(const wxString &romPath, uint64_t seed) { return emulation.startRecording(std::string(romPath.mb_str()), seed); }
+    bool StopRecording(const wxString &moviePath) { return emulation.stopRecording(std::string(moviePath.mb_str())); }
+    bool IsRecording() const { return emulation.isRecording(); }
+
+    // Netplay restarts the ROM too, see EmulationThread::startNetplay
+    bool StartNetplay(const wxString &romPath, uint64_t seed, std::unique_ptr<NetplaySession> session)
     {
-        Slow,
-        Normal,
-        Fast,
-        Fastest
-    };
+        return emulation.startNetplay(std::string(romPath.mb_str()), seed, std::move(session));
+    }
+    void StopNetplay() { emulation.stopNetplay(); }
+    bool IsNetplaying() const { return emulation.isNetplaying(); }
+    const NetplaySession *GetNetplaySession() const { return emulation.netplaySession(); }
 
-    Speed emuSpeed = Speed::Normal; // default speed
-    bool paused = false;
+    // Frames for other processes, see EmulationThread::startFrameShare
+    bool StartFrameShare(const wxString &name) { return emulation.startFrameShare(std::string(name.mb_str())); }
+    void StopFrameShare() { emulation.stopFrameShare(); }
 
-    wxString currentROMPath;
+    // Screen recording, see EmulationThread::startVideo
+    bool StartVideo(const wxString &path) { return emulation.startVideo(std::string(path.mb_str())); }
+    bool StopVideo() { return emulation.stopVideo(); }
+    bool IsRecordingVideo() const { return emulation.isRecordingVideo(); }
+    uint64_t GetDroppedVideoFrames() const { return emulation.droppedVideoFrames(); }
 
-private:
-    void Render()
+    // Hands a copy of the picture last presented, in its colours, to the
+    // screenshot writer; false if the writer has too many waiting
+    bool SaveScreenshot(const wxString &path, int scale)
     {
-        int w, h;
-        GetSize(&w, &h);
-        glViewport(0, 0, w, h);
+        Screenshot shot;
+        shot.gfx = shownGfx;
+        shot.hires = shownHires;
+        auto colors = Palette();
+        for (int c = 0; c < 3; ++c)
+        {
+            shot.off[c] = static_cast<uint8_t>(std::lround(colors.first[c] * 255.0f));
+            shot.on[c] = static_cast<uint8_t>(std::lround(colors.second[c] * 255.0f));
+        }
+        shot.scale = scale;
+        shot.path = std::string(path.mb_str());
+        return ScreenshotWriter::shared().submit(std::move(shot));
+    }
 
-        glMatrixMode(GL_PROJECTION);
-        glLoadIdentity();
-        glOrtho(0, 64, 32, 0, -1, 1);
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
+    // Breakpoints and tracing, see EmulationThread::setDebugging
+    void SetDebugging(bool debug) { emulation.setDebugging(debug); }
+    bool TakeDebugBreak() { return emulation.takeDebugBreak(); }
+    void DebugStep() { emulation.debugStep(); }
+    bool DebugStepBack() { return emulation.debugStepBack(); }
+    bool DebugRunBack() { return emulation.debugRunBack(); }
+    bool TakeDebugWrite(Chip8Debugger::WriteEvent &out)
+    {
+        auto &log = emulation.debugWrites();
+        const Chip8Debugger::WriteEvent *event = log.front();
+        if (!event)
+            return false;
+        out = *event;
+        log.pop();
+        return true;
+    }
+    template <typename F>
+    void WithDebugger(F &&fn) { emulation.withDebugger(std::forward<F>(fn)); }
 
-        switch (filter)
+    // Held once per frame, see EmulationThread::setCheats
+    void SetCheats(const CheatList &list) { emulation.setCheats(list); }
+
+    void SetPaused(bool pause)
+    {
+        hiddenPause = false;
+        emulation.setPaused(pause);
+    }
+    bool IsPaused() const { return emulation.isPaused(); }
+
+    // Whether emulation goes on while nothing of the canvas can be seen;
+    // nothing is drawn either way, see UpdateHidden
+    void SetRunWhileHidden(bool run)
+    {
+        runWhileHidden = run;
+        if (hidden && !run && !emulation.isPaused())
         {
-        case ScreenFilter::Classic:
-            glClearColor(0.0f, 0.0f, 0.0f, 1.0f); // black
-            break;
-        case ScreenFilter::Green:
-            glClearColor(155.0f / 255.0f, 188.0f / 255.0f, 15.0f / 255.0f, 1.0f); // #9bbc0f
-            break;
+            emulation.setPaused(true);
+            hiddenPause = true;
         }
-        glClear(GL_COLOR_BUFFER_BIT);
-
-        glBegin(GL_QUADS);
-        for (int y = 0; y < 32; ++y)
+        else if (run && hiddenPause)
         {
-            for (int x = 0; x < 64; ++x)
-            {
-                if (chip8.gfx[y * 64 + x])
-                {
-                    switch (filter)
-                    {
-                    case ScreenFilter::Classic:
-                        glColor3f(1.0f, 1.0f, 1.0f); // white
-                        break;
-                    case ScreenFilter::Green:
-                        glColor3f(15.0f / 255.0f, 56.0f / 255.0f, 15.0f / 255.0f); // #0f380f
-                        break;
-                    }
-                    glVertex2f(x, y);
-                    glVertex2f(x + 1, y);
-                    glVertex2f(x + 1, y + 1);
-                    glVertex2f(x, y + 1);
-                }
-            }
+            emulation.setPaused(false);
+            hiddenPause = false;
         }
-        glEnd();
     }
 
-    void MapKey(wxKeyEvent &event, bool pressed)
+    // Key changes reach the core through the emulation thread's event queue
+    void PostKey(int key, bool pressed) { emulation.postKey(key, pressed); }
+
+    // Game controllers, polled by the emulation thread each frame
+    void SetGamepad(bool enabled, const GamepadProfile &profile) { emulation.setGamepad(enabled, profile); }
+
+    // Take the keypad from the raw keyboard thread instead of wx key
+    // events, see RawKeyboard. False if raw input isn't available.
+    bool SetRawKeyboard(bool on)
     {
-        int key = -1;
-        switch (event.GetKeyCode())
+        if (on == (rawKeyboard != 0))
+            return true;
+        if (!on)
         {
-        case '1':
-            key = 0x1;
-            break;
-        case '2':
-            key = 0x2;
-            break;
-        case '3':
-            key = 0x3;
-            break;
-        case '4':
-            key = 0xC;
-            break;
-        case 'Q':
-            key = 0x4;
-            break;
-        case 'W':
-            key = 0x5;
-            break;
-        case 'E':
-            key = 0x6;
-            break;
-        case 'R':
-            key = 0xD;
-            break;
-        case 'A':
-            key = 0x7;
-            break;
-        case 'S':
-            key = 0x8;
-            break;
-        case 'D':
-            key = 0x9;
-            break;
-        case 'F':
-            key = 0xE;
-            break;
-        case 'Z':
-            key = 0xA;
-            break;
-        case 'X':
-            key = 0x0;
-            break;
-        case 'C':
-            key = 0xB;
-            break;
-        case 'V':
-            key = 0xF;
-            break;
+            RawKeyboard::shared().unsubscribe(rawKeyboard);
+            rawKeyboard = 0;
+            return true;
         }
-        if (key != -1)
-            chip8.keys[key] = pressed;
+#if defined(_WIN32)
+        rawKeyboard = RawKeyboard::shared().subscribe(wxGetTopLevelParent(this)->GetHWND(), [this](int virtualKey, bool pressed)
+                                                      {
+                                                          int key = KeyForCode(KeyMap::fromVirtualKey(virtualKey));
+                                                          if (key != -1)
+                                                              emulation.postRawKey(key, pressed); });
+#endif
+        return rawKeyboard != 0;
     }
 
-    Chip8 &chip8;
-    wxGLContext *context;
-    wxTimer timer;
+    // Touch the core from the GUI thread with emulation held between frames
+    template <typename F>
+    void WithCore(F &&fn) { emulation.withCore(std::forward<F>(fn)); }
 
-    // Audio
-    SDL_AudioDeviceID audioDevice = 0;
-    SDL_AudioSpec audioSpec{};
-    bool audioInitialized = false;
+    // Host timing of recent frames, see FrameMetricsLog
+    FrameMetricsSummary GetMetricsSummary(double seconds) const
+    {
+        return FrameMetricsLog::summarize(metrics.recent(static_cast<uint64_t>(seconds * 1e6)));
+    }
+    bool SaveMetrics(const wxString &path) const { return metrics.save(std::string(path.mb_str())); }
 
-    // Emulation speed
-    int emulationDelay;
-};
+    // Key press to screen timings, see InputLatencyMeter
+    void SetMeasuringLatency(bool on) { emulation.latencyMeter().setEnabled(on); }
+    bool IsMeasuringLatency() const { return emulation.latencyMeter().isEnabled(); }
+    InputLatencySummary GetLatencySummary() const { return emulation.latencyMeter().summary(); }
 
-class PixelButton : public wxButton
-{
-public:
-    PixelButton(wxWindow *parent, int id, const wxString &label)
-        : wxButton(parent, id, label, wxDefaultPosition, wxDefaultSize, wxBU_EXACTFIT | wxBORDER_NONE)
-    {
-        wxFont font(14, wxFONTFAMILY_MODERN, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_BOLD);
-        SetFont(font);
-        SetBackgroundColour(wxColour(30, 30, 30));
-        SetForegroundColour(wxColour(200, 200, 200));
-        SetMinSize(wxSize(40, 40));
-        SetMaxSize(wxSize(60, 60));
+    // Where PC spends its time, see PcSampler
+    void SetSamplingPc(bool on) { emulation.setSamplingPc(on); }
+    std::string GetPcSampleListing(size_t topN) { return emulation.pcSampleListing(topN); }
 
-        pressed = false;
+#if defined(CHIP8_LUA)
+    // Per-frame Lua hooks, see EmulationThread::loadScript
+    bool LoadScript(const std::string &path, std::string &error) { return emulation.loadScript(path, LuaScript::defaultBudget, error); }
+    void StopScript() { emulation.stopScript(); }
+    bool HasScript() { return emulation.hasScript(); }
+    std::vector<std::string> TakeScriptOutput() { return emulation.takeScriptOutput(); }
+#endif
 
-        Bind(wxEVT_LEFT_DOWN, &PixelButton::OnMouseDown, this);
-        Bind(wxEVT_LEFT_UP, &PixelButton::OnMouseUp, this);
-        Bind(wxEVT_LEAVE_WINDOW, &PixelButton::OnMouseLeave, this);
-    }
+    // Device buffer size, see AudioOutput
+    void SetAudioBuffer(int samples) { audio.setBufferSamples(samples); }
+    double GetBeepLatencyMs() const { return audio.beepLatency() / 1000.0; }
 
-protected:
-    bool pressed;
+    wxString currentROMPath;
+    // Called on the GUI thread when a picked-up frame's held keys differ
+    // from the last one's
+    std::function<void(uint16_t)> onKeysShown;
 
-    void OnMouseDown(wxMouseEvent &event)
+private:
+    using MetricsClock = std::chrono::steady_clock;
+
+    // Creates the chosen backend on the first paint. Direct3D falls back to
+    // OpenGL; a core context the shader renderer can't use is swapped for a
+    // compatibility one the fixed-function path can, and without any
+    // working context the software renderer draws.
+    void StartBackend()
     {
-        pressed = true;
-        Refresh();
-        event.Skip(); // allow normal click processing
+#if defined(_WIN32)
+        if (backendKind == Backend::Direct3D11)
+        {
+            std::unique_ptr<ScreenBackend> d3d = std::make_unique<D3D11ScreenRenderer>(GetHWND());
+            if (d3d->init())
+            {
+                backend = std::move(d3d);
+                usingGl = false;
+                vsync = true; // Present waits for the refresh
+            }
+        }
+#endif
+        if (!backend && backendKind != Backend::Software && context->IsOK() && SetCurrent(*context))
+        {
+            usingGl = true;
+            if (coreContext)
+            {
+                backend = std::make_unique<ScreenRenderer>([this]
+                                                           { SwapBuffers(); }, &sharedGl->screenPrograms);
+                if (!backend->init())
+                {
+                    backend.reset();
+                    sharedGl = AcquireGlContext(this, false);
+                    context = sharedGl->context.get();
+                    coreContext = false;
+                    SetCurrent(*context);
+                }
+            }
+            if (!backend)
+            {
+                backend = std::make_unique<LegacyScreenRenderer>([this]
+                                                                 { SwapBuffers(); });
+                if (!backend->init())
+                    backend.reset();
+            }
+            if (backend)
+                vsync = EnableVsync();
+            else
+                usingGl = false;
+        }
+        if (!backend)
+        {
+            // Drawn whole into a bitmap, so the paint handler mustn't erase first
+            SetBackgroundStyle(wxBG_STYLE_PAINT);
+            backend = std::make_unique<SoftwareScreenRenderer>(this);
+            backend->init();
+            usingGl = false;
+            vsync = false;
+        }
+
+        if (vsync)
+            timer.Stop();
+        else
+            timer.Start(4);
+        backend->setEffects(effects);
+        ApplyFullScreen();
+        int w, h;
+        GetClientSize(&w, &h);
+        backend->resize(w, h);
     }
 
-    void OnMouseUp(wxMouseEvent &event)
+    void StopBackend()
     {
-        pressed = false;
-        Refresh();
-        event.Skip();
+        if (!backend)
+            return;
+        if (usingGl)
+            SetCurrent(*context);
+        backend.reset();
+        exclusiveActive = false;
     }
 
-    void OnMouseLeave(wxMouseEvent &event)
+    // Minimized, on a hidden page or, as far as the backend knows, covered
+    // by other windows. The timer keeps polling while hidden (the vsync
+    // idle loop would stop) and drawing starts again once it is seen.
+    bool UpdateHidden()
+    {
+        const wxTopLevelWindow *top = wxDynamicCast(wxGetTopLevelParent(this), wxTopLevelWindow);
+        const bool now = (top && top->IsIconized()) || !IsShownOnScreen() || (backend && backend->occluded());
+        if (now == hidden)
+            return hidden;
+        hidden = now;
+        if (hidden)
+        {
+            timer.Start(100);
+            if (!runWhileHidden && !emulation.isPaused())
+            {
+                emulation.setPaused(true);
+                hiddenPause = true;
+            }
+        }
+        else
+        {
+            if (hiddenPause)
+                emulation.setPaused(false);
+            hiddenPause = false;
+            if (vsync)
+                timer.Stop();
+            else
+                timer.Start(4);
+            Refresh();
+        }
+        return hidden;
+    }
+
+    void ApplyFullScreen()
+    {
+        backend->setIntegerScale(fullScreen);
+        exclusiveActive = backend->setExclusive(exclusiveWanted);
+    }
+
+    // Colours of unlit and lit pixels
+    std::pair<ScreenBackend::Color, ScreenBackend::Color> Palette() const
+    {
+        switch (filter)
+        {
+        case ScreenFilter::Green:
+            return {{155.0f / 255.0f, 188.0f / 255.0f, 15.0f / 255.0f}, {15.0f / 255.0f, 56.0f / 255.0f, 15.0f / 255.0f}}; // #9bbc0f, #0f380f
+        case ScreenFilter::Classic:
+        default:
+            return {{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}}; // black, white
+        }
+    }
+
+    // Draw and show the newest frame; the metrics count the drawing, not
+    // the wait for vsync. A lost device is created again on the next paint.
+    void Present()
+    {
+        CHIP8_ZONE("Present");
+        if (usingGl)
+            SetCurrent(*context);
+        MetricsClock::time_point start = MetricsClock::now();
+        const EmulatedFrame &frame = emulation.frames().front();
+        {
+            CHIP8_ZONE("Texture upload");
+            backend->upload(frame.gfx);
+        }
+        shownGfx = frame.gfx;
+        shownHires = frame.hires;
+        auto colors = Palette();
+        {
+            CHIP8_ZONE("Render");
+            backend->draw(frame.hires, colors.first, colors.second, frameArrived);
+        }
+        frameArrived = false;
+        renderMicros += Micros(MetricsClock::now() - start);
+
+        bool presented;
+        {
+            CHIP8_ZONE("SwapBuffers");
+            presented = backend->present();
+        }
+        CHIP8_FRAME_MARK();
+        if (!presented)
+        {
+            StopBackend();
+            Refresh();
+        }
+        else if (emulation.latencyMeter().isEnabled())
+            emulation.latencyMeter().presented(frame.sequence);
+    }
+
+    // Newest frame the emulation thread finished, or nullptr if none since
+    const EmulatedFrame *PickUpFrame()
+    {
+        if (!emulation.frames().update())
+            return nullptr;
+        const EmulatedFrame &frame = emulation.frames().front();
+        RecordMetrics(frame);
+        frameArrived = true;
+        if (frame.keys != shownKeys)
+        {
+            shownKeys = frame.keys;
+            if (onKeysShown)
+                onKeysShown(shownKeys);
+        }
+        return &frame;
+    }
+
+    // Swap interval 1, or adaptive (-1) where late frames may tear instead
+    // of waiting a whole refresh. Needs the context current.
+    static bool EnableVsync()
+    {
+#if defined(_WIN32)
+        typedef BOOL(WINAPI * SwapIntervalProc)(int);
+        typedef const char *(WINAPI * ExtensionsProc)();
+        SwapIntervalProc swapInterval = reinterpret_cast<SwapIntervalProc>(wglGetProcAddress("wglSwapIntervalEXT"));
+        if (!swapInterval)
+            return false;
+        ExtensionsProc extensions = reinterpret_cast<ExtensionsProc>(wglGetProcAddress("wglGetExtensionsStringEXT"));
+        if (extensions && std::strstr(extensions(), "WGL_EXT_swap_control_tear") && swapInterval(-1))
+            return true;
+        return swapInterval(1) != FALSE;
+#else
+        return false;
+#endif
+    }
+
+    static uint32_t Micros(MetricsClock::duration d)
+    {
+        return static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(d).count());
+    }
+
+    // One log entry per frame picked up from the emulation thread
+    void RecordMetrics(const EmulatedFrame &frame)
+    {
+        MetricsClock::time_point now = MetricsClock::now();
+        FrameMetrics m;
+        m.timeMicros = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - metricsStart).count());
+        if (metricsStarted)
+        {
+            m.frameMicros = Micros(now - lastPresent);
+            m.instructions = static_cast<uint32_t>(std::min<uint64_t>(frame.instructions - lastInstructions, UINT32_MAX));
+            m.dropped = static_cast<uint32_t>(frame.sequence - lastSequence - 1);
+        }
+        m.renderMicros = renderMicros;
+        m.audioGapMicros = audio.takeLongestGap();
+        metrics.push(m);
+
+        metricsStarted = true;
+        lastPresent = now;
+        lastInstructions = frame.instructions;
+        lastSequence = frame.sequence;
+        renderMicros = 0;
+    }
+
+
+    void MapKey(wxKeyEvent &event, bool pressed)
+    {
+        if (event.GetKeyCode() == WXK_BACK)
+        {
+            SetRewinding(pressed);
+            return;
+        }
+        int key = KeyForCode(event.GetKeyCode());
+        if (key != -1 && rawKeyboard == 0)
+            PostKey(key, pressed);
+    }
+
+    std::unique_ptr<Chip8> machine; // Outlives emulation, which steps it
+    EmulationThread emulation;
+    uint32_t rawKeyboard = 0; // RawKeyboard subscription, 0 for wx key events
+    KeyMap keyMap;            // CHIP-8 key by host key code, see SetKeyMap
+    std::shared_ptr<SharedGlContext> sharedGl; // Kept by every game and wall window
+    wxGLContext *context;                      // sharedGl's
+    wxTimer timer;
+    std::array<uint64_t, 64 * Chip8::rowWords> shownGfx{}; // Frame last presented
+    bool shownHires = false;
+    Backend backendKind = Backend::OpenGL;
+    std::unique_ptr<ScreenBackend> backend; // Created on the first paint
+    bool usingGl = false;     // backend draws through context
+    bool coreContext = false; // context is 3.3 core, only the shader renderer can draw
+    ScreenBackend::Effects effects;
+    bool frameArrived = false; // Emulation moved on since the last draw
+    uint16_t shownKeys = 0;    // Keys held in the last frame picked up
+    bool vsync = false;          // SwapBuffers waits for the refresh, idle passes present
+    bool fullScreen = false;      // Whole-number scaling, see SetFullScreen
+    bool exclusiveWanted = false; // Asked for exclusive mode
+    bool exclusiveActive = false; // The backend holds the monitor
+    bool hidden = false;          // Nothing drawn, see UpdateHidden
+    bool runWhileHidden = true;   // Else hidden pauses emulation
+    bool hiddenPause = false;     // Paused by hiding, not by the user
+
+    // Buzzer, fed by the emulation thread's sound state
+    AudioOutput audio;
+
+    FrameMetricsLog metrics;
+    MetricsClock::time_point metricsStart = MetricsClock::now();
+    MetricsClock::time_point lastPresent;
+    uint64_t lastInstructions = 0;
+    uint64_t lastSequence = 0;
+    uint32_t renderMicros = 0; // Painting since the last logged frame
+    bool metricsStarted = false;
+};
+
+class PixelButton : public wxButton
+{
+public:
+    PixelButton(wxWindow *parent, int id, const wxString &label)
+        : wxButton(parent, id, label, wxDefaultPosition, wxDefaultSize, wxBU_EXACTFIT | wxBORDER_NONE)
     {
+        wxFont font(14, wxFONTFAMILY_MODERN, wxFONTSTYLE_NORMAL, wxFONTWEIGHT_BOLD);
+        SetFont(font);
+        SetBackgroundColour(wxColour(30, 30, 30));
+        SetForegroundColour(wxColour(200, 200, 200));
+        SetMinSize(wxSize(40, 40));
+        SetMaxSize(wxSize(60, 60));
+        SetBackgroundStyle(wxBG_STYLE_PAINT); // The face covers all of it
+
         pressed = false;
-        Refresh();
+
+        Bind(wxEVT_LEFT_DOWN, &PixelButton::OnMouseDown, this);
+        Bind(wxEVT_LEFT_UP, &PixelButton::OnMouseUp, this);
+        Bind(wxEVT_LEAVE_WINDOW, &PixelButton::OnMouseLeave, this);
+    }
+
+    // Shown pressed while the machine holds the key, however it got there.
+    // Blits the cached face straight to the window, no repaint.
+    void SetLit(bool on)
+    {
+        if (on == lit)
+            return;
+        lit = on;
+        if (IsShownOnScreen())
+        {
+            wxClientDC dc(this);
+            dc.DrawBitmap(Face(), 0, 0);
+        }
+    }
+
+protected:
+    bool pressed;
+    bool lit = false;
+
+    void SetPressed(bool down)
+    {
+        if (down == pressed)
+            return;
+        const bool wasDown = pressed || lit;
+        pressed = down;
+        if ((pressed || lit) != wasDown)
+            Refresh(false);
+    }
+
+    void OnMouseDown(wxMouseEvent &event)
+    {
+        SetPressed(true);
+        event.Skip(); // allow normal click processing
+    }
+
+    void OnMouseUp(wxMouseEvent &event)
+    {
+        SetPressed(false);
+        event.Skip();
+    }
+
+    void OnMouseLeave(wxMouseEvent &event)
+    {
+        SetPressed(false);
         event.Skip();
     }
 
     void OnPaint(wxPaintEvent &WXUNUSED(event))
     {
         wxPaintDC dc(this);
-        wxSize sz = GetClientSize();
+        dc.DrawBitmap(Face(), 0, 0);
+    }
+
+    // Both faces are drawn once per size and blitted from then on
+    const wxBitmap &Face()
+    {
+        const wxSize sz = GetClientSize();
+        if (sz != faceSize)
+        {
+            faceSize = sz;
+            upFace = DrawFace(false);
+            downFace = DrawFace(true);
+        }
+        return pressed || lit ? downFace : upFace;
+    }
+
+    wxBitmap DrawFace(bool down) const
+    {
+        const wxSize sz(std::max(faceSize.GetWidth(), 1), std::max(faceSize.GetHeight(), 1));
+        wxBitmap bitmap(sz);
+        wxMemoryDC dc(bitmap);
+        dc.SetBackground(wxBrush(GetParent()->GetBackgroundColour()));
+        dc.Clear(); // Shows in the rounded corners
 
         // Draw rounded rectangle
         int radius = 5; // pixelated rounded corners
@@ -381,7 +1091,7 @@ protected:
         dc.DrawRoundedRectangle(0, 0, sz.GetWidth(), sz.GetHeight(), radius);
 
         // Draw press shading
-        if (pressed)
+        if (down)
         {
             // darker inset
             dc.SetBrush(wxBrush(bottomShade));
@@ -406,8 +1116,14 @@ protected:
         int tx = (sz.GetWidth() - textSize.GetWidth()) / 2;
         int ty = (sz.GetHeight() - textSize.GetHeight()) / 2;
         dc.DrawText(GetLabel(), tx, ty);
+        dc.SelectObject(wxNullBitmap);
+        return bitmap;
     }
 
+    wxSize faceSize; // Of the cached faces, unset until the first paint
+    wxBitmap upFace;
+    wxBitmap downFace;
+
     wxDECLARE_EVENT_TABLE();
 };
 
@@ -415,209 +1131,2923 @@ wxBEGIN_EVENT_TABLE(PixelButton, wxButton)
     EVT_PAINT(PixelButton::OnPaint)
         wxEND_EVENT_TABLE()
 
-    // -------------------------
-    // Main frame (with canvas)
-    // -------------------------
-    class Chip8FrameWithCanvas : public wxFrame
+// -------------------------
+// Debugger window
+// -------------------------
+// The debugger's picture of all of memory, redrawn every 16 ms from a copy
+// taken under the core lock. Bytes the debugged instructions read or wrote
+// glow for about a second after, fading a step per refresh.
+class MemoryMapCanvas : public wxGLCanvas
 {
 public:
-    Chip8FrameWithCanvas(Chip8 *chip8Ptr, const wxString &romFile)
-        : wxFrame(nullptr, wxID_ANY, "CHIP-8 Emulator", wxDefaultPosition, wxSize(640, 480)),
-          chip8(chip8Ptr)
+    static constexpr int heatStep = 4; // Per refresh, 255 fades out in 64
+
+    MemoryMapCanvas(wxWindow *parent, Chip8Canvas *canvasRef)
+        : wxGLCanvas(parent, wxID_ANY, nullptr, wxDefaultPosition, wxSize(-1, 128)),
+          canvas(canvasRef),
+          sharedGl(AcquireGlContext(this, false)),
+          context(sharedGl->context.get())
     {
-        SetIcon(wxICON(IDI_APP_ICON));
+        timer.SetOwner(this);
+        timer.Start(16);
+        Bind(wxEVT_TIMER, &MemoryMapCanvas::OnTimer, this);
+        Bind(wxEVT_PAINT, &MemoryMapCanvas::OnPaint, this);
+        Bind(wxEVT_SIZE, &MemoryMapCanvas::OnSize, this);
+        Bind(wxEVT_LEFT_DOWN, &MemoryMapCanvas::OnLeftDown, this);
+        Bind(wxEVT_MOTION, &MemoryMapCanvas::OnMotion, this);
+    }
 
-        // ---- Menu Bar ----
-        wxMenu *fileMenu = new wxMenu;
-        fileMenu->Append(wxID_OPEN, "Open Game\tCtrl+O");
-        fileMenu->AppendSeparator();
-        fileMenu->Append(wxID_EXIT);
+    ~MemoryMapCanvas()
+    {
+        timer.Stop();
+        if (renderer)
+        {
+            SetCurrent(*context);
+            renderer.reset();
+        }
+    }
 
-        wxMenu *emulationMenu = new wxMenu;
-        emulationMenu->Append(wxID_STOP, "Pause\tCtrl+P");
-        emulationMenu->Append(wxID_REFRESH, "Reset\tCtrl+R");
+    // Told the address under a click
+    std::function<void(uint16_t)> onPick;
 
-        wxMenu *speedMenu = new wxMenu;
-        speedMenu->AppendRadioItem(ID_SPEED_FASTEST, "Fastest");
-        speedMenu->AppendRadioItem(ID_SPEED_FAST, "Fast");
-        speedMenu->AppendRadioItem(ID_SPEED_NORMAL, "Normal");
-        speedMenu->AppendRadioItem(ID_SPEED_SLOW, "Slow");
-        wxMenuItem *normalItem = speedMenu->FindItem(ID_SPEED_NORMAL);
-        if (normalItem)
+private:
+    void OnTimer(wxTimerEvent &)
+    {
+        Chip8Debugger::Bitmap read, written;
+        canvas->WithDebugger([&](Chip8Debugger &debugger, const Chip8 &chip8)
+                             {
+                                 memory = chip8.getMemory();
+                                 pc = chip8.getPC();
+                                 index = chip8.getI();
+                                 debugger.takeAccesses(read, written);
+                             });
+        for (size_t addr = 0; addr < Chip8::memorySize; ++addr)
+        {
+            const uint64_t bit = uint64_t(1) << (addr & 63);
+            readHeat[addr] = (read[addr >> 6] & bit) ? 255 : static_cast<uint8_t>(std::max(readHeat[addr] - heatStep, 0));
+            writeHeat[addr] = (written[addr >> 6] & bit) ? 255 : static_cast<uint8_t>(std::max(writeHeat[addr] - heatStep, 0));
+        }
+        Refresh(false);
+    }
+
+    void OnPaint(wxPaintEvent &)
+    {
+        wxPaintDC dc(this);
+        if (!context->IsOK() || failed)
+            return;
+        SetCurrent(*context);
+        if (!renderer)
+        {
+            renderer = std::make_unique<MemoryMapRenderer>([this]
+                                                           { SwapBuffers(); });
+            if (!renderer->init(Chip8::memorySize))
+            {
+                renderer.reset();
+                failed = true;
+                return;
+            }
+            int w, h;
+            GetClientSize(&w, &h);
+            renderer->resize(w, h);
+        }
+        renderer->upload(memory.data(), readHeat.data(), writeHeat.data(), pc, index);
+        renderer->draw();
+        renderer->present();
+    }
+
+    void OnSize(wxSizeEvent &)
+    {
+        if (!renderer)
+            return;
+        int w, h;
+        GetClientSize(&w, &h);
+        SetCurrent(*context);
+        renderer->resize(w, h);
+        Refresh(false);
+    }
+
+    void OnLeftDown(wxMouseEvent &event)
+    {
+        int addr = renderer ? renderer->addressAt(event.GetX(), event.GetY()) : -1;
+        if (addr != -1 && onPick)
+            onPick(static_cast<uint16_t>(addr));
+    }
+
+    void OnMotion(wxMouseEvent &event)
+    {
+        int addr = renderer ? renderer->addressAt(event.GetX(), event.GetY()) : -1;
+        SetToolTip(addr == -1 ? wxString() : wxString::Format("%03X  %02X", addr, memory[addr]));
+    }
+
+    Chip8Canvas *canvas;
+    std::shared_ptr<SharedGlContext> sharedGl; // The fixed-function context
+    wxGLContext *context;                      // sharedGl's
+    wxTimer timer;
+    std::unique_ptr<MemoryMapRenderer> renderer; // Created on the first paint
+    bool failed = false;                         // No working context, the map stays blank
+    std::array<uint8_t, Chip8::memorySize> memory{};
+    std::array<uint8_t, Chip8::memorySize> readHeat{};
+    std::array<uint8_t, Chip8::memorySize> writeHeat{};
+    uint16_t pc = 0;
+    uint16_t index = 0;
+};
+
+// Shows the machine of one game window and sets its breakpoints. While it
+// is open every instruction of that machine goes through Chip8Debugger;
+// the view refreshes four times a second and at once on a break.
+class DebuggerFrame : public wxFrame
+{
+public:
+    DebuggerFrame(wxWindow *parent, Chip8Canvas *canvasRef)
+        : wxFrame(parent, wxID_ANY, "CHIP-8 Debugger", wxDefaultPosition, wxSize(960, 820)),
+          canvas(canvasRef), refreshTimer(this)
+    {
+        wxFont mono(wxFontInfo(9).Family(wxFONTFAMILY_TELETYPE));
+        wxPanel *panel = new wxPanel(this);
+
+        wxBoxSizer *controls = new wxBoxSizer(wxHORIZONTAL);
+        wxButton *continueButton = new wxButton(panel, wxID_ANY, "Continue");
+        wxButton *pauseButton = new wxButton(panel, wxID_ANY, "Pause");
+        wxButton *stepButton = new wxButton(panel, wxID_ANY, "Step");
+        wxButton *stepBackButton = new wxButton(panel, wxID_ANY, "Step Back");
+        wxButton *runBackButton = new wxButton(panel, wxID_ANY, "Run Back");
+        addressBox = new wxTextCtrl(panel, wxID_ANY, "200", wxDefaultPosition, wxSize(60, -1), wxTE_PROCESS_ENTER);
+        wxButton *breakButton = new wxButton(panel, wxID_ANY, "Break at");
+        wxButton *watchButton = new wxButton(panel, wxID_ANY, "Watch Writes");
+        wxButton *logButton = new wxButton(panel, wxID_ANY, "Log Writes");
+        wxButton *memoryButton = new wxButton(panel, wxID_ANY, "Show Memory");
+        followIndex = new wxCheckBox(panel, wxID_ANY, "Memory follows I");
+        wxButton *traceButton = new wxButton(panel, wxID_ANY, "Save Trace...");
+        controls->Add(continueButton, 0, wxRIGHT, 4);
+        controls->Add(pauseButton, 0, wxRIGHT, 4);
+        controls->Add(stepButton, 0, wxRIGHT, 4);
+        controls->Add(stepBackButton, 0, wxRIGHT, 4);
+        controls->Add(runBackButton, 0, wxRIGHT, 12);
+        controls->Add(new wxStaticText(panel, wxID_ANY, "Address:"), 0, wxALIGN_CENTER_VERTICAL | wxRIGHT, 4);
+        controls->Add(addressBox, 0, wxRIGHT, 4);
+        controls->Add(breakButton, 0, wxRIGHT, 4);
+        controls->Add(watchButton, 0, wxRIGHT, 4);
+        controls->Add(logButton, 0, wxRIGHT, 4);
+        controls->Add(memoryButton, 0, wxRIGHT, 4);
+        controls->Add(followIndex, 0, wxALIGN_CENTER_VERTICAL | wxRIGHT, 12);
+        controls->Add(traceButton, 0);
+
+        disassembly = new wxListBox(panel, wxID_ANY);
+        disassembly->SetFont(mono);
+        registers = new wxStaticText(panel, wxID_ANY, "");
+        registers->SetFont(mono);
+        breakpoints = new wxListBox(panel, wxID_ANY);
+        breakpoints->SetFont(mono);
+        traceTail = new wxListBox(panel, wxID_ANY);
+        traceTail->SetFont(mono);
+        writeList = new wxListBox(panel, wxID_ANY);
+        writeList->SetFont(mono);
+
+        wxArrayString classNames;
+        for (int cls = 0; cls < Chip8Profile::classCount; ++cls)
+            classNames.Add(Chip8Profile::className(cls));
+        classBreaks = new wxCheckListBox(panel, wxID_ANY, wxDefaultPosition, wxSize(90, -1), classNames);
+        classBreaks->SetFont(mono);
+        stackTrap = new wxCheckBox(panel, wxID_ANY, "Stack trap");
+
+        memoryView = new wxTextCtrl(panel, wxID_ANY, "", wxDefaultPosition, wxSize(-1, 200), wxTE_MULTILINE | wxTE_READONLY | wxTE_DONTWRAP);
+        memoryView->SetFont(mono);
+        memoryMap = new MemoryMapCanvas(panel, canvas);
+
+        wxBoxSizer *middle = new wxBoxSizer(wxVERTICAL);
+        middle->Add(registers, 0, wxEXPAND | wxBOTTOM, 6);
+        middle->Add(new wxStaticText(panel, wxID_ANY, "Breakpoints (double-click removes):"), 0);
+        middle->Add(breakpoints, 1, wxEXPAND | wxBOTTOM, 6);
+        middle->Add(new wxStaticText(panel, wxID_ANY, "Last instructions:"), 0);
+        middle->Add(traceTail, 2, wxEXPAND | wxBOTTOM, 6);
+        middle->Add(new wxStaticText(panel, wxID_ANY, "Logged writes:"), 0);
+        middle->Add(writeList, 1, wxEXPAND);
+
+        wxBoxSizer *classes = new wxBoxSizer(wxVERTICAL);
+        classes->Add(new wxStaticText(panel, wxID_ANY, "Break on:"), 0);
+        classes->Add(classBreaks, 1, wxEXPAND | wxBOTTOM, 6);
+        classes->Add(stackTrap, 0);
+
+        wxBoxSizer *views = new wxBoxSizer(wxHORIZONTAL);
+        views->Add(disassembly, 3, wxEXPAND | wxRIGHT, 6);
+        views->Add(middle, 2, wxEXPAND | wxRIGHT, 6);
+        views->Add(classes, 0, wxEXPAND);
+
+        wxBoxSizer *sizer = new wxBoxSizer(wxVERTICAL);
+        sizer->Add(controls, 0, wxEXPAND | wxALL, 6);
+        sizer->Add(views, 1, wxEXPAND | wxLEFT | wxRIGHT, 6);
+        sizer->Add(memoryView, 0, wxEXPAND | wxALL, 6);
+        sizer->Add(new wxStaticText(panel, wxID_ANY, "Memory (click shows the address; yellow PC, green I, blue read, red written):"), 0, wxLEFT | wxRIGHT, 6);
+        sizer->Add(memoryMap, 0, wxEXPAND | wxALL, 6);
+        panel->SetSizer(sizer);
+
+        continueButton->Bind(wxEVT_BUTTON, [this](wxCommandEvent &)
+                             { canvas->SetPaused(false); SetStatusText("Running"); });
+        pauseButton->Bind(wxEVT_BUTTON, [this](wxCommandEvent &)
+                          { canvas->SetPaused(true); SetStatusText("Paused"); UpdateView(); });
+        stepButton->Bind(wxEVT_BUTTON, &DebuggerFrame::OnStep, this);
+        stepBackButton->Bind(wxEVT_BUTTON, &DebuggerFrame::OnStepBack, this);
+        runBackButton->Bind(wxEVT_BUTTON, &DebuggerFrame::OnRunBack, this);
+        breakButton->Bind(wxEVT_BUTTON, [this](wxCommandEvent &)
+                          { ToggleAddress(Kind::Breakpoint); });
+        watchButton->Bind(wxEVT_BUTTON, [this](wxCommandEvent &)
+                          { ToggleAddress(Kind::Watch); });
+        logButton->Bind(wxEVT_BUTTON, [this](wxCommandEvent &)
+                        { ToggleAddress(Kind::Log); });
+        memoryButton->Bind(wxEVT_BUTTON, [this](wxCommandEvent &)
+                           { ShowMemoryAt(); });
+        addressBox->Bind(wxEVT_TEXT_ENTER, [this](wxCommandEvent &)
+                         { ShowMemoryAt(); });
+        traceButton->Bind(wxEVT_BUTTON, &DebuggerFrame::OnSaveTrace, this);
+        memoryMap->onPick = [this](uint16_t addr)
+        {
+            addressBox->ChangeValue(wxString::Format("%03X", addr));
+            ShowMemoryAt();
+        };
+        disassembly->Bind(wxEVT_LISTBOX_DCLICK, &DebuggerFrame::OnDisassemblyClick, this);
+        breakpoints->Bind(wxEVT_LISTBOX_DCLICK, &DebuggerFrame::OnRemoveBreakpoint, this);
+        classBreaks->Bind(wxEVT_CHECKLISTBOX, &DebuggerFrame::OnClassBreak, this);
+        stackTrap->Bind(wxEVT_CHECKBOX, [this](wxCommandEvent &event)
+                        {
+                            bool on = event.IsChecked();
+                            canvas->WithDebugger([&](Chip8Debugger &debugger, const Chip8 &)
+                                                 { debugger.setStackTrap(on); });
+                        });
+        Bind(wxEVT_TIMER, [this](wxTimerEvent &)
+             { Poll(); });
+        Bind(wxEVT_CLOSE_WINDOW, &DebuggerFrame::OnClose, this);
+
+        CreateStatusBar();
+        canvas->SetDebugging(true);
+        UpdateView();
+        refreshTimer.Start(250);
+    }
+
+private:
+    enum class Kind
+    {
+        Breakpoint, // On PC
+        Watch,      // Stops in front of a write
+        Log         // Writes go to the log
+    };
+
+    // One breakpoint, watched or logged byte, as listed
+    struct Entry
+    {
+        uint16_t address;
+        Kind kind;
+    };
+
+    static constexpr size_t writeLines = 200;
+
+    void Poll()
+    {
+        if (canvas->TakeDebugBreak())
+        {
+            Chip8Debugger::Stop stop = Chip8Debugger::Stop::None;
+            uint16_t at = 0;
+            canvas->WithDebugger([&](Chip8Debugger &debugger, const Chip8 &)
+                                 {
+                                     stop = debugger.lastStop();
+                                     at = debugger.stopAddress();
+                                 });
+            if (stop == Chip8Debugger::Stop::MemoryWrite)
+                SetStatusText(wxString::Format("Stopped: the next instruction writes 0x%03X", at));
+            else if (stop == Chip8Debugger::Stop::OpcodeClass)
+                SetStatusText(wxString::Format("Stopped: opcode class breakpoint at 0x%03X", at));
+            else if (stop == Chip8Debugger::Stop::StackOverflow)
+                SetStatusText(wxString::Format("Stopped: call at 0x%03X overflows the stack", at));
+            else if (stop == Chip8Debugger::Stop::StackUnderflow)
+                SetStatusText(wxString::Format("Stopped: return at 0x%03X with the stack empty", at));
+            else
+                SetStatusText(wxString::Format("Stopped: breakpoint at 0x%03X", at));
+            Raise();
+        }
+        DrainWrites();
+        UpdateView();
+    }
+
+    // The newest writes last, the list trimmed to its last lines
+    void DrainWrites()
+    {
+        Chip8Debugger::WriteEvent event;
+        bool any = false;
+        while (canvas->TakeDebugWrite(event))
+        {
+            writeLog.push_back(wxString::Format("%03X  %02X -> %02X  by %03X  at %llu", event.addr, event.before, event.after, event.pc,
+                                                static_cast<unsigned long long>(event.cycle)));
+            any = true;
+        }
+        if (!any)
+            return;
+        if (writeLog.size() > writeLines)
+            writeLog.erase(writeLog.begin(), writeLog.begin() + (writeLog.size() - writeLines));
+        wxArrayString lines;
+        for (const wxString &line : writeLog)
+            lines.Add(line);
+        writeList->Set(lines);
+        writeList->EnsureVisible(static_cast<int>(lines.size()) - 1);
+    }
+
+    // Copies the state out under the core lock, then fills the views
+    void UpdateView()
+    {
+        std::array<uint8_t, Chip8::memorySize> memory;
+        std::array<uint8_t, 16> v;
+        std::array<uint16_t, Chip8::stackDepth> stack;
+        uint16_t pc = 0, index = 0;
+        uint8_t sp = 0, delay = 0, sound = 0;
+        bool waiting = false;
+        std::vector<Chip8Debugger::TraceEntry> trace;
+        std::vector<bool> marked;
+        const int before = 12, after = 28;
+        canvas->WithDebugger([&](Chip8Debugger &debugger, const Chip8 &chip8)
+                             {
+                                 memory = chip8.getMemory();
+                                 v = chip8.getV();
+                                 stack = chip8.getStack();
+                                 pc = chip8.getPC();
+                                 index = chip8.getI();
+                                 sp = chip8.getSP();
+                                 delay = chip8.getDelayTimer();
+                                 sound = chip8.getSoundTimer();
+                                 waiting = chip8.isWaitingForKey();
+                                 size_t count = std::min<size_t>(debugger.traceSize(), 16);
+                                 for (size_t i = debugger.traceSize() - count; i < debugger.traceSize(); ++i)
+                                     trace.push_back(debugger.traceAt(i));
+                                 for (int i = -before; i < after; ++i)
+                                     marked.push_back(debugger.hasBreakpoint(static_cast<uint16_t>((pc + 2 * i) & 0xFFF)));
+                             });
+
+        auto word = [&](unsigned addr)
+        { return static_cast<uint16_t>((memory[addr & 0xFFF] << 8) | memory[(addr + 1) & 0xFFF]); };
+
+        // Addresses step by two from an even distance to PC, so the listing
+        // stays aligned to the instructions being run
+        wxArrayString lines;
+        disassemblyRows.clear();
+        for (int i = -before; i < after; ++i)
+        {
+            unsigned addr = (pc + 2 * i) & 0xFFF;
+            uint16_t opcode = word(addr);
+            lines.Add(wxString::Format("%s%s %03X  %04X  %s", addr == pc ? ">" : " ", marked[i + before] ? "*" : " ", addr,
+                                       opcode, Chip8Disassembler::text(opcode, word(addr + 2))));
+            disassemblyRows.push_back(static_cast<uint16_t>(addr));
+        }
+        disassembly->Set(lines);
+        disassembly->SetSelection(before);
+
+        wxString text = wxString::Format("PC %03X  I %03X  SP %X  DT %02X  ST %02X%s\n\n", pc, index, sp, delay, sound,
+                                         waiting ? "  (waiting for a key)" : "");
+        for (int r = 0; r < 16; ++r)
+            text += wxString::Format("V%X %02X%s", r, v[r], r % 4 == 3 ? "\n" : "   ");
+        text += "\nStack:";
+        for (int i = 0; i < sp && i < Chip8::stackDepth; ++i)
+            text += wxString::Format(" %03X", stack[i]);
+        registers->SetLabel(text);
+
+        wxArrayString traceLines;
+        for (const Chip8Debugger::TraceEntry &entry : trace)
+            traceLines.Add(wxString::Format("%03X  %04X  %s", entry.pc, entry.opcode, Chip8Disassembler::text(entry.opcode)));
+        traceTail->Set(traceLines);
+
+        // 16 rows of 16 bytes, redrawn only when they change so the view keeps its scroll
+        if (followIndex->GetValue())
+            memoryStart = index & 0xFF0;
+        wxString hex;
+        for (unsigned row = 0; row < 16; ++row)
+        {
+            unsigned base = (memoryStart + row * 16) & 0xFFF;
+            hex += wxString::Format("%03X ", base);
+            for (unsigned b = 0; b < 16; ++b)
+                hex += wxString::Format(" %02X", memory[(base + b) & 0xFFF]);
+            hex += "\n";
+        }
+        if (hex != memoryView->GetValue())
+            memoryView->ChangeValue(hex);
+    }
+
+    bool ParseAddress(uint16_t &addr)
+    {
+        unsigned long value = 0;
+        if (!addressBox->GetValue().ToULong(&value, 16) || value >= Chip8::memorySize)
+        {
+            SetStatusText("Enter a hex address from 000 to FFF");
+            return false;
+        }
+        addr = static_cast<uint16_t>(value);
+        return true;
+    }
+
+    void ShowMemoryAt()
+    {
+        uint16_t addr;
+        if (!ParseAddress(addr))
+            return;
+        followIndex->SetValue(false);
+        memoryStart = addr & 0xFF0;
+        UpdateView();
+    }
+
+    void ToggleAddress(Kind kind)
+    {
+        uint16_t addr;
+        if (ParseAddress(addr))
+            SetEntry({addr, kind}, std::none_of(entries.begin(), entries.end(), [&](const Entry &e)
+                                                { return e.address == addr && e.kind == kind; }));
+    }
+
+    void SetEntry(const Entry &entry, bool on)
+    {
+        canvas->WithDebugger([&](Chip8Debugger &debugger, const Chip8 &)
+                             {
+                                 if (entry.kind == Kind::Watch)
+                                     debugger.setWatch(entry.address, on);
+                                 else if (entry.kind == Kind::Log)
+                                     debugger.setWriteLog(entry.address, on);
+                                 else
+                                     debugger.setBreakpoint(entry.address, on);
+                             });
+        entries.erase(std::remove_if(entries.begin(), entries.end(), [&](const Entry &e)
+                                     { return e.address == entry.address && e.kind == entry.kind; }),
+                      entries.end());
+        if (on)
+            entries.push_back(entry);
+
+        wxArrayString lines;
+        for (const Entry &e : entries)
+            lines.Add(wxString::Format("%s %03X", e.kind == Kind::Watch ? "Write" : e.kind == Kind::Log ? "Log  " : "PC   ", e.address));
+        breakpoints->Set(lines);
+        UpdateView();
+    }
+
+    void OnDisassemblyClick(wxCommandEvent &event)
+    {
+        int row = event.GetSelection();
+        if (row < 0 || row >= static_cast<int>(disassemblyRows.size()))
+            return;
+        uint16_t addr = disassemblyRows[row];
+        SetEntry({addr, Kind::Breakpoint}, std::none_of(entries.begin(), entries.end(), [&](const Entry &e)
+                                                        { return e.address == addr && e.kind == Kind::Breakpoint; }));
+    }
+
+    void OnRemoveBreakpoint(wxCommandEvent &event)
+    {
+        int row = event.GetSelection();
+        if (row >= 0 && row < static_cast<int>(entries.size()))
+            SetEntry(entries[row], false);
+    }
+
+    void OnClassBreak(wxCommandEvent &event)
+    {
+        int cls = event.GetInt();
+        bool on = classBreaks->IsChecked(cls);
+        canvas->WithDebugger([&](Chip8Debugger &debugger, const Chip8 &)
+                             { debugger.setClassBreak(cls, on); });
+    }
+
+    // Paused first, so the step is the only instruction that runs
+    void OnStep(wxCommandEvent &)
+    {
+        canvas->SetPaused(true);
+        canvas->DebugStep();
+        SetStatusText("Paused");
+        UpdateView();
+    }
+
+    // Time travel, from the history the debugger keeps while it steps
+    void OnStepBack(wxCommandEvent &)
+    {
+        canvas->SetPaused(true);
+        SetStatusText(canvas->DebugStepBack() ? "Paused" : "No history to step back through");
+        UpdateView();
+    }
+
+    void OnRunBack(wxCommandEvent &)
+    {
+        canvas->SetPaused(true);
+        if (!canvas->DebugRunBack())
+        {
+            SetStatusText("No history to run back through");
+            return;
+        }
+        Chip8Debugger::Stop stop = Chip8Debugger::Stop::None;
+        uint16_t at = 0;
+        canvas->WithDebugger([&](Chip8Debugger &debugger, const Chip8 &)
+                             {
+                                 stop = debugger.lastStop();
+                                 at = debugger.stopAddress();
+                             });
+        if (stop == Chip8Debugger::Stop::HistoryStart)
+            SetStatusText(wxString::Format("Back at the start of the history, 0x%03X", at));
+        else if (stop == Chip8Debugger::Stop::MemoryWrite)
+            SetStatusText(wxString::Format("Stopped back: the next instruction writes 0x%03X", at));
+        else if (stop == Chip8Debugger::Stop::OpcodeClass)
+            SetStatusText(wxString::Format("Stopped back: opcode class breakpoint at 0x%03X", at));
+        else if (stop == Chip8Debugger::Stop::StackOverflow || stop == Chip8Debugger::Stop::StackUnderflow)
+            SetStatusText(wxString::Format("Stopped back: stack trap at 0x%03X", at));
+        else
+            SetStatusText(wxString::Format("Stopped back: breakpoint at 0x%03X", at));
+        UpdateView();
+    }
+
+    void OnSaveTrace(wxCommandEvent &)
+    {
+        wxFileDialog dlg(this, "Save Trace", "", "trace.txt", "Text files (*.txt)|*.txt", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+        if (dlg.ShowModal() != wxID_OK)
+            return;
+
+        // Copied out first, formatting a million lines shouldn't hold the core
+        std::vector<Chip8Debugger::TraceEntry> trace;
+        canvas->WithDebugger([&](Chip8Debugger &debugger, const Chip8 &)
+                             {
+                                 trace.reserve(debugger.traceSize());
+                                 for (size_t i = 0; i < debugger.traceSize(); ++i)
+                                     trace.push_back(debugger.traceAt(i));
+                             });
+        wxFFile file(dlg.GetPath(), "w");
+        if (!file.IsOpened())
+        {
+            SetStatusText("Failed to save trace");
+            return;
+        }
+        wxBusyCursor busy;
+        for (const Chip8Debugger::TraceEntry &entry : trace)
+            file.Write(wxString::Format("%03X  %04X  %s\n", entry.pc, entry.opcode, Chip8Disassembler::text(entry.opcode)));
+        SetStatusText(wxString::Format("Saved %zu instructions to %s", trace.size(), dlg.GetPath()));
+    }
+
+    // The machine runs at full speed again once nothing watches it
+    void OnClose(wxCloseEvent &)
+    {
+        refreshTimer.Stop();
+        canvas->SetDebugging(false);
+        Destroy();
+    }
+
+    Chip8Canvas *canvas;
+    wxTimer refreshTimer;
+    wxTextCtrl *addressBox;
+    wxCheckBox *followIndex;
+    wxListBox *disassembly;
+    wxStaticText *registers;
+    wxListBox *breakpoints;
+    wxListBox *traceTail;
+    wxListBox *writeList;
+    wxCheckListBox *classBreaks;
+    wxCheckBox *stackTrap;
+    wxTextCtrl *memoryView;
+    MemoryMapCanvas *memoryMap;
+    std::vector<uint16_t> disassemblyRows; // Address of each disassembly line
+    std::vector<Entry> entries;
+    std::vector<wxString> writeLog; // Lines of writeList
+    unsigned memoryStart = 0x200;
+};
+
+// -------------------------
+// Cheats window
+// -------------------------
+// RAM search and the loaded ROM's cheats. The results refresh every frame
+// from a copy of memory; with Live checked the last filter is applied to
+// each copy too, so holding still and watching what stays Unchanged, say,
+// narrows the list as the game runs.
+class CheatsFrame : public wxFrame
+{
+public:
+    CheatsFrame(wxWindow *parent, Chip8Canvas *canvasRef)
+        : wxFrame(parent, wxID_ANY, "CHIP-8 Cheats", wxDefaultPosition, wxSize(560, 600)),
+          canvas(canvasRef), refreshTimer(this)
+    {
+        wxFont mono(wxFontInfo(9).Family(wxFONTFAMILY_TELETYPE));
+        wxPanel *panel = new wxPanel(this);
+
+        wxBoxSizer *searchControls = new wxBoxSizer(wxHORIZONTAL);
+        wxButton *newButton = new wxButton(panel, wxID_ANY, "New Search");
+        searchControls->Add(newButton, 0, wxRIGHT, 12);
+        const struct
+        {
+            const char *label;
+            MemorySearch::Filter filter;
+        } filters[] = {{"Changed", MemorySearch::Filter::Changed},
+                       {"Unchanged", MemorySearch::Filter::Unchanged},
+                       {"Increased", MemorySearch::Filter::Increased},
+                       {"Decreased", MemorySearch::Filter::Decreased},
+                       {"Equal to", MemorySearch::Filter::Equal}};
+        for (const auto &f : filters)
+        {
+            wxButton *button = new wxButton(panel, wxID_ANY, f.label);
+            const MemorySearch::Filter filter = f.filter;
+            button->Bind(wxEVT_BUTTON, [this, filter](wxCommandEvent &)
+                         { Filter(filter); });
+            searchControls->Add(button, 0, wxRIGHT, 4);
+        }
+        valueBox = new wxTextCtrl(panel, wxID_ANY, "00", wxDefaultPosition, wxSize(40, -1));
+        live = new wxCheckBox(panel, wxID_ANY, "Live");
+        searchControls->Add(valueBox, 0, wxRIGHT, 12);
+        searchControls->Add(live, 0, wxALIGN_CENTER_VERTICAL);
+
+        found = new wxStaticText(panel, wxID_ANY, "Press New Search to start");
+        results = new wxListBox(panel, wxID_ANY);
+        results->SetFont(mono);
+
+        cheatText = new wxTextCtrl(panel, wxID_ANY, "", wxDefaultPosition, wxSize(-1, 140), wxTE_MULTILINE | wxTE_DONTWRAP);
+        cheatText->SetFont(mono);
+        wxButton *applyButton = new wxButton(panel, wxID_ANY, "Apply Cheats");
+
+        wxBoxSizer *sizer = new wxBoxSizer(wxVERTICAL);
+        sizer->Add(searchControls, 0, wxEXPAND | wxALL, 6);
+        sizer->Add(found, 0, wxLEFT | wxRIGHT, 6);
+        sizer->Add(results, 1, wxEXPAND | wxALL, 6);
+        sizer->Add(new wxStaticText(panel, wxID_ANY, "Cheats, e.g. 3F0 = 05 or 3F0 = 09 if 3F1 < 02 (double-click a result to add it):"),
+                   0, wxLEFT | wxRIGHT, 6);
+        sizer->Add(cheatText, 0, wxEXPAND | wxALL, 6);
+        sizer->Add(applyButton, 0, wxLEFT | wxRIGHT | wxBOTTOM, 6);
+        panel->SetSizer(sizer);
+
+        newButton->Bind(wxEVT_BUTTON, [this](wxCommandEvent &)
+                        { NewSearch(); });
+        results->Bind(wxEVT_LISTBOX_DCLICK, &CheatsFrame::OnResultClick, this);
+        applyButton->Bind(wxEVT_BUTTON, [this](wxCommandEvent &)
+                          { ApplyCheats(); });
+        Bind(wxEVT_TIMER, [this](wxTimerEvent &)
+             { Refresh(); });
+        Bind(wxEVT_CLOSE_WINDOW, [this](wxCloseEvent &)
+             { refreshTimer.Stop(); Destroy(); });
+
+        CreateStatusBar();
+        refreshTimer.Start(16);
+    }
+
+    // The loaded ROM's cheats, kept in the config under key ("" with no ROM)
+    void ShowCheats(const wxString &key, const wxString &text)
+    {
+        configKey = key;
+        cheatText->ChangeValue(text);
+    }
+
+private:
+    void CopyMemory()
+    {
+        canvas->WithCore([&]
+                         { memory = canvas->GetChip8().getMemory(); });
+    }
+
+    void NewSearch()
+    {
+        CopyMemory();
+        search.start(memory.data(), memory.size());
+        filtered = false;
+        Refresh();
+    }
+
+    void Filter(MemorySearch::Filter filter)
+    {
+        unsigned long value = 0;
+        if (filter == MemorySearch::Filter::Equal && (!valueBox->GetValue().ToULong(&value, 16) || value > 0xFF))
+        {
+            SetStatusText("Enter a hex value from 00 to FF");
+            return;
+        }
+        if (!search.isStarted())
+            NewSearch();
+        CopyMemory();
+        lastFilter = filter;
+        lastValue = static_cast<uint8_t>(value);
+        filtered = true;
+        search.filter(memory.data(), filter, lastValue);
+        Refresh();
+    }
+
+    // The first few hundred candidates with their last and current values,
+    // the list only rebuilt when a line changes
+    void Refresh()
+    {
+        if (!search.isStarted())
+            return;
+        CopyMemory();
+        if (live->GetValue() && filtered)
+            search.filter(memory.data(), lastFilter, lastValue);
+
+        rows = search.candidates(maxRows);
+        wxArrayString lines;
+        for (uint16_t addr : rows)
+            lines.Add(wxString::Format("%03X  %02X -> %02X", addr, search.previous(addr), memory[addr]));
+        if (lines != shown)
+        {
+            const int selection = results->GetSelection();
+            results->Set(lines);
+            if (selection != wxNOT_FOUND && selection < static_cast<int>(lines.size()))
+                results->SetSelection(selection);
+            shown = lines;
+        }
+        found->SetLabel(search.count() > maxRows ? wxString::Format("%zu addresses, showing the first %zu", search.count(), maxRows)
+                                                  : wxString::Format("%zu addresses", search.count()));
+    }
+
+    void OnResultClick(wxCommandEvent &event)
+    {
+        const int row = event.GetSelection();
+        if (row < 0 || row >= static_cast<int>(rows.size()))
+            return;
+        wxString text = cheatText->GetValue();
+        if (!text.IsEmpty() && !text.EndsWith("\n"))
+            text += "\n";
+        text += wxString::Format("%03X = %02X\n", rows[row], memory[rows[row]]);
+        cheatText->ChangeValue(text);
+    }
+
+    void ApplyCheats()
+    {
+        CheatList list;
+        std::string error;
+        if (!list.compile(std::string(cheatText->GetValue().mb_str()), error))
+        {
+            SetStatusText(wxString(error));
+            return;
+        }
+        canvas->SetCheats(list);
+        if (!configKey.IsEmpty())
+        {
+            if (cheatText->GetValue().IsEmpty())
+                wxConfigBase::Get()->DeleteEntry(configKey);
+            else
+                wxConfigBase::Get()->Write(configKey, cheatText->GetValue());
+        }
+        SetStatusText(wxString::Format("%zu cheats on%s", list.size(), configKey.IsEmpty() ? "" : ", kept for this ROM"));
+    }
+
+    static constexpr size_t maxRows = 256;
+
+    Chip8Canvas *canvas;
+    wxTimer refreshTimer;
+    wxTextCtrl *valueBox;
+    wxCheckBox *live;
+    wxStaticText *found;
+    wxListBox *results;
+    wxTextCtrl *cheatText;
+    std::array<uint8_t, Chip8::memorySize> memory{};
+    MemorySearch search;
+    MemorySearch::Filter lastFilter = MemorySearch::Filter::Unchanged;
+    uint8_t lastValue = 0;
+    bool filtered = false;        // A filter has been applied since New Search, for Live to repeat
+    std::vector<uint16_t> rows;   // Address of each result line
+    wxArrayString shown;
+    wxString configKey;
+};
+
+    // -------------------------
+    // Main frame (with canvas)
+    // -------------------------
+    class Chip8FrameWithCanvas : public wxFrame
+{
+public:
+    static constexpr uint64_t fixedBootSeed = 1; // Seed of Same Seed Only boots
+
+    // Where InstantBoot keeps its states
+    static std::string BootDirectory()
+    {
+        return std::string((wxStandardPaths::Get().GetUserDataDir() + wxFILE_SEP_PATH + "boot").mb_str());
+    }
+
+    explicit Chip8FrameWithCanvas(const wxString &romFile, const LaunchOptions &launch = LaunchOptions())
+        : wxFrame(nullptr, wxID_ANY, "CHIP-8 Emulator", wxDefaultPosition, wxSize(640, 480)),
+          metricsTimer(this, ID_METRICS_TIMER), netplayTimer(this, ID_NETPLAY_TIMER), reloadTimer(this, ID_RELOAD_TIMER)
+    {
+        SetIcon(wxICON(IDI_APP_ICON));
+
+        // ---- Menu Bar ----
+        wxMenu *fileMenu = new wxMenu;
+        fileMenu->Append(wxID_OPEN, "Open Game\tCtrl+O");
+        fileMenu->AppendSeparator();
+        fileMenu->Append(wxID_EXIT);
+
+        wxMenu *emulationMenu = new wxMenu;
+        emulationMenu->Append(wxID_STOP, "Pause\tCtrl+P");
+        emulationMenu->Append(wxID_REFRESH, "Reset\tCtrl+R");
+        emulationMenu->AppendCheckItem(ID_WATCH_ROM, "Reload ROM on Change");
+        emulationMenu->AppendCheckItem(ID_WATCH_KEEP_STATE, "Keep State on Reload");
+        emulationMenu->AppendCheckItem(ID_RUN_HIDDEN, "Run While Minimized");
+
+        wxMenu *threadMenu = new wxMenu;
+        threadMenu->AppendCheckItem(ID_THREAD_PRIORITY, "High Priority");
+        threadMenu->Append(ID_THREAD_CORES, "Cores...");
+        emulationMenu->AppendSubMenu(threadMenu, "Threads");
+
+        wxMenu *bootMenu = new wxMenu;
+        bootMenu->AppendRadioItem(ID_BOOT_OFF, "Off");
+        bootMenu->AppendRadioItem(ID_BOOT_ON, "On");
+        bootMenu->AppendRadioItem(ID_BOOT_SAME_SEED, "Same Seed Only");
+        emulationMenu->AppendSubMenu(bootMenu, "Instant Boot");
+        emulationMenu->AppendSeparator();
+        emulationMenu->Append(ID_SAVE_STATE, "Save State\tF5");
+        emulationMenu->Append(ID_LOAD_STATE, "Load State\tF8");
+        emulationMenu->AppendCheckItem(ID_AUTOSAVE, "Autosave and Resume");
+        emulationMenu->AppendSeparator();
+        emulationMenu->Append(ID_RECORD_MOVIE, "Record Movie...");
+        emulationMenu->Append(ID_STOP_MOVIE, "Stop Recording");
+        emulationMenu->Append(ID_RECORD_VIDEO, "Record Video...");
+        emulationMenu->Append(ID_STOP_VIDEO, "Stop Video");
+        emulationMenu->Append(ID_EXPORT_VIDEO, "Export Video...");
+        emulationMenu->Append(ID_SCREENSHOT, "Screenshot\tF9");
+        wxMenu *screenshotMenu = new wxMenu;
+        screenshotMenu->AppendRadioItem(ID_SCREENSHOT_1X, "1x");
+        screenshotMenu->AppendRadioItem(ID_SCREENSHOT_2X, "2x");
+        screenshotMenu->AppendRadioItem(ID_SCREENSHOT_4X, "4x");
+        screenshotMenu->AppendRadioItem(ID_SCREENSHOT_8X, "8x");
+        emulationMenu->AppendSubMenu(screenshotMenu, "Screenshot Scale");
+        emulationMenu->AppendSeparator();
+        emulationMenu->Append(ID_HOST_NETPLAY, "Host Netplay...");
+        emulationMenu->Append(ID_JOIN_NETPLAY, "Join Netplay...");
+        emulationMenu->Append(ID_STOP_NETPLAY, "Stop Netplay");
+        emulationMenu->AppendSeparator();
+        emulationMenu->AppendCheckItem(ID_SHARE_FRAMES, "Share Frames");
+        emulationMenu->Append(ID_DEBUGGER, "Debugger...\tF12");
+        emulationMenu->Append(ID_CHEATS, "Cheats...");
+#if defined(CHIP8_LUA)
+        emulationMenu->Append(ID_LOAD_SCRIPT, "Load Script...");
+        emulationMenu->Append(ID_STOP_SCRIPT, "Stop Script");
+#endif
+#if defined(_WIN32)
+        emulationMenu->AppendCheckItem(ID_RAW_KEYBOARD, "Raw Keyboard Input");
+#endif
+        emulationMenu->AppendCheckItem(ID_GAMEPAD, "Gamepad");
+        emulationMenu->Append(ID_GAMEPAD_MAPPING, "Gamepad Mapping...");
+        emulationMenu->Append(ID_KEYBOARD_MAPPING, "Keyboard Mapping...");
+        wxMenu *layoutMenu = new wxMenu;
+        for (size_t i = 0; i < KeyMap::presets().size(); ++i)
+            layoutMenu->Append(ID_KEYS_PRESET + static_cast<int>(i), KeyMap::presets()[i].name);
+        emulationMenu->AppendSubMenu(layoutMenu, "Keyboard Layout");
+        wxMenu *audioMenu = new wxMenu;
+        audioMenu->AppendRadioItem(ID_AUDIO_128, "128 Samples (Lowest Latency)");
+        audioMenu->AppendRadioItem(ID_AUDIO_256, "256 Samples");
+        audioMenu->AppendRadioItem(ID_AUDIO_512, "512 Samples");
+        audioMenu->AppendRadioItem(ID_AUDIO_1024, "1024 Samples (Safest)");
+        emulationMenu->AppendSubMenu(audioMenu, "Audio Buffer");
+        emulationMenu->AppendSeparator();
+        emulationMenu->AppendCheckItem(ID_SHOW_METRICS, "Show Performance\tF3");
+        emulationMenu->Append(ID_SAVE_METRICS, "Save Performance Log...");
+        emulationMenu->AppendCheckItem(ID_MEASURE_LATENCY, "Measure Input Latency");
+        emulationMenu->AppendCheckItem(ID_SAMPLE_PC, "Sample PC");
+        emulationMenu->Append(ID_SAVE_PC_SAMPLES, "Save PC Samples...");
+        emulationMenu->AppendSeparator();
+
+        wxMenu *speedMenu = new wxMenu;
+        speedMenu->AppendRadioItem(ID_SPEED_UNTHROTTLED, "Unthrottled");
+        speedMenu->AppendRadioItem(ID_SPEED_1MHZ, "1 MHz");
+        speedMenu->AppendRadioItem(ID_SPEED_FASTEST, "Fastest (1200 Hz)");
+        speedMenu->AppendRadioItem(ID_SPEED_FAST, "Fast (600 Hz)");
+        speedMenu->AppendRadioItem(ID_SPEED_NORMAL, "Normal (300 Hz)");
+        speedMenu->AppendRadioItem(ID_SPEED_SLOW, "Slow (120 Hz)");
+        speedMenu->AppendRadioItem(ID_SPEED_VIP, "COSMAC VIP Timing");
+        speedMenu->AppendRadioItem(ID_SPEED_CUSTOM, "Custom...");
+        speedMenu->AppendSeparator();
+        speedMenu->Append(ID_AUTO_TUNE, "Auto-Tune");
+        speedMenu->AppendCheckItem(ID_AUTO_TUNE_NEW, "Auto-Tune New ROMs");
+        wxMenuItem *normalItem = speedMenu->FindItem(ID_SPEED_NORMAL);
+        if (normalItem)
+        {
+            normalItem->Check(true);
+        }
+        emulationMenu->AppendSubMenu(speedMenu, "Speed");
+
+        wxMenu *fastForwardMenu = new wxMenu;
+        fastForwardMenu->AppendRadioItem(ID_FF_OFF, "Off");
+        fastForwardMenu->AppendRadioItem(ID_FF_10X, "10x\tCtrl+F");
+        fastForwardMenu->AppendRadioItem(ID_FF_100X, "100x");
+        fastForwardMenu->AppendRadioItem(ID_FF_UNLIMITED, "Unlimited");
+        emulationMenu->AppendSubMenu(fastForwardMenu, "Fast Forward");
+
+        wxMenu *runAheadMenu = new wxMenu;
+        runAheadMenu->AppendRadioItem(ID_RUN_AHEAD_OFF, "Off");
+        runAheadMenu->AppendRadioItem(ID_RUN_AHEAD_1, "1 Frame");
+        runAheadMenu->AppendRadioItem(ID_RUN_AHEAD_2, "2 Frames");
+        emulationMenu->AppendSubMenu(runAheadMenu, "Run-Ahead");
+
+        wxMenu *screenMenu = new wxMenu;
+        screenMenu->AppendRadioItem(ID_SCREEN_CLASSIC, "Classic");
+        screenMenu->AppendRadioItem(ID_SCREEN_GREEN, "Green");
+        screenMenu->AppendSeparator();
+        screenMenu->AppendCheckItem(ID_SCREEN_SCANLINES, "Scanlines");
+        screenMenu->AppendCheckItem(ID_SCREEN_PHOSPHOR, "Phosphor Persistence");
+        screenMenu->AppendCheckItem(ID_SCREEN_BLOOM, "Bloom");
+        screenMenu->AppendCheckItem(ID_SCREEN_BLEND, "Blend Frames");
+        screenMenu->AppendCheckItem(ID_SCREEN_WHOLE, "Whole Pictures Only");
+        wxMenu *upscaleMenu = new wxMenu;
+        upscaleMenu->AppendRadioItem(ID_UPSCALE_NONE, "None");
+        upscaleMenu->AppendRadioItem(ID_UPSCALE_SCALE2X, "Scale2x");
+        upscaleMenu->AppendRadioItem(ID_UPSCALE_XBR, "xBR");
+        screenMenu->AppendSubMenu(upscaleMenu, "Upscaling");
+        screenMenu->AppendSeparator();
+        screenMenu->AppendCheckItem(ID_FULLSCREEN, "Full Screen\tF11");
+        screenMenu->AppendCheckItem(ID_FULLSCREEN_EXCLUSIVE, "Exclusive Full Screen");
+        screenMenu->AppendSeparator();
+
+        wxMenu *rendererMenu = new wxMenu;
+        rendererMenu->AppendRadioItem(ID_RENDERER_OPENGL, "OpenGL");
+#if defined(_WIN32)
+        rendererMenu->AppendRadioItem(ID_RENDERER_D3D11, "Direct3D 11");
+#endif
+        rendererMenu->AppendRadioItem(ID_RENDERER_SOFTWARE, "Software");
+        screenMenu->AppendSubMenu(rendererMenu, "Renderer");
+        wxMenuItem *classicItem = screenMenu->FindItem(ID_SCREEN_CLASSIC);
+        if (classicItem)
+        {
+            classicItem->Check(true);
+        }
+
+        wxMenuBar *menuBar = new wxMenuBar;
+        menuBar->Append(fileMenu, "&File");
+        menuBar->Append(emulationMenu, "&Emulation");
+        menuBar->Append(screenMenu, "&Screen");
+        SetMenuBar(menuBar);
+
+        // ---- Bind events ----
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnOpenGame, this, wxID_OPEN);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnQuit, this, wxID_EXIT);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnPause, this, wxID_STOP);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnReset, this, wxID_REFRESH);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnSaveState, this, ID_SAVE_STATE);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnLoadState, this, ID_LOAD_STATE);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnAutosave, this, ID_AUTOSAVE);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnRecordMovie, this, ID_RECORD_MOVIE);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnStopMovie, this, ID_STOP_MOVIE);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnRecordVideo, this, ID_RECORD_VIDEO);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnStopVideo, this, ID_STOP_VIDEO);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnExportVideo, this, ID_EXPORT_VIDEO);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnScreenshot, this, ID_SCREENSHOT);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnScreenshotScale, this, ID_SCREENSHOT_1X, ID_SCREENSHOT_8X);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnShowMetrics, this, ID_SHOW_METRICS);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnSaveMetrics, this, ID_SAVE_METRICS);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnMeasureLatency, this, ID_MEASURE_LATENCY);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnSamplePc, this, ID_SAMPLE_PC);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnSavePcSamples, this, ID_SAVE_PC_SAMPLES);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnHostNetplay, this, ID_HOST_NETPLAY);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnJoinNetplay, this, ID_JOIN_NETPLAY);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnStopNetplay, this, ID_STOP_NETPLAY);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnShareFrames, this, ID_SHARE_FRAMES);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnDebugger, this, ID_DEBUGGER);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnCheats, this, ID_CHEATS);
+#if defined(CHIP8_LUA)
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnLoadScript, this, ID_LOAD_SCRIPT);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnStopScript, this, ID_STOP_SCRIPT);
+        Bind(wxEVT_TIMER, &Chip8FrameWithCanvas::OnScriptTimer, this, ID_SCRIPT_TIMER);
+#endif
+        Bind(wxEVT_TIMER, &Chip8FrameWithCanvas::OnMetricsTimer, this, ID_METRICS_TIMER);
+        Bind(wxEVT_TIMER, &Chip8FrameWithCanvas::OnNetplayTimer, this, ID_NETPLAY_TIMER);
+        Bind(wxEVT_TIMER, &Chip8FrameWithCanvas::OnReloadTimer, this, ID_RELOAD_TIMER);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnWatchROM, this, ID_WATCH_ROM, ID_WATCH_KEEP_STATE);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnRunHidden, this, ID_RUN_HIDDEN);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnThreadPriority, this, ID_THREAD_PRIORITY);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnThreadCores, this, ID_THREAD_CORES);
+        Bind(wxEVT_FSWATCHER, &Chip8FrameWithCanvas::OnFileChanged, this);
+        Bind(wxEVT_CLOSE_WINDOW, &Chip8FrameWithCanvas::OnClose, this);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnSpeedChange, this, ID_SPEED_FASTEST, ID_SPEED_CUSTOM);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnAutoTune, this, ID_AUTO_TUNE);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnAutoTuneNew, this, ID_AUTO_TUNE_NEW);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnFastForwardChange, this, ID_FF_OFF, ID_FF_UNLIMITED);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnRunAheadChange, this, ID_RUN_AHEAD_OFF, ID_RUN_AHEAD_2);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnInstantBootChange, this, ID_BOOT_OFF, ID_BOOT_SAME_SEED);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnScreenFilterChange, this, ID_SCREEN_CLASSIC, ID_SCREEN_GREEN);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnScreenEffectChange, this, ID_SCREEN_SCANLINES, ID_SCREEN_BLOOM);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnScreenEffectChange, this, ID_UPSCALE_NONE, ID_UPSCALE_XBR);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnFrameBlend, this, ID_SCREEN_BLEND);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnWholePictures, this, ID_SCREEN_WHOLE);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnFullScreen, this, ID_FULLSCREEN);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnExclusiveFullScreen, this, ID_FULLSCREEN_EXCLUSIVE);
+        Bind(wxEVT_CHAR_HOOK, &Chip8FrameWithCanvas::OnCharHook, this);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnRendererChange, this, ID_RENDERER_OPENGL, ID_RENDERER_SOFTWARE);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnRawKeyboard, this, ID_RAW_KEYBOARD);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnGamepad, this, ID_GAMEPAD);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnGamepadMapping, this, ID_GAMEPAD_MAPPING);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnKeyboardMapping, this, ID_KEYBOARD_MAPPING);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnKeyboardLayout, this, ID_KEYS_PRESET, ID_KEYS_PRESET + static_cast<int>(KeyMap::presets().size()) - 1);
+        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnAudioBuffer, this, ID_AUDIO_128, ID_AUDIO_1024);
+
+        // ---- Layout ----
+        wxBoxSizer *mainSizer = new wxBoxSizer(wxVERTICAL);
+
+        // Canvas (bigger proportion)
+        canvas = new Chip8Canvas(this);
+        chip8 = &canvas->GetChip8();
+        canvas->SetClockRate(300);
+        instantBoot = static_cast<int>(wxConfigBase::Get()->ReadLong("/Emulation/InstantBoot", 0));
+        GetMenuBar()->Check(ID_BOOT_OFF + std::clamp(instantBoot, 0, 2), true);
+        const wxString renderer = wxConfigBase::Get()->Read("/Screen/Renderer", "opengl");
+        if (renderer == "software")
+        {
+            canvas->SetBackend(Chip8Canvas::Backend::Software);
+            GetMenuBar()->Check(ID_RENDERER_SOFTWARE, true);
+        }
+#if defined(_WIN32)
+        if (renderer == "d3d11")
+        {
+            canvas->SetBackend(Chip8Canvas::Backend::Direct3D11);
+            GetMenuBar()->Check(ID_RENDERER_D3D11, true);
+        }
+        if (wxConfigBase::Get()->ReadBool("/Input/RawKeyboard", false) && canvas->SetRawKeyboard(true))
+            GetMenuBar()->Check(ID_RAW_KEYBOARD, true);
+#endif
+        GetMenuBar()->Check(ID_FULLSCREEN_EXCLUSIVE, wxConfigBase::Get()->ReadBool("/Screen/ExclusiveFullScreen", false));
+        GetMenuBar()->Check(ID_GAMEPAD, wxConfigBase::Get()->ReadBool("/Gamepad/Enabled", true));
+        ApplyGamepad();
+        GetMenuBar()->Check(ID_WATCH_ROM, wxConfigBase::Get()->ReadBool("/Emulation/WatchROM", false));
+        GetMenuBar()->Check(ID_WATCH_KEEP_STATE, wxConfigBase::Get()->ReadBool("/Emulation/WatchKeepState", false));
+        GetMenuBar()->Check(ID_RUN_HIDDEN, wxConfigBase::Get()->ReadBool("/Emulation/RunHidden", true));
+        GetMenuBar()->Check(ID_AUTOSAVE, wxConfigBase::Get()->ReadBool("/Emulation/Autosave", false));
+        canvas->SetRunWhileHidden(GetMenuBar()->IsChecked(ID_RUN_HIDDEN));
+        ApplyThreadTuning();
+        GetMenuBar()->Check(ID_THREAD_PRIORITY, ThreadTuning::shared().isHighPriority());
+        GetMenuBar()->Check(ID_AUTO_TUNE_NEW, wxConfigBase::Get()->ReadBool("/Emulation/AutoTune", false));
+        const long audioSamples = wxConfigBase::Get()->ReadLong("/Audio/BufferSamples", AudioOutput::defaultBufferSamples);
+        const long screenshotScale = wxConfigBase::Get()->ReadLong("/Screen/ScreenshotScale", 4);
+        GetMenuBar()->Check(screenshotScale <= 1 ? ID_SCREENSHOT_1X : screenshotScale <= 2 ? ID_SCREENSHOT_2X : screenshotScale <= 4 ? ID_SCREENSHOT_4X : ID_SCREENSHOT_8X, true);
+        GetMenuBar()->Check(audioSamples <= 128 ? ID_AUDIO_128 : audioSamples <= 256 ? ID_AUDIO_256 : audioSamples <= 512 ? ID_AUDIO_512 : ID_AUDIO_1024, true);
+        SettingsStore::Settings global;
+        if (Preferences().find(SettingsStore::globalKey, global))
+            ApplySettings(global);
+        ApplyKeyMap();
+        ApplyLaunchOptions(launch);
+        mainSizer->Add(canvas, 3, wxEXPAND | wxALL, 5); // proportion=3 for more space
+
+        // Keypad
+        keypadSizer = new wxGridSizer(4, 4, 5, 5);
+        const char *labels[16] = {"1", "2", "3", "C", "4", "5", "6", "D", "7", "8", "9", "E", "A", "0", "B", "F"};
+        const int keyMap[16] = {
+            0x1, 0x2, 0x3, 0xC, // 1 2 3 C
+            0x4, 0x5, 0x6, 0xD, // 4 5 6 D
+            0x7, 0x8, 0x9, 0xE, // 7 8 9 E
+            0xA, 0x0, 0xB, 0xF  // A 0 B F
+        };
+
+        for (int i = 0; i < 16; ++i)
+        {
+            PixelButton *btn = new PixelButton(this, 1000 + i, labels[i]);
+            keypadSizer->Add(btn, 1, wxEXPAND);
+            keypadButtons[keyMap[i]] = btn;
+
+            btn->Bind(wxEVT_BUTTON, [](wxCommandEvent &) { /* empty: preserves button clicking animation */ });
+
+            btn->Bind(wxEVT_LEFT_DOWN, [=](wxMouseEvent &event)
+                      {
+                          if (!MouseFromTouch())
+                          {
+                              canvas->PostKey(keyMap[i], true);
+                              canvas->SetFocus();
+                          }
+                          event.Skip(); // allow button to process the click normally
+                      });
+
+            btn->Bind(wxEVT_LEFT_UP, [=](wxMouseEvent &event)
+                      {
+                          if (!MouseFromTouch())
+                          {
+                              canvas->PostKey(keyMap[i], false);
+                              canvas->SetFocus();
+                          }
+                          event.Skip(); // allow button to process the click normally
+                      });
+
+            // Every finger is a key of its own, so two can be held at once
+            btn->EnableTouchEvents(wxTOUCH_RAW_EVENTS);
+            btn->Bind(wxEVT_TOUCH_BEGIN, &Chip8FrameWithCanvas::OnKeypadTouch, this);
+            btn->Bind(wxEVT_TOUCH_MOVE, &Chip8FrameWithCanvas::OnKeypadTouch, this);
+            btn->Bind(wxEVT_TOUCH_END, &Chip8FrameWithCanvas::OnKeypadTouch, this);
+            btn->Bind(wxEVT_TOUCH_CANCEL, &Chip8FrameWithCanvas::OnKeypadTouch, this);
+        }
+
+        // Lit from the machine's own key state, so keys pressed on the
+        // keyboard, a gamepad or by a movie show too
+        canvas->onKeysShown = [this](uint16_t keys)
+        {
+            for (int k = 0; k < 16; ++k)
+                keypadButtons[k]->SetLit((keys >> k) & 1);
+        };
+
+        mainSizer->Add(keypadSizer, 1, wxEXPAND | wxALL, 10);
+        SetSizer(mainSizer);
+        Layout();
+        canvas->SetFocus();
+
+        // ---- Status Bar ----
+        CreateStatusBar();
+        LoadROM(romFile);
+        canvas->StartEmulation();
+    }
+
+private:
+    void OnOpenGame(wxCommandEvent &)
+    {
+        wxFileDialog dlg(this, "Open ROM", "", "",
+                         "CHIP-8 ROMs (*.ch8;*.rom;*.zip)|*.ch8;*.rom;*.zip|All files (*.*)|*.*",
+                         wxFD_OPEN);
+        if (dlg.ShowModal() == wxID_OK)
+            LoadROM(dlg.GetPath());
+    }
+
+    void OnQuit(wxCommandEvent &) { Close(); }
+
+    enum class LoadReason
+    {
+        Open,
+        Reset,
+        FileChanged // By the watcher, see WatchROM
+    };
+
+    // The file is read off the GUI thread; the rest happens in ROMLoaded
+    // once the emulation thread has installed it
+    void LoadROM(const wxString &path, LoadReason reason = LoadReason::Open)
+    {
+        FinishRecording();
+        FinishNetplay();
+        if (reason == LoadReason::Open)
+            StopAutosave();
+        SetStatusText((reason == LoadReason::Open ? "Loading " : "Reloading ") + path);
+        const bool keepState = reason == LoadReason::FileChanged && GetMenuBar()->IsChecked(ID_WATCH_KEEP_STATE);
+        canvas->LoadROMAsync(path, [this, path, reason](EmulationThread::LoadResult result)
+                             { CallAfter([this, path, reason, result]
+                                         { ROMLoaded(path, reason, result); }); },
+                             keepState);
+    }
+
+    void ROMLoaded(const wxString &path, LoadReason reason, EmulationThread::LoadResult result)
+    {
+        if (result == EmulationThread::LoadResult::Failed)
+        {
+            // A rebuild may still be writing the file, the next change retries
+            const wxString message = reason == LoadReason::Open ? "Failed to load ROM" : "Failed to reload ROM";
+            if (reason != LoadReason::FileChanged)
+                wxMessageBox(message, "Error", wxOK | wxICON_ERROR);
+            SetStatusText(message);
+        }
+        else if (result == EmulationThread::LoadResult::Patched)
+        {
+            SetStatusText("ROM changed on disk, patched in with the state kept");
+        }
+        else if (reason != LoadReason::Open)
+        {
+            SetStatusText(reason == LoadReason::FileChanged ? "ROM changed on disk, reloaded" : "ROM reloaded");
+            InstantBoot(path);
+        }
+        else
+        {
+            SetStatusText("Loaded ROM: " + path);
+            canvas->currentROMPath = path; // store path for reload
+            WatchROM();
+
+            // A speed saved for the ROM wins over the database's
+            SettingsStore::Settings own;
+            bool ownSpeed = false;
+            if (!speedPinned && Preferences().find(RomSettingsKey(), own))
+            {
+                ownSpeed = (own.fields & SettingsStore::HasClock) != 0;
+                ApplySettings(own);
+            }
+            ApplyKeyMap();
+
+            // Known titles come with their own speed, unless VIP timing
+            // decides it; others can be timed with a trial run
+            const RomInfo *info = RomDatabase::findFile(std::string(path.mb_str()));
+            if (info && !canvas->IsVipTiming() && !speedPinned && !ownSpeed)
+            {
+                canvas->SetClockRate(info->ipf * 60.0);
+                CheckSpeedItem(info->ipf * 60.0);
+                SetStatusText(wxString::Format("Loaded %s (%s, %d instructions per frame)", info->title,
+                                               RomDatabase::platformName(info->platform), info->ipf));
+            }
+            else if (!info && !canvas->IsVipTiming() && !speedPinned && !ownSpeed && GetMenuBar()->IsChecked(ID_AUTO_TUNE_NEW))
+                AutoTune();
+            ApplyGamepad();
+            LoadCheats();
+            if (StartAutosave(true))
+                SetStatusText("Resumed from autosave: " + path);
+            else
+                InstantBoot(path);
+        }
+    }
+
+    // Follows the ROM's file, or the archive holding it, through change
+    // notifications from the OS while Reload ROM on Change is checked. The
+    // folder is watched, as editors often save by renaming a new file over
+    // the old one.
+    void WatchROM()
+    {
+        if (!watcher)
+        {
+            watcher = std::make_unique<wxFileSystemWatcher>();
+            watcher->SetOwner(this);
+        }
+        watcher->RemoveAll();
+        watchedFile.Clear();
+        reloadTimer.Stop();
+        if (!GetMenuBar()->IsChecked(ID_WATCH_ROM) || canvas->currentROMPath.IsEmpty())
+            return;
+
+        std::string archive, member;
+        const bool archived = RomArchive::splitPath(std::string(canvas->currentROMPath.mb_str()), archive, member);
+        wxFileName file(archived ? wxString(archive) : canvas->currentROMPath);
+        file.MakeAbsolute();
+        watchedFile = file;
+        watcher->Add(wxFileName::DirName(file.GetPath()), wxFSW_EVENT_CREATE | wxFSW_EVENT_MODIFY | wxFSW_EVENT_RENAME);
+    }
+
+    void OnFileChanged(wxFileSystemWatcherEvent &event)
+    {
+        const wxFileName &changed = event.GetChangeType() == wxFSW_EVENT_RENAME ? event.GetNewPath() : event.GetPath();
+        if (!watchedFile.IsOk() || !changed.SameAs(watchedFile))
+            return;
+        // Builds write in several steps; reload once they have settled
+        reloadTimer.StartOnce(150);
+    }
+
+    void OnReloadTimer(wxTimerEvent &)
+    {
+        if (!canvas->currentROMPath.IsEmpty())
+            LoadROM(canvas->currentROMPath, LoadReason::FileChanged);
+    }
+
+    void OnWatchROM(wxCommandEvent &)
+    {
+        const bool watch = GetMenuBar()->IsChecked(ID_WATCH_ROM);
+        const bool keep = GetMenuBar()->IsChecked(ID_WATCH_KEEP_STATE);
+        wxConfigBase::Get()->Write("/Emulation/WatchROM", watch);
+        wxConfigBase::Get()->Write("/Emulation/WatchKeepState", keep);
+        WatchROM();
+        SetStatusText(!watch ? wxString("Not watching the ROM file")
+                             : keep ? wxString("Reloading on change, keeping the state when the length is unchanged")
+                                    : wxString("Reloading the ROM when it changes"));
+    }
+
+    // Skip to where the ROM first waits for a key, from the boot cache or
+    // by booting it once now. The speed is part of the key, so this runs
+    // after the ROM database set it; VIP timing and unthrottled runs don't
+    // have a fixed frame length and always boot normally.
+    void InstantBoot(const wxString &path)
+    {
+        const double hz = canvas->GetClockRate();
+        if (instantBoot == 0 || canvas->IsVipTiming() || hz <= 0)
+            return;
+        std::shared_ptr<const RomCache::Image> rom = RomCache::shared().get(std::string(path.mb_str()));
+        if (!rom)
+            return;
+
+        const int ipf = std::max(1, static_cast<int>(std::lround(hz / 60.0)));
+        const bool sameSeed = instantBoot == ID_BOOT_SAME_SEED - ID_BOOT_OFF;
+        const BootCache::Seed policy = sameSeed ? BootCache::Seed::MustMatch : BootCache::Seed::Reseed;
+        const uint64_t seed = sameSeed ? fixedBootSeed : std::random_device{}();
+        BootCache cache(BootDirectory());
+        RomPrefetcher::shared().wait(std::string(path.mb_str())); // The launcher may be booting it already
+
+        bool restored = false;
+        for (int attempt = 0; attempt < 2 && !restored; ++attempt)
+        {
+            if (attempt == 1 && !cache.build<Chip8>(rom->data(), rom->size(), ipf, seed))
+                return;
+            canvas->WithCore([&]
+                             { restored = cache.restore(*chip8, rom->data(), rom->size(), ipf, seed, policy); });
+        }
+        canvas->ClearRewind();
+    }
+
+    void OnPause(wxCommandEvent &)
+    {
+        canvas->SetPaused(!canvas->IsPaused());
+        wxMenuItem *pauseItem = GetMenuBar()->FindItem(wxID_STOP);
+        if (pauseItem)
+            pauseItem->SetItemLabel(canvas->IsPaused() ? "Resume\tCtrl+P" : "Pause\tCtrl+P");
+
+        SetStatusText(canvas->IsPaused() ? "Paused" : "Running");
+    }
+
+    void OnReset(wxCommandEvent &)
+    {
+        if (!canvas->currentROMPath.IsEmpty())
+            LoadROM(canvas->currentROMPath, LoadReason::Reset);
+        else
+        {
+            wxMessageBox("No ROM loaded to reset", "Error", wxOK | wxICON_ERROR);
+        }
+    }
+
+    // Quick save slot next to the ROM file, or next to its archive
+    wxString StatePath() const
+    {
+        std::string archive, member;
+        if (!RomArchive::splitPath(std::string(canvas->currentROMPath.mb_str()), archive, member))
+            return canvas->currentROMPath + ".state";
+        std::replace(member.begin(), member.end(), '/', '_');
+        return wxString(archive) + "." + wxString(member) + ".state";
+    }
+
+    void OnSaveState(wxCommandEvent &)
+    {
+        if (canvas->currentROMPath.IsEmpty())
+            return;
+        bool saved = false;
+        canvas->WithCore([&]
+                         { saved = chip8->saveStateFile(std::string(StatePath().mb_str())); });
+        SetStatusText(saved ? "State saved" : "Failed to save state");
+    }
+
+    void OnLoadState(wxCommandEvent &)
+    {
+        if (canvas->currentROMPath.IsEmpty())
+            return;
+        FinishRecording(); // A movie can't cover a jump to another state
+        FinishNetplay();
+        bool loaded = false;
+        canvas->WithCore([&]
+                         { loaded = chip8->loadStateFile(std::string(StatePath().mb_str())); });
+        SetStatusText(loaded ? "State loaded" : "No saved state for this ROM");
+    }
+
+    // The loaded ROM's autosave, named by its contents so a renamed or
+    // moved ROM keeps it
+    wxString AutosavePath() const
+    {
+        return wxStandardPaths::Get().GetUserDataDir() + wxFILE_SEP_PATH + "autosave" + wxFILE_SEP_PATH +
+               wxString::Format("%016llx.state", static_cast<unsigned long long>(RomSettingsKey()));
+    }
+
+    // Keeps the loaded ROM's autosave current while Autosave and Resume is
+    // checked, first picking up from it with resume; true if it did
+    bool StartAutosave(bool resume)
+    {
+        StopAutosave();
+        if (!GetMenuBar()->IsChecked(ID_AUTOSAVE) || canvas->currentROMPath.IsEmpty())
+            return false;
+        const std::string path(AutosavePath().mb_str());
+        bool resumed = false;
+        if (resume)
+        {
+            canvas->WithCore([&]
+                             { resumed = chip8->loadStateFile(path); });
+            if (resumed)
+                canvas->ClearRewind();
+        }
+        autosaveSession = Autosaver::shared().open(path);
+        canvas->SetAutosave(autosaveSession);
+        return resumed;
+    }
+
+    // Saves the state as it is now and ends the session
+    void StopAutosave()
+    {
+        if (autosaveSession < 0)
+            return;
+        canvas->SetAutosave(-1);
+        Chip8::Snapshot last;
+        canvas->WithCore([&]
+                         { chip8->snapshot(last); });
+        while (!Autosaver::shared().submit(autosaveSession, last))
+            std::this_thread::yield();
+        Autosaver::shared().close(autosaveSession);
+        autosaveSession = -1;
+    }
+
+    void OnAutosave(wxCommandEvent &)
+    {
+        const bool on = GetMenuBar()->IsChecked(ID_AUTOSAVE);
+        wxConfigBase::Get()->Write("/Emulation/Autosave", on);
+        if (on)
+            StartAutosave(false);
+        else
+            StopAutosave();
+        SetStatusText(on ? wxString("Autosaving every few seconds, resuming where the ROM was left")
+                         : wxString("Not autosaving"));
+    }
+
+    void OnRecordMovie(wxCommandEvent &)
+    {
+        if (canvas->currentROMPath.IsEmpty())
+            return;
+        wxFileDialog dlg(this, "Record Movie", "", wxFileName(canvas->currentROMPath).GetName() + ".c8mv",
+                         "CHIP-8 movies (*.c8mv)|*.c8mv", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+        if (dlg.ShowModal() != wxID_OK)
+            return;
+
+        FinishRecording();
+        uint64_t seed = (static_cast<uint64_t>(std::random_device{}()) << 32) | std::random_device{}();
+        if (!canvas->StartRecording(canvas->currentROMPath, seed))
+        {
+            SetStatusText("Failed to reload ROM for recording");
+            return;
+        }
+        moviePath = dlg.GetPath();
+        SetStatusText("Recording movie: " + moviePath);
+    }
+
+    void OnStopMovie(wxCommandEvent &) { FinishRecording(); }
+
+    // Unlike a movie the video doesn't restart the ROM, it starts with the next frame
+    void OnRecordVideo(wxCommandEvent &)
+    {
+        wxString name = canvas->currentROMPath.IsEmpty() ? wxString("chip8") : wxFileName(canvas->currentROMPath).GetName();
+        wxFileDialog dlg(this, "Record Video", "", name + ".c8v", "CHIP-8 videos (*.c8v)|*.c8v",
+                         wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+        if (dlg.ShowModal() != wxID_OK)
+            return;
+
+        FinishVideo();
+        if (!canvas->StartVideo(dlg.GetPath()))
+        {
+            SetStatusText("Failed to create " + dlg.GetPath());
+            return;
+        }
+        videoPath = dlg.GetPath();
+        SetStatusText("Recording video: " + videoPath);
+    }
+
+    void OnStopVideo(wxCommandEvent &) { FinishVideo(); }
+
+    // The picture as an animated GIF or the buzzer as a WAV
+    void OnExportVideo(wxCommandEvent &)
+    {
+        wxFileDialog open(this, "Export Video", "", "", "CHIP-8 videos (*.c8v)|*.c8v", wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+        if (open.ShowModal() != wxID_OK)
+            return;
+        wxFileDialog save(this, "Export As", "", wxFileName(open.GetPath()).GetName() + ".gif",
+                          "Animated GIF (*.gif)|*.gif|Sound (*.wav)|*.wav", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+        if (save.ShowModal() != wxID_OK)
+            return;
+
+        wxBusyCursor busy;
+        std::string videoFile(open.GetPath().mb_str());
+        std::string outFile(save.GetPath().mb_str());
+        bool saved = save.GetFilterIndex() == 1 ? exportWav(videoFile, outFile) : exportGif(videoFile, outFile);
+        SetStatusText(saved ? "Exported " + save.GetPath() : wxString("Failed to export " + open.GetPath()));
+    }
+
+    // Saves the picture on screen as a PNG in Pictures/CHIP-8 without
+    // asking, named after the ROM and the time; the writer encodes it on
+    // its own thread
+    void OnScreenshot(wxCommandEvent &)
+    {
+        wxFileName dir(wxStandardPaths::Get().GetUserDir(wxStandardPaths::Dir_Pictures), "");
+        dir.AppendDir("CHIP-8");
+        if (!dir.Mkdir(wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+        {
+            SetStatusText("Failed to create " + dir.GetPath());
+            return;
+        }
+        wxString name = canvas->currentROMPath.IsEmpty() ? wxString("chip8") : wxFileName(canvas->currentROMPath).GetName();
+        wxFileName file(dir.GetPath(), name + wxDateTime::UNow().Format(" %Y-%m-%d %H-%M-%S-%l"), "png");
+        const int scale = static_cast<int>(wxConfigBase::Get()->ReadLong("/Screen/ScreenshotScale", 4));
+        if (canvas->SaveScreenshot(file.GetFullPath(), scale))
+            SetStatusText("Screenshot: " + file.GetFullPath());
+        else
+            SetStatusText("Screenshot skipped, the last ones are still being saved");
+    }
+
+    void OnScreenshotScale(wxCommandEvent &event)
+    {
+        const int scale = 1 << (event.GetId() - ID_SCREENSHOT_1X);
+        wxConfigBase::Get()->Write("/Screen/ScreenshotScale", scale);
+        SetStatusText(wxString::Format("Screenshots at %dx", scale));
+    }
+
+    void OnHostNetplay(wxCommandEvent &)
+    {
+        if (canvas->currentROMPath.IsEmpty())
+            return;
+        long port = wxGetNumberFromUser("Both players need the same ROM. The other player joins this\n"
+                                        "computer's address and this UDP port.",
+                                        "Port:", "Host Netplay", NetplaySession::defaultPort, 1024, 65535, this);
+        if (port < 0)
+            return;
+
+        auto session = std::make_unique<NetplaySession>();
+        if (!session->host(static_cast<uint16_t>(port)))
+        {
+            SetStatusText(wxString::Format("Netplay: can't listen on port %ld", port));
+            return;
+        }
+        netplayTarget = wxString::Format("port %ld", port);
+        BeginNetplay(std::move(session));
+    }
+
+    void OnJoinNetplay(wxCommandEvent &)
+    {
+        if (canvas->currentROMPath.IsEmpty())
+            return;
+        wxString address = wxGetTextFromUser("Address of the hosting computer, optionally with :port",
+                                             "Join Netplay", netplayAddress, this);
+        if (address.IsEmpty())
+            return;
+        netplayAddress = address;
+
+        unsigned long port = NetplaySession::defaultPort;
+        wxString host = address.BeforeLast(':');
+        if (host.IsEmpty() || !address.AfterLast(':').ToULong(&port) || port == 0 || port > 65535)
+        {
+            host = address;
+            port = NetplaySession::defaultPort;
+        }
+
+        auto session = std::make_unique<NetplaySession>();
+        if (!session->join(std::string(host.mb_str()), static_cast<uint16_t>(port)))
+        {
+            SetStatusText("Netplay: can't find " + host);
+            return;
+        }
+        netplayTarget = wxString::Format("%s:%lu", host, port);
+        BeginNetplay(std::move(session));
+    }
+
+    void BeginNetplay(std::unique_ptr<NetplaySession> session)
+    {
+        FinishRecording();
+        FinishNetplay();
+        uint64_t seed = (static_cast<uint64_t>(std::random_device{}()) << 32) | std::random_device{}();
+        if (!canvas->StartNetplay(canvas->currentROMPath, seed, std::move(session)))
+        {
+            SetStatusText("Failed to reload ROM for netplay");
+            return;
+        }
+        canvas->ClearRewind();
+        UpdateNetplayStatus();
+        netplayTimer.Start(500);
+    }
+
+    void OnStopNetplay(wxCommandEvent &)
+    {
+        if (!canvas->IsNetplaying())
+            return;
+        FinishNetplay();
+        SetStatusText("Netplay stopped");
+    }
+
+    void OnNetplayTimer(wxTimerEvent &) { UpdateNetplayStatus(); }
+
+    // Each window gets its own mapping name, shown for the reader to open
+    void OnShareFrames(wxCommandEvent &event)
+    {
+        if (!event.IsChecked())
+        {
+            canvas->StopFrameShare();
+            SetStatusText("Frame sharing off");
+            return;
+        }
+        static int windowCount = 0;
+        wxString name = wxString::Format("chip8-frames-%lu-%d", wxGetProcessId(), ++windowCount);
+        if (canvas->StartFrameShare(name))
+        {
+            SetStatusText("Sharing frames as " + name);
+        }
+        else
+        {
+            GetMenuBar()->Check(ID_SHARE_FRAMES, false);
+            SetStatusText("Failed to create shared memory " + name);
+        }
+    }
+
+    // One debugger per game window, brought forward if already open
+    void OnDebugger(wxCommandEvent &)
+    {
+        if (debugger)
+        {
+            debugger->Raise();
+            return;
+        }
+        debugger = new DebuggerFrame(this, canvas);
+        debugger->Bind(wxEVT_DESTROY, [this](wxWindowDestroyEvent &event)
+                       {
+                           if (event.GetEventObject() == debugger)
+                               debugger = nullptr;
+                           event.Skip();
+                       });
+        debugger->Show();
+    }
+
+#if defined(CHIP8_LUA)
+    // The script's latest printed line, or why it stopped, goes to the
+    // status bar a few times a second
+    void OnLoadScript(wxCommandEvent &)
+    {
+        wxFileDialog dlg(this, "Load Script", "", "", "Lua scripts (*.lua)|*.lua|All files (*.*)|*.*", wxFD_OPEN | wxFD_FILE_MUST_EXIST);
+        if (dlg.ShowModal() != wxID_OK)
+            return;
+        std::string error;
+        if (!canvas->LoadScript(std::string(dlg.GetPath().mb_str()), error))
+        {
+            scriptTimer.Stop();
+            wxMessageBox(wxString(error), "Load Script", wxOK | wxICON_ERROR, this);
+            return;
+        }
+        SetStatusText("Script running: " + dlg.GetFilename());
+        UpdateScriptStatus();
+        scriptTimer.Start(250);
+    }
+
+    void OnStopScript(wxCommandEvent &)
+    {
+        canvas->StopScript();
+        scriptTimer.Stop();
+        SetStatusText("Script stopped");
+    }
+
+    void OnScriptTimer(wxTimerEvent &) { UpdateScriptStatus(); }
+
+    void UpdateScriptStatus()
+    {
+        const std::vector<std::string> lines = canvas->TakeScriptOutput();
+        if (!lines.empty())
+            SetStatusText(wxString(lines.back()));
+        if (!canvas->HasScript())
+            scriptTimer.Stop();
+    }
+#endif
+
+    void OnCheats(wxCommandEvent &)
+    {
+        if (cheats)
+        {
+            cheats->Raise();
+            return;
+        }
+        cheats = new CheatsFrame(this, canvas);
+        cheats->Bind(wxEVT_DESTROY, [this](wxWindowDestroyEvent &event)
+                     {
+                         if (event.GetEventObject() == cheats)
+                             cheats = nullptr;
+                         event.Skip();
+                     });
+        wxString text;
+        const wxString key = CheatConfigKey();
+        if (!key.IsEmpty())
+            wxConfigBase::Get()->Read(key, &text);
+        cheats->ShowCheats(key, text);
+        cheats->Show();
+    }
+
+    // A ROM's cheats are kept by its digest, like its gamepad profile
+    wxString CheatConfigKey() const
+    {
+        if (canvas->currentROMPath.IsEmpty())
+            return "";
+        std::shared_ptr<const RomCache::Image> rom = RomCache::shared().get(std::string(canvas->currentROMPath.mb_str()));
+        if (!rom)
+            return "";
+        return "/Cheats/" + wxString(RomDatabase::sha1(rom->data(), rom->size()).substr(0, 16));
+    }
+
+    // The loaded ROM's saved cheats go on as it starts
+    void LoadCheats()
+    {
+        wxString text;
+        const wxString key = CheatConfigKey();
+        if (!key.IsEmpty())
+            wxConfigBase::Get()->Read(key, &text);
+        CheatList list;
+        std::string error;
+        if (!list.compile(std::string(text.mb_str()), error))
+            list = CheatList();
+        canvas->SetCheats(list);
+        if (cheats)
+            cheats->ShowCheats(key, text);
+    }
+
+    void UpdateNetplayStatus()
+    {
+        const NetplaySession *session = canvas->GetNetplaySession();
+        if (!session)
+            return;
+        switch (session->status())
+        {
+        case NetplaySession::Status::Connecting:
+            SetStatusText("Netplay: waiting for the other player on " + netplayTarget);
+            break;
+        case NetplaySession::Status::Running:
+            SetStatusText(wxString::Format("Netplay: connected to %s, %llu rollbacks", netplayTarget,
+                                           static_cast<unsigned long long>(session->rollbackCount())));
+            break;
+        case NetplaySession::Status::Mismatch:
+            SetStatusText("Netplay: the other player loaded a different ROM");
+            netplayTimer.Stop();
+            break;
+        case NetplaySession::Status::Desynced:
+            SetStatusText(wxString::Format("Netplay: the games went out of step at frame %u", session->desyncFrame()));
+            netplayTimer.Stop();
+            break;
+        case NetplaySession::Status::Disconnected:
+            SetStatusText("Netplay: the other player left");
+            netplayTimer.Stop();
+            break;
+        }
+    }
+
+    // Performance goes in a second status bar field, refreshed twice a second
+    void OnShowMetrics(wxCommandEvent &event)
+    {
+        if (event.IsChecked())
+        {
+            const int widths[2] = {-1, -2};
+            GetStatusBar()->SetFieldsCount(2, widths);
+            UpdateMetrics();
+            metricsTimer.Start(500);
+        }
+        else
+        {
+            metricsTimer.Stop();
+            GetStatusBar()->SetFieldsCount(1);
+        }
+    }
+
+    void OnMetricsTimer(wxTimerEvent &) { UpdateMetrics(); }
+
+    void UpdateMetrics()
+    {
+        FrameMetricsSummary s = canvas->GetMetricsSummary(1.0);
+        SetStatusText(wxString::Format("%s | %.0f ips | frame %.1f ms (max %.1f) | render %.2f ms | audio gap %.1f ms | beep %.1f ms | dropped %u",
+                                       canvas->GetBackendName(), s.instructionsPerSecond, s.averageFrameMs, s.worstFrameMs,
+                                       s.averageRenderMs, s.worstAudioGapMs, canvas->GetBeepLatencyMs(), s.dropped) +
+                          IdleStatus() + LatencyStatus(),
+                      1);
+    }
+
+    // Share of the instructions since the ROM started that went round a
+    // busy-wait loop, see Chip8::IdleStats
+    wxString IdleStatus()
+    {
+        uint64_t idle = 0, total = 0;
+        canvas->WithCore([&]
+                         {
+                             idle = canvas->GetChip8().getIdleStats().total();
+                             total = canvas->GetChip8().getCycleCount();
+                         });
+        if (total == 0)
+            return wxString();
+        return wxString::Format(" | idle %.0f%%", 100.0 * std::min(idle, total) / total);
+    }
+
+    wxString LatencyStatus() const
+    {
+        if (!canvas->IsMeasuringLatency())
+            return wxString();
+        InputLatencySummary s = canvas->GetLatencySummary();
+        return wxString::Format(" | input %.1f ms (p99 %.1f, %d presses)", s.presentMs.p50, s.presentMs.p99, static_cast<int>(s.samples));
+    }
+
+    // Dumps the last minute of frame timings, for reporting stutters
+    void OnSaveMetrics(wxCommandEvent &)
+    {
+        wxFileDialog dlg(this, "Save Performance Log", "", "performance.csv",
+                         "CSV files (*.csv)|*.csv", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+        if (dlg.ShowModal() != wxID_OK)
+            return;
+        SetStatusText(canvas->SaveMetrics(dlg.GetPath()) ? "Performance log saved: " + dlg.GetPath() : wxString("Failed to save performance log"));
+    }
+
+    // Stopping shows the distribution of the key presses measured meanwhile
+    void OnMeasureLatency(wxCommandEvent &event)
+    {
+        if (event.IsChecked())
+        {
+            canvas->SetMeasuringLatency(true);
+            SetStatusText("Measuring input latency: press keys the game reacts to on screen");
+            return;
+        }
+        canvas->SetMeasuringLatency(false);
+        InputLatencySummary s = canvas->GetLatencySummary();
+        if (s.samples == 0)
+        {
+            SetStatusText("No key presses measured");
+            return;
+        }
+        auto row = [](const char *name, const InputLatencyPercentiles &p, const char *format)
+        {
+            return wxString(name) + wxString::Format(format, p.p50, p.p90, p.p99, p.max);
+        };
+        wxString text = wxString::Format("%d key presses, at %s (p50 / p90 / p99 / max)\n\n", static_cast<int>(s.samples), canvas->GetBackendName()) +
+                        row("Key to core read: ", s.readCycles, "%.0f / %.0f / %.0f / %.0f instructions\n") +
+                        row("Key to changed frame: ", s.frameMs, "%.1f / %.1f / %.1f / %.1f ms\n") +
+                        row("Key to present: ", s.presentMs, "%.1f / %.1f / %.1f / %.1f ms");
+        wxMessageBox(text, "Input Latency", wxOK | wxICON_INFORMATION, this);
+    }
+
+    // Starts over with no samples
+    void OnSamplePc(wxCommandEvent &event)
+    {
+        canvas->SetSamplingPc(event.IsChecked());
+        SetStatusText(event.IsChecked() ? "Sampling PC" : "Stopped sampling PC");
+    }
+
+    // The hottest addresses with their disassembly, from the samples since
+    // Sample PC was last turned on
+    void OnSavePcSamples(wxCommandEvent &)
+    {
+        wxFileDialog dlg(this, "Save PC Samples", "", "pc_samples.txt", "Text files (*.txt)|*.txt", wxFD_SAVE | wxFD_OVERWRITE_PROMPT);
+        if (dlg.ShowModal() != wxID_OK)
+            return;
+        wxFFile file(dlg.GetPath(), "w");
+        if (!file.IsOpened() || !file.Write(wxString(canvas->GetPcSampleListing(200))))
+        {
+            SetStatusText("Failed to save PC samples");
+            return;
+        }
+        SetStatusText("PC samples saved: " + dlg.GetPath());
+    }
+
+    void OnClose(wxCloseEvent &event)
+    {
+        FinishRecording();
+        FinishVideo();
+        FinishNetplay();
+        StopAutosave();
+        if (debugger)
+            debugger->Close(true);
+        event.Skip(); // Let the frame close as usual
+    }
+
+    // Writes out the movie being recorded, if any
+    void FinishRecording()
+    {
+        if (!canvas->IsRecording())
+            return;
+        SetStatusText(canvas->StopRecording(moviePath) ? "Movie saved: " + moviePath : wxString("Failed to save movie"));
+    }
+
+    void FinishVideo()
+    {
+        if (!canvas->IsRecordingVideo())
+            return;
+        uint64_t dropped = canvas->GetDroppedVideoFrames();
+        if (!canvas->StopVideo())
+            SetStatusText("Failed to write " + videoPath);
+        else if (dropped > 0)
+            SetStatusText(wxString::Format("Video saved: %s (%llu frames dropped)", videoPath, static_cast<unsigned long long>(dropped)));
+        else
+            SetStatusText("Video saved: " + videoPath);
+    }
+
+    // Leaves the netplay session, if any; the peer is told
+    void FinishNetplay()
+    {
+        if (!canvas->IsNetplaying())
+            return;
+        netplayTimer.Stop();
+        canvas->StopNetplay();
+    }
+
+    void OnSpeedChange(wxCommandEvent &event)
+    {
+        speedPinned = false;
+        int id = event.GetId();
+        double hz = canvas->GetClockRate();
+        switch (id)
+        {
+        case ID_SPEED_SLOW:
+            hz = 120;
+            break;
+        case ID_SPEED_NORMAL:
+            hz = 300;
+            break;
+        case ID_SPEED_FAST:
+            hz = 600;
+            break;
+        case ID_SPEED_FASTEST:
+            hz = 1200;
+            break;
+        case ID_SPEED_1MHZ:
+            hz = 1000000;
+            break;
+        case ID_SPEED_UNTHROTTLED:
+            hz = 0;
+            break;
+        case ID_SPEED_VIP:
+            speedItemId = id;
+            canvas->SetVipTiming(true);
+            SaveSpeed();
+            SetStatusText("Speed: COSMAC VIP timing");
+            return;
+        case ID_SPEED_CUSTOM:
+        {
+            long value = wxGetNumberFromUser("Instructions per second:", "", "Custom Speed",
+                                             hz > 0 ? static_cast<long>(hz) : 500, 1, 100000000, this);
+            if (value < 0)
+            {
+                // Cancelled: put the radio mark back on the previous choice
+                GetMenuBar()->Check(speedItemId, true);
+                return;
+            }
+            hz = value;
+            break;
+        }
+        }
+
+        speedItemId = id;
+        canvas->SetVipTiming(false);
+        canvas->SetClockRate(hz);
+        SaveSpeed();
+        SetStatusText(hz > 0 ? wxString::Format("Speed: %.0f Hz", hz) : wxString("Speed: unthrottled"));
+    }
+
+    // Clock the loaded ROM from a trial of its first seconds, see
+    // SpeedTuner, and keep the speed with the ROM like one from the menu.
+    // Games that never wait on their timers keep the speed they have.
+    void AutoTune()
+    {
+        std::shared_ptr<const RomCache::Image> rom = RomCache::shared().get(std::string(canvas->currentROMPath.mb_str()));
+        if (!rom)
+            return;
+        const SpeedTuner::Result tuned = SpeedTuner::tune<Chip8>(rom->data(), rom->size(), std::random_device{}());
+        if (tuned.ipf == 0)
+        {
+            SetStatusText(wxString::Format("Speed unchanged: the ROM doesn't pace itself by its timers (%d of %d frames)",
+                                           tuned.pacedFrames, tuned.frames));
+            return;
+        }
+        speedPinned = false;
+        canvas->SetVipTiming(false);
+        canvas->SetClockRate(tuned.ipf * 60.0);
+        CheckSpeedItem(tuned.ipf * 60.0);
+        SaveSpeed();
+        SetStatusText(wxString::Format("Auto-tuned to %d instructions per frame (%d draws and %d FX15 waits in %d frames)",
+                                       tuned.ipf, tuned.draws, tuned.timerWaits, tuned.frames));
+    }
+
+    void OnAutoTune(wxCommandEvent &)
+    {
+        if (canvas->currentROMPath.IsEmpty())
+        {
+            wxMessageBox("No ROM loaded to tune", "Error", wxOK | wxICON_ERROR);
+            return;
+        }
+        AutoTune();
+        InstantBoot(canvas->currentROMPath);
+    }
+
+    void OnAutoTuneNew(wxCommandEvent &)
+    {
+        wxConfigBase::Get()->Write("/Emulation/AutoTune", GetMenuBar()->IsChecked(ID_AUTO_TUNE_NEW));
+    }
+
+    // Preferences saved for every game or the loaded ROM, whichever fields
+    // they set. The key map is applied on its own, see ApplyKeyMap.
+    void ApplySettings(const SettingsStore::Settings &settings)
+    {
+        if (settings.fields & SettingsStore::HasClock)
+        {
+            canvas->SetVipTiming(settings.vipTiming != 0);
+            if (settings.vipTiming)
+            {
+                GetMenuBar()->Check(ID_SPEED_VIP, true);
+                speedItemId = ID_SPEED_VIP;
+            }
+            else
+            {
+                canvas->SetClockRate(settings.clockHz);
+                CheckSpeedItem(settings.clockHz);
+            }
+        }
+        if (settings.fields & SettingsStore::HasPalette)
+        {
+            const bool green = settings.palette == static_cast<uint8_t>(Chip8Canvas::ScreenFilter::Green);
+            canvas->filter = green ? Chip8Canvas::ScreenFilter::Green : Chip8Canvas::ScreenFilter::Classic;
+            GetMenuBar()->Check(green ? ID_SCREEN_GREEN : ID_SCREEN_CLASSIC, true);
+        }
+        if (settings.fields & SettingsStore::HasEffects)
+        {
+            ScreenBackend::Effects effects;
+            effects.scanlines = settings.effects & 1;
+            effects.phosphor = settings.effects & 2;
+            effects.bloom = settings.effects & 4;
+            effects.upscaler = (settings.effects & 16) ? ScreenBackend::Upscaler::Xbr
+                               : (settings.effects & 8) ? ScreenBackend::Upscaler::Scale2x
+                                                        : ScreenBackend::Upscaler::None;
+            canvas->SetEffects(effects);
+            GetMenuBar()->Check(ID_SCREEN_SCANLINES, effects.scanlines);
+            GetMenuBar()->Check(ID_SCREEN_PHOSPHOR, effects.phosphor);
+            GetMenuBar()->Check(ID_SCREEN_BLOOM, effects.bloom);
+            GetMenuBar()->Check(ID_UPSCALE_NONE + static_cast<int>(effects.upscaler), true);
+        }
+    }
+
+    // Record of the loaded ROM's own settings, the global one with none loaded
+    uint64_t RomSettingsKey() const
+    {
+        if (canvas->currentROMPath.IsEmpty())
+            return SettingsStore::globalKey;
+        std::shared_ptr<const RomCache::Image> rom = RomCache::shared().get(std::string(canvas->currentROMPath.mb_str()));
+        return rom ? SettingsStore::keyFor(rom->data(), rom->size()) : SettingsStore::globalKey;
+    }
+
+    // A speed picked from the menu stays with the ROM it was picked for
+    void SaveSpeed()
+    {
+        SettingsStore::Settings speed;
+        speed.fields = SettingsStore::HasClock;
+        speed.vipTiming = canvas->IsVipTiming() ? 1 : 0;
+        speed.clockHz = canvas->GetClockRate();
+        Preferences().put(RomSettingsKey(), speed);
+    }
+
+    // The ROM's own keys, else the global ones, else the default layout
+    KeyMap::Layout CurrentKeyMap() const
+    {
+        SettingsStore::Settings settings;
+        const uint64_t key = RomSettingsKey();
+        auto has = [&](uint64_t record)
+        {
+            return Preferences().find(record, settings) && (settings.fields & SettingsStore::HasKeys) &&
+                   settings.keys != KeyMap::Layout{};
+        };
+        if ((key != SettingsStore::globalKey && has(key)) || has(SettingsStore::globalKey))
+            return settings.keys;
+        return {};
+    }
+
+    void ApplyKeyMap() { canvas->SetKeyMap(CurrentKeyMap()); }
+
+    // Like the gamepad mapping: the loaded ROM's keys, or the default ones
+    // with none loaded. An empty answer drops them.
+    void OnKeyboardMapping(wxCommandEvent &)
+    {
+        const uint64_t record = RomSettingsKey();
+        KeyMap::Layout keys = CurrentKeyMap();
+        wxString layout;
+        for (int key = 0; key < 16; ++key)
+        {
+            const uint16_t code = keys[key] ? keys[key] : static_cast<uint8_t>(defaultKeyLayout[key]);
+            layout += code < 128 && std::isalnum(code) ? static_cast<char>(code) : defaultKeyLayout[key]; // A preset's keypad keys have no letter
+        }
+        wxString text = wxGetTextFromUser("Host key (letter or digit) for each CHIP-8 key from 0 to F, 16 in all.\n"
+                                          "The default layout is " + wxString(defaultKeyLayout) + "; see Keyboard Layout for others.",
+                                          record == SettingsStore::globalKey ? "Default Keyboard Mapping" : "Keyboard Mapping for This ROM",
+                                          layout, this);
+        text = text.Upper();
+        SettingsStore::Settings settings;
+        settings.fields = SettingsStore::HasKeys;
+        if (!text.IsEmpty())
+        {
+            if (text.length() != 16)
+            {
+                SetStatusText("A keyboard mapping needs 16 keys: " + text);
+                return;
+            }
+            for (int key = 0; key < 16; ++key)
+            {
+                const wxUniChar c = text[key];
+                if (!(c >= 'A' && c <= 'Z') && !(c >= '0' && c <= '9'))
+                {
+                    SetStatusText("Keyboard mappings take letters and digits only: " + text);
+                    return;
+                }
+                settings.keys[key] = static_cast<uint8_t>(c.GetValue());
+            }
+        }
+        Preferences().put(record, settings);
+        ApplyKeyMap();
+        SetStatusText(text.IsEmpty() ? wxString("Keyboard mapping reset") : "Keyboard mapping: " + text);
+    }
+
+    // A touch point presses the key under it and, sliding, the key it moves
+    // onto; lifted or slid off the keypad it releases. Keys held by more
+    // than one finger stay down until the last lets go. Goes straight to
+    // the key queue, the canvas keeps or lacks the focus as it was.
+    void OnKeypadTouch(wxMultiTouchEvent &event)
+    {
+        const wxEventType type = event.GetEventType();
+        int key = -1;
+        if (type == wxEVT_TOUCH_BEGIN || type == wxEVT_TOUCH_MOVE)
+        {
+            const wxWindow *from = static_cast<wxWindow *>(event.GetEventObject());
+            const wxPoint2DDouble at = event.GetPosition();
+            key = KeypadKeyAt(from->ClientToScreen(wxPoint(wxRound(at.m_x), wxRound(at.m_y))));
+        }
+
+        auto touch = std::find_if(keypadTouches.begin(), keypadTouches.end(), [&](const KeypadTouch &t)
+                                  { return t.id == event.GetSequenceId(); });
+        const int held = touch == keypadTouches.end() ? -1 : touch->key;
+        if (key != held)
+        {
+            if (held >= 0 && --keyTouches[held] == 0)
+                canvas->PostKey(held, false);
+            if (key >= 0 && keyTouches[key]++ == 0)
+                canvas->PostKey(key, true);
+        }
+        if (key < 0 && touch != keypadTouches.end())
+            keypadTouches.erase(touch);
+        else if (key >= 0 && touch == keypadTouches.end())
+            keypadTouches.push_back({event.GetSequenceId(), key});
+        else if (key >= 0)
+            touch->key = key;
+    }
+
+    // CHIP-8 key of the keypad button at a screen point, -1 if none
+    int KeypadKeyAt(const wxPoint &screen) const
+    {
+        for (int k = 0; k < 16; ++k)
+            if (keypadButtons[k]->IsShownOnScreen() && keypadButtons[k]->GetScreenRect().Contains(screen))
+                return k;
+        return -1;
+    }
+
+    // Windows follows a touch with mouse messages of its own; the touch
+    // events have pressed the key already
+    static bool MouseFromTouch()
+    {
+#if defined(_WIN32)
+        return (GetMessageExtraInfo() & 0xFFFFFF00) == 0xFF515700; // MI_WP_SIGNATURE
+#else
+        return false;
+#endif
+    }
+
+    // A whole layout at once, kept like one typed into the dialog
+    void OnKeyboardLayout(wxCommandEvent &event)
+    {
+        const KeyMap::Preset &preset = KeyMap::presets()[event.GetId() - ID_KEYS_PRESET];
+        SettingsStore::Settings settings;
+        settings.fields = SettingsStore::HasKeys;
+        settings.keys = preset.keys;
+        const uint64_t record = RomSettingsKey();
+        Preferences().put(record, settings);
+        ApplyKeyMap();
+        SetStatusText(wxString::Format("Keyboard layout %s%s", preset.name, record == SettingsStore::globalKey ? "" : " for this ROM"));
+    }
+
+    // Speed and palette given on the command line, before the ROM loads
+    void ApplyLaunchOptions(const LaunchOptions &launch)
+    {
+        if (launch.vipTiming)
+        {
+            canvas->SetVipTiming(true);
+            GetMenuBar()->Check(ID_SPEED_VIP, true);
+            speedItemId = ID_SPEED_VIP;
+        }
+        else if (launch.clockHz >= 0)
+        {
+            canvas->SetClockRate(launch.clockHz);
+            CheckSpeedItem(launch.clockHz);
+            speedPinned = true;
+        }
+        if (launch.palette == "green")
+        {
+            canvas->filter = Chip8Canvas::ScreenFilter::Green;
+            GetMenuBar()->Check(ID_SCREEN_GREEN, true);
+        }
+        if (launch.autosave)
+            GetMenuBar()->Check(ID_AUTOSAVE, true);
+    }
+
+    // Radio-check the Speed entry for hz, Custom... if no preset matches
+    void CheckSpeedItem(double hz)
+    {
+        int id = ID_SPEED_CUSTOM;
+        if (hz == 120)
+            id = ID_SPEED_SLOW;
+        else if (hz == 300)
+            id = ID_SPEED_NORMAL;
+        else if (hz == 600)
+            id = ID_SPEED_FAST;
+        else if (hz == 1200)
+            id = ID_SPEED_FASTEST;
+        else if (hz == 1000000)
+            id = ID_SPEED_1MHZ;
+        else if (hz == 0)
+            id = ID_SPEED_UNTHROTTLED;
+        GetMenuBar()->Check(id, true);
+        speedItemId = id;
+    }
+
+    void OnFastForwardChange(wxCommandEvent &event)
+    {
+        int id = event.GetId();
+        switch (id)
+        {
+        case ID_FF_OFF:
+            canvas->SetFastForward(1);
+            SetStatusText("Fast forward off");
+            break;
+        case ID_FF_10X:
+            canvas->SetFastForward(10);
+            SetStatusText("Fast forward: 10x");
+            break;
+        case ID_FF_100X:
+            canvas->SetFastForward(100);
+            SetStatusText("Fast forward: 100x");
+            break;
+        case ID_FF_UNLIMITED:
+            canvas->SetFastForward(0);
+            SetStatusText("Fast forward: unlimited");
+            break;
+        }
+    }
+
+    void OnRunAheadChange(wxCommandEvent &event)
+    {
+        int frames = event.GetId() - ID_RUN_AHEAD_OFF;
+        canvas->SetRunAhead(frames);
+        if (frames == 0)
+            SetStatusText("Run-ahead off");
+        else
+            SetStatusText(wxString::Format("Run-ahead: %d frame%s", frames, frames > 1 ? "s" : ""));
+    }
+
+    void OnInstantBootChange(wxCommandEvent &event)
+    {
+        instantBoot = event.GetId() - ID_BOOT_OFF;
+        wxConfigBase::Get()->Write("/Emulation/InstantBoot", static_cast<long>(instantBoot));
+        SetStatusText(instantBoot == 0 ? "Instant boot off" : "Instant boot on, from the next ROM loaded");
+    }
+
+    void OnScreenFilterChange(wxCommandEvent &event)
+    {
+        int id = event.GetId();
+        switch (id)
+        {
+        case ID_SCREEN_CLASSIC:
+            canvas->filter = Chip8Canvas::ScreenFilter::Classic;
+            break;
+        case ID_SCREEN_GREEN:
+            canvas->filter = Chip8Canvas::ScreenFilter::Green;
+            break;
+        }
+        SettingsStore::Settings look;
+        look.fields = SettingsStore::HasPalette;
+        look.palette = static_cast<uint8_t>(canvas->filter);
+        Preferences().put(SettingsStore::globalKey, look);
+        canvas->Refresh(); // force redraw
+    }
+
+    void OnScreenEffectChange(wxCommandEvent &event)
+    {
+        ScreenBackend::Effects effects = canvas->GetEffects();
+        switch (event.GetId())
+        {
+        case ID_SCREEN_SCANLINES:
+            effects.scanlines = event.IsChecked();
+            break;
+        case ID_SCREEN_PHOSPHOR:
+            effects.phosphor = event.IsChecked();
+            break;
+        case ID_SCREEN_BLOOM:
+            effects.bloom = event.IsChecked();
+            break;
+        case ID_UPSCALE_NONE:
+        case ID_UPSCALE_SCALE2X:
+        case ID_UPSCALE_XBR:
+            effects.upscaler = static_cast<ScreenBackend::Upscaler>(event.GetId() - ID_UPSCALE_NONE);
+            break;
+        }
+        canvas->SetEffects(effects);
+        SettingsStore::Settings look;
+        look.fields = SettingsStore::HasEffects;
+        look.effects = static_cast<uint8_t>((effects.scanlines ? 1 : 0) | (effects.phosphor ? 2 : 0) | (effects.bloom ? 4 : 0) |
+                                            (effects.upscaler == ScreenBackend::Upscaler::Scale2x ? 8 : 0) |
+                                            (effects.upscaler == ScreenBackend::Upscaler::Xbr ? 16 : 0));
+        Preferences().put(SettingsStore::globalKey, look);
+    }
+
+    void OnFrameBlend(wxCommandEvent &event) { canvas->SetFrameBlend(event.IsChecked()); }
+    void OnWholePictures(wxCommandEvent &event) { canvas->SetWholePictures(event.IsChecked()); }
+
+public:
+    // Only the canvas is left, covering the monitor, so the compositor can
+    // hand its flip-model swap chain straight to the display; the exclusive
+    // setting takes the monitor over outright from Direct3D 11
+    void SetFullScreen(bool on)
+    {
+        GetSizer()->Show(keypadSizer, !on);
+        if (wxSizerItem *item = GetSizer()->GetItem(canvas))
+            item->SetBorder(on ? 0 : 5);
+        ShowFullScreen(on, wxFULLSCREEN_ALL);
+        Layout();
+        canvas->SetFullScreen(on, GetMenuBar()->IsChecked(ID_FULLSCREEN_EXCLUSIVE));
+        GetMenuBar()->Check(ID_FULLSCREEN, on);
+        canvas->SetFocus();
+    }
+
+private:
+    void OnFullScreen(wxCommandEvent &) { SetFullScreen(!IsFullScreen()); }
+
+    // The choice is remembered for the next start
+    void OnExclusiveFullScreen(wxCommandEvent &event)
+    {
+        wxConfigBase::Get()->Write("/Screen/ExclusiveFullScreen", event.IsChecked());
+        if (IsFullScreen())
+            canvas->SetFullScreen(true, event.IsChecked());
+    }
+
+    // The menu bar is hidden in full screen, so F11 and Escape are caught here
+    void OnCharHook(wxKeyEvent &event)
+    {
+        if (event.GetKeyCode() == WXK_F11 && !event.HasAnyModifiers())
+            SetFullScreen(!IsFullScreen());
+        else if (event.GetKeyCode() == WXK_ESCAPE && IsFullScreen())
+            SetFullScreen(false);
+        else
+            event.Skip();
+    }
+
+    // The choice is remembered for the next start
+    void OnRendererChange(wxCommandEvent &event)
+    {
+        static const struct
+        {
+            int id;
+            Chip8Canvas::Backend kind;
+            const char *key;
+            const char *label;
+        } renderers[] = {{ID_RENDERER_OPENGL, Chip8Canvas::Backend::OpenGL, "opengl", "OpenGL"},
+                         {ID_RENDERER_D3D11, Chip8Canvas::Backend::Direct3D11, "d3d11", "Direct3D 11"},
+                         {ID_RENDERER_SOFTWARE, Chip8Canvas::Backend::Software, "software", "Software"}};
+        for (const auto &renderer : renderers)
+        {
+            if (renderer.id != event.GetId())
+                continue;
+            canvas->SetBackend(renderer.kind);
+            wxConfigBase::Get()->Write("/Screen/Renderer", renderer.key);
+            SetStatusText(wxString("Renderer: ") + renderer.label);
+        }
+    }
+
+    // The choice is remembered for the next start
+    void OnRawKeyboard(wxCommandEvent &event)
+    {
+        bool on = event.IsChecked() && canvas->SetRawKeyboard(true);
+        if (!event.IsChecked())
+            canvas->SetRawKeyboard(false);
+        GetMenuBar()->Check(ID_RAW_KEYBOARD, on);
+        wxConfigBase::Get()->Write("/Input/RawKeyboard", on);
+        if (event.IsChecked() && !on)
+            SetStatusText("Raw keyboard input is not available");
+        else
+            SetStatusText(on ? "Keyboard: raw input" : "Keyboard: window key events");
+    }
+
+    // Smaller buffers bring the beep closer to the frame that started it;
+    // the device reopens on its own thread
+    void OnAudioBuffer(wxCommandEvent &event)
+    {
+        const int samples = 128 << (event.GetId() - ID_AUDIO_128);
+        wxConfigBase::Get()->Write("/Audio/BufferSamples", samples);
+        canvas->SetAudioBuffer(samples);
+        SetStatusText(wxString::Format("Audio buffer: %d samples", samples));
+    }
+
+    // Nothing is drawn while the window can't be seen; this says whether
+    // the game goes on meanwhile
+    void OnRunHidden(wxCommandEvent &event)
+    {
+        wxConfigBase::Get()->Write("/Emulation/RunHidden", event.IsChecked());
+        canvas->SetRunWhileHidden(event.IsChecked());
+    }
+
+    // Shared by every window; the threads pick the settings up themselves
+    static void ApplyThreadTuning()
+    {
+        ThreadTuning &tuning = ThreadTuning::shared();
+        tuning.setHighPriority(wxConfigBase::Get()->ReadBool("/Threads/HighPriority", false));
+        const struct
+        {
+            const char *key;
+            ThreadTuning::Role role;
+        } roles[] = {{"/Threads/EmulationCores", ThreadTuning::Role::Emulation},
+                     {"/Threads/AudioCores", ThreadTuning::Role::Audio},
+                     {"/Threads/RenderCores", ThreadTuning::Role::Render}};
+        for (const auto &entry : roles)
+        {
+            uint64_t mask = 0;
+            if (ThreadTuning::parseCores(std::string(wxConfigBase::Get()->Read(entry.key, "").mb_str()), mask))
+                tuning.setCores(entry.role, mask);
+        }
+        tuning.apply(ThreadTuning::Role::Render);
+    }
+
+    void OnThreadPriority(wxCommandEvent &event)
+    {
+        wxConfigBase::Get()->Write("/Threads/HighPriority", event.IsChecked());
+        ApplyThreadTuning();
+        SetStatusText(event.IsChecked() ? "Emulation, audio and drawing threads at high priority" : "Threads at normal priority");
+    }
+
+    // Three core lists separated by slashes: emulation / audio / render
+    void OnThreadCores(wxCommandEvent &)
+    {
+        const ThreadTuning &tuning = ThreadTuning::shared();
+        const wxString current = wxString(ThreadTuning::formatCores(tuning.cores(ThreadTuning::Role::Emulation))) + " / " +
+                                 wxString(ThreadTuning::formatCores(tuning.cores(ThreadTuning::Role::Audio))) + " / " +
+                                 wxString(ThreadTuning::formatCores(tuning.cores(ThreadTuning::Role::Render)));
+        wxTextEntryDialog dialog(this,
+                                 "Logical cores for the emulation, audio and drawing threads, e.g. 2-3 / 1 / 0
+"
+                                 "Leave a list empty to let those threads run on any core.",
+                                 "Thread Cores", current);
+        if (dialog.ShowModal() != wxID_OK)
+            return;
+        const wxArrayString lists = wxSplit(dialog.GetValue(), '/', '\0');
+        const char *keys[] = {"/Threads/EmulationCores", "/Threads/AudioCores", "/Threads/RenderCores"};
+        uint64_t masks[3] = {};
+        for (size_t i = 0; i < lists.size(); ++i)
+        {
+            if (i >= 3 || !ThreadTuning::parseCores(std::string(lists[i].mb_str()), masks[i]))
+            {
+                SetStatusText("Core lists not understood: " + dialog.GetValue());
+                return;
+            }
+        }
+        for (int i = 0; i < 3; ++i)
+            wxConfigBase::Get()->Write(keys[i], wxString(ThreadTuning::formatCores(masks[i])));
+        ApplyThreadTuning();
+        SetStatusText("Thread cores: " + dialog.GetValue());
+    }
+
+    void OnGamepad(wxCommandEvent &event)
+    {
+        wxConfigBase::Get()->Write("/Gamepad/Enabled", event.IsChecked());
+        ApplyGamepad();
+        SetStatusText(event.IsChecked() ? wxString::Format("Gamepad on, %d connected", Gamepads::shared().count())
+                                        : wxString("Gamepad off"));
+    }
+
+    // One profile per ROM, by its digest; ROMs without one use the default
+    wxString GamepadConfigKey() const
+    {
+        if (canvas->currentROMPath.IsEmpty())
+            return "/Gamepad/Default";
+        std::shared_ptr<const RomCache::Image> rom = RomCache::shared().get(std::string(canvas->currentROMPath.mb_str()));
+        if (!rom)
+            return "/Gamepad/Default";
+        return "/Gamepad/Profiles/" + wxString(RomDatabase::sha1(rom->data(), rom->size()).substr(0, 16));
+    }
+
+    GamepadProfile CurrentGamepadProfile() const
+    {
+        GamepadProfile profile = GamepadProfile::defaults();
+        wxString text;
+        if (wxConfigBase::Get()->Read("/Gamepad/Default", &text))
+            GamepadProfile::parse(std::string(text.mb_str()), profile);
+        if (wxConfigBase::Get()->Read(GamepadConfigKey(), &text))
+            GamepadProfile::parse(std::string(text.mb_str()), profile);
+        return profile;
+    }
+
+    void ApplyGamepad()
+    {
+        canvas->SetGamepad(GetMenuBar()->IsChecked(ID_GAMEPAD), CurrentGamepadProfile());
+    }
+
+    // Edits the loaded ROM's profile, or the default one with none loaded.
+    // An empty answer drops the ROM's own profile.
+    void OnGamepadMapping(wxCommandEvent &)
+    {
+        const wxString key = GamepadConfigKey();
+        wxString text = wxGetTextFromUser("CHIP-8 key (hex digit) for each controller button, e.g. dpup=2 a=5\n"
+                                          "Buttons: a b x y back guide start leftstick rightstick leftshoulder rightshoulder dpup dpdown dpleft dpright",
+                                          key == "/Gamepad/Default" ? "Default Gamepad Mapping" : "Gamepad Mapping for This ROM",
+                                          wxString(CurrentGamepadProfile().text()), this);
+        if (text.IsEmpty())
+        {
+            if (key != "/Gamepad/Default")
+                wxConfigBase::Get()->DeleteEntry(key);
+        }
+        else
+        {
+            GamepadProfile profile;
+            if (!GamepadProfile::parse(std::string(text.mb_str()), profile))
+            {
+                SetStatusText("Gamepad mapping not understood: " + text);
+                return;
+            }
+            wxConfigBase::Get()->Write(key, wxString(profile.text()));
+        }
+        ApplyGamepad();
+        SetStatusText("Gamepad mapping: " + wxString(CurrentGamepadProfile().text()));
+    }
+
+    Chip8 *chip8 = nullptr; // The canvas's machine
+    int instantBoot = 0;    // Offset from ID_BOOT_OFF
+    Chip8Canvas *canvas;
+    wxGridSizer *keypadSizer;          // Hidden in full screen
+    PixelButton *keypadButtons[16];    // By CHIP-8 key
+    struct KeypadTouch
+    {
+        wxTouchSequenceId id;
+        int key;
+    };
+    std::vector<KeypadTouch> keypadTouches; // Fingers on a key, one each
+    int keyTouches[16] = {};                // Fingers on each key
+    int speedItemId = ID_SPEED_NORMAL; // Checked speed menu item
+    bool speedPinned = false;          // Set on the command line, the ROM database doesn't override it
+    wxString moviePath;                // File the current recording goes to
+    int autosaveSession = -1;          // Autosaver session of the loaded ROM, while autosaving
+    wxString videoPath;                // File the current video goes to
+    DebuggerFrame *debugger = nullptr; // Open debugger window, if any
+    CheatsFrame *cheats = nullptr;     // Open cheats window, if any
+    wxTimer metricsTimer;              // Refreshes the performance field while shown
+    wxTimer netplayTimer;              // Refreshes the netplay status while a session runs
+    wxTimer reloadTimer;               // Waits for a changed ROM file to settle
+#if defined(CHIP8_LUA)
+    wxTimer scriptTimer{this, ID_SCRIPT_TIMER}; // Shows the script's output while one runs
+#endif
+    std::unique_ptr<wxFileSystemWatcher> watcher; // Created on first use, once the event loop runs
+    wxFileName watchedFile;                       // The ROM or its archive, while watched
+    wxString netplayTarget;            // Port or host shown in the netplay status
+    wxString netplayAddress;           // Last address joined, offered again
+};
+
+// -------------------------
+// ROM wall
+// -------------------------
+// Many games side by side in one window, each on its own machine and all on
+// the shared scheduler. WallRenderer draws the whole grid in one call, so
+// the GUI thread's cost stays flat as games are added. Clicking a tile gives
+// it the keyboard. Every game's buzzer goes to one AudioOutput, which mixes
+// them on its callback; the selected tile plays at full gain and the rest,
+// unless muted, quietly behind it.
+class WallCanvas : public wxGLCanvas
+{
+public:
+    enum class Sound
+    {
+        Off,
+        Selected, // The selected tile only
+        All
+    };
+    static constexpr float backgroundGain = 0.2f; // Tiles not selected, with Sound::All
+
+    WallCanvas(wxWindow *parent, const std::vector<wxString> &romPaths)
+        : wxGLCanvas(parent, wxID_ANY, nullptr),
+          sharedGl(AcquireGlContext(this, true)),
+          context(sharedGl->context.get())
+    {
+
+        for (const wxString &path : romPaths)
+        {
+            Game game;
+            game.machine = std::make_unique<Chip8>();
+            if (!game.machine->loadROM(std::string(path.mb_str())))
+                continue;
+            game.emulation = std::make_unique<EmulationThread>(*game.machine);
+            if (const RomInfo *info = RomDatabase::findFile(std::string(path.mb_str())))
+                game.emulation->setClockRate(info->ipf * 60.0);
+            game.name = wxFileName(path).GetName();
+            games.push_back(std::move(game));
+            if (games.size() == static_cast<size_t>(WallRenderer::maxTiles))
+                break;
+        }
+        for (Game &game : games)
+            game.emulation->start();
+        std::vector<const SoundState *> sources;
+        for (const Game &game : games)
+            sources.push_back(&game.emulation->soundState());
+        audio = std::make_unique<AudioOutput>(sources, static_cast<int>(wxConfigBase::Get()->ReadLong("/Audio/BufferSamples", AudioOutput::defaultBufferSamples)));
+        ApplyGains();
+
+        // Poll for finished frames several times per refresh, as the game canvas does
+        timer.SetOwner(this);
+        timer.Start(4);
+        Bind(wxEVT_TIMER, &WallCanvas::OnTimer, this);
+        Bind(wxEVT_PAINT, &WallCanvas::OnPaint, this);
+        Bind(wxEVT_SIZE, &WallCanvas::OnSize, this);
+        Bind(wxEVT_LEFT_DOWN, &WallCanvas::OnLeftDown, this);
+        Bind(wxEVT_KEY_DOWN, &WallCanvas::OnKeyDown, this);
+        Bind(wxEVT_KEY_UP, &WallCanvas::OnKeyUp, this);
+
+        // Tiles are many ROMs at once, so the default mapping for all
+        SettingsStore::Settings settings;
+        if (Preferences().find(SettingsStore::globalKey, settings) && (settings.fields & SettingsStore::HasKeys))
+            keyMap.set(settings.keys);
+    }
+
+    ~WallCanvas()
+    {
+        for (Game &game : games)
+            game.emulation->stop();
+        if (renderer)
+        {
+            SetCurrent(*context);
+            renderer.reset();
+        }
+    }
+
+    size_t GetGameCount() const { return games.size(); }
+
+    void SetSound(Sound mode)
+    {
+        sound = mode;
+        ApplyGains();
+    }
+
+    // Told the game name whenever a click moves the keyboard to another tile
+    std::function<void(const wxString &)> onSelect;
+
+private:
+    struct Game
+    {
+        std::unique_ptr<Chip8> machine; // Outlives emulation, which steps it
+        std::unique_ptr<EmulationThread> emulation;
+        wxString name;
+    };
+
+    void OnTimer(wxTimerEvent &)
+    {
+        bool changed = false;
+        for (Game &game : games)
+            changed = game.emulation->frames().update() || changed;
+        if (changed)
+            Refresh(false);
+    }
+
+    void OnPaint(wxPaintEvent &)
+    {
+        wxPaintDC dc(this);
+        if (!context->IsOK() || games.empty())
+            return;
+        SetCurrent(*context);
+        if (!renderer)
         {
-            normalItem->Check(true);
+            renderer = std::make_unique<WallRenderer>([this]
+                                                      { SwapBuffers(); });
+            if (!renderer->init(static_cast<int>(games.size())))
+            {
+                renderer.reset();
+                if (!failed) // Leave the window blank, but say why once
+                    wxLogError("The ROM wall needs OpenGL 3.3.");
+                failed = true;
+                return;
+            }
+            int w, h;
+            GetClientSize(&w, &h);
+            renderer->resize(w, h);
         }
-        emulationMenu->AppendSubMenu(speedMenu, "Speed");
 
-        wxMenu *screenMenu = new wxMenu;
-        screenMenu->AppendRadioItem(ID_SCREEN_CLASSIC, "Classic");
-        screenMenu->AppendRadioItem(ID_SCREEN_GREEN, "Green");
-        wxMenuItem *classicItem = screenMenu->FindItem(ID_SCREEN_CLASSIC);
-        if (classicItem)
+        for (size_t i = 0; i < games.size(); ++i)
         {
-            classicItem->Check(true);
+            const EmulatedFrame &frame = games[i].emulation->frames().front();
+            renderer->upload(static_cast<int>(i), frame.gfx, frame.hires);
         }
+        renderer->draw({0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, selected);
+        renderer->present();
+    }
 
-        wxMenuBar *menuBar = new wxMenuBar;
-        menuBar->Append(fileMenu, "&File");
-        menuBar->Append(emulationMenu, "&Emulation");
-        menuBar->Append(screenMenu, "&Screen");
-        SetMenuBar(menuBar);
+    void OnSize(wxSizeEvent &)
+    {
+        if (!renderer)
+            return;
+        int w, h;
+        GetClientSize(&w, &h);
+        SetCurrent(*context);
+        renderer->resize(w, h);
+        Refresh(false);
+    }
 
-        // ---- Bind events ----
-        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnOpenGame, this, wxID_OPEN);
-        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnQuit, this, wxID_EXIT);
-        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnPause, this, wxID_STOP);
-        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnReset, this, wxID_REFRESH);
-        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnSpeedChange, this, ID_SPEED_FASTEST, ID_SPEED_SLOW);
-        Bind(wxEVT_MENU, &Chip8FrameWithCanvas::OnScreenFilterChange, this, ID_SCREEN_CLASSIC, ID_SCREEN_GREEN);
+    void OnLeftDown(wxMouseEvent &event)
+    {
+        SetFocus();
+        int tile = renderer ? renderer->tileAt(event.GetX(), event.GetY()) : -1;
+        if (tile == -1 || tile == selected)
+            return;
 
-        // ---- Layout ----
-        wxBoxSizer *mainSizer = new wxBoxSizer(wxVERTICAL);
+        // Keys held on the old tile would otherwise stay down there for good
+        ReleaseKeys();
+        selected = tile;
+        ApplyGains();
+        if (onSelect)
+            onSelect(games[selected].name);
+        Refresh(false);
+    }
 
-        // Canvas (bigger proportion)
-        canvas = new Chip8Canvas(this, *chip8);
-        canvas->emuSpeed = Chip8Canvas::Speed::Normal;
-        mainSizer->Add(canvas, 3, wxEXPAND | wxALL, 5); // proportion=3 for more space
+    void OnKeyDown(wxKeyEvent &event) { MapKey(event, true); }
+    void OnKeyUp(wxKeyEvent &event) { MapKey(event, false); }
 
-        // Keypad
-        wxGridSizer *keypadSizer = new wxGridSizer(4, 4, 5, 5);
-        const char *labels[16] = {"1", "2", "3", "C", "4", "5", "6", "D", "7", "8", "9", "E", "A", "0", "B", "F"};
-        const int keyMap[16] = {
-            0x1, 0x2, 0x3, 0xC, // 1 2 3 C
-            0x4, 0x5, 0x6, 0xD, // 4 5 6 D
-            0x7, 0x8, 0x9, 0xE, // 7 8 9 E
-            0xA, 0x0, 0xB, 0xF  // A 0 B F
-        };
+    void MapKey(wxKeyEvent &event, bool pressed)
+    {
+        int key = keyMap.keyFor(event.GetKeyCode());
+        if (key == -1 || selected == -1)
+            return;
+        games[selected].emulation->postKey(key, pressed);
+        if (pressed)
+            heldKeys |= static_cast<uint16_t>(1u << key);
+        else
+            heldKeys &= static_cast<uint16_t>(~(1u << key));
+    }
 
-        for (int i = 0; i < 16; ++i)
+    void ApplyGains()
+    {
+        for (size_t i = 0; i < games.size(); ++i)
         {
-            PixelButton *btn = new PixelButton(this, 1000 + i, labels[i]);
-            keypadSizer->Add(btn, 1, wxEXPAND);
-
-            btn->Bind(wxEVT_BUTTON, [](wxCommandEvent &) { /* empty: preserves button clicking animation */ });
-
-            btn->Bind(wxEVT_LEFT_DOWN, [=](wxMouseEvent &event)
-                      {
-                          chip8->keys[keyMap[i]] = true;
-                          canvas->SetFocus();
-                          event.Skip(); // allow button to process the click normally
-                      });
+            const bool isSelected = static_cast<int>(i) == selected;
+            const float gain = sound == Sound::Off ? 0.0f : isSelected ? 1.0f : sound == Sound::All ? backgroundGain : 0.0f;
+            audio->setGain(i, gain);
+        }
+    }
 
-            btn->Bind(wxEVT_LEFT_UP, [=](wxMouseEvent &event)
-                      {
-                          chip8->keys[keyMap[i]] = false;
-                          canvas->SetFocus();
-                          event.Skip(); // allow button to process the click normally
-                      });
+    void ReleaseKeys()
+    {
+        for (int key = 0; key < 16 && selected != -1; ++key)
+        {
+            if (heldKeys & (1u << key))
+                games[selected].emulation->postKey(key, false);
         }
+        heldKeys = 0;
+    }
 
-        mainSizer->Add(keypadSizer, 1, wxEXPAND | wxALL, 10);
-        SetSizer(mainSizer);
-        Layout();
-        canvas->SetFocus();
+    std::vector<Game> games;
+    std::unique_ptr<AudioOutput> audio; // Mixes every game's buzzer, gone before the games
+    Sound sound = Sound::All;
+    std::shared_ptr<SharedGlContext> sharedGl; // The game windows' core context
+    wxGLContext *context;                      // sharedGl's
+    wxTimer timer;
+    std::unique_ptr<WallRenderer> renderer; // Created on the first paint
+    bool failed = false;                    // No 3.3 renderer, reported once
+    int selected = -1;                      // Tile the keyboard plays, -1 = none
+    uint16_t heldKeys = 0;                  // Keys down on the selected tile
+    KeyMap keyMap;
+};
 
-        // ---- Status Bar ----
+class WallFrame : public wxFrame
+{
+public:
+    explicit WallFrame(const std::vector<wxString> &romPaths)
+        : wxFrame(nullptr, wxID_ANY, "CHIP-8 Wall", wxDefaultPosition, wxSize(1280, 720))
+    {
+        SetIcon(wxICON(IDI_APP_ICON));
         CreateStatusBar();
-        LoadROM(romFile);
+        canvas = new WallCanvas(this, romPaths);
+        canvas->onSelect = [this](const wxString &name)
+        { SetStatusText("Playing: " + name); };
+        SetStatusText(wxString::Format("%zu games - click one to play it", canvas->GetGameCount()));
+
+        wxMenu *soundMenu = new wxMenu;
+        soundMenu->AppendRadioItem(ID_WALL_SOUND_OFF, "Off");
+        soundMenu->AppendRadioItem(ID_WALL_SOUND_SELECTED, "Selected Game Only");
+        soundMenu->AppendRadioItem(ID_WALL_SOUND_ALL, "All Games");
+        wxMenuBar *menuBar = new wxMenuBar;
+        menuBar->Append(soundMenu, "&Sound");
+        SetMenuBar(menuBar);
+        Bind(wxEVT_MENU, &WallFrame::OnSound, this, ID_WALL_SOUND_OFF, ID_WALL_SOUND_ALL);
+
+        const long mode = std::clamp(wxConfigBase::Get()->ReadLong("/Wall/Sound", static_cast<long>(WallCanvas::Sound::All)), 0L, 2L);
+        GetMenuBar()->Check(ID_WALL_SOUND_OFF + static_cast<int>(mode), true);
+        canvas->SetSound(static_cast<WallCanvas::Sound>(mode));
     }
 
 private:
-    void OnOpenGame(wxCommandEvent &)
+    // The choice is remembered for the next wall
+    void OnSound(wxCommandEvent &event)
     {
-        wxFileDialog dlg(this, "Open ROM", "", "",
-                         "CHIP-8 ROMs (*.ch8;*.rom)|*.ch8;*.rom|All files (*.*)|*.*",
-                         wxFD_OPEN);
-        if (dlg.ShowModal() == wxID_OK)
-            LoadROM(dlg.GetPath());
+        const int mode = event.GetId() - ID_WALL_SOUND_OFF;
+        wxConfigBase::Get()->Write("/Wall/Sound", mode);
+        canvas->SetSound(static_cast<WallCanvas::Sound>(mode));
     }
 
-    void OnQuit(wxCommandEvent &) { Close(); }
+    WallCanvas *canvas;
+};
 
-    void LoadROM(const wxString &path)
+// -------------------------
+// ROM list
+// -------------------------
+// Virtual list over the scanned entries: rows are drawn on demand from the
+// entry vector, so the control's cost doesn't grow with the library.
+class RomListCtrl : public wxListView
+{
+public:
+    explicit RomListCtrl(wxWindow *parent)
+        : wxListView(parent, wxID_ANY, wxDefaultPosition, wxDefaultSize,
+                     wxLC_REPORT | wxLC_VIRTUAL | wxLC_SINGLE_SEL | wxLC_NO_HEADER)
+    {
+        AppendColumn("Name");
+        Bind(wxEVT_SIZE, &RomListCtrl::OnSize, this);
+    }
+
+    void Clear()
+    {
+        roms.clear();
+        visible.clear();
+        search.reset();
+        searchRoms.clear();
+        ranked = false;
+        SetItemCount(0);
+        Refresh();
+    }
+
+    void Append(const std::vector<RomScanner::Entry> &entries)
     {
-        chip8->reset();
-        if (!chip8->loadROM(std::string(path.mb_str())))
+        for (const RomScanner::Entry &entry : entries)
         {
-            wxMessageBox("Failed to load ROM", "Error", wxOK | wxICON_ERROR);
-            SetStatusText("Failed to load ROM");
+            roms.push_back(entry);
+            if (!ranked && Matches(entry.name))
+                visible.push_back(static_cast<uint32_t>(roms.size() - 1));
         }
-        else
+        SetItemCount(static_cast<long>(visible.size()));
+        Refresh();
+    }
+
+    // The scanner's index of the ROMs listed, for fuzzy filtering
+    void SetSearch(std::shared_ptr<const RomSearch> index)
+    {
+        search = std::move(index);
+        searchRoms.assign(search ? search->size() : 0, UINT32_MAX);
+        std::unordered_map<std::string, uint32_t> byName;
+        for (size_t i = 0; i < roms.size(); ++i)
+            byName.emplace(roms[i].name, static_cast<uint32_t>(i));
+        for (uint32_t id = 0; id < searchRoms.size(); ++id)
         {
-            SetStatusText("Loaded ROM: " + path);
-            canvas->currentROMPath = path; // store path for reload
+            auto found = byName.find(search->document(id).name);
+            if (found != byName.end())
+                searchRoms[id] = found->second;
         }
+        if (!filter.empty())
+            SetFilter(wxString::FromUTF8(filter), true);
     }
 
-    void OnPause(wxCommandEvent &)
+    // Fuzzy search over titles, authors, years and notes once the scan has
+    // built its index, best match first; case-insensitive substring match
+    // on the file name before that and for queries too short for it
+    void SetFilter(const wxString &text, bool refresh = false)
     {
-        canvas->paused = !canvas->paused;
-        wxMenuItem *pauseItem = GetMenuBar()->FindItem(wxID_STOP);
-        if (pauseItem)
-            pauseItem->SetItemLabel(canvas->paused ? "Resume\tCtrl+P" : "Pause\tCtrl+P");
+        const RomScanner::Entry *selected = GetSelectedEntry();
+        uint32_t keep = selected ? static_cast<uint32_t>(selected - roms.data()) : UINT32_MAX;
 
-        SetStatusText(canvas->paused ? "Paused" : "Running");
-    }
+        std::string next(text.Lower().utf8_str());
+        bool narrowing = !refresh && next.compare(0, filter.size(), filter) == 0;
+        filter = next;
 
-    void OnReset(wxCommandEvent &)
-    {
-        if (!canvas->currentROMPath.IsEmpty())
+        ranked = search && filter.size() >= RomSearch::minimumQuery;
+        if (ranked)
         {
-            if (!chip8->loadROM(std::string(canvas->currentROMPath.mb_str())))
+            visible.clear();
+            for (uint32_t id : search->find(filter))
             {
-                wxMessageBox("Failed to reload ROM", "Error", wxOK | wxICON_ERROR);
-                SetStatusText("Failed to reload ROM");
+                if (searchRoms[id] != UINT32_MAX)
+                    visible.push_back(searchRoms[id]);
             }
-            else
+        }
+        // Typing one more character only needs to look at what is still shown
+        else if (narrowing)
+        {
+            visible.erase(std::remove_if(visible.begin(), visible.end(), [this](uint32_t i)
+                                         { return !Matches(roms[i].name); }),
+                          visible.end());
+        }
+        else
+        {
+            visible.clear();
+            for (size_t i = 0; i < roms.size(); ++i)
             {
-                SetStatusText("ROM reloaded");
+                if (Matches(roms[i].name))
+                    visible.push_back(static_cast<uint32_t>(i));
             }
         }
-        else
+        SetItemCount(static_cast<long>(visible.size()));
+
+        // Keep the selection if the ROM is still shown; unranked indexes
+        // stay sorted
+        long item = GetFirstSelected();
+        if (item != -1)
+            Select(item, false);
+        auto it = ranked ? std::find(visible.begin(), visible.end(), keep) : std::lower_bound(visible.begin(), visible.end(), keep);
+        if (it != visible.end() && *it == keep)
         {
-            wxMessageBox("No ROM loaded to reset", "Error", wxOK | wxICON_ERROR);
+            item = static_cast<long>(it - visible.begin());
+            Select(item);
+            Focus(item);
         }
+        Refresh();
     }
 
-    void OnSpeedChange(wxCommandEvent &event)
+    const RomScanner::Entry *GetEntry(long item) const
     {
-        int id = event.GetId();
-        switch (id)
-        {
-        case ID_SPEED_SLOW:
-            canvas->emuSpeed = Chip8Canvas::Speed::Slow;
-            break;
-        case ID_SPEED_NORMAL:
-            canvas->emuSpeed = Chip8Canvas::Speed::Normal;
-            break;
-        case ID_SPEED_FAST:
-            canvas->emuSpeed = Chip8Canvas::Speed::Fast;
-            break;
-        case ID_SPEED_FASTEST:
-            canvas->emuSpeed = Chip8Canvas::Speed::Fastest;
-            break;
-        }
+        if (item < 0 || item >= static_cast<long>(visible.size()))
+            return nullptr;
+        return &roms[visible[item]];
+    }
+
+    const RomScanner::Entry *GetSelectedEntry() const { return GetEntry(GetFirstSelected()); }
 
-        SetStatusText("Speed changed");
+    size_t GetRomCount() const { return roms.size(); }
+
+private:
+    wxString OnGetItemText(long item, long) const override
+    {
+        const RomScanner::Entry *entry = GetEntry(item);
+        return entry ? wxString::FromUTF8(entry->name) : wxString();
     }
 
-    void OnScreenFilterChange(wxCommandEvent &event)
+    bool Matches(const std::string &name) const
     {
-        int id = event.GetId();
-        switch (id)
-        {
-        case ID_SCREEN_CLASSIC:
-            canvas->filter = Chip8Canvas::ScreenFilter::Classic;
-            break;
-        case ID_SCREEN_GREEN:
-            canvas->filter = Chip8Canvas::ScreenFilter::Green;
-            break;
-        }
-        canvas->Refresh(); // force redraw
+        if (filter.empty())
+            return true;
+        auto it = std::search(name.begin(), name.end(), filter.begin(), filter.end(), [](char a, char b)
+                              { return std::tolower(static_cast<unsigned char>(a)) == b; });
+        return it != name.end();
     }
 
-    Chip8 *chip8;
-    Chip8Canvas *canvas;
+    void OnSize(wxSizeEvent &event)
+    {
+        SetColumnWidth(0, GetClientSize().GetWidth());
+        event.Skip();
+    }
+
+    std::vector<RomScanner::Entry> roms; // In scan order
+    std::vector<uint32_t> visible;       // Indexes into roms matching the filter, ascending unless ranked
+    std::string filter;                  // Lower-case UTF-8
+    bool ranked = false;                 // visible is in search order
+
+    std::shared_ptr<const RomSearch> search;
+    std::vector<uint32_t> searchRoms; // Index into roms of each search document, UINT32_MAX if not listed
 };
 
 // -------------------------
@@ -627,15 +4057,14 @@ class Chip8Frame : public wxFrame
 {
 public:
     Chip8Frame()
-        : wxFrame(nullptr, wxID_ANY, "CHIP-8 Emulator", wxDefaultPosition, wxSize(640, 480))
+        : wxFrame(nullptr, wxID_ANY, "CHIP-8 Emulator", wxDefaultPosition, wxSize(640, 480)), scanTimer(this)
     {
         SetIcon(wxICON(IDI_APP_ICON));
 
-        chip8 = std::make_unique<Chip8>();
-
         wxMenu *fileMenu = new wxMenu;
         fileMenu->Append(wxID_FILE, "Open Game\tCtrl+O");
         fileMenu->Append(wxID_OPEN, "Open Folder...");
+        fileMenu->Append(ID_OPEN_WALL, "Open ROM Wall");
         fileMenu->AppendSeparator();
         fileMenu->Append(wxID_EXIT);
 
@@ -644,29 +4073,40 @@ public:
         SetMenuBar(menuBar);
 
         wxBoxSizer *sizer = new wxBoxSizer(wxVERTICAL);
-        romList = new wxListBox(this, wxID_ANY);
+        filterBox = new wxSearchCtrl(this, wxID_ANY);
+        filterBox->SetDescriptiveText("Search");
+        romList = new RomListCtrl(this);
         playBtn = new wxButton(this, wxID_ANY, "Play Selected Game");
         playBtn->Disable();
 
-        wxStaticText *hintText = new wxStaticText(this, wxID_ANY, "Open a folder to begin");
+        hintText = new wxStaticText(this, wxID_ANY, "Open a folder to begin");
+        preview = new wxStaticBitmap(this, wxID_ANY, Thumbnail(nullptr));
         sizer->Add(hintText, 0, wxALL | wxALIGN_CENTER_HORIZONTAL, 10);
+        sizer->Add(preview, 0, wxBOTTOM | wxALIGN_CENTER_HORIZONTAL, 5);
+        sizer->Add(filterBox, 0, wxEXPAND | wxLEFT | wxRIGHT, 5);
         sizer->Add(romList, 1, wxEXPAND | wxALL, 5);
         sizer->Add(playBtn, 0, wxEXPAND | wxALL, 5);
         SetSizer(sizer);
 
         Bind(wxEVT_MENU, &Chip8Frame::OnOpenGame, this, wxID_FILE);
         Bind(wxEVT_MENU, &Chip8Frame::OnOpenFolder, this, wxID_OPEN);
+        Bind(wxEVT_MENU, &Chip8Frame::OnOpenWall, this, ID_OPEN_WALL);
         Bind(wxEVT_MENU, &Chip8Frame::OnQuit, this, wxID_EXIT);
-        romList->Bind(wxEVT_LISTBOX, &Chip8Frame::OnSelectRom, this);
-        romList->Bind(wxEVT_LISTBOX_DCLICK, &Chip8Frame::OnDoubleClickRom, this);
+        romList->Bind(wxEVT_LIST_ITEM_SELECTED, &Chip8Frame::OnSelectRom, this);
+        romList->Bind(wxEVT_LIST_ITEM_DESELECTED, &Chip8Frame::OnSelectRom, this);
+        romList->Bind(wxEVT_LIST_ITEM_ACTIVATED, &Chip8Frame::OnActivateRom, this);
+        filterBox->Bind(wxEVT_TEXT, &Chip8Frame::OnFilter, this);
         playBtn->Bind(wxEVT_BUTTON, &Chip8Frame::OnRunGame, this);
+        Bind(wxEVT_TIMER, &Chip8Frame::OnScanTimer, this);
     }
 
+    ~Chip8Frame() override { scanner.stop(); }
+
 private:
     void OnOpenGame(wxCommandEvent &)
     {
         wxFileDialog dlg(this, "Open ROM", "", "",
-                         "CHIP-8 ROMs (*.ch8;*.rom)|*.ch8;*.rom|All files (*.*)|*.*",
+                         "CHIP-8 ROMs (*.ch8;*.rom;*.zip)|*.ch8;*.rom;*.zip|All files (*.*)|*.*",
                          wxFD_OPEN | wxFD_FILE_MUST_EXIST);
         if (dlg.ShowModal() == wxID_OK)
             OpenGame(dlg.GetPath());
@@ -679,57 +4119,304 @@ private:
         {
             selectedFolder = dlg.GetPath();
             romList->Clear();
+            playBtn->Disable();
+
+            // Results stream in from the scanner thread, see OnScanTimer
+            scanner.start(std::string(selectedFolder.mb_str()), IndexPath(selectedFolder));
+            scanTimer.Start(50);
+            hintText->SetLabel("Scanning...");
+            Layout();
+        }
+    }
+
+    void OnScanTimer(wxTimerEvent &)
+    {
+        RomScanner::Batch batch = scanner.takeBatch();
+        if (batch.replace)
+        {
+            romList->Clear();
+            playBtn->Disable();
+        }
+        if (!batch.entries.empty())
+            romList->Append(batch.entries);
 
-            wxDir dir(selectedFolder);
-            if (dir.IsOpened())
+        if (batch.search)
+        {
+            romList->SetSearch(batch.search);
+            ShowSelection();
+        }
+        if (batch.finished)
+        {
+            scanTimer.Stop();
+            if (!romList->GetSelectedEntry())
             {
-                wxString filename;
-                bool cont = dir.GetFirst(&filename, "*", wxDIR_FILES);
-                while (cont)
-                {
-                    if (filename.EndsWith(".ch8") || filename.EndsWith(".rom"))
-                        romList->Append(filename);
-                    cont = dir.GetNext(&filename);
-                }
+                hintText->SetLabel(wxString::Format("%zu ROMs", romList->GetRomCount()));
+                Layout();
             }
         }
     }
 
-    void OnSelectRom(wxCommandEvent &) { playBtn->Enable(romList->GetSelection() != wxNOT_FOUND); }
+    // One index per folder, kept with the user's settings
+    static std::string IndexPath(const wxString &folder)
+    {
+        wxString dir = wxStandardPaths::Get().GetUserDataDir() + wxFILE_SEP_PATH + "index";
+        if (!wxFileName::Mkdir(dir, wxS_DIR_DEFAULT, wxPATH_MKDIR_FULL))
+            return std::string();
+
+        std::string key(folder.utf8_str());
+        std::string digest = RomDatabase::sha1(reinterpret_cast<const uint8_t *>(key.data()), key.size());
+        wxString path = dir + wxFILE_SEP_PATH + wxString(digest.substr(0, 16)) + ".idx";
+        return std::string(path.mb_str());
+    }
+
+    wxString RomPath(const RomScanner::Entry &entry) const
+    {
+        return selectedFolder + wxFILE_SEP_PATH + wxString::FromUTF8(entry.name);
+    }
+
+    void OnFilter(wxCommandEvent &)
+    {
+        romList->SetFilter(filterBox->GetValue());
+        ShowSelection();
+    }
+
+    void OnSelectRom(wxListEvent &)
+    {
+        ShowSelection();
+        Prefetch();
+    }
+
+    // The selected ROM and its neighbours, read and booted ahead so
+    // opening one is instant; see RomPrefetcher
+    void Prefetch()
+    {
+        const long item = romList->GetFirstSelected();
+        if (item == -1)
+            return;
+        std::vector<RomPrefetcher::Request> requests;
+        for (long near : {item, item + 1, item - 1})
+        {
+            if (const RomScanner::Entry *entry = romList->GetEntry(near))
+                requests.push_back(PrefetchRequest(*entry));
+        }
+        RomPrefetcher::shared().prefetch(std::move(requests));
+    }
+
+    // Boots at the speed a game window will pick for the ROM: its own
+    // saved speed, else the database's, else the global default; as
+    // Chip8FrameWithCanvas::ROMLoaded, short of command-line speeds
+    RomPrefetcher::Request PrefetchRequest(const RomScanner::Entry &entry) const
+    {
+        RomPrefetcher::Request request;
+        request.path = std::string(RomPath(entry).mb_str());
+        const long instantBoot = wxConfigBase::Get()->ReadLong("/Emulation/InstantBoot", 0);
+        if (instantBoot == 0 || entry.sha1.size() < 16)
+            return request;
+
+        double hz = 300;
+        bool vip = false;
+        SettingsStore::Settings settings;
+        if (Preferences().find(SettingsStore::globalKey, settings) && (settings.fields & SettingsStore::HasClock))
+        {
+            vip = settings.vipTiming != 0;
+            hz = settings.clockHz;
+        }
+        const uint64_t key = std::stoull(entry.sha1.substr(0, 16), nullptr, 16); // SettingsStore::keyFor
+        const RomInfo *info = RomDatabase::findDigest(entry.sha1);
+        if (Preferences().find(key == SettingsStore::globalKey ? 1 : key, settings) && (settings.fields & SettingsStore::HasClock))
+        {
+            vip = settings.vipTiming != 0;
+            hz = settings.clockHz;
+        }
+        else if (info && !vip)
+        {
+            hz = info->ipf * 60.0;
+        }
+        if (vip || hz <= 0)
+            return request; // InstantBoot doesn't apply
+
+        const bool sameSeed = instantBoot == ID_BOOT_SAME_SEED - ID_BOOT_OFF;
+        request.bootIpf = std::max(1, static_cast<int>(std::lround(hz / 60.0)));
+        request.seed = sameSeed ? Chip8FrameWithCanvas::fixedBootSeed : std::random_device{}();
+        request.policy = sameSeed ? BootCache::Seed::MustMatch : BootCache::Seed::Reseed;
+        request.bootDirectory = Chip8FrameWithCanvas::BootDirectory();
+        return request;
+    }
+
+    void ShowSelection()
+    {
+        const RomScanner::Entry *entry = romList->GetSelectedEntry();
+        playBtn->Enable(entry != nullptr);
+        preview->SetBitmap(Thumbnail(entry));
+        if (!entry)
+            return;
+
+        // Identify the ROM by content, the scanner already hashed it
+        const RomInfo *info = RomDatabase::findDigest(entry->sha1);
+        if (info)
+        {
+            hintText->SetLabel(wxString::Format("%s - %s", info->title, RomDatabase::platformName(info->platform)));
+        }
+        else
+        {
+            // Not in the database, so whatever its file name says
+            const RomSearch::Document named = RomSearch::parseName(entry->name);
+            wxString label = wxString::FromUTF8(named.title);
+            if (!named.author.empty())
+                label += " - " + wxString::FromUTF8(named.author);
+            if (!named.year.empty())
+                label += " (" + wxString::FromUTF8(named.year) + ")";
+            hintText->SetLabel(label);
+        }
+        Layout();
+    }
+
+    // The scanner's 64x32 screen shot, drawn at 4x
+    static wxBitmap Thumbnail(const RomScanner::Entry *entry)
+    {
+        wxImage image(64, 32);
+        unsigned char *rgb = image.GetData();
+        for (int y = 0; y < 32; ++y)
+        {
+            for (int x = 0; x < 64; ++x)
+            {
+                unsigned char shade = entry && entry->thumbnailPixel(x, y) ? 255 : 0;
+                std::fill_n(rgb + (y * 64 + x) * 3, 3, shade);
+            }
+        }
+        return wxBitmap(image.Rescale(256, 128, wxIMAGE_QUALITY_NEAREST));
+    }
 
-    void OnDoubleClickRom(wxCommandEvent &)
+    void OnActivateRom(wxListEvent &event)
     {
-        int sel = romList->GetSelection();
-        if (sel != wxNOT_FOUND)
-            OpenGame(selectedFolder + wxFILE_SEP_PATH + romList->GetString(sel));
+        if (const RomScanner::Entry *entry = romList->GetEntry(event.GetIndex()))
+            OpenGame(RomPath(*entry));
     }
 
     void OnRunGame(wxCommandEvent &)
     {
-        int sel = romList->GetSelection();
-        if (sel != wxNOT_FOUND)
-            OpenGame(selectedFolder + wxFILE_SEP_PATH + romList->GetString(sel));
+        if (const RomScanner::Entry *entry = romList->GetSelectedEntry())
+            OpenGame(RomPath(*entry));
+    }
+
+    // Every ROM the filter shows, as many as the wall has tiles for
+    void OnOpenWall(wxCommandEvent &)
+    {
+        std::vector<wxString> paths;
+        for (long i = 0; i < romList->GetItemCount() && paths.size() < static_cast<size_t>(WallRenderer::maxTiles); ++i)
+        {
+            if (const RomScanner::Entry *entry = romList->GetEntry(i))
+                paths.push_back(RomPath(*entry));
+        }
+        if (paths.empty())
+        {
+            hintText->SetLabel("Open a folder with ROMs to fill the wall");
+            Layout();
+            return;
+        }
+        WallFrame *wall = new WallFrame(paths);
+        wall->Show();
     }
 
     void OnQuit(wxCommandEvent &) { Close(); }
 
     void OpenGame(const wxString &path)
     {
-        Chip8FrameWithCanvas *gameFrame = new Chip8FrameWithCanvas(chip8.get(), path);
+        Chip8FrameWithCanvas *gameFrame = new Chip8FrameWithCanvas(path);
         gameFrame->Show();
     }
 
-    wxListBox *romList;
+    wxSearchCtrl *filterBox;
+    RomListCtrl *romList;
     wxButton *playBtn;
+    wxStaticText *hintText;
+    wxStaticBitmap *preview;
     wxString selectedFolder;
-    std::unique_ptr<Chip8> chip8;
+    RomScanner scanner;
+    wxTimer scanTimer;
 };
 
 // -------------------------
 // wxApp implementation
 // -------------------------
+//   chip8 [rom] [--ipf N | --clock HZ] [--profile chip8|vip] [--palette classic|green] [--fullscreen] [--autosave]
+//         [--event-log FILE]
+void Chip8App::OnInitCmdLine(wxCmdLineParser &parser)
+{
+    static const wxCmdLineEntryDesc options[] = {
+        {wxCMD_LINE_SWITCH, "h", "help", "show this help", wxCMD_LINE_VAL_NONE, wxCMD_LINE_OPTION_HELP},
+        {wxCMD_LINE_OPTION, nullptr, "ipf", "instructions per frame", wxCMD_LINE_VAL_NUMBER},
+        {wxCMD_LINE_OPTION, nullptr, "clock", "instructions per second, 0 unthrottled", wxCMD_LINE_VAL_DOUBLE},
+        {wxCMD_LINE_OPTION, nullptr, "profile", "chip8, or vip for COSMAC VIP timing", wxCMD_LINE_VAL_STRING},
+        {wxCMD_LINE_OPTION, nullptr, "palette", "classic or green", wxCMD_LINE_VAL_STRING},
+        {wxCMD_LINE_SWITCH, nullptr, "fullscreen", "start full screen"},
+        {wxCMD_LINE_SWITCH, nullptr, "autosave", "resume from the ROM's autosave and keep it current"},
+        {wxCMD_LINE_OPTION, nullptr, "event-log", "append diagnostic events to this file", wxCMD_LINE_VAL_STRING},
+        {wxCMD_LINE_PARAM, nullptr, nullptr, "ROM file, played straight away without the launcher", wxCMD_LINE_VAL_STRING,
+         wxCMD_LINE_PARAM_OPTIONAL},
+        wxCMD_LINE_DESC_END};
+    parser.SetDesc(options);
+    parser.SetSwitchChars("-");
+}
+
+bool Chip8App::OnCmdLineParsed(wxCmdLineParser &parser)
+{
+    long ipf = 0;
+    double hz = 0;
+    wxString profile;
+    const bool hasIpf = parser.Found("ipf", &ipf);
+    const bool hasClock = parser.Found("clock", &hz);
+    if ((hasIpf && ipf <= 0) || (hasClock && hz < 0) || (hasIpf && hasClock))
+    {
+        wxLogError("Give either --ipf above 0 or --clock of 0 or more");
+        return false;
+    }
+    if (hasIpf)
+        launch.clockHz = ipf * 60.0;
+    if (hasClock)
+        launch.clockHz = hz;
+    if (parser.Found("profile", &profile))
+    {
+        if (profile != "chip8" && profile != "vip")
+        {
+            wxLogError("Unknown profile %s, expected chip8 or vip", profile);
+            return false;
+        }
+        launch.vipTiming = profile == "vip";
+    }
+    if (parser.Found("palette", &launch.palette) && launch.palette != "classic" && launch.palette != "green")
+    {
+        wxLogError("Unknown palette %s, expected classic or green", launch.palette);
+        return false;
+    }
+    launch.fullscreen = parser.Found("fullscreen");
+    launch.autosave = parser.Found("autosave");
+    wxString eventLog;
+    if (parser.Found("event-log", &eventLog) && !EventLog::shared().open(std::string(eventLog.mb_str())))
+    {
+        wxLogError("Can't open the event log %s", eventLog);
+        return false;
+    }
+    if (parser.GetParamCount() > 0)
+        romPath = parser.GetParam(0);
+    return true;
+}
+
 bool Chip8App::OnInit()
 {
+    if (!wxApp::OnInit()) // Parses the command line
+        return false;
+    Preferences().load(std::string((wxStandardPaths::Get().GetUserDataDir() + wxFILE_SEP_PATH + "settings.bin").mb_str()));
+
+    // A ROM on the command line skips the launcher altogether
+    if (!romPath.IsEmpty())
+    {
+        Chip8FrameWithCanvas *game = new Chip8FrameWithCanvas(romPath, launch);
+        game->Show(true);
+        if (launch.fullscreen)
+            game->SetFullScreen(true);
+        return true;
+    }
     Chip8Frame *frame = new Chip8Frame();
     frame->Show(true);
     return true;
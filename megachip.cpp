@@ -0,0 +1,581 @@
+#include "megachip.h"
+#include "chip8.h"
+#include "chip8_simd.h"
+#include "rom_cache.h"
+#include <algorithm> // For std::copy, std::fill
+#include <cstring>   // For std::memcpy
+#include <random>    // For the default seed
+
+MegaChip8::MegaChip8() : memory(memorySize)
+{
+    std::random_device rd;
+    seedRandom((static_cast<uint64_t>(rd()) << 32) | rd());
+    reset();
+}
+
+bool MegaChip8::loadROM(const std::string &filename)
+{
+    std::shared_ptr<const RomCache::Image> rom = RomCache::shared().get(filename);
+    if (!rom)
+    {
+        romImage.clear();
+        reset();
+        return false;
+    }
+    return loadROM(rom->data(), rom->size());
+}
+
+bool MegaChip8::loadROM(const uint8_t *data, size_t size)
+{
+    if (size > memorySize - 0x200)
+    {
+        romImage.clear();
+        reset();
+        return false;
+    }
+    romImage.assign(data, data + size);
+    reset();
+    return true;
+}
+
+void MegaChip8::reset()
+{
+    std::fill(memory.begin(), memory.end(), 0);
+    std::memcpy(memory.data(), Chip8::bootImage(), 0x200);
+    std::copy(romImage.begin(), romImage.end(), memory.begin() + 0x200);
+
+    V.fill(0);
+    I = 0;
+    PC = 0x200;
+    stack.fill(0);
+    sp = 0;
+    delayTimer = 0;
+    soundTimer = 0;
+    keyWaitReg = -1;
+    keyWaitKey = -1;
+    rplFlags.fill(0);
+    cycleCount = 0;
+
+    mega = false;
+    hires = false;
+    canvas.fill(0);
+    shown.fill(0);
+    colours.fill(0);
+    spriteWidth = 0;
+    spriteHeight = 0;
+    alpha = 255;
+    collisionIndex = 0;
+    blend = Blend::Normal;
+    digitised = Sound{};
+    blendBuilt = Blend::Normal;
+    drawFlag = true;
+}
+
+void MegaChip8::seedRandom(uint64_t seed)
+{
+    // Standard PCG32 initialisation, as BasicChip8
+    rngState = 0;
+    nextRandom();
+    rngState += seed;
+    nextRandom();
+}
+
+uint8_t MegaChip8::nextRandom()
+{
+    uint64_t old = rngState;
+    rngState = old * 6364136223846793005ull + 1442695040888963407ull;
+    uint32_t xorshifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+    uint32_t rot = static_cast<uint32_t>(old >> 59);
+    uint32_t out = (xorshifted >> rot) | (xorshifted << ((32 - rot) & 31));
+    return static_cast<uint8_t>(out >> 24);
+}
+
+const MegaChip8::Palette &MegaChip8::classicPalette()
+{
+    static const Palette palette = []
+    {
+        Palette p{};
+        p[0] = 0xFF000000;
+        p[1] = 0xFFFFFFFF;
+        return p;
+    }();
+    return palette;
+}
+
+void MegaChip8::setKey(int key, bool pressed)
+{
+    key &= 0xF;
+    const bool wasDown = keys[key];
+    keys[key] = pressed;
+    if (keyWaitReg < 0)
+        return;
+    if (pressed && !wasDown && keyWaitKey < 0)
+        keyWaitKey = static_cast<int8_t>(key);
+    else if (!pressed && key == keyWaitKey)
+    {
+        V[keyWaitReg] = static_cast<uint8_t>(key);
+        keyWaitReg = -1;
+        keyWaitKey = -1;
+    }
+}
+
+uint16_t MegaChip8::keyMask() const
+{
+    uint16_t mask = 0;
+    for (int k = 0; k < 16; ++k)
+        mask |= static_cast<uint16_t>(keys[k]) << k;
+    return mask;
+}
+
+void MegaChip8::decrementTimers()
+{
+    if (delayTimer > 0)
+        --delayTimer;
+    if (soundTimer > 0)
+        --soundTimer;
+}
+
+bool MegaChip8::runFrame(int instructions)
+{
+    drawFlag = false;
+    for (int i = 0; i < instructions && keyWaitReg < 0; ++i)
+        emulateCycle();
+    decrementTimers();
+    return drawFlag;
+}
+
+void MegaChip8::clearScreen()
+{
+    // Mega mode draws the next frame behind the one on show
+    if (mega)
+        shown = canvas;
+    canvas.fill(0);
+    drawFlag = true;
+}
+
+void MegaChip8::skipIf(bool cond)
+{
+    if (cond)
+        PC += memory[PC & (memorySize - 1)] == 0x01 ? 4 : 2;
+}
+
+void MegaChip8::emulateCycle()
+{
+    const uint32_t at = PC & (memorySize - 1);
+    const uint16_t opcode = static_cast<uint16_t>(memory[at] << 8 | memory[(at + 1) & (memorySize - 1)]);
+    PC += 2;
+    ++cycleCount;
+
+    const uint8_t x = (opcode >> 8) & 0xF;
+    const uint8_t y = (opcode >> 4) & 0xF;
+    const uint8_t n = opcode & 0xF;
+    const uint8_t nn = opcode & 0xFF;
+    const uint16_t nnn = opcode & 0xFFF;
+
+    switch (opcode >> 12)
+    {
+    case 0x0:
+        if (opcode == 0x00E0)
+            clearScreen();
+        else if (opcode == 0x00EE)
+            PC = stack[--sp & 15];
+        else if ((opcode & 0xFFF0) == 0x00C0)
+            scrollDown(n);
+        else if ((opcode & 0xFFF0) == 0x00B0)
+            scrollUp(n);
+        else if (opcode == 0x00FB)
+            scrollSideways(4);
+        else if (opcode == 0x00FC)
+            scrollSideways(-4);
+        else if (opcode == 0x00FE || opcode == 0x00FF)
+        {
+            hires = opcode == 0x00FF;
+            canvas.fill(0);
+            drawFlag = true;
+        }
+        else if (opcode == 0x0010 || opcode == 0x0011)
+        {
+            mega = opcode == 0x0011;
+            canvas.fill(0);
+            shown.fill(0);
+            drawFlag = true;
+        }
+        else if ((opcode & 0xFF00) == 0x0100)
+        {
+            // 01NN NNNN, I takes all 24 bits
+            const uint32_t next = PC & (memorySize - 1);
+            I = static_cast<uint32_t>(nn) << 16 | memory[next] << 8 | memory[(next + 1) & (memorySize - 1)];
+            PC += 2;
+        }
+        else if ((opcode & 0xFF00) == 0x0200)
+        {
+            // Entries 1 up keep their colours as ARGB from I; 0 stays transparent
+            for (int i = 0; i < nn && i < 255; ++i)
+            {
+                const uint32_t from = (I + 4 * i) & (memorySize - 1);
+                uint32_t argb = 0;
+                for (int b = 0; b < 4; ++b)
+                    argb = argb << 8 | memory[(from + b) & (memorySize - 1)];
+                colours[i + 1] = argb;
+            }
+            blendBuilt = Blend::Normal;
+            drawFlag = true;
+        }
+        else if ((opcode & 0xFF00) == 0x0300)
+            spriteWidth = nn ? nn : 256;
+        else if ((opcode & 0xFF00) == 0x0400)
+            spriteHeight = nn ? nn : 256;
+        else if ((opcode & 0xFF00) == 0x0500)
+        {
+            alpha = nn;
+            drawFlag = true;
+        }
+        else if ((opcode & 0xFFF0) == 0x0600)
+        {
+            const uint32_t from = I & (memorySize - 1);
+            auto byte = [&](uint32_t i)
+            { return static_cast<uint32_t>(memory[(from + i) & (memorySize - 1)]); };
+            digitised.rate = static_cast<uint16_t>(byte(0) << 8 | byte(1));
+            digitised.length = byte(2) << 16 | byte(3) << 8 | byte(4);
+            digitised.address = (from + 6) & (memorySize - 1);
+            digitised.loop = n == 0;
+            digitised.playing = digitised.length > 0;
+        }
+        else if (opcode == 0x0700)
+            digitised.playing = false;
+        else if ((opcode & 0xFFF0) == 0x0800)
+            blend = n <= 4 ? static_cast<Blend>(n) : Blend::Normal;
+        else if ((opcode & 0xFF00) == 0x0900)
+            collisionIndex = nn;
+        break; // Other 0NNN are ignored
+    case 0x1:
+        PC = nnn;
+        break;
+    case 0x2:
+        stack[sp++ & 15] = PC;
+        PC = nnn;
+        break;
+    case 0x3:
+        skipIf(V[x] == nn);
+        break;
+    case 0x4:
+        skipIf(V[x] != nn);
+        break;
+    case 0x5:
+        skipIf(V[x] == V[y]);
+        break;
+    case 0x6:
+        V[x] = nn;
+        break;
+    case 0x7:
+        V[x] = static_cast<uint8_t>(V[x] + nn);
+        break;
+    case 0x8:
+    {
+        uint8_t flag = V[0xF];
+        switch (n)
+        {
+        case 0x0:
+            V[x] = V[y];
+            return;
+        case 0x1:
+            V[x] |= V[y];
+            return;
+        case 0x2:
+            V[x] &= V[y];
+            return;
+        case 0x3:
+            V[x] ^= V[y];
+            return;
+        case 0x4:
+            flag = V[x] + V[y] > 0xFF;
+            V[x] = static_cast<uint8_t>(V[x] + V[y]);
+            break;
+        case 0x5:
+            flag = V[x] >= V[y];
+            V[x] = static_cast<uint8_t>(V[x] - V[y]);
+            break;
+        case 0x6: // SUPER-CHIP shifts Vx in place
+            flag = V[x] & 1;
+            V[x] >>= 1;
+            break;
+        case 0x7:
+            flag = V[y] >= V[x];
+            V[x] = static_cast<uint8_t>(V[y] - V[x]);
+            break;
+        case 0xE:
+            flag = V[x] >> 7;
+            V[x] = static_cast<uint8_t>(V[x] << 1);
+            break;
+        default:
+            return;
+        }
+        V[0xF] = flag;
+        break;
+    }
+    case 0x9:
+        skipIf(V[x] != V[y]);
+        break;
+    case 0xA:
+        I = nnn;
+        break;
+    case 0xB:
+        PC = nnn + V[x]; // BXNN, as SUPER-CHIP
+        break;
+    case 0xC:
+        V[x] = nextRandom() & nn;
+        break;
+    case 0xD:
+        draw(x, y, n);
+        break;
+    case 0xE:
+        if (nn == 0x9E)
+            skipIf(keys[V[x] & 0xF]);
+        else if (nn == 0xA1)
+            skipIf(!keys[V[x] & 0xF]);
+        break;
+    case 0xF:
+        switch (nn)
+        {
+        case 0x07:
+            V[x] = delayTimer;
+            break;
+        case 0x0A:
+            keyWaitReg = static_cast<int8_t>(x);
+            keyWaitKey = -1;
+            break;
+        case 0x15:
+            delayTimer = V[x];
+            break;
+        case 0x18:
+            soundTimer = V[x];
+            break;
+        case 0x1E:
+            I = (I + V[x]) & (memorySize - 1);
+            break;
+        case 0x29:
+            I = 0x050 + (V[x] & 0x0F) * 5;
+            break;
+        case 0x30:
+            I = 0x0A0 + (V[x] & 0x0F) * 10;
+            break;
+        case 0x33:
+            memory[I & (memorySize - 1)] = V[x] / 100;
+            memory[(I + 1) & (memorySize - 1)] = V[x] / 10 % 10;
+            memory[(I + 2) & (memorySize - 1)] = V[x] % 10;
+            break;
+        case 0x55: // I left alone, as SUPER-CHIP
+            for (int r = 0; r <= x; ++r)
+                memory[(I + r) & (memorySize - 1)] = V[r];
+            break;
+        case 0x65:
+            for (int r = 0; r <= x; ++r)
+                V[r] = memory[(I + r) & (memorySize - 1)];
+            break;
+        case 0x75:
+            std::memcpy(rplFlags.data(), V.data(), x + 1u);
+            break;
+        case 0x85:
+            std::memcpy(V.data(), rplFlags.data(), x + 1u);
+            break;
+        }
+        break;
+    }
+}
+
+void MegaChip8::draw(uint8_t x, uint8_t y, uint8_t n)
+{
+    bool hit;
+    if (!mega)
+    {
+        // SUPER-CHIP: DXY0 is 16x16 in hi-res
+        const bool large = n == 0 && hires;
+        hit = drawBits(V[x] % width(), V[y] % height(), large ? 16 : n, large ? 16 : 8);
+    }
+    else if (I < 0x100)
+        hit = drawFont(V[x], V[y], n);
+    else
+        hit = drawMega(V[x], V[y]);
+    V[0xF] = hit ? 1 : 0;
+    drawFlag = true;
+}
+
+bool MegaChip8::drawBits(int x, int y, int rows, int columns)
+{
+    // Sprites clip at the right and bottom edges
+    const int w = width(), h = height();
+    const int rowBytes = columns / 8;
+    bool hit = false;
+    for (int r = 0; r < rows && y + r < h; ++r)
+    {
+        uint8_t *row = &canvas[(y + r) * screenWidth];
+        for (int c = 0; c < columns && x + c < w; ++c)
+        {
+            const uint8_t bits = memory[(I + r * rowBytes + c / 8) & (memorySize - 1)];
+            if (!((bits >> (7 - (c & 7))) & 1))
+                continue;
+            hit |= row[x + c] != 0;
+            row[x + c] ^= 1;
+        }
+    }
+    return hit;
+}
+
+bool MegaChip8::drawFont(int x, int y, int rows)
+{
+    // Off the vector path: at most 8x15 pixels, and only for text
+    bool hit = false;
+    for (int r = 0; r < rows && y + r < screenHeight; ++r)
+    {
+        const uint8_t bits = memory[I + r];
+        uint8_t *row = &canvas[(y + r) * screenWidth];
+        for (int c = 0; c < 8 && x + c < screenWidth; ++c)
+        {
+            if (!((bits >> (7 - c)) & 1))
+                continue;
+            hit |= row[x + c] == collisionIndex;
+            row[x + c] = 255;
+        }
+    }
+    return hit;
+}
+
+bool MegaChip8::drawMega(int x, int y)
+{
+    // Each sprite row is one span of bytes over one screen row, so the
+    // normal mode is the vector blit; the others look every pixel up
+    const int columns = std::min<int>(spriteWidth, screenWidth - x);
+    bool hit = false;
+    const uint8_t *table = blend == Blend::Normal ? nullptr : blendTable();
+    for (int r = 0; r < spriteHeight && y + r < screenHeight; ++r)
+    {
+        const uint32_t from = I + static_cast<uint32_t>(r) * spriteWidth;
+        if (from + columns > memorySize)
+            break;
+        const uint8_t *src = &memory[from];
+        uint8_t *dst = &canvas[(y + r) * screenWidth + x];
+        if (!table)
+        {
+            hit |= simd::blitBytes(dst, src, columns, collisionIndex);
+            continue;
+        }
+        for (int c = 0; c < columns; ++c)
+        {
+            if (src[c] == 0)
+                continue;
+            hit |= dst[c] == collisionIndex;
+            dst[c] = table[src[c] << 8 | dst[c]];
+        }
+    }
+    return hit;
+}
+
+const uint8_t *MegaChip8::blendTable()
+{
+    if (blendBuilt == blend)
+        return blendLookup.data();
+    blendLookup.resize(256 * 256);
+
+    auto channel = [](uint32_t argb, int shift)
+    { return static_cast<int>((argb >> shift) & 0xFF); };
+    for (int s = 0; s < 256; ++s)
+    {
+        for (int d = 0; d < 256; ++d)
+        {
+            int rgb[3];
+            for (int k = 0; k < 3; ++k)
+            {
+                const int a = channel(colours[s], 16 - 8 * k), b = channel(colours[d], 16 - 8 * k);
+                switch (blend)
+                {
+                case Blend::Quarter:
+                    rgb[k] = (a + 3 * b) / 4;
+                    break;
+                case Blend::Half:
+                    rgb[k] = (a + b) / 2;
+                    break;
+                case Blend::Add:
+                    rgb[k] = std::min(a + b, 255);
+                    break;
+                default:
+                    rgb[k] = a * b / 255;
+                    break;
+                }
+            }
+
+            // The screen holds indices, so the blend lands on the nearest
+            // colour the palette has; index 0 is transparent, not a colour
+            int best = s, bestDistance = 1 << 30;
+            for (int p = 1; p < 256; ++p)
+            {
+                const int dr = channel(colours[p], 16) - rgb[0];
+                const int dg = channel(colours[p], 8) - rgb[1];
+                const int db = channel(colours[p], 0) - rgb[2];
+                const int distance = dr * dr + dg * dg + db * db;
+                if (distance < bestDistance)
+                {
+                    best = p;
+                    bestDistance = distance;
+                }
+            }
+            blendLookup[s << 8 | d] = static_cast<uint8_t>(best);
+        }
+    }
+    blendBuilt = blend;
+    return blendLookup.data();
+}
+
+void MegaChip8::scrollDown(int rows)
+{
+    const int h = height();
+    if (rows >= h)
+        rows = h;
+    std::copy_backward(canvas.begin(), canvas.begin() + (h - rows) * screenWidth, canvas.begin() + h * screenWidth);
+    std::fill(canvas.begin(), canvas.begin() + rows * screenWidth, 0);
+    drawFlag = true;
+}
+
+void MegaChip8::scrollUp(int rows)
+{
+    const int h = height();
+    if (rows >= h)
+        rows = h;
+    std::copy(canvas.begin() + rows * screenWidth, canvas.begin() + h * screenWidth, canvas.begin());
+    std::fill(canvas.begin() + (h - rows) * screenWidth, canvas.begin() + h * screenWidth, 0);
+    drawFlag = true;
+}
+
+void MegaChip8::scrollSideways(int pixels)
+{
+    const int w = width(), h = height();
+    for (int r = 0; r < h; ++r)
+    {
+        uint8_t *row = &canvas[r * screenWidth];
+        if (pixels > 0)
+        {
+            std::copy_backward(row, row + w - pixels, row + w);
+            std::fill(row, row + pixels, 0);
+        }
+        else
+        {
+            std::copy(row - pixels, row + w, row);
+            std::fill(row + w + pixels, row + w, 0);
+        }
+    }
+    drawFlag = true;
+}
+
+uint64_t MegaChip8::stateHash() const
+{
+    // Registers then the picture; the screen dominates the cost
+    struct
+    {
+        std::array<uint8_t, 16> V;
+        uint32_t I, PC;
+        uint8_t sp, delay, sound, flags;
+    } registers{V, I, PC, sp, delayTimer, soundTimer, static_cast<uint8_t>(mega | hires << 1)};
+    uint64_t hash = simd::hashBytes(&registers, sizeof registers);
+    hash = simd::hashBytes(stack.data(), sizeof stack, hash);
+    hash = simd::hashBytes(colours.data(), sizeof colours, hash);
+    return simd::hashBytes(screen().data(), screen().size(), hash);
+}
@@ -0,0 +1,152 @@
+#ifndef MEGACHIP_H
+#define MEGACHIP_H
+
+#include <array>   // For registers, the screen and the palette
+#include <cstddef> // For size_t
+#include <cstdint> // For uint8_t, uint32_t
+#include <string>  // For file loading
+#include <vector>  // For memory and the ROM image
+
+// MEGA-CHIP (Revival Studios, 2007): SUPER-CHIP with a 256x192 screen of
+// 8-bit palette indices, behind 0011 (mega on) and 0010 (mega off).
+// Sprites are SPRW x SPRH bytes of indices at a 24-bit I, index 0 being
+// transparent, written over the screen in one of five blend modes; 00E0
+// shows the finished frame and starts a clear one. Machines run on their
+// own interpreter rather than BasicChip8, as the 16 MB address space the
+// 24-bit I reaches is more than its per-address caches could cover. Off
+// mega mode the same screen holds the 64x32 or 128x64 SUPER-CHIP picture
+// as indices 0 and 1, drawn by XOR.
+class MegaChip8
+{
+public:
+    static constexpr int screenWidth = 256;
+    static constexpr int screenHeight = 192;
+    static constexpr size_t memorySize = 0x1000000;
+
+    // Rows of screenWidth indices, whichever mode is on
+    using Screen = std::array<uint8_t, screenWidth * screenHeight>;
+    using Palette = std::array<uint32_t, 256>; // ARGB
+
+    // How a sprite's pixels combine with the screen's (080N)
+    enum class Blend : uint8_t
+    {
+        Normal,   // The sprite's colour
+        Quarter,  // A quarter of the sprite's, three quarters of the screen's
+        Half,     // Half of each
+        Add,      // Summed, saturating
+        Multiply  // Product of the two, each channel out of 255
+    };
+
+    // 060N: 8-bit unsigned samples at rate Hz, from memory after a
+    // 6-byte header (rate u16, length u24, one byte unused), big-endian
+    struct Sound
+    {
+        bool playing = false;
+        bool loop = false;
+        uint32_t address = 0; // First sample
+        uint32_t length = 0;  // Samples
+        uint16_t rate = 0;
+    };
+
+    MegaChip8();
+
+    bool loadROM(const std::string &filename); // Through the shared RomCache
+    // Copies into memory at 0x200. False, leaving the machine reset with
+    // no ROM, if it doesn't fit.
+    bool loadROM(const uint8_t *data, size_t size);
+    void reset(); // Back to power-on, with the loaded ROM in memory again
+    void seedRandom(uint64_t seed);
+
+    void emulateCycle();
+    // instructions turns then the 60 Hz timer tick; true if the shown
+    // frame changed. Mega mode usually wants thousands a frame.
+    bool runFrame(int instructions);
+    void decrementTimers();
+
+    // Keyboard, as BasicChip8: FX0A waits for a key to go down and up
+    void setKey(int key, bool pressed);
+    uint16_t keyMask() const;
+    bool isWaitingForKey() const { return keyWaitReg >= 0; }
+
+    bool isMega() const { return mega; }
+    bool isHires() const { return hires; }
+    int width() const { return mega ? screenWidth : hires ? 128 : 64; }
+    int height() const { return mega ? screenHeight : hires ? 64 : 32; }
+
+    // What to show: the frame the last 00E0 finished in mega mode, the
+    // screen as it stands otherwise, its top-left width() x height() in use
+    const Screen &screen() const { return mega ? shown : canvas; }
+    // The colour of each index; off mega mode black and white
+    const Palette &palette() const { return mega ? colours : classicPalette(); }
+    uint8_t screenAlpha() const { return alpha; } // 05NN, 255 opaque
+    const Sound &sound() const { return digitised; }
+    Blend blendMode() const { return blend; }
+
+    // Changed since the renderer last cleared it
+    bool drawFlag = false;
+
+    const std::array<uint8_t, 16> &getV() const { return V; }
+    uint32_t getI() const { return I; }
+    uint32_t getPC() const { return PC; }
+    uint8_t getSP() const { return sp; }
+    uint8_t getDelayTimer() const { return delayTimer; }
+    uint8_t getSoundTimer() const { return soundTimer; }
+    uint64_t getCycleCount() const { return cycleCount; }
+    const std::vector<uint8_t> &getMemory() const { return memory; }
+
+    // 64-bit hash of the registers, palette and shown screen
+    uint64_t stateHash() const;
+
+private:
+    static const Palette &classicPalette();
+
+    void clearScreen();
+    void skipIf(bool cond); // Over 4 bytes when the next is 01NN NNNN
+    void draw(uint8_t x, uint8_t y, uint8_t n);
+    bool drawBits(int x, int y, int rows, int columns); // 1-bit sprite at I, XOR
+    bool drawMega(int x, int y);                         // SPRW x SPRH indices at I
+    bool drawFont(int x, int y, int rows);               // 1-bit font glyph in mega mode, index 255
+    void scrollDown(int rows);
+    void scrollUp(int rows);
+    void scrollSideways(int pixels); // Right if positive
+    uint8_t nextRandom();
+
+    // index = blendTable[sprite << 8 | screen] for the non-normal modes:
+    // the palette entry nearest the blended colour, built on the first
+    // blended draw after the palette or the mode changes
+    const uint8_t *blendTable();
+
+    std::vector<uint8_t> memory;
+    std::vector<uint8_t> romImage;
+
+    std::array<uint8_t, 16> V{};
+    uint32_t I = 0;
+    uint32_t PC = 0x200;
+    std::array<uint32_t, 16> stack{};
+    uint8_t sp = 0;
+    uint8_t delayTimer = 0;
+    uint8_t soundTimer = 0;
+    int8_t keyWaitReg = -1;
+    int8_t keyWaitKey = -1;
+    std::array<bool, 16> keys{};
+    std::array<uint8_t, 16> rplFlags{};
+    uint64_t cycleCount = 0;
+    uint64_t rngState = 0;
+
+    bool mega = false;
+    bool hires = false;
+    Screen canvas{}; // Being drawn
+    Screen shown{};  // Mega mode's finished frame
+    Palette colours{};
+    uint16_t spriteWidth = 0;
+    uint16_t spriteHeight = 0;
+    uint8_t alpha = 255;
+    uint8_t collisionIndex = 0;
+    Blend blend = Blend::Normal;
+    Sound digitised;
+
+    std::vector<uint8_t> blendLookup; // 64 KB once built
+    Blend blendBuilt = Blend::Normal; // Mode blendLookup is for, Normal if stale
+};
+
+#endif
@@ -0,0 +1,155 @@
+#include "memory_map_renderer.h"
+#include <utility> // For std::move
+#if defined(_WIN32)
+#include <windows.h>
+#endif
+#include <GL/gl.h>
+
+namespace
+{
+    struct Rgb
+    {
+        int r, g, b;
+    };
+
+    const Rgb setBit = {200, 200, 200};
+    const Rgb clearBit = {28, 28, 32};
+    const Rgb readTint = {70, 130, 255};
+    const Rgb writeTint = {255, 60, 50};
+    const Rgb pcColor = {255, 215, 40};
+    const Rgb indexColor = {60, 230, 90};
+
+    // amount out of 255 of the way from a to b
+    Rgb mix(const Rgb &a, const Rgb &b, int amount)
+    {
+        return {a.r + (b.r - a.r) * amount / 255, a.g + (b.g - a.g) * amount / 255, a.b + (b.b - a.b) * amount / 255};
+    }
+
+    // Clear bits of a highlighted byte a dimmer shade of its colour
+    Rgb dim(const Rgb &c)
+    {
+        return {c.r * 2 / 5, c.g * 2 / 5, c.b * 2 / 5};
+    }
+}
+
+MemoryMapRenderer::MemoryMapRenderer(std::function<void()> swap)
+    : swapBuffers(std::move(swap))
+{
+}
+
+MemoryMapRenderer::~MemoryMapRenderer()
+{
+    if (texture != 0)
+        glDeleteTextures(1, &texture);
+}
+
+bool MemoryMapRenderer::init(size_t memorySize)
+{
+    if (!glGetString(GL_VERSION) || (memorySize != 4096 && memorySize != 0x10000))
+        return false;
+    size = memorySize;
+    mapRows = memorySize == 4096 ? 64 : 256;
+    mapColumns = static_cast<int>(memorySize) / mapRows;
+    staging.assign(static_cast<size_t>(8 * mapColumns) * mapRows * 4, 0);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 8 * mapColumns, mapRows, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    return glGetError() == GL_NO_ERROR;
+}
+
+void MemoryMapRenderer::resize(int width, int height)
+{
+    windowWidth = width;
+    windowHeight = height;
+    glViewport(0, 0, width, height);
+    glMatrixMode(GL_PROJECTION);
+    glLoadIdentity();
+    glOrtho(0, 1, 1, 0, -1, 1);
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+}
+
+int MemoryMapRenderer::addressAt(int x, int y) const
+{
+    if (windowWidth <= 0 || windowHeight <= 0 || x < 0 || y < 0 || x >= windowWidth || y >= windowHeight)
+        return -1;
+    const int column = x * mapColumns / windowWidth;
+    const int row = y * mapRows / windowHeight;
+    return column * mapRows + row;
+}
+
+// Each byte picks its two colours, then its bits pick between them
+void MemoryMapRenderer::upload(const uint8_t *memory, const uint8_t *readHeat, const uint8_t *writeHeat, uint16_t pc, uint16_t index)
+{
+    const int pitch = 8 * mapColumns * 4;
+    const size_t pcNext = (pc + 1u) % size;
+    for (size_t addr = 0; addr < size; ++addr)
+    {
+        Rgb on = setBit, off = clearBit;
+        if (addr == pc % size || addr == pcNext)
+        {
+            on = pcColor;
+            off = dim(pcColor);
+        }
+        else if (addr == index % size)
+        {
+            on = indexColor;
+            off = dim(indexColor);
+        }
+        else
+        {
+            // The more recent of the two shows; a write outranks a read of the same age
+            const bool written = writeHeat[addr] >= readHeat[addr];
+            const Rgb &tint = written ? writeTint : readTint;
+            const int heat = (written ? writeHeat[addr] : readHeat[addr]) * 3 / 5;
+            on = mix(setBit, tint, heat);
+            off = mix(clearBit, dim(tint), heat);
+        }
+
+        const int column = static_cast<int>(addr) / mapRows;
+        const int row = static_cast<int>(addr) % mapRows;
+        uint8_t *texel = &staging[static_cast<size_t>(row) * pitch + column * 8 * 4];
+        for (int bit = 7; bit >= 0; --bit, texel += 4)
+        {
+            const Rgb &c = (memory[addr] >> bit) & 1 ? on : off;
+            texel[0] = static_cast<uint8_t>(c.r);
+            texel[1] = static_cast<uint8_t>(c.g);
+            texel[2] = static_cast<uint8_t>(c.b);
+            texel[3] = 255;
+        }
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 8 * mapColumns, mapRows, GL_RGBA, GL_UNSIGNED_BYTE, staging.data());
+}
+
+void MemoryMapRenderer::draw()
+{
+    glViewport(0, 0, windowWidth, windowHeight);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    glColor3f(1.0f, 1.0f, 1.0f);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glEnable(GL_TEXTURE_2D);
+    glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0f, 0.0f);
+    glVertex2f(0.0f, 0.0f);
+    glTexCoord2f(1.0f, 0.0f);
+    glVertex2f(1.0f, 0.0f);
+    glTexCoord2f(1.0f, 1.0f);
+    glVertex2f(1.0f, 1.0f);
+    glTexCoord2f(0.0f, 1.0f);
+    glVertex2f(0.0f, 1.0f);
+    glEnd();
+
+    glDisable(GL_TEXTURE_2D);
+}
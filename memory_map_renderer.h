@@ -0,0 +1,57 @@
+#ifndef MEMORY_MAP_RENDERER_H
+#define MEMORY_MAP_RENDERER_H
+
+#include <cstddef>    // For size_t
+#include <cstdint>    // For memory and texels
+#include <functional> // For the swap callback
+#include <vector>     // For the staging texels
+
+// The whole of a machine's memory as one fixed-function OpenGL texture,
+// one texel per bit, for the debugger. Bytes run down columns of rows()
+// so sprite data stacked in memory shows its shape: 4 KB is 64 columns of
+// 64 bytes, XO-CHIP's 64 KB 256 of 256. Set bits are light and clear ones
+// dark, bytes read or written lately are tinted blue or red by how recent,
+// PC's two bytes are yellow and I's byte green. Each frame is built in
+// memory and sent with a single glTexSubImage2D, which stays cheap however
+// much of memory changed. The GL context has to be current for every call,
+// including the destructor.
+class MemoryMapRenderer
+{
+public:
+    explicit MemoryMapRenderer(std::function<void()> swap);
+    ~MemoryMapRenderer();
+
+    MemoryMapRenderer(const MemoryMapRenderer &) = delete;
+    MemoryMapRenderer &operator=(const MemoryMapRenderer &) = delete;
+
+    // Creates the texture for memorySize bytes, 4096 or 0x10000. False
+    // without a working context.
+    bool init(size_t memorySize);
+
+    // Window client size; the map is stretched to fill it
+    void resize(int width, int height);
+    int columns() const { return mapColumns; }
+    int rows() const { return mapRows; }
+
+    // Address at a window position, -1 outside the map
+    int addressAt(int x, int y) const;
+
+    // Takes memory and, per byte, how lately it was read and written
+    // (255 just now, 0 not lately), all memorySize bytes long
+    void upload(const uint8_t *memory, const uint8_t *readHeat, const uint8_t *writeHeat, uint16_t pc, uint16_t index);
+
+    void draw();
+    void present() { swapBuffers(); }
+
+private:
+    std::function<void()> swapBuffers;
+    unsigned texture = 0;
+    size_t size = 0;
+    int mapColumns = 0;
+    int mapRows = 0;
+    std::vector<uint8_t> staging; // RGBA, 8 * mapColumns by mapRows
+    int windowWidth = 0;
+    int windowHeight = 0;
+};
+
+#endif
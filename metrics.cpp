@@ -0,0 +1,96 @@
+#include "metrics.h"
+#include <cstdio> // For std::snprintf
+
+namespace
+{
+    std::atomic<unsigned> threadsSeen{0};
+
+    // Numbered on first use, the same shard in every FrameMetrics
+    unsigned threadIndex()
+    {
+        thread_local const unsigned index = threadsSeen.fetch_add(1, std::memory_order_relaxed);
+        return index;
+    }
+
+    void appendf(std::string &out, const char *format, const char *name, double value)
+    {
+        char line[160];
+        std::snprintf(line, sizeof line, format, name, value);
+        out += line;
+    }
+}
+
+constexpr int64_t FrameMetrics::bucketNanos[bucketCount];
+
+FrameMetrics::Shard &FrameMetrics::local()
+{
+    return shards[threadIndex() % shardCount];
+}
+
+void FrameMetrics::recordFrame(uint64_t instructions, int64_t nanos)
+{
+    Shard &shard = local();
+    shard.frames.fetch_add(1, std::memory_order_relaxed);
+    shard.instructions.fetch_add(instructions, std::memory_order_relaxed);
+    shard.nanos.fetch_add(static_cast<uint64_t>(nanos), std::memory_order_relaxed);
+    int bucket = 0;
+    while (bucket < bucketCount && nanos > bucketNanos[bucket])
+        ++bucket;
+    shard.buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+void FrameMetrics::write(std::string &out, const char *prefix, bool sentBytes) const
+{
+    uint64_t frames = 0, instructions = 0, nanos = 0, bytes = 0;
+    uint64_t buckets[bucketCount + 1] = {};
+    for (const Shard &shard : shards)
+    {
+        frames += shard.frames.load(std::memory_order_relaxed);
+        instructions += shard.instructions.load(std::memory_order_relaxed);
+        nanos += shard.nanos.load(std::memory_order_relaxed);
+        bytes += shard.bytes.load(std::memory_order_relaxed);
+        for (int b = 0; b <= bucketCount; ++b)
+            buckets[b] += shard.buckets[b].load(std::memory_order_relaxed);
+    }
+
+    const std::string base(prefix);
+    writeMetric(out, (base + "_frames_total").c_str(), "counter", "Frames stepped", static_cast<double>(frames));
+    writeMetric(out, (base + "_instructions_total").c_str(), "counter", "Instructions executed", static_cast<double>(instructions));
+    if (sentBytes)
+        writeMetric(out, (base + "_sent_bytes_total").c_str(), "counter", "Frame bytes sent to clients", static_cast<double>(bytes));
+
+    // Cumulative buckets in seconds, as Prometheus histograms are
+    const std::string histogram = base + "_frame_seconds";
+    out += "# HELP " + histogram + " Host time to step one frame\n# TYPE " + histogram + " histogram\n";
+    uint64_t cumulative = 0;
+    char line[160];
+    for (int b = 0; b <= bucketCount; ++b)
+    {
+        cumulative += buckets[b];
+        if (b < bucketCount)
+            std::snprintf(line, sizeof line, "%s_bucket{le=\"%g\"} %llu\n", histogram.c_str(), bucketNanos[b] / 1e9,
+                          static_cast<unsigned long long>(cumulative));
+        else
+            std::snprintf(line, sizeof line, "%s_bucket{le=\"+Inf\"} %llu\n", histogram.c_str(),
+                          static_cast<unsigned long long>(cumulative));
+        out += line;
+    }
+    appendf(out, "%s_sum %.9f\n", histogram.c_str(), nanos / 1e9);
+    appendf(out, "%s_count %.0f\n", histogram.c_str(), static_cast<double>(cumulative));
+}
+
+void writeMetric(std::string &out, const char *name, const char *type, const char *help, double value)
+{
+    out += "# HELP ";
+    out += name;
+    out += ' ';
+    out += help;
+    out += "\n# TYPE ";
+    out += name;
+    out += ' ';
+    out += type;
+    out += '\n';
+    // Counts exactly, anything else to nine digits
+    const bool whole = value == static_cast<double>(static_cast<int64_t>(value)) && value < 9e15 && value > -9e15;
+    appendf(out, whole ? "%s %.0f\n" : "%s %.9g\n", name, value);
+}
@@ -0,0 +1,54 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>  // For the shard counters
+#include <cstddef> // For size_t
+#include <cstdint> // For the counts
+#include <string>  // For the exposition text
+
+// Frame counters in Prometheus form, for the server's /metrics endpoint
+// and the batch runner's metrics file. Every thread counts into a shard
+// of its own, on its own cache line, with relaxed atomic adds; nothing is
+// summed until a scrape asks, so counting costs the stepping threads a
+// few uncontended adds a frame.
+class FrameMetrics
+{
+public:
+    // Frame time histogram bounds, an open bucket above the last
+    static constexpr int bucketCount = 12;
+    static constexpr int64_t bucketNanos[bucketCount] = {250, 500, 1000, 2000, 5000, 10000, 20000, 50000, 100000, 1000000, 10000000, 100000000};
+
+    // One frame of instructions that took nanos to step
+    void recordFrame(uint64_t instructions, int64_t nanos);
+
+    // Instructions run where the frame time isn't seen (sandbox workers)
+    void addInstructions(uint64_t instructions) { local().instructions.fetch_add(instructions, std::memory_order_relaxed); }
+    void addBytes(uint64_t bytes) { local().bytes.fetch_add(bytes, std::memory_order_relaxed); }
+
+    // Appends prefix_frames_total, prefix_instructions_total, the
+    // prefix_frame_seconds histogram and, if sentBytes,
+    // prefix_sent_bytes_total
+    void write(std::string &out, const char *prefix, bool sentBytes) const;
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> frames{0};
+        std::atomic<uint64_t> instructions{0};
+        std::atomic<uint64_t> nanos{0};
+        std::atomic<uint64_t> bytes{0};
+        std::atomic<uint64_t> buckets[bucketCount + 1] = {};
+    };
+
+    // More threads than shards share them, still without a lock
+    static constexpr size_t shardCount = 64;
+
+    Shard &local();
+
+    Shard shards[shardCount];
+};
+
+// One line of exposition with its HELP and TYPE
+void writeMetric(std::string &out, const char *name, const char *type, const char *help, double value);
+
+#endif
@@ -0,0 +1,286 @@
+#include "movie.h"
+#include <algorithm> // For std::upper_bound
+#include <cstring>   // For std::memcmp
+#include <fstream>
+#include <iterator> // For std::istreambuf_iterator
+#include <zlib.h>   // For the keyframes
+
+namespace
+{
+    const char movieMagic[4] = {'C', '8', 'M', 'V'};
+    const uint16_t movieVersion = 4; // 2 switched CXNN to PCG32, 3 added keyframes, 4 the end hash
+
+    void putU64(std::vector<uint8_t> &out, uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+            out.push_back((value >> (8 * i)) & 0xFF);
+    }
+
+    // LEB128: 7 bits per byte, high bit set while more follow
+    void putVarint(std::vector<uint8_t> &out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    bool getU64(const std::vector<uint8_t> &in, size_t &pos, uint64_t &value)
+    {
+        if (in.size() - pos < 8)
+            return false;
+        value = 0;
+        for (int i = 0; i < 8; ++i)
+            value |= static_cast<uint64_t>(in[pos + i]) << (8 * i);
+        pos += 8;
+        return true;
+    }
+
+    bool getVarint(const std::vector<uint8_t> &in, size_t &pos, uint64_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64 && pos < in.size(); shift += 7)
+        {
+            uint8_t byte = in[pos++];
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+}
+
+uint64_t Movie::hashImage(const Chip8 &chip8)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (uint8_t byte : chip8.getMemory())
+        hash = (hash ^ byte) * 1099511628211ull;
+    return hash;
+}
+
+bool Movie::save(const std::string &filename) const
+{
+    std::vector<uint8_t> out(movieMagic, movieMagic + sizeof movieMagic);
+    out.push_back(movieVersion & 0xFF);
+    out.push_back(movieVersion >> 8);
+    putU64(out, seed);
+    putU64(out, imageHash);
+    putU64(out, endCycle);
+    putU64(out, endHash);
+    putU64(out, events.size());
+
+    // Cycles are stored as deltas, most events are a frame apart
+    uint64_t last = 0;
+    for (const Event &event : events)
+    {
+        putVarint(out, event.cycle - last);
+        out.push_back(event.code);
+        last = event.cycle;
+    }
+
+    // Keyframes after the events, each deflated on its own so a seek
+    // inflates one
+    putVarint(out, keyframeFrames);
+    putVarint(out, keyframes.size());
+    const Keyframe *previous = nullptr;
+    std::vector<uint8_t> packed;
+    for (const Keyframe &key : keyframes)
+    {
+        putVarint(out, key.frame - (previous ? previous->frame : 0));
+        putVarint(out, key.cycle - (previous ? previous->cycle : 0));
+        putVarint(out, key.event - (previous ? previous->event : 0));
+        out.push_back(key.keys & 0xFF);
+        out.push_back(key.keys >> 8);
+        uLongf packedSize = compressBound(static_cast<uLong>(key.state.size()));
+        packed.resize(packedSize);
+        if (compress2(packed.data(), &packedSize, key.state.data(), static_cast<uLong>(key.state.size()), Z_BEST_SPEED) != Z_OK)
+            return false;
+        putVarint(out, key.state.size());
+        putVarint(out, packedSize);
+        out.insert(out.end(), packed.begin(), packed.begin() + packedSize);
+        previous = &key;
+    }
+
+    std::ofstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    file.write(reinterpret_cast<const char *>(out.data()), out.size());
+    return static_cast<bool>(file);
+}
+
+bool Movie::load(const std::string &filename)
+{
+    std::ifstream file(filename, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    std::vector<uint8_t> in((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    size_t pos = sizeof movieMagic + 2;
+    if (in.size() < pos || std::memcmp(in.data(), movieMagic, sizeof movieMagic) != 0)
+        return false;
+    const int version = in[4] | (in[5] << 8);
+    if (version < 2 || version > movieVersion)
+        return false;
+
+    uint64_t count = 0;
+    endHash = 0;
+    if (!getU64(in, pos, seed) || !getU64(in, pos, imageHash) || !getU64(in, pos, endCycle) ||
+        (version >= 4 && !getU64(in, pos, endHash)) || !getU64(in, pos, count))
+        return false;
+
+    // Each event takes at least two bytes, reject impossible counts before reserving
+    if (count > (in.size() - pos) / 2)
+        return false;
+    events.clear();
+    events.reserve(count);
+    frameCount = 0;
+    uint64_t cycle = 0;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t delta = 0;
+        if (!getVarint(in, pos, delta) || pos >= in.size())
+            return false;
+        cycle += delta;
+        events.push_back({cycle, in[pos++]});
+        frameCount += events.back().code == TimerTick;
+    }
+
+    // Version 2 movies have none; seeking then replays from the start
+    keyframes.clear();
+    if (version < 3)
+        return true;
+    uint64_t interval = 0, keyCount = 0;
+    if (!getVarint(in, pos, interval) || !getVarint(in, pos, keyCount) || interval > UINT32_MAX || keyCount > (in.size() - pos) / 7)
+        return false;
+    keyframeFrames = static_cast<uint32_t>(interval);
+    keyframes.resize(keyCount);
+    for (uint64_t i = 0; i < keyCount; ++i)
+    {
+        Keyframe &key = keyframes[i];
+        const Keyframe *previous = i ? &keyframes[i - 1] : nullptr;
+        uint64_t frame, keyCycle, event, size, packedSize;
+        if (!getVarint(in, pos, frame) || !getVarint(in, pos, keyCycle) || !getVarint(in, pos, event) || in.size() - pos < 2)
+            return false;
+        key.frame = frame + (previous ? previous->frame : 0);
+        key.cycle = keyCycle + (previous ? previous->cycle : 0);
+        key.event = event + (previous ? previous->event : 0);
+        key.keys = static_cast<uint16_t>(in[pos] | (in[pos + 1] << 8));
+        pos += 2;
+        if (key.event > events.size() || key.frame > frameCount || !getVarint(in, pos, size) || !getVarint(in, pos, packedSize) ||
+            size > (1u << 20) || packedSize > in.size() - pos)
+            return false;
+        key.state.resize(size);
+        uLongf unpacked = static_cast<uLongf>(size);
+        if (uncompress(key.state.data(), &unpacked, &in[pos], static_cast<uLong>(packedSize)) != Z_OK || unpacked != size)
+            return false;
+        pos += packedSize;
+    }
+    return true;
+}
+
+void Movie::play(Chip8 &chip8) const
+{
+    chip8.seedRandom(seed);
+    for (const Event &event : events)
+    {
+        chip8.runUntil(event.cycle);
+        if (event.code == TimerTick)
+            chip8.decrementTimers();
+        else
+            chip8.setKey(event.code & 0x0F, (event.code & KeyDown) != 0);
+    }
+    chip8.runUntil(endCycle);
+}
+
+void Movie::keyframeAt(const Chip8 &chip8, uint64_t event)
+{
+    Keyframe key;
+    key.frame = frameCount;
+    key.cycle = chip8.getCycleCount();
+    key.event = event;
+    key.keys = chip8.keyMask();
+    key.state = chip8.saveState();
+    keyframes.push_back(std::move(key));
+}
+
+void Movie::countTick(const Chip8 &chip8, uint64_t nextEvent)
+{
+    ++frameCount;
+    const uint64_t last = keyframes.empty() ? 0 : keyframes.back().frame;
+    if (keyframeFrames && frameCount - last >= keyframeFrames)
+        keyframeAt(chip8, nextEvent);
+}
+
+void Movie::addKeyframe(const Chip8 &chip8)
+{
+    keyframeAt(chip8, events.size());
+}
+
+void Movie::tick(const Chip8 &chip8)
+{
+    events.push_back({chip8.getCycleCount(), TimerTick});
+    countTick(chip8, events.size());
+}
+
+void Movie::buildKeyframes(Chip8 &chip8)
+{
+    keyframes.clear();
+    frameCount = 0;
+    chip8.reset();
+    chip8.seedRandom(seed);
+    keyframeAt(chip8, 0);
+    for (size_t i = 0; i < events.size(); ++i)
+    {
+        const Event &event = events[i];
+        chip8.runUntil(event.cycle);
+        if (event.code == TimerTick)
+        {
+            chip8.decrementTimers();
+            countTick(chip8, i + 1);
+        }
+        else
+            chip8.setKey(event.code & 0x0F, (event.code & KeyDown) != 0);
+    }
+}
+
+bool Movie::seek(Chip8 &chip8, uint64_t frame) const
+{
+    if (frame > frameCount)
+        return false;
+
+    // Cycles in the movie count from where the restored machine's stand
+    size_t next = 0;
+    uint64_t ticks = 0, base = 0, baseCycle = 0;
+    auto key = std::upper_bound(keyframes.begin(), keyframes.end(), frame, [](uint64_t f, const Keyframe &k)
+                                { return f < k.frame; });
+    if (key != keyframes.begin() && chip8.loadState((key - 1)->state.data(), (key - 1)->state.size()))
+    {
+        --key;
+        chip8.setKeyMask(key->keys);
+        next = static_cast<size_t>(key->event);
+        ticks = key->frame;
+        baseCycle = key->cycle;
+    }
+    else
+    {
+        chip8.reset();
+        chip8.seedRandom(seed);
+    }
+    base = chip8.getCycleCount();
+
+    for (; ticks < frame && next < events.size(); ++next)
+    {
+        const Event &event = events[next];
+        chip8.runUntil(base + (event.cycle - baseCycle));
+        if (event.code == TimerTick)
+        {
+            chip8.decrementTimers();
+            ++ticks;
+        }
+        else
+            chip8.setKey(event.code & 0x0F, (event.code & KeyDown) != 0);
+    }
+    return ticks == frame;
+}
@@ -0,0 +1,81 @@
+#ifndef MOVIE_H
+#define MOVIE_H
+
+#include "chip8.h"
+#include <cstdint> // For uint64_t
+#include <string>  // For file names
+#include <vector>  // For the event list
+
+// Input recording of a session that started from a freshly loaded ROM.
+// Every key transition and timer tick is stored with the cycle count it
+// happened at, together with the RNG seed, so a replay repeats the run
+// bit for bit regardless of the clock rate it was recorded at.
+//
+// Every keyframeFrames timer ticks the recording also keeps a keyframe,
+// the whole machine state and the held keys, so seeking to any frame is
+// one restore and at most keyframeFrames frames of emulation, however
+// long the movie. Files keep them deflated, a few hundred bytes each.
+struct Movie
+{
+    enum : uint8_t
+    {
+        KeyUp = 0x00,    // | key
+        KeyDown = 0x10,  // | key
+        TimerTick = 0x20 // decrementTimers()
+    };
+
+    struct Event
+    {
+        uint64_t cycle;
+        uint8_t code;
+    };
+
+    // The machine right after a timer tick, with events[event] next
+    struct Keyframe
+    {
+        uint64_t frame = 0; // Timer ticks before it
+        uint64_t cycle = 0;
+        uint64_t event = 0;
+        uint16_t keys = 0;          // Held, which states leave out
+        std::vector<uint8_t> state; // saveState()
+    };
+
+    uint64_t seed = 0;
+    uint64_t imageHash = 0; // Memory right after the ROM load
+    uint64_t endCycle = 0;  // Cycle count when recording stopped
+    uint64_t endHash = 0;   // stateHash() then, 0 in movies older than it
+    std::vector<Event> events;
+
+    uint32_t keyframeFrames = 600; // 10 s at 60 Hz
+    std::vector<Keyframe> keyframes; // By frame, the first at frame 0
+    uint64_t frameCount = 0;         // Timer ticks among the events
+
+    // FNV-1a over memory, identifies the ROM a movie belongs to
+    static uint64_t hashImage(const Chip8 &chip8);
+
+    bool save(const std::string &filename) const;
+    bool load(const std::string &filename);
+
+    // Replays onto a machine that just loaded the movie's ROM
+    void play(Chip8 &chip8) const;
+
+    // While recording: a keyframe of the machine as it stands, and a timer
+    // tick that chip8 just ran, with a keyframe when one is due
+    void addKeyframe(const Chip8 &chip8);
+    void tick(const Chip8 &chip8);
+
+    // Replaces the keyframes by replaying the whole movie onto chip8, which
+    // holds its ROM, for movies recorded before there were any
+    void buildKeyframes(Chip8 &chip8);
+
+    // Puts chip8, which holds the movie's ROM, where the replay stands
+    // right after the timer tick of the given frame (0: the start) from
+    // the nearest keyframe before it. False past the last frame.
+    bool seek(Chip8 &chip8, uint64_t frame) const;
+
+private:
+    void keyframeAt(const Chip8 &chip8, uint64_t event);
+    void countTick(const Chip8 &chip8, uint64_t nextEvent);
+};
+
+#endif
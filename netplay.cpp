@@ -0,0 +1,426 @@
+#include "netplay.h"
+#include <algorithm> // For std::min
+#include <cstring>   // For std::memcmp
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const char packetMagic[4] = {'C', '8', 'N', 'P'};
+    const uint8_t protocolVersion = 2; // 2 added the state hash
+    const size_t headerSize = sizeof packetMagic + 2;
+    const auto peerTimeout = std::chrono::seconds(5);
+    const int helloInterval = 15; // Frames between hellos while connecting
+    const int maxInputsPerPacket = 32;
+
+    enum : uint8_t
+    {
+        HelloPacket = 1, // u8 hosting, u64 image hash, u64 seed, u32 cycles per frame
+        InputPacket = 2, // u32 ack, u32 frame, i8 advantage, u32 hashed frame, u64 state hash, u32 first input frame, u8 count, u16 keys[count]
+        QuitPacket = 3
+    };
+
+    void putU16(std::vector<uint8_t> &out, uint16_t value)
+    {
+        out.push_back(value & 0xFF);
+        out.push_back(value >> 8);
+    }
+
+    void putU32(std::vector<uint8_t> &out, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+            out.push_back((value >> (8 * i)) & 0xFF);
+    }
+
+    void putU64(std::vector<uint8_t> &out, uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+            out.push_back((value >> (8 * i)) & 0xFF);
+    }
+
+    uint64_t getLE(const uint8_t *data, int bytes)
+    {
+        uint64_t value = 0;
+        for (int i = 0; i < bytes; ++i)
+            value |= static_cast<uint64_t>(data[i]) << (8 * i);
+        return value;
+    }
+
+    std::vector<uint8_t> packetHeader(uint8_t type)
+    {
+        std::vector<uint8_t> out(packetMagic, packetMagic + sizeof packetMagic);
+        out.push_back(protocolVersion);
+        out.push_back(type);
+        return out;
+    }
+
+#if defined(_WIN32)
+    using SocketType = SOCKET;
+    const intptr_t noSocket = static_cast<intptr_t>(INVALID_SOCKET);
+    void closeSocket(intptr_t s) { closesocket(static_cast<SOCKET>(s)); }
+#else
+    using SocketType = int;
+    const intptr_t noSocket = -1;
+    void closeSocket(intptr_t s) { close(static_cast<int>(s)); }
+#endif
+
+    // A non-blocking UDP socket on port, 0 for any
+    intptr_t openSocket(uint16_t port)
+    {
+        SocketType s = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+        if (static_cast<intptr_t>(s) == noSocket)
+            return noSocket;
+
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = htonl(INADDR_ANY);
+        address.sin_port = htons(port);
+#if defined(_WIN32)
+        u_long nonBlocking = 1;
+        bool ready = bind(s, reinterpret_cast<sockaddr *>(&address), sizeof address) == 0 &&
+                     ioctlsocket(s, FIONBIO, &nonBlocking) == 0;
+#else
+        bool ready = bind(s, reinterpret_cast<sockaddr *>(&address), sizeof address) == 0 &&
+                     fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK) == 0;
+#endif
+        if (!ready)
+        {
+            closeSocket(static_cast<intptr_t>(s));
+            return noSocket;
+        }
+        return static_cast<intptr_t>(s);
+    }
+}
+
+NetplaySession::NetplaySession()
+    : history(ringSize)
+{
+#if defined(_WIN32)
+    WSADATA data;
+    WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+    socketHandle = noSocket;
+}
+
+NetplaySession::~NetplaySession()
+{
+    if (socketHandle != noSocket)
+        closeSocket(socketHandle);
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+}
+
+bool NetplaySession::host(uint16_t port)
+{
+    hosting = true;
+    socketHandle = openSocket(port);
+    return socketHandle != noSocket;
+}
+
+bool NetplaySession::join(const std::string &address, uint16_t port)
+{
+    hosting = false;
+    addrinfo hints{};
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_DGRAM;
+    addrinfo *found = nullptr;
+    if (getaddrinfo(address.c_str(), nullptr, &hints, &found) != 0 || !found)
+        return false;
+    peerAddress = reinterpret_cast<sockaddr_in *>(found->ai_addr)->sin_addr.s_addr;
+    peerPort = htons(port);
+    peerKnown = true;
+    freeaddrinfo(found);
+
+    socketHandle = openSocket(0);
+    return socketHandle != noSocket;
+}
+
+bool NetplaySession::connect(const Settings &localSettings)
+{
+    local = localSettings;
+    receive();
+    if (status() == Status::Connecting && !hosting && --helloCountdown <= 0)
+    {
+        sendHello();
+        helloCountdown = helloInterval;
+    }
+    return status() == Status::Running;
+}
+
+void NetplaySession::disconnect()
+{
+    if (peerKnown && status() != Status::Disconnected)
+    {
+        // Datagrams get lost, a few copies make it likely one arrives
+        for (int i = 0; i < 3; ++i)
+            sendPacket(packetHeader(QuitPacket));
+    }
+    state.store(Status::Disconnected, std::memory_order_relaxed);
+}
+
+void NetplaySession::sendPacket(const std::vector<uint8_t> &packet)
+{
+    if (socketHandle == noSocket || !peerKnown)
+        return;
+    sockaddr_in to{};
+    to.sin_family = AF_INET;
+    to.sin_addr.s_addr = peerAddress;
+    to.sin_port = peerPort;
+    sendto(static_cast<SocketType>(socketHandle), reinterpret_cast<const char *>(packet.data()), static_cast<int>(packet.size()), 0,
+           reinterpret_cast<sockaddr *>(&to), sizeof to);
+}
+
+void NetplaySession::sendHello()
+{
+    // The guest's seed and clock rate are ignored, send them anyway
+    std::vector<uint8_t> packet = packetHeader(HelloPacket);
+    packet.push_back(hosting ? 1 : 0);
+    putU64(packet, local.imageHash);
+    putU64(packet, local.seed);
+    putU32(packet, static_cast<uint32_t>(local.cyclesPerFrame));
+    sendPacket(packet);
+}
+
+// Everything the peer hasn't acknowledged yet, so lost packets cost nothing
+// as long as a later one arrives
+void NetplaySession::sendInputs()
+{
+    const uint32_t end = localEnd;
+    const uint32_t start = std::max(peerAck, end - std::min<uint32_t>(end, maxInputsPerPacket));
+    std::vector<uint8_t> packet = packetHeader(InputPacket);
+    putU32(packet, remoteConfirmed);
+    putU32(packet, frame);
+    packet.push_back(static_cast<uint8_t>(static_cast<int8_t>(std::max(-127, std::min(127, static_cast<int>(frame - peerFrame))))));
+    const uint32_t settled = settledFrame();
+    putU32(packet, settled);
+    putU64(packet, settled != UINT32_MAX ? history[settled % ringSize].hash : 0);
+    putU32(packet, start);
+    packet.push_back(static_cast<uint8_t>(end - start));
+    for (uint32_t f = start; f < end; ++f)
+        putU16(packet, localInputs[f % ringSize]);
+    sendPacket(packet);
+}
+
+void NetplaySession::receive()
+{
+    if (socketHandle == noSocket)
+        return;
+    uint8_t buffer[512];
+    for (;;)
+    {
+        sockaddr_in from{};
+#if defined(_WIN32)
+        int fromSize = sizeof from;
+#else
+        socklen_t fromSize = sizeof from;
+#endif
+        auto received = recvfrom(static_cast<SocketType>(socketHandle), reinterpret_cast<char *>(buffer), sizeof buffer, 0,
+                                 reinterpret_cast<sockaddr *>(&from), &fromSize);
+        if (received < 0)
+        {
+#if defined(_WIN32)
+            // An ICMP port unreachable from an earlier send, not fatal for UDP
+            if (WSAGetLastError() == WSAECONNRESET)
+                continue;
+#endif
+            return; // Nothing more queued
+        }
+        handlePacket(buffer, static_cast<size_t>(received), from.sin_addr.s_addr, from.sin_port);
+    }
+}
+
+void NetplaySession::handlePacket(const uint8_t *data, size_t size, uint32_t fromAddress, uint16_t fromPort)
+{
+    if (size < headerSize || std::memcmp(data, packetMagic, sizeof packetMagic) != 0 || data[4] != protocolVersion)
+        return;
+    const uint8_t type = data[5];
+    const uint8_t *body = data + headerSize;
+    size -= headerSize;
+
+    if (type == HelloPacket && size >= 21)
+    {
+        const bool fromHost = body[0] != 0;
+        if (fromHost == hosting)
+            return;
+        if (hosting)
+        {
+            // The first guest to say hello is the peer from then on
+            if (!peerKnown)
+            {
+                peerAddress = fromAddress;
+                peerPort = fromPort;
+                peerKnown = true;
+            }
+            if (fromAddress != peerAddress || fromPort != peerPort)
+                return;
+            sendHello(); // Also answers repeats whose reply got lost
+        }
+        else if (fromAddress != peerAddress || fromPort != peerPort)
+        {
+            return;
+        }
+
+        if (status() != Status::Connecting)
+            return;
+        lastHeard = Clock::now();
+        if (getLE(body + 1, 8) != local.imageHash)
+        {
+            state.store(Status::Mismatch, std::memory_order_relaxed);
+            return;
+        }
+        agreed = local;
+        if (!hosting)
+        {
+            agreed.seed = getLE(body + 9, 8);
+            agreed.cyclesPerFrame = static_cast<int>(getLE(body + 17, 4));
+        }
+        state.store(Status::Running, std::memory_order_relaxed);
+        return;
+    }
+
+    if (!peerKnown || fromAddress != peerAddress || fromPort != peerPort || status() != Status::Running)
+        return;
+    lastHeard = Clock::now();
+
+    if (type == QuitPacket)
+    {
+        state.store(Status::Disconnected, std::memory_order_relaxed);
+        return;
+    }
+    if (type != InputPacket || size < 26)
+        return;
+
+    const uint32_t ack = static_cast<uint32_t>(getLE(body, 4));
+    peerFrame = static_cast<uint32_t>(getLE(body + 4, 4));
+    peerAdvantage = static_cast<int8_t>(body[8]);
+    const uint32_t hashed = static_cast<uint32_t>(getLE(body + 9, 4));
+    if (hashed != UINT32_MAX && peerHashFrame == UINT32_MAX) // One at a time, each waits until this side settles it
+    {
+        peerHashFrame = hashed;
+        peerHash = getLE(body + 13, 8);
+    }
+    const uint32_t start = static_cast<uint32_t>(getLE(body + 21, 4));
+    const size_t count = std::min<size_t>(body[25], (size - 26) / 2);
+    if (ack > peerAck && ack <= localEnd)
+        peerAck = ack;
+
+    // Take the keys that extend what is confirmed. Past frames that ran on
+    // a different prediction mark where the next advance rolls back to.
+    for (size_t i = 0; i < count; ++i)
+    {
+        const uint32_t f = start + static_cast<uint32_t>(i);
+        if (f < remoteConfirmed)
+            continue;
+        if (f > remoteConfirmed || f >= frame + ringSize / 2)
+            break;
+        const uint16_t keys = static_cast<uint16_t>(getLE(body + 26 + 2 * i, 2));
+        remoteInputs[f % ringSize] = keys;
+        if (f < frame && history[f % ringSize].remoteUsed != keys)
+            firstWrong = std::min(firstWrong, f);
+        ++remoteConfirmed;
+    }
+}
+
+// A frame's start only depends on the keys of the frames before it. A
+// pending rollback will run the frames after firstWrong again.
+uint32_t NetplaySession::settledFrame() const
+{
+    if (frame == 0)
+        return UINT32_MAX;
+    return std::min({remoteConfirmed, frame - 1, firstWrong});
+}
+
+// Only hashes still in the ring can be compared; an older one is dropped
+void NetplaySession::checkPeerHash()
+{
+    const uint32_t settled = settledFrame();
+    if (peerHashFrame == UINT32_MAX || settled == UINT32_MAX || peerHashFrame > settled)
+        return;
+    if (frame - peerHashFrame <= static_cast<uint32_t>(ringSize) && history[peerHashFrame % ringSize].hash != peerHash)
+    {
+        desyncAt.store(peerHashFrame, std::memory_order_relaxed);
+        state.store(Status::Desynced, std::memory_order_relaxed);
+    }
+    peerHashFrame = UINT32_MAX;
+}
+
+// Snapshots the frame's start, then runs it on both players' keys
+void NetplaySession::runFrame(Chip8 &chip8, uint32_t index)
+{
+    FrameRecord &record = history[index % ringSize];
+    record.hash = chip8.stateHash();
+    chip8.snapshot(record.state);
+    record.keys = chip8.keyMask();
+    record.remoteUsed = remoteInputs[(index < remoteConfirmed ? index : remoteConfirmed - 1) % ringSize];
+
+    // Key changes go through setKey in a fixed order so FX0A wakes the same on both sides
+    const uint16_t keys = localInputs[index % ringSize] | record.remoteUsed;
+    const uint16_t changed = keys ^ record.keys;
+    for (int k = 0; k < 16; ++k)
+    {
+        if ((changed >> k) & 1)
+            chip8.setKey(k, (keys >> k) & 1);
+    }
+
+    if (agreed.cyclesPerFrame > 0)
+        chip8.runFrame(agreed.cyclesPerFrame);
+    else
+        chip8.runVipFrame();
+}
+
+bool NetplaySession::advance(Chip8 &chip8, uint16_t localKeys)
+{
+    receive();
+    if (status() != Status::Running)
+        return false;
+    if (Clock::now() - lastHeard > peerTimeout)
+    {
+        state.store(Status::Disconnected, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Snapshots only reach back maxRollback frames. Apart from that, a side
+    // that runs over a frame ahead of the other skips one now and then, so
+    // the one behind doesn't keep rolling back; the difference of the two
+    // advantages cancels out the latency both of them see.
+    const int lead = (static_cast<int>(frame - peerFrame) - peerAdvantage) / 2;
+    if (frame >= remoteConfirmed + maxRollback || (lead >= 1 && frame - lastSyncWait >= 60))
+    {
+        if (frame < remoteConfirmed + maxRollback)
+            lastSyncWait = frame;
+        sendInputs();
+        return false;
+    }
+
+    localInputs[localEnd++ % ringSize] = localKeys;
+    sendInputs();
+
+    if (firstWrong < frame)
+    {
+        FrameRecord &record = history[firstWrong % ringSize];
+        chip8.restore(record.state);
+        chip8.setKeyMask(record.keys);
+        for (uint32_t f = firstWrong; f < frame; ++f)
+            runFrame(chip8, f);
+        rollbacks.fetch_add(1, std::memory_order_relaxed);
+    }
+    firstWrong = UINT32_MAX;
+
+    runFrame(chip8, frame);
+    ++frame;
+    checkPeerHash();
+    return true;
+}
@@ -0,0 +1,123 @@
+#ifndef NETPLAY_H
+#define NETPLAY_H
+
+#include "chip8.h"
+#include <array>   // For the input rings
+#include <atomic>  // For the status the GUI polls
+#include <chrono>  // For the peer timeout
+#include <cstdint> // For key masks and frame numbers
+#include <string>  // For the host address
+#include <vector>  // For the snapshot ring
+
+// Two-player rollback netplay over UDP. Both machines run the same ROM from
+// the same seed and swap one 16-key mask per frame; the keypad each side's
+// program sees is both players' keys ORed together. Remote keys that have
+// not arrived yet are predicted to stay as last seen, and when the real ones
+// differ the session restores the snapshot of that frame and runs forward
+// again, so neither side waits on the network unless the other falls more
+// than maxRollback frames behind. Each side also sends the state hash of
+// its latest frame that no more keys can change; a hash that differs from
+// the one taken locally at that frame ends the session as Desynced.
+// Everything except the status getters belongs to the emulation thread.
+class NetplaySession
+{
+public:
+    enum class Status
+    {
+        Connecting,  // Waiting for the peer's hello
+        Running,
+        Mismatch,    // The peers loaded different ROMs
+        Desynced,    // The machines ended up in different states
+        Disconnected // The peer quit or went silent
+    };
+
+    // Agreed in the handshake; the host's seed and clock rate win and the
+    // ROM image must match
+    struct Settings
+    {
+        uint64_t seed = 0;
+        uint64_t imageHash = 0;  // Movie::hashImage of the fresh ROM
+        int cyclesPerFrame = 0;  // 0 is COSMAC VIP timing
+    };
+
+    static constexpr int inputDelay = 2;   // Local keys apply this many frames late, which hides most latency
+    static constexpr int maxRollback = 8;  // Furthest back a correction can reach
+    static constexpr uint16_t defaultPort = 6502;
+
+    NetplaySession();
+    ~NetplaySession();
+
+    NetplaySession(const NetplaySession &) = delete;
+    NetplaySession &operator=(const NetplaySession &) = delete;
+
+    // Opens the socket; false if it can't be bound or the host not resolved
+    bool host(uint16_t port);
+    bool join(const std::string &address, uint16_t port);
+
+    // Call once per frame while Connecting. Exchanges hellos and returns
+    // true once both sides agree; settings() holds the result then.
+    bool connect(const Settings &local);
+    const Settings &settings() const { return agreed; }
+
+    // Runs the next frame on chip8 with these local keys, first rolling back
+    // and re-running any frames whose remote keys were mispredicted. False if
+    // the frame has to wait for the peer; chip8 is untouched then.
+    bool advance(Chip8 &chip8, uint16_t localKeys);
+
+    // Tells the peer, the session stays Disconnected from then on
+    void disconnect();
+
+    Status status() const { return state.load(std::memory_order_relaxed); }
+    uint64_t rollbackCount() const { return rollbacks.load(std::memory_order_relaxed); }
+    uint32_t desyncFrame() const { return desyncAt.load(std::memory_order_relaxed); } // Once Desynced
+
+private:
+    static constexpr int ringSize = 64;
+
+    struct FrameRecord
+    {
+        Chip8::Snapshot state;   // Machine at the start of the frame
+        uint16_t keys = 0;       // Keys held going into it
+        uint16_t remoteUsed = 0; // Remote keys it ran with, maybe predicted
+        uint64_t hash = 0;       // Chip8::stateHash of state
+    };
+
+    void receive();
+    void handlePacket(const uint8_t *data, size_t size, uint32_t fromAddress, uint16_t fromPort);
+    void sendHello();
+    void sendInputs();
+    void sendPacket(const std::vector<uint8_t> &packet);
+    void runFrame(Chip8 &chip8, uint32_t index);
+    uint32_t settledFrame() const; // Latest frame whose start no more keys can change, UINT32_MAX if none
+    void checkPeerHash();
+
+    intptr_t socketHandle = -1;
+    bool hosting = false;
+    uint32_t peerAddress = 0; // IPv4, network byte order
+    uint16_t peerPort = 0;    // Network byte order
+    bool peerKnown = false;
+    Settings local;
+    Settings agreed;
+    std::chrono::steady_clock::time_point lastHeard;
+    int helloCountdown = 0;
+
+    std::vector<FrameRecord> history; // ringSize frames, indexed by frame % ringSize
+    std::array<uint16_t, ringSize> localInputs{};
+    std::array<uint16_t, ringSize> remoteInputs{};
+    uint32_t frame = 0;                    // Next frame to emulate
+    uint32_t localEnd = inputDelay;        // Our keys are known for every frame below this
+    uint32_t remoteConfirmed = inputDelay; // Remote keys are known for every frame below this
+    uint32_t firstWrong = UINT32_MAX;      // Earliest emulated frame that ran on a wrong prediction
+    uint32_t peerAck = 0;                  // The peer has our keys for every frame below this
+    uint32_t peerFrame = 0;                // Peer's next frame as of its last packet
+    int peerAdvantage = 0;                 // How far it saw itself ahead of us
+    uint32_t lastSyncWait = 0;
+    uint32_t peerHashFrame = UINT32_MAX; // Frame the peer last sent the state hash of, UINT32_MAX if none
+    uint64_t peerHash = 0;
+
+    std::atomic<Status> state{Status::Connecting};
+    std::atomic<uint64_t> rollbacks{0};
+    std::atomic<uint32_t> desyncAt{0};
+};
+
+#endif
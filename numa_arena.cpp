@@ -0,0 +1,235 @@
+#include "numa_arena.h"
+#include <cstdint> // For uintptr_t
+#include <cstdlib> // For std::strtol
+#include <fstream> // For the sysfs node lists
+#include <string>  // For sysfs paths
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <pthread.h>     // For pthread_setaffinity_np
+#include <sched.h>       // For cpu_set_t
+#include <sys/mman.h>    // For mmap and madvise
+#include <sys/syscall.h> // For mbind, which glibc doesn't wrap
+#include <unistd.h>
+#endif
+
+namespace numa
+{
+    namespace
+    {
+#if defined(__linux__)
+        // "0-15,32-47" as sysfs writes it
+        std::vector<int> parseCpuList(const std::string &text)
+        {
+            std::vector<int> cpus;
+            const char *p = text.c_str();
+            while (*p)
+            {
+                char *end = nullptr;
+                const long first = std::strtol(p, &end, 10);
+                if (end == p)
+                    break;
+                long last = first;
+                p = end;
+                if (*p == '-')
+                {
+                    last = std::strtol(p + 1, &end, 10);
+                    p = end;
+                }
+                for (long cpu = first; cpu <= last; ++cpu)
+                    cpus.push_back(static_cast<int>(cpu));
+                if (*p == ',')
+                    ++p;
+            }
+            return cpus;
+        }
+#endif
+
+        std::vector<Node> findNodes()
+        {
+            std::vector<Node> found;
+#if defined(_WIN32)
+            ULONG highest = 0;
+            if (GetNumaHighestNodeNumber(&highest))
+            {
+                for (USHORT id = 0; id <= highest; ++id)
+                {
+                    GROUP_AFFINITY affinity{};
+                    if (!GetNumaNodeProcessorMaskEx(id, &affinity) || affinity.Mask == 0)
+                        continue;
+                    Node node;
+                    node.id = id;
+                    for (int bit = 0; bit < static_cast<int>(sizeof(KAFFINITY) * 8); ++bit)
+                    {
+                        if ((affinity.Mask >> bit) & 1)
+                            node.cpus.push_back(affinity.Group * 64 + bit);
+                    }
+                    found.push_back(node);
+                }
+            }
+#elif defined(__linux__)
+            for (int id = 0; id < 1024; ++id)
+            {
+                std::ifstream list("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+                if (!list)
+                {
+                    if (id > 0 && found.empty())
+                        break;
+                    continue;
+                }
+                std::string text;
+                std::getline(list, text);
+                Node node;
+                node.id = id;
+                node.cpus = parseCpuList(text);
+                if (!node.cpus.empty())
+                    found.push_back(node);
+            }
+#endif
+            if (found.empty())
+                found.push_back(Node{});
+            return found;
+        }
+
+        // Unmaps or frees a chunk from either allocation path
+        void release(void *base, size_t size)
+        {
+#if defined(_WIN32)
+            (void)size;
+            VirtualFree(base, 0, MEM_RELEASE);
+#elif defined(__linux__)
+            munmap(base, size);
+#else
+            (void)size;
+            std::free(base);
+#endif
+        }
+    }
+
+    const std::vector<Node> &nodes()
+    {
+        static const std::vector<Node> found = findNodes();
+        return found;
+    }
+
+    bool bindThread(const Node &node)
+    {
+        if (node.cpus.empty())
+            return false;
+#if defined(_WIN32)
+        // A node lies within one processor group
+        GROUP_AFFINITY affinity{};
+        if (!GetNumaNodeProcessorMaskEx(static_cast<USHORT>(node.id), &affinity))
+            return false;
+        return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu : node.cpus)
+        {
+            if (cpu < CPU_SETSIZE)
+                CPU_SET(cpu, &set);
+        }
+        return pthread_setaffinity_np(pthread_self(), sizeof set, &set) == 0;
+#else
+        return false;
+#endif
+    }
+
+    Arena::Arena(int node) : home(node) {}
+
+    Arena::~Arena()
+    {
+        for (const Chunk &chunk : chunks)
+            release(chunk.base, chunk.size);
+    }
+
+    void *Arena::allocate(size_t size, size_t alignment)
+    {
+        if (!chunks.empty())
+        {
+            const Chunk &last = chunks.back();
+            const uintptr_t start = reinterpret_cast<uintptr_t>(last.base);
+            const size_t offset = ((start + used + alignment - 1) & ~(uintptr_t(alignment) - 1)) - start;
+            if (offset + size <= last.size)
+            {
+                used = offset + size;
+                return static_cast<char *>(last.base) + offset;
+            }
+        }
+        if (!addChunk(size + alignment))
+            return nullptr;
+        return allocate(size, alignment);
+    }
+
+    size_t Arena::reserved() const
+    {
+        size_t total = 0;
+        for (const Chunk &chunk : chunks)
+            total += chunk.size;
+        return total;
+    }
+
+    size_t Arena::hugeReserved() const
+    {
+        size_t total = 0;
+        for (const Chunk &chunk : chunks)
+            total += chunk.huge ? chunk.size : 0;
+        return total;
+    }
+
+    bool Arena::addChunk(size_t minimum)
+    {
+        const size_t size = minimum <= chunkSize ? chunkSize : (minimum + hugePageSize - 1) / hugePageSize * hugePageSize;
+        void *base = nullptr;
+        bool huge = false;
+#if defined(_WIN32)
+        // Large pages need SeLockMemoryPrivilege; without it they fail and
+        // ordinary pages are used
+        const DWORD node = home >= 0 ? static_cast<DWORD>(home) : NUMA_NO_PREFERRED_NODE;
+        const SIZE_T large = GetLargePageMinimum();
+        if (large && size % large == 0)
+        {
+            base = VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+                                      PAGE_READWRITE, node);
+            huge = base != nullptr;
+        }
+        if (!base)
+            base = VirtualAllocExNuma(GetCurrentProcess(), nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, node);
+#elif defined(__linux__)
+        base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        huge = base != MAP_FAILED;
+        if (!huge)
+        {
+            // Over-map so the chunk can start on a huge page boundary,
+            // which transparent huge pages need
+            const size_t padded = size + hugePageSize;
+            char *raw = static_cast<char *>(mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+            if (raw == MAP_FAILED)
+                return false;
+            char *aligned = reinterpret_cast<char *>((reinterpret_cast<uintptr_t>(raw) + hugePageSize - 1) & ~(uintptr_t(hugePageSize) - 1));
+            if (aligned > raw)
+                munmap(raw, aligned - raw);
+            munmap(aligned + size, raw + padded - (aligned + size));
+            base = aligned;
+            madvise(base, size, MADV_HUGEPAGE);
+        }
+        if (home >= 0 && home < 63)
+        {
+            // MPOL_PREFERRED: the node's memory while it has some, before
+            // the first touch places a page anywhere else
+            const unsigned long mask = 1ul << home;
+            syscall(SYS_mbind, base, size, 1 /* MPOL_PREFERRED */, &mask, sizeof mask * 8, 0);
+        }
+#else
+        base = std::malloc(size);
+#endif
+        if (!base)
+            return false;
+        chunks.push_back({base, size, huge});
+        used = 0;
+        return true;
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef NUMA_ARENA_H
+#define NUMA_ARENA_H
+
+#include <cstddef> // For size_t
+#include <vector>  // For node and chunk lists
+
+// Memory placement for the batch tools on multi-socket machines: the
+// NUMA nodes with their processors, pinning a thread to one, and bump
+// arenas whose pages come from one node, in 2 MB huge pages where the
+// system has them. Without NUMA support everything is node 0.
+namespace numa
+{
+    struct Node
+    {
+        int id = 0;
+        std::vector<int> cpus; // Logical processors, empty if unknown
+    };
+
+    // Nodes that have processors, at least one
+    const std::vector<Node> &nodes();
+
+    // Keeps the calling thread on node's processors; false if it can't
+    bool bindThread(const Node &node);
+
+    // Bump allocator over chunks taken from one node. Nothing is freed
+    // until the arena goes, which suits machines kept for a worker's
+    // whole run. Chunks are huge-page sized and aligned so the kernel can
+    // map them with huge pages, explicitly (Linux hugetlbfs pages, Windows
+    // large pages) when some are free, else as transparent huge pages.
+    class Arena
+    {
+    public:
+        static constexpr size_t chunkSize = size_t(64) << 20;
+        static constexpr size_t hugePageSize = size_t(2) << 20;
+
+        explicit Arena(int node = -1); // -1 = wherever the thread runs
+        ~Arena();
+
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+
+        // nullptr if the system is out of memory
+        void *allocate(size_t size, size_t alignment);
+
+        size_t reserved() const;    // Bytes mapped
+        size_t hugeReserved() const; // Of those, in explicit huge pages
+        int node() const { return home; }
+
+    private:
+        struct Chunk
+        {
+            void *base;
+            size_t size;
+            bool huge;
+        };
+
+        bool addChunk(size_t minimum);
+
+        int home;
+        std::vector<Chunk> chunks;
+        size_t used = 0; // In the last chunk
+    };
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include "pc_sampler.h"
+#include "chip8_disasm.h"
+#include <algorithm> // For std::fill, std::min and std::partial_sort
+#include <cstdio>    // For std::snprintf
+
+PcSampler::PcSampler(size_t memorySize) : counts(memorySize, 0)
+{
+}
+
+int PcSampler::sampleOffset(int count)
+{
+    if (count <= 1)
+        return 0;
+    rng ^= rng << 13;
+    rng ^= rng >> 7;
+    rng ^= rng << 17;
+    return static_cast<int>(rng % static_cast<uint64_t>(count));
+}
+
+void PcSampler::reset()
+{
+    std::fill(counts.begin(), counts.end(), 0);
+    total = 0;
+}
+
+std::vector<std::pair<uint16_t, uint64_t>> PcSampler::hotAddresses(size_t n) const
+{
+    std::vector<std::pair<uint16_t, uint64_t>> hot;
+    for (size_t pc = 0; pc < counts.size(); ++pc)
+    {
+        if (counts[pc])
+            hot.push_back({static_cast<uint16_t>(pc), counts[pc]});
+    }
+    n = std::min(n, hot.size());
+    std::partial_sort(hot.begin(), hot.begin() + n, hot.end(), [](const auto &a, const auto &b)
+                      { return a.second > b.second; });
+    hot.resize(n);
+    return hot;
+}
+
+std::string PcSampler::listing(const uint8_t *memory, size_t topN) const
+{
+    std::string out;
+    char line[128];
+    std::snprintf(line, sizeof line, "%llu samples\n\naddress    samples      %%  instruction\n", static_cast<unsigned long long>(total));
+    out += line;
+    const size_t size = counts.size();
+    for (const auto &entry : hotAddresses(topN))
+    {
+        const size_t pc = entry.first;
+        auto word = [&](size_t addr)
+        { return static_cast<uint16_t>((memory[addr % size] << 8) | memory[(addr + 1) % size]); };
+        const uint16_t opcode = word(pc);
+        std::snprintf(line, sizeof line, "%04X   %11llu %6.2f  %04X  %s\n", entry.first, static_cast<unsigned long long>(entry.second),
+                      100.0 * entry.second / total, opcode, Chip8Disassembler::text(opcode, word(pc + 2)).c_str());
+        out += line;
+    }
+    return out;
+}
@@ -0,0 +1,49 @@
+#ifndef PC_SAMPLER_H
+#define PC_SAMPLER_H
+
+#include <cstddef> // For size_t
+#include <cstdint> // For the counters
+#include <string>  // For the listing
+#include <utility> // For std::pair
+#include <vector>  // For the histogram
+
+// Where the emulated PC stands at sampled instants, a histogram over every
+// address. The cheap sibling of Chip8Profile: no build flag and nothing in
+// the interpreter, so it can stay on in live play. The caller splits each
+// run of instructions once at sampleOffset() and records PC there, which
+// costs one extra call into the core and an increment per run. The offset
+// is random so a sample isn't always the frame's last instruction, and the
+// shares converge on the per-address instruction counts the full profiler
+// makes. Not thread-safe; the emulation thread records under its core lock.
+class PcSampler
+{
+public:
+    explicit PcSampler(size_t memorySize);
+
+    // Instruction of the next run of count at which to sample, 0..count-1
+    int sampleOffset(int count);
+    void record(uint16_t pc)
+    {
+        ++counts[pc % counts.size()];
+        ++total;
+    }
+
+    void reset();
+
+    uint64_t samples() const { return total; }
+    uint64_t samplesAt(uint16_t pc) const { return counts[pc % counts.size()]; }
+
+    // The n most sampled addresses, most sampled first
+    std::vector<std::pair<uint16_t, uint64_t>> hotAddresses(size_t n) const;
+
+    // Text table of the n most sampled addresses with their share of the
+    // samples and the instruction disassembled from memory
+    std::string listing(const uint8_t *memory, size_t topN = 20) const;
+
+private:
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    uint64_t rng = 0x9E3779B97F4A7C15; // xorshift64 state for the offsets
+};
+
+#endif
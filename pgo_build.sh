@@ -0,0 +1,138 @@
+#!/usr/bin/env bash
+# Profile-guided build: compiles the core instrumented, trains it on the
+# ROMs in roms/ through the headless runner (every ROM on its database
+# machine and speed) and the differential tester (which also runs the
+# server's Chip8Batch lanes), then compiles the core again with those
+# profiles and links chip8-headless, chip8-server and, under MSYS2,
+# chip8.exe from it with link-time optimization. The interpreter's
+# dispatch, DXYN and the batch lanes are laid out for the opcode mix real
+# ROMs run rather than the compiler's guesses.
+#
+#   ./pgo_build.sh [options]
+#     --roms DIR     training ROMs (default roms)
+#     --frames N     frames each training run lasts (default 3000)
+#     --out DIR      where the binaries and the objects go (default pgo)
+#     --no-gui       skip chip8.exe even where wxWidgets is available
+#
+# CXX and CXXFLAGS are honoured; the training profiles are only valid for
+# the compiler that wrote them.
+
+set -euo pipefail
+
+roms=roms
+frames=3000
+out=pgo
+gui=auto
+while [ $# -gt 0 ]; do
+    case "$1" in
+    --roms) roms="$2"; shift 2 ;;
+    --frames) frames="$2"; shift 2 ;;
+    --out) out="$2"; shift 2 ;;
+    --no-gui) gui=no; shift ;;
+    *)
+        echo "usage: ./pgo_build.sh [--roms DIR] [--frames N] [--out DIR] [--no-gui]" >&2
+        exit 1
+        ;;
+    esac
+done
+if [ "$gui" = auto ]; then
+    case "$(uname -s)" in
+    MINGW* | MSYS*) gui=yes ;;
+    *) gui=no ;;
+    esac
+fi
+
+CXX=${CXX:-g++}
+CXXFLAGS=${CXXFLAGS:-"-std=c++17 -O2"}
+exe=
+[ "$gui" = yes ] && exe=.exe
+
+# Everything the profiles cover. Each keeps one object path through both
+# compiles, since GCC finds a profile by the object it was written for.
+core="chip8.cpp chip8_jit.cpp chip8_aot.cpp chip8_simd.cpp chip8_batch.cpp rom_cache.cpp rom_archive.cpp"
+headless="headless.cpp megachip.cpp movie.cpp rom_database.cpp video_recorder.cpp trace_log.cpp chip8_coverage.cpp pc_sampler.cpp chip8_disasm.cpp"
+diff="core_diff.cpp thread_pool.cpp chip8_disasm.cpp"
+server="chip8_server.cpp stream_server.cpp sandbox_pool.cpp metrics.cpp session_store.cpp state_codec.cpp timer_wheel.cpp thread_pool.cpp rom_database.cpp"
+gui_sources="main.cpp emulation_thread.cpp emulation_scheduler.cpp thread_tuning.cpp audio_output.cpp frame_metrics.cpp gl_functions.cpp screen_renderer.cpp legacy_screen_renderer.cpp memory_map_renderer.cpp software_screen_renderer.cpp wall_renderer.cpp d3d11_screen_renderer.cpp netplay.cpp frame_share.cpp input_latency.cpp pc_sampler.cpp raw_keyboard.cpp gamepad.cpp video_recorder.cpp screenshot_writer.cpp rewind_buffer.cpp autosave.cpp event_log.cpp movie.cpp boot_cache.cpp settings_store.cpp speed_tuner.cpp rom_database.cpp rom_scanner.cpp rom_search.cpp rom_prefetch.cpp thread_pool.cpp chip8_profile.cpp chip8_debugger.cpp chip8_disasm.cpp cheat_engine.cpp"
+
+objects() # dir sources...
+{
+    local dir=$1
+    shift
+    for source in "$@"; do
+        printf '%s/%s.o ' "$dir" "${source%.cpp}"
+    done
+}
+
+compile() # dir flags sources...
+{
+    local dir=$1 flags=$2
+    shift 2
+    local pids=() pid
+    mkdir -p "$dir"
+    for source in "$@"; do
+        # shellcheck disable=SC2086
+        $CXX $CXXFLAGS $flags -c "$source" -o "$dir/${source%.cpp}.o" &
+        pids+=($!)
+    done
+    for pid in "${pids[@]}"; do
+        wait "$pid"
+    done
+}
+
+# 1. Instrumented core, and the two trainers built on it
+rm -rf "$out/core"
+echo "pgo: instrumenting"
+# shellcheck disable=SC2086
+compile "$out/core" "-fprofile-generate -fprofile-update=atomic" $core
+# shellcheck disable=SC2086
+compile "$out/train" "" $headless $diff
+# shellcheck disable=SC2046,SC2086
+$CXX $CXXFLAGS -fprofile-generate $(objects "$out/train" $headless) $(objects "$out/core" $core) -o "$out/train-headless" -lpthread -lz
+# shellcheck disable=SC2046,SC2086
+$CXX $CXXFLAGS -fprofile-generate $(objects "$out/train" $diff) $(objects "$out/core" $core) -o "$out/train-diff" -lpthread -lz
+
+# 2. Training: every ROM as the GUI would run it, then the batch lanes
+echo "pgo: training on $roms"
+trained=0
+for rom in "$roms"/*.ch8 "$roms"/*.sc8 "$roms"/*.xo8; do
+    [ -f "$rom" ] || continue
+    "$out/train-headless" --machine auto --frames "$frames" --quiet "$rom" >/dev/null || true
+    trained=$((trained + 1))
+done
+if [ "$trained" -eq 0 ]; then
+    echo "pgo: no ROMs in $roms" >&2
+    exit 1
+fi
+"$out/train-diff" --cores table,batch --frames "$frames" "$roms" >/dev/null || true
+
+# 3. The core again, laid out by the profiles; what training never ran is
+# optimized as it would be without them
+echo "pgo: optimizing with $trained ROMs' profiles"
+# shellcheck disable=SC2086
+compile "$out/core" "-fprofile-use -fprofile-partial-training -Wno-missing-profile -flto=auto" $core
+
+# 4. The binaries, with the rest of each program left unprofiled
+echo "pgo: linking"
+# shellcheck disable=SC2086
+compile "$out/headless" "-flto=auto" $headless
+# shellcheck disable=SC2046,SC2086
+$CXX $CXXFLAGS -flto=auto $(objects "$out/headless" $headless) $(objects "$out/core" $core) -o "$out/chip8-headless$exe" -lpthread -lz
+
+server_libs="-lpthread -lz"
+[ "$gui" = yes ] && server_libs="$server_libs -lws2_32"
+# shellcheck disable=SC2086
+compile "$out/server" "-flto=auto" $server
+# shellcheck disable=SC2046,SC2086
+$CXX $CXXFLAGS -flto=auto $(objects "$out/server" $server) $(objects "$out/core" $core) -o "$out/chip8-server$exe" $server_libs
+
+if [ "$gui" = yes ]; then
+    # shellcheck disable=SC2086
+    compile "$out/gui" "-flto=auto -D__WXMSW__ -Iinclude -Ilib/mswu" $gui_sources
+    # shellcheck disable=SC2046,SC2086
+    $CXX $CXXFLAGS -flto=auto -mwindows $(objects "$out/gui" $gui_sources) $(objects "$out/core" $core) app.res -o "$out/chip8.exe" \
+        -Llib -lwxmsw33u_gl -lwxmsw33u_core -lwxbase33u -lwxpng -lwxzlib \
+        -lSDL2 -lopengl32 -ld3d11 -ldxgi -ld3dcompiler -lws2_32 -lcomctl32 -lcomdlg32 -lole32 -loleaut32 -luuid \
+        -lwinspool -lgdi32 -luxtheme -loleacc -lshlwapi -lversion -lwinmm -lavrt -lpthread
+fi
+echo "pgo: done, binaries in $out/"
@@ -0,0 +1,49 @@
+#include "profile_zones.h"
+
+// Only the ETW backend needs code of its own: one TraceLogging provider
+// for the whole process. Events carry the zone name as a field and the
+// start/stop opcodes, so Windows Performance Analyzer pairs them into
+// regions per thread.
+#if defined(CHIP8_ETW) && defined(_WIN32)
+
+#include <windows.h>
+#include <TraceLoggingProvider.h>
+#include <winmeta.h> // For the start and stop opcodes
+#include <cstdlib>   // For std::atexit
+#include <mutex>     // For std::call_once
+
+// {5a1f0a8e-60c3-4f27-9d55-c8e2f0b7a3d1}
+TRACELOGGING_DEFINE_PROVIDER(chip8Provider, "Chip8Emulator",
+                             (0x5a1f0a8e, 0x60c3, 0x4f27, 0x9d, 0x55, 0xc8, 0xe2, 0xf0, 0xb7, 0xa3, 0xd1));
+
+namespace
+{
+    std::once_flag registered;
+
+    void ensureRegistered()
+    {
+        std::call_once(registered, []
+                       {
+                           TraceLoggingRegister(chip8Provider);
+                           std::atexit([] { TraceLoggingUnregister(chip8Provider); }); });
+    }
+}
+
+void profile_zones::begin(const char *name)
+{
+    ensureRegistered();
+    TraceLoggingWrite(chip8Provider, "Zone", TraceLoggingOpcode(WINEVENT_OPCODE_START), TraceLoggingString(name, "Name"));
+}
+
+void profile_zones::end(const char *name)
+{
+    TraceLoggingWrite(chip8Provider, "Zone", TraceLoggingOpcode(WINEVENT_OPCODE_STOP), TraceLoggingString(name, "Name"));
+}
+
+void profile_zones::frame()
+{
+    ensureRegistered();
+    TraceLoggingWrite(chip8Provider, "Frame");
+}
+
+#endif
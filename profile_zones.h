@@ -0,0 +1,88 @@
+#ifndef PROFILE_ZONES_H
+#define PROFILE_ZONES_H
+
+// Named zones for a sampling or tracing profiler, around the parts of a
+// frame worth seeing on a timeline: emulation, drawing, texture upload,
+// presenting, the audio callback, ROM loads and snapshots. Define one of
+//   CHIP8_TRACY  Tracy (build TracyClient.cpp alongside, see README)
+//   CHIP8_ITT    Intel ITT for VTune (link libittnotify)
+//   CHIP8_ETW    ETW TraceLogging start/stop events, Windows only (build
+//                profile_zones.cpp alongside)
+// Without any of them CHIP8_ZONE and CHIP8_FRAME_MARK expand to nothing,
+// so a normal build carries no trace of the profiler.
+//
+//   CHIP8_ZONE("Emulate frame"); // Until the end of the enclosing scope
+//   CHIP8_FRAME_MARK();          // One presented frame ends here
+
+#define CHIP8_ZONE_CAT2(a, b) a##b
+#define CHIP8_ZONE_CAT(a, b) CHIP8_ZONE_CAT2(a, b)
+
+#if defined(CHIP8_TRACY)
+
+#include <tracy/Tracy.hpp>
+
+#define CHIP8_ZONE(name) ZoneScopedN(name)
+#define CHIP8_FRAME_MARK() FrameMark
+
+#elif defined(CHIP8_ITT)
+
+#include <ittnotify.h>
+
+namespace profile_zones
+{
+    inline __itt_domain *domain()
+    {
+        static __itt_domain *const chip8 = __itt_domain_create("chip8");
+        return chip8;
+    }
+
+    class Zone
+    {
+    public:
+        explicit Zone(__itt_string_handle *name) { __itt_task_begin(domain(), __itt_null, __itt_null, name); }
+        ~Zone() { __itt_task_end(domain()); }
+        Zone(const Zone &) = delete;
+        Zone &operator=(const Zone &) = delete;
+    };
+}
+
+// The string handle is made once per site, the first time it runs
+#define CHIP8_ZONE(name)                                                                                          \
+    static __itt_string_handle *const CHIP8_ZONE_CAT(chip8ZoneName, __LINE__) = __itt_string_handle_create(name); \
+    profile_zones::Zone CHIP8_ZONE_CAT(chip8Zone, __LINE__)(CHIP8_ZONE_CAT(chip8ZoneName, __LINE__))
+#define CHIP8_FRAME_MARK() __itt_frame_end_v3(profile_zones::domain(), nullptr)
+
+#elif defined(CHIP8_ETW) && defined(_WIN32)
+
+namespace profile_zones
+{
+    // Start and stop events of the Chip8Emulator provider, which
+    // registers itself on first use; see profile_zones.cpp
+    void begin(const char *name);
+    void end(const char *name);
+    void frame();
+
+    class Zone
+    {
+    public:
+        explicit Zone(const char *zoneName) : name(zoneName) { begin(name); }
+        ~Zone() { end(name); }
+        Zone(const Zone &) = delete;
+        Zone &operator=(const Zone &) = delete;
+
+    private:
+        const char *name;
+    };
+}
+
+#define CHIP8_ZONE(name) profile_zones::Zone CHIP8_ZONE_CAT(chip8Zone, __LINE__)(name)
+#define CHIP8_FRAME_MARK() profile_zones::frame()
+
+#else
+
+#define CHIP8_ZONE(name) static_cast<void>(0)
+#define CHIP8_FRAME_MARK() static_cast<void>(0)
+
+#endif
+
+#endif
@@ -0,0 +1,135 @@
+#include "raw_keyboard.h"
+#include <algorithm> // For std::fill
+#include <iterator>  // For std::begin
+#include <utility>   // For std::move
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+RawKeyboard &RawKeyboard::shared()
+{
+    static RawKeyboard keyboard;
+    return keyboard;
+}
+
+RawKeyboard::~RawKeyboard()
+{
+#if defined(_WIN32)
+    if (thread.joinable())
+    {
+        PostThreadMessageW(threadId, WM_QUIT, 0, 0);
+        thread.join();
+    }
+#endif
+}
+
+uint32_t RawKeyboard::subscribe(void *window, Callback callback)
+{
+#if defined(_WIN32)
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!running)
+    {
+        // The thread owns the window raw input goes to, wait until it exists
+        std::promise<bool> started;
+        std::future<bool> result = started.get_future();
+        thread = std::thread([this, &started]
+                             { run(started); });
+        if (!result.get())
+        {
+            thread.join();
+            return 0;
+        }
+        running = true;
+    }
+    Subscriber &s = subscribers[nextId];
+    s.window = window;
+    s.callback = std::move(callback);
+    std::fill(std::begin(s.down), std::end(s.down), false);
+    return nextId++;
+#else
+    (void)window;
+    (void)callback;
+    return 0;
+#endif
+}
+
+void RawKeyboard::unsubscribe(uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    subscribers.erase(id);
+}
+
+// The input thread: a message-only window that never has the focus, so it
+// takes raw input as a sink, next to the usual key messages of the GUI
+void RawKeyboard::run(std::promise<bool> &started)
+{
+#if defined(_WIN32)
+    threadId = GetCurrentThreadId();
+    WNDCLASSEXW windowClass{};
+    windowClass.cbSize = sizeof windowClass;
+    windowClass.lpfnWndProc = DefWindowProcW;
+    windowClass.hInstance = GetModuleHandleW(nullptr);
+    windowClass.lpszClassName = L"Chip8RawKeyboard";
+    RegisterClassExW(&windowClass);
+    HWND window = CreateWindowExW(0, windowClass.lpszClassName, L"", 0, 0, 0, 0, 0, HWND_MESSAGE, nullptr,
+                                  windowClass.hInstance, nullptr);
+
+    RAWINPUTDEVICE device{};
+    device.usUsagePage = 0x01; // Generic desktop
+    device.usUsage = 0x06;     // Keyboard
+    device.dwFlags = RIDEV_INPUTSINK;
+    device.hwndTarget = window;
+    if (!window || !RegisterRawInputDevices(&device, 1, sizeof device))
+    {
+        if (window)
+            DestroyWindow(window);
+        started.set_value(false);
+        return;
+    }
+    started.set_value(true); // Gone from here on
+
+    MSG msg;
+    while (GetMessageW(&msg, nullptr, 0, 0) > 0)
+    {
+        if (msg.message == WM_INPUT)
+        {
+            RAWINPUT input;
+            UINT size = sizeof input;
+            if (GetRawInputData(reinterpret_cast<HRAWINPUT>(msg.lParam), RID_INPUT, &input, &size, sizeof(RAWINPUTHEADER)) != static_cast<UINT>(-1) &&
+                input.header.dwType == RIM_TYPEKEYBOARD && input.data.keyboard.VKey < 0xFF)
+                dispatch(input.data.keyboard.VKey, (input.data.keyboard.Flags & RI_KEY_BREAK) == 0);
+        }
+        DispatchMessageW(&msg); // WM_INPUT must reach DefWindowProc to be cleaned up
+    }
+
+    device.dwFlags = RIDEV_REMOVE;
+    device.hwndTarget = nullptr;
+    RegisterRawInputDevices(&device, 1, sizeof device);
+    DestroyWindow(window);
+#else
+    started.set_value(false);
+#endif
+}
+
+// One key from the input thread: a press goes to the subscriber whose
+// window is in the foreground unless it already holds the key (OS repeat),
+// a release to whoever holds it
+void RawKeyboard::dispatch(int virtualKey, bool pressed)
+{
+#if defined(_WIN32)
+    void *foreground = GetForegroundWindow();
+#else
+    void *foreground = nullptr;
+#endif
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &entry : subscribers)
+    {
+        Subscriber &s = entry.second;
+        if (pressed == s.down[virtualKey] || (pressed && s.window != foreground))
+            continue;
+        s.down[virtualKey] = pressed;
+        s.callback(virtualKey, pressed);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef RAW_KEYBOARD_H
+#define RAW_KEYBOARD_H
+
+#include <cstdint>    // For the subscription ids
+#include <functional> // For the key callbacks
+#include <future>     // For the startup handshake
+#include <map>        // For the subscribers
+#include <mutex>      // For subscribing while keys arrive
+#include <thread>     // For the input thread
+
+// Keyboard state straight from the OS (Windows Raw Input), independent of
+// which control has the keyboard focus and of key repeat. A process can
+// only register one raw keyboard target, so every window shares one input
+// thread, which hands each key to the subscriber whose window is in the
+// foreground. Key-ups still reach a window that lost the foreground, so no
+// key stays held. Elsewhere subscribe() always fails.
+class RawKeyboard
+{
+public:
+    // Virtual-key code (letters and digits are their upper-case ASCII)
+    // and whether it went down. Runs on the input thread.
+    using Callback = std::function<void(int virtualKey, bool pressed)>;
+
+    static RawKeyboard &shared();
+
+    ~RawKeyboard();
+
+    // Keys for the top-level window (an HWND), 0 if raw input isn't
+    // available. The thread starts with the first subscriber.
+    uint32_t subscribe(void *window, Callback callback);
+
+    // No callback of id runs once this returns
+    void unsubscribe(uint32_t id);
+
+private:
+    struct Subscriber
+    {
+        void *window;
+        Callback callback;
+        bool down[256];
+    };
+
+    RawKeyboard() = default;
+    void run(std::promise<bool> &started);
+    void dispatch(int virtualKey, bool pressed);
+
+    std::mutex mutex;
+    std::map<uint32_t, Subscriber> subscribers;
+    uint32_t nextId = 1;
+    std::thread thread;
+    bool running = false;       // Guarded by mutex
+    unsigned long threadId = 0; // Set by the thread before it reports startup
+};
+
+#endif
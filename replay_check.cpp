@@ -0,0 +1,248 @@
+// Replay checker: replays every recorded movie on the current core and
+// compares the state it ends in with the hash stored when it was recorded,
+// so a core change that alters behaviour shows up as the movies it breaks.
+// Movies are spread over all hardware threads, the longest first; each
+// finds its ROM among the ones given by the hash of the loaded image.
+//
+//   chip8-replay-check [options] <movie files or folders...>
+//     --roms DIR     where the movies' ROMs are (default roms), may repeat
+//     --core NAME    switch | table | predecoded | jit | aot | tiered
+//                    (default table)
+//     --threads N    worker threads (default: all hardware threads)
+//     --update       store the hash in movies recorded before there was
+//                    one, and keyframes in those without
+//     --quiet        list only the movies that failed
+
+#include "chip8.h"
+#include "movie.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>      // For std::istreambuf_iterator
+#include <string>
+#include <unordered_map> // For the ROMs by image hash
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    struct Options
+    {
+        std::vector<std::string> romDirs;
+        Chip8::Core core = Chip8::Core::Table;
+        unsigned threads = 0;
+        bool update = false;
+        bool quiet = false;
+    };
+
+    enum class Status
+    {
+        Ok,
+        Mismatch,  // Ended in another state than it was recorded to
+        NoHash,    // Recorded before movies kept one
+        Hashed,    // Had none, --update stored it
+        NoRom,     // None of the ROMs loads to its image
+        LoadFailed // Not a movie, or the update couldn't be written
+    };
+
+    struct Result
+    {
+        Status status = Status::LoadFailed;
+        uint64_t frames = 0;
+        uint64_t expected = 0;
+        uint64_t replayed = 0;
+    };
+
+    using RomMap = std::unordered_map<uint64_t, std::vector<uint8_t>>;
+
+    const struct
+    {
+        const char *name;
+        Chip8::Core core;
+    } coreNames[] = {{"switch", Chip8::Core::Switch}, {"table", Chip8::Core::Table}, {"predecoded", Chip8::Core::Predecoded},
+                     {"jit", Chip8::Core::Jit},       {"aot", Chip8::Core::Aot},     {"tiered", Chip8::Core::Tiered}};
+
+    bool readFile(const fs::path &path, std::vector<uint8_t> &out)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open())
+            return false;
+        out.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return true;
+    }
+
+    // Movies are only recorded on the classic machine, so only its ROMs
+    void collectRoms(const fs::path &dir, RomMap &roms)
+    {
+        std::error_code ec;
+        for (const fs::directory_entry &entry : fs::recursive_directory_iterator(dir, ec))
+        {
+            std::string ext = entry.path().extension().string();
+            std::vector<uint8_t> data;
+            if (!entry.is_regular_file() || (ext != ".ch8" && ext != ".rom") || !readFile(entry.path(), data))
+                continue;
+            Chip8 chip8;
+            if (chip8.loadROM(data.data(), data.size()))
+                roms.emplace(Movie::hashImage(chip8), std::move(data));
+        }
+    }
+
+    void collectMovies(const fs::path &path, std::vector<std::string> &movies)
+    {
+        std::error_code ec;
+        if (!fs::is_directory(path, ec))
+        {
+            movies.push_back(path.string());
+            return;
+        }
+        for (const fs::directory_entry &entry : fs::recursive_directory_iterator(path, ec))
+        {
+            if (entry.is_regular_file() && entry.path().extension() == ".c8mv")
+                movies.push_back(entry.path().string());
+        }
+    }
+
+    void checkMovie(const Options &opt, const RomMap &roms, const std::string &path, Result &result)
+    {
+        Movie movie;
+        if (!movie.load(path))
+            return;
+        result.frames = movie.frameCount;
+        result.expected = movie.endHash;
+        auto rom = roms.find(movie.imageHash);
+        if (rom == roms.end())
+        {
+            result.status = Status::NoRom;
+            return;
+        }
+
+        Chip8 chip8(opt.core);
+        if (!chip8.loadROM(rom->second.data(), rom->second.size()))
+            return;
+        const bool rewrite = opt.update && (movie.endHash == 0 || movie.keyframes.empty());
+        if (rewrite && movie.keyframes.empty())
+        {
+            movie.buildKeyframes(chip8);
+            chip8.runUntil(movie.endCycle);
+        }
+        else
+        {
+            movie.play(chip8);
+        }
+        result.replayed = chip8.stateHash();
+
+        if (movie.endHash != 0)
+            result.status = result.replayed == movie.endHash ? Status::Ok : Status::Mismatch;
+        else
+            result.status = opt.update ? Status::Hashed : Status::NoHash;
+        if (rewrite && result.status != Status::Mismatch)
+        {
+            movie.endHash = result.replayed;
+            if (!movie.save(path))
+                result.status = Status::LoadFailed;
+        }
+    }
+
+    void usage()
+    {
+        std::fprintf(stderr, "usage: chip8-replay-check [--roms DIR]... [--core NAME] [--threads N] [--update] [--quiet] "
+                             "<movie files or folders...>\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    std::vector<std::string> movies;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--roms" && hasValue)
+            opt.romDirs.push_back(argv[++i]);
+        else if (arg == "--threads" && hasValue)
+            opt.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (arg == "--update")
+            opt.update = true;
+        else if (arg == "--quiet")
+            opt.quiet = true;
+        else if (arg == "--core" && hasValue)
+        {
+            std::string name = argv[++i];
+            auto known = std::find_if(std::begin(coreNames), std::end(coreNames), [&](const auto &entry)
+                                      { return name == entry.name; });
+            if (known == std::end(coreNames))
+            {
+                usage();
+                return 1;
+            }
+            opt.core = known->core;
+        }
+        else if (arg[0] != '-')
+            collectMovies(arg, movies);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (movies.empty())
+    {
+        usage();
+        return 1;
+    }
+    if (opt.romDirs.empty())
+        opt.romDirs.push_back("roms");
+
+    RomMap roms;
+    for (const std::string &dir : opt.romDirs)
+        collectRoms(dir, roms);
+
+    // Longest first by file size, so no long movie starts last and runs alone
+    std::vector<uintmax_t> sizes(movies.size());
+    std::vector<size_t> order(movies.size());
+    for (size_t m = 0; m < movies.size(); ++m)
+    {
+        std::error_code ec;
+        sizes[m] = fs::file_size(movies[m], ec);
+        order[m] = m;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                     { return sizes[a] > sizes[b]; });
+
+    std::vector<Result> results(movies.size());
+    ThreadPool pool(opt.threads);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t m : order)
+        pool.submit([&, m]
+                    { checkMovie(opt, roms, movies[m], results[m]); });
+    pool.wait();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int counts[6] = {};
+    uint64_t frames = 0;
+    for (size_t m = 0; m < movies.size(); ++m)
+    {
+        const Result &result = results[m];
+        ++counts[static_cast<int>(result.status)];
+        frames += result.frames;
+        const bool failed = result.status == Status::Mismatch || result.status == Status::NoRom || result.status == Status::LoadFailed;
+        if (opt.quiet && !failed)
+            continue;
+        static const char *const names[] = {"ok", "MISMATCH", "no hash", "hashed", "NO ROM", "LOAD FAILED"};
+        std::printf("%-11s %s\n", names[static_cast<int>(result.status)], movies[m].c_str());
+        if (result.status == Status::Mismatch)
+            std::printf("            expected %016llx, replayed %016llx\n", static_cast<unsigned long long>(result.expected),
+                        static_cast<unsigned long long>(result.replayed));
+    }
+    std::printf("\n%zu movies (%llu frames) against %zu ROMs in %.3f s on %u threads\n", movies.size(),
+                static_cast<unsigned long long>(frames), roms.size(), wall, pool.size());
+    std::printf("%d ok, %d mismatched, %d without a hash, %d hashed, %d without their ROM, %d failed to load\n",
+                counts[0], counts[1], counts[2], counts[3], counts[4], counts[5]);
+    return (counts[1] || counts[4] || counts[5]) ? 1 : 0;
+}
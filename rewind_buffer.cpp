@@ -0,0 +1,178 @@
+#include "rewind_buffer.h"
+#include <cstring> // For std::memcpy
+
+namespace
+{
+    const size_t stateSize = sizeof(Chip8::Snapshot);
+
+    const uint8_t *bytesOf(const Chip8::Snapshot &s) { return reinterpret_cast<const uint8_t *>(&s); }
+    uint8_t *bytesOf(Chip8::Snapshot &s) { return reinterpret_cast<uint8_t *>(&s); }
+
+    void putCount(std::vector<uint8_t> &out, size_t value)
+    {
+        // 1 byte below 128, else 2 (snapshots are well under 32 KB)
+        if (value < 0x80)
+            out.push_back(static_cast<uint8_t>(value));
+        else
+        {
+            out.push_back(static_cast<uint8_t>(0x80 | (value >> 8)));
+            out.push_back(static_cast<uint8_t>(value & 0xFF));
+        }
+    }
+
+    size_t getCount(const uint8_t *&in)
+    {
+        size_t value = *in++;
+        if (value & 0x80)
+            value = ((value & 0x7F) << 8) | *in++;
+        return value;
+    }
+
+    // Appends cur XOR base as (zero run, literal length, literals) triples.
+    // Literals swallow zero gaps shorter than a triple header.
+    void encode(const uint8_t *cur, const uint8_t *base, std::vector<uint8_t> &out)
+    {
+        size_t i = 0;
+        while (i < stateSize)
+        {
+            size_t skip = i;
+            while (i < stateSize && cur[i] == base[i])
+                ++i;
+            if (i == stateSize)
+                break;
+            size_t start = i;
+            size_t end = i;
+            while (i < stateSize)
+            {
+                if (cur[i] != base[i])
+                    end = ++i;
+                else if (i - end < 3)
+                    ++i;
+                else
+                    break;
+            }
+            putCount(out, start - skip);
+            putCount(out, end - start);
+            for (size_t k = start; k < end; ++k)
+                out.push_back(cur[k] ^ base[k]);
+            i = end;
+        }
+    }
+
+    void decode(const uint8_t *in, const uint8_t *inEnd, uint8_t *state)
+    {
+        size_t pos = 0;
+        while (in < inEnd)
+        {
+            pos += getCount(in);
+            size_t count = getCount(in);
+            for (size_t k = 0; k < count; ++k)
+                state[pos++] ^= *in++;
+        }
+    }
+}
+
+RewindBuffer::RewindBuffer(size_t byteBudget, int keyframeInterval)
+    : budget(byteBudget), interval(keyframeInterval > 0 ? keyframeInterval : 1)
+{
+}
+
+void RewindBuffer::push(const Chip8::Snapshot &state)
+{
+    if (groups.empty() || groups.back().frameOffsets.size() >= static_cast<size_t>(interval))
+    {
+        Group group;
+        if (!spare.empty())
+        {
+            group = std::move(spare.back());
+            spare.pop_back();
+            group.data.clear();
+            group.frameOffsets.clear();
+        }
+        group.frameOffsets.push_back(0);
+        encode(bytesOf(state), bytesOf(boot), group.data);
+        std::memcpy(bytesOf(base), bytesOf(state), stateSize);
+        used += group.data.size();
+        groups.push_back(std::move(group));
+    }
+    else
+    {
+        Group &group = groups.back();
+        size_t before = group.data.size();
+        group.frameOffsets.push_back(before);
+        encode(bytesOf(state), bytesOf(base), group.data);
+        used += group.data.size() - before;
+    }
+    ++frameCount;
+
+    // Never drop the group being written
+    while (used > budget && groups.size() > 1)
+        evictOldest();
+}
+
+bool RewindBuffer::pop(Chip8::Snapshot &out)
+{
+    if (groups.empty())
+        return false;
+
+    Group &group = groups.back();
+    size_t frame = group.frameOffsets.size() - 1;
+    decodeFrame(group, frame, out);
+
+    size_t start = group.frameOffsets[frame];
+    used -= group.data.size() - start;
+    group.data.resize(start);
+    group.frameOffsets.pop_back();
+    --frameCount;
+    if (group.frameOffsets.empty())
+    {
+        recycle(std::move(group));
+        groups.pop_back();
+
+        // The next push may append deltas to the group now at the back
+        if (!groups.empty())
+            decodeFrame(groups.back(), 0, base);
+    }
+    return true;
+}
+
+void RewindBuffer::clear()
+{
+    while (!groups.empty())
+        evictOldest();
+}
+
+void RewindBuffer::setBoot(const Chip8::Snapshot &state)
+{
+    clear();
+    std::memcpy(bytesOf(boot), bytesOf(state), stateSize);
+}
+
+void RewindBuffer::decodeFrame(const Group &group, size_t frame, Chip8::Snapshot &out) const
+{
+    const uint8_t *data = group.data.data();
+    size_t keyEnd = group.frameOffsets.size() > 1 ? group.frameOffsets[1] : group.data.size();
+
+    std::memcpy(bytesOf(out), bytesOf(boot), stateSize);
+    decode(data, data + keyEnd, bytesOf(out));
+    if (frame > 0)
+    {
+        size_t end = frame + 1 < group.frameOffsets.size() ? group.frameOffsets[frame + 1] : group.data.size();
+        decode(data + group.frameOffsets[frame], data + end, bytesOf(out));
+    }
+}
+
+void RewindBuffer::evictOldest()
+{
+    Group &group = groups.front();
+    used -= group.data.size();
+    frameCount -= group.frameOffsets.size();
+    recycle(std::move(group));
+    groups.pop_front();
+}
+
+void RewindBuffer::recycle(Group &&group)
+{
+    if (spare.size() < 2)
+        spare.push_back(std::move(group));
+}
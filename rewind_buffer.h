@@ -0,0 +1,57 @@
+#ifndef REWIND_BUFFER_H
+#define REWIND_BUFFER_H
+
+#include "chip8.h"
+#include <cstddef> // For size_t
+#include <cstdint> // For uint8_t
+#include <deque>   // For the group ring
+#include <vector>  // For encoded frames
+
+// Bounded history of machine snapshots for rewinding. Frames are grouped
+// behind a keyframe; each frame is stored as the run-length encoded XOR
+// against its group's keyframe, and keyframes are encoded against the
+// boot state (zero until setBoot), so the ROM and the font cancel out of
+// them too. Most of memory doesn't change between frames, so a frame
+// usually costs tens of bytes and a keyframe a few hundred. When the byte
+// budget is exceeded the oldest group goes.
+class RewindBuffer
+{
+public:
+    explicit RewindBuffer(size_t byteBudget = 1 << 20, int keyframeInterval = 60);
+
+    void push(const Chip8::Snapshot &state);
+
+    // Removes the newest frame into out, false when the history is empty
+    bool pop(Chip8::Snapshot &out);
+
+    void clear();
+
+    // Clears the history and encodes keyframes against state from now on,
+    // the machine just after its ROM loaded
+    void setBoot(const Chip8::Snapshot &state);
+
+    size_t frames() const { return frameCount; }
+    size_t bytesUsed() const { return used; }
+
+private:
+    struct Group
+    {
+        std::vector<uint8_t> data;        // Encoded keyframe then encoded deltas
+        std::vector<size_t> frameOffsets; // Start of each frame in data, [0] = keyframe
+    };
+
+    void decodeFrame(const Group &group, size_t frame, Chip8::Snapshot &out) const;
+    void evictOldest();
+    void recycle(Group &&group);
+
+    std::deque<Group> groups;
+    std::vector<Group> spare; // A few evicted groups, reused to keep their capacity
+    Chip8::Snapshot base{};   // Decoded keyframe of the newest group
+    Chip8::Snapshot boot{};   // What keyframes are encoded against
+    size_t budget;
+    int interval;
+    size_t used = 0;
+    size_t frameCount = 0;
+};
+
+#endif
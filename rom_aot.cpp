@@ -0,0 +1,291 @@
+// Ahead-of-time translator: turns a ROM's static control-flow graph into
+// C++, one function per basic block, for Chip8Aot to run. Compile the
+// output into the program together with chip8_aot.cpp and create the
+// machine with Core::Aot; loading the exact ROM then runs the translation.
+//
+//   chip8-aot [options] <rom file>
+//     --name NAME   program name in the output (default the file name)
+//     --out FILE    write the C++ there instead of stdout
+
+#include "chip8_cfg.h"
+#include "chip8_disasm.h"
+#include "rom_cache.h"
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+namespace
+{
+    void usage()
+    {
+        std::fprintf(stderr, "usage: chip8-aot [--name NAME] [--out FILE] <rom file>\n");
+    }
+
+    std::string hex(unsigned value, int digits)
+    {
+        char text[16];
+        std::snprintf(text, sizeof text, "0x%0*X", digits, value);
+        return text;
+    }
+
+    // Name and file name can come from anywhere, keep them a plain comment
+    // and string literal
+    std::string printable(const std::string &text, bool quoted)
+    {
+        std::string out;
+        for (char c : text)
+        {
+            if (c < 0x20 || c > 0x7E || (quoted && (c == '"' || c == '\\')))
+                out += '_';
+            else
+                out += c;
+        }
+        return out;
+    }
+
+    // C++ for one instruction of a block, the last one of a block always
+    // leaves it. FX0A leaves early, the rest of its block is dead code.
+    void translate(std::ostream &out, const uint8_t *rom, uint16_t pc, int count, bool last)
+    {
+        const uint16_t opcode = static_cast<uint16_t>((rom[pc - 0x200] << 8) | rom[pc - 0x200 + 1]);
+        const unsigned x = (opcode >> 8) & 0xF;
+        const unsigned y = (opcode >> 4) & 0xF;
+        const std::string vx = "V[" + std::to_string(x) + "]";
+        const std::string vy = "V[" + std::to_string(y) + "]";
+        const std::string nn = hex(opcode & 0xFF, 2);
+        const std::string next = hex(pc + 2u, 3);
+        const std::string skip = hex(pc + 4u, 3);
+        const std::string leave = " return " + std::to_string(count) + ";";
+        const std::string helper = "m.op(" + hex(opcode, 4) + ", " + next + ");";
+
+        std::ostringstream code;
+        bool left = false;
+        switch (opcode & 0xF000)
+        {
+        case 0x1000:
+            code << "m.PC = " << hex(opcode & 0xFFF, 3) << ";" << leave;
+            left = true;
+            break;
+        case 0x3000:
+        case 0x4000:
+            code << "m.PC = " << vx << ((opcode & 0xF000) == 0x3000 ? " == " : " != ") << nn << " ? " << skip << " : " << next << ";" << leave;
+            left = true;
+            break;
+        case 0x5000:
+        case 0x9000:
+            code << "m.PC = " << vx << ((opcode & 0xF000) == 0x5000 ? " == " : " != ") << vy << " ? " << skip << " : " << next << ";" << leave;
+            left = true;
+            break;
+        case 0x6000:
+            code << vx << " = " << nn << ";";
+            break;
+        case 0x7000:
+            code << vx << " += " << nn << ";";
+            break;
+        case 0x8000:
+            switch (opcode & 0xF)
+            {
+            case 0x0:
+                code << vx << " = " << vy << ";";
+                break;
+            case 0x1:
+                code << vx << " |= " << vy << ";";
+                break;
+            case 0x2:
+                code << vx << " &= " << vy << ";";
+                break;
+            case 0x3:
+                code << vx << " ^= " << vy << ";";
+                break;
+            case 0x4:
+                code << "{ unsigned sum = " << vx << " + " << vy << "; " << vx << " = sum & 0xFF; V[15] = sum > 0xFF; }";
+                break;
+            case 0x5:
+                code << "{ uint8_t flag = " << vx << " >= " << vy << "; " << vx << " -= " << vy << "; V[15] = flag; }";
+                break;
+            case 0x6:
+                code << "{ uint8_t flag = " << vx << " & 1; " << vx << " >>= 1; V[15] = flag; }";
+                break;
+            case 0x7:
+                code << "{ uint8_t flag = " << vy << " >= " << vx << "; " << vx << " = " << vy << " - " << vx << "; V[15] = flag; }";
+                break;
+            case 0xE:
+                code << "{ uint8_t flag = " << vx << " >> 7; " << vx << " <<= 1; V[15] = flag; }";
+                break;
+            }
+            break;
+        case 0xA000:
+            code << "m.I = " << hex(opcode & 0xFFF, 3) << ";";
+            break;
+        case 0xF000:
+            switch (opcode & 0xFF)
+            {
+            case 0x07:
+                code << vx << " = m.delay();";
+                break;
+            case 0x15:
+                code << "m.setDelay(" << vx << ");";
+                break;
+            case 0x18:
+                code << "m.setSound(" << vx << ");";
+                break;
+            case 0x1E:
+                code << "m.I += " << vx << ";";
+                break;
+            case 0x29:
+                code << "m.I = 0x050 + (" << vx << " & 0xF) * 5;";
+                break;
+            case 0x0A: // Halts until a key
+                code << helper << leave;
+                left = true;
+                break;
+            case 0x33: // Stores can hit translated code
+            case 0x55:
+                code << helper << " if (m.written)" << leave;
+                break;
+            default:
+                code << helper;
+                break;
+            }
+            break;
+        default:
+            code << helper;
+            // Calls, returns, BNNN and the key skips set PC themselves
+            if (opcode == 0x00EE || (opcode & 0xF000) == 0x2000 || (opcode & 0xF000) == 0xB000 || (opcode & 0xF000) == 0xE000)
+            {
+                code << leave;
+                left = true;
+            }
+            break;
+        }
+
+        // The listing as a comment keeps the generated code readable
+        std::string line = code.str();
+        out << "        " << line << std::string(line.size() < 56 ? 56 - line.size() : 1, ' ') << "// "
+            << hex(pc, 3).substr(2) << "  " << Chip8Disassembler::text(opcode) << "\n";
+        if (last && !left)
+            out << "        m.PC = " << next << ";" << leave << "\n";
+    }
+
+    bool usesRegisters(const uint8_t *rom, const Chip8Cfg::Block &block)
+    {
+        for (uint16_t pc = block.start; pc < block.end; pc += 2)
+        {
+            const uint16_t opcode = static_cast<uint16_t>((rom[pc - 0x200] << 8) | rom[pc - 0x200 + 1]);
+            switch (opcode & 0xF000)
+            {
+            case 0x3000:
+            case 0x4000:
+            case 0x5000:
+            case 0x6000:
+            case 0x7000:
+            case 0x8000:
+            case 0x9000:
+                return true;
+            case 0xF000:
+                if ((opcode & 0xFF) == 0x07 || (opcode & 0xFF) == 0x15 || (opcode & 0xFF) == 0x18 ||
+                    (opcode & 0xFF) == 0x1E || (opcode & 0xFF) == 0x29)
+                    return true;
+            }
+        }
+        return false;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::string rom, name, outPath;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--name" && hasValue)
+            name = argv[++i];
+        else if (arg == "--out" && hasValue)
+            outPath = argv[++i];
+        else if (arg[0] != '-' && rom.empty())
+            rom = arg;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (rom.empty())
+    {
+        usage();
+        return 1;
+    }
+
+    std::shared_ptr<const RomCache::Image> image = RomCache::shared().get(rom);
+    if (!image || image->size() == 0 || image->size() > 4096 - 0x200)
+    {
+        std::fprintf(stderr, "can't read %s as a CHIP-8 ROM\n", rom.c_str());
+        return 1;
+    }
+    if (name.empty())
+        name = std::filesystem::path(rom).stem().string();
+
+    // The translation is for the classic machine, so F000 NNNN is 2 bytes
+    const uint8_t *bytes = image->data();
+    Chip8Cfg cfg;
+    cfg.build(bytes, image->size());
+
+    std::ostringstream out;
+    out << "// Translated by chip8-aot from " << printable(std::filesystem::path(rom).filename().string(), false)
+        << ", don't edit.\n"
+        << "// " << cfg.getBlocks().size() << " blocks; " << cfg.getComputedJumps().size()
+        << " computed jumps and any code they reach run on the interpreter.\n\n"
+        << "#include \"chip8_aot.h\"\n\n"
+        << "namespace\n{\n"
+        << "    const uint8_t rom[" << image->size() << "] = {";
+    for (size_t i = 0; i < image->size(); ++i)
+        out << (i % 12 == 0 ? "\n        " : " ") << hex(bytes[i], 2) << ",";
+    out << "\n    };\n";
+
+    for (const Chip8Cfg::Block &block : cfg.getBlocks())
+    {
+        out << "\n    int b" << hex(block.start, 3).substr(2) << "(Chip8Aot &m)\n    {\n";
+        if (usesRegisters(bytes, block))
+            out << "        uint8_t *const V = m.V;\n";
+        int count = 0;
+        for (uint16_t pc = block.start; pc < block.end; pc += 2)
+        {
+            ++count;
+            translate(out, bytes, pc, count, pc + 2 >= block.end);
+        }
+        out << "    }\n";
+    }
+
+    out << "\n    const Chip8Aot::Block blocks[] = {\n";
+    for (const Chip8Cfg::Block &block : cfg.getBlocks())
+    {
+        const uint16_t first = static_cast<uint16_t>((bytes[block.start - 0x200] << 8) | bytes[block.start - 0x200 + 1]);
+        const bool idle = (first & 0xF000) == 0x1000 || (first & 0xF000) == 0xD000 || (first & 0xF0FF) == 0xF007;
+        out << "        {" << hex(block.start, 3) << ", " << hex(block.end, 3) << ", " << block.instructions << ", "
+            << (idle ? "true" : "false") << ", &b" << hex(block.start, 3).substr(2) << "},\n";
+    }
+    out << "    };\n\n"
+        << "    const Chip8Aot::Program program = {\"" << printable(name, true) << "\", rom, sizeof rom, blocks, "
+        << "sizeof blocks / sizeof blocks[0]};\n"
+        << "    const Chip8Aot::Registration registration(program);\n"
+        << "}\n";
+
+    if (outPath.empty())
+    {
+        std::cout << out.str();
+        return 0;
+    }
+    std::ofstream file(outPath);
+    file << out.str();
+    if (!file)
+    {
+        std::fprintf(stderr, "can't write %s\n", outPath.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "rom_archive.h"
+#include <algorithm> // For std::min
+#include <cctype>    // For std::tolower
+#include <climits>   // For UINT_MAX
+#include <filesystem>
+#include <zlib.h>
+
+namespace
+{
+    const uint32_t localSignature = 0x04034b50;
+    const uint32_t centralSignature = 0x02014b50;
+    const uint32_t endSignature = 0x06054b50;
+    const size_t endSize = 22;
+    const size_t centralSize = 46;
+    const size_t localSize = 30;
+
+    uint16_t read16(const uint8_t *p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+    uint32_t read32(const uint8_t *p) { return read16(p) | static_cast<uint32_t>(read16(p + 2)) << 16; }
+
+    bool endsWithNoCase(const std::string &text, const char *suffix)
+    {
+        size_t n = std::char_traits<char>::length(suffix);
+        if (text.size() < n)
+            return false;
+        for (size_t i = 0; i < n; ++i)
+        {
+            if (std::tolower(static_cast<unsigned char>(text[text.size() - n + i])) != suffix[i])
+                return false;
+        }
+        return true;
+    }
+}
+
+std::shared_ptr<const RomArchive> RomArchive::open(std::shared_ptr<const RomCache::Image> zip)
+{
+    if (!zip || zip->size() < endSize)
+        return nullptr;
+    const uint8_t *bytes = zip->data();
+    const size_t length = zip->size();
+
+    // The end record sits behind a comment of up to 64 KB
+    size_t end = length - endSize + 1;
+    const size_t lowest = length - std::min(length, endSize + 0xFFFF);
+    do
+    {
+        --end;
+        if (read32(bytes + end) == endSignature)
+            break;
+    } while (end > lowest);
+    if (read32(bytes + end) != endSignature || read16(bytes + end + 4) != 0 || read16(bytes + end + 6) != 0)
+        return nullptr;
+
+    const size_t count = read16(bytes + end + 10);
+    size_t at = read32(bytes + end + 16);
+    const size_t directoryEnd = at + read32(bytes + end + 12);
+    if (directoryEnd > end)
+        return nullptr;
+
+    std::shared_ptr<RomArchive> archive(new RomArchive());
+    archive->list.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        if (at + centralSize > directoryEnd || read32(bytes + at) != centralSignature)
+            return nullptr;
+        const uint8_t *header = bytes + at;
+        const size_t nameLength = read16(header + 28);
+        const size_t next = at + centralSize + nameLength + read16(header + 30) + read16(header + 32);
+        if (next > directoryEnd)
+            return nullptr;
+
+        Member member;
+        member.name.assign(reinterpret_cast<const char *>(header + centralSize), nameLength);
+        member.method = read16(header + 10);
+        member.crc = read32(header + 16);
+        member.compressedSize = read32(header + 20);
+        member.size = read32(header + 24);
+        member.headerOffset = read32(header + 42);
+        const bool encrypted = read16(header + 8) & 1;
+        const bool folder = !member.name.empty() && member.name.back() == '/';
+        if (!encrypted && !folder && (member.method == 0 || member.method == 8) && member.size <= maxMemberSize)
+        {
+            archive->byName.emplace(member.name, archive->list.size());
+            archive->list.push_back(std::move(member));
+        }
+        at = next;
+    }
+    archive->zip = std::move(zip);
+    return archive;
+}
+
+bool RomArchive::splitPath(const std::string &path, std::string &archive, std::string &member)
+{
+    for (size_t at = path.find('.'); at != std::string::npos; at = path.find('.', at + 1))
+    {
+        const size_t end = at + 4;
+        if (end > path.size() || !endsWithNoCase(path.substr(0, end), ".zip"))
+            continue;
+        if (end < path.size() && path[end] != '/' && path[end] != '\\')
+            continue;
+        std::error_code ec;
+        if (!std::filesystem::is_regular_file(std::filesystem::u8path(path.substr(0, end)), ec))
+            continue;
+        archive = path.substr(0, end);
+        member = end < path.size() ? path.substr(end + 1) : std::string();
+        for (char &c : member)
+        {
+            if (c == '\\')
+                c = '/';
+        }
+        return true;
+    }
+    return false;
+}
+
+const RomArchive::Member *RomArchive::find(const std::string &name) const
+{
+    auto found = byName.find(name);
+    return found == byName.end() ? nullptr : &list[found->second];
+}
+
+const RomArchive::Member *RomArchive::firstRom() const
+{
+    for (const Member &member : list)
+    {
+        if (endsWithNoCase(member.name, ".ch8") || endsWithNoCase(member.name, ".rom"))
+            return &member;
+    }
+    return nullptr;
+}
+
+bool RomArchive::extract(const Member &member, uint8_t *out) const
+{
+    const uint8_t *bytes = zip->data();
+    const size_t length = zip->size();
+    if (member.headerOffset + localSize > length || read32(bytes + member.headerOffset) != localSignature)
+        return false;
+    const size_t start = member.headerOffset + localSize + read16(bytes + member.headerOffset + 26) +
+                         read16(bytes + member.headerOffset + 28);
+    if (start > length || member.compressedSize > length - start || member.size > UINT_MAX)
+        return false;
+    const uint8_t *data = bytes + start;
+
+    if (member.method == 0)
+    {
+        if (member.compressedSize != member.size)
+            return false;
+        std::copy(data, data + member.size, out);
+    }
+    else
+    {
+        // Raw deflate, no zlib header
+        z_stream stream{};
+        if (inflateInit2(&stream, -MAX_WBITS) != Z_OK)
+            return false;
+        stream.next_in = const_cast<Bytef *>(data);
+        stream.avail_in = static_cast<uInt>(member.compressedSize);
+        stream.next_out = out;
+        stream.avail_out = static_cast<uInt>(member.size);
+        const int status = inflate(&stream, Z_FINISH);
+        const size_t produced = stream.total_out;
+        inflateEnd(&stream);
+        if (status != Z_STREAM_END || produced != member.size)
+            return false;
+    }
+    return crc32(0, out, static_cast<uInt>(member.size)) == member.crc;
+}
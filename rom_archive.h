@@ -0,0 +1,65 @@
+#ifndef ROM_ARCHIVE_H
+#define ROM_ARCHIVE_H
+
+#include "rom_cache.h"
+#include <cstddef>       // For size_t
+#include <cstdint>       // For zip fields
+#include <memory>        // For the archive's bytes
+#include <string>        // For member names
+#include <unordered_map> // For members by name
+#include <vector>        // For the member list
+
+// Index of a zip file's members, built from its central directory in one
+// pass over the archive's cached bytes. Members are decompressed on demand
+// with zlib, straight into the caller's buffer. Stored and deflated members
+// only; no zip64, encryption or multi-disk archives. Members bigger than
+// maxMemberSize are left out, since callers allocate a member's size as
+// the directory gives it before inflating.
+//
+// A member is named by a path through the archive, "pack.zip/Game.ch8",
+// which RomCache::get() resolves like any other ROM file.
+class RomArchive
+{
+public:
+    // The most memory any machine loads a ROM into, MEGA-CHIP's 16 MB
+    static constexpr size_t maxMemberSize = 0x1000000;
+
+    struct Member
+    {
+        std::string name; // Path inside the archive, '/' separated
+        uint16_t method;  // 0 stored, 8 deflated
+        uint32_t crc;
+        size_t compressedSize;
+        size_t size;
+        size_t headerOffset; // Of the member's local header
+    };
+
+    // nullptr unless zip is a readable zip archive
+    static std::shared_ptr<const RomArchive> open(std::shared_ptr<const RomCache::Image> zip);
+
+    // Splits a path into the archive file and the member path after it.
+    // False unless some prefix ending in ".zip" is a file; member is empty
+    // for the archive itself.
+    static bool splitPath(const std::string &path, std::string &archive, std::string &member);
+
+    const std::vector<Member> &members() const { return list; }
+
+    // nullptr if there is no such member
+    const Member *find(const std::string &name) const;
+
+    // The first .ch8 or .rom member, for opening an archive as a ROM
+    const Member *firstRom() const;
+
+    // Decompresses member into out, member.size bytes. False if it is
+    // damaged or compressed some other way. Safe from several threads.
+    bool extract(const Member &member, uint8_t *out) const;
+
+private:
+    RomArchive() = default;
+
+    std::shared_ptr<const RomCache::Image> zip;
+    std::vector<Member> list;
+    std::unordered_map<std::string, size_t> byName; // Into list
+};
+
+#endif
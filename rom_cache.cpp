@@ -0,0 +1,219 @@
+#include "rom_cache.h"
+#include "rom_archive.h"
+#include "profile_zones.h"
+#include <fstream>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+RomCache::Image::~Image()
+{
+    if (!mapped)
+        return;
+#if defined(_WIN32)
+    UnmapViewOfFile(bytes);
+#else
+    munmap(const_cast<uint8_t *>(bytes), length);
+#endif
+}
+
+RomCache::~RomCache()
+{
+    {
+        std::lock_guard<std::mutex> lock(ioMutex);
+        ioStopping = true;
+    }
+    ioWake.notify_all();
+    if (ioThread.joinable())
+        ioThread.join();
+}
+
+RomCache &RomCache::shared()
+{
+    static RomCache cache;
+    return cache;
+}
+
+std::shared_ptr<const RomCache::Image> RomCache::get(const std::string &path)
+{
+    CHIP8_ZONE("ROM read");
+    std::string archivePath, member;
+    if (RomArchive::splitPath(path, archivePath, member))
+        return getMember(archivePath, member, path);
+    return getFile(path);
+}
+
+std::shared_ptr<const RomArchive> RomCache::archive(const std::string &path)
+{
+    std::shared_ptr<const Image> zip = getFile(path);
+    if (!zip)
+        return nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = archives.find(path);
+        if (it != archives.end() && it->second.zip == zip)
+            return it->second.index;
+    }
+    // Indexed outside the lock; two threads racing here both get a valid index
+    std::shared_ptr<const RomArchive> index = RomArchive::open(zip);
+    std::lock_guard<std::mutex> lock(mutex);
+    archives[path] = {zip, index};
+    return index;
+}
+
+// Cached by the whole path, against the archive's size and time
+std::shared_ptr<const RomCache::Image> RomCache::getMember(const std::string &archivePath, const std::string &member,
+                                                           const std::string &path)
+{
+    std::shared_ptr<const RomArchive> index = archive(archivePath);
+    if (!index)
+        return nullptr;
+    std::error_code ec;
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(archivePath, ec);
+    if (ec)
+        return nullptr;
+    uintmax_t size = std::filesystem::file_size(archivePath, ec);
+    if (ec)
+        return nullptr;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = members.find(path);
+        if (it != members.end() && it->second.modified == modified && it->second.size == size)
+            return it->second.image;
+    }
+
+    const RomArchive::Member *found = member.empty() ? index->firstRom() : index->find(member);
+    if (!found)
+        return nullptr;
+    std::shared_ptr<Image> image(new Image());
+    image->length = found->size;
+    image->copy.reset(new uint8_t[found->size ? found->size : 1]);
+    if (!index->extract(*found, image->copy.get()))
+        return nullptr;
+    image->bytes = image->copy.get();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    members[path] = {modified, size, image};
+    return image;
+}
+
+std::shared_ptr<const RomCache::Image> RomCache::getFile(const std::string &path)
+{
+    std::error_code ec;
+    std::filesystem::file_time_type modified = std::filesystem::last_write_time(path, ec);
+    if (ec)
+        return nullptr;
+    uintmax_t size = std::filesystem::file_size(path, ec);
+    if (ec)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto it = entries.find(path);
+    if (it != entries.end() && it->second.modified == modified && it->second.size == size)
+        return it->second.image;
+
+    // New or changed on disk: older images stay valid for whoever still holds them
+    std::shared_ptr<const Image> image = open(path, size);
+    if (!image)
+        return nullptr;
+    entries[path] = {modified, size, image};
+    return image;
+}
+
+void RomCache::getAsync(const std::string &path, Completion done)
+{
+    {
+        std::lock_guard<std::mutex> lock(ioMutex);
+        reads.push_back({path, std::move(done)});
+        if (!ioThread.joinable())
+            ioThread = std::thread(&RomCache::ioLoop, this);
+    }
+    ioWake.notify_one();
+}
+
+// Reads still queued at shutdown are dropped without a callback
+void RomCache::ioLoop()
+{
+    std::unique_lock<std::mutex> lock(ioMutex);
+    for (;;)
+    {
+        ioWake.wait(lock, [this]
+                    { return ioStopping || !reads.empty(); });
+        if (ioStopping)
+            return;
+        Read read = std::move(reads.front());
+        reads.pop_front();
+        lock.unlock();
+
+        std::shared_ptr<const Image> image = get(read.path);
+        if (image)
+        {
+            // A mapped image is only read from disk when touched
+            volatile uint8_t sink = 0;
+            for (size_t at = 0; at < image->size(); at += 4096)
+                sink = sink + image->data()[at];
+        }
+        read.done(std::move(image));
+        lock.lock();
+    }
+}
+
+void RomCache::clear()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    entries.clear();
+    archives.clear();
+    members.clear();
+}
+
+std::shared_ptr<const RomCache::Image> RomCache::open(const std::string &path, uintmax_t size)
+{
+    std::shared_ptr<Image> image(new Image());
+    image->length = static_cast<size_t>(size);
+    if (size == 0)
+        return image;
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file != INVALID_HANDLE_VALUE)
+    {
+        HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+        {
+            // The view keeps the mapping alive after both handles close
+            image->bytes = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+            CloseHandle(mapping);
+        }
+        CloseHandle(file);
+    }
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0)
+    {
+        void *view = mmap(nullptr, image->length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED)
+            image->bytes = static_cast<const uint8_t *>(view);
+        close(fd);
+    }
+#endif
+    if (image->bytes)
+    {
+        image->mapped = true;
+        return image;
+    }
+
+    // Mapping unavailable: keep a private copy instead
+    std::ifstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return nullptr;
+    image->copy.reset(new uint8_t[image->length]);
+    if (!file.read(reinterpret_cast<char *>(image->copy.get()), image->length))
+        return nullptr;
+    image->bytes = image->copy.get();
+    return image;
+}
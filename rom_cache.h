@@ -0,0 +1,109 @@
+#ifndef ROM_CACHE_H
+#define ROM_CACHE_H
+
+#include <condition_variable> // For the idle I/O thread
+#include <cstddef>            // For size_t
+#include <cstdint>            // For uint8_t
+#include <deque>              // For queued reads
+#include <filesystem>         // For file times
+#include <functional>         // For read completions
+#include <memory>             // For std::shared_ptr
+#include <mutex>              // For the entry map lock
+#include <string>             // For paths
+#include <thread>             // For the I/O thread
+#include <unordered_map>      // For the entry map
+
+class RomArchive;
+
+// Process-wide cache of ROM files. Each file version (path, size and
+// modification time) is memory-mapped read-only once and shared, so
+// loading or resetting a ROM only costs a stat and a copy into memory.
+// Paths may run into zip archives, see RomArchive: a member is inflated
+// once per archive version and cached like a file.
+class RomCache
+{
+public:
+    // Read-only bytes of one ROM file version
+    class Image
+    {
+    public:
+        ~Image();
+        Image(const Image &) = delete;
+        Image &operator=(const Image &) = delete;
+
+        const uint8_t *data() const { return bytes; }
+        size_t size() const { return length; }
+
+    private:
+        friend class RomCache;
+        Image() = default;
+
+        const uint8_t *bytes = nullptr;
+        size_t length = 0;
+        bool mapped = false;
+        std::unique_ptr<uint8_t[]> copy; // Used when the file can't be mapped
+    };
+
+    using Completion = std::function<void(std::shared_ptr<const Image>)>;
+
+    RomCache() = default;
+    ~RomCache();
+    RomCache(const RomCache &) = delete;
+    RomCache &operator=(const RomCache &) = delete;
+
+    static RomCache &shared();
+
+    // nullptr if the file can't be read. A path naming an archive itself
+    // gets its first ROM.
+    std::shared_ptr<const Image> get(const std::string &path);
+
+    // The member index of a zip file, read once per archive version;
+    // nullptr if it isn't one
+    std::shared_ptr<const RomArchive> archive(const std::string &path);
+
+    // get() on the cache's I/O thread, which also faults in every page of
+    // the image so copying it later doesn't wait on the disk, then done
+    // with the result on that thread. Reads run one at a time, in order.
+    void getAsync(const std::string &path, Completion done);
+
+    void clear();
+
+private:
+    struct Entry
+    {
+        std::filesystem::file_time_type modified;
+        uintmax_t size;
+        std::shared_ptr<const Image> image;
+    };
+
+    struct Read
+    {
+        std::string path;
+        Completion done;
+    };
+
+    struct ArchiveEntry
+    {
+        std::shared_ptr<const Image> zip; // The version indexed
+        std::shared_ptr<const RomArchive> index;
+    };
+
+    static std::shared_ptr<const Image> open(const std::string &path, uintmax_t size);
+    std::shared_ptr<const Image> getFile(const std::string &path);
+    std::shared_ptr<const Image> getMember(const std::string &archivePath, const std::string &member, const std::string &path);
+    void ioLoop();
+
+    std::mutex mutex;
+    std::unordered_map<std::string, Entry> entries;
+    std::unordered_map<std::string, ArchiveEntry> archives;
+    std::unordered_map<std::string, Entry> members; // By path through the archive
+
+    // Started by the first getAsync()
+    std::mutex ioMutex;
+    std::condition_variable ioWake;
+    std::deque<Read> reads;
+    std::thread ioThread;
+    bool ioStopping = false;
+};
+
+#endif
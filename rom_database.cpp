@@ -0,0 +1,207 @@
+#include "rom_database.h"
+#include "rom_cache.h"
+#include <algorithm> // For std::lower_bound
+#include <array>     // For the digest state
+#include <cstring>   // For std::strcmp
+#include <iterator>  // For std::begin, std::end
+
+namespace
+{
+    // Sorted by digest for binary search
+    const RomInfo knownRoms[] = {
+        {"050f07a54371da79f924dd0227b89d07b4f2aed0", "Hidden [David Winter, 1996]", RomPlatform::Classic, 10},
+        {"09ce01c54ddddda42ca5cd171f1ffcfd47355d12", "Wall [David Winter]", RomPlatform::Classic, 10},
+        {"0d0cc129dad3c45ba672f85fec71a668232212cc", "Missile [David Winter]", RomPlatform::Classic, 10},
+        {"1293db0ccccbe7dd3fc5a09a2abc5d7b175e18e0", "Puzzle", RomPlatform::Classic, 10},
+        {"137cb8397456f53fcab216124458238bc18c0965", "Guess [David Winter]", RomPlatform::Classic, 10},
+        {"1830eb401ba8789a477dfcf294873a5479ebcfe8", "Pong 2 (Pong hack) [David Winter, 1997]", RomPlatform::Classic, 10},
+        {"18b9d15f4c159e1f0ed58c2d8ec1d89325d3a3b6", "Tank", RomPlatform::Classic, 10},
+        {"193915dcde1365ae054c4eaa21a35baa27cd3356", "Breakout [Carmelo Cortez, 1979]", RomPlatform::CosmacVip, 10},
+        {"1bd92042717c3bc4f7f34cab34be2887145a6704", "Spooky Spot [Joseph Weisbecker, 1978]", RomPlatform::CosmacVip, 10},
+        {"1bdb4ddaa7049266fa3226851f28855a365cfd12", "Syzygy [Roy Trevino, 1990]", RomPlatform::Classic, 10},
+        {"237756a4014fb3aa82a29246a7cdd534f8dc2dbb", "Breakout (Brix hack) [David Winter, 1997]", RomPlatform::Classic, 10},
+        {"24960090b2afc9de2a4cb3ee7daf6a21456bb49b", "Russian Roulette [Carmelo Cortez, 1978]", RomPlatform::CosmacVip, 10},
+        {"29a41ab4d0aa3bc0d6a9d2fa71d533fe463344b3", "Rush Hour [Hap, 2006] (alt)", RomPlatform::Classic, 10},
+        {"2d10c07b532f4fa7c07a07324ba26ca39fe484fd", "Connect 4 [David Winter]", RomPlatform::Classic, 10},
+        {"3368d56efeb584c509bafb548f1ee5e71ac1bc70", "Biorhythm [Jef Winsor]", RomPlatform::CosmacVip, 10},
+        {"35158696bd94ea22ef34e899fff1f15f7154d4fd", "Craps [Camerlo Cortez, 1978]", RomPlatform::CosmacVip, 10},
+        {"3b2bf5dc7ffb5f3fbe168e802079f79730535ca8", "Figures", RomPlatform::Classic, 10},
+        {"3d1d029d6e31206d245c0ba881c0d1f003953bad", "Rocket [Joseph Weisbecker, 1978]", RomPlatform::CosmacVip, 10},
+        {"4031dae5c7545a1adc160a661be36f19fc1d47b2", "Nim [Carmelo Cortez, 1978]", RomPlatform::CosmacVip, 10},
+        {"429d455a4bc53167942bf6fd934d72b0f648dce3", "Tic-Tac-Toe [David Winter]", RomPlatform::Classic, 10},
+        {"443550abf646bc7f475ef0466f8e1232ec7474f3", "Shooting Stars [Philip Baltzer, 1978]", RomPlatform::CosmacVip, 10},
+        {"448f9d30d2157ab42679b809d4fb0b43d145f74f", "Sequence Shoot [Joyce Weisbecker]", RomPlatform::CosmacVip, 10},
+        {"4639f86beb0a203ae512b85d3b56d813b2dea7b4", "Rush Hour [Hap, 2006]", RomPlatform::Classic, 10},
+        {"5260f8931e0e9f41e555b382a14a88368e3ed886", "Guess [David Winter] (alt)", RomPlatform::Classic, 10},
+        {"5c28a5f85289c9d859f95fd5eadbdcb1c30bb08b", "Space Invaders [David Winter]", RomPlatform::Classic, 10},
+        {"5c82520906073287a3ef781746c67207ca084d93", "Cave", RomPlatform::Classic, 10},
+        {"5e70f91ca08e9b9e9de61670492e3db2d7f7d57a", "Rocket Launch [Jonas Lindstedt]", RomPlatform::Classic, 10},
+        {"5f518084744bf3cb8733f6e5454dfd1634320563", "Tetris [Fran Dachille, 1991]", RomPlatform::Classic, 10},
+        {"607c4f7f4e4dce9f99d96b3182bfe7e88bb090ee", "Pong (1 player)", RomPlatform::Classic, 10},
+        {"614a2b3d0bb5d62a16d963ac2d3a79eb3dd22742", "Coin Flipping [Carmelo Cortez, 1978]", RomPlatform::CosmacVip, 10},
+        {"669e32b6f42f52da658e428f501aabcdfa37fb2e", "Mastermind FourRow (Robert Lindley, 1978)", RomPlatform::CosmacVip, 10},
+        {"67996195539c0ddcd98533a01dffeec6a53a6da1", "Timebomb", RomPlatform::Classic, 10},
+        {"6df358d77961a0bf21e98876f9f616791cba31e3", "Soccer", RomPlatform::Classic, 10},
+        {"6f6509f38220e057a7e32ebb22dd353c1078e3e7", "Blitz [David Winter]", RomPlatform::Classic, 10},
+        {"726cb39afa7e17725af7fab37d153277d86bff77", "Programmable Spacefighters [Jef Winsor]", RomPlatform::CosmacVip, 10},
+        {"72e8f3a10a32bd7fb91322ecab87249f95e81e57", "Lunar Lander (Udo Pernisz, 1979)", RomPlatform::CosmacVip, 10},
+        {"72fb3e0a4572bdb81f484df7948a8bc736fe78d0", "Landing", RomPlatform::Classic, 10},
+        {"7623fa0fa915979226566b24107360e7537735f4", "Slide [Joyce Weisbecker]", RomPlatform::CosmacVip, 10},
+        {"775e82a36c93f1b41b42eca94b55acbc4a48cebe", "Tapeworm [JDR, 1999]", RomPlatform::Classic, 10},
+        {"83a2f9c8153be955c28e788bd803aa1d25131330", "Sum Fun [Joyce Weisbecker]", RomPlatform::CosmacVip, 10},
+        {"89aadf7c28bcd1c11e71ad9bd6eeaf0e7be474f3", "Submarine [Carmelo Cortez, 1978]", RomPlatform::CosmacVip, 10},
+        {"8e5f19d8ae9f3346779613359610967a5ed95fa8", "Deflection [John Fort]", RomPlatform::CosmacVip, 10},
+        {"91442577a6bbf8c3267f2df95fdfc50baebe176d", "Brick (Brix hack, 1990)", RomPlatform::Classic, 10},
+        {"a18f1e3897416180b32e47ddc82cba9aca2c8d52", "Paddles", RomPlatform::Classic, 10},
+        {"a1c1e0e7b01004be3ee77c69030e6b536cb316e6", "Worm V4 [RB-Revival Studios, 2007]", RomPlatform::Classic, 10},
+        {"a27dcf88a931f70c3ccf3c01a5410b263bac48bc", "Animal Race [Brian Astle]", RomPlatform::CosmacVip, 10},
+        {"a58ec7cc63707f9e7274026de27c15ec1d9945bd", "Squash [David Winter]", RomPlatform::Classic, 10},
+        {"a60611339661e3ab2d8af024ad1da5880a6f8665", "Pong (alt)", RomPlatform::Classic, 10},
+        {"a6a6cb2351c20b8f904da07c0ce91bd8161e9317", "Tron", RomPlatform::Classic, 10},
+        {"aa4f1a282bd64a2364102abf5737a4205365a2b4", "Space Flight", RomPlatform::Classic, 10},
+        {"ac621d9fcada302ba6965768229ef130630bc525", "Astro Dodge [Revival Studios, 2008]", RomPlatform::Classic, 10},
+        {"ade839585ddeb0e3633177df03c1d91589e629eb", "Vers [JMN, 1991]", RomPlatform::Classic, 10},
+        {"ae71a7b081a947f1760cdc147759803aea45e751", "Filter", RomPlatform::Classic, 10},
+        {"b232ef880bd6060fb45fa6effed7edf0ae95670e", "Pong [Paul Vervalin, 1990]", RomPlatform::Classic, 10},
+        {"b3fed4ed1eb0ed693c9731dbe53b29a76236c781", "Bowling [Gooitzen van der Wal]", RomPlatform::CosmacVip, 10},
+        {"bc158d819890f16f105b8a316eeeefe4a0bad875", "X-Mirror", RomPlatform::Classic, 10},
+        {"bdb92475acfe11bc7814a2f5eade13fcd09b756a", "UFO [Lutz V, 1992]", RomPlatform::Classic, 10},
+        {"cf3a8c546038c63cd4cc1de8d171b9bf0d57c0ee", "15 Puzzle [Roger Ivie] (alt)", RomPlatform::CosmacVip, 10},
+        {"d40abc54374e4343639f993e897e00904ddf85d9", "Blinky [Hans Christian Egeberg, 1991]", RomPlatform::Classic, 10},
+        {"d666688a8fce468a7d88b536bc1ef5f35ba12031", "Wipe Off [Joseph Weisbecker]", RomPlatform::CosmacVip, 10},
+        {"d979858bb9ffd07b48f52f92a8bcac0199f3623e", "Merlin [David Winter]", RomPlatform::Classic, 10},
+        {"da710f631f8e35534d0b9170bcf892a60f49c43d", "Vertical Brix [Paul Robson, 1996]", RomPlatform::Classic, 10},
+        {"dbb52193db4063149c3d8768ab47dd740d90955c", "Hi-Lo [Jef Winsor, 1978]", RomPlatform::CosmacVip, 10},
+        {"e2005db6391f589534dd2d63a95b429338bd667c", "Rocket Launcher", RomPlatform::Classic, 10},
+        {"ea9af3c09b0d9e265fcd92bcc5d51a2939fdf27a", "15 Puzzle [Roger Ivie]", RomPlatform::CosmacVip, 10},
+        {"ed829190e37815771e7a8c675ba0074996a2ddb0", "Space Intercept [Joseph Weisbecker, 1978]", RomPlatform::CosmacVip, 10},
+        {"f100197f0f2f05b4f3c8c31ab9c2c3930d3e9571", "Space Invaders [David Winter] (alt)", RomPlatform::Classic, 10},
+        {"f13766c14aeb02ad8d4d103cb5eadd282d20cddc", "Brix [Andreas Gustafsson, 1990]", RomPlatform::Classic, 10},
+        {"f2e9c480af31a4039af02dd7a2b8d5d1f859704d", "ZeroPong [zeroZshadow, 2007]", RomPlatform::Classic, 10},
+        {"f4169141735d8d60e51409ca7e73f4adedcefef2", "Blinky [Hans Christian Egeberg] (alt)", RomPlatform::Classic, 10},
+        {"fa7c04f68d78e0faf6d136a3babe3943fc2e02f1", "Most Dangerous Game [Peter Maruhnic]", RomPlatform::CosmacVip, 10},
+        {"fc724ae0125f5f1ac94a79fe3afc6318b1f57556", "Kaleidoscope [Joseph Weisbecker, 1978]", RomPlatform::CosmacVip, 10},
+        {"fca71182a8838b686573e69b22aff945d79fe1d0", "Airplane", RomPlatform::Classic, 10},
+        {"feaa2b999737630a6402e990df4d0558f79ba43e", "Addition Problems [Paul C. Moews]", RomPlatform::CosmacVip, 10},
+        {"ff639eceaf221ae66151a03779b41fae7118d2d8", "Reversi [Philip Baltzer]", RomPlatform::CosmacVip, 10},
+    };
+
+    uint32_t rotl(uint32_t value, int bits) { return (value << bits) | (value >> (32 - bits)); }
+
+    void sha1Block(std::array<uint32_t, 5> &h, const uint8_t *block)
+    {
+        uint32_t w[80];
+        for (int i = 0; i < 16; ++i)
+            w[i] = (block[4 * i] << 24) | (block[4 * i + 1] << 16) | (block[4 * i + 2] << 8) | block[4 * i + 3];
+        for (int i = 16; i < 80; ++i)
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i)
+        {
+            uint32_t f, k;
+            if (i < 20)
+            {
+                f = (b & c) | (~b & d);
+                k = 0x5A827999;
+            }
+            else if (i < 40)
+            {
+                f = b ^ c ^ d;
+                k = 0x6ED9EBA1;
+            }
+            else if (i < 60)
+            {
+                f = (b & c) | (b & d) | (c & d);
+                k = 0x8F1BBCDC;
+            }
+            else
+            {
+                f = b ^ c ^ d;
+                k = 0xCA62C1D6;
+            }
+            uint32_t t = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+}
+
+std::string RomDatabase::sha1(const uint8_t *data, size_t size)
+{
+    std::array<uint32_t, 5> h = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    size_t full = size / 64 * 64;
+    for (size_t i = 0; i < full; i += 64)
+        sha1Block(h, data + i);
+
+    // Final block(s): the tail, a 1 bit, zeros and the length in bits
+    uint8_t tail[128] = {};
+    size_t rest = size - full;
+    if (rest)
+        std::memcpy(tail, data + full, rest);
+    tail[rest] = 0x80;
+    size_t tailSize = rest < 56 ? 64 : 128;
+    uint64_t bits = static_cast<uint64_t>(size) * 8;
+    for (int i = 0; i < 8; ++i)
+        tail[tailSize - 1 - i] = static_cast<uint8_t>(bits >> (8 * i));
+    for (size_t i = 0; i < tailSize; i += 64)
+        sha1Block(h, tail + i);
+
+    static const char hex[] = "0123456789abcdef";
+    std::string digest;
+    for (uint32_t word : h)
+    {
+        for (int shift = 28; shift >= 0; shift -= 4)
+            digest += hex[(word >> shift) & 0xF];
+    }
+    return digest;
+}
+
+const RomInfo *RomDatabase::find(const uint8_t *data, size_t size)
+{
+    return findDigest(sha1(data, size));
+}
+
+const RomInfo *RomDatabase::findDigest(const std::string &digest)
+{
+    const RomInfo *it = std::lower_bound(std::begin(knownRoms), std::end(knownRoms), digest,
+                                         [](const RomInfo &info, const std::string &key)
+                                         { return std::strcmp(info.sha1, key.c_str()) < 0; });
+    if (it == std::end(knownRoms) || digest != it->sha1)
+        return nullptr;
+    return it;
+}
+
+const RomInfo *RomDatabase::findFile(const std::string &path)
+{
+    std::shared_ptr<const RomCache::Image> rom = RomCache::shared().get(path);
+    if (!rom)
+        return nullptr;
+    return find(rom->data(), rom->size());
+}
+
+const char *RomDatabase::platformName(RomPlatform platform)
+{
+    switch (platform)
+    {
+    case RomPlatform::Classic:
+        return "CHIP-8";
+    case RomPlatform::CosmacVip:
+        return "COSMAC VIP";
+    case RomPlatform::Hp48:
+        return "CHIP-48";
+    case RomPlatform::SuperChip:
+        return "SUPER-CHIP";
+    case RomPlatform::XoChip:
+        return "XO-CHIP";
+    }
+    return "CHIP-8";
+}
@@ -0,0 +1,40 @@
+#ifndef ROM_DATABASE_H
+#define ROM_DATABASE_H
+
+#include <cstddef> // For size_t
+#include <cstdint> // For uint8_t
+#include <string>  // For paths and digests
+
+// Interpreter a ROM was written for, which decides its quirk profile
+enum class RomPlatform
+{
+    Classic,   // Original behaviour of this emulator (quirks::Legacy)
+    CosmacVip, // quirks::CosmacVip
+    Hp48,      // CHIP-48, quirks::Chip48
+    SuperChip, // quirks::SuperChip
+    XoChip     // quirks::XoChip on the 64 KB machine
+};
+
+// Known ROM, identified by the SHA-1 of the whole file
+struct RomInfo
+{
+    const char *sha1; // Lower-case hex digest
+    const char *title;
+    RomPlatform platform;
+    int ipf; // Recommended instructions per 60 Hz frame
+};
+
+// Embedded table of known titles with their platform and speed
+class RomDatabase
+{
+public:
+    // nullptr for unknown ROMs
+    static const RomInfo *find(const uint8_t *data, size_t size);
+    static const RomInfo *findFile(const std::string &path); // Reads through the RomCache
+    static const RomInfo *findDigest(const std::string &digest);
+
+    static std::string sha1(const uint8_t *data, size_t size);
+    static const char *platformName(RomPlatform platform);
+};
+
+#endif
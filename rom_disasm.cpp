@@ -0,0 +1,98 @@
+// Static disassembler: walks a ROM's control flow from 0x200, separates
+// the code it reaches from the sprite data that code reads, and prints a
+// labelled listing.
+//
+//   chip8-disasm [options] <rom file>
+//     --xo          XO-CHIP: F000 NNNN is 4 bytes, 64 KB address space
+//     --out FILE    write the listing there instead of stdout
+//     --dot FILE    also write the control-flow graph for Graphviz
+//     --coverage F  also start from the code a .c8cv coverage file saw
+//                   run (chip8-headless --coverage), and take the bytes
+//                   it saw read as data
+
+#include "chip8_cfg.h"
+#include "chip8_coverage.h"
+#include "rom_cache.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    void usage()
+    {
+        std::fprintf(stderr, "usage: chip8-disasm [--xo] [--out FILE] [--dot FILE] [--coverage FILE] <rom file>\n");
+    }
+}
+
+int main(int argc, char **argv)
+{
+    bool xo = false;
+    std::string rom, outPath, dotPath, coveragePath;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--xo")
+            xo = true;
+        else if (arg == "--out" && hasValue)
+            outPath = argv[++i];
+        else if (arg == "--dot" && hasValue)
+            dotPath = argv[++i];
+        else if (arg == "--coverage" && hasValue)
+            coveragePath = argv[++i];
+        else if (arg[0] != '-' && rom.empty())
+            rom = arg;
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (rom.empty())
+    {
+        usage();
+        return 1;
+    }
+
+    std::shared_ptr<const RomCache::Image> image = RomCache::shared().get(rom);
+    if (!image)
+    {
+        std::fprintf(stderr, "can't read %s\n", rom.c_str());
+        return 1;
+    }
+    Chip8Coverage coverage(xo ? 0x10000 : 0x1000);
+    if (!coveragePath.empty() && !coverage.load(coveragePath))
+    {
+        std::fprintf(stderr, "can't read coverage %s\n", coveragePath.c_str());
+        return 1;
+    }
+    Chip8Cfg cfg;
+    cfg.build(image->data(), image->size(), xo, coveragePath.empty() ? nullptr : &coverage);
+
+    if (outPath.empty())
+        cfg.writeListing(std::cout);
+    else
+    {
+        std::ofstream out(outPath);
+        cfg.writeListing(out);
+        if (!out)
+        {
+            std::fprintf(stderr, "can't write %s\n", outPath.c_str());
+            return 1;
+        }
+    }
+    if (!dotPath.empty())
+    {
+        std::ofstream dot(dotPath);
+        cfg.writeDot(dot);
+        if (!dot)
+        {
+            std::fprintf(stderr, "can't write %s\n", dotPath.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
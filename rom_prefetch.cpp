@@ -0,0 +1,79 @@
+#include "rom_prefetch.h"
+#include "chip8.h"
+#include "rom_cache.h"
+#include <algorithm> // For std::none_of
+#include <iterator>  // For std::make_move_iterator
+
+RomPrefetcher::~RomPrefetcher()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+        queue.clear();
+    }
+    wake.notify_all();
+    if (worker.joinable())
+        worker.join();
+}
+
+RomPrefetcher &RomPrefetcher::shared()
+{
+    static RomPrefetcher prefetcher;
+    return prefetcher;
+}
+
+void RomPrefetcher::prefetch(std::vector<Request> requests)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!worker.joinable())
+            worker = std::thread(&RomPrefetcher::run, this);
+        queue.assign(std::make_move_iterator(requests.begin()), std::make_move_iterator(requests.end()));
+    }
+    wake.notify_one();
+    finished.notify_all(); // Waiters on a request just dropped
+}
+
+void RomPrefetcher::wait(const std::string &path)
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&]
+                  { return running != path && std::none_of(queue.begin(), queue.end(), [&](const Request &r)
+                                                           { return r.path == path; }); });
+}
+
+void RomPrefetcher::run()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        wake.wait(lock, [&]
+                  { return stopping || !queue.empty(); });
+        if (stopping)
+            break;
+        Request request = std::move(queue.front());
+        queue.pop_front();
+        running = request.path;
+        lock.unlock();
+
+        // Touching every page now is what saves the open a disk read later
+        std::shared_ptr<const RomCache::Image> rom = RomCache::shared().get(request.path);
+        if (rom)
+        {
+            volatile uint8_t sink = 0;
+            for (size_t i = 0; i < rom->size(); i += 4096)
+                sink = sink + rom->data()[i];
+            (void)sink;
+        }
+        if (rom && request.bootIpf > 0)
+        {
+            BootCache cache(request.bootDirectory);
+            if (!cache.has<Chip8>(rom->data(), rom->size(), request.bootIpf, request.seed, request.policy))
+                cache.build<Chip8>(rom->data(), rom->size(), request.bootIpf, request.seed);
+        }
+
+        lock.lock();
+        running.clear();
+        finished.notify_all();
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef ROM_PREFETCH_H
+#define ROM_PREFETCH_H
+
+#include "boot_cache.h"
+#include <condition_variable> // For the idle worker and wait()
+#include <cstdint>            // For seeds
+#include <deque>              // For queued requests
+#include <mutex>              // For the queue
+#include <string>             // For paths
+#include <thread>             // For the worker
+#include <vector>             // For a selection's requests
+
+// Gets ROMs ready before they are opened, for a launcher that knows what
+// the user is looking at: each request reads the ROM into RomCache with
+// every page faulted in, then boots it into the boot cache unless that
+// state is there already, so opening it is a cache hit on both. Runs on
+// a thread of its own; a new selection replaces the requests not started.
+class RomPrefetcher
+{
+public:
+    struct Request
+    {
+        std::string path;
+        int bootIpf = 0; // Speed the ROM will boot at, 0 to only read it
+        uint64_t seed = 0;
+        BootCache::Seed policy = BootCache::Seed::Reseed;
+        std::string bootDirectory;
+    };
+
+    RomPrefetcher() = default;
+    ~RomPrefetcher();
+    RomPrefetcher(const RomPrefetcher &) = delete;
+    RomPrefetcher &operator=(const RomPrefetcher &) = delete;
+
+    static RomPrefetcher &shared();
+
+    // Drops the queued requests and queues these, first most wanted
+    void prefetch(std::vector<Request> requests);
+
+    // Until no request for path is queued or running; for whatever is
+    // about to boot it, which would only do the same work again
+    void wait(const std::string &path);
+
+private:
+    void run();
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished; // For wait()
+    std::deque<Request> queue;
+    std::string running; // Path of the request under way, "" if none
+    bool stopping = false;
+    std::thread worker; // Started by the first prefetch()
+};
+
+#endif
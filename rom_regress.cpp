@@ -0,0 +1,276 @@
+// Regression runner: plays every ROM of a corpus for a fixed number of
+// frames with scripted keys, hashes the screen at regular checkpoints and
+// compares the hashes with a golden file recorded from a known-good
+// build. ROMs are spread over all hardware threads. Exits with 1 if any
+// ROM differs, is missing from the golden file or fails to load.
+//
+//   chip8-regress [options] <rom files or folders...>
+//     --golden F     golden hashes (default roms/golden_hashes.txt)
+//     --update       write the golden file from this run instead
+//     --frames N     frames to run per ROM (default 600)
+//     --every N      frames between checkpoints (default 60)
+//     --ipf N        instructions per frame (default 10)
+//     --core NAME    switch | table | predecoded | jit | aot | tiered
+//                    (default table)
+//     --threads N    worker threads (default: all hardware threads)
+//     --seed N       CXNN seed and key script seed (default 1)
+//
+// The golden file has one line per ROM: its file name, a tab, then the
+// checkpoint hashes in hex separated by spaces, as --update writes them.
+
+#include "chip8.h"
+#include "chip8_simd.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    struct Options
+    {
+        std::string golden = "roms/golden_hashes.txt";
+        bool update = false;
+        long long frames = 600;
+        int every = 60;
+        int ipf = 10;
+        Chip8::Core core = Chip8::Core::Table;
+        unsigned threads = 0;
+        uint64_t seed = 1;
+    };
+
+    struct alignas(64) Result
+    {
+        bool loaded = false;
+        std::vector<uint64_t> hashes; // One per checkpoint
+    };
+
+    void usage()
+    {
+        std::fprintf(stderr, "usage: chip8-regress [--golden FILE] [--update] [--frames N] [--every N] [--ipf N] "
+                             "[--core switch|table|predecoded|jit|aot|tiered] [--threads N] [--seed N] <rom files or folders...>\n");
+    }
+
+    bool parseCore(const char *name, Chip8::Core &core)
+    {
+        static const struct
+        {
+            const char *name;
+            Chip8::Core core;
+        } cores[] = {{"switch", Chip8::Core::Switch},
+                     {"table", Chip8::Core::Table},
+                     {"predecoded", Chip8::Core::Predecoded},
+                     {"jit", Chip8::Core::Jit},
+                     {"aot", Chip8::Core::Aot},
+                     {"tiered", Chip8::Core::Tiered}};
+        for (const auto &known : cores)
+        {
+            if (std::strcmp(name, known.name) == 0)
+            {
+                core = known.core;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void collectRoms(const fs::path &path, std::vector<std::string> &roms)
+    {
+        std::error_code ec;
+        if (!fs::is_directory(path, ec))
+        {
+            roms.push_back(path.string());
+            return;
+        }
+        for (const fs::directory_entry &entry : fs::directory_iterator(path, ec))
+        {
+            std::string ext = entry.path().extension().string();
+            if (entry.is_regular_file() && (ext == ".ch8" || ext == ".rom"))
+                roms.push_back(entry.path().string());
+        }
+    }
+
+    // Every 6 frames one key goes down or the held one comes up, picked
+    // from the seed, as the differential tester scripts them
+    void applyKeys(Chip8 &chip8, uint64_t seed, long long frame)
+    {
+        if (frame % 6 != 0)
+            return;
+        uint64_t z = seed + static_cast<uint64_t>(frame / 12) * 0x9E3779B97F4A7C15ull;
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+        chip8.setKey(static_cast<int>((z ^ (z >> 31)) & 0xF), frame % 12 == 0);
+    }
+
+    void runRom(const Options &opt, const std::string &path, Result &result)
+    {
+        Chip8 chip8(opt.core);
+        if (!chip8.loadROM(path))
+            return;
+        chip8.seedRandom(opt.seed);
+        result.loaded = true;
+        for (long long frame = 0; frame < opt.frames; ++frame)
+        {
+            applyKeys(chip8, opt.seed, frame);
+            chip8.runFrame(opt.ipf);
+            if ((frame + 1) % opt.every == 0)
+                result.hashes.push_back(simd::hashBytes(chip8.gfx.data(), sizeof chip8.gfx, chip8.isHires()));
+        }
+    }
+
+    std::string hashLine(const std::vector<uint64_t> &hashes)
+    {
+        std::string line;
+        char hex[24];
+        for (uint64_t hash : hashes)
+        {
+            std::snprintf(hex, sizeof hex, "%s%016llx", line.empty() ? "" : " ", static_cast<unsigned long long>(hash));
+            line += hex;
+        }
+        return line;
+    }
+
+    std::map<std::string, std::vector<uint64_t>> readGolden(const std::string &path, bool &found)
+    {
+        std::map<std::string, std::vector<uint64_t>> golden;
+        std::ifstream in(path);
+        found = in.is_open();
+        std::string line;
+        while (std::getline(in, line))
+        {
+            const size_t tab = line.find('\t');
+            if (tab == std::string::npos)
+                continue;
+            std::vector<uint64_t> &hashes = golden[line.substr(0, tab)];
+            std::istringstream fields(line.substr(tab + 1));
+            std::string field;
+            while (fields >> field)
+                hashes.push_back(std::strtoull(field.c_str(), nullptr, 16));
+        }
+        return golden;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    std::vector<std::string> roms;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--golden" && hasValue)
+            opt.golden = argv[++i];
+        else if (arg == "--update")
+            opt.update = true;
+        else if (arg == "--frames" && hasValue)
+            opt.frames = std::atoll(argv[++i]);
+        else if (arg == "--every" && hasValue)
+            opt.every = std::atoi(argv[++i]);
+        else if (arg == "--ipf" && hasValue)
+            opt.ipf = std::atoi(argv[++i]);
+        else if (arg == "--threads" && hasValue)
+            opt.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+        else if (arg == "--seed" && hasValue)
+            opt.seed = std::strtoull(argv[++i], nullptr, 0);
+        else if (arg == "--core" && hasValue)
+        {
+            if (!parseCore(argv[++i], opt.core))
+            {
+                usage();
+                return 1;
+            }
+        }
+        else if (arg[0] != '-')
+            collectRoms(arg, roms);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (roms.empty() || opt.every <= 0 || opt.ipf <= 0 || opt.frames < 0)
+    {
+        usage();
+        return 1;
+    }
+    std::sort(roms.begin(), roms.end());
+
+    std::vector<Result> results(roms.size());
+    ThreadPool pool(opt.threads);
+    auto start = std::chrono::steady_clock::now();
+    for (size_t r = 0; r < roms.size(); ++r)
+        pool.submit([&, r]
+                    { runRom(opt, roms[r], results[r]); });
+    pool.wait();
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int failures = 0;
+    if (opt.update)
+    {
+        std::ofstream out(opt.golden, std::ios::trunc);
+        for (size_t r = 0; r < roms.size(); ++r)
+        {
+            if (results[r].loaded)
+                out << fs::path(roms[r]).filename().string() << '\t' << hashLine(results[r].hashes) << '\n';
+            else
+                ++failures;
+        }
+        if (!out)
+        {
+            std::fprintf(stderr, "Failed to write golden hashes: %s\n", opt.golden.c_str());
+            return 1;
+        }
+        std::printf("Recorded %zu ROMs to %s in %.3f s on %u threads, %d load failures\n", roms.size() - failures,
+                    opt.golden.c_str(), wall, pool.size(), failures);
+        return failures ? 1 : 0;
+    }
+
+    bool haveGolden = false;
+    const auto golden = readGolden(opt.golden, haveGolden);
+    if (!haveGolden)
+    {
+        std::fprintf(stderr, "No golden hashes in %s, record them with --update\n", opt.golden.c_str());
+        return 1;
+    }
+    int differing = 0, missing = 0;
+    for (size_t r = 0; r < roms.size(); ++r)
+    {
+        const Result &result = results[r];
+        const auto entry = golden.find(fs::path(roms[r]).filename().string());
+        if (!result.loaded)
+        {
+            ++failures;
+            std::printf("%-11s %s\n", "LOAD FAILED", roms[r].c_str());
+        }
+        else if (entry == golden.end())
+        {
+            ++missing;
+            std::printf("%-11s %s\n", "NEW", roms[r].c_str());
+        }
+        else if (entry->second != result.hashes)
+        {
+            ++differing;
+            size_t first = 0;
+            while (first < entry->second.size() && first < result.hashes.size() && entry->second[first] == result.hashes[first])
+                ++first;
+            std::printf("%-11s %s\n            screen differs from frame %lld on\n", "DIFFERS", roms[r].c_str(),
+                        static_cast<long long>(first + 1) * opt.every);
+        }
+    }
+    std::printf("\n%zu ROMs, %lld frames each, checked every %d frames, in %.3f s on %u threads\n", roms.size(), opt.frames,
+                opt.every, wall, pool.size());
+    std::printf("%d differ, %d not in the golden file, %d load failures\n", differing, missing, failures);
+    return (differing || missing || failures) ? 1 : 0;
+}
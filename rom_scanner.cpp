@@ -0,0 +1,362 @@
+#include "rom_scanner.h"
+#include "chip8.h"
+#include "rom_archive.h"
+#include "rom_cache.h"
+#include "rom_database.h"
+#include "thread_pool.h"
+#include <algorithm> // For std::sort
+#include <filesystem>
+#include <fstream>
+#include <iterator> // For std::istreambuf_iterator
+#include <memory>   // For std::unique_ptr
+#include <unordered_map>
+#include <unordered_set> // For the notes found
+
+namespace
+{
+    const char indexHeader[] = "C8IDX 2";
+    const char hexDigits[] = "0123456789abcdef";
+
+    bool isRom(const std::string &name)
+    {
+        auto endsWith = [&](const char *suffix)
+        {
+            size_t n = std::char_traits<char>::length(suffix);
+            return name.size() >= n && name.compare(name.size() - n, n, suffix) == 0;
+        };
+        return endsWith(".ch8") || endsWith(".rom");
+    }
+
+    bool isNotes(const std::string &name)
+    {
+        return name.size() >= 4 && name.compare(name.size() - 4, 4, ".txt") == 0;
+    }
+
+    // "Game.ch8" has its notes in "Game.txt"
+    std::string notesName(const std::string &romName)
+    {
+        const size_t slash = romName.find_last_of('/');
+        const size_t dot = romName.find_last_of('.');
+        if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+            return romName + ".txt";
+        return romName.substr(0, dot) + ".txt";
+    }
+
+    bool isArchive(const std::string &name)
+    {
+        return name.size() >= 4 && name.compare(name.size() - 4, 4, ".zip") == 0;
+    }
+
+    // A file of the folder, or a member of an archive in it, inflated
+    // without going through the cache so a big pack isn't kept in memory
+    std::vector<uint8_t> readRom(const std::string &folder, const std::string &name)
+    {
+        namespace fs = std::filesystem;
+        const std::string path = (fs::u8path(folder) / fs::u8path(name)).u8string();
+        std::string archivePath, member;
+        if (RomArchive::splitPath(path, archivePath, member))
+        {
+            std::shared_ptr<const RomArchive> archive = RomCache::shared().archive(archivePath);
+            const RomArchive::Member *found = archive ? archive->find(member) : nullptr;
+            std::vector<uint8_t> bytes(found ? found->size : 0);
+            if (!found || !archive->extract(*found, bytes.data()))
+                bytes.clear();
+            return bytes;
+        }
+        std::ifstream file(fs::u8path(path), std::ios::binary);
+        return std::vector<uint8_t>((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    }
+
+    bool parseThumbnail(const std::string &hex, std::array<uint8_t, 256> &out)
+    {
+        if (hex.size() != out.size() * 2)
+            return false;
+        for (size_t i = 0; i < out.size(); ++i)
+        {
+            const char *hi = std::char_traits<char>::find(hexDigits, 16, hex[i * 2]);
+            const char *lo = std::char_traits<char>::find(hexDigits, 16, hex[i * 2 + 1]);
+            if (!hi || !lo)
+                return false;
+            out[i] = static_cast<uint8_t>((hi - hexDigits) << 4 | (lo - hexDigits));
+        }
+        return true;
+    }
+
+    // Runs the ROM headless like the GUI would and packs the final screen.
+    // Hi-res screens are halved, a pixel is lit if any of its four is.
+    void renderThumbnail(const std::vector<uint8_t> &rom, const std::string &sha1, std::array<uint8_t, 256> &out)
+    {
+        out.fill(0);
+        std::unique_ptr<Chip8> chip8 = std::make_unique<Chip8>(Chip8::Core::Predecoded);
+        if (!chip8->loadROM(rom.data(), rom.size()))
+            return;
+        chip8->seedRandom(1);
+
+        const RomInfo *info = RomDatabase::findDigest(sha1);
+        int ipf = info ? info->ipf : 5;
+        for (int frame = 0; frame < RomScanner::thumbnailFrames; ++frame)
+            chip8->runFrame(ipf);
+
+        bool hires = chip8->isHires();
+        for (int y = 0; y < 32; ++y)
+        {
+            for (int x = 0; x < 64; ++x)
+            {
+                bool lit = hires ? chip8->pixel(x * 2, y * 2) || chip8->pixel(x * 2 + 1, y * 2) ||
+                                       chip8->pixel(x * 2, y * 2 + 1) || chip8->pixel(x * 2 + 1, y * 2 + 1)
+                                 : chip8->pixel(x, y);
+                if (lit)
+                    out[y * 8 + x / 8] |= 0x80 >> (x % 8);
+            }
+        }
+    }
+
+    // One "sha1 size modified thumbnail name" line per ROM, tab separated
+    std::vector<RomScanner::Entry> readIndex(const std::string &path)
+    {
+        std::vector<RomScanner::Entry> entries;
+        std::ifstream file(path);
+        std::string line;
+        if (!std::getline(file, line) || line != indexHeader)
+            return entries;
+        while (std::getline(file, line))
+        {
+            size_t a = line.find('\t');
+            size_t b = a == std::string::npos ? a : line.find('\t', a + 1);
+            size_t c = b == std::string::npos ? b : line.find('\t', b + 1);
+            size_t d = c == std::string::npos ? c : line.find('\t', c + 1);
+            if (d == std::string::npos)
+                return {}; // Damaged: scan from scratch
+            RomScanner::Entry entry;
+            entry.sha1 = line.substr(0, a);
+            entry.size = std::stoull(line.substr(a + 1, b - a - 1));
+            entry.modified = std::stoll(line.substr(b + 1, c - b - 1));
+            if (!parseThumbnail(line.substr(c + 1, d - c - 1), entry.thumbnail))
+                return {};
+            entry.name = line.substr(d + 1);
+            entries.push_back(std::move(entry));
+        }
+        return entries;
+    }
+
+    void writeIndex(const std::string &path, const std::vector<RomScanner::Entry> &entries)
+    {
+        std::ofstream file(path, std::ios::trunc);
+        file << indexHeader << '\n';
+        for (const RomScanner::Entry &entry : entries)
+        {
+            std::string hex;
+            for (uint8_t byte : entry.thumbnail)
+            {
+                hex += hexDigits[byte >> 4];
+                hex += hexDigits[byte & 0xF];
+            }
+            file << entry.sha1 << '\t' << entry.size << '\t' << entry.modified << '\t' << hex << '\t' << entry.name << '\n';
+        }
+    }
+
+    bool sameEntries(const std::vector<RomScanner::Entry> &a, const std::vector<RomScanner::Entry> &b)
+    {
+        if (a.size() != b.size())
+            return false;
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            if (a[i].name != b[i].name || a[i].sha1 != b[i].sha1 || a[i].size != b[i].size || a[i].modified != b[i].modified)
+                return false;
+        }
+        return true;
+    }
+}
+
+RomScanner::~RomScanner()
+{
+    stop();
+}
+
+void RomScanner::start(const std::string &folder, const std::string &indexPath)
+{
+    stop();
+    cancel.store(false);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pending = Batch();
+    }
+    thread = std::thread(&RomScanner::run, this, folder, indexPath);
+}
+
+void RomScanner::stop()
+{
+    cancel.store(true);
+    if (thread.joinable())
+        thread.join();
+}
+
+RomScanner::Batch RomScanner::takeBatch()
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    Batch batch = std::move(pending);
+    pending = Batch();
+    pending.finished = batch.finished; // Stays over once over
+    return batch;
+}
+
+void RomScanner::deliver(std::vector<Entry> entries, bool replace)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (replace)
+    {
+        pending.entries = std::move(entries);
+        pending.replace = true;
+    }
+    else
+    {
+        pending.entries.insert(pending.entries.end(), std::make_move_iterator(entries.begin()),
+                               std::make_move_iterator(entries.end()));
+    }
+}
+
+void RomScanner::run(std::string folder, std::string indexPath)
+{
+    namespace fs = std::filesystem;
+
+    // Show the previous listing straight away, the scan below corrects it
+    std::vector<Entry> indexed = indexPath.empty() ? std::vector<Entry>() : readIndex(indexPath);
+    std::unordered_map<std::string, const Entry *> byName;
+    for (const Entry &entry : indexed)
+        byName[entry.name] = &entry;
+    if (!indexed.empty())
+        deliver(indexed, true);
+
+    // New or changed files are read, hashed and run on a pool, a batch at a time
+    std::unique_ptr<ThreadPool> pool;
+    std::vector<Entry> found;
+    std::vector<size_t> stale; // Indexes into found
+    size_t delivered = 0;
+    auto flush = [&]()
+    {
+        if (!stale.empty())
+        {
+            if (!pool)
+                pool = std::make_unique<ThreadPool>();
+            for (size_t i : stale)
+            {
+                pool->submit([&, i]()
+                             {
+                                 if (cancel.load())
+                                     return;
+                                 Entry &entry = found[i];
+                                 std::vector<uint8_t> bytes = readRom(folder, entry.name);
+                                 entry.sha1 = RomDatabase::sha1(bytes.data(), bytes.size());
+                                 renderThumbnail(bytes, entry.sha1, entry.thumbnail);
+                             });
+            }
+            pool->wait();
+            stale.clear();
+        }
+
+        // Without an index the listing streams in as it is found
+        if (indexed.empty() && !cancel.load())
+        {
+            deliver(std::vector<Entry>(found.begin() + delivered, found.end()), false);
+            delivered = found.size();
+        }
+    };
+
+    // Known and unchanged entries keep their hash and thumbnail
+    auto add = [&](Entry entry)
+    {
+        auto known = byName.find(entry.name);
+        if (known != byName.end() && known->second->size == entry.size && known->second->modified == entry.modified)
+        {
+            entry.sha1 = known->second->sha1;
+            entry.thumbnail = known->second->thumbnail;
+        }
+        else
+        {
+            stale.push_back(found.size());
+        }
+        found.push_back(std::move(entry));
+
+        if (indexed.empty() && found.size() - delivered >= 64)
+            flush();
+    };
+
+    std::unordered_set<std::string> notes; // Names of the .txt files, as entry names
+    std::error_code ec;
+    for (fs::directory_iterator it(fs::u8path(folder), ec), end; !ec && it != end && !cancel.load(); it.increment(ec))
+    {
+        std::error_code fileEc;
+        if (!it->is_regular_file(fileEc))
+            continue;
+        Entry entry;
+        entry.name = it->path().filename().u8string();
+        if (isNotes(entry.name))
+            notes.insert(entry.name);
+        if (!isRom(entry.name) && !isArchive(entry.name))
+            continue;
+        entry.size = it->file_size(fileEc);
+        entry.modified = static_cast<int64_t>(it->last_write_time(fileEc).time_since_epoch().count());
+        if (fileEc)
+            continue;
+        if (!isArchive(entry.name))
+        {
+            add(std::move(entry));
+            continue;
+        }
+
+        // Every ROM of an archive, from its central directory, as
+        // "pack.zip/member" with the archive's time
+        std::shared_ptr<const RomArchive> archive = RomCache::shared().archive(it->path().u8string());
+        if (!archive)
+            continue;
+        for (const RomArchive::Member &member : archive->members())
+        {
+            if (cancel.load())
+                break;
+            if (isNotes(member.name))
+                notes.insert(entry.name + "/" + member.name);
+            if (!isRom(member.name))
+                continue;
+            Entry inner;
+            inner.name = entry.name + "/" + member.name;
+            inner.size = member.size;
+            inner.modified = entry.modified;
+            add(std::move(inner));
+        }
+    }
+    flush();
+    if (cancel.load())
+        return;
+
+    // The index is kept sorted, so an unchanged folder compares equal
+    std::sort(found.begin(), found.end(), [](const Entry &a, const Entry &b)
+              { return a.name < b.name; });
+    if (!sameEntries(found, indexed))
+    {
+        if (!indexed.empty())
+            deliver(found, true);
+        if (!indexPath.empty())
+            writeIndex(indexPath, found);
+    }
+
+    // Notes aren't kept in the index, they are read again each scan
+    std::shared_ptr<RomSearch> search = std::make_shared<RomSearch>();
+    for (const Entry &entry : found)
+    {
+        if (cancel.load())
+            return;
+        std::string text;
+        const std::string name = notesName(entry.name);
+        if (notes.count(name))
+        {
+            std::vector<uint8_t> bytes = readRom(folder, name);
+            text.assign(bytes.begin(), bytes.begin() + static_cast<ptrdiff_t>(std::min(bytes.size(), maxNotes)));
+        }
+        search->add(entry.name, text);
+    }
+    search->build();
+
+    std::lock_guard<std::mutex> lock(mutex);
+    pending.search = std::move(search);
+    pending.finished = true;
+}
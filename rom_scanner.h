@@ -0,0 +1,73 @@
+#ifndef ROM_SCANNER_H
+#define ROM_SCANNER_H
+
+#include <array>   // For thumbnails
+#include "rom_search.h"
+#include <atomic>  // For the cancel flag
+#include <cstdint> // For file sizes and times
+#include <memory>  // For the search index
+#include <mutex>   // For the pending batch
+#include <string>  // For paths
+#include <thread>  // For std::thread
+#include <vector>  // For entries
+
+// Lists the ROMs of a folder on a background thread, with their SHA-1
+// and a thumbnail of the screen after a short headless run. Results are
+// kept in an index file, so reopening a folder shows the previous
+// listing at once and only reads files that changed. Once the folder is
+// listed the scan also builds a RomSearch over the ROMs' names and the
+// .txt notes next to them, "Game.txt" for "Game.ch8", in archives too.
+class RomScanner
+{
+public:
+    struct Entry
+    {
+        std::string name; // File name inside the folder
+        uintmax_t size = 0;
+        int64_t modified = 0; // File time ticks, only compared for equality
+        std::string sha1;
+        std::array<uint8_t, 256> thumbnail{}; // 64x32 screen, 8 bytes per row, MSB is the left pixel
+
+        bool thumbnailPixel(int x, int y) const { return (thumbnail[y * 8 + x / 8] >> (7 - x % 8)) & 1; }
+    };
+
+    // Frames a ROM runs before its thumbnail is taken
+    static constexpr int thumbnailFrames = 120;
+    // Bytes of a ROM's notes that are searched
+    static constexpr size_t maxNotes = 64 * 1024;
+
+    // What arrived since the previous takeBatch()
+    struct Batch
+    {
+        std::vector<Entry> entries;
+        bool replace = false;  // Entries replace everything delivered so far
+        bool finished = false; // The scan is over, nothing else will arrive
+        // With the finished batch: every ROM of the folder, by name
+        std::shared_ptr<const RomSearch> search;
+    };
+
+    RomScanner() = default;
+    ~RomScanner();
+
+    RomScanner(const RomScanner &) = delete;
+    RomScanner &operator=(const RomScanner &) = delete;
+
+    // Cancels any running scan first. An empty indexPath disables the index.
+    void start(const std::string &folder, const std::string &indexPath);
+    void stop();
+
+    // For the thread that called start(), typically from a GUI timer
+    Batch takeBatch();
+
+private:
+    void run(std::string folder, std::string indexPath);
+    void deliver(std::vector<Entry> entries, bool replace);
+
+    std::thread thread;
+    std::atomic<bool> cancel{false};
+
+    std::mutex mutex;
+    Batch pending;
+};
+
+#endif
@@ -0,0 +1,190 @@
+#include "rom_search.h"
+#include <algorithm> // For std::sort, std::lower_bound
+
+namespace
+{
+    // Letters and digits lower-cased, bytes of UTF-8 sequences kept as
+    // letters; anything else separates words
+    char foldChar(unsigned char c)
+    {
+        if (c >= 'A' && c <= 'Z')
+            return static_cast<char>(c - 'A' + 'a');
+        if ((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c >= 0x80)
+            return static_cast<char>(c);
+        return ' ';
+    }
+
+    // Every trigram of the words of text, " word " padded, appended to out
+    void trigramsOf(const std::string &text, std::vector<uint32_t> &out)
+    {
+        uint32_t window = 0;
+        int length = 0; // Characters of the current word in window, padding included
+        auto push = [&](char c)
+        {
+            window = ((window << 8) | static_cast<unsigned char>(c)) & 0xFFFFFF;
+            if (++length >= 3)
+                out.push_back(window);
+        };
+        for (size_t i = 0; i <= text.size(); ++i)
+        {
+            const char c = i < text.size() ? foldChar(static_cast<unsigned char>(text[i])) : ' ';
+            if (c != ' ')
+            {
+                if (length == 0)
+                    push(' ');
+                push(c);
+            }
+            else if (length > 0)
+            {
+                push(' ');
+                length = 0;
+            }
+        }
+    }
+
+    void distinct(std::vector<uint32_t> &v)
+    {
+        std::sort(v.begin(), v.end());
+        v.erase(std::unique(v.begin(), v.end()), v.end());
+    }
+
+    std::string trim(const std::string &s)
+    {
+        const size_t begin = s.find_first_not_of(' ');
+        if (begin == std::string::npos)
+            return std::string();
+        return s.substr(begin, s.find_last_not_of(' ') - begin + 1);
+    }
+}
+
+RomSearch::Document RomSearch::parseName(const std::string &name)
+{
+    Document doc;
+    doc.name = name;
+
+    // "pack.zip/Dir/Game [Author, 1990] (alt).ch8" is titled "Game"
+    std::string base = name.substr(name.find_last_of('/') + 1);
+    const size_t dot = base.find_last_of('.');
+    if (dot != std::string::npos && dot > 0)
+        base.erase(dot);
+    doc.title = trim(base.substr(0, base.find_first_of("[(")));
+    if (doc.title.empty())
+        doc.title = trim(base);
+
+    const size_t open = base.find('[');
+    const size_t close = open == std::string::npos ? open : base.find(']', open);
+    if (close == std::string::npos)
+        return doc;
+    const std::string inside = base.substr(open + 1, close - open - 1);
+    size_t start = 0;
+    while (start <= inside.size())
+    {
+        size_t comma = inside.find(',', start);
+        if (comma == std::string::npos)
+            comma = inside.size();
+        const std::string part = trim(inside.substr(start, comma - start));
+        if (part.size() == 4 && std::all_of(part.begin(), part.end(), [](char c)
+                                            { return c >= '0' && c <= '9'; }))
+            doc.year = part;
+        else if (!part.empty())
+            doc.author += (doc.author.empty() ? "" : ", ") + part;
+        start = comma + 1;
+    }
+    return doc;
+}
+
+void RomSearch::add(const std::string &name, const std::string &notes)
+{
+    if (built)
+        return;
+    const uint32_t id = static_cast<uint32_t>(documents.size());
+    documents.push_back(parseName(name));
+
+    // The whole file name counts as name, so "(alt)" and "hack" are found
+    // too; the title, author and year are already in it
+    std::vector<uint32_t> grams;
+    trigramsOf(name.substr(name.find_last_of('/') + 1), grams);
+    distinct(grams);
+    for (uint32_t gram : grams)
+        pending.push_back(static_cast<uint64_t>(gram) << 32 | id << 1);
+
+    grams.clear();
+    trigramsOf(notes, grams);
+    distinct(grams);
+    for (uint32_t gram : grams)
+        pending.push_back(static_cast<uint64_t>(gram) << 32 | id << 1 | 1);
+}
+
+void RomSearch::build()
+{
+    if (built)
+        return;
+    built = true;
+    std::sort(pending.begin(), pending.end());
+    trigrams.clear();
+    offsets.clear();
+    postings.clear();
+    postings.reserve(pending.size());
+    for (uint64_t entry : pending)
+    {
+        const uint32_t gram = static_cast<uint32_t>(entry >> 32);
+        if (trigrams.empty() || trigrams.back() != gram)
+        {
+            trigrams.push_back(gram);
+            offsets.push_back(static_cast<uint32_t>(postings.size()));
+        }
+        postings.push_back(static_cast<uint32_t>(entry));
+    }
+    offsets.push_back(static_cast<uint32_t>(postings.size()));
+    pending.clear();
+    pending.shrink_to_fit();
+}
+
+std::vector<uint32_t> RomSearch::find(const std::string &query) const
+{
+    std::vector<uint32_t> grams;
+    trigramsOf(query, grams);
+    distinct(grams);
+    std::vector<uint32_t> found;
+    if (grams.empty() || !built)
+        return found;
+
+    // Trigrams each document has of the query's, in its name and its notes
+    std::vector<uint16_t> nameHits(documents.size()), noteHits(documents.size());
+    std::vector<uint32_t> touched;
+    for (uint32_t gram : grams)
+    {
+        auto it = std::lower_bound(trigrams.begin(), trigrams.end(), gram);
+        if (it == trigrams.end() || *it != gram)
+            continue;
+        const size_t t = static_cast<size_t>(it - trigrams.begin());
+        for (uint32_t p = offsets[t]; p < offsets[t + 1]; ++p)
+        {
+            const uint32_t id = postings[p] >> 1;
+            if (nameHits[id] == 0 && noteHits[id] == 0)
+                touched.push_back(id);
+            if (postings[p] & 1)
+                ++noteHits[id];
+            else
+                ++nameHits[id];
+        }
+    }
+
+    // Half the query's trigrams in one place. Every name match ranks
+    // above every notes match, then by trigrams matched.
+    const size_t needed = (grams.size() + 1) / 2;
+    std::vector<std::pair<uint32_t, uint32_t>> ranked; // Score, id
+    for (uint32_t id : touched)
+    {
+        if (nameHits[id] >= needed)
+            ranked.push_back({0x10000u + nameHits[id], id});
+        else if (noteHits[id] >= needed)
+            ranked.push_back({noteHits[id], id});
+    }
+    std::sort(ranked.begin(), ranked.end(), [](const std::pair<uint32_t, uint32_t> &a, const std::pair<uint32_t, uint32_t> &b)
+              { return a.first != b.first ? a.first > b.first : a.second < b.second; });
+    found.reserve(ranked.size());
+    for (const auto &r : ranked)
+        found.push_back(r.second);
+    return found;
+}
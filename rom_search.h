@@ -0,0 +1,61 @@
+#ifndef ROM_SEARCH_H
+#define ROM_SEARCH_H
+
+#include <cstddef> // For size_t
+#include <cstdint> // For document ids and trigrams
+#include <string>  // For names and notes
+#include <vector>  // For the postings
+
+// Fuzzy search over a ROM library: each ROM's title, author and year, as
+// read from names like "Tetris [Fran Dachille, 1991].ch8", and the text
+// of the .txt notes next to it. Words are broken into trigrams, padded
+// with a space at each end, and each trigram maps to the ROMs that have
+// it; a query matches a ROM holding at least half of the query's
+// trigrams, in its name or in its notes, so a missing or wrong letter
+// still finds it. Matches in the name rank above matches in the notes.
+//
+// Built once, add() per ROM then build(), on whatever thread scans the
+// folder; find() is const and may then be called from any thread.
+class RomSearch
+{
+public:
+    struct Document
+    {
+        std::string name;   // As given to add()
+        std::string title;  // Before the brackets, without the extension
+        std::string author; // From the brackets, "" if there were none
+        std::string year;   // The 4-digit part of the brackets, "" if none
+    };
+
+    // Queries shorter than this have no trigram; callers match those some
+    // other way
+    static constexpr size_t minimumQuery = 3;
+
+    // name is the ROM's file name, notes the text of its .txt or ""
+    void add(const std::string &name, const std::string &notes);
+    // Turns what was added into the index; add() after this is ignored
+    void build();
+
+    // Documents matching query, best first, ties in order of add()
+    std::vector<uint32_t> find(const std::string &query) const;
+
+    size_t size() const { return documents.size(); }
+    const Document &document(uint32_t id) const { return documents[id]; }
+
+    // Title, author and year from a ROM file name, for display too
+    static Document parseName(const std::string &name);
+
+private:
+    std::vector<Document> documents;
+    std::vector<uint64_t> pending; // trigram << 32 | posting, until build()
+    bool built = false;
+
+    // Sorted distinct trigrams, each with its postings at
+    // postings[offsets[i], offsets[i + 1]): document id << 1, bit 0 set
+    // for a trigram of the notes rather than the name
+    std::vector<uint32_t> trigrams;
+    std::vector<uint32_t> offsets;
+    std::vector<uint32_t> postings;
+};
+
+#endif
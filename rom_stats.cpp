@@ -0,0 +1,329 @@
+// Corpus statistics: walks the control flow of every ROM in a folder with
+// Chip8Cfg and counts what the reached code is made of, to decide which
+// opcodes the dispatch table, the fused superinstructions and the JIT
+// should favour. Reports opcode class frequencies, the most common runs
+// of two and three instructions inside one block, DXYN heights, block
+// lengths, and which ROMs modify their own code: statically, an FX33 or
+// FX55 whose I the walk knows stores into reached code, and dynamically,
+// stores into decoded code during a short run.
+//
+//   chip8-rom-stats [options] <rom files or folders...> (default roms)
+//     --top N       rows of each n-gram table (default 25)
+//     --frames N    frames each ROM runs to watch for writes into its
+//                   code (default 600, 0 none)
+//     --ipf N       instructions per frame for that run (default 10)
+//     --xo          XO-CHIP: F000 NNNN is 4 bytes, 64 KB address space
+//     --per-rom     also print a line per ROM
+
+#include "chip8.h"
+#include "chip8_cfg.h"
+#include "chip8_profile.h"
+#include "rom_cache.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    using Gram = std::vector<uint8_t>; // Opcode classes in program order
+
+    struct Tally
+    {
+        uint64_t count = 0;
+        std::set<size_t> roms; // Indices of the ROMs it appears in
+    };
+
+    // What one ROM contributes
+    struct RomStats
+    {
+        std::string path;
+        size_t size = 0;
+        size_t instructions = 0;
+        size_t blocks = 0;
+        size_t computedJumps = 0;
+        size_t writtenCodeBytes = 0; // Static self-modification
+        uint64_t codeWrites = 0;     // Seen in the run
+    };
+
+    struct Corpus
+    {
+        std::array<Tally, Chip8Profile::classCount> classes;
+        std::map<Gram, Tally> bigrams, trigrams;
+        std::array<uint64_t, 16> drawHeights{}; // Index 0 is DXY0
+        std::array<uint64_t, 7> blockLengths{}; // 1, 2, 3-4, 5-8, 9-16, 17-32, more
+        std::vector<RomStats> roms;
+    };
+
+    void usage()
+    {
+        std::fprintf(stderr, "usage: chip8-rom-stats [--top N] [--frames N] [--ipf N] [--xo] [--per-rom] [rom files or folders...]\n");
+    }
+
+    void collectRoms(const fs::path &path, std::vector<std::string> &roms)
+    {
+        std::error_code ec;
+        if (!fs::is_directory(path, ec))
+        {
+            roms.push_back(path.string());
+            return;
+        }
+        std::vector<std::string> found;
+        for (const fs::directory_entry &entry : fs::directory_iterator(path, ec))
+        {
+            std::string ext = entry.path().extension().string();
+            if (entry.is_regular_file() && (ext == ".ch8" || ext == ".rom" || ext == ".xo8" || ext == ".sc8"))
+                found.push_back(entry.path().string());
+        }
+        std::sort(found.begin(), found.end()); // Directory order isn't stable between runs
+        roms.insert(roms.end(), found.begin(), found.end());
+    }
+
+    int lengthBucket(int instructions)
+    {
+        int bucket = 0;
+        for (int limit = 1; bucket < 6 && instructions > limit; limit = limit == 1 ? 2 : limit * 2)
+            ++bucket;
+        return bucket;
+    }
+
+    // Stores into decoded code while the ROM runs frames, a fixed seed so
+    // every run of the tool agrees
+    template <typename Machine>
+    uint64_t runForCodeWrites(const uint8_t *data, size_t size, long long frames, int ipf)
+    {
+        std::unique_ptr<Machine> machine(new Machine(Machine::Core::Predecoded));
+        machine->seedRandom(1);
+        if (!machine->loadROM(data, size))
+            return 0;
+        for (long long f = 0; f < frames; ++f)
+            machine->runFrame(ipf);
+        return machine->getCodeCacheStats().codeWrites;
+    }
+
+    void addRom(Corpus &corpus, const std::string &path, bool xo, long long frames, int ipf)
+    {
+        std::shared_ptr<const RomCache::Image> image = RomCache::shared().get(path);
+        if (!image)
+        {
+            std::fprintf(stderr, "can't read %s\n", path.c_str());
+            return;
+        }
+        const uint8_t *rom = image->data();
+        const size_t size = image->size();
+        const size_t index = corpus.roms.size();
+        RomStats stats;
+        stats.path = path;
+        stats.size = size;
+
+        Chip8Cfg cfg;
+        cfg.build(rom, size, xo);
+        auto byteAt = [&](size_t addr) -> uint8_t
+        { return addr >= 0x200 && addr - 0x200 < size ? rom[addr - 0x200] : 0; };
+
+        for (const Chip8Cfg::Block &block : cfg.getBlocks())
+        {
+            ++stats.blocks;
+            stats.instructions += block.instructions;
+            ++corpus.blockLengths[lengthBucket(block.instructions)];
+
+            Gram window;
+            for (size_t pc = block.start; pc < block.end;)
+            {
+                const uint16_t opcode = static_cast<uint16_t>((byteAt(pc) << 8) | byteAt(pc + 1));
+                const int cls = Chip8Profile::opcodeClass(opcode);
+                Tally &tally = corpus.classes[cls];
+                ++tally.count;
+                tally.roms.insert(index);
+                if ((opcode & 0xF000) == 0xD000)
+                    ++corpus.drawHeights[opcode & 0xF];
+
+                window.push_back(static_cast<uint8_t>(cls));
+                if (window.size() > 3)
+                    window.erase(window.begin());
+                if (window.size() >= 2)
+                {
+                    Tally &pair = corpus.bigrams[Gram(window.end() - 2, window.end())];
+                    ++pair.count;
+                    pair.roms.insert(index);
+                }
+                if (window.size() == 3)
+                {
+                    Tally &triple = corpus.trigrams[window];
+                    ++triple.count;
+                    triple.roms.insert(index);
+                }
+                pc += xo && opcode == 0xF000 ? 4 : 2;
+            }
+        }
+        stats.computedJumps = cfg.getComputedJumps().size();
+        for (size_t addr = 0x200; addr < 0x200 + size && addr <= 0xFFFF; ++addr)
+        {
+            if (cfg.byteKind(static_cast<uint16_t>(addr)) == Chip8Cfg::Byte::Code && cfg.isWritten(static_cast<uint16_t>(addr)))
+                ++stats.writtenCodeBytes;
+        }
+        if (frames > 0)
+            stats.codeWrites = xo ? runForCodeWrites<XoChip8>(rom, size, frames, ipf) : runForCodeWrites<Chip8>(rom, size, frames, ipf);
+        corpus.roms.push_back(std::move(stats));
+    }
+
+    std::string gramName(const Gram &gram)
+    {
+        std::string name;
+        for (uint8_t cls : gram)
+        {
+            if (!name.empty())
+                name += ' ';
+            name += Chip8Profile::className(cls);
+        }
+        return name;
+    }
+
+    void printGrams(const char *title, const std::map<Gram, Tally> &grams, uint64_t total, size_t top)
+    {
+        std::vector<std::pair<const Gram *, const Tally *>> sorted;
+        for (const auto &entry : grams)
+            sorted.push_back({&entry.first, &entry.second});
+        std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b)
+                  { return a.second->count != b.second->count ? a.second->count > b.second->count : *a.first < *b.first; });
+        std::printf("\n%-16s      count      %%   roms\n", title);
+        for (size_t i = 0; i < sorted.size() && i < top; ++i)
+            std::printf("%-16s %10llu %6.2f %6zu\n", gramName(*sorted[i].first).c_str(),
+                        static_cast<unsigned long long>(sorted[i].second->count),
+                        total ? 100.0 * sorted[i].second->count / total : 0.0, sorted[i].second->roms.size());
+    }
+
+    void report(const Corpus &corpus, size_t top, bool perRom, long long frames)
+    {
+        uint64_t instructions = 0, blocks = 0, pairs = 0, triples = 0;
+        for (const RomStats &rom : corpus.roms)
+        {
+            instructions += rom.instructions;
+            blocks += rom.blocks;
+        }
+        for (const auto &entry : corpus.bigrams)
+            pairs += entry.second.count;
+        for (const auto &entry : corpus.trigrams)
+            triples += entry.second.count;
+
+        std::printf("%zu ROMs, %llu reached instructions in %llu blocks (%.2f per block)\n", corpus.roms.size(),
+                    static_cast<unsigned long long>(instructions), static_cast<unsigned long long>(blocks),
+                    blocks ? static_cast<double>(instructions) / blocks : 0.0);
+
+        std::vector<int> order;
+        for (int cls = 0; cls < Chip8Profile::classCount; ++cls)
+        {
+            if (corpus.classes[cls].count)
+                order.push_back(cls);
+        }
+        std::sort(order.begin(), order.end(), [&](int a, int b)
+                  { return corpus.classes[a].count != corpus.classes[b].count ? corpus.classes[a].count > corpus.classes[b].count : a < b; });
+        std::printf("\nclass        count      %%   roms\n");
+        for (int cls : order)
+            std::printf("%-6s %12llu %6.2f %6zu\n", Chip8Profile::className(cls),
+                        static_cast<unsigned long long>(corpus.classes[cls].count),
+                        instructions ? 100.0 * corpus.classes[cls].count / instructions : 0.0, corpus.classes[cls].roms.size());
+
+        printGrams("pair", corpus.bigrams, pairs, top);
+        printGrams("triple", corpus.trigrams, triples, top);
+
+        uint64_t draws = 0;
+        for (uint64_t count : corpus.drawHeights)
+            draws += count;
+        std::printf("\nDXYN height  count      %%\n");
+        for (int n = 0; n < 16; ++n)
+        {
+            if (corpus.drawHeights[n])
+                std::printf("%-6s %10llu %6.2f\n", n ? std::to_string(n).c_str() : "0 (16)",
+                            static_cast<unsigned long long>(corpus.drawHeights[n]), 100.0 * corpus.drawHeights[n] / draws);
+        }
+
+        const char *lengthNames[] = {"1", "2", "3-4", "5-8", "9-16", "17-32", "33+"};
+        std::printf("\nblock length  count      %%\n");
+        for (int b = 0; b < 7; ++b)
+            std::printf("%-8s %10llu %6.2f\n", lengthNames[b], static_cast<unsigned long long>(corpus.blockLengths[b]),
+                        blocks ? 100.0 * corpus.blockLengths[b] / blocks : 0.0);
+
+        size_t staticSelf = 0, dynamicSelf = 0, computed = 0;
+        for (const RomStats &rom : corpus.roms)
+        {
+            staticSelf += rom.writtenCodeBytes != 0;
+            dynamicSelf += rom.codeWrites != 0;
+            computed += rom.computedJumps != 0;
+        }
+        std::printf("\nself-modifying: %zu ROMs store into their code by a known I", staticSelf);
+        if (frames > 0)
+            std::printf(", %zu did in %lld frames", dynamicSelf, frames);
+        std::printf("; %zu use BNNN\n", computed);
+        for (const RomStats &rom : corpus.roms)
+        {
+            if (rom.writtenCodeBytes || rom.codeWrites)
+                std::printf("  %s: %zu code bytes written statically, %llu stores into code run\n", fs::path(rom.path).filename().string().c_str(),
+                            rom.writtenCodeBytes, static_cast<unsigned long long>(rom.codeWrites));
+        }
+
+        if (perRom)
+        {
+            std::printf("\nrom                                              bytes  insns blocks  bnnn   smc\n");
+            for (const RomStats &rom : corpus.roms)
+                std::printf("%-48.48s %6zu %6zu %6zu %5zu %5s\n", fs::path(rom.path).filename().string().c_str(), rom.size,
+                            rom.instructions, rom.blocks, rom.computedJumps, rom.writtenCodeBytes || rom.codeWrites ? "yes" : "");
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    size_t top = 25;
+    long long frames = 600;
+    int ipf = 10;
+    bool xo = false;
+    bool perRom = false;
+    std::vector<std::string> roms;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--top" && hasValue)
+            top = static_cast<size_t>(std::atoll(argv[++i]));
+        else if (arg == "--frames" && hasValue)
+            frames = std::atoll(argv[++i]);
+        else if (arg == "--ipf" && hasValue)
+            ipf = std::atoi(argv[++i]);
+        else if (arg == "--xo")
+            xo = true;
+        else if (arg == "--per-rom")
+            perRom = true;
+        else if (arg[0] != '-')
+            collectRoms(arg, roms);
+        else
+        {
+            usage();
+            return 1;
+        }
+    }
+    if (roms.empty())
+        collectRoms("roms", roms);
+    if (roms.empty() || ipf <= 0 || frames < 0)
+    {
+        usage();
+        return 1;
+    }
+
+    Corpus corpus;
+    for (const std::string &path : roms)
+        addRom(corpus, path, xo, frames, ipf);
+    if (corpus.roms.empty())
+        return 1;
+    report(corpus, top, perRom, frames);
+    return 0;
+}
@@ -0,0 +1,104 @@
+// Sandbox pool check: opens every slot of a one-worker pool, closes them
+// all again at a random point of the worker's frame, and makes sure each
+// slot comes back. A close that lands while the worker is still loading a
+// slot's ROM is the case it looks for: the worker must free that slot
+// rather than start running it, or the slot is lost to the pool for good.
+//
+//   chip8-sandbox-check [--rounds N] [--slots N]
+//
+// Exits with 1 if any slot isn't given out again. The binary is also its
+// own sandbox worker, as chip8-server is.
+
+#include "sandbox_pool.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // Jumps to itself
+    const uint8_t idleRom[] = {0x12, 0x00};
+
+    // Opens slots until the pool is full, supervising for up to a second
+    // while closed slots are still being let go
+    size_t openAll(SandboxPool &pool, size_t want, std::vector<long> &open)
+    {
+        const Clock::time_point giveUp = Clock::now() + std::chrono::seconds(1);
+        while (open.size() < want)
+        {
+            pool.supervise();
+            const long slot = pool.open(idleRom, sizeof idleRom, open.size());
+            if (slot >= 0)
+            {
+                open.push_back(slot);
+                continue;
+            }
+            if (Clock::now() > giveUp)
+                break;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return open.size();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc == 4 && std::string(argv[1]) == "--sandbox-worker")
+        return SandboxPool::workerMain(argv[2], static_cast<unsigned>(std::atoi(argv[3])));
+
+    int rounds = 200;
+    size_t slots = 256;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--rounds" && hasValue)
+            rounds = std::atoi(argv[++i]);
+        else if (arg == "--slots" && hasValue)
+            slots = static_cast<size_t>(std::atoi(argv[++i]));
+        else
+        {
+            std::fprintf(stderr, "usage: chip8-sandbox-check [--rounds N] [--slots N]\n");
+            return 1;
+        }
+    }
+
+    SandboxPool::Options options;
+    options.workers = 1;
+    options.slotsPerWorker = slots;
+    SandboxPool pool(options);
+    if (!pool.start())
+    {
+        std::fprintf(stderr, "can't start the sandbox pool\n");
+        return 1;
+    }
+
+    // Closes at random offsets into the worker's 16.7 ms frame, so some
+    // land in the middle of its pass loading the new slots
+    std::mt19937 rng(1);
+    std::uniform_int_distribution<int> delay(0, 17000);
+    for (int round = 0; round < rounds; ++round)
+    {
+        std::vector<long> open;
+        const size_t opened = openAll(pool, slots, open);
+        if (opened < slots)
+        {
+            std::printf("FAIL round %d: %zu of %zu slots came back\n", round, opened, slots);
+            return 1;
+        }
+        const Clock::time_point closeAt = Clock::now() + std::chrono::microseconds(delay(rng));
+        while (Clock::now() < closeAt)
+        {
+        }
+        for (long slot : open)
+            pool.close(slot);
+    }
+    std::printf("%d rounds of %zu slots, every slot came back\n", rounds, slots);
+    return 0;
+}
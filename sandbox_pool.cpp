@@ -0,0 +1,523 @@
+#include "sandbox_pool.h"
+#include "chip8.h"
+#include <atomic>  // For the shared counters
+#include <chrono>  // For pacing and the watchdog
+#include <cstring> // For std::memcpy
+#include <memory>  // For the workers' machines
+#include <thread>  // For sleep_until
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/prctl.h>
+#endif
+extern char **environ;
+#endif
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const uint32_t sharedMagic = 0x58533843; // "C8SX"
+    const size_t romCapacity = 4096 - 0x200;
+    const uint32_t keyRingSize = 32;  // Key changes a worker takes per frame at most
+    const uint32_t frameRingSize = 4; // Frames a reader may lag before it retries
+    const int64_t frameMicros = 1000000 / 60;
+    const int64_t hangMicros = 2000000; // Heartbeat silence before a worker counts as hung
+
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared counters must not need a lock");
+
+    enum SlotState : uint32_t
+    {
+        SlotFree,    // The host may fill it
+        SlotLoad,    // ROM and seed written, the worker boots it
+        SlotRunning, // The worker runs it every frame
+        SlotClose    // The host is done, the worker frees it
+    };
+
+    // One published frame, under a sequence lock: seq is odd while the
+    // worker writes it and 2 * number once it is whole
+    struct SharedFrame
+    {
+        std::atomic<uint64_t> seq;
+        uint8_t flags; // Bit 0 hi-res, bit 1 buzzer
+        uint64_t gfx[128];
+    };
+
+    struct SharedSlot
+    {
+        std::atomic<uint32_t> state;
+        std::atomic<uint32_t> keys;    // Held now, applied after the ring
+        std::atomic<uint32_t> keyHead; // Written by the host
+        std::atomic<uint32_t> keyTail; // Written by the worker
+        uint16_t keyRing[keyRingSize];
+        uint64_t seed;
+        uint32_t romSize;
+        uint8_t rom[romCapacity];
+        std::atomic<uint64_t> frameCount; // Frames published
+        SharedFrame frames[frameRingSize];
+    };
+
+    struct SharedWorker
+    {
+        std::atomic<uint64_t> heartbeat; // Ticks of the worker's clock
+        std::atomic<uint32_t> stop;
+    };
+
+    // The mapping: this header, a SharedWorker per worker, then the slots
+    struct SharedHeader
+    {
+        uint32_t magic;
+        uint32_t workers;
+        uint64_t slotsPerWorker;
+        int32_t ipf;
+        int32_t hostProcess;
+    };
+
+    size_t workerOffset() { return (sizeof(SharedHeader) + 63) & ~size_t(63); }
+    size_t slotOffset(size_t workers) { return (workerOffset() + workers * sizeof(SharedWorker) + 63) & ~size_t(63); }
+
+    SharedWorker *workerAt(void *base, size_t index)
+    {
+        return reinterpret_cast<SharedWorker *>(static_cast<uint8_t *>(base) + workerOffset()) + index;
+    }
+
+    SharedSlot *slotAt(void *base, size_t workers, size_t index)
+    {
+        return reinterpret_cast<SharedSlot *>(static_cast<uint8_t *>(base) + slotOffset(workers)) + index;
+    }
+
+    int64_t micros()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now().time_since_epoch()).count();
+    }
+
+    int currentProcess()
+    {
+#if defined(_WIN32)
+        return static_cast<int>(GetCurrentProcessId());
+#else
+        return static_cast<int>(getpid());
+#endif
+    }
+
+    // What the server's sessions do to keys: only changes go through
+    // setKey, so FX0A sees a press and a release
+    void applyKeys(Chip8 &machine, uint16_t keys)
+    {
+        const uint16_t changed = static_cast<uint16_t>(keys ^ machine.keyMask());
+        for (int k = 0; k < 16; ++k)
+        {
+            if (changed & (1u << k))
+                machine.setKey(k, (keys >> k) & 1);
+        }
+    }
+
+    void publish(SharedSlot &slot, const Chip8 &machine)
+    {
+        const uint64_t number = slot.frameCount.load(std::memory_order_relaxed) + 1;
+        SharedFrame &frame = slot.frames[(number - 1) % frameRingSize];
+        frame.seq.store(2 * number - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        frame.flags = static_cast<uint8_t>((machine.isHires() ? 1 : 0) | (machine.beepFlag ? 2 : 0));
+        std::memcpy(frame.gfx, machine.gfx.data(), sizeof frame.gfx);
+        frame.seq.store(2 * number, std::memory_order_release);
+        slot.frameCount.store(number, std::memory_order_release);
+    }
+
+    // Nothing past the mapping: no files, sockets or child processes
+    void lockDown()
+    {
+#if !defined(_WIN32)
+        const rlimit none{0, 0};
+        setrlimit(RLIMIT_NOFILE, &none);
+        setrlimit(RLIMIT_FSIZE, &none);
+        setrlimit(RLIMIT_NPROC, &none);
+        setrlimit(RLIMIT_CORE, &none);
+#endif
+    }
+}
+
+SandboxPool::SandboxPool(const Options &options) : options(options)
+{
+    name = "chip8-sandbox-" + std::to_string(currentProcess());
+}
+
+SandboxPool::~SandboxPool()
+{
+    if (!base)
+        return;
+    for (unsigned w = 0; w < workers.size(); ++w)
+        workerAt(base, w)->stop.store(1, std::memory_order_relaxed);
+    for (unsigned w = 0; w < workers.size(); ++w)
+        kill(w);
+#if defined(_WIN32)
+    UnmapViewOfFile(base);
+    CloseHandle(reinterpret_cast<HANDLE>(mapping));
+    if (job)
+        CloseHandle(reinterpret_cast<HANDLE>(job));
+#else
+    munmap(base, bytes);
+    shm_unlink(("/" + name).c_str());
+#endif
+}
+
+bool SandboxPool::start()
+{
+    if (options.workers == 0 || options.slotsPerWorker == 0 || base)
+        return false;
+    const size_t total = options.workers * options.slotsPerWorker;
+    bytes = slotOffset(options.workers) + total * sizeof(SharedSlot);
+#if defined(_WIN32)
+    HANDLE file = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(uint64_t(bytes) >> 32),
+                                     static_cast<DWORD>(bytes), ("Local\\" + name).c_str());
+    if (!file)
+        return false;
+    mapping = reinterpret_cast<intptr_t>(file);
+    base = MapViewOfFile(file, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+    HANDLE killJob = CreateJobObjectA(nullptr, nullptr);
+    if (killJob)
+    {
+        JOBOBJECT_EXTENDED_LIMIT_INFORMATION limits{};
+        limits.BasicLimitInformation.LimitFlags = JOB_OBJECT_LIMIT_KILL_ON_JOB_CLOSE;
+        SetInformationJobObject(killJob, JobObjectExtendedLimitInformation, &limits, sizeof limits);
+        job = reinterpret_cast<intptr_t>(killJob);
+    }
+#else
+    const std::string path = "/" + name;
+    const int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+        return false;
+    void *mapped = ftruncate(fd, static_cast<off_t>(bytes)) == 0 ? mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)
+                                                                 : MAP_FAILED;
+    ::close(fd);
+    if (mapped != MAP_FAILED)
+        base = mapped;
+    else
+        shm_unlink(path.c_str());
+#endif
+    if (!base)
+        return false;
+
+    // The mapping starts zeroed: every slot free, every counter 0
+    SharedHeader *header = static_cast<SharedHeader *>(base);
+    header->workers = options.workers;
+    header->slotsPerWorker = options.slotsPerWorker;
+    header->ipf = options.ipf;
+    header->hostProcess = currentProcess();
+    header->magic = sharedMagic;
+    workers.assign(options.workers, Worker{});
+    slots.assign(total, HostSlot{});
+    for (unsigned w = 0; w < options.workers; ++w)
+    {
+        if (!spawn(w))
+            return false;
+    }
+    return true;
+}
+
+long SandboxPool::open(const uint8_t *rom, size_t size, uint64_t seed)
+{
+    if (!base || size > romCapacity)
+        return -1;
+    // The worker with the most room takes it
+    long best = -1;
+    size_t bestFree = 0;
+    for (size_t w = 0; w < workers.size(); ++w)
+    {
+        size_t free = 0;
+        long first = -1;
+        for (size_t s = w * options.slotsPerWorker; s < (w + 1) * options.slotsPerWorker; ++s)
+        {
+            if (!slots[s].used)
+            {
+                if (first < 0)
+                    first = static_cast<long>(s);
+                ++free;
+            }
+        }
+        if (free > bestFree)
+        {
+            bestFree = free;
+            best = first;
+        }
+    }
+    if (best < 0)
+        return -1;
+
+    // The slot is free, so its worker doesn't touch it until the state says so
+    SharedSlot &slot = *slotAt(base, workers.size(), static_cast<size_t>(best));
+    std::memcpy(slot.rom, rom, size);
+    slot.romSize = static_cast<uint32_t>(size);
+    slot.seed = seed;
+    slot.keys.store(0, std::memory_order_relaxed);
+    slot.keyTail.store(slot.keyHead.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    slot.frameCount.store(0, std::memory_order_relaxed);
+    slot.state.store(SlotLoad, std::memory_order_release);
+    slots[best] = HostSlot{true, false, false};
+    return best;
+}
+
+void SandboxPool::close(long slot)
+{
+    HostSlot &host = slots[static_cast<size_t>(slot)];
+    if (!host.used || host.closing)
+        return;
+    if (host.faulted)
+    {
+        host = HostSlot{}; // Its worker was replaced, the slot is free already
+        return;
+    }
+    host.closing = true;
+    slotAt(base, workers.size(), static_cast<size_t>(slot))->state.store(SlotClose, std::memory_order_release);
+}
+
+void SandboxPool::setKeys(long slot, uint16_t keys)
+{
+    SharedSlot &shared = *slotAt(base, workers.size(), static_cast<size_t>(slot));
+    shared.keys.store(keys, std::memory_order_release);
+    const uint32_t head = shared.keyHead.load(std::memory_order_relaxed);
+    if (head - shared.keyTail.load(std::memory_order_acquire) >= keyRingSize)
+        return; // The held keys above still arrive
+    shared.keyRing[head % keyRingSize] = keys;
+    shared.keyHead.store(head + 1, std::memory_order_release);
+}
+
+bool SandboxPool::latest(long slot, uint64_t after, Frame &out) const
+{
+    const SharedSlot &shared = *slotAt(base, workers.size(), static_cast<size_t>(slot));
+    for (int attempt = 0; attempt < 3; ++attempt)
+    {
+        const uint64_t number = shared.frameCount.load(std::memory_order_acquire);
+        if (number <= after)
+            return false;
+        const SharedFrame &frame = shared.frames[(number - 1) % frameRingSize];
+        const uint64_t before = frame.seq.load(std::memory_order_acquire);
+        const uint8_t flags = frame.flags;
+        std::memcpy(out.gfx.data(), frame.gfx, sizeof frame.gfx);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (before != 2 * number || frame.seq.load(std::memory_order_relaxed) != before)
+            continue; // The worker came round to it again while it was read
+        out.number = number;
+        out.hires = (flags & 1) != 0;
+        out.sound = (flags & 2) != 0;
+        return true;
+    }
+    return false;
+}
+
+bool SandboxPool::supervise()
+{
+    if (!base)
+        return false;
+    bool anyFaulted = false;
+    const int64_t now = micros();
+    for (unsigned w = 0; w < workers.size(); ++w)
+    {
+        Worker &worker = workers[w];
+        const uint64_t beat = workerAt(base, w)->heartbeat.load(std::memory_order_relaxed);
+        if (beat != worker.lastBeat)
+        {
+            worker.lastBeat = beat;
+            worker.beatSeen = now;
+        }
+        if (alive(w) && now - worker.beatSeen < hangMicros)
+            continue;
+
+        // Its sessions are lost; the slots go back to free for the next worker
+        kill(w);
+        for (size_t s = w * options.slotsPerWorker; s < (w + 1) * options.slotsPerWorker; ++s)
+        {
+            slotAt(base, workers.size(), s)->state.store(SlotFree, std::memory_order_relaxed);
+            HostSlot &host = slots[s];
+            if (host.closing)
+                host = HostSlot{};
+            else if (host.used && !host.faulted)
+            {
+                host.faulted = true;
+                anyFaulted = true;
+            }
+        }
+        spawn(w);
+    }
+
+    for (size_t s = 0; s < slots.size(); ++s)
+    {
+        if (slots[s].closing && slotAt(base, workers.size(), s)->state.load(std::memory_order_acquire) == SlotFree)
+            slots[s] = HostSlot{};
+    }
+    return anyFaulted;
+}
+
+bool SandboxPool::spawn(unsigned index)
+{
+    Worker &worker = workers[index];
+    worker = Worker{};
+    worker.lastBeat = workerAt(base, index)->heartbeat.load(std::memory_order_relaxed);
+    worker.beatSeen = micros();
+    workerAt(base, index)->stop.store(0, std::memory_order_relaxed);
+#if defined(_WIN32)
+    char exe[MAX_PATH];
+    if (!GetModuleFileNameA(nullptr, exe, MAX_PATH))
+        return false;
+    std::string command = "\"" + std::string(exe) + "\" --sandbox-worker " + name + " " + std::to_string(index);
+    STARTUPINFOA startup{};
+    startup.cb = sizeof startup;
+    PROCESS_INFORMATION info{};
+    if (!CreateProcessA(exe, &command[0], nullptr, nullptr, FALSE, CREATE_SUSPENDED | CREATE_NO_WINDOW, nullptr, nullptr,
+                        &startup, &info))
+        return false;
+    if (job)
+        AssignProcessToJobObject(reinterpret_cast<HANDLE>(job), info.hProcess);
+    ResumeThread(info.hThread);
+    CloseHandle(info.hThread);
+    worker.process = reinterpret_cast<intptr_t>(info.hProcess);
+#else
+    const std::string indexText = std::to_string(index);
+    char exe[] = "/proc/self/exe";
+    char flag[] = "--sandbox-worker";
+    char *argv[] = {exe, flag, &name[0], const_cast<char *>(indexText.c_str()), nullptr};
+    pid_t pid = 0;
+    if (posix_spawn(&pid, exe, nullptr, nullptr, argv, environ) != 0)
+        return false;
+    worker.process = pid;
+#endif
+    return true;
+}
+
+void SandboxPool::kill(unsigned index)
+{
+    Worker &worker = workers[index];
+    if (!worker.process)
+        return;
+#if defined(_WIN32)
+    HANDLE process = reinterpret_cast<HANDLE>(worker.process);
+    TerminateProcess(process, 1);
+    WaitForSingleObject(process, INFINITE);
+    CloseHandle(process);
+#else
+    ::kill(static_cast<pid_t>(worker.process), SIGKILL);
+    waitpid(static_cast<pid_t>(worker.process), nullptr, 0);
+#endif
+    worker.process = 0;
+}
+
+bool SandboxPool::alive(unsigned index)
+{
+    Worker &worker = workers[index];
+    if (!worker.process)
+        return false;
+#if defined(_WIN32)
+    return WaitForSingleObject(reinterpret_cast<HANDLE>(worker.process), 0) == WAIT_TIMEOUT;
+#else
+    if (waitpid(static_cast<pid_t>(worker.process), nullptr, WNOHANG) == 0)
+        return true;
+    worker.process = 0; // Reaped
+    return false;
+#endif
+}
+
+int SandboxPool::workerMain(const char *mappingName, unsigned index)
+{
+#if defined(_WIN32)
+    HANDLE file = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, ("Local\\" + std::string(mappingName)).c_str());
+    if (!file)
+        return 1;
+    void *base = MapViewOfFile(file, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!base)
+        return 1;
+#else
+    // Nothing the host had open comes along: not its sockets, not its files
+    const long maxFd = sysconf(_SC_OPEN_MAX);
+    for (int fd = 3; fd < (maxFd > 0 ? maxFd : 1024); ++fd)
+        ::close(fd);
+#if defined(__linux__)
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+#endif
+    const int fd = shm_open(("/" + std::string(mappingName)).c_str(), O_RDWR, 0);
+    if (fd < 0)
+        return 1;
+    SharedHeader probe{};
+    if (pread(fd, &probe, sizeof probe, 0) != static_cast<ssize_t>(sizeof probe) || probe.magic != sharedMagic)
+        return 1;
+    const size_t bytes = slotOffset(probe.workers) + probe.workers * probe.slotsPerWorker * sizeof(SharedSlot);
+    void *base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (base == MAP_FAILED)
+        return 1;
+    if (getppid() != probe.hostProcess)
+        return 1; // The host went before the death signal was set
+#endif
+    lockDown();
+
+    const SharedHeader &header = *static_cast<const SharedHeader *>(base);
+    if (header.magic != sharedMagic || index >= header.workers)
+        return 1;
+    SharedWorker &self = *workerAt(base, index);
+    const size_t first = index * header.slotsPerWorker;
+    std::vector<std::unique_ptr<Chip8>> machines(header.slotsPerWorker);
+
+    Clock::time_point next = Clock::now();
+    while (!self.stop.load(std::memory_order_relaxed))
+    {
+        for (size_t s = 0; s < machines.size(); ++s)
+        {
+            SharedSlot &slot = *slotAt(base, header.workers, first + s);
+            switch (slot.state.load(std::memory_order_acquire))
+            {
+            case SlotLoad:
+            {
+                if (!machines[s])
+                    machines[s] = std::make_unique<Chip8>();
+                machines[s]->loadROM(slot.rom, slot.romSize);
+                machines[s]->seedRandom(slot.seed);
+
+                // The host may have closed it meanwhile, and has to see it freed
+                uint32_t expected = SlotLoad;
+                if (!slot.state.compare_exchange_strong(expected, SlotRunning, std::memory_order_acq_rel))
+                {
+                    machines[s].reset();
+                    slot.state.store(SlotFree, std::memory_order_release);
+                }
+                break;
+            }
+            case SlotRunning:
+            {
+                Chip8 &machine = *machines[s];
+                const uint32_t head = slot.keyHead.load(std::memory_order_acquire);
+                uint32_t tail = slot.keyTail.load(std::memory_order_relaxed);
+                for (; tail != head; ++tail)
+                    applyKeys(machine, slot.keyRing[tail % keyRingSize]);
+                slot.keyTail.store(tail, std::memory_order_release);
+                applyKeys(machine, static_cast<uint16_t>(slot.keys.load(std::memory_order_acquire)));
+                machine.runFrame(header.ipf);
+                publish(slot, machine);
+                break;
+            }
+            case SlotClose:
+                slot.state.store(SlotFree, std::memory_order_release);
+                break;
+            default:
+                break;
+            }
+        }
+        self.heartbeat.fetch_add(1, std::memory_order_relaxed);
+
+        // One sleep a frame for the whole worker; a worker that fell behind
+        // gives up the frames it missed
+        next += std::chrono::microseconds(frameMicros);
+        const Clock::time_point now = Clock::now();
+        if (next < now)
+            next = now;
+        std::this_thread::sleep_until(next);
+    }
+    return 0;
+}
@@ -0,0 +1,102 @@
+#ifndef SANDBOX_POOL_H
+#define SANDBOX_POOL_H
+
+#include <array>   // For a frame's screen
+#include <cstddef> // For size_t
+#include <cstdint> // For keys, seeds and frame numbers
+#include <string>  // For the mapping name
+#include <vector>  // For the workers and slots
+
+// Untrusted sessions in pooled worker processes. The host and its workers
+// share one memory mapping of session slots, and nothing else: a slot
+// carries the ROM and seed in, a ring of key masks and the held keys in,
+// and a ring of finished frames out, with the screen, resolution and
+// buzzer. Each worker runs its slots at 60 Hz on its own clock and the
+// host reads the newest frame when it wants one, so a frame costs no
+// system call on either side. A worker is the host's own executable
+// started again with workerMain's arguments. It can open no files, and a
+// crash or hang takes down only its own slots: the host sees them fault,
+// and starts a new worker for the rest of the pool. POSIX shared memory
+// and posix_spawn on Linux, a named file mapping and a job object on
+// Windows.
+class SandboxPool
+{
+public:
+    struct Options
+    {
+        unsigned workers = 2;
+        size_t slotsPerWorker = 256;
+        int ipf = 10; // Instructions per frame
+    };
+
+    struct Frame
+    {
+        uint64_t number = 0; // Frames the slot has run, this one included
+        bool hires = false;
+        bool sound = false;
+        std::array<uint64_t, 128> gfx{}; // Chip8::gfx layout
+    };
+
+    explicit SandboxPool(const Options &options);
+    ~SandboxPool(); // Stops the workers
+    SandboxPool(const SandboxPool &) = delete;
+    SandboxPool &operator=(const SandboxPool &) = delete;
+
+    // Maps the slots and starts the workers. False if either fails.
+    bool start();
+
+    // A slot running rom from a reset, seeded with seed; -1 if the ROM
+    // doesn't fit or every slot is taken
+    long open(const uint8_t *rom, size_t size, uint64_t seed);
+
+    // Stops the slot; it is given out again once its worker lets go
+    void close(long slot);
+
+    // Held keys, bit k = key k. Every change reaches the machine in order,
+    // so presses shorter than a frame still count.
+    void setKeys(long slot, uint16_t keys);
+
+    // The slot's newest frame if it is newer than after. Safe from any
+    // thread, one caller per slot at a time.
+    bool latest(long slot, uint64_t after, Frame &out) const;
+
+    // The slot's worker crashed or hung; close it
+    bool faulted(long slot) const { return slots[static_cast<size_t>(slot)].faulted; }
+
+    // Reaps and restarts dead or hung workers, and frees closed slots.
+    // Call from the host's loop; true if any slot faulted.
+    bool supervise();
+
+    // A worker's whole life; chip8-server calls it for --sandbox-worker
+    static int workerMain(const char *mapping, unsigned index);
+
+private:
+    struct Worker
+    {
+        intptr_t process = 0; // pid, or a process handle on Windows
+        uint64_t lastBeat = 0;
+        int64_t beatSeen = 0; // Microseconds on the host's clock
+    };
+
+    struct HostSlot
+    {
+        bool used = false;
+        bool closing = false;
+        bool faulted = false;
+    };
+
+    bool spawn(unsigned index);
+    void kill(unsigned index);
+    bool alive(unsigned index);
+
+    Options options;
+    std::string name;
+    void *base = nullptr;
+    size_t bytes = 0;
+    intptr_t mapping = 0; // File mapping handle on Windows
+    intptr_t job = 0;     // Windows job that takes the workers down with the host
+    std::vector<Worker> workers;
+    std::vector<HostSlot> slots;
+};
+
+#endif
@@ -0,0 +1,101 @@
+#ifndef SCREEN_BACKEND_H
+#define SCREEN_BACKEND_H
+
+#include "chip8.h"
+#include "megachip.h"
+#include <array>   // For the framebuffer and palette
+#include <cstdint> // For framebuffer words
+
+// Draws the CHIP-8 screen into a window, one implementation per graphics
+// API. All calls come from the GUI thread; OpenGL backends also need the
+// canvas context current, including for the destructor.
+class ScreenBackend
+{
+public:
+    using Framebuffer = std::array<uint64_t, 64 * Chip8::rowWords>;
+    using Color = std::array<float, 3>;
+
+    // Pixel-art filters that round off the staircase of diagonal edges
+    enum class Upscaler
+    {
+        None,
+        Scale2x, // EPX: each quarter pixel from its two neighbours
+        Xbr      // xBR level 1: corners cut along detected edges, anti-aliased
+    };
+
+    struct Effects
+    {
+        bool scanlines = false; // Dark gaps between pixel rows
+        bool phosphor = false;  // Unlit pixels fade out over a few frames, hiding flicker
+        bool bloom = false;     // Lit pixels glow into their neighbours
+        Upscaler upscaler = Upscaler::None;
+    };
+
+    virtual ~ScreenBackend() = default;
+
+    // Creates the device objects. False if this system can't run the
+    // backend; it is unusable then.
+    virtual bool init() = 0;
+    virtual const char *name() const = 0;
+
+    // Window client size in pixels, the picture is stretched over all of it
+    virtual void resize(int width, int height) = 0;
+
+    // Takes the framebuffer, re-uploading only if it changed
+    virtual void upload(const Framebuffer &gfx) = 0;
+
+    // Draw at the largest whole multiple of the CHIP-8 resolution that
+    // fits, centred on black, rather than stretched over the window
+    virtual void setIntegerScale(bool) {}
+
+    // Take the monitor over exclusively, for a window covering it. False
+    // if the backend can't; a borderless window over the whole monitor
+    // still skips the compositor when its swap chain flips.
+    virtual bool setExclusive(bool) { return false; }
+
+    // Picture inside a width x height window, scale is a whole number
+    struct Viewport
+    {
+        int x = 0;
+        int y = 0;
+        int width = 0;
+        int height = 0;
+    };
+    static Viewport integerViewport(int width, int height, bool hires)
+    {
+        return integerViewport(width, height, hires ? 128 : 64, hires ? 64 : 32);
+    }
+    static Viewport integerViewport(int width, int height, int columns, int rows)
+    {
+        int scale = width / columns < height / rows ? width / columns : height / rows;
+        if (scale < 1)
+            return {0, 0, width, height};
+        return {(width - columns * scale) / 2, (height - rows * scale) / 2, columns * scale, rows * scale};
+    }
+
+    virtual bool supportsEffects() const { return false; }
+    virtual void setEffects(const Effects &) {}
+
+    // Draws the uploaded frame, lo-res frames from its top-left 64x32
+    // pixels. newFrame says the emulation moved on since the last draw.
+    virtual void draw(bool hires, const Color &off, const Color &on, bool newFrame) = 0;
+
+    // MEGA-CHIP's screen of palette indices, uploaded as it is with its
+    // palette rather than expanded to colours. False if the backend can't
+    // draw one, and then the caller has to convert it.
+    virtual bool uploadIndexed(const MegaChip8::Screen &, const MegaChip8::Palette &) { return false; }
+
+    // Draws the uploaded indexed frame, its top-left columns x rows (what
+    // the machine's mode uses), each colour scaled by alpha out of 255
+    virtual void drawIndexed(int, int, uint8_t) {}
+
+    // Shows the drawn frame. False if the device was lost and the backend
+    // has to be created again.
+    virtual bool present() = 0;
+
+    // True while the window can't be seen at all, so drawing is wasted.
+    // Only backends the system tells (DXGI's presentation status) know.
+    virtual bool occluded() { return false; }
+};
+
+#endif
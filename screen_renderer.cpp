@@ -0,0 +1,564 @@
+#include "screen_renderer.h"
+#include "gl_functions.h"
+#include <memory>  // For the shared programs
+#include <string>  // For joining shader sources
+#include <utility> // For std::move
+
+namespace
+{
+    const char *vertexSource = R"(#version 330 core
+layout(location = 0) in vec2 position;
+out vec2 uv;
+void main()
+{
+    uv = vec2(position.x * 0.5 + 0.5, 0.5 - position.y * 0.5);
+    gl_Position = vec4(position, 0.0, 1.0);
+}
+)";
+
+    // Rows are two 64-bit words with the leftmost pixel in the top bit.
+    // Read as 32-bit texels on a little-endian host the halves of each word
+    // swap places, hence texel = group ^ 1.
+    const char *plainSource = R"(#version 330 core
+uniform usampler2D screen;
+uniform vec2 extent;
+uniform vec3 palette[2];
+in vec2 uv;
+out vec4 color;
+float upscaled(vec2 pos);
+float pixelAt(ivec2 p)
+{
+    if (any(lessThan(p, ivec2(0))) || any(greaterThanEqual(p, ivec2(extent))))
+        return 0.0;
+    uint bits = texelFetch(screen, ivec2((p.x >> 5) ^ 1, p.y), 0).r;
+    return float((bits >> uint(31 - (p.x & 31))) & 1u);
+}
+void main()
+{
+    color = vec4(mix(palette[0], palette[1], upscaled(uv * extent)), 1.0);
+}
+)";
+
+    // MEGA-CHIP: one normalized byte per pixel, the index into a row of
+    // palette texels
+    const char *indexedSource = R"(#version 330 core
+uniform sampler2D indices;
+uniform sampler2D colours;
+uniform vec2 extent;
+uniform float alpha;
+in vec2 uv;
+out vec4 color;
+void main()
+{
+    ivec2 p = min(ivec2(uv * extent), ivec2(extent) - 1);
+    int index = int(texelFetch(indices, p, 0).r * 255.0 + 0.5);
+    color = vec4(texelFetch(colours, ivec2(index, 0), 0).rgb * alpha, 1.0);
+}
+)";
+
+    // The offscreen passes work at one texel per CHIP-8 pixel, row 0 at
+    // the top, so every pass addresses its input by gl_FragCoord.
+
+    // Lit pixels at full intensity, unlit ones fade from the previous frame
+    const char *persistSource = R"(#version 330 core
+uniform usampler2D screen;
+uniform sampler2D previous;
+uniform float decay;
+out vec4 color;
+void main()
+{
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    uint bits = texelFetch(screen, ivec2((p.x >> 5) ^ 1, p.y), 0).r;
+    float lit = float((bits >> uint(31 - (p.x & 31))) & 1u);
+    float faded = texelFetch(previous, p, 0).r * decay;
+    color = vec4(max(lit, faded < 0.02 ? 0.0 : faded), 0.0, 0.0, 1.0);
+}
+)";
+
+    // One direction of a 9-tap Gaussian, clamped to the screen
+    const char *blurSource = R"(#version 330 core
+uniform sampler2D source;
+uniform ivec2 direction;
+uniform vec2 extent;
+out vec4 color;
+void main()
+{
+    const float weights[5] = float[](0.227027, 0.194595, 0.121622, 0.054054, 0.016216);
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 last = ivec2(extent) - 1;
+    float sum = texelFetch(source, p, 0).r * weights[0];
+    for (int i = 1; i < 5; ++i)
+    {
+        sum += weights[i] * texelFetch(source, clamp(p + direction * i, ivec2(0), last), 0).r;
+        sum += weights[i] * texelFetch(source, clamp(p - direction * i, ivec2(0), last), 0).r;
+    }
+    color = vec4(sum, 0.0, 0.0, 1.0);
+}
+)";
+
+    // Palette, glow and scanlines at window resolution
+    const char *compositeSource = R"(#version 330 core
+uniform sampler2D image;
+uniform sampler2D glow;
+uniform vec2 extent;
+uniform vec3 palette[2];
+uniform float bloom;
+uniform float scanlines;
+in vec2 uv;
+out vec4 color;
+float upscaled(vec2 pos);
+float pixelAt(ivec2 p)
+{
+    if (any(lessThan(p, ivec2(0))) || any(greaterThanEqual(p, ivec2(extent))))
+        return 0.0;
+    return texelFetch(image, p, 0).r;
+}
+void main()
+{
+    vec2 pos = uv * extent;
+    vec3 c = mix(palette[0], palette[1], upscaled(pos));
+    vec2 glowPos = clamp(pos, vec2(0.5), extent - 0.5) / vec2(textureSize(glow, 0));
+    c += palette[1] * texture(glow, glowPos).r * bloom;
+    c *= 1.0 - scanlines * (1.0 - sin(fract(pos.y) * 3.14159265));
+    color = vec4(c, 1.0);
+}
+)";
+
+    // Appended to the plain and composite shaders, which define pixelAt
+    // (a pixel's intensity, 0 off the screen) and extent. The filters work
+    // at window resolution straight from the CHIP-8 pixels, so they cost
+    // no passes or targets, and on intensities, so phosphor trails and
+    // their edges get rounded off too.
+    const char *upscaleSource = R"(
+uniform int upscaler; // 0 none, 1 Scale2x, 2 xBR
+bool same(float a, float b) { return abs(a - b) < 0.1; }
+float at(ivec2 p, int x, int y) { return pixelAt(p + ivec2(x, y)); }
+
+// Scale2x: the quarter of p towards d takes its two neighbours on that
+// side when they agree with each other and not with the sides opposite
+float scale2x(ivec2 p, ivec2 d)
+{
+    float h = at(p, d.x, 0), v = at(p, 0, d.y);
+    if (same(h, v) && !same(h, at(p, 0, -d.y)) && !same(v, at(p, -d.x, 0)))
+        return v;
+    return pixelAt(p);
+}
+
+// xBR level 1 for the corner of E = p towards d, with the neighbours
+// named as in the reference, seen from that corner:
+//         B
+//      D  E  F  F4
+//      G  H  I  I4
+//            H5 I5  (C is above F, G left of H)
+// If the edge across the corner is weaker than along it, the part of E
+// beyond the line through the middles of its two sides takes their
+// value, blended over one window pixel (width).
+float xbr(ivec2 p, ivec2 d, vec2 q, float width)
+{
+    float E = pixelAt(p), F = at(p, d.x, 0), H = at(p, 0, d.y);
+    if (same(E, F) || same(E, H))
+        return E;
+    float I = at(p, d.x, d.y), B = at(p, 0, -d.y), D = at(p, -d.x, 0);
+    float C = at(p, d.x, -d.y), G = at(p, -d.x, d.y);
+    float F4 = at(p, 2 * d.x, 0), I4 = at(p, 2 * d.x, d.y), H5 = at(p, 0, 2 * d.y), I5 = at(p, d.x, 2 * d.y);
+    float across = abs(E - C) + abs(E - G) + abs(I - H5) + abs(I - F4) + 4.0 * abs(H - F);
+    float along = abs(H - D) + abs(H - I5) + abs(F - I4) + abs(F - B) + 4.0 * abs(E - I);
+    bool keep = (!same(F, B) && !same(H, D)) || (same(E, I) && !same(F, I4) && !same(H, I5)) || same(E, G) || same(E, C);
+    if (across >= along || !keep)
+        return E;
+    float side = abs(E - F) <= abs(E - H) ? F : H;
+    float beyond = dot(q, vec2(d)) - 0.5;
+    return mix(E, side, smoothstep(-0.5 * width, 0.5 * width, beyond));
+}
+
+// Value at pos in CHIP-8 pixels, q its place inside the pixel
+float upscaled(vec2 pos)
+{
+    ivec2 p = min(ivec2(pos), ivec2(extent) - 1);
+    vec2 q = pos - vec2(p) - 0.5;
+    ivec2 d = ivec2(q.x < 0.0 ? -1 : 1, q.y < 0.0 ? -1 : 1);
+    vec2 width = fwidth(pos);
+    if (upscaler == 1)
+        return scale2x(p, d);
+    if (upscaler == 2)
+        return xbr(p, d, q, width.x + width.y);
+    return pixelAt(p);
+}
+)";
+
+    const float phosphorDecay = 0.55f; // Intensity kept per emulated frame
+    const float bloomStrength = 1.0f;
+    const float scanlineDepth = 0.35f; // Darkening between rows
+
+    // Program from the shared vertex shader and a fragment shader, 0 on failure
+    unsigned link(const char *fragmentSource) { return linkGlProgram(vertexSource, fragmentSource); }
+
+    // The same with the upscalers appended
+    unsigned linkUpscaled(const char *fragmentSource)
+    {
+        return link((std::string(fragmentSource) + upscaleSource).c_str());
+    }
+
+    void setSampler(unsigned program, const char *name, int unit)
+    {
+        gl.UseProgram(program);
+        gl.Uniform1i(gl.GetUniformLocation(program, name), unit);
+    }
+}
+
+// The programs, their uniforms and the quad
+struct ScreenRenderer::Shared
+{
+    unsigned plainProgram = 0;     // Bits straight to palette colours
+    unsigned persistProgram = 0;   // Bits to intensity, with phosphor decay
+    unsigned blurProgram = 0;      // One direction of the bloom blur
+    unsigned compositeProgram = 0; // Intensity, glow and scanlines to the window
+    unsigned indexedProgram = 0;   // MEGA-CHIP indices to palette colours
+    unsigned vertexArray = 0;
+    unsigned vertexBuffer = 0;
+    int plainExtent = -1;
+    int plainPalette = -1;
+    int plainUpscaler = -1;
+    int persistDecay = -1;
+    int blurDirection = -1;
+    int blurExtent = -1;
+    int compositeExtent = -1;
+    int compositePalette = -1;
+    int compositeBloom = -1;
+    int compositeScanlines = -1;
+    int compositeUpscaler = -1;
+    int indexedExtent = -1;
+    int indexedAlpha = -1;
+
+    ~Shared()
+    {
+        // Anything created before a failed build() goes too
+        if (vertexBuffer)
+            gl.DeleteBuffers(1, &vertexBuffer);
+        if (vertexArray)
+            gl.DeleteVertexArrays(1, &vertexArray);
+        for (unsigned program : {plainProgram, persistProgram, blurProgram, compositeProgram, indexedProgram})
+        {
+            if (program)
+                gl.DeleteProgram(program);
+        }
+    }
+
+    bool build()
+    {
+        plainProgram = linkUpscaled(plainSource);
+        persistProgram = link(persistSource);
+        blurProgram = link(blurSource);
+        compositeProgram = linkUpscaled(compositeSource);
+        indexedProgram = link(indexedSource);
+        if (!plainProgram || !persistProgram || !blurProgram || !compositeProgram || !indexedProgram)
+            return false;
+
+        // The integer screen texture stays on unit 0, pass inputs go on 1 and 2
+        setSampler(plainProgram, "screen", 0);
+        setSampler(persistProgram, "screen", 0);
+        setSampler(persistProgram, "previous", 1);
+        setSampler(blurProgram, "source", 1);
+        setSampler(compositeProgram, "image", 1);
+        setSampler(compositeProgram, "glow", 2);
+        setSampler(indexedProgram, "indices", 1);
+        setSampler(indexedProgram, "colours", 2);
+        plainExtent = gl.GetUniformLocation(plainProgram, "extent");
+        plainPalette = gl.GetUniformLocation(plainProgram, "palette");
+        plainUpscaler = gl.GetUniformLocation(plainProgram, "upscaler");
+        persistDecay = gl.GetUniformLocation(persistProgram, "decay");
+        blurDirection = gl.GetUniformLocation(blurProgram, "direction");
+        blurExtent = gl.GetUniformLocation(blurProgram, "extent");
+        compositeExtent = gl.GetUniformLocation(compositeProgram, "extent");
+        compositePalette = gl.GetUniformLocation(compositeProgram, "palette");
+        compositeBloom = gl.GetUniformLocation(compositeProgram, "bloom");
+        compositeScanlines = gl.GetUniformLocation(compositeProgram, "scanlines");
+        compositeUpscaler = gl.GetUniformLocation(compositeProgram, "upscaler");
+        indexedExtent = gl.GetUniformLocation(indexedProgram, "extent");
+        indexedAlpha = gl.GetUniformLocation(indexedProgram, "alpha");
+
+        // One full-viewport quad as a triangle strip
+        const GLfloat corners[] = {-1.0f, -1.0f, 1.0f, -1.0f, -1.0f, 1.0f, 1.0f, 1.0f};
+        gl.GenVertexArrays(1, &vertexArray);
+        gl.BindVertexArray(vertexArray);
+        gl.GenBuffers(1, &vertexBuffer);
+        gl.BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+        gl.BufferData(GL_ARRAY_BUFFER, sizeof corners, corners, GL_STATIC_DRAW);
+        gl.VertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, nullptr);
+        gl.EnableVertexAttribArray(0);
+        return true;
+    }
+};
+
+ScreenRenderer::ScreenRenderer(std::function<void()> swap, SharedCache *sharedCache)
+    : swapBuffers(std::move(swap)), cache(sharedCache)
+{
+}
+
+ScreenRenderer::~ScreenRenderer()
+{
+    // Anything created before a failed init() goes too
+    if (texture)
+        glDeleteTextures(1, &texture);
+    for (unsigned made : {indexTexture, paletteTexture})
+    {
+        if (made)
+            glDeleteTextures(1, &made);
+    }
+    for (const Target &target : targets)
+    {
+        if (target.framebuffer)
+            gl.DeleteFramebuffers(1, &target.framebuffer);
+        if (target.texture)
+            glDeleteTextures(1, &target.texture);
+    }
+}
+
+bool ScreenRenderer::init()
+{
+    if (ready)
+        return true;
+    if (!loadGlFunctions())
+        return false;
+
+    // Only errors raised from here on decide whether this worked
+    for (int i = 0; i < 16 && glGetError() != GL_NO_ERROR; ++i)
+    {
+    }
+
+    // Another window on this context may have built the programs already
+    if (cache)
+        shared = cache->lock();
+    if (!shared)
+    {
+        std::shared_ptr<Shared> built = std::make_shared<Shared>();
+        if (!built->build())
+            return false;
+        shared = built;
+        if (cache)
+            *cache = shared;
+    }
+
+    // 128x64 pixels as 4x64 32-bit texels, integer textures only filter nearest
+    gl.ActiveTexture(GL_TEXTURE0);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32UI, 4, 64, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    // Effect targets, one float intensity per CHIP-8 pixel, made once and reused
+    gl.ActiveTexture(GL_TEXTURE1);
+    for (Target &target : targets)
+    {
+        glGenTextures(1, &target.texture);
+        glBindTexture(GL_TEXTURE_2D, target.texture);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R16F, 128, 64, 0, GL_RED, GL_FLOAT, nullptr);
+
+        gl.GenFramebuffers(1, &target.framebuffer);
+        gl.BindFramebuffer(GL_FRAMEBUFFER, target.framebuffer);
+        gl.FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target.texture, 0);
+        bool complete = gl.CheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        if (!complete)
+        {
+            gl.BindFramebuffer(GL_FRAMEBUFFER, 0);
+            return false;
+        }
+    }
+    gl.BindFramebuffer(GL_FRAMEBUFFER, 0);
+    gl.ActiveTexture(GL_TEXTURE0);
+
+    ready = glGetError() == GL_NO_ERROR;
+    stale = true;
+    return ready;
+}
+
+void ScreenRenderer::upload(const Framebuffer &gfx)
+{
+    if (!stale && gfx == uploaded)
+        return;
+    uploaded = gfx;
+    stale = false;
+    gl.ActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 4, 64, GL_RED_INTEGER, GL_UNSIGNED_INT, uploaded.data());
+}
+
+void ScreenRenderer::resize(int width, int height)
+{
+    windowWidth = width;
+    windowHeight = height;
+    glViewport(0, 0, width, height);
+}
+
+void ScreenRenderer::setEffects(const Effects &newEffects)
+{
+    // Rebuild the targets from the current frame rather than stale passes
+    if (newEffects.phosphor != effects.phosphor || newEffects.bloom != effects.bloom)
+        targetsStale = true;
+    effects = newEffects;
+}
+
+void ScreenRenderer::draw(bool hires, const Color &off, const Color &on, bool newFrame)
+{
+    const GLfloat palette[6] = {off[0], off[1], off[2], on[0], on[1], on[2]};
+    const float width = hires ? 128.0f : 64.0f;
+    const float height = hires ? 64.0f : 32.0f;
+    gl.BindVertexArray(shared->vertexArray);
+    gl.ActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+
+    // Bars around a whole-number scale, the passes below keep the viewport
+    glViewport(0, 0, windowWidth, windowHeight);
+    if (integerScale)
+    {
+        const Viewport picture = integerViewport(windowWidth, windowHeight, hires);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glViewport(picture.x, picture.y, picture.width, picture.height);
+    }
+
+    if (!effects.scanlines && !effects.phosphor && !effects.bloom)
+    {
+        gl.UseProgram(shared->plainProgram);
+        gl.Uniform2f(shared->plainExtent, width, height);
+        gl.Uniform3fv(shared->plainPalette, 2, palette);
+        gl.Uniform1i(shared->plainUpscaler, static_cast<GLint>(effects.upscaler));
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        return;
+    }
+
+    // Switching resolution leaves the other mode's pixels in the targets
+    if (hires != targetHires)
+    {
+        targetHires = hires;
+        targetsStale = true;
+    }
+
+    if (newFrame || targetsStale)
+    {
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        glViewport(0, 0, static_cast<GLsizei>(width), static_cast<GLsizei>(height));
+
+        // Phosphor: decode the bits, keeping a decaying copy of the last frame
+        Target &previous = targets[current];
+        current ^= 1;
+        gl.BindFramebuffer(GL_FRAMEBUFFER, targets[current].framebuffer);
+        gl.UseProgram(shared->persistProgram);
+        gl.Uniform1f(shared->persistDecay, effects.phosphor && !targetsStale ? phosphorDecay : 0.0f);
+        gl.ActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, previous.texture);
+        glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+
+        // Bloom: blur across, then down
+        if (effects.bloom)
+        {
+            gl.UseProgram(shared->blurProgram);
+            gl.Uniform2f(shared->blurExtent, width, height);
+            gl.BindFramebuffer(GL_FRAMEBUFFER, targets[2].framebuffer);
+            gl.Uniform2i(shared->blurDirection, 1, 0);
+            glBindTexture(GL_TEXTURE_2D, targets[current].texture);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+            gl.BindFramebuffer(GL_FRAMEBUFFER, targets[3].framebuffer);
+            gl.Uniform2i(shared->blurDirection, 0, 1);
+            glBindTexture(GL_TEXTURE_2D, targets[2].texture);
+            glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+        }
+
+        gl.BindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+        targetsStale = false;
+    }
+
+    gl.UseProgram(shared->compositeProgram);
+    gl.Uniform2f(shared->compositeExtent, width, height);
+    gl.Uniform3fv(shared->compositePalette, 2, palette);
+    gl.Uniform1f(shared->compositeBloom, effects.bloom ? bloomStrength : 0.0f);
+    gl.Uniform1f(shared->compositeScanlines, effects.scanlines ? scanlineDepth : 0.0f);
+    gl.Uniform1i(shared->compositeUpscaler, static_cast<GLint>(effects.upscaler));
+    gl.ActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, targets[current].texture);
+    gl.ActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, targets[3].texture);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    gl.ActiveTexture(GL_TEXTURE0);
+}
+
+bool ScreenRenderer::uploadIndexed(const MegaChip8::Screen &screen, const MegaChip8::Palette &palette)
+{
+    if (!ready)
+        return false;
+    const bool created = indexTexture == 0;
+    if (created)
+    {
+        gl.ActiveTexture(GL_TEXTURE1);
+        for (unsigned *made : {&indexTexture, &paletteTexture})
+        {
+            glGenTextures(1, made);
+            glBindTexture(GL_TEXTURE_2D, *made);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        }
+        glBindTexture(GL_TEXTURE_2D, indexTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, MegaChip8::screenWidth, MegaChip8::screenHeight, 0, GL_RED, GL_UNSIGNED_BYTE, nullptr);
+        glBindTexture(GL_TEXTURE_2D, paletteTexture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 256, 1, 0, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, nullptr);
+    }
+
+    // 48 KB of indices a frame; the palette only when a program loads one.
+    // ARGB words read as BGRA from the low byte up.
+    gl.ActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, indexTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, MegaChip8::screenWidth, MegaChip8::screenHeight, GL_RED, GL_UNSIGNED_BYTE, screen.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    if (created || palette != uploadedPalette)
+    {
+        uploadedPalette = palette;
+        glBindTexture(GL_TEXTURE_2D, paletteTexture);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 256, 1, GL_BGRA, GL_UNSIGNED_INT_8_8_8_8_REV, uploadedPalette.data());
+    }
+    gl.ActiveTexture(GL_TEXTURE0);
+    return true;
+}
+
+void ScreenRenderer::drawIndexed(int columns, int rows, uint8_t alpha)
+{
+    if (!indexTexture)
+        return;
+    gl.BindVertexArray(shared->vertexArray);
+    glViewport(0, 0, windowWidth, windowHeight);
+    if (integerScale)
+    {
+        const Viewport picture = integerViewport(windowWidth, windowHeight, columns, rows);
+        glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+        glClear(GL_COLOR_BUFFER_BIT);
+        glViewport(picture.x, picture.y, picture.width, picture.height);
+    }
+    gl.UseProgram(shared->indexedProgram);
+    gl.Uniform2f(shared->indexedExtent, static_cast<float>(columns), static_cast<float>(rows));
+    gl.Uniform1f(shared->indexedAlpha, alpha / 255.0f);
+    gl.ActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, indexTexture);
+    gl.ActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, paletteTexture);
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+    gl.ActiveTexture(GL_TEXTURE0);
+}
+
+bool ScreenRenderer::present()
+{
+    swapBuffers();
+    return true;
+}
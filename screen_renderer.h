@@ -0,0 +1,86 @@
+#ifndef SCREEN_RENDERER_H
+#define SCREEN_RENDERER_H
+
+#include "screen_backend.h"
+#include <functional> // For the swap callback
+#include <memory>     // For the shared programs
+
+// OpenGL 3.3 core profile renderer for the CHIP-8 display. The packed
+// framebuffer words go straight into an integer texture and the fragment
+// shader picks each pixel's bit and looks its colour up in a palette
+// uniform, so a frame costs one 1 KB upload and palette changes are free.
+// Optional CRT effects run as extra passes through offscreen targets at
+// CHIP-8 resolution; the Scale2x and xBR upscalers run in the final pass.
+// Everything is created once in init(); the GL context has to be current
+// for every call, including the destructor.
+class ScreenRenderer : public ScreenBackend
+{
+public:
+    // The shader programs and quad, which every renderer on one GL context
+    // can use. The first to start builds them and the last to go deletes
+    // them, with the context current as always.
+    struct Shared;
+    using SharedCache = std::weak_ptr<Shared>;
+
+    // swap shows the back buffer, the GL canvas owns that. Renderers given
+    // the same cache, kept with their context, build the shaders once.
+    explicit ScreenRenderer(std::function<void()> swap, SharedCache *cache = nullptr);
+    ~ScreenRenderer() override;
+
+    ScreenRenderer(const ScreenRenderer &) = delete;
+    ScreenRenderer &operator=(const ScreenRenderer &) = delete;
+
+    // Loads the GL entry points and builds the shaders, quad and textures
+    bool init() override;
+    const char *name() const override { return "OpenGL 3.3"; }
+
+    void resize(int width, int height) override;
+    void upload(const Framebuffer &gfx) override;
+
+    void setIntegerScale(bool on) override { integerScale = on; }
+
+    bool supportsEffects() const override { return true; }
+    void setEffects(const Effects &newEffects) override;
+
+    // The effect passes only step on a new frame, so trails fade at the
+    // emulation's 60 Hz whatever the monitor's refresh rate
+    void draw(bool hires, const Color &off, const Color &on, bool newFrame) override;
+
+    // An 8-bit index texture and a 256x1 palette texture, looked up in
+    // the shader; the textures are made on the first upload
+    bool uploadIndexed(const MegaChip8::Screen &screen, const MegaChip8::Palette &palette) override;
+    void drawIndexed(int columns, int rows, uint8_t alpha) override;
+
+    bool present() override;
+
+private:
+    struct Target
+    {
+        unsigned framebuffer = 0;
+        unsigned texture = 0;
+    };
+
+    std::function<void()> swapBuffers;
+    SharedCache *cache;
+    std::shared_ptr<Shared> shared;
+    bool ready = false;
+    unsigned texture = 0;
+    Framebuffer uploaded{};
+    bool stale = true; // Texture contents undefined until the first upload
+    int windowWidth = 0;
+    int windowHeight = 0;
+    bool integerScale = false;
+
+    // [0] and [1] alternate as the phosphor image, [2] and [3] hold the blur
+    std::array<Target, 4> targets{};
+    int current = 0;
+    Effects effects;
+    bool targetHires = false;
+    bool targetsStale = true;
+
+    unsigned indexTexture = 0;   // MEGA-CHIP screen, 0 until the first uploadIndexed
+    unsigned paletteTexture = 0; // Its colours
+    MegaChip8::Palette uploadedPalette{};
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "screenshot_writer.h"
+#include "chip8_simd.h"
+#include <algorithm> // For std::clamp
+#include <cstdio>    // For the file
+#include <zlib.h>    // For IDAT and the chunk CRCs
+
+namespace
+{
+    void putU32(std::vector<uint8_t> &out, uint32_t value)
+    {
+        out.push_back(static_cast<uint8_t>(value >> 24));
+        out.push_back(static_cast<uint8_t>(value >> 16));
+        out.push_back(static_cast<uint8_t>(value >> 8));
+        out.push_back(static_cast<uint8_t>(value));
+    }
+
+    // Length, type, data and the CRC of type and data
+    void putChunk(std::vector<uint8_t> &out, const char type[4], const uint8_t *data, size_t size)
+    {
+        putU32(out, static_cast<uint32_t>(size));
+        const size_t start = out.size();
+        out.insert(out.end(), type, type + 4);
+        out.insert(out.end(), data, data + size);
+        putU32(out, static_cast<uint32_t>(crc32(0, &out[start], static_cast<uInt>(4 + size))));
+    }
+}
+
+ScreenshotWriter::~ScreenshotWriter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    if (encoder.joinable())
+        encoder.join();
+}
+
+ScreenshotWriter &ScreenshotWriter::shared()
+{
+    static ScreenshotWriter writer;
+    return writer;
+}
+
+bool ScreenshotWriter::submit(Screenshot shot)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (pending.size() >= maxPending)
+        return false;
+    if (!encoder.joinable())
+        encoder = std::thread(&ScreenshotWriter::encodeLoop, this);
+    pending.push_back(std::move(shot));
+    wake.notify_one();
+    return true;
+}
+
+uint64_t ScreenshotWriter::writes() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return writeCount;
+}
+
+uint64_t ScreenshotWriter::failures() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    return failureCount;
+}
+
+void ScreenshotWriter::encodeLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        wake.wait(lock, [this]
+                  { return stopping || !pending.empty(); });
+        if (pending.empty())
+            return; // Stopping with everything saved
+        Screenshot shot = std::move(pending.front());
+        pending.pop_front();
+        lock.unlock();
+
+        const std::vector<uint8_t> png = encodePng(shot);
+        bool ok = !png.empty();
+        if (ok)
+        {
+            std::FILE *file = std::fopen(shot.path.c_str(), "wb");
+            ok = file && std::fwrite(png.data(), 1, png.size(), file) == png.size();
+            if (file)
+                ok = std::fclose(file) == 0 && ok;
+        }
+
+        lock.lock();
+        ++(ok ? writeCount : failureCount);
+    }
+}
+
+std::vector<uint8_t> ScreenshotWriter::encodePng(const Screenshot &shot)
+{
+    const int scale = std::clamp(shot.scale, 1, maxScale);
+    const size_t width = (shot.hires ? 128 : 64) * static_cast<size_t>(scale);
+    const size_t height = (shot.hires ? 64 : 32) * static_cast<size_t>(scale);
+
+    // Every row is a filter byte (0, none) and a palette index per pixel.
+    // The rows are expanded one filter byte apart, so no copy is needed.
+    std::vector<uint8_t> rows((width + 1) * height, 0);
+    simd::expandFrame(rows.data() + 1, width + 1, shot.gfx.data(), Chip8::rowWords, width / scale, height / scale, 0, 1, scale);
+
+    uLongf packedSize = compressBound(static_cast<uLong>(rows.size()));
+    std::vector<uint8_t> packed(packedSize);
+    if (compress2(packed.data(), &packedSize, rows.data(), static_cast<uLong>(rows.size()), Z_DEFAULT_COMPRESSION) != Z_OK)
+        return {};
+
+    std::vector<uint8_t> out = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    std::vector<uint8_t> header;
+    putU32(header, static_cast<uint32_t>(width));
+    putU32(header, static_cast<uint32_t>(height));
+    header.insert(header.end(), {8, 3, 0, 0, 0}); // 8-bit, indexed, deflate, adaptive filters, no interlace
+    putChunk(out, "IHDR", header.data(), header.size());
+    const uint8_t palette[6] = {shot.off[0], shot.off[1], shot.off[2], shot.on[0], shot.on[1], shot.on[2]};
+    putChunk(out, "PLTE", palette, sizeof palette);
+    putChunk(out, "IDAT", packed.data(), packedSize);
+    putChunk(out, "IEND", nullptr, 0);
+    return out;
+}
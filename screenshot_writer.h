@@ -0,0 +1,67 @@
+#ifndef SCREENSHOT_WRITER_H
+#define SCREENSHOT_WRITER_H
+
+#include "chip8.h"
+#include <array>              // For the screen and colours
+#include <condition_variable> // For the idle encoder
+#include <cstdint>            // For the counters
+#include <deque>              // For the queue
+#include <mutex>              // For the queue
+#include <string>             // For paths
+#include <thread>             // For the encoder thread
+#include <vector>             // For the PNG bytes
+
+// One screen to save: the bit-packed framebuffer as the GUI got it, the
+// colours it was shown in and the size to save it at
+struct Screenshot
+{
+    std::array<uint64_t, 64 * Chip8::rowWords> gfx{};
+    bool hires = false;
+    std::array<uint8_t, 3> off{};                 // RGB of unlit pixels
+    std::array<uint8_t, 3> on{{255, 255, 255}};   // And of lit ones
+    int scale = 1;                                // 1 to maxScale output pixels per CHIP-8 pixel
+    std::string path;
+};
+
+// Saves screenshots as PNG files on a thread of its own. The caller hands
+// over a copy of the screen, 1 KB, and returns at once; the thread expands
+// it with simd::expandFrame, deflates it and writes the file, so neither
+// the emulation nor the presenting thread waits on encoding or the disk.
+// The PNG is 8-bit indexed with a two-colour palette, which keeps even a
+// large scale to a few kilobytes.
+class ScreenshotWriter
+{
+public:
+    static constexpr int maxScale = 16;
+    static constexpr size_t maxPending = 8; // Screenshots queued beyond this are refused
+
+    ScreenshotWriter() = default;
+    ~ScreenshotWriter(); // Saves what is still queued
+    ScreenshotWriter(const ScreenshotWriter &) = delete;
+    ScreenshotWriter &operator=(const ScreenshotWriter &) = delete;
+
+    static ScreenshotWriter &shared();
+
+    // Queues shot and starts the thread with the first one. False, with
+    // nothing queued, if maxPending are already waiting.
+    bool submit(Screenshot shot);
+
+    uint64_t writes() const;   // Files saved since startup
+    uint64_t failures() const; // Files that couldn't be
+
+    // The PNG file for shot, for callers that encode on their own thread
+    static std::vector<uint8_t> encodePng(const Screenshot &shot);
+
+private:
+    void encodeLoop();
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::deque<Screenshot> pending;
+    uint64_t writeCount = 0;
+    uint64_t failureCount = 0;
+    bool stopping = false;
+    std::thread encoder;
+};
+
+#endif
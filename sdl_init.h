@@ -0,0 +1,15 @@
+#ifndef SDL_INIT_H
+#define SDL_INIT_H
+
+#include <mutex> // For the subsystem lock
+
+// SDL_InitSubSystem and SDL_QuitSubSystem keep unguarded reference counts,
+// and the audio device opens on a thread of its own, so every caller of
+// either takes this lock around them
+inline std::mutex &sdlSubsystemMutex()
+{
+    static std::mutex mutex;
+    return mutex;
+}
+
+#endif
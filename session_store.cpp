@@ -0,0 +1,56 @@
+#include "session_store.h"
+#include "rom_cache.h"
+#include "state_codec.h"
+
+std::shared_ptr<const Chip8Batch::Machine> SessionStore::baseFor(const std::string &romPath)
+{
+    auto found = bases.find(romPath);
+    if (found != bases.end())
+        return found->second;
+
+    std::shared_ptr<const RomCache::Image> image = RomCache::shared().get(romPath);
+    Chip8Batch fresh(1);
+    if (!image || !fresh.loadROM(image->data(), image->size()))
+        return nullptr;
+    auto base = std::make_shared<Chip8Batch::Machine>();
+    fresh.get(0, *base);
+    bases.emplace(romPath, base);
+    return base;
+}
+
+bool SessionStore::park(uint64_t id, const std::string &romPath, const Chip8Batch::Machine &state)
+{
+    std::shared_ptr<const Chip8Batch::Machine> base = baseFor(romPath);
+    if (!base)
+        return false;
+
+    drop(id);
+    Parked &entry = parked[id];
+    entry.base = std::move(base);
+    state_codec::pack(&state, entry.base.get(), sizeof state, entry.data);
+    entry.data.shrink_to_fit();
+    used += entry.data.size();
+    return true;
+}
+
+bool SessionStore::unpark(uint64_t id, Chip8Batch::Machine &out)
+{
+    auto found = parked.find(id);
+    if (found == parked.end())
+        return false;
+    const Parked &entry = found->second;
+    if (!state_codec::unpack(entry.data.data(), entry.data.size(), entry.base.get(), &out, sizeof out))
+        return false;
+    used -= entry.data.size();
+    parked.erase(found);
+    return true;
+}
+
+void SessionStore::drop(uint64_t id)
+{
+    auto found = parked.find(id);
+    if (found == parked.end())
+        return;
+    used -= found->second.data.size();
+    parked.erase(found);
+}
@@ -0,0 +1,47 @@
+#ifndef SESSION_STORE_H
+#define SESSION_STORE_H
+
+#include "chip8_batch.h"
+#include <cstddef>       // For size_t
+#include <cstdint>       // For session ids
+#include <memory>        // For the shared boot snapshots
+#include <string>        // For ROM paths
+#include <unordered_map> // For the parked sessions and boot snapshots
+#include <vector>        // For encoded states
+
+// Cold store for idle sessions. A parked machine is kept as its state
+// packed against the state of the same ROM just loaded (see
+// state_codec.h), so only what the game has changed since boot is
+// stored: usually 100-200 bytes in place of a whole machine. One boot
+// state per ROM is shared by every session parked on it.
+class SessionStore
+{
+public:
+    // Keeps a Chip8Batch lane's state, running romPath, under id in place
+    // of any state already there. False if the ROM can't be read.
+    bool park(uint64_t id, const std::string &romPath, const Chip8Batch::Machine &state);
+
+    // The state parked under id, which is then forgotten. False if nothing
+    // is parked there.
+    bool unpark(uint64_t id, Chip8Batch::Machine &out);
+
+    void drop(uint64_t id);
+
+    size_t size() const { return parked.size(); }
+    size_t bytesUsed() const { return used; }
+
+private:
+    struct Parked
+    {
+        std::shared_ptr<const Chip8Batch::Machine> base;
+        std::vector<uint8_t> data;
+    };
+
+    std::shared_ptr<const Chip8Batch::Machine> baseFor(const std::string &romPath);
+
+    std::unordered_map<uint64_t, Parked> parked;
+    std::unordered_map<std::string, std::shared_ptr<const Chip8Batch::Machine>> bases;
+    size_t used = 0; // Encoded bytes held
+};
+
+#endif
@@ -0,0 +1,132 @@
+#include "settings_store.h"
+#include "rom_database.h"
+#include <algorithm> // For std::lower_bound, std::copy
+#include <cstring>   // For std::memcmp
+#include <filesystem>
+#include <fstream>
+#include <type_traits> // For std::is_trivially_copyable
+
+namespace
+{
+    const char magic[4] = {'C', '8', 'S', 'T'};
+    const uint32_t version = 2;
+
+    struct Header
+    {
+        char magic[4];
+        uint32_t version;
+        uint32_t recordSize; // Guards against a build with another layout
+        uint32_t count;
+    };
+
+    // A version 1 record: keys were letters and digits only
+    struct RecordV1
+    {
+        uint64_t key;
+        uint32_t fields;
+        uint8_t vipTiming, palette, effects, reserved;
+        double clockHz;
+        std::array<uint8_t, 16> keys;
+    };
+    static_assert(sizeof(RecordV1) == 40, "version 1 layout");
+}
+
+uint64_t SettingsStore::keyFor(const uint8_t *rom, size_t size)
+{
+    const std::string digest = RomDatabase::sha1(rom, size);
+    uint64_t key = std::stoull(digest.substr(0, 16), nullptr, 16);
+    return key == globalKey ? 1 : key;
+}
+
+void SettingsStore::load(const std::string &path)
+{
+    static_assert(std::is_trivially_copyable<Record>::value, "records are read and written as bytes");
+    file = path;
+    records.clear();
+
+    std::ifstream in(std::filesystem::u8path(path), std::ios::binary);
+    Header header{};
+    if (!in.read(reinterpret_cast<char *>(&header), sizeof header) || std::memcmp(header.magic, magic, sizeof magic) != 0)
+        return;
+    if (header.version == 1 && header.recordSize == sizeof(RecordV1))
+    {
+        std::vector<RecordV1> old(header.count);
+        if (!in.read(reinterpret_cast<char *>(old.data()), static_cast<std::streamsize>(header.count * sizeof(RecordV1))))
+            return;
+        for (const RecordV1 &r : old)
+        {
+            Record record{r.key, Settings()};
+            record.settings.fields = r.fields;
+            record.settings.vipTiming = r.vipTiming;
+            record.settings.palette = r.palette;
+            record.settings.effects = r.effects;
+            record.settings.clockHz = r.clockHz;
+            std::copy(r.keys.begin(), r.keys.end(), record.settings.keys.begin());
+            records.push_back(record);
+        }
+        return;
+    }
+    if (header.version != version || header.recordSize != sizeof(Record))
+        return;
+    records.resize(header.count);
+    if (!in.read(reinterpret_cast<char *>(records.data()), static_cast<std::streamsize>(header.count * sizeof(Record))))
+        records.clear();
+}
+
+bool SettingsStore::find(uint64_t key, Settings &out) const
+{
+    auto found = std::lower_bound(records.begin(), records.end(), key, [](const Record &r, uint64_t k)
+                                  { return r.key < k; });
+    if (found == records.end() || found->key != key)
+        return false;
+    out = found->settings;
+    return true;
+}
+
+bool SettingsStore::put(uint64_t key, const Settings &settings)
+{
+    auto found = std::lower_bound(records.begin(), records.end(), key, [](const Record &r, uint64_t k)
+                                  { return r.key < k; });
+    if (found == records.end() || found->key != key)
+        found = records.insert(found, Record{key, Settings()});
+
+    Settings &stored = found->settings;
+    if (settings.fields & HasClock)
+    {
+        stored.clockHz = settings.clockHz;
+        stored.vipTiming = settings.vipTiming;
+    }
+    if (settings.fields & HasPalette)
+        stored.palette = settings.palette;
+    if (settings.fields & HasEffects)
+        stored.effects = settings.effects;
+    if (settings.fields & HasKeys)
+        stored.keys = settings.keys;
+    stored.fields |= settings.fields;
+    return save();
+}
+
+// Written next to the file and renamed over it, so a crash mid-write
+// leaves the old settings
+bool SettingsStore::save() const
+{
+    if (file.empty())
+        return false;
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::u8path(file).parent_path(), ec);
+    const std::string temp = file + ".tmp";
+    {
+        std::ofstream out(std::filesystem::u8path(temp), std::ios::binary | std::ios::trunc);
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof magic);
+        header.version = version;
+        header.recordSize = sizeof(Record);
+        header.count = static_cast<uint32_t>(records.size());
+        out.write(reinterpret_cast<const char *>(&header), sizeof header);
+        out.write(reinterpret_cast<const char *>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(Record)));
+        if (!out)
+            return false;
+    }
+    std::filesystem::rename(std::filesystem::u8path(temp), std::filesystem::u8path(file), ec);
+    return !ec;
+}
@@ -0,0 +1,67 @@
+#ifndef SETTINGS_STORE_H
+#define SETTINGS_STORE_H
+
+#include <array>   // For the key map
+#include <cstdint> // For record fields
+#include <string>  // For the file path
+#include <vector>  // For the records
+
+// Global and per-ROM preferences in one small binary file: a header, then
+// fixed-size records sorted by key. Loading reads the records straight
+// into memory as they are, with nothing to parse, and a lookup is a binary
+// search. Every change rewrites the file, which stays a few KB for hundreds
+// of ROMs. Files of the version before, with 8-bit key codes, are read
+// and written back in the current layout on the next change.
+class SettingsStore
+{
+public:
+    enum : uint32_t
+    {
+        HasClock = 1,   // clockHz and vipTiming
+        HasPalette = 2, // palette
+        HasEffects = 4, // effects
+        HasKeys = 8     // keys
+    };
+
+    // Trivially copyable, stored as is
+    struct Settings
+    {
+        uint32_t fields = 0; // Has* bits of the values set
+        uint8_t vipTiming = 0;
+        uint8_t palette = 0; // Chip8Canvas::ScreenFilter
+        uint8_t effects = 0; // Scanlines, phosphor and bloom bits, then Scale2x and xBR
+        uint8_t reserved = 0;
+        double clockHz = 0;
+        std::array<uint16_t, 16> keys{}; // wx key code of each CHIP-8 key, 0 for the default layout's
+    };
+
+    static constexpr uint64_t globalKey = 0;
+
+    // Key of a ROM's own settings: the first 64 bits of its SHA-1
+    static uint64_t keyFor(const uint8_t *rom, size_t size);
+
+    // Takes the records of the file at path, none if it is missing or not
+    // a settings file
+    void load(const std::string &path);
+
+    // False if nothing is stored under key
+    bool find(uint64_t key, Settings &out) const;
+
+    // Merges the fields set in settings into key's record and saves. False
+    // if the file couldn't be written.
+    bool put(uint64_t key, const Settings &settings);
+
+private:
+    struct Record
+    {
+        uint64_t key;
+        Settings settings;
+    };
+
+    bool save() const;
+
+    std::string file;
+    std::vector<Record> records; // Sorted by key
+};
+
+#endif
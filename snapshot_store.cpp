@@ -0,0 +1,312 @@
+#include "snapshot_store.h"
+#include <cstring> // For std::memcmp, std::memset
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    const uint64_t initialRecords = 1024; // About 5 MB; the file doubles from here
+    const uint64_t initialSlots = 4096;
+
+    uint64_t slotOf(uint64_t hash, uint64_t mask)
+    {
+        // stateHash is good in its low bits already, but a store of one
+        // ROM's states is a lot of near-equal machines
+        hash ^= hash >> 31;
+        hash *= 0x9e3779b97f4a7c15ull;
+        return (hash ^ (hash >> 29)) & mask;
+    }
+}
+
+bool SnapshotStore::Mapping::open(const std::string &path, uint64_t minimum)
+{
+    close();
+#if defined(_WIN32)
+    HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+                                FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (handle == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size))
+    {
+        CloseHandle(handle);
+        return false;
+    }
+    file = handle;
+    bytes = static_cast<uint64_t>(size.QuadPart);
+#else
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0)
+        return false;
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close();
+        return false;
+    }
+    bytes = static_cast<uint64_t>(info.st_size);
+#endif
+    // Only a new, empty file is sized; one that exists is mapped as it is
+    // until its header has been checked
+    if (!resize(bytes == 0 ? minimum : bytes))
+    {
+        close();
+        return false;
+    }
+    return true;
+}
+
+// Sets the file's length and maps all of it. Growing maps the new length
+// before letting the old view go, so a failed grow leaves the old one in
+// place; bytes past the old end read as zeros.
+bool SnapshotStore::Mapping::resize(uint64_t size)
+{
+#if defined(_WIN32)
+    // A mapped file can't be cut, but a mapping longer than the file
+    // extends it
+    if (size < bytes)
+    {
+        UnmapViewOfFile(data);
+        CloseHandle(static_cast<HANDLE>(mapping));
+        data = nullptr;
+        mapping = nullptr;
+        LARGE_INTEGER end;
+        end.QuadPart = static_cast<LONGLONG>(size);
+        if (!SetFilePointerEx(static_cast<HANDLE>(file), end, nullptr, FILE_BEGIN) || !SetEndOfFile(static_cast<HANDLE>(file)))
+            return false;
+    }
+    HANDLE handle = CreateFileMappingA(static_cast<HANDLE>(file), nullptr, PAGE_READWRITE, static_cast<DWORD>(size >> 32),
+                                       static_cast<DWORD>(size), nullptr);
+    if (!handle)
+        return false;
+    void *view = MapViewOfFile(handle, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+    if (!view)
+    {
+        CloseHandle(handle);
+        return false;
+    }
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping)
+        CloseHandle(static_cast<HANDLE>(mapping));
+    mapping = handle;
+#else
+    if (size > bytes && ftruncate(fd, static_cast<off_t>(size)) != 0)
+        return false;
+    void *view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED)
+        return false;
+    if (data)
+        munmap(data, bytes);
+    if (size < bytes && ftruncate(fd, static_cast<off_t>(size)) != 0)
+    {
+        munmap(view, size);
+        data = nullptr;
+        return false;
+    }
+#endif
+    data = view;
+    bytes = size;
+    return true;
+}
+
+bool SnapshotStore::Mapping::flush()
+{
+    if (!data)
+        return true;
+#if defined(_WIN32)
+    return FlushViewOfFile(data, 0) && FlushFileBuffers(static_cast<HANDLE>(file));
+#else
+    return msync(data, bytes, MS_SYNC) == 0;
+#endif
+}
+
+void SnapshotStore::Mapping::close()
+{
+#if defined(_WIN32)
+    if (data)
+        UnmapViewOfFile(data);
+    if (mapping)
+        CloseHandle(static_cast<HANDLE>(mapping));
+    if (file)
+        CloseHandle(static_cast<HANDLE>(file));
+    mapping = nullptr;
+    file = nullptr;
+#else
+    if (data)
+        munmap(data, bytes);
+    if (fd >= 0)
+        ::close(fd);
+    fd = -1;
+#endif
+    data = nullptr;
+    bytes = 0;
+}
+
+bool SnapshotStore::open(const std::string &path)
+{
+    close();
+    if (!store.open(path, sizeof(Header) + initialRecords * sizeof(Record)))
+        return false;
+
+    Header *h = header();
+    if (store.bytes < sizeof(Header))
+    {
+        store.close();
+        return false;
+    }
+    if (h->magic == 0)
+    {
+        // A new file: all zeros until now
+        h->version = version;
+        h->recordSize = sizeof(Record);
+        h->count = 0;
+        h->magic = magic;
+    }
+    else if (h->magic != magic || h->version != version || h->recordSize != sizeof(Record) ||
+             h->count > (store.bytes - sizeof(Header)) / sizeof(Record))
+    {
+        store.close(); // Not cut to length like a store of ours would be
+        return false;
+    }
+
+    if (!index.open(path + ".idx", sizeof(IndexHeader) + initialSlots * sizeof(Slot)))
+    {
+        close();
+        return false;
+    }
+    const IndexHeader *ih = indexHeader();
+    const bool current = ih->magic == indexMagic && ih->version == version && ih->indexed == h->count &&
+                         ih->slots != 0 && (ih->slots & (ih->slots - 1)) == 0 &&
+                         ih->slots <= (index.bytes - sizeof(IndexHeader)) / sizeof(Slot) && ih->indexed * 2 <= ih->slots;
+    if (!current)
+    {
+        uint64_t slotCount = initialSlots;
+        while (slotCount < h->count * 2 + 2)
+            slotCount *= 2;
+        if (!rebuildIndex(slotCount))
+        {
+            close();
+            return false;
+        }
+    }
+    return true;
+}
+
+void SnapshotStore::close()
+{
+    // Drops the room grown ahead, so a closed store is only its records
+    if (store.data)
+        store.resize(sizeof(Header) + header()->count * sizeof(Record));
+    store.close();
+    index.close();
+}
+
+uint64_t SnapshotStore::insert(const Chip8::Snapshot &state, uint64_t hash, bool *added)
+{
+    uint64_t mask = indexHeader()->slots - 1;
+    uint64_t s = slotOf(hash, mask);
+    for (Slot *slot = slots(); slot[s].record != 0; s = (s + 1) & mask)
+    {
+        if (slot[s].hash == hash && std::memcmp(&records()[slot[s].record - 1].state, &state, sizeof state) == 0)
+        {
+            if (added)
+                *added = false;
+            return slot[s].record - 1;
+        }
+    }
+
+    Header *h = header();
+    uint64_t n = h->count;
+    if (sizeof(Header) + (n + 1) * sizeof(Record) > store.bytes)
+    {
+        uint64_t capacity = (store.bytes - sizeof(Header)) / sizeof(Record);
+        capacity = capacity < initialRecords ? initialRecords : capacity * 2;
+        if (!store.resize(sizeof(Header) + capacity * sizeof(Record)))
+        {
+            // Out of disk or address space; the store stays as it was
+            if (added)
+                *added = false;
+            return UINT64_MAX;
+        }
+        h = header();
+    }
+    Record &record = records()[n];
+    record.hash = hash;
+    record.state = state;
+    h->count = n + 1;
+
+    // Written last, so a store torn by a crash has an index that's behind
+    // and gets rebuilt rather than one that points past the records
+    IndexHeader *ih = indexHeader();
+    if ((ih->indexed + 1) * 2 > ih->slots)
+    {
+        rebuildIndex(ih->slots * 2);
+    }
+    else
+    {
+        slots()[s] = {hash, n + 1};
+        ih->indexed = n + 1;
+    }
+    if (added)
+        *added = true;
+    return n;
+}
+
+int64_t SnapshotStore::find(uint64_t hash) const
+{
+    uint64_t mask = indexHeader()->slots - 1;
+    const Slot *slot = slots();
+    for (uint64_t s = slotOf(hash, mask); slot[s].record != 0; s = (s + 1) & mask)
+    {
+        if (slot[s].hash == hash)
+            return static_cast<int64_t>(slot[s].record - 1);
+    }
+    return -1;
+}
+
+const SnapshotStore::Record &SnapshotStore::record(uint64_t index) const
+{
+    return records()[index];
+}
+
+bool SnapshotStore::flush()
+{
+    bool ok = store.flush();
+    return index.flush() && ok;
+}
+
+bool SnapshotStore::rebuildIndex(uint64_t slotCount)
+{
+    if (!index.resize(sizeof(IndexHeader) + slotCount * sizeof(Slot)))
+        return false;
+    IndexHeader *ih = indexHeader();
+    std::memset(ih, 0, sizeof(IndexHeader) + slotCount * sizeof(Slot));
+    ih->version = version;
+    ih->slots = slotCount;
+    uint64_t count = header()->count;
+    for (uint64_t n = 0; n < count; ++n)
+        indexRecord(n);
+    ih->indexed = count;
+    ih->magic = indexMagic;
+    return true;
+}
+
+void SnapshotStore::indexRecord(uint64_t recordIndex)
+{
+    uint64_t hash = records()[recordIndex].hash;
+    uint64_t mask = indexHeader()->slots - 1;
+    Slot *slot = slots();
+    uint64_t s = slotOf(hash, mask);
+    while (slot[s].record != 0)
+        s = (s + 1) & mask;
+    slot[s] = {hash, recordIndex + 1};
+}
@@ -0,0 +1,127 @@
+#ifndef SNAPSHOT_STORE_H
+#define SNAPSHOT_STORE_H
+
+#include "chip8.h"
+#include <cstddef> // For size_t
+#include <cstdint> // For the fixed-width layout
+#include <string>  // For the file names
+
+// Append-only store of machine snapshots in a memory-mapped file, for
+// keeping more states than fit in memory and for keeping them between
+// runs. Every record is a Chip8::Snapshot with its state hash in front,
+// all the same size, so record n sits at a fixed offset and is read in
+// place: no parsing, no copy, no allocation per state. A hash index in a
+// second mapped file (path + ".idx") finds a state by its hash; states
+// are kept once, an insert of one already stored returns the old record.
+//
+// Both files start with a header; records follow the store's. The index
+// is open addressing over (hash, record + 1) pairs, kept at most half
+// full, and whole-record compared on a hash match, so colliding hashes
+// still store two records. The index notes how many records it covers;
+// one that doesn't match the store (a crash between the two writes) is
+// rebuilt from the hashes in the records on open.
+//
+// One thread writes; any may read between writes. Records and the
+// references at() returns stay valid until the next insert, which may
+// grow the file and map it again.
+class SnapshotStore
+{
+public:
+    static constexpr uint32_t magic = 0x53533843;      // "C8SS" in memory order
+    static constexpr uint32_t indexMagic = 0x49533843; // "C8SI"
+    static constexpr uint32_t version = 2; // 2 moved the stack behind the scalars in Chip8State
+
+    struct Header
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t recordSize; // sizeof(Record), a store of another core's layout won't open
+        uint32_t reserved;
+        uint64_t count; // Records written
+        uint8_t padding[40];
+    };
+
+    struct Record
+    {
+        uint64_t hash; // Chip8::stateHash of state
+        Chip8::Snapshot state;
+    };
+
+    static_assert(sizeof(Header) == 64, "file layout");
+
+    SnapshotStore() = default;
+    ~SnapshotStore() { close(); }
+
+    SnapshotStore(const SnapshotStore &) = delete;
+    SnapshotStore &operator=(const SnapshotStore &) = delete;
+
+    // Opens the store at path, creating it if there is none; false if the
+    // file is some other layout or can't be mapped
+    bool open(const std::string &path);
+    void close();
+    bool isOpen() const { return store.data != nullptr; }
+
+    // The record holding state, appended unless an equal one is stored;
+    // added says which. hash is state's Chip8::stateHash. UINT64_MAX if
+    // the file couldn't grow.
+    uint64_t insert(const Chip8::Snapshot &state, uint64_t hash, bool *added = nullptr);
+
+    // Record index of a state with that hash, or -1
+    int64_t find(uint64_t hash) const;
+
+    uint64_t size() const { return header()->count; }
+    const Record &record(uint64_t index) const;
+    const Chip8::Snapshot &at(uint64_t index) const { return record(index).state; }
+
+    // Writes the mapped pages out, for a store that has to survive power
+    // loss and not just the process. True if both files made it.
+    bool flush();
+
+private:
+    // A file mapped whole, grown by remapping
+    struct Mapping
+    {
+        void *data = nullptr;
+        uint64_t bytes = 0;
+#if defined(_WIN32)
+        void *file = nullptr;
+        void *mapping = nullptr;
+#else
+        int fd = -1;
+#endif
+        bool open(const std::string &path, uint64_t minimum);
+        bool resize(uint64_t size);
+        bool flush();
+        void close();
+    };
+
+    struct IndexHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t slots;   // Power of two
+        uint64_t indexed; // Records the table covers
+        uint8_t padding[40];
+    };
+
+    struct Slot
+    {
+        uint64_t hash;
+        uint64_t record; // Index + 1, 0 while free
+    };
+
+    static_assert(sizeof(IndexHeader) == 64, "file layout");
+
+    Header *header() const { return static_cast<Header *>(store.data); }
+    IndexHeader *indexHeader() const { return static_cast<IndexHeader *>(index.data); }
+    Slot *slots() const { return reinterpret_cast<Slot *>(indexHeader() + 1); }
+    Record *records() const { return reinterpret_cast<Record *>(header() + 1); }
+
+    bool rebuildIndex(uint64_t slotCount);
+    void indexRecord(uint64_t recordIndex);
+
+    Mapping store;
+    Mapping index;
+};
+
+#endif
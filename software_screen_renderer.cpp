@@ -0,0 +1,106 @@
+#include "software_screen_renderer.h"
+#include "chip8_simd.h"
+#include <algorithm> // For std::min, std::max, std::fill_n
+#include <cstring>   // For std::memcpy, std::memcmp
+#include <wx/bitmap.h>
+#include <wx/dcclient.h>
+#include <wx/rawbmp.h>
+#include <wx/window.h>
+
+namespace
+{
+    // Bytes B, G, R, A in memory: Windows DIBs and cairo's ARGB32 alike
+    uint32_t packColor(const ScreenBackend::Color &color)
+    {
+        auto channel = [](float c)
+        { return static_cast<uint32_t>(std::clamp(c, 0.0f, 1.0f) * 255.0f + 0.5f); };
+        return 0xFF000000u | channel(color[0]) << 16 | channel(color[1]) << 8 | channel(color[2]);
+    }
+
+    uint32_t *pixelRow(wxAlphaPixelData &data, wxAlphaPixelData::Iterator &at, int x, int y)
+    {
+        at.MoveTo(data, x, y);
+        return reinterpret_cast<uint32_t *>(at.m_ptr);
+    }
+}
+
+SoftwareScreenRenderer::SoftwareScreenRenderer(wxWindow *target)
+    : window(target)
+{
+}
+
+SoftwareScreenRenderer::~SoftwareScreenRenderer() = default;
+
+bool SoftwareScreenRenderer::init()
+{
+    return window != nullptr;
+}
+
+void SoftwareScreenRenderer::resize(int newWidth, int newHeight)
+{
+    width = std::max(newWidth, 1);
+    height = std::max(newHeight, 1);
+    frame = std::make_unique<wxBitmap>(width, height, 32);
+    stale = true;
+}
+
+void SoftwareScreenRenderer::upload(const Framebuffer &gfx)
+{
+    uploaded = gfx;
+}
+
+// Clears the bitmap to the unlit colour when the size, mode or palette
+// changed, then expands the rows that differ from what it shows, each
+// once and copied down for the rest of its scale
+void SoftwareScreenRenderer::draw(bool hires, const Color &off, const Color &on, bool)
+{
+    if (!frame || !frame->IsOk())
+        return;
+    const uint32_t offPixel = packColor(off), onPixel = packColor(on);
+    const bool full = stale || hires != drawnHires || offPixel != drawnOff || onPixel != drawnOn;
+    if (!full && uploaded == drawn)
+        return;
+
+    const int columns = hires ? 128 : 64, rows = hires ? 64 : 32;
+    const int scale = std::min(width / columns, height / rows);
+    const int left = (width - columns * scale) / 2, top = (height - rows * scale) / 2;
+    const int words = Chip8::rowWords;
+    {
+        wxAlphaPixelData data(*frame);
+        if (!data)
+            return;
+        wxAlphaPixelData::Iterator at(data);
+        if (full)
+        {
+            for (int y = 0; y < height; ++y)
+                std::fill_n(pixelRow(data, at, 0, y), width, offPixel);
+        }
+        for (int y = 0; y < rows && scale > 0; ++y)
+        {
+            if (!full && std::memcmp(&uploaded[y * words], &drawn[y * words], words * sizeof(uint64_t)) == 0)
+                continue;
+            uint32_t *first = pixelRow(data, at, left, top + y * scale);
+            simd::expandBits(first, &uploaded[y * words], columns, offPixel, onPixel, scale);
+            for (int copy = 1; copy < scale; ++copy)
+                std::memcpy(pixelRow(data, at, left, top + y * scale + copy), first, columns * scale * sizeof *first);
+        }
+    }
+    // Every pixel is opaque, so a plain blit will do
+    frame->ResetAlpha();
+
+    drawn = uploaded;
+    drawnHires = hires;
+    drawnOff = offPixel;
+    drawnOn = onPixel;
+    stale = false;
+}
+
+bool SoftwareScreenRenderer::present()
+{
+    if (frame && frame->IsOk())
+    {
+        wxClientDC dc(window);
+        dc.DrawBitmap(*frame, 0, 0, false);
+    }
+    return true;
+}
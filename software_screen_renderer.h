@@ -0,0 +1,47 @@
+#ifndef SOFTWARE_SCREEN_RENDERER_H
+#define SOFTWARE_SCREEN_RENDERER_H
+
+#include "screen_backend.h"
+#include <cstdint> // For packed pixels
+#include <memory>  // For the frame bitmap
+
+class wxBitmap;
+class wxWindow;
+
+// GDI fallback for machines whose OpenGL drivers can't give a working
+// context. The display is expanded with simd::expandBits straight into a
+// 32-bit bitmap of the whole client area, at the largest integer scale that
+// fits and centred on the unlit colour, and blitted to the window in one
+// piece, so nothing flickers. Only rows that changed are expanded again,
+// and an unchanged frame is just blitted. No effects and no vsync.
+class SoftwareScreenRenderer : public ScreenBackend
+{
+public:
+    explicit SoftwareScreenRenderer(wxWindow *window);
+    ~SoftwareScreenRenderer() override;
+
+    SoftwareScreenRenderer(const SoftwareScreenRenderer &) = delete;
+    SoftwareScreenRenderer &operator=(const SoftwareScreenRenderer &) = delete;
+
+    bool init() override;
+    const char *name() const override { return "Software"; }
+
+    void resize(int width, int height) override;
+    void upload(const Framebuffer &gfx) override;
+    void draw(bool hires, const Color &off, const Color &on, bool newFrame) override;
+    bool present() override;
+
+private:
+    wxWindow *window;
+    std::unique_ptr<wxBitmap> frame; // Back buffer, the size of the client area
+    int width = 0;
+    int height = 0;
+    Framebuffer uploaded{}; // Newest frame
+    Framebuffer drawn{};    // Frame the bitmap currently shows
+    bool drawnHires = false;
+    uint32_t drawnOff = 0; // Palette the bitmap was drawn with
+    uint32_t drawnOn = 0;
+    bool stale = true; // Bitmap was just created, draw everything
+};
+
+#endif
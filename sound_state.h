@@ -0,0 +1,21 @@
+#ifndef SOUND_STATE_H
+#define SOUND_STATE_H
+
+#include <atomic>  // For lock-free publishing
+#include <cstdint> // For uint8_t, uint64_t
+
+// Sound output state, written by the emulation thread once per frame and
+// read by the audio callback. A sequence counter (odd while writing) lets
+// the callback skip a half-written pattern and keep the previous one.
+struct SoundState
+{
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<bool> tone{false};       // Sound timer running
+    std::atomic<bool> patterned{false};  // Play the XO-CHIP pattern instead of the plain buzzer
+    std::atomic<uint8_t> pitch{64};      // XO-CHIP pitch register
+    std::atomic<uint64_t> patternHigh{0}; // Pattern bits 0-63, first played in bit 63
+    std::atomic<uint64_t> patternLow{0};  // Pattern bits 64-127
+    std::atomic<int64_t> toneSince{0};    // steady_clock microseconds when tone last came on
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "speed_tuner.h"
+#include "chip8.h"
+#include <algorithm> // For std::nth_element, std::clamp
+#include <memory>    // For the trial machine
+#include <vector>
+
+namespace
+{
+    constexpr int keyPatience = 30;    // Frames at an FX0A before the trial presses something
+    constexpr int minPacedFrames = 30; // To go by
+}
+
+template <typename Machine>
+SpeedTuner::Result SpeedTuner::tune(const uint8_t *rom, size_t size, uint64_t seed)
+{
+    Result result;
+    std::unique_ptr<Machine> machine = std::make_unique<Machine>();
+    if (!machine->loadROM(rom, size))
+        return result;
+    machine->seedRandom(seed);
+
+    std::vector<int> work; // Instructions before the wait, per paced frame
+    int busyFrames = 0;
+    int keyFrames = 0;
+    int heldKey = -1;
+    int nextKey = 0;
+    for (; result.frames < trialFrames; ++result.frames)
+    {
+        // Menus and title screens wait for a key: tap one, then let go
+        if (heldKey >= 0)
+        {
+            machine->setKey(heldKey, false);
+            heldKey = -1;
+        }
+        else if (keyFrames >= keyPatience)
+        {
+            heldKey = nextKey;
+            nextKey = (nextKey + 1) & 0xF;
+            machine->setKey(heldKey, true);
+            keyFrames = 0;
+        }
+
+        // Reading a running delay timer is what a wait loop does, however
+        // much else (key tests, say) it does on each turn. Frames spent
+        // wholly in a wait draw nothing and set no timer, and don't count.
+        int ran = 0;
+        bool acted = false;
+        while (ran < trialIpf && !machine->isIdle())
+        {
+            const auto &memory = machine->getMemory();
+            const uint16_t pc = machine->getPC();
+            const uint16_t opcode = static_cast<uint16_t>(memory[pc % memory.size()] << 8 | memory[(pc + 1) % memory.size()]);
+            if ((opcode & 0xF000) == 0xD000)
+            {
+                ++result.draws;
+                acted = true;
+            }
+            else if ((opcode & 0xF0FF) == 0xF015)
+            {
+                ++result.timerWaits;
+                acted = true;
+            }
+            machine->emulateCycle();
+            ++ran;
+            if ((opcode & 0xF0FF) == 0xF007 && machine->getDelayTimer() > 0)
+                break;
+        }
+        machine->decrementTimers();
+
+        if (machine->isWaitingForKey())
+            ++keyFrames;
+        else if (ran > trialIpf * 3 / 4)
+            ++busyFrames;
+        else if (acted)
+        {
+            ++result.pacedFrames;
+            work.push_back(ran);
+        }
+    }
+
+    // Too little play past the menus says nothing about the speed a game
+    // wants, and one that runs flat out now and then (a Pong rally) would
+    // play those parts slower
+    if (result.pacedFrames < minPacedFrames || busyFrames * 20 > result.pacedFrames)
+        return result;
+
+    // The busy end of the frames, with room for scenes the trial didn't reach
+    auto high = work.begin() + work.size() * 95 / 100;
+    std::nth_element(work.begin(), high, work.end());
+    result.ipf = std::clamp(*high * 5 / 4 + 1, minIpf, trialIpf);
+    return result;
+}
+
+template SpeedTuner::Result SpeedTuner::tune<Chip8>(const uint8_t *, size_t, uint64_t);
+template SpeedTuner::Result SpeedTuner::tune<VipChip8>(const uint8_t *, size_t, uint64_t);
+template SpeedTuner::Result SpeedTuner::tune<Chip48>(const uint8_t *, size_t, uint64_t);
+template SpeedTuner::Result SpeedTuner::tune<SuperChip8>(const uint8_t *, size_t, uint64_t);
+template SpeedTuner::Result SpeedTuner::tune<XoChip8>(const uint8_t *, size_t, uint64_t);
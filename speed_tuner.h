@@ -0,0 +1,37 @@
+#ifndef SPEED_TUNER_H
+#define SPEED_TUNER_H
+
+#include <cstddef> // For size_t
+#include <cstdint> // For uint8_t, uint64_t
+
+// Picks a speed for a ROM from how it spends its frames. A machine of its
+// own runs the first seconds at a generous speed, one instruction at a
+// time, and counts each frame's instructions until the program settles
+// into an idle loop: polling the delay timer it set with FX15, waiting for
+// the display or for a key. A game paced that way needs about as many
+// instructions per frame as its busiest frames do real work; the rest of
+// the clock only spins in the wait.
+class SpeedTuner
+{
+public:
+    static constexpr int trialFrames = 600; // Ten seconds of play
+    static constexpr int trialIpf = 1000;   // Well above what any game needs
+    static constexpr int minIpf = 5;
+
+    struct Result
+    {
+        int ipf = 0;         // Instructions per frame, 0 if the ROM sets its own pace
+        int frames = 0;      // Run in the trial
+        int pacedFrames = 0; // Of those, frames that drew or set a timer, then waited
+        int draws = 0;       // DXYN over the trial
+        int timerWaits = 0;  // FX15 over the trial
+    };
+
+    // A ROM that runs some frames flat out rather than waiting runs as
+    // fast as it is clocked, whatever that is; it gets ipf 0 and keeps the
+    // speed it has.
+    template <typename Machine>
+    static Result tune(const uint8_t *rom, size_t size, uint64_t seed);
+};
+
+#endif
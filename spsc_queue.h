@@ -0,0 +1,54 @@
+#ifndef SPSC_QUEUE_H
+#define SPSC_QUEUE_H
+
+#include <array>   // For the ring storage
+#include <atomic>  // For the read/write indices
+#include <cstddef> // For size_t
+
+// Lock-free bounded ring for exactly one producer and one consumer thread.
+// Each side keeps a cached copy of the other's index, so the shared cache
+// lines are only touched when the ring looks full or empty.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // Producer side, false if the ring is full
+    bool push(const T &value)
+    {
+        size_t write = writeIndex.load(std::memory_order_relaxed);
+        if (write - cachedRead == Capacity)
+        {
+            cachedRead = readIndex.load(std::memory_order_acquire);
+            if (write - cachedRead == Capacity)
+                return false;
+        }
+        slots[write & (Capacity - 1)] = value;
+        writeIndex.store(write + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side: oldest entry or nullptr if empty, valid until pop()
+    const T *front()
+    {
+        size_t read = readIndex.load(std::memory_order_relaxed);
+        if (read == cachedWrite)
+        {
+            cachedWrite = writeIndex.load(std::memory_order_acquire);
+            if (read == cachedWrite)
+                return nullptr;
+        }
+        return &slots[read & (Capacity - 1)];
+    }
+    void pop() { readIndex.store(readIndex.load(std::memory_order_relaxed) + 1, std::memory_order_release); }
+
+private:
+    alignas(64) std::atomic<size_t> readIndex{0};
+    size_t cachedWrite = 0; // Consumer's view of writeIndex
+    alignas(64) std::atomic<size_t> writeIndex{0};
+    size_t cachedRead = 0; // Producer's view of readIndex
+    alignas(64) std::array<T, Capacity> slots{};
+};
+
+#endif
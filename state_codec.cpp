@@ -0,0 +1,85 @@
+#include "state_codec.h"
+#include <zlib.h>
+
+namespace
+{
+    // A deflate or inflate stream per thread, reset between states: setting
+    // one up allocates a few hundred KB, more time than packing a state
+    struct Streams
+    {
+        z_stream deflater{};
+        z_stream inflater{};
+        bool deflating = false;
+        bool inflating = false;
+        std::vector<uint8_t> scratch; // state XOR base
+
+        ~Streams()
+        {
+            if (deflating)
+                deflateEnd(&deflater);
+            if (inflating)
+                inflateEnd(&inflater);
+        }
+    };
+
+    thread_local Streams streams;
+
+    void xorInto(uint8_t *out, const uint8_t *a, const uint8_t *b, size_t size)
+    {
+        for (size_t i = 0; i < size; ++i)
+            out[i] = a[i] ^ b[i];
+    }
+}
+
+void state_codec::pack(const void *state, const void *base, size_t size, std::vector<uint8_t> &out)
+{
+    Streams &s = streams;
+    if (!s.deflating)
+    {
+        // Raw deflate, no zlib header or checksum: the size is known and the
+        // caller keeps its own checks
+        deflateInit2(&s.deflater, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 9, Z_DEFAULT_STRATEGY);
+        s.deflating = true;
+    }
+    else
+    {
+        deflateReset(&s.deflater);
+    }
+    s.scratch.resize(size);
+    xorInto(s.scratch.data(), static_cast<const uint8_t *>(state), static_cast<const uint8_t *>(base), size);
+
+    const size_t start = out.size();
+    out.resize(start + deflateBound(&s.deflater, static_cast<uLong>(size)));
+    s.deflater.next_in = s.scratch.data();
+    s.deflater.avail_in = static_cast<uInt>(size);
+    s.deflater.next_out = out.data() + start;
+    s.deflater.avail_out = static_cast<uInt>(out.size() - start);
+    deflate(&s.deflater, Z_FINISH);
+    out.resize(out.size() - s.deflater.avail_out);
+}
+
+bool state_codec::unpack(const uint8_t *packed, size_t length, const void *base, void *state, size_t size)
+{
+    Streams &s = streams;
+    if (!s.inflating)
+    {
+        if (inflateInit2(&s.inflater, -15) != Z_OK)
+            return false;
+        s.inflating = true;
+    }
+    else
+    {
+        inflateReset(&s.inflater);
+    }
+
+    // Inflated straight into state, then XORed back in place
+    uint8_t *out = static_cast<uint8_t *>(state);
+    s.inflater.next_in = const_cast<uint8_t *>(packed);
+    s.inflater.avail_in = static_cast<uInt>(length);
+    s.inflater.next_out = out;
+    s.inflater.avail_out = static_cast<uInt>(size);
+    if (inflate(&s.inflater, Z_FINISH) != Z_STREAM_END || s.inflater.avail_out != 0 || s.inflater.avail_in != 0)
+        return false;
+    xorInto(out, out, static_cast<const uint8_t *>(base), size);
+    return true;
+}
@@ -0,0 +1,42 @@
+#ifndef STATE_CODEC_H
+#define STATE_CODEC_H
+
+#include <cstddef> // For size_t
+#include <cstdint> // For uint8_t
+#include <vector>  // For packed states
+
+// Machine states packed for keeping by the million: a state is XORed with
+// a base, the same machine just after its ROM loaded, and what differs is
+// deflated. The ROM image, the font and the untouched memory all cancel
+// out, so only what the game has changed since boot costs anything, and
+// deflate's window takes the zero runs between changes for a few bits
+// each. A state a few seconds into play packs to 100-200 bytes.
+//
+// The boot state is the best dictionary there is for a ROM's states, the
+// one input all of them share; XORing with it packs a little smaller than
+// handing it to zlib as a preset dictionary, and deflate has less to search.
+namespace state_codec
+{
+    // Appends state packed against base to out, both size bytes
+    void pack(const void *state, const void *base, size_t size, std::vector<uint8_t> &out);
+
+    // The state in packed (length bytes) into state; false if it is not
+    // one packed against a base of that size, with state left part written
+    bool unpack(const uint8_t *packed, size_t length, const void *base, void *state, size_t size);
+
+    template <typename State>
+    std::vector<uint8_t> pack(const State &state, const State &base)
+    {
+        std::vector<uint8_t> out;
+        pack(&state, &base, sizeof(State), out);
+        return out;
+    }
+
+    template <typename State>
+    bool unpack(const std::vector<uint8_t> &packed, const State &base, State &state)
+    {
+        return unpack(packed.data(), packed.size(), &base, &state, sizeof(State));
+    }
+}
+
+#endif
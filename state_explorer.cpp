@@ -0,0 +1,365 @@
+// State-space explorer: breadth-first search over every machine state a
+// ROM can reach by input. From the boot state it tries each key held for
+// a few frames and released again (and optionally every pair of keys, and
+// doing nothing), hashes each resulting state with Chip8::stateHash and
+// keeps the ones not seen before for the next level. Levels are expanded
+// in parallel; the seen states live in a lock-free hash set shared by all
+// workers. Reports the states and distinct screens found per level.
+//
+// With --store the states go to a SnapshotStore file instead of memory:
+// a level is a list of record numbers, and the workers read the states in
+// place from the mapped file. The search is the same either way; states
+// the store holds from an earlier run are found there rather than added
+// again, so runs with other inputs or timings build up one store.
+//
+//   chip8-explore [options] rom.ch8
+//     --settle N     frames run with no keys before the search (default 60)
+//     --hold N       frames a key stays down (default 6)
+//     --release N    frames after letting go (default 6)
+//     --ipf N        instructions per frame (default 10)
+//     --depth N      levels to search (default 20)
+//     --max-states N stop adding states after N (default 50000)
+//     --pairs        also try every two keys held together
+//     --idle         also try pressing nothing
+//     --threads N    worker threads (default: all hardware threads)
+//     --seed N       CXNN seed (default 1)
+//     --screens DIR  write every distinct screen to DIR as a PBM image
+//     --store FILE   keep the states in FILE (and FILE.idx), memory-mapped
+
+#include "chip8.h"
+#include "chip8_simd.h"
+#include "snapshot_store.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+    // Open addressing over 64-bit hashes, claimed with a compare-and-swap.
+    // 0 marks a free slot, so a hash of 0 is stored as 1.
+    class ConcurrentHashSet
+    {
+    public:
+        explicit ConcurrentHashSet(size_t capacity)
+        {
+            size_t size = 1024;
+            while (size < capacity * 2)
+                size <<= 1;
+            slots = std::make_unique<std::atomic<uint64_t>[]>(size);
+            for (size_t i = 0; i < size; ++i)
+                slots[i].store(0, std::memory_order_relaxed);
+            mask = size - 1;
+        }
+
+        // True if hash wasn't in the set yet; false as well once it is full
+        bool insert(uint64_t hash)
+        {
+            if (hash == 0)
+                hash = 1;
+            for (size_t i = hash & mask, probes = 0; probes <= mask; i = (i + 1) & mask, ++probes)
+            {
+                uint64_t seen = slots[i].load(std::memory_order_relaxed);
+                if (seen == 0 && slots[i].compare_exchange_strong(seen, hash, std::memory_order_relaxed))
+                {
+                    used.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+                if (seen == hash)
+                    return false;
+            }
+            return false;
+        }
+
+        size_t size() const { return used.load(std::memory_order_relaxed); }
+
+    private:
+        std::unique_ptr<std::atomic<uint64_t>[]> slots;
+        size_t mask = 0;
+        std::atomic<size_t> used{0};
+    };
+
+    struct Options
+    {
+        int settle = 60;
+        int hold = 6;
+        int release = 6;
+        int ipf = 10;
+        int depth = 20;
+        size_t maxStates = 50000;
+        bool pairs = false;
+        bool idle = false;
+        unsigned threads = 0;
+        uint64_t seed = 1;
+        const char *screenDir = nullptr;
+        const char *storePath = nullptr;
+        const char *romPath = nullptr;
+    };
+
+    void usage()
+    {
+        std::fprintf(stderr, "usage: chip8-explore [--settle N] [--hold N] [--release N] [--ipf N] [--depth N] [--max-states N] "
+                             "[--pairs] [--idle] [--threads N] [--seed N] [--screens DIR] [--store FILE] rom.ch8\n");
+    }
+
+    bool parseArgs(int argc, char **argv, Options &opt)
+    {
+        for (int i = 1; i < argc; ++i)
+        {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--settle" && hasValue)
+                opt.settle = std::atoi(argv[++i]);
+            else if (arg == "--hold" && hasValue)
+                opt.hold = std::atoi(argv[++i]);
+            else if (arg == "--release" && hasValue)
+                opt.release = std::atoi(argv[++i]);
+            else if (arg == "--ipf" && hasValue)
+                opt.ipf = std::atoi(argv[++i]);
+            else if (arg == "--depth" && hasValue)
+                opt.depth = std::atoi(argv[++i]);
+            else if (arg == "--max-states" && hasValue)
+                opt.maxStates = std::strtoull(argv[++i], nullptr, 10);
+            else if (arg == "--threads" && hasValue)
+                opt.threads = static_cast<unsigned>(std::atoi(argv[++i]));
+            else if (arg == "--seed" && hasValue)
+                opt.seed = std::strtoull(argv[++i], nullptr, 0);
+            else if (arg == "--screens" && hasValue)
+                opt.screenDir = argv[++i];
+            else if (arg == "--store" && hasValue)
+                opt.storePath = argv[++i];
+            else if (arg == "--pairs")
+                opt.pairs = true;
+            else if (arg == "--idle")
+                opt.idle = true;
+            else if (arg[0] != '-' && !opt.romPath)
+                opt.romPath = argv[i];
+            else
+                return false;
+        }
+        return opt.romPath && opt.settle >= 0 && opt.hold > 0 && opt.release >= 0 && opt.ipf > 0 && opt.depth >= 0 &&
+               opt.maxStates > 0;
+    }
+
+    // The inputs tried from every state, as key masks
+    std::vector<uint16_t> inputMasks(const Options &opt)
+    {
+        std::vector<uint16_t> masks;
+        if (opt.idle)
+            masks.push_back(0);
+        for (int a = 0; a < 16; ++a)
+        {
+            masks.push_back(static_cast<uint16_t>(1 << a));
+            for (int b = a + 1; opt.pairs && b < 16; ++b)
+                masks.push_back(static_cast<uint16_t>(1 << a | 1 << b));
+        }
+        return masks;
+    }
+
+    void runFrames(Chip8 &chip8, int frames, int ipf)
+    {
+        for (int f = 0; f < frames; ++f)
+            chip8.runFrame(ipf);
+    }
+
+    uint64_t screenHash(const Chip8::Snapshot &state)
+    {
+        return simd::hashBytes(state.gfx.data(), sizeof state.gfx, state.hires);
+    }
+
+    // Binary PBM, one bit per pixel with the leftmost in the top bit
+    bool writeScreen(const fs::path &path, const Chip8::Snapshot &state)
+    {
+        const int width = state.hires ? 128 : 64, height = state.hires ? 64 : 32;
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out << "P4\n" << width << ' ' << height << '\n';
+        for (int y = 0; y < height; ++y)
+        {
+            for (int word = 0; word < width / 64; ++word)
+            {
+                const uint64_t bits = state.gfx[y * Chip8::rowWords + word];
+                for (int byte = 7; byte >= 0; --byte)
+                    out.put(static_cast<char>(bits >> (8 * byte)));
+            }
+        }
+        return static_cast<bool>(out);
+    }
+
+    // A worker's machine, reused for every job it runs
+    thread_local std::unique_ptr<Chip8> workerMachine;
+
+    // States found by one job, merged into the next level afterwards
+    struct alignas(64) JobResult
+    {
+        std::vector<Chip8::Snapshot> states;
+        std::vector<uint64_t> hashes;
+        std::vector<Chip8::Snapshot> screens; // States that showed a new screen
+    };
+}
+
+int main(int argc, char **argv)
+{
+    Options opt;
+    if (!parseArgs(argc, argv, opt))
+    {
+        usage();
+        return 1;
+    }
+
+    Chip8 root;
+    if (!root.loadROM(opt.romPath))
+    {
+        std::fprintf(stderr, "Failed to load ROM: %s\n", opt.romPath);
+        return 1;
+    }
+    root.seedRandom(opt.seed);
+    runFrames(root, opt.settle, opt.ipf);
+
+    if (opt.screenDir)
+    {
+        std::error_code ec;
+        fs::create_directories(opt.screenDir, ec);
+    }
+
+    const std::vector<uint16_t> masks = inputMasks(opt);
+    ConcurrentHashSet seen(opt.maxStates);
+    ConcurrentHashSet screens(opt.maxStates);
+    std::vector<Chip8::Snapshot> level(1);
+    root.snapshot(level[0]);
+    seen.insert(root.stateHash());
+    screens.insert(screenHash(level[0]));
+    size_t screenCount = 0;
+    auto saveScreen = [&](const Chip8::Snapshot &state)
+    {
+        if (opt.screenDir)
+            writeScreen(fs::path(opt.screenDir) / ("screen_" + std::to_string(screenCount) + ".pbm"), state);
+        ++screenCount;
+    };
+    saveScreen(level[0]);
+
+    SnapshotStore store;
+    std::vector<uint64_t> records; // The level, when it's in the store
+    if (opt.storePath)
+    {
+        if (store.open(opt.storePath))
+            records.push_back(store.insert(level[0], root.stateHash()));
+        if (records.empty() || records[0] == UINT64_MAX)
+        {
+            std::fprintf(stderr, "Failed to open state store: %s\n", opt.storePath);
+            return 1;
+        }
+        level.clear();
+        std::printf("%llu states in %s\n", static_cast<unsigned long long>(store.size()), opt.storePath);
+    }
+    auto levelSize = [&]
+    { return opt.storePath ? records.size() : level.size(); };
+    auto levelState = [&](size_t s) -> const Chip8::Snapshot &
+    { return opt.storePath ? store.at(records[s]) : level[s]; };
+
+    ThreadPool pool(opt.threads);
+    const auto start = std::chrono::steady_clock::now();
+    std::printf("%zu inputs from each state, %u threads\n", masks.size(), pool.size());
+
+    int depth = 0;
+    bool full = false;
+    bool storeFull = false;
+    for (; depth < opt.depth && levelSize() != 0 && !full && !storeFull; ++depth)
+    {
+        // A few jobs per thread, so stolen work evens out slow states
+        const size_t count = levelSize();
+        const size_t chunk = std::max<size_t>(1, count / (pool.size() * 4));
+        std::vector<JobResult> results((count + chunk - 1) / chunk);
+        std::atomic<bool> limitHit{false};
+        for (size_t job = 0; job < results.size(); ++job)
+        {
+            pool.submit([&, job]
+                        {
+                            if (!workerMachine)
+                                workerMachine = std::make_unique<Chip8>();
+                            Chip8 &chip8 = *workerMachine;
+                            JobResult &result = results[job];
+                            const size_t end = std::min(count, (job + 1) * chunk);
+                            for (size_t s = job * chunk; s < end; ++s)
+                            {
+                                for (uint16_t mask : masks)
+                                {
+                                    chip8.restore(levelState(s));
+                                    chip8.setKeyMask(0);
+                                    for (int k = 0; k < 16; ++k)
+                                    {
+                                        if ((mask >> k) & 1)
+                                            chip8.setKey(k, true);
+                                    }
+                                    runFrames(chip8, opt.hold, opt.ipf);
+                                    for (int k = 0; k < 16; ++k)
+                                    {
+                                        if ((mask >> k) & 1)
+                                            chip8.setKey(k, false);
+                                    }
+                                    runFrames(chip8, opt.release, opt.ipf);
+
+                                    if (seen.size() >= opt.maxStates)
+                                    {
+                                        limitHit.store(true, std::memory_order_relaxed);
+                                        return;
+                                    }
+                                    const uint64_t hash = chip8.stateHash();
+                                    if (!seen.insert(hash))
+                                        continue;
+                                    result.hashes.push_back(hash);
+                                    result.states.emplace_back();
+                                    chip8.snapshot(result.states.back());
+                                    if (screens.insert(screenHash(result.states.back())))
+                                        result.screens.push_back(result.states.back());
+                                }
+                            }
+                        });
+        }
+        pool.wait();
+
+        // Only this thread writes the store, and only while no job reads it
+        std::vector<Chip8::Snapshot> next;
+        std::vector<uint64_t> nextRecords;
+        size_t newScreens = 0;
+        for (JobResult &result : results)
+        {
+            if (!opt.storePath)
+                next.insert(next.end(), result.states.begin(), result.states.end());
+            for (size_t i = 0; opt.storePath && i < result.states.size() && !storeFull; ++i)
+            {
+                // Same by stateHash, as in the seen set, though an earlier
+                // run may have got there at another cycle count
+                int64_t stored = store.find(result.hashes[i]);
+                nextRecords.push_back(stored >= 0 ? static_cast<uint64_t>(stored)
+                                                  : store.insert(result.states[i], result.hashes[i]));
+                storeFull = nextRecords.back() == UINT64_MAX;
+            }
+            for (const Chip8::Snapshot &state : result.screens)
+                saveScreen(state);
+            newScreens += result.screens.size();
+        }
+        level = std::move(next);
+        records = std::move(nextRecords);
+        full = limitHit.load();
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::printf("depth %2d: %7zu new states, %5zu new screens, %.3f s\n", depth + 1, levelSize(), newScreens, seconds);
+    }
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::printf("%zu states and %zu distinct screens within %d levels in %.3f s%s\n", seen.size(), screenCount, depth, seconds,
+                full ? " (stopped at --max-states)" : storeFull ? " (the store couldn't grow)"
+                : levelSize() == 0 ? " (nothing left to explore)" : "");
+    if (opt.storePath)
+        std::printf("%llu states in %s\n", static_cast<unsigned long long>(store.size()), opt.storePath);
+    return storeFull ? 1 : 0;
+}
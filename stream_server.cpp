@@ -0,0 +1,958 @@
+#include "stream_server.h"
+#include "rom_cache.h"
+#include "rom_database.h"
+#include <algorithm>  // For std::sort, std::remove_if, std::search
+#include <cctype>     // For std::tolower, std::isxdigit
+#include <cerrno>     // For errno
+#include <chrono>     // For the wheel ticks
+#include <cstring>    // For std::memcpy
+#include <filesystem> // For resolving ROM names
+
+#if defined(_WIN32)
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const int64_t frameMicros = 1000000 / 60;
+    const int64_t tickMicros = 1000; // Timer wheel resolution
+    const uint64_t maxLag = 4;       // Frames a session may fall behind before it skips them
+    const size_t maxRequest = 8192; // Bytes of handshake before giving up on a client
+    const size_t maxMessage = 1024; // Largest client message accepted
+    const int64_t budgetMicros = 1000000; // Window the session budgets count over
+    const uint16_t closePolicy = 1008;    // WebSocket close status for a session over budget
+    const uint16_t closeGoingAway = 1001; // Sent to spectators whose session ended
+    const int64_t closeMicros = 5000000;  // Time a closing session gets to drain its output
+    const char acceptGuid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+    enum : uint8_t
+    {
+        FlagHires = 1,
+        FlagSound = 2,
+        FlagKeyframe = 4
+    };
+
+    enum : uint8_t
+    {
+        OpContinuation = 0x0,
+        OpText = 0x1,
+        OpBinary = 0x2,
+        OpClose = 0x8,
+        OpPing = 0x9,
+        OpPong = 0xA
+    };
+
+#if defined(_WIN32)
+    using SocketType = SOCKET;
+    const intptr_t noSocket = static_cast<intptr_t>(INVALID_SOCKET);
+    void closeSocket(intptr_t s) { closesocket(static_cast<SOCKET>(s)); }
+    bool setNonBlocking(SocketType s)
+    {
+        u_long nonBlocking = 1;
+        return ioctlsocket(s, FIONBIO, &nonBlocking) == 0;
+    }
+    bool wouldBlock() { return WSAGetLastError() == WSAEWOULDBLOCK; }
+    int pollSockets(std::vector<WSAPOLLFD> &fds, int timeout) { return WSAPoll(fds.data(), static_cast<ULONG>(fds.size()), timeout); }
+    using PollEntry = WSAPOLLFD;
+    const int sendFlags = 0;
+#else
+    using SocketType = int;
+    const intptr_t noSocket = -1;
+    void closeSocket(intptr_t s) { close(static_cast<int>(s)); }
+    bool setNonBlocking(SocketType s) { return fcntl(s, F_SETFL, fcntl(s, F_GETFL, 0) | O_NONBLOCK) == 0; }
+    bool wouldBlock() { return errno == EWOULDBLOCK || errno == EAGAIN; }
+    int pollSockets(std::vector<pollfd> &fds, int timeout) { return poll(fds.data(), fds.size(), timeout); }
+    using PollEntry = pollfd;
+    const int sendFlags = MSG_NOSIGNAL; // A client gone mid-send is an error, not a signal
+#endif
+
+    std::string base64(const uint8_t *data, size_t size)
+    {
+        static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        std::string out;
+        for (size_t i = 0; i < size; i += 3)
+        {
+            uint32_t group = static_cast<uint32_t>(data[i]) << 16;
+            if (i + 1 < size)
+                group |= static_cast<uint32_t>(data[i + 1]) << 8;
+            if (i + 2 < size)
+                group |= data[i + 2];
+            out += digits[(group >> 18) & 63];
+            out += digits[(group >> 12) & 63];
+            out += i + 1 < size ? digits[(group >> 6) & 63] : '=';
+            out += i + 2 < size ? digits[group & 63] : '=';
+        }
+        return out;
+    }
+
+    // Sec-WebSocket-Accept for a client's Sec-WebSocket-Key
+    std::string acceptKey(const std::string &key)
+    {
+        const std::string joined = key + acceptGuid;
+        const std::string hex = RomDatabase::sha1(reinterpret_cast<const uint8_t *>(joined.data()), joined.size());
+        uint8_t digest[20];
+        for (size_t i = 0; i < sizeof digest; ++i)
+            digest[i] = static_cast<uint8_t>(std::stoi(hex.substr(2 * i, 2), nullptr, 16));
+        return base64(digest, sizeof digest);
+    }
+
+    // Value of header name in an HTTP request, empty if it isn't there
+    std::string header(const std::string &request, const std::string &name)
+    {
+        size_t line = request.find("\r\n");
+        while (line != std::string::npos && line + 2 < request.size())
+        {
+            const size_t start = line + 2;
+            const size_t end = request.find("\r\n", start);
+            const size_t colon = request.find(':', start);
+            if (colon != std::string::npos && colon < end && colon - start == name.size() &&
+                std::equal(name.begin(), name.end(), request.begin() + start, [](char a, char b)
+                           { return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b)); }))
+            {
+                size_t value = request.find_first_not_of(' ', colon + 1);
+                return request.substr(value, end - value);
+            }
+            line = end;
+        }
+        return {};
+    }
+
+    // Server messages are never masked or fragmented
+    void putMessage(std::vector<uint8_t> &out, uint8_t opcode, const uint8_t *payload, size_t size)
+    {
+        out.push_back(0x80 | opcode);
+        if (size < 126)
+            out.push_back(static_cast<uint8_t>(size));
+        else
+        {
+            out.push_back(126);
+            out.push_back(static_cast<uint8_t>(size >> 8));
+            out.push_back(static_cast<uint8_t>(size));
+        }
+        out.insert(out.end(), payload, payload + size);
+    }
+
+    void putWord(uint8_t *&out, uint64_t value)
+    {
+        for (int i = 0; i < 8; ++i)
+            *out++ = (value >> (8 * i)) & 0xFF;
+    }
+
+    enum : uint8_t
+    {
+        WatchMachine = 0x10,
+        WatchFrame = 0x01,
+        WatchKeysFrame = 0x02
+    };
+
+    // A lane as a Chip8 save state; loaded into any core it runs on as the
+    // lane would, see Chip8Batch
+    std::vector<uint8_t> saveStateOf(const Chip8Batch::Machine &lane, Chip8 &scratch)
+    {
+        Chip8::Snapshot s;
+        s.V = lane.regs.V;
+        s.I = lane.regs.I;
+        s.PC = lane.regs.PC;
+        s.sp = lane.regs.sp;
+        s.keyWaitReg = lane.regs.keyWaitReg;
+        s.keyWaitKey = lane.regs.keyWaitKey;
+        s.hires = lane.regs.hires;
+        s.delayExpiry = lane.regs.delayTimer; // Timer frame 0
+        s.soundExpiry = lane.regs.soundTimer;
+        s.rngState = lane.regs.rngState;
+        s.stack = lane.stack;
+        s.rplFlags = lane.rplFlags;
+        s.gfx = lane.gfx;
+        s.memory = lane.memory;
+        scratch.restore(s);
+        return scratch.saveState();
+    }
+
+    // File in folder for a request path, empty unless it names a plain file
+    // there: no subfolders, so ".." can't climb out
+    std::string romPath(const std::string &folder, std::string target)
+    {
+        if (target.empty() || target[0] != '/')
+            return {};
+        target.erase(0, 1);
+        target = target.substr(0, target.find('?'));
+        std::string name;
+        for (size_t i = 0; i < target.size(); ++i)
+        {
+            if (target[i] == '%' && i + 2 < target.size() && std::isxdigit(static_cast<unsigned char>(target[i + 1])) &&
+                std::isxdigit(static_cast<unsigned char>(target[i + 2])))
+            {
+                name += static_cast<char>(std::stoi(target.substr(i + 1, 2), nullptr, 16));
+                i += 2;
+            }
+            else
+                name += target[i];
+        }
+        if (name.empty() || name == "." || name == ".." || name.find_first_of("/\\:") != std::string::npos)
+            return {};
+        std::error_code error;
+        const std::filesystem::path path = std::filesystem::path(folder) / name;
+        return std::filesystem::is_regular_file(path, error) ? path.string() : std::string();
+    }
+}
+
+StreamServer::StreamServer(const Options &options)
+    : options(options), listener(noSocket), pool(options.threads), epoch(Clock::now())
+{
+#if defined(_WIN32)
+    WSADATA data;
+    WSAStartup(MAKEWORD(2, 2), &data);
+#endif
+}
+
+StreamServer::~StreamServer()
+{
+    for (auto &session : sessions)
+        closeSocket(session->socket);
+    if (listener != noSocket)
+        closeSocket(listener);
+#if defined(_WIN32)
+    WSACleanup();
+#endif
+}
+
+bool StreamServer::listen()
+{
+    // Workers start before the sockets exist, so there are none to inherit
+    if (options.sandboxWorkers > 0 && !sandbox)
+    {
+        SandboxPool::Options sandboxOptions;
+        sandboxOptions.workers = options.sandboxWorkers;
+        sandboxOptions.slotsPerWorker = options.sandboxSlots;
+        sandboxOptions.ipf = options.ipf;
+        sandbox = std::make_unique<SandboxPool>(sandboxOptions);
+        if (!sandbox->start())
+        {
+            sandbox.reset();
+            return false;
+        }
+    }
+
+    SocketType s = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+    if (static_cast<intptr_t>(s) == noSocket)
+        return false;
+
+    int reuse = 1;
+    setsockopt(s, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char *>(&reuse), sizeof reuse);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(options.port);
+    if (bind(s, reinterpret_cast<sockaddr *>(&address), sizeof address) != 0 || ::listen(s, SOMAXCONN) != 0 ||
+        !setNonBlocking(s))
+    {
+        closeSocket(static_cast<intptr_t>(s));
+        return false;
+    }
+    listener = static_cast<intptr_t>(s);
+    return true;
+}
+
+void StreamServer::run(const std::atomic<bool> &stop)
+{
+    std::vector<PollEntry> fds;
+    while (!stop.load(std::memory_order_relaxed))
+    {
+        fds.clear();
+        PollEntry entry{};
+        entry.fd = static_cast<SocketType>(listener);
+        entry.events = POLLIN;
+        fds.push_back(entry);
+        for (auto &session : sessions)
+        {
+            entry.fd = static_cast<SocketType>(session->socket);
+            entry.events = static_cast<short>(POLLIN | (session->out.empty() ? 0 : POLLOUT));
+            entry.revents = 0;
+            fds.push_back(entry);
+        }
+
+        const int64_t wait = (static_cast<int64_t>(wheel.nextEvent()) * tickMicros - elapsed() + tickMicros - 1) / tickMicros;
+        if (pollSockets(fds, static_cast<int>(std::max<int64_t>(0, std::min<int64_t>(wait, 1000)))) > 0)
+        {
+            if (fds[0].revents & POLLIN)
+                accept();
+            const size_t polled = fds.size() - 1; // Sessions accepted above weren't polled
+            for (size_t i = 0; i < polled; ++i)
+            {
+                Session &session = *sessions[i];
+                const short events = fds[i + 1].revents;
+                if (events & (POLLERR | POLLHUP | POLLNVAL))
+                    session.closing = true;
+                if (events & POLLIN)
+                    receive(session);
+                if (events & POLLOUT)
+                    flush(session);
+            }
+        }
+
+        stepDue();
+        if (sandbox && sandbox->supervise())
+            closeFaulted();
+
+        // A peer that stops reading never drains its output, so a closing
+        // session goes at its deadline regardless. Polls wait a second at
+        // most, which is as late as one can be dropped.
+        const int64_t now = elapsed();
+        sessions.erase(std::remove_if(sessions.begin(), sessions.end(), [this, now](const std::unique_ptr<Session> &session)
+                                      {
+                                          if (!session->closing)
+                                              return false;
+                                          if (!session->out.empty())
+                                          {
+                                              if (session->closeBy == 0)
+                                                  session->closeBy = now + closeMicros;
+                                              if (now < session->closeBy)
+                                                  return false;
+                                          }
+                                          if (session->watching)
+                                          {
+                                              auto player = byId.find(session->watching);
+                                              if (player != byId.end())
+                                              {
+                                                  std::vector<uint64_t> &list = player->second->watchers;
+                                                  list.erase(std::remove(list.begin(), list.end(), session->id), list.end());
+                                              }
+                                              --spectators;
+                                          }
+                                          for (uint64_t id : session->watchers)
+                                          {
+                                              auto watcher = byId.find(id);
+                                              if (watcher == byId.end() || watcher->second->closing)
+                                                  continue;
+                                              const uint8_t status[2] = {static_cast<uint8_t>(closeGoingAway >> 8), static_cast<uint8_t>(closeGoingAway & 0xFF)};
+                                              putMessage(watcher->second->out, OpClose, status, sizeof status);
+                                              watcher->second->closing = true;
+                                              watcher->second->watching = 0; // Nothing to take it off
+                                              --spectators;
+                                          }
+                                          closeSocket(session->socket);
+                                          byId.erase(session->id); // Its wheel entry is dropped when due
+                                          store.drop(session->id);
+                                          releaseLane(*session);
+                                          if (session->slot >= 0)
+                                              sandbox->close(session->slot);
+                                          return true; }),
+                       sessions.end());
+    }
+}
+
+void StreamServer::accept()
+{
+    for (;;)
+    {
+        SocketType s = ::accept(static_cast<SocketType>(listener), nullptr, nullptr);
+        if (static_cast<intptr_t>(s) == noSocket)
+            return;
+        if (sessions.size() >= options.maxSessions || !setNonBlocking(s))
+        {
+            closeSocket(static_cast<intptr_t>(s));
+            continue;
+        }
+        int noDelay = 1; // Frames are small and late ones are useless
+        setsockopt(s, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char *>(&noDelay), sizeof noDelay);
+        auto session = std::make_unique<Session>();
+        session->id = nextId++;
+        session->socket = static_cast<intptr_t>(s);
+        byId[session->id] = session.get();
+        sessions.push_back(std::move(session));
+    }
+}
+
+void StreamServer::receive(Session &session)
+{
+    uint8_t buffer[4096];
+    for (;;)
+    {
+        const auto got = recv(static_cast<SocketType>(session.socket), reinterpret_cast<char *>(buffer), sizeof buffer, 0);
+        if (got > 0)
+        {
+            session.in.insert(session.in.end(), buffer, buffer + got);
+            continue;
+        }
+        if (got == 0 || !wouldBlock())
+        {
+            session.closing = true;
+            session.out.clear(); // Nobody left to flush to
+            return;
+        }
+        break;
+    }
+    if (!session.open)
+        handshake(session);
+    if (session.open)
+        readMessages(session);
+}
+
+void StreamServer::handshake(Session &session)
+{
+    const char end[] = "\r\n\r\n";
+    auto found = std::search(session.in.begin(), session.in.end(), end, end + 4);
+    if (found == session.in.end())
+    {
+        if (session.in.size() > maxRequest)
+            session.closing = true;
+        return;
+    }
+    const std::string request(session.in.begin(), found + 4);
+    session.in.erase(session.in.begin(), found + 4);
+
+    const auto refuse = [&session](const char *status)
+    {
+        const std::string response = std::string("HTTP/1.1 ") + status + "\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        session.out.assign(response.begin(), response.end());
+        session.closing = true;
+    };
+    const std::string key = header(request, "Sec-WebSocket-Key");
+    if (request.compare(0, 13, "GET /metrics ") == 0 && key.empty())
+    {
+        const std::string body = metricsText();
+        const std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+                                     std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+        session.out.assign(response.begin(), response.end());
+        session.closing = true;
+        return;
+    }
+    if (request.compare(0, 14, "GET /sessions ") == 0 && key.empty())
+    {
+        const std::string body = sessionList();
+        const std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\nContent-Length: " + std::to_string(body.size()) +
+                                     "\r\nConnection: close\r\n\r\n" + body;
+        session.out.assign(response.begin(), response.end());
+        session.closing = true;
+        return;
+    }
+    if (request.compare(0, 4, "GET ") != 0 || key.empty())
+        return refuse("400 Bad Request");
+    const std::string target = request.substr(4, request.find(' ', 4) - 4);
+    const std::string response = "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                                 "Sec-WebSocket-Accept: " +
+                                 acceptKey(key) + "\r\n\r\n";
+    if (target.compare(0, 7, "/watch/") == 0)
+    {
+        auto player = byId.find(std::strtoull(target.c_str() + 7, nullptr, 10));
+        if (player == byId.end() || !player->second->open || player->second->closing || player->second->watching)
+            return refuse("404 Not Found");
+        if (player->second->slot >= 0)
+            return refuse("501 Not Implemented");
+        session.out.assign(response.begin(), response.end());
+        session.open = true;
+        session.watching = player->first;
+        player->second->watchers.push_back(session.id);
+        ++spectators;
+        sendMachine(session, *player->second);
+        return;
+    }
+    const std::string path = romPath(options.romFolder, target);
+    const uint64_t seed = static_cast<uint64_t>(Clock::now().time_since_epoch().count());
+    size_t lane = 0;
+    LaneGroup *group = nullptr;
+    if (sandbox)
+    {
+        std::shared_ptr<const RomCache::Image> image = path.empty() ? nullptr : RomCache::shared().get(path);
+        if (!image)
+            return refuse("404 Not Found");
+        session.slot = sandbox->open(image->data(), image->size(), seed);
+        if (session.slot < 0)
+            return refuse("503 Service Unavailable");
+    }
+    else
+    {
+        group = path.empty() ? nullptr : acquireLane(path, lane);
+        if (!group)
+            return refuse("404 Not Found");
+        group->batch.seedRandom(lane, seed);
+    }
+
+    session.out.assign(response.begin(), response.end());
+    session.group = group;
+    session.lane = lane;
+    session.romPath = path;
+    session.open = true;
+    session.start = session.lastInput = session.budgetStart = elapsed();
+    schedule(session);
+}
+
+// Client messages are masked; whole ones are taken off the input buffer
+void StreamServer::readMessages(Session &session)
+{
+    std::vector<uint8_t> &in = session.in;
+    while (!session.closing && in.size() >= 2)
+    {
+        const uint8_t opcode = in[0] & 0x0F;
+        const bool final = (in[0] & 0x80) != 0;
+        size_t length = in[1] & 0x7F;
+        size_t at = 2;
+        if (length == 126)
+        {
+            if (in.size() < 4)
+                return;
+            length = (static_cast<size_t>(in[2]) << 8) | in[3];
+            at = 4;
+        }
+        else if (length == 127)
+        {
+            session.closing = true; // Nothing a client sends is that big
+            return;
+        }
+        if (!(in[1] & 0x80) || length > maxMessage || !final || opcode == OpContinuation)
+        {
+            session.closing = true;
+            return;
+        }
+        if (in.size() < at + 4 + length)
+            return;
+        uint8_t *payload = in.data() + at + 4;
+        for (size_t i = 0; i < length; ++i)
+            payload[i] ^= in[at + (i & 3)];
+
+        if (opcode == OpBinary && length == 2 && !session.watching)
+        {
+            session.keys = static_cast<uint16_t>(payload[0] | (payload[1] << 8));
+            session.lastInput = elapsed();
+            if (session.slot >= 0)
+                sandbox->setKeys(session.slot, session.keys);
+            else if (!session.group && !wake(session))
+                session.closing = true;
+        }
+        else if (opcode == OpPing)
+            putMessage(session.out, OpPong, payload, length);
+        else if (opcode == OpClose)
+        {
+            putMessage(session.out, OpClose, payload, std::min<size_t>(length, 2));
+            session.closing = true;
+        }
+        in.erase(in.begin(), in.begin() + at + 4 + length);
+    }
+}
+
+void StreamServer::flush(Session &session)
+{
+    while (!session.out.empty())
+    {
+        const auto sent = send(static_cast<SocketType>(session.socket), reinterpret_cast<const char *>(session.out.data()),
+                               static_cast<int>(session.out.size()), sendFlags);
+        if (sent > 0)
+        {
+            session.out.erase(session.out.begin(), session.out.begin() + sent);
+            continue;
+        }
+        if (sent < 0 && wouldBlock())
+            return;
+        session.closing = true;
+        session.out.clear();
+        return;
+    }
+}
+
+int64_t StreamServer::elapsed() const
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - epoch).count();
+}
+
+// A free lane on romPath in a group with room, in a new group if none has
+// any. nullptr if the ROM can't be read.
+StreamServer::LaneGroup *StreamServer::acquireLane(const std::string &romPath, size_t &lane)
+{
+    LaneGroup *group = nullptr;
+    for (auto &candidate : groups)
+    {
+        if (candidate->romPath == romPath && (!candidate->freeLanes.empty() || candidate->batch.size() < lanesPerGroup))
+        {
+            group = candidate.get();
+            break;
+        }
+    }
+    if (!group)
+    {
+        std::shared_ptr<const RomCache::Image> image = RomCache::shared().get(romPath);
+        auto created = std::make_unique<LaneGroup>();
+        if (!image || !created->batch.loadROM(image->data(), image->size()))
+            return nullptr;
+        created->romPath = romPath;
+        group = created.get();
+        groups.push_back(std::move(created));
+    }
+
+    if (!group->freeLanes.empty())
+    {
+        lane = group->freeLanes.back();
+        group->freeLanes.pop_back();
+    }
+    else
+    {
+        lane = group->batch.size();
+        group->batch.resize(lane + 1);
+    }
+    ++group->used;
+    return group;
+}
+
+// The lane goes back to its group, reset so its pages are freed; an empty
+// group goes altogether
+void StreamServer::releaseLane(Session &session)
+{
+    LaneGroup *group = session.group;
+    if (!group)
+        return;
+    session.group = nullptr;
+    if (--group->used == 0)
+    {
+        groups.erase(std::find_if(groups.begin(), groups.end(), [group](const std::unique_ptr<LaneGroup> &g)
+                                  { return g.get() == group; }));
+        return;
+    }
+    group->batch.reset(session.lane);
+    group->freeLanes.push_back(session.lane);
+}
+
+// Next frame on the wheel, on the tick it falls in
+void StreamServer::schedule(Session &session)
+{
+    const int64_t due = session.start + static_cast<int64_t>(session.frames + 1) * frameMicros;
+    wheel.schedule(session.id, static_cast<uint64_t>(due / tickMicros));
+}
+
+// Every session due by now steps in batches on the pool, then goes back on
+// the wheel for its next frame. One that fell behind (the host stalled)
+// gives up the frames it missed instead of racing through them.
+void StreamServer::stepDue()
+{
+    const int64_t now = elapsed();
+    dueIds.clear();
+    wheel.advance(static_cast<uint64_t>(now / tickMicros), dueIds);
+    dueSessions.clear();
+    for (uint64_t id : dueIds)
+    {
+        auto found = byId.find(id);
+        if (found != byId.end() && !found->second->closing)
+            dueSessions.push_back(found->second);
+    }
+    lastDue = dueSessions.size();
+    if (dueSessions.empty())
+        return;
+
+    std::sort(dueSessions.begin(), dueSessions.end(), [](const Session *a, const Session *b)
+              { return a->group < b->group; });
+    for (size_t first = 0; first < dueSessions.size();)
+    {
+        size_t last = first + 1;
+        // Sandboxed sessions share no batch, only the task size bounds them
+        while (last < dueSessions.size() && dueSessions[last]->group == dueSessions[first]->group &&
+               (dueSessions[first]->group || last - first < lanesPerGroup))
+            ++last;
+        // Small enough for std::function to hold without allocating
+        const uint32_t from = static_cast<uint32_t>(first), to = static_cast<uint32_t>(last);
+        pool.submit([this, from, to]
+                    {
+                        for (uint32_t i = from; i < to; ++i)
+                            step(*dueSessions[i]); });
+        first = last;
+    }
+    pool.wait();
+
+    // Sockets stay on the I/O thread
+    for (Session *session : dueSessions)
+    {
+        ++session->frames;
+        if (session->ran && !session->watchers.empty())
+            broadcast(*session);
+        account(*session, now);
+        if (session->slot < 0 && options.idleSeconds > 0 && now - session->lastInput > static_cast<int64_t>(options.idleSeconds) * 1000000)
+            park(*session);
+        else if (now - session->start > static_cast<int64_t>(session->frames + maxLag) * frameMicros)
+        {
+            session->start = now;
+            session->frames = 0;
+        }
+        if (session->group || session->slot >= 0)
+            schedule(*session);
+        if (session->frame.empty())
+            continue;
+        session->out.insert(session->out.end(), session->frame.begin(), session->frame.end());
+        session->frame.clear();
+        flush(*session);
+    }
+}
+
+// Starts the session's next budget window once a second has passed. A
+// session that kept going over the host-time budget is closed with a
+// policy-violation status; its last frame still goes out.
+void StreamServer::account(Session &session, int64_t now)
+{
+    if (now - session.budgetStart < budgetMicros)
+        return;
+    const bool overCpu = options.cpuMicrosBudget > 0 && session.cpuNanos >= options.cpuMicrosBudget * 1000;
+    session.strikes = overCpu ? session.strikes + 1 : 0;
+    session.budgetStart = now;
+    session.instructions = 0;
+    session.cpuNanos = 0;
+    session.bytesSent = 0;
+    if (options.strikeSeconds > 0 && session.strikes >= options.strikeSeconds)
+    {
+        const uint8_t status[2] = {static_cast<uint8_t>(closePolicy >> 8), static_cast<uint8_t>(closePolicy & 0xFF)};
+        putMessage(session.out, OpClose, status, sizeof status);
+        session.closing = true;
+    }
+}
+
+// Sessions whose sandbox worker died or hung can't go on
+void StreamServer::closeFaulted()
+{
+    const uint16_t status = 1011; // Internal error
+    const uint8_t payload[2] = {static_cast<uint8_t>(status >> 8), static_cast<uint8_t>(status & 0xFF)};
+    for (auto &session : sessions)
+    {
+        if (session->slot < 0 || session->closing || !sandbox->faulted(session->slot))
+            continue;
+        putMessage(session->out, OpClose, payload, sizeof payload);
+        session->closing = true;
+    }
+}
+
+// Off the wheel and into the store. The pending frame still goes out, so
+// the client is left showing where the machine stopped.
+void StreamServer::park(Session &session)
+{
+    Chip8Batch::Machine state;
+    session.group->batch.get(session.lane, state);
+    if (!store.park(session.id, session.romPath, state))
+        return; // ROM gone from the folder, keep it running
+    ++parks;
+    releaseLane(session);
+    session.in.shrink_to_fit();
+    session.out.shrink_to_fit();
+}
+
+// Back from the store, stepping again from the next tick on
+bool StreamServer::wake(Session &session)
+{
+    Chip8Batch::Machine state;
+    size_t lane = 0;
+    LaneGroup *group = nullptr;
+    if (!store.unpark(session.id, state) || !(group = acquireLane(session.romPath, lane)))
+        return false;
+    group->batch.set(lane, state);
+    ++wakes;
+    session.group = group;
+    session.lane = lane;
+    session.start = elapsed();
+    session.frames = 0;
+    schedule(session);
+    return true;
+}
+
+// One frame of a session, then its delta against what the client last got.
+// A client that isn't keeping up gets nothing new until it drains; the
+// next delta it does get covers everything it missed.
+void StreamServer::step(Session &session)
+{
+    session.ran = false;
+    if (!session.open || session.closing)
+        return;
+    if (session.slot >= 0)
+    {
+        // The worker ran the frame; take the newest it has
+        if (session.out.size() > maxBacklog || (options.outputBudget > 0 && session.bytesSent >= options.outputBudget))
+            return;
+        SandboxPool::Frame frame;
+        if (!sandbox->latest(session.slot, session.slotFrame, frame))
+            return;
+        metrics.addInstructions((frame.number - session.slotFrame) * static_cast<uint64_t>(options.ipf));
+        session.slotFrame = frame.number;
+        encode(session, frame.gfx, frame.hires, frame.sound);
+        return;
+    }
+    if (!session.group)
+        return;
+    // Past its budget the machine stalls, timers and all, until the next second
+    if ((options.instructionBudget > 0 && session.instructions + static_cast<uint64_t>(options.ipf) > options.instructionBudget) ||
+        (options.cpuMicrosBudget > 0 && session.cpuNanos >= options.cpuMicrosBudget * 1000))
+        return;
+    Chip8Batch &batch = session.group->batch;
+    const size_t lane = session.lane;
+    const Clock::time_point started = Clock::now();
+    const uint16_t changed = static_cast<uint16_t>(session.keys ^ batch.keyMask(lane));
+    for (int k = 0; k < 16; ++k)
+    {
+        if (changed & (1u << k))
+            batch.setKey(lane, k, (session.keys >> k) & 1);
+    }
+    batch.run(lane, options.ipf);
+    const bool sound = batch.getSoundTimer(lane) > 0; // As Chip8::beepFlag after the tick
+    batch.decrementTimers(lane);
+    session.ran = true;
+    session.instructions += static_cast<uint64_t>(options.ipf);
+    const int64_t spent = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - started).count();
+    session.cpuNanos += spent;
+    metrics.recordFrame(static_cast<uint64_t>(options.ipf), spent);
+
+    if (session.out.size() > maxBacklog || (options.outputBudget > 0 && session.bytesSent >= options.outputBudget))
+        return;
+    std::array<uint64_t, frameWords> gfx;
+    batch.screen(lane, gfx);
+    encode(session, gfx, batch.isHires(lane), sound);
+}
+
+// The frame as a keyframe or a delta against what the client last got
+void StreamServer::encode(Session &session, const std::array<uint64_t, frameWords> &gfx, bool hires, bool sound)
+{
+    const uint8_t flags = static_cast<uint8_t>((hires ? FlagHires : 0) | (sound ? FlagSound : 0));
+    // Built on the stack and framed into the session's own buffer, which
+    // keeps its capacity between frames: no allocation per frame
+    uint8_t payload[1 + frameWords / 8 + frameWords * 8];
+    uint8_t *at = payload;
+    if (!session.sentAny)
+    {
+        *at++ = flags | FlagKeyframe;
+        for (size_t i = 0; i < frameWords; ++i)
+            putWord(at, gfx[i]);
+        session.sentAny = true;
+    }
+    else
+    {
+        uint8_t bitmap[frameWords / 8] = {};
+        bool any = false;
+        for (size_t i = 0; i < frameWords; ++i)
+        {
+            if (gfx[i] != session.sent[i])
+            {
+                bitmap[i / 8] |= static_cast<uint8_t>(1u << (i & 7));
+                any = true;
+            }
+        }
+        if (!any && flags == session.sentFlags)
+            return;
+        *at++ = flags;
+        std::memcpy(at, bitmap, sizeof bitmap);
+        at += sizeof bitmap;
+        for (size_t i = 0; i < frameWords; ++i)
+        {
+            if (bitmap[i / 8] & (1u << (i & 7)))
+                putWord(at, gfx[i] ^ session.sent[i]);
+        }
+    }
+    session.sent = gfx;
+    session.sentFlags = flags;
+    putMessage(session.frame, OpBinary, payload, static_cast<size_t>(at - payload));
+    session.bytesSent += session.frame.size();
+    metrics.addBytes(session.frame.size());
+}
+
+// The player's machine as it stands, from its lane or the store, and the
+// keys it holds. Spectators run on from here with the frames after it.
+void StreamServer::sendMachine(Session &spectator, Session &player)
+{
+    Chip8Batch::Machine state;
+    if (player.group)
+        player.group->batch.get(player.lane, state);
+    else if (store.unpark(player.id, state))
+        store.park(player.id, player.romPath, state); // Only looked at
+    else
+        return;
+    const std::vector<uint8_t> blob = saveStateOf(state, scratch);
+    std::vector<uint8_t> payload;
+    payload.reserve(5 + blob.size());
+    payload.push_back(WatchMachine);
+    payload.push_back(static_cast<uint8_t>(options.ipf & 0xFF));
+    payload.push_back(static_cast<uint8_t>(options.ipf >> 8));
+    payload.push_back(static_cast<uint8_t>(state.regs.keys & 0xFF));
+    payload.push_back(static_cast<uint8_t>(state.regs.keys >> 8));
+    payload.insert(payload.end(), blob.begin(), blob.end());
+    putMessage(spectator.out, OpBinary, payload.data(), payload.size());
+    player.watchedKeys = state.regs.keys;
+    metrics.addBytes(spectator.out.size());
+    flush(spectator);
+}
+
+// The frame the player just ran, to each spectator: its keys if they
+// changed. One that is too far behind to take it gets the whole machine
+// again once it has caught up.
+void StreamServer::broadcast(Session &player)
+{
+    const uint16_t keys = player.group->batch.keyMask(player.lane);
+    uint8_t payload[3] = {WatchFrame, 0, 0};
+    size_t length = 1;
+    if (keys != player.watchedKeys)
+    {
+        payload[0] = WatchKeysFrame;
+        payload[1] = static_cast<uint8_t>(keys & 0xFF);
+        payload[2] = static_cast<uint8_t>(keys >> 8);
+        length = 3;
+        player.watchedKeys = keys;
+    }
+    for (uint64_t id : player.watchers)
+    {
+        auto found = byId.find(id);
+        if (found == byId.end() || found->second->closing)
+            continue;
+        Session &spectator = *found->second;
+        if (spectator.out.size() > maxBacklog)
+            spectator.resync = true;
+        if (spectator.resync)
+        {
+            if (spectator.out.empty())
+            {
+                spectator.resync = false;
+                sendMachine(spectator, player);
+            }
+            continue;
+        }
+        const size_t before = spectator.out.size();
+        putMessage(spectator.out, OpBinary, payload, length);
+        metrics.addBytes(spectator.out.size() - before);
+        flush(spectator);
+    }
+}
+
+// One line per player: id, ROM file, what it is doing, spectators
+std::string StreamServer::sessionList() const
+{
+    std::string out;
+    for (const auto &session : sessions)
+    {
+        if (!session->open || session->closing || session->watching)
+            continue;
+        const char *state = session->slot >= 0 ? "sandboxed" : session->group ? "running" : "parked";
+        out += std::to_string(session->id) + "\t" + std::filesystem::path(session->romPath).filename().string() + "\t" + state +
+               "\t" + std::to_string(session->watchers.size()) + "\n";
+    }
+    return out;
+}
+
+std::string StreamServer::metricsText() const
+{
+    size_t open = 0, sandboxed = 0;
+    for (const auto &session : sessions)
+    {
+        open += session->open && !session->watching ? 1 : 0;
+        sandboxed += session->slot >= 0 ? 1 : 0;
+    }
+    std::string out;
+    writeMetric(out, "chip8_sessions", "gauge", "Connected sessions past the handshake", static_cast<double>(open));
+    writeMetric(out, "chip8_sessions_parked", "gauge", "Sessions parked in the store", static_cast<double>(store.size()));
+    writeMetric(out, "chip8_sessions_sandboxed", "gauge", "Sessions in sandbox workers", static_cast<double>(sandboxed));
+    writeMetric(out, "chip8_spectators", "gauge", "Spectators following a session", static_cast<double>(spectators));
+    writeMetric(out, "chip8_lane_groups", "gauge", "Batches of sessions on one ROM", static_cast<double>(groups.size()));
+    writeMetric(out, "chip8_scheduler_queue_depth", "gauge", "Frames waiting on the timer wheel", static_cast<double>(wheel.size()));
+    writeMetric(out, "chip8_scheduler_last_round", "gauge", "Sessions stepped in the last round", static_cast<double>(lastDue));
+    writeMetric(out, "chip8_parked_state_bytes", "gauge", "Encoded bytes of every parked state", static_cast<double>(store.bytesUsed()));
+    writeMetric(out, "chip8_parks_total", "counter", "Sessions parked", static_cast<double>(parks));
+    writeMetric(out, "chip8_wakes_total", "counter", "Parked sessions woken", static_cast<double>(wakes));
+    metrics.write(out, "chip8", true);
+    return out;
+}
@@ -0,0 +1,214 @@
+#ifndef STREAM_SERVER_H
+#define STREAM_SERVER_H
+
+#include "chip8.h"
+#include "chip8_batch.h"
+#include "metrics.h"
+#include "sandbox_pool.h"
+#include "session_store.h"
+#include "thread_pool.h"
+#include "timer_wheel.h"
+#include <array>         // For the last frame a client was sent
+#include <atomic>        // For the stop flag
+#include <chrono>        // For the wheel's epoch
+#include <cstdint>       // For sockets and key masks
+#include <memory>        // For the sessions
+#include <string>        // For the ROM folder
+#include <unordered_map> // For sessions by id
+#include <vector>        // For the session list and socket buffers
+
+// Headless host for many CHIP-8 sessions, one per WebSocket client. A
+// client opens ws://host:port/<rom file>, with the file taken from the ROM
+// folder, and gets a machine of its own: a lane of a Chip8Batch shared by
+// up to lanesPerGroup sessions of that ROM, so the ROM image is held once
+// and a session only owns the 256-byte pages its game has written to.
+// Each session runs at 60 Hz from
+// when it connected, on a timer wheel of 1 ms ticks, so frames of
+// sessions that joined at different times spread over the frame period;
+// every session due on the same tick steps in one round, a task per lane
+// group on the thread pool.
+//
+// Server messages are binary, one per frame that changed anything:
+//   byte 0     bit 0 hi-res, bit 1 buzzer on, bit 2 keyframe
+//   keyframe   the 128 words of the screen in Chip8::gfx layout,
+//              little-endian
+//   otherwise  a 16-byte bitmap of which gfx words changed (bit i of
+//              byte i / 8), then each changed word XORed with the last
+//              one sent, little-endian
+// The first frame is a keyframe. Clients send a binary message of 2 bytes,
+// the held keys (bit k = key k) little-endian, whenever they change.
+//
+// A session that sends no keys for idleSeconds is parked: its machine goes
+// to a SessionStore, off the timer wheel, and the client keeps the last
+// frame. The next keys bring the machine back where it stopped.
+//
+// Budgets are checked once a frame, so the core runs unaware of them. A
+// session's memory needs no limit of its own: a lane owns at most 16
+// pages, and its socket buffers are capped by maxMessage and maxBacklog.
+//
+// With sandboxWorkers set, sessions run in a SandboxPool's worker
+// processes instead of lanes, on the workers' own 60 Hz clocks; each due
+// step sends the newest frame its worker has published. A worker that
+// crashes or hangs closes its sessions with status 1011 and is replaced.
+// Sandboxed sessions are never parked, and only the output budget
+// applies to them: the workers pace the machines themselves.
+//
+// Spectators open ws://host:port/watch/<id> for the session of that id
+// (GET /sessions lists them) and run a copy of its machine themselves, so
+// they cost the server a few bytes a frame whatever the game draws. The
+// first message, and another whenever a spectator fell too far behind to
+// be sent every frame, is the whole machine:
+//   byte 0     0x10
+//   2 bytes    instructions per frame, little-endian
+//   2 bytes    the held keys, as clients send them
+//   then       a Chip8::saveState() blob of the machine
+// and after it one message per frame the session ran:
+//   0x01              a frame with the same keys
+//   0x02, 2 bytes     the keys now held, then a frame
+// A frame is ipf instructions and a timer tick, as Chip8::runFrame; the
+// core is deterministic, so every copy stays the session's machine bit
+// for bit. Sessions stalled by a budget, or parked, send nothing until
+// they run again. Sandboxed sessions can't be watched, their machines are
+// in the workers. Messages from spectators other than pings and closes
+// are ignored; a spectator is closed with status 1001 when its session
+// ends.
+//
+// GET /metrics without a WebSocket upgrade answers in Prometheus text
+// format: sessions by state, instructions and frames run, frame step
+// times, the wheel's queue depth, parked state sizes and park counts.
+class StreamServer
+{
+public:
+    struct Options
+    {
+        uint16_t port = 8068;
+        std::string romFolder = "roms";
+        int ipf = 10;              // Instructions per frame
+        unsigned threads = 0;      // 0 for every hardware thread
+        size_t maxSessions = 10000;
+        int idleSeconds = 60; // Without keys before a session is parked, 0 never
+
+        // Per-session budgets for untrusted ROMs, each per wall-second and 0
+        // for no limit. A session past one stalls, or gets no frames, for
+        // the rest of that second; one over the host-time budget for
+        // strikeSeconds seconds running is closed.
+        uint64_t instructionBudget = 0;   // Instructions run, ipf * 60 when keeping pace
+        int64_t cpuMicrosBudget = 20000;  // Host microseconds spent stepping it
+        size_t outputBudget = 256 * 1024; // Frame bytes sent
+        int strikeSeconds = 10;           // 0 never closes
+
+        unsigned sandboxWorkers = 0; // Worker processes for sessions, 0 to run them here
+        size_t sandboxSlots = 256;   // Sessions per worker
+    };
+
+    explicit StreamServer(const Options &options);
+    ~StreamServer();
+    StreamServer(const StreamServer &) = delete;
+    StreamServer &operator=(const StreamServer &) = delete;
+
+    // False if the port can't be bound
+    bool listen();
+
+    // Serves until stop is set
+    void run(const std::atomic<bool> &stop);
+
+    size_t sessionCount() const { return sessions.size(); }
+    size_t spectatorCount() const { return spectators; }
+    size_t parkedCount() const { return store.size(); }
+
+private:
+    static constexpr size_t frameWords = 128;
+    static constexpr size_t maxBacklog = 64 * 1024; // Unsent bytes before a client stops getting frames
+    static constexpr size_t lanesPerGroup = 256;    // Sessions stepped by one task at most
+
+    // Sessions on one ROM. A batch isn't thread-safe, so one task steps
+    // every due lane of a group.
+    struct LaneGroup
+    {
+        std::string romPath;
+        Chip8Batch batch;
+        std::vector<size_t> freeLanes;
+        size_t used = 0;
+    };
+
+    struct Session
+    {
+        uint64_t id; // Its key in the timer wheel
+        intptr_t socket;
+        bool open = false;    // Past the handshake
+        bool closing = false; // Dropped once its output is flushed, or now on errors
+        int64_t closeBy = 0;  // Dropped then even with output unsent, microseconds after the epoch
+        std::vector<uint8_t> in, out;
+        LaneGroup *group = nullptr; // nullptr while parked
+        size_t lane = 0;
+        long slot = -1;         // In the sandbox pool, -1 for a lane
+        uint64_t slotFrame = 0; // Newest sandbox frame already encoded
+        std::string romPath;
+        int64_t lastInput = 0; // Microseconds after the epoch
+        int64_t start = 0;     // Microseconds after the epoch frame 0 was due
+        uint64_t frames = 0;   // Run since start
+        uint16_t keys = 0;     // As the client last sent them
+        bool sentAny = false;
+        uint8_t sentFlags = 0;
+        std::array<uint64_t, frameWords> sent{};
+        std::vector<uint8_t> frame; // WebSocket message built by the step, sent by the I/O loop
+
+        // Budget use in the wall-second from budgetStart, microseconds after the epoch
+        int64_t budgetStart = 0;
+        uint64_t instructions = 0;
+        int64_t cpuNanos = 0;
+        size_t bytesSent = 0;
+        int strikes = 0; // Seconds in a row over the host-time budget
+
+        // Players keep their spectators' ids; a spectator the id it watches
+        uint64_t watching = 0;      // 0 for a player
+        bool resync = false;        // Spectator that missed frames, sent the machine again once drained
+        bool ran = false;           // The last step ran a frame
+        uint16_t watchedKeys = 0;   // Keys of the last frame spectators were sent
+        std::vector<uint64_t> watchers;
+    };
+
+    void accept();
+    void receive(Session &session);
+    void handshake(Session &session);
+    void readMessages(Session &session);
+    void flush(Session &session);
+    int64_t elapsed() const; // Microseconds since the epoch
+    LaneGroup *acquireLane(const std::string &romPath, size_t &lane);
+    void releaseLane(Session &session);
+    void schedule(Session &session);
+    void park(Session &session);
+    bool wake(Session &session);
+    void stepDue();
+    void step(Session &session);
+    void account(Session &session, int64_t now);
+    void encode(Session &session, const std::array<uint64_t, frameWords> &gfx, bool hires, bool sound);
+    void sendMachine(Session &spectator, Session &player);
+    void broadcast(Session &player);
+    std::string sessionList() const;
+    void closeFaulted();
+    std::string metricsText() const;
+
+    Options options;
+    intptr_t listener;
+    ThreadPool pool;
+    std::vector<std::unique_ptr<Session>> sessions;
+    std::unordered_map<uint64_t, Session *> byId;
+    uint64_t nextId = 1;
+    std::chrono::steady_clock::time_point epoch;
+    TimerWheel wheel; // In milliseconds after the epoch
+    std::vector<uint64_t> dueIds;
+    std::vector<Session *> dueSessions; // Grouped by lane group
+    std::vector<std::unique_ptr<LaneGroup>> groups;
+    SessionStore store;
+    std::unique_ptr<SandboxPool> sandbox; // Only with sandboxWorkers
+
+    // Counted by the stepping threads; the rest only on the I/O thread
+    FrameMetrics metrics;
+    uint64_t parks = 0, wakes = 0;
+    size_t spectators = 0;
+    Chip8 scratch; // Turns lanes into save states for spectators
+    size_t lastDue = 0; // Sessions stepped in the last round
+};
+
+#endif
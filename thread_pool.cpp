@@ -0,0 +1,102 @@
+#include "thread_pool.h"
+#include <algorithm> // For std::max
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    if (threads == 0)
+        threads = std::max(1u, std::thread::hardware_concurrency());
+
+    for (unsigned i = 0; i < threads; ++i)
+        queues.push_back(std::make_unique<Queue>());
+    for (unsigned i = 0; i < threads; ++i)
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        stopping = true;
+    }
+    wakeWorkers.notify_all();
+    for (std::thread &worker : workers)
+        worker.join();
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    Queue &queue = *queues[nextQueue++ % queues.size()];
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(stateMutex);
+        ++queued;
+        ++unfinished;
+    }
+    wakeWorkers.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> lock(stateMutex);
+    allDone.wait(lock, [this]
+                 { return unfinished == 0; });
+}
+
+bool ThreadPool::popTask(unsigned self, std::function<void()> &task)
+{
+    // Own queue first (newest task, still warm in cache)...
+    {
+        Queue &own = *queues[self];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    // ...then steal the oldest task from another worker
+    for (size_t i = 1; i < queues.size(); ++i)
+    {
+        Queue &victim = *queues[(self + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThreadPool::workerLoop(unsigned self)
+{
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(stateMutex);
+            wakeWorkers.wait(lock, [this]
+                             { return stopping || queued > 0; });
+            if (queued == 0)
+                return; // Stopping with nothing left to do
+            --queued;   // Claimed: no other worker wakes for this task
+        }
+
+        // A claimed task is in some queue, but the scan can pass its queue
+        // just before a submit lands there while another worker takes the
+        // one it would have found; it is there on the next pass
+        std::function<void()> task;
+        while (!popTask(self, task))
+            std::this_thread::yield();
+        task();
+
+        std::lock_guard<std::mutex> lock(stateMutex);
+        if (--unfinished == 0)
+            allDone.notify_all();
+    }
+}
@@ -0,0 +1,56 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>             // For the pending task count
+#include <condition_variable> // For idle workers
+#include <deque>              // For the per-worker queues
+#include <functional>         // For std::function
+#include <memory>             // For std::unique_ptr
+#include <mutex>              // For queue locks
+#include <thread>             // For std::thread
+#include <vector>             // For the worker list
+
+// Fixed-size pool where every worker owns a task queue. Workers pop
+// their own queue from the back and steal from the front of the others
+// when it runs dry, so uneven jobs still keep every core busy.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(unsigned threads = 0); // 0 = one per hardware thread
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    // Queue a task; submissions are spread round-robin over the workers
+    void submit(std::function<void()> task);
+
+    // Block until every submitted task has finished
+    void wait();
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+private:
+    // One queue per worker, on its own cache line
+    struct alignas(64) Queue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(unsigned self);
+    bool popTask(unsigned self, std::function<void()> &task);
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::atomic<unsigned> nextQueue{0};
+
+    std::mutex stateMutex;
+    std::condition_variable wakeWorkers;
+    std::condition_variable allDone;
+    size_t queued = 0;     // Tasks waiting in any queue
+    size_t unfinished = 0; // Tasks queued or running
+    bool stopping = false;
+};
+
+#endif
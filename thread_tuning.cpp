@@ -0,0 +1,172 @@
+#include "thread_tuning.h"
+#include <cstdlib> // For std::strtoul
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <avrt.h> // For the MMCSS task
+#elif defined(__linux__)
+#include <pthread.h>      // For pthread_setaffinity_np
+#include <sched.h>        // For cpu_set_t
+#include <sys/resource.h> // For setpriority
+#include <sys/syscall.h>  // For the thread id
+#include <unistd.h>
+#endif
+
+thread_local unsigned ThreadTuning::appliedGeneration = 0;
+
+namespace
+{
+    // What the calling thread was changed to, so threads never tuned are
+    // left as they started
+    struct ThreadState
+    {
+        bool raised = false;
+        bool pinned = false;
+#if defined(_WIN32)
+        HANDLE task = nullptr; // MMCSS registration
+#endif
+    };
+    thread_local ThreadState state;
+
+    void setPriority(ThreadTuning::Role role, bool high)
+    {
+        if (high == state.raised)
+            return;
+#if defined(_WIN32)
+        if (high)
+        {
+            DWORD taskIndex = 0;
+            state.task = AvSetMmThreadCharacteristicsW(role == ThreadTuning::Role::Audio ? L"Audio" : L"Games", &taskIndex);
+            if (!state.task)
+                return;
+            AvSetMmThreadPriority(state.task, AVRT_PRIORITY_HIGH);
+        }
+        else
+        {
+            AvRevertMmThreadCharacteristics(state.task);
+            state.task = nullptr;
+        }
+#elif defined(__linux__)
+        (void)role;
+        // Needs CAP_SYS_NICE or a raised RLIMIT_NICE; without, nothing changes
+        if (setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), high ? -10 : 0) != 0)
+            return;
+#else
+        (void)role;
+        return;
+#endif
+        state.raised = high;
+    }
+
+    void setAffinity(uint64_t mask)
+    {
+        if (mask == 0 && !state.pinned)
+            return;
+#if defined(_WIN32)
+        DWORD_PTR process = 0, system = 0;
+        if (!GetProcessAffinityMask(GetCurrentProcess(), &process, &system))
+            return;
+        const DWORD_PTR wanted = mask ? static_cast<DWORD_PTR>(mask) & process : process;
+        if (wanted == 0 || !SetThreadAffinityMask(GetCurrentThread(), wanted))
+            return;
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+        {
+            if (mask == 0 || (cpu < 64 && ((mask >> cpu) & 1)))
+                CPU_SET(cpu, &set);
+        }
+        if (pthread_setaffinity_np(pthread_self(), sizeof set, &set) != 0)
+            return;
+#else
+        return;
+#endif
+        state.pinned = mask != 0;
+    }
+}
+
+ThreadTuning &ThreadTuning::shared()
+{
+    static ThreadTuning tuning;
+    return tuning;
+}
+
+void ThreadTuning::setHighPriority(bool on)
+{
+    highPriority.store(on, std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+void ThreadTuning::setCores(Role role, uint64_t mask)
+{
+    masks[static_cast<int>(role)].store(mask, std::memory_order_relaxed);
+    generation.fetch_add(1, std::memory_order_release);
+}
+
+void ThreadTuning::reapply(Role role, unsigned now)
+{
+    appliedGeneration = now;
+    setPriority(role, highPriority.load(std::memory_order_relaxed));
+    setAffinity(cores(role));
+}
+
+bool ThreadTuning::parseCores(const std::string &text, uint64_t &mask)
+{
+    uint64_t parsed = 0;
+    const char *p = text.c_str();
+    while (*p == ' ')
+        ++p;
+    while (*p)
+    {
+        char *end = nullptr;
+        const unsigned long first = std::strtoul(p, &end, 10);
+        if (end == p)
+            return false;
+        unsigned long last = first;
+        p = end;
+        if (*p == '-')
+        {
+            ++p;
+            last = std::strtoul(p, &end, 10);
+            if (end == p)
+                return false;
+            p = end;
+        }
+        if (first > last || last > 63)
+            return false;
+        for (unsigned long core = first; core <= last; ++core)
+            parsed |= uint64_t(1) << core;
+        while (*p == ' ')
+            ++p;
+        if (*p == ',')
+            ++p;
+        else if (*p)
+            return false;
+        while (*p == ' ')
+            ++p;
+    }
+    mask = parsed;
+    return true;
+}
+
+std::string ThreadTuning::formatCores(uint64_t mask)
+{
+    std::string text;
+    for (int core = 0; core < 64; ++core)
+    {
+        if (!((mask >> core) & 1))
+            continue;
+        int last = core;
+        while (last < 63 && ((mask >> (last + 1)) & 1))
+            ++last;
+        if (!text.empty())
+            text += ',';
+        text += std::to_string(core);
+        if (last > core)
+            text += '-' + std::to_string(last);
+        core = last;
+    }
+    return text;
+}
@@ -0,0 +1,57 @@
+#ifndef THREAD_TUNING_H
+#define THREAD_TUNING_H
+
+#include <atomic>  // For settings read by every tuned thread
+#include <cstdint> // For core masks
+#include <string>  // For core lists
+
+// Priority and core affinity for the threads that keep a game on time.
+// The settings are shared; each thread brings itself in line when it
+// calls apply, so threads owned by the scheduler's pool or by SDL's audio
+// device are covered without reaching into them. High priority joins the
+// MMCSS "Games" task on Windows ("Audio" for the audio thread), which
+// keeps other services from preempting them; elsewhere it lowers their
+// nice value if the process may. Core masks have a bit per logical
+// processor, the first 64 only; 0 lets a thread run anywhere.
+class ThreadTuning
+{
+public:
+    enum class Role
+    {
+        Emulation, // The scheduler's clock and workers
+        Audio,     // SDL's device callback
+        Render     // The GUI thread, which draws and presents
+    };
+
+    static ThreadTuning &shared();
+
+    void setHighPriority(bool on);
+    bool isHighPriority() const { return highPriority.load(std::memory_order_relaxed); }
+
+    void setCores(Role role, uint64_t mask);
+    uint64_t cores(Role role) const { return masks[static_cast<int>(role)].load(std::memory_order_relaxed); }
+
+    // Call from a thread of role now and then; one atomic load unless the
+    // settings changed since this thread last applied them
+    void apply(Role role)
+    {
+        const unsigned now = generation.load(std::memory_order_acquire);
+        if (now != appliedGeneration)
+            reapply(role, now);
+    }
+
+    // "0,2-3" style lists, empty for any core. False on anything else.
+    static bool parseCores(const std::string &text, uint64_t &mask);
+    static std::string formatCores(uint64_t mask);
+
+private:
+    ThreadTuning() = default;
+    void reapply(Role role, unsigned now);
+
+    static thread_local unsigned appliedGeneration; // 0 = never applied
+    std::atomic<bool> highPriority{false};
+    std::atomic<uint64_t> masks[3] = {};
+    std::atomic<unsigned> generation{1};
+};
+
+#endif
@@ -0,0 +1,74 @@
+#include "timer_wheel.h"
+#include <utility> // For std::swap
+
+void TimerWheel::schedule(uint64_t key, uint64_t due)
+{
+    ++count;
+    if (due <= current)
+        late.push_back(key);
+    else
+        insert({key, due});
+}
+
+void TimerWheel::insert(const Entry &entry)
+{
+    const uint64_t differs = entry.due ^ current;
+    for (int level = 0; level < levels; ++level)
+    {
+        if ((differs >> (slotBits * (level + 1))) == 0)
+        {
+            wheel[level][(entry.due >> (slotBits * level)) & (slots - 1)].push_back(entry);
+            return;
+        }
+    }
+    overflow.push_back(entry);
+}
+
+// Entries of a slot the wheel has reached, placed again a level lower.
+// The slot takes the scratch list's emptied buffer in exchange, so once
+// every slot has grown to its load the wheel stops allocating.
+void TimerWheel::cascade(std::vector<Entry> &slot)
+{
+    std::swap(moving, slot);
+    for (const Entry &entry : moving)
+        insert(entry);
+    moving.clear();
+}
+
+void TimerWheel::advance(uint64_t tick, std::vector<uint64_t> &due)
+{
+    due.insert(due.end(), late.begin(), late.end());
+    count -= late.size();
+    late.clear();
+
+    while (current < tick)
+    {
+        ++current;
+        if ((current & ((uint64_t{1} << (slotBits * levels)) - 1)) == 0)
+            cascade(overflow);
+        for (int level = levels - 1; level > 0; --level)
+        {
+            if ((current & ((uint64_t{1} << (slotBits * level)) - 1)) == 0)
+                cascade(wheel[level][(current >> (slotBits * level)) & (slots - 1)]);
+        }
+
+        std::vector<Entry> &slot = wheel[0][current & (slots - 1)];
+        for (const Entry &entry : slot)
+            due.push_back(entry.key);
+        count -= slot.size();
+        slot.clear();
+    }
+}
+
+uint64_t TimerWheel::nextEvent() const
+{
+    if (!late.empty())
+        return current;
+    const uint64_t boundary = (current | (slots - 1)) + 1;
+    for (uint64_t tick = current + 1; tick < boundary; ++tick)
+    {
+        if (!wheel[0][tick & (slots - 1)].empty())
+            return tick;
+    }
+    return boundary;
+}
@@ -0,0 +1,61 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <array>   // For the levels
+#include <cstddef> // For size_t
+#include <cstdint> // For ticks and keys
+#include <vector>  // For the slots
+
+// Hierarchical timer wheel for many timers of similar period. Four levels
+// of 64 slots cover 2^24 ticks; an entry sits at the level of the highest
+// 6-bit group its due tick differs from the current tick in, and moves
+// down a level each time the wheel reaches its slot, so scheduling is
+// O(1) and advancing one tick costs one slot. Entries due later still
+// wait in an overflow list. Every key that comes due on the same tick is
+// returned together, for the caller to dispatch as one batch.
+//
+// Keys are the caller's. There is no cancel: a key stays scheduled until
+// it comes due, and the caller ignores keys it no longer knows.
+class TimerWheel
+{
+public:
+    explicit TimerWheel(uint64_t now = 0) : current(now) {}
+
+    uint64_t now() const { return current; }
+    size_t size() const { return count; }
+
+    // Due no earlier than the next tick; a due tick already passed comes
+    // due on the next advance()
+    void schedule(uint64_t key, uint64_t due);
+
+    // Moves the wheel on to tick and appends every key due by then to
+    // due, earliest tick first
+    void advance(uint64_t tick, std::vector<uint64_t> &due);
+
+    // Earliest tick at which advance() may return anything: exact within
+    // the current 64 ticks, the next 64-tick boundary otherwise
+    uint64_t nextEvent() const;
+
+private:
+    static constexpr int levels = 4;
+    static constexpr int slotBits = 6;
+    static constexpr uint64_t slots = 1u << slotBits;
+
+    struct Entry
+    {
+        uint64_t key;
+        uint64_t due;
+    };
+
+    void insert(const Entry &entry);
+    void cascade(std::vector<Entry> &slot);
+
+    uint64_t current;
+    size_t count = 0;
+    std::array<std::array<std::vector<Entry>, slots>, levels> wheel;
+    std::vector<Entry> overflow; // Due 2^24 ticks or more away
+    std::vector<uint64_t> late;  // Scheduled at or before the current tick
+    std::vector<Entry> moving;   // Cascade scratch, kept so slots trade buffers instead of reallocating
+};
+
+#endif
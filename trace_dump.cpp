@@ -0,0 +1,66 @@
+// Trace dump: turns a .c8tr execution trace (chip8-headless --trace) into
+// a text listing, one line per instruction:
+//
+//   cycle  PC  opcode  mnemonic  ; I and the registers it changed
+//
+//   chip8-trace-dump trace.c8tr [out.txt]
+//
+// Without an output file the listing goes to stdout.
+
+#include "chip8_disasm.h"
+#include "trace_log.h"
+#include <cstdio>
+
+int main(int argc, char **argv)
+{
+    if (argc < 2 || argc > 3)
+    {
+        std::fprintf(stderr, "usage: chip8-trace-dump trace.c8tr [out.txt]\n");
+        return 1;
+    }
+    TraceReader reader;
+    if (!reader.open(argv[1]))
+    {
+        std::fprintf(stderr, "Not a trace file: %s\n", argv[1]);
+        return 1;
+    }
+    std::FILE *out = argc == 3 ? std::fopen(argv[2], "w") : stdout;
+    if (!out)
+    {
+        std::fprintf(stderr, "Failed to create %s\n", argv[2]);
+        return 1;
+    }
+
+    const TraceRecord &first = reader.initial();
+    std::fprintf(out, "; start at cycle %llu, PC=%03X I=%03X", static_cast<unsigned long long>(first.cycle), first.pc, first.index);
+    for (int r = 0; r < 16; ++r)
+        std::fprintf(out, " V%X=%02X", r, first.v[r]);
+    std::fprintf(out, "\n");
+
+    // F000 NNNN takes its address from the word after it, which the trace
+    // doesn't keep; its load shows up as the change to I
+    TraceRecord record;
+    uint16_t index = first.index;
+    unsigned long long count = 0;
+    while (reader.next(record))
+    {
+        std::fprintf(out, "%12llu  %03X  %04X  %-22s", static_cast<unsigned long long>(record.cycle), record.pc, record.opcode,
+                     Chip8Disassembler::text(record.opcode).c_str());
+        if (record.index != index || record.changed)
+            std::fprintf(out, " ;");
+        if (record.index != index)
+            std::fprintf(out, " I=%03X", record.index);
+        for (int r = 0; r < 16; ++r)
+        {
+            if (record.changed & (1 << r))
+                std::fprintf(out, " V%X=%02X", r, record.v[r]);
+        }
+        std::fprintf(out, "\n");
+        index = record.index;
+        ++count;
+    }
+    if (out != stdout)
+        std::fclose(out);
+    std::fprintf(stderr, "%llu instructions\n", count);
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include "trace_log.h"
+#include <cstring> // For std::memcmp
+
+namespace
+{
+    const char traceMagic[4] = {'C', '8', 'T', 'R'};
+    const uint32_t traceVersion = 1;
+
+    enum : uint8_t
+    {
+        JumpFlag = 1,
+        IndexFlag = 2,
+        CyclesFlag = 4,
+        RegistersFlag = 8
+    };
+
+    void put16(std::ofstream &out, uint16_t value)
+    {
+        out.put(static_cast<char>(value & 0xFF));
+        out.put(static_cast<char>(value >> 8));
+    }
+
+    uint16_t unzigzag16(uint64_t value) { return static_cast<uint16_t>((value >> 1) ^ (0 - (value & 1))); }
+}
+
+bool TraceWriter::start(const std::string &path, uint64_t cycle, uint16_t pc, uint16_t index, const std::array<uint8_t, 16> &v)
+{
+    stop();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+    file.write(traceMagic, sizeof traceMagic);
+    for (int b = 0; b < 4; ++b)
+        file.put(static_cast<char>(traceVersion >> (8 * b)));
+    for (int b = 0; b < 8; ++b)
+        file.put(static_cast<char>(cycle >> (8 * b)));
+    put16(file, pc);
+    put16(file, index);
+    file.write(reinterpret_cast<const char *>(v.data()), v.size());
+
+    fill.resize(bufferBytes);
+    pending.resize(bufferBytes);
+    used = 0;
+    busy = false;
+    stopping = false;
+    failed = false;
+    expectPc = pc;
+    lastIndex = index;
+    lastCycle = cycle;
+    lastV = v;
+    writer = std::thread(&TraceWriter::writeLoop, this);
+    return true;
+}
+
+bool TraceWriter::stop()
+{
+    if (!writer.joinable())
+        return false;
+    handOff(); // The partly filled buffer
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+    file.close();
+    return !failed && !file.fail();
+}
+
+void TraceWriter::handOff()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [this]
+              { return !busy; });
+    fill.swap(pending);
+    pendingBytes = used;
+    used = 0;
+    busy = true;
+    lock.unlock();
+    wake.notify_all();
+}
+
+void TraceWriter::writeLoop()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;)
+    {
+        wake.wait(lock, [this]
+                  { return busy || stopping; });
+        if (busy)
+        {
+            // The caller only touches pending again after busy clears
+            lock.unlock();
+            file.write(reinterpret_cast<const char *>(pending.data()), static_cast<std::streamsize>(pendingBytes));
+            const bool ok = static_cast<bool>(file);
+            lock.lock();
+            failed = failed || !ok;
+            busy = false;
+            wake.notify_all();
+        }
+        else if (stopping)
+            break;
+    }
+    file.flush();
+}
+
+bool TraceReader::open(const std::string &path)
+{
+    file.open(path, std::ios::binary);
+    uint8_t header[4 + 4 + 8 + 2 + 2 + 16];
+    if (!file.read(reinterpret_cast<char *>(header), sizeof header) || std::memcmp(header, traceMagic, sizeof traceMagic) != 0)
+        return false;
+    uint32_t version = 0;
+    for (int b = 0; b < 4; ++b)
+        version |= static_cast<uint32_t>(header[4 + b]) << (8 * b);
+    if (version != traceVersion)
+        return false;
+
+    start = TraceRecord();
+    for (int b = 0; b < 8; ++b)
+        start.cycle |= static_cast<uint64_t>(header[8 + b]) << (8 * b);
+    start.pc = static_cast<uint16_t>(header[16] | header[17] << 8);
+    start.index = static_cast<uint16_t>(header[18] | header[19] << 8);
+    std::memcpy(start.v.data(), header + 20, start.v.size());
+    last = start;
+    expectPc = start.pc;
+    return true;
+}
+
+bool TraceReader::next(TraceRecord &out)
+{
+    const int flags = file.get();
+    const int high = file.get();
+    const int low = file.get();
+    if (low == EOF)
+        return false;
+
+    TraceRecord record = last;
+    record.opcode = static_cast<uint16_t>(high << 8 | low);
+    record.pc = expectPc;
+    record.changed = 0;
+    uint64_t value = 0;
+    if (flags & JumpFlag)
+    {
+        if (!getVarint(value))
+            return false;
+        record.pc = static_cast<uint16_t>(record.pc + unzigzag16(value));
+    }
+    if (flags & IndexFlag)
+    {
+        if (!getVarint(value))
+            return false;
+        record.index = static_cast<uint16_t>(record.index + unzigzag16(value));
+    }
+    record.cycle += 1;
+    if (flags & CyclesFlag)
+    {
+        if (!getVarint(value))
+            return false;
+        record.cycle = last.cycle + value;
+    }
+    if (flags & RegistersFlag)
+    {
+        if (!getVarint(value) || value > 0xFFFF)
+            return false;
+        record.changed = static_cast<uint16_t>(value);
+        for (int r = 0; r < 16; ++r)
+        {
+            if (!(record.changed & (1 << r)))
+                continue;
+            const int byte = file.get();
+            if (byte == EOF)
+                return false;
+            record.v[r] = static_cast<uint8_t>(byte);
+        }
+    }
+    last = record;
+    expectPc = static_cast<uint16_t>(record.pc + 2);
+    out = record;
+    return true;
+}
+
+bool TraceReader::getVarint(uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        int byte = file.get();
+        if (byte == EOF)
+            return false;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+            return true;
+    }
+    return false;
+}
@@ -0,0 +1,176 @@
+#ifndef TRACE_LOG_H
+#define TRACE_LOG_H
+
+#include <array>              // For the registers
+#include <condition_variable> // For the buffer handoff
+#include <cstdint>            // For the record fields
+#include <cstring>            // For std::memcpy
+#include <fstream>            // For the files
+#include <mutex>              // For the buffer handoff
+#include <string>             // For file names
+#include <thread>             // For the writer thread
+#include <vector>             // For the buffers
+
+// Binary execution trace. A .c8tr file is "C8TR", a 32-bit version and the
+// state before the first instruction (64-bit cycle, PC, I, V0..VF), then
+// one record per instruction run:
+//   byte    flags: 1 PC isn't the previous PC + 2, 2 I changed, 4 more
+//           than one cycle since the previous record, 8 V registers changed
+//   2 bytes opcode, big-endian as in memory
+//   varint  with 1, PC minus the expected one, zigzag coded
+//   varint  with 2, I minus the previous I, zigzag coded
+//   varint  with 4, cycles since the previous record
+//   varint  with 8, mask of the changed registers, then their new values
+// Varints are LEB128 as in movies and videos. Straight-line code with no
+// register writes takes three bytes an instruction.
+struct TraceRecord
+{
+    uint64_t cycle = 0; // Instruction count after the instruction
+    uint16_t pc = 0;
+    uint16_t opcode = 0;
+    uint16_t index = 0;          // I after the instruction
+    uint16_t changed = 0;        // Bit x set if Vx changed
+    std::array<uint8_t, 16> v{}; // All registers after the instruction
+};
+
+// Records are encoded into one of two buffers on the calling thread while
+// a thread of the writer's own writes out the other, so the machine only
+// waits if the disk falls a whole buffer behind.
+class TraceWriter
+{
+public:
+    static constexpr size_t bufferBytes = 4 << 20;
+
+    TraceWriter() = default;
+    ~TraceWriter() { stop(); }
+
+    TraceWriter(const TraceWriter &) = delete;
+    TraceWriter &operator=(const TraceWriter &) = delete;
+
+    // The state before the first instruction goes in the header
+    bool start(const std::string &path, uint64_t cycle, uint16_t pc, uint16_t index, const std::array<uint8_t, 16> &v);
+
+    // Writes the rest and closes the file; false if any write failed
+    bool stop();
+    bool isRecording() const { return writer.joinable(); }
+
+    // One instruction, with the state it left behind
+    void record(uint64_t cycle, uint16_t pc, uint16_t opcode, uint16_t index, const std::array<uint8_t, 16> &v)
+    {
+        if (used > bufferBytes - maxRecordBytes)
+            handOff();
+        uint8_t *out = fill.data() + used;
+        uint8_t *flags = out++;
+        *out++ = static_cast<uint8_t>(opcode >> 8);
+        *out++ = static_cast<uint8_t>(opcode);
+        uint8_t bits = 0;
+        if (pc != expectPc)
+        {
+            bits |= 1;
+            out = putVarint(out, zigzag(static_cast<int16_t>(pc - expectPc)));
+        }
+        if (index != lastIndex)
+        {
+            bits |= 2;
+            out = putVarint(out, zigzag(static_cast<int16_t>(index - lastIndex)));
+        }
+        if (cycle != lastCycle + 1)
+        {
+            bits |= 4;
+            out = putVarint(out, cycle - lastCycle);
+        }
+        // Registers compare eight at a time, one flag bit per byte
+        uint64_t now[2], before[2];
+        std::memcpy(now, v.data(), sizeof now);
+        std::memcpy(before, lastV.data(), sizeof before);
+        uint32_t mask = changedBytes(now[0] ^ before[0]) | changedBytes(now[1] ^ before[1]) << 8;
+        if (mask)
+        {
+            bits |= 8;
+            out = putVarint(out, mask);
+            for (int r = 0; mask; ++r, mask >>= 1)
+            {
+                *out = v[r];
+                out += mask & 1;
+            }
+            lastV = v;
+        }
+        *flags = bits;
+        used = static_cast<size_t>(out - fill.data());
+        expectPc = static_cast<uint16_t>(pc + 2);
+        lastIndex = index;
+        lastCycle = cycle;
+    }
+
+private:
+    // Flags, opcode, three varints of up to ten bytes and 16 registers
+    static constexpr size_t maxRecordBytes = 3 + 3 + 3 + 10 + 3 + 16;
+
+    // Bit k set if byte k of x isn't zero: each byte folds into its low
+    // bit, the multiply gathers the eight low bits into the top byte
+    static uint32_t changedBytes(uint64_t x)
+    {
+        x |= x >> 4;
+        x |= x >> 2;
+        x |= x >> 1;
+        x &= 0x0101010101010101;
+        return static_cast<uint32_t>((x * 0x0102040810204080) >> 56);
+    }
+
+    static uint64_t zigzag(int64_t delta) { return (static_cast<uint64_t>(delta) << 1) ^ (0 - (static_cast<uint64_t>(delta) >> 63)); }
+    static uint8_t *putVarint(uint8_t *out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            *out++ = static_cast<uint8_t>(value | 0x80);
+            value >>= 7;
+        }
+        *out++ = static_cast<uint8_t>(value);
+        return out;
+    }
+
+    // Waits for the writer to finish the other buffer, then swaps
+    void handOff();
+    void writeLoop();
+
+    std::ofstream file;
+    std::thread writer;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::vector<uint8_t> fill;    // Being encoded into, the caller's
+    std::vector<uint8_t> pending; // Being written, the writer's while busy
+    size_t used = 0;
+    size_t pendingBytes = 0;
+    bool busy = false;     // pending holds bytes not yet written
+    bool stopping = false;
+    bool failed = false;
+
+    // Previous record, for the deltas
+    uint16_t expectPc = 0;
+    uint16_t lastIndex = 0;
+    uint64_t lastCycle = 0;
+    std::array<uint8_t, 16> lastV{};
+};
+
+// Streams the records of a .c8tr file back
+class TraceReader
+{
+public:
+    bool open(const std::string &path);
+
+    // The state before the first record
+    const TraceRecord &initial() const { return start; }
+
+    // False at the end of the file or at a damaged record
+    bool next(TraceRecord &out);
+
+private:
+    bool getVarint(uint64_t &value);
+
+    std::ifstream file;
+    TraceRecord start;
+    TraceRecord last;
+    uint16_t expectPc = 0;
+};
+
+#endif
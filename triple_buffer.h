@@ -0,0 +1,45 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <array>   // For the three slots
+#include <atomic>  // For the shared slot index
+#include <cstdint> // For uint8_t
+
+// Lock-free single-producer/single-consumer triple buffer. The producer
+// fills back() and publishes it; the consumer picks up the newest
+// published slot with update() and reads it through front(). Neither
+// side ever waits, and the consumer only sees complete values.
+template <typename T>
+class TripleBuffer
+{
+public:
+    // Producer side
+    T &back() { return slots[backIndex]; }
+    void publish()
+    {
+        uint8_t previous = middle.exchange(backIndex | freshBit, std::memory_order_acq_rel);
+        backIndex = previous & indexMask;
+    }
+
+    // Consumer side: true if a newer value was published since the last call
+    bool update()
+    {
+        if (!(middle.load(std::memory_order_relaxed) & freshBit))
+            return false;
+        uint8_t previous = middle.exchange(frontIndex, std::memory_order_acq_rel);
+        frontIndex = previous & indexMask;
+        return true;
+    }
+    const T &front() const { return slots[frontIndex]; }
+
+private:
+    static constexpr uint8_t indexMask = 0x3;
+    static constexpr uint8_t freshBit = 0x4;
+
+    std::array<T, 3> slots{};
+    std::atomic<uint8_t> middle{1}; // Slot between the two sides, plus freshBit
+    uint8_t backIndex = 0;          // Owned by the producer
+    uint8_t frontIndex = 2;         // Owned by the consumer
+};
+
+#endif
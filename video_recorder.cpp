@@ -0,0 +1,557 @@
+#include "video_recorder.h"
+#include "chip8_simd.h"
+#include <algorithm> // For std::min, std::max
+#include <chrono>    // For the encoder's idle wait
+#include <cstring>   // For std::memcmp
+#include <vector>    // For the GIF buffers
+
+namespace
+{
+    const char videoMagic[4] = {'C', '8', 'V', 'D'};
+    const uint16_t videoVersion = 2; // 2 added buzzer changes and cycle counts
+    const size_t screenBytes = 128 * 8;
+
+    enum : uint8_t
+    {
+        HiresFlag = 1,
+        SameFlag = 2,
+        ToneFlag = 4,
+        ToneOnFlag = 8
+    };
+
+    // LEB128 as in movie.cpp
+    void putVarint(std::string &out, uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            out.push_back(static_cast<char>(value | 0x80));
+            value >>= 7;
+        }
+        out.push_back(static_cast<char>(value));
+    }
+
+    bool getVarint(std::istream &in, uint64_t &value)
+    {
+        value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            int byte = in.get();
+            if (byte == EOF)
+                return false;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80))
+                return true;
+        }
+        return false;
+    }
+
+    // Small negative deltas stay one byte
+    uint64_t zigzag(uint64_t delta) { return (delta << 1) ^ (0 - (delta >> 63)); }
+    uint64_t unzigzag(uint64_t value) { return (value >> 1) ^ (0 - (value & 1)); }
+
+    uint8_t screenByte(const std::array<uint64_t, 128> &gfx, size_t i)
+    {
+        return static_cast<uint8_t>(gfx[i / 8] >> (8 * (i % 8)));
+    }
+}
+
+bool VideoRecorder::start(const std::string &path)
+{
+    stop();
+    file.open(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+    file.write(videoMagic, sizeof videoMagic);
+    file.put(static_cast<char>(videoVersion & 0xFF));
+    file.put(static_cast<char>(videoVersion >> 8));
+
+    queue = std::make_unique<SpscQueue<Entry, queueFrames>>();
+    previous = VideoFrame();
+    lastMicros = 0;
+    lastCycle = 0;
+    dropped.store(0);
+    stopping.store(false);
+    encoder = std::thread(&VideoRecorder::encodeLoop, this);
+    return true;
+}
+
+bool VideoRecorder::stop()
+{
+    if (!encoder.joinable())
+        return false;
+    stopping.store(true);
+    encoder.join();
+    file.close();
+    queue.reset();
+    return !file.fail();
+}
+
+bool VideoRecorder::push(const VideoFrame &frame)
+{
+    Entry entry;
+    entry.frame = frame;
+    if (queue->push(entry))
+        return true;
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+bool VideoRecorder::pushTone(const ToneChange &change)
+{
+    Entry entry;
+    entry.frame.micros = change.micros;
+    entry.frame.cycle = change.cycle;
+    entry.tone = true;
+    entry.toneOn = change.on;
+    if (queue->push(entry))
+        return true;
+    dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+// Frames come at 60 Hz, so polling every few milliseconds keeps the
+// queue short without a lock on the producer's side
+void VideoRecorder::encodeLoop()
+{
+    for (;;)
+    {
+        bool finishing = stopping.load();
+        while (const Entry *entry = queue->front())
+        {
+            encode(*entry);
+            queue->pop();
+        }
+        if (finishing)
+            break;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    file.flush();
+}
+
+void VideoRecorder::encode(const Entry &entry)
+{
+    const VideoFrame &frame = entry.frame;
+    record.clear();
+    putVarint(record, frame.micros - lastMicros);
+    bool same = entry.tone || frame.gfx == previous.gfx;
+    uint8_t flags = entry.tone ? ToneFlag | (entry.toneOn ? ToneOnFlag : 0) : (frame.hires ? HiresFlag : 0) | (same ? SameFlag : 0);
+    record.push_back(static_cast<char>(flags));
+    putVarint(record, zigzag(frame.cycle - lastCycle));
+    lastMicros = frame.micros;
+    lastCycle = frame.cycle;
+
+    // Alternating runs of unchanged and changed bytes of the XOR
+    size_t i = 0;
+    while (!same && i < screenBytes)
+    {
+        size_t zeros = i;
+        while (zeros < screenBytes && screenByte(frame.gfx, zeros) == screenByte(previous.gfx, zeros))
+            ++zeros;
+        size_t literals = zeros;
+        while (literals < screenBytes && screenByte(frame.gfx, literals) != screenByte(previous.gfx, literals))
+            ++literals;
+        putVarint(record, zeros - i);
+        putVarint(record, literals - zeros);
+        for (size_t b = zeros; b < literals; ++b)
+            record.push_back(static_cast<char>(screenByte(frame.gfx, b) ^ screenByte(previous.gfx, b)));
+        i = literals;
+    }
+    file.write(record.data(), static_cast<std::streamsize>(record.size()));
+    if (!entry.tone)
+        previous = frame;
+}
+
+bool VideoReader::open(const std::string &path)
+{
+    file.open(path, std::ios::binary);
+    char header[6];
+    if (!file.read(header, sizeof header))
+        return false;
+    previous = VideoFrame();
+    lastMicros = 0;
+    lastCycle = 0;
+    version = static_cast<uint16_t>(static_cast<uint8_t>(header[4]) | static_cast<uint8_t>(header[5]) << 8);
+    return std::memcmp(header, videoMagic, sizeof videoMagic) == 0 && version >= 1 && version <= videoVersion;
+}
+
+bool VideoReader::next(VideoFrame &out)
+{
+    tones.clear();
+    for (;;)
+    {
+        uint64_t delta = 0;
+        if (!getVarint(file, delta))
+            return false;
+        int flags = file.get();
+        uint64_t cycles = 0;
+        if (flags == EOF || (version >= 2 && !getVarint(file, cycles)))
+            return false;
+        lastMicros += delta;
+        lastCycle += unzigzag(cycles);
+        if (flags & ToneFlag)
+        {
+            tones.push_back({lastMicros, lastCycle, (flags & ToneOnFlag) != 0});
+            continue;
+        }
+
+        out = previous;
+        out.micros = lastMicros;
+        out.cycle = lastCycle;
+        out.hires = (flags & HiresFlag) != 0;
+        size_t i = 0;
+        while (!(flags & SameFlag) && i < screenBytes)
+        {
+            uint64_t zeros = 0, literals = 0;
+            if (!getVarint(file, zeros) || !getVarint(file, literals) || zeros + literals > screenBytes - i)
+                return false;
+            i += zeros;
+            for (uint64_t b = 0; b < literals; ++b, ++i)
+            {
+                int byte = file.get();
+                if (byte == EOF)
+                    return false;
+                out.gfx[i / 8] ^= static_cast<uint64_t>(byte) << (8 * (i % 8));
+            }
+        }
+        previous = out;
+        return true;
+    }
+}
+
+namespace
+{
+    const int gifWidth = 128;
+    const int gifHeight = 64;
+    const int gifMinDelay = 2; // Centiseconds; browsers slow anything shorter down
+
+    // One pixel per byte at 128x64, lo-res doubled
+    std::vector<uint8_t> gifPixels(const VideoFrame &frame)
+    {
+        std::vector<uint8_t> pixels(gifWidth * gifHeight);
+        const int scale = frame.hires ? 1 : 2;
+        simd::expandFrame(pixels.data(), gifWidth, frame.gfx.data(), 2, gifWidth / scale, gifHeight / scale, 0, 1, scale);
+        return pixels;
+    }
+
+    // LSB-first code packer in 255-byte sub-blocks
+    class GifBits
+    {
+    public:
+        explicit GifBits(std::string &outRef) : out(outRef) {}
+
+        void put(unsigned code, int size)
+        {
+            bits |= static_cast<uint32_t>(code) << count;
+            count += size;
+            while (count >= 8)
+            {
+                byte(static_cast<uint8_t>(bits));
+                bits >>= 8;
+                count -= 8;
+            }
+        }
+
+        void finish()
+        {
+            if (count > 0)
+                byte(static_cast<uint8_t>(bits));
+            if (!block.empty())
+                flushBlock();
+            out.push_back('\0');
+        }
+
+    private:
+        void byte(uint8_t value)
+        {
+            block.push_back(static_cast<char>(value));
+            if (block.size() == 255)
+                flushBlock();
+        }
+        void flushBlock()
+        {
+            out.push_back(static_cast<char>(block.size()));
+            out += block;
+            block.clear();
+        }
+
+        std::string &out;
+        std::string block;
+        uint32_t bits = 0;
+        int count = 0;
+    };
+
+    // Two colours, so the minimum code size is 2 and the pixel alphabet
+    // 0..3; the table is indexed by prefix code and next pixel
+    void gifCompress(std::string &out, const std::vector<uint8_t> &indices)
+    {
+        const int minCodeSize = 2;
+        const unsigned clearCode = 1u << minCodeSize;
+        const unsigned endCode = clearCode + 1;
+        out.push_back(static_cast<char>(minCodeSize));
+        GifBits bits(out);
+
+        std::vector<std::array<uint16_t, 4>> table(4096);
+        int codeSize = minCodeSize + 1;
+        unsigned nextCode = endCode + 1;
+        auto resetTable = [&]()
+        {
+            for (auto &entry : table)
+                entry.fill(0);
+            codeSize = minCodeSize + 1;
+            nextCode = endCode + 1;
+        };
+        bits.put(clearCode, codeSize);
+
+        unsigned prefix = indices[0];
+        for (size_t i = 1; i < indices.size(); ++i)
+        {
+            uint8_t pixel = indices[i];
+            if (table[prefix][pixel])
+            {
+                prefix = table[prefix][pixel];
+                continue;
+            }
+            bits.put(prefix, codeSize);
+            if (nextCode < 4096)
+            {
+                table[prefix][pixel] = static_cast<uint16_t>(nextCode++);
+                if (nextCode > (1u << codeSize) && codeSize < 12)
+                    ++codeSize;
+            }
+            else
+            {
+                bits.put(clearCode, codeSize);
+                resetTable();
+            }
+            prefix = pixel;
+        }
+        bits.put(prefix, codeSize);
+
+        // Decoders add an entry after the last code too
+        if (nextCode == (1u << codeSize) && codeSize < 12)
+            ++codeSize;
+        bits.put(endCode, codeSize);
+        bits.finish();
+    }
+
+    void putU16(std::string &out, unsigned value)
+    {
+        out.push_back(static_cast<char>(value & 0xFF));
+        out.push_back(static_cast<char>(value >> 8));
+    }
+
+    // Only the rectangle that changed from shown, over what is left there
+    void gifFrame(std::string &out, const std::vector<uint8_t> &pixels, std::vector<uint8_t> &shown, unsigned delay, int scale)
+    {
+        int left = gifWidth, top = gifHeight, right = -1, bottom = -1;
+        for (int y = 0; y < gifHeight; ++y)
+        {
+            for (int x = 0; x < gifWidth; ++x)
+            {
+                if (pixels[y * gifWidth + x] != shown[y * gifWidth + x])
+                {
+                    left = std::min(left, x);
+                    right = std::max(right, x);
+                    top = std::min(top, y);
+                    bottom = std::max(bottom, y);
+                }
+            }
+        }
+        if (right < 0)
+            left = top = right = bottom = 0; // Nothing changed, one pixel carries the delay
+        shown = pixels;
+
+        // Graphic control extension: keep the previous frame, delay in 1/100 s
+        out += "\x21\xF9\x04";
+        out.push_back('\x04');
+        putU16(out, delay);
+        out.push_back('\0');
+        out.push_back('\0');
+
+        int w = (right - left + 1) * scale;
+        int h = (bottom - top + 1) * scale;
+        out.push_back('\x2C');
+        putU16(out, left * scale);
+        putU16(out, top * scale);
+        putU16(out, w);
+        putU16(out, h);
+        out.push_back('\0');
+
+        std::vector<uint8_t> indices(static_cast<size_t>(w) * h);
+        for (int y = 0; y < h; ++y)
+        {
+            for (int x = 0; x < w; ++x)
+                indices[y * w + x] = pixels[(top + y / scale) * gifWidth + left + x / scale];
+        }
+        gifCompress(out, indices);
+    }
+}
+
+bool exportGif(const std::string &videoPath, const std::string &gifPath, int scale)
+{
+    VideoReader reader;
+    if (scale < 1 || !reader.open(videoPath))
+        return false;
+    std::ofstream file(gifPath, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    std::string out = "GIF89a";
+    putU16(out, gifWidth * scale);
+    putU16(out, gifHeight * scale);
+    out.push_back('\x81'); // Global table of 4 entries
+    out.push_back('\0');
+    out.push_back('\0');
+    out.append("\x00\x00\x00\xFF\xFF\xFF\x00\x00\x00\x00\x00\x00", 12);
+    out += "\x21\xFF\x0BNETSCAPE2.0\x03\x01";
+    putU16(out, 0); // Loop forever
+    out.push_back('\0');
+
+    // A frame is written once the next one that differs shows up, so its
+    // delay is known; changes too soon after it replace it
+    std::vector<uint8_t> shown(gifWidth * gifHeight, 0xFF);
+    std::vector<uint8_t> pending;
+    uint64_t pendingStart = 0; // Centiseconds
+    uint64_t now = 0;
+    auto emitPending = [&](uint64_t delay)
+    {
+        // Delays are 16 bits, longer stills repeat
+        while (delay > 0)
+        {
+            unsigned part = static_cast<unsigned>(std::min<uint64_t>(delay, 0xFFFF));
+            gifFrame(out, pending, shown, part, scale);
+            delay -= part;
+        }
+        file.write(out.data(), static_cast<std::streamsize>(out.size()));
+        out.clear();
+    };
+    VideoFrame frame;
+    while (reader.next(frame))
+    {
+        std::vector<uint8_t> pixels = gifPixels(frame);
+        now = frame.micros / 10000;
+        if (pending.empty())
+        {
+            pending = std::move(pixels);
+            pendingStart = now;
+            continue;
+        }
+        if (pixels == pending)
+            continue;
+        if (now - pendingStart < gifMinDelay)
+        {
+            pending = std::move(pixels);
+            continue;
+        }
+        emitPending(now - pendingStart);
+        pending = std::move(pixels);
+        pendingStart = now;
+    }
+
+    // The last screen stays up as long as the recording went on
+    if (!pending.empty())
+        emitPending(std::max<uint64_t>(now - pendingStart, gifMinDelay));
+    out.push_back('\x3B');
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    return static_cast<bool>(file);
+}
+
+namespace
+{
+    void putU32(std::string &out, uint32_t value)
+    {
+        for (int i = 0; i < 4; ++i)
+            out.push_back(static_cast<char>(value >> (8 * i)));
+    }
+
+    // Where a change falls between the frames around it, by the cycles
+    // run; its own time if the cycles don't move forward across them
+    uint64_t toneMicros(const ToneChange &tone, const VideoFrame &before, const VideoFrame &after)
+    {
+        if (after.cycle <= before.cycle || tone.cycle < before.cycle || tone.cycle > after.cycle)
+            return tone.micros;
+        double t = static_cast<double>(tone.cycle - before.cycle) / static_cast<double>(after.cycle - before.cycle);
+        return before.micros + static_cast<uint64_t>(t * static_cast<double>(after.micros - before.micros));
+    }
+}
+
+bool exportWav(const std::string &videoPath, const std::string &wavPath, int sampleRate)
+{
+    const double toneHz = 440.0; // As AudioOutput
+    const int16_t amplitude = 8192;
+
+    VideoReader reader;
+    if (sampleRate <= 0 || !reader.open(videoPath))
+        return false;
+    std::ofstream file(wavPath, std::ios::binary | std::ios::trunc);
+    if (!file)
+        return false;
+
+    // The sizes are patched once the length is known
+    std::string header = "RIFF";
+    putU32(header, 0);
+    header += "WAVEfmt ";
+    putU32(header, 16);
+    putU16(header, 1); // PCM
+    putU16(header, 1); // Mono
+    putU32(header, static_cast<uint32_t>(sampleRate));
+    putU32(header, static_cast<uint32_t>(sampleRate) * 2);
+    putU16(header, 2);
+    putU16(header, 16);
+    header += "data";
+    putU32(header, 0);
+    file.write(header.data(), static_cast<std::streamsize>(header.size()));
+
+    // Samples up to each change are written as it is placed
+    std::string samples;
+    uint64_t written = 0;
+    bool on = false;
+    double phase = 0;
+    auto fillTo = [&](uint64_t micros)
+    {
+        uint64_t end = micros * static_cast<uint64_t>(sampleRate) / 1000000;
+        samples.clear();
+        for (; written < end; ++written)
+        {
+            int16_t value = 0;
+            if (on)
+            {
+                value = phase < 0.5 ? amplitude : -amplitude;
+                phase += toneHz / sampleRate;
+                phase -= static_cast<int>(phase);
+            }
+            putU16(samples, static_cast<uint16_t>(value));
+        }
+        file.write(samples.data(), static_cast<std::streamsize>(samples.size()));
+    };
+
+    VideoFrame before, frame;
+    bool started = false; // A frame came before the changes being placed
+    bool more = true;
+    while (more)
+    {
+        more = reader.next(frame);
+        for (const ToneChange &tone : reader.tonesBefore())
+        {
+            fillTo(more && started ? toneMicros(tone, before, frame) : tone.micros);
+            on = tone.on;
+        }
+        if (more)
+        {
+            fillTo(frame.micros);
+            before = frame;
+            started = true;
+        }
+    }
+
+    uint32_t dataBytes = static_cast<uint32_t>(written * 2);
+    std::string size;
+    putU32(size, 36 + dataBytes);
+    file.seekp(4);
+    file.write(size.data(), 4);
+    size.clear();
+    putU32(size, dataBytes);
+    file.seekp(40);
+    file.write(size.data(), 4);
+    return static_cast<bool>(file);
+}
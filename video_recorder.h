@@ -0,0 +1,125 @@
+#ifndef VIDEO_RECORDER_H
+#define VIDEO_RECORDER_H
+
+#include "spsc_queue.h"
+#include <array>   // For the frame copy
+#include <atomic>  // For the encoder's stop flag and counters
+#include <cstdint> // For the timestamps
+#include <fstream> // For the output file
+#include <memory>  // For the frame queue
+#include <string>  // For file names
+#include <thread>  // For the encoder thread
+#include <vector>  // For the tone changes between frames
+
+// Lossless recording of the screen and the buzzer. A .c8v file is "C8VD"
+// and a 16-bit version, then records until the end of the file:
+//   varint  microseconds since the previous record
+//   byte    flags: 1 hi-res, 2 same screen as the previous frame,
+//           4 buzzer change instead of a frame, 8 buzzer on after it
+//   varint  emulated cycles since the previous record, zigzag coded as
+//           rewinding goes back (version 2 on)
+//   then for frames, unless 2 is set, the 1024 bytes of gfx XORed with
+//   the previous frame as runs: varint zero bytes, varint literal bytes,
+//   the literals, repeated until all 1024 are covered
+// Varints are LEB128 as in movies. Most frames change a few bytes, so an
+// hour comes to a few MB. The file stays readable up to the last whole
+// record if the recorder never got to stop(). Buzzer changes carry the
+// cycle they happened on, so the sound can be rebuilt in step with the
+// frames around them rather than recorded as samples.
+struct VideoFrame
+{
+    std::array<uint64_t, 128> gfx{}; // Chip8::gfx layout
+    bool hires = false;
+    uint64_t micros = 0; // Since the recording started
+    uint64_t cycle = 0;  // Emulated cycle count on the frame
+};
+
+struct ToneChange
+{
+    uint64_t micros = 0;
+    uint64_t cycle = 0;
+    bool on = false;
+};
+
+// Frames are queued by one producer thread and compressed and written by
+// a thread of the recorder's own, so the emulation never waits on disk.
+class VideoRecorder
+{
+public:
+    static constexpr size_t queueFrames = 256; // About four seconds of backlog before frames drop
+
+    VideoRecorder() = default;
+    ~VideoRecorder() { stop(); }
+
+    VideoRecorder(const VideoRecorder &) = delete;
+    VideoRecorder &operator=(const VideoRecorder &) = delete;
+
+    bool start(const std::string &path);
+
+    // Flushes the queue and closes the file; false if any write failed
+    bool stop();
+    bool isRecording() const { return encoder.joinable(); }
+
+    // Producer side; false if the queue was full and the frame dropped
+    bool push(const VideoFrame &frame);
+    bool pushTone(const ToneChange &change);
+    uint64_t droppedFrames() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+    // A frame, or with tone set a buzzer change at frame's time and cycle
+    struct Entry
+    {
+        VideoFrame frame;
+        bool tone = false;
+        bool toneOn = false;
+    };
+
+    void encodeLoop();
+    void encode(const Entry &entry);
+
+    std::unique_ptr<SpscQueue<Entry, queueFrames>> queue;
+    std::thread encoder;
+    std::atomic<bool> stopping{false};
+    std::atomic<uint64_t> dropped{0};
+
+    // Encoder thread only
+    std::ofstream file;
+    VideoFrame previous;
+    uint64_t lastMicros = 0;
+    uint64_t lastCycle = 0;
+    std::string record; // Staging for one frame
+};
+
+// Streams the frames of a .c8v file back
+class VideoReader
+{
+public:
+    bool open(const std::string &path);
+
+    // False at the end of the file or at a damaged record
+    bool next(VideoFrame &out);
+
+    // Buzzer changes read on the way to the frame next() returned, or
+    // once it returned false, those after the last frame
+    const std::vector<ToneChange> &tonesBefore() const { return tones; }
+
+private:
+    std::ifstream file;
+    uint16_t version = 0;
+    VideoFrame previous;
+    uint64_t lastMicros = 0;
+    uint64_t lastCycle = 0;
+    std::vector<ToneChange> tones;
+};
+
+// Writes a recording as an animated GIF, each pixel scale x scale and lo-res
+// doubled so the size never changes. Frames closer than the 1/50 s GIF
+// delays can show are merged.
+bool exportGif(const std::string &videoPath, const std::string &gifPath, int scale = 4);
+
+// Rebuilds the buzzer as a mono 16-bit WAV, the 440 Hz square wave of
+// AudioOutput. Each change is placed by its cycle between the frames
+// around it, so the sound lines up with the picture.
+bool exportWav(const std::string &videoPath, const std::string &wavPath, int sampleRate = 44100);
+
+#endif
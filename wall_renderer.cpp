@@ -0,0 +1,176 @@
+#include "wall_renderer.h"
+#include "gl_functions.h"
+#include <algorithm> // For std::min
+#include <cstring>   // For std::memcpy
+#include <utility>   // For std::move
+
+namespace
+{
+    const float tileMargin = 0.03f; // Gap around each tile, as a fraction of its cell
+
+    // Instance i is tile i, placed row by row from the top left. The quad's
+    // corners come from gl_VertexID, so there is no vertex data at all.
+    const char *vertexSource = R"(#version 330 core
+uniform ivec2 grid;
+uniform float margin;
+out vec2 uv;
+flat out int layer;
+void main()
+{
+    uv = vec2(gl_VertexID & 1, gl_VertexID >> 1);
+    layer = gl_InstanceID;
+    vec2 cell = vec2(gl_InstanceID % grid.x, gl_InstanceID / grid.x);
+    vec2 pos = (cell + margin + uv * (1.0 - 2.0 * margin)) / vec2(grid);
+    gl_Position = vec4(pos.x * 2.0 - 1.0, 1.0 - pos.y * 2.0, 0.0, 1.0);
+}
+)";
+
+    // Same bit lookup as the single-screen shader, per layer. Row 64 holds
+    // the layer's flags: bit 0 is hi-res.
+    const char *fragmentSource = R"(#version 330 core
+uniform usampler2DArray screens;
+uniform vec3 palette[2];
+uniform int selected;
+in vec2 uv;
+flat in int layer;
+out vec4 color;
+void main()
+{
+    bool hires = (texelFetch(screens, ivec3(0, 64, layer), 0).r & 1u) != 0u;
+    vec2 extent = hires ? vec2(128.0, 64.0) : vec2(64.0, 32.0);
+    ivec2 p = min(ivec2(uv * extent), ivec2(extent) - 1);
+    uint bits = texelFetch(screens, ivec3((p.x >> 5) ^ 1, p.y, layer), 0).r;
+    int lit = int((bits >> uint(31 - (p.x & 31))) & 1u);
+    vec3 c = palette[lit];
+
+    // A frame a few window pixels thick around the selected tile
+    vec2 edge = min(uv, 1.0 - uv) / fwidth(uv);
+    if (layer == selected && min(edge.x, edge.y) < 3.0)
+        c = palette[1];
+    color = vec4(c, 1.0);
+}
+)";
+}
+
+WallRenderer::WallRenderer(std::function<void()> swap)
+    : swapBuffers(std::move(swap))
+{
+}
+
+WallRenderer::~WallRenderer()
+{
+    if (texture)
+        glDeleteTextures(1, &texture);
+    if (vertexArray)
+        gl.DeleteVertexArrays(1, &vertexArray);
+    if (program)
+        gl.DeleteProgram(program);
+}
+
+bool WallRenderer::init(int count)
+{
+    if (ready)
+        return true;
+    if (count < 1 || count > maxTiles || !loadGlFunctions())
+        return false;
+
+    for (int i = 0; i < 16 && glGetError() != GL_NO_ERROR; ++i)
+    {
+    }
+
+    program = linkGlProgram(vertexSource, fragmentSource);
+    if (!program)
+        return false;
+    gl.UseProgram(program);
+    gl.Uniform1i(gl.GetUniformLocation(program, "screens"), 0);
+    gl.Uniform1f(gl.GetUniformLocation(program, "margin"), tileMargin);
+    gridUniform = gl.GetUniformLocation(program, "grid");
+    paletteUniform = gl.GetUniformLocation(program, "palette");
+    selectedUniform = gl.GetUniformLocation(program, "selected");
+
+    // Core profile draws need a vertex array bound, even an empty one
+    gl.GenVertexArrays(1, &vertexArray);
+
+    // 4x65 32-bit texels per layer: the 128x64 screen and the flags row
+    gl.ActiveTexture(GL_TEXTURE0);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, 0);
+    gl.TexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_R32UI, 4, 65, count, 0, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+
+    tiles.assign(static_cast<size_t>(count), Tile());
+    ready = glGetError() == GL_NO_ERROR;
+    return ready;
+}
+
+void WallRenderer::resize(int newWidth, int newHeight)
+{
+    width = newWidth;
+    height = newHeight;
+    glViewport(0, 0, width, height);
+
+    // Try every column count and keep the one with the biggest 2:1 tiles
+    const int count = std::max(1, static_cast<int>(tiles.size()));
+    float best = -1.0f;
+    for (int columns = 1; columns <= count; ++columns)
+    {
+        int rows = (count + columns - 1) / columns;
+        float scale = std::min(static_cast<float>(width) / columns / 2.0f, static_cast<float>(height) / rows);
+        if (scale > best)
+        {
+            best = scale;
+            gridColumns = columns;
+            gridRows = rows;
+        }
+    }
+}
+
+int WallRenderer::tileAt(int x, int y) const
+{
+    if (width <= 0 || height <= 0 || x < 0 || y < 0 || x >= width || y >= height)
+        return -1;
+    float cellX = static_cast<float>(x) * gridColumns / width;
+    float cellY = static_cast<float>(y) * gridRows / height;
+    float inX = cellX - static_cast<int>(cellX);
+    float inY = cellY - static_cast<int>(cellY);
+    if (inX < tileMargin || inX > 1.0f - tileMargin || inY < tileMargin || inY > 1.0f - tileMargin)
+        return -1;
+    int tile = static_cast<int>(cellY) * gridColumns + static_cast<int>(cellX);
+    return tile < static_cast<int>(tiles.size()) ? tile : -1;
+}
+
+void WallRenderer::upload(int index, const Framebuffer &gfx, bool hires)
+{
+    if (index < 0 || index >= static_cast<int>(tiles.size()))
+        return;
+    Tile &tile = tiles[index];
+    if (!tile.stale && tile.hires == hires && tile.gfx == gfx)
+        return;
+    tile.gfx = gfx;
+    tile.hires = hires;
+    tile.stale = false;
+
+    std::memcpy(staging.data(), gfx.data(), sizeof gfx);
+    staging[4 * 64] = hires ? 1u : 0u;
+    gl.ActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    gl.TexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, index, 4, 65, 1, GL_RED_INTEGER, GL_UNSIGNED_INT, staging.data());
+}
+
+void WallRenderer::draw(const Color &off, const Color &on, int selected)
+{
+    const GLfloat palette[6] = {off[0], off[1], off[2], on[0], on[1], on[2]};
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    gl.UseProgram(program);
+    gl.Uniform2i(gridUniform, gridColumns, gridRows);
+    gl.Uniform3fv(paletteUniform, 2, palette);
+    gl.Uniform1i(selectedUniform, selected);
+    gl.BindVertexArray(vertexArray);
+    gl.ActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    gl.DrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, static_cast<GLsizei>(tiles.size()));
+}
@@ -0,0 +1,71 @@
+#ifndef WALL_RENDERER_H
+#define WALL_RENDERER_H
+
+#include "screen_backend.h"
+#include <array>      // For the layer staging
+#include <cstdint>    // For texel words
+#include <functional> // For the swap callback
+#include <vector>     // For the per-tile state
+
+// OpenGL 3.3 renderer for a grid of CHIP-8 screens. Every screen is one
+// layer of an integer array texture, with its resolution in an extra row,
+// and the whole wall is a single instanced draw of one quad per tile, so
+// the cost barely grows with the number of games. The GL context has to be
+// current for every call, including the destructor.
+class WallRenderer
+{
+public:
+    using Framebuffer = ScreenBackend::Framebuffer;
+    using Color = ScreenBackend::Color;
+
+    static constexpr int maxTiles = 256; // Array layers every 3.3 driver has
+
+    explicit WallRenderer(std::function<void()> swap);
+    ~WallRenderer();
+
+    WallRenderer(const WallRenderer &) = delete;
+    WallRenderer &operator=(const WallRenderer &) = delete;
+
+    // Builds the shader and a texture for tiles screens, at most maxTiles
+    bool init(int tiles);
+
+    // Window client size; picks the grid that shows the tiles largest
+    void resize(int width, int height);
+    int columns() const { return gridColumns; }
+    int rows() const { return gridRows; }
+
+    // Tile at a window position, -1 between or outside tiles
+    int tileAt(int x, int y) const;
+
+    // Takes one tile's screen, re-uploading only its layer and only if it changed
+    void upload(int tile, const Framebuffer &gfx, bool hires);
+
+    // Draws every tile; selected (or -1) gets a frame in the lit colour
+    void draw(const Color &off, const Color &on, int selected);
+    void present() { swapBuffers(); }
+
+private:
+    struct Tile
+    {
+        Framebuffer gfx{};
+        bool hires = false;
+        bool stale = true;
+    };
+
+    std::function<void()> swapBuffers;
+    bool ready = false;
+    unsigned program = 0;
+    unsigned vertexArray = 0; // Empty, corners come from gl_VertexID
+    unsigned texture = 0;
+    int gridUniform = -1;
+    int paletteUniform = -1;
+    int selectedUniform = -1;
+    std::vector<Tile> tiles;
+    std::array<uint32_t, 4 * 65> staging{}; // One layer: 64 screen rows and the flags row
+    int width = 0;
+    int height = 0;
+    int gridColumns = 1;
+    int gridRows = 1;
+};
+
+#endif
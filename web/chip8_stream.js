@@ -0,0 +1,118 @@
+// Client for chip8-server: keeps a copy of the session's screen up to date
+// from the frames the server streams and draws it into a canvas, and sends
+// the held keys back. See stream_server.h for the message layout.
+//
+//   const session = new Chip8Stream(document.querySelector('canvas'),
+//                                   'ws://localhost:8068/Pong%20(alt).ch8');
+
+// The desktop layout: 1234 / QWER / ASDF / ZXCV for the 4x4 keypad
+const streamKeyCodes = {
+    Digit1: 0x1, Digit2: 0x2, Digit3: 0x3, Digit4: 0xC,
+    KeyQ: 0x4, KeyW: 0x5, KeyE: 0x6, KeyR: 0xD,
+    KeyA: 0x7, KeyS: 0x8, KeyD: 0x9, KeyF: 0xE,
+    KeyZ: 0xA, KeyX: 0x0, KeyC: 0xB, KeyV: 0xF,
+};
+
+class Chip8Stream
+{
+    constructor(canvas, url)
+    {
+        this.canvas = canvas;
+        this.context = canvas.getContext('2d');
+        this.screen = document.createElement('canvas'); // One texel per pixel, scaled up onto canvas
+        this.screen.width = 128;
+        this.screen.height = 64;
+        this.screenContext = this.screen.getContext('2d');
+        this.image = this.screenContext.createImageData(128, 64);
+        this.words = new Uint32Array(256); // Chip8::gfx as little-endian halves
+        this.hires = false;
+        this.sound = false;
+        this.keys = 0;
+        this.dirty = false;
+
+        this.socket = new WebSocket(url);
+        this.socket.binaryType = 'arraybuffer';
+        this.socket.onmessage = (event) => this.receive(new Uint8Array(event.data));
+        this.socket.onclose = () => this.onClose && this.onClose();
+
+        window.addEventListener('keydown', (event) => this.key(event, true));
+        window.addEventListener('keyup', (event) => this.key(event, false));
+        requestAnimationFrame(() => this.draw());
+    }
+
+    close()
+    {
+        this.socket.close();
+    }
+
+    // Flags byte, then the whole screen or a changed-word bitmap and the
+    // changed words XORed in
+    receive(message)
+    {
+        const flags = message[0];
+        this.hires = (flags & 1) !== 0;
+        this.sound = (flags & 2) !== 0;
+        const view = new DataView(message.buffer, message.byteOffset, message.byteLength);
+        if (flags & 4)
+        {
+            for (let i = 0; i < 256; ++i)
+                this.words[i] = view.getUint32(1 + i * 4, true);
+        }
+        else
+        {
+            let at = 17;
+            for (let word = 0; word < 128; ++word)
+            {
+                if (!(message[1 + (word >> 3)] & (1 << (word & 7))))
+                    continue;
+                this.words[word * 2] ^= view.getUint32(at, true);
+                this.words[word * 2 + 1] ^= view.getUint32(at + 4, true);
+                at += 8;
+            }
+        }
+        this.dirty = true;
+    }
+
+    key(event, pressed)
+    {
+        const key = streamKeyCodes[event.code];
+        if (key === undefined || event.repeat)
+            return;
+        const mask = pressed ? this.keys | (1 << key) : this.keys & ~(1 << key);
+        if (mask !== this.keys && this.socket.readyState === WebSocket.OPEN)
+        {
+            this.keys = mask;
+            this.socket.send(new Uint8Array([mask & 0xFF, mask >> 8]));
+        }
+        event.preventDefault();
+    }
+
+    // Lo-res uses the first word of the top 32 rows, bit 63 leftmost
+    draw()
+    {
+        requestAnimationFrame(() => this.draw());
+        if (!this.dirty)
+            return;
+        this.dirty = false;
+
+        const width = this.hires ? 128 : 64;
+        const height = this.hires ? 64 : 32;
+        const pixels = this.image.data;
+        for (let y = 0; y < height; ++y)
+        {
+            for (let x = 0; x < width; ++x)
+            {
+                const word = y * 2 + (x >> 6);
+                const bit = 63 - (x & 63);
+                const half = this.words[word * 2 + (bit >> 5)];
+                const lit = (half >>> (bit & 31)) & 1;
+                const p = (y * 128 + x) * 4;
+                pixels[p] = pixels[p + 1] = pixels[p + 2] = lit ? 255 : 0;
+                pixels[p + 3] = 255;
+            }
+        }
+        this.screenContext.putImageData(this.image, 0, 0, 0, 0, width, height);
+        this.context.imageSmoothingEnabled = false;
+        this.context.drawImage(this.screen, 0, 0, width, height, 0, 0, this.canvas.width, this.canvas.height);
+    }
+}
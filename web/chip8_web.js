@@ -0,0 +1,149 @@
+// Page side of the web build: starts chip8_worker.js and draws the frames
+// it publishes into a canvas, reading them straight from the worker's
+// shared wasm memory. Needs a cross-origin isolated page (COOP/COEP
+// headers) for SharedArrayBuffer.
+//
+//   const chip8 = new Chip8Web(document.querySelector('canvas'));
+//   await chip8.load(await (await fetch('pong.ch8')).arrayBuffer(), 10);
+//   await chip8.spectate('ws://host:8068/watch/12'); // Or follow a server session
+
+// The desktop layout: 1234 / QWER / ASDF / ZXCV for the 4x4 keypad
+const keyCodes = {
+    Digit1: 0x1, Digit2: 0x2, Digit3: 0x3, Digit4: 0xC,
+    KeyQ: 0x4, KeyW: 0x5, KeyE: 0x6, KeyR: 0xD,
+    KeyA: 0x7, KeyS: 0x8, KeyD: 0x9, KeyF: 0xE,
+    KeyZ: 0xA, KeyX: 0x0, KeyC: 0xB, KeyV: 0xF,
+};
+
+class Chip8Web
+{
+    constructor(canvas, workerUrl = 'chip8_worker.js')
+    {
+        this.canvas = canvas;
+        this.context = canvas.getContext('2d');
+        this.screen = document.createElement('canvas'); // One texel per pixel, scaled up onto canvas
+        this.screen.width = 128;
+        this.screen.height = 64;
+        this.screenContext = this.screen.getContext('2d');
+        this.image = this.screenContext.createImageData(128, 64);
+        this.keys = 0;
+        this.socket = null; // While spectating
+        this.shown = -1; // Sequence of the frame on screen
+        this.worker = new Worker(workerUrl);
+        this.ready = new Promise((resolve) =>
+        {
+            this.worker.onmessage = (event) =>
+            {
+                const message = event.data;
+                if (message.type === 'ready')
+                {
+                    // WasmFrame: sequence, hires, sound, reserved, then 128 words
+                    this.sequence = new Int32Array(message.memory, message.frame, 4);
+                    this.words = new Uint32Array(message.memory, message.frame + 16, 256);
+                    resolve();
+                    requestAnimationFrame(() => this.draw());
+                }
+                else if (message.type === 'loaded' && this.onLoaded)
+                {
+                    this.onLoaded(message.ok);
+                }
+            };
+        });
+
+        window.addEventListener('keydown', (event) => this.key(event, true));
+        window.addEventListener('keyup', (event) => this.key(event, false));
+    }
+
+    // Resolves to false if the ROM doesn't fit the machine
+    async load(rom, ipf = 10, seed = Math.random() * 2 ** 32)
+    {
+        await this.ready;
+        return new Promise((resolve) =>
+        {
+            this.onLoaded = resolve;
+            this.worker.postMessage({type: 'load', rom, ipf, seed}, [rom]);
+        });
+    }
+
+    // Follows a chip8-server session: the worker runs the machine the
+    // server sends on the keys it sends. Resolves once connected.
+    async spectate(url)
+    {
+        await this.ready;
+        if (this.socket)
+            this.socket.close();
+        const socket = new WebSocket(url);
+        socket.binaryType = 'arraybuffer';
+        socket.onmessage = (event) =>
+        {
+            if (event.data instanceof ArrayBuffer)
+                this.worker.postMessage({type: 'stream', message: event.data}, [event.data]);
+        };
+        socket.onclose = () =>
+        {
+            if (this.socket === socket)
+                this.socket = null;
+        };
+        this.socket = socket;
+        return new Promise((resolve, reject) =>
+        {
+            socket.onopen = () => resolve();
+            socket.onerror = () => reject(new Error('could not watch ' + url));
+        });
+    }
+
+    setPaused(paused)
+    {
+        this.worker.postMessage({type: 'pause', paused});
+    }
+
+    key(event, pressed)
+    {
+        const key = keyCodes[event.code];
+        if (key === undefined || event.repeat || this.socket)
+            return; // A spectated machine takes its keys from the server
+        const mask = pressed ? this.keys | (1 << key) : this.keys & ~(1 << key);
+        if (mask !== this.keys)
+        {
+            this.keys = mask;
+            this.worker.postMessage({type: 'keys', mask});
+        }
+        event.preventDefault();
+    }
+
+    // Lo-res uses the first word of the top 32 rows, bit 63 leftmost. A
+    // frame the worker wrote to meanwhile is skipped, the next one is drawn.
+    draw()
+    {
+        requestAnimationFrame(() => this.draw());
+        const before = Atomics.load(this.sequence, 0);
+        if ((before & 1) || before === this.shown)
+            return;
+
+        const hires = this.sequence[1] !== 0;
+        const width = hires ? 128 : 64;
+        const height = hires ? 64 : 32;
+        const pixels = this.image.data;
+        for (let y = 0; y < height; ++y)
+        {
+            for (let x = 0; x < width; ++x)
+            {
+                // Little-endian halves of each 64-bit word: high half first on screen
+                const word = y * 2 + (x >> 6);
+                const bit = 63 - (x & 63);
+                const half = this.words[word * 2 + (bit >> 5)];
+                const lit = (half >>> (bit & 31)) & 1;
+                const p = (y * 128 + x) * 4;
+                pixels[p] = pixels[p + 1] = pixels[p + 2] = lit ? 255 : 0;
+                pixels[p + 3] = 255;
+            }
+        }
+        if (Atomics.load(this.sequence, 0) !== before)
+            return; // Torn, try again next animation frame
+
+        this.shown = before;
+        this.screenContext.putImageData(this.image, 0, 0, 0, 0, width, height);
+        this.context.imageSmoothingEnabled = false;
+        this.context.drawImage(this.screen, 0, 0, width, height, 0, 0, this.canvas.width, this.canvas.height);
+    }
+}
@@ -0,0 +1,107 @@
+// Runs the wasm core (chip8_wasm.cpp) at 60 frames per second off the
+// page's main thread. The wasm memory is shared, so after "ready" the page
+// reads every published frame directly from it; only ROMs and key changes
+// travel as messages.
+//
+// Messages in:  {type: 'load', rom: ArrayBuffer, ipf, seed}
+//               {type: 'keys', mask}      bit k = CHIP-8 key k held
+//               {type: 'pause', paused}
+//               {type: 'stream', message: ArrayBuffer}  a spectator
+//                   message from chip8-server, see stream_server.h; the
+//                   machine then runs a frame per message, not on the clock
+// Messages out: {type: 'ready', memory: SharedArrayBuffer, frame: offset}
+//               {type: 'loaded', ok}
+
+importScripts('chip8.js'); // Emscripten output, exports createChip8Module
+
+const framePeriod = 1000 / 60;
+const maxCatchUp = 6; // Frames run at once after the worker was held up
+
+let core = null;
+let keys = 0;
+let paused = true;
+let nextFrame = 0;
+let streamKeys = 0;
+
+function spectate(bytes)
+{
+    if (bytes[0] === 0x10 && bytes.length > 5)
+    {
+        const state = bytes.subarray(5);
+        if (state.length > core._chip8_wasm_state_capacity())
+            return;
+        core.HEAPU8.set(state, core._chip8_wasm_state_buffer());
+        streamKeys = bytes[3] | (bytes[4] << 8);
+        paused = true;
+        core._chip8_wasm_load_state(state.length, bytes[1] | (bytes[2] << 8), streamKeys);
+    }
+    else if (bytes[0] === 0x01)
+    {
+        core._chip8_wasm_step(1, streamKeys);
+    }
+    else if (bytes[0] === 0x02 && bytes.length >= 3)
+    {
+        streamKeys = bytes[1] | (bytes[2] << 8);
+        core._chip8_wasm_step(1, streamKeys);
+    }
+}
+
+function tick()
+{
+    const now = performance.now();
+    if (!paused)
+    {
+        // Whole frames owed since the last tick; after a long stall start over
+        let due = Math.floor((now - nextFrame) / framePeriod) + 1;
+        if (due > maxCatchUp)
+        {
+            due = 1;
+            nextFrame = now;
+        }
+        if (due > 0)
+        {
+            core._chip8_wasm_step(due, keys);
+            nextFrame += due * framePeriod;
+        }
+    }
+    setTimeout(tick, Math.max(0, nextFrame - performance.now()));
+}
+
+self.onmessage = (event) =>
+{
+    const message = event.data;
+    switch (message.type)
+    {
+    case 'load':
+    {
+        const rom = new Uint8Array(message.rom);
+        const ok = rom.length <= core._chip8_wasm_rom_capacity();
+        if (ok)
+            core.HEAPU8.set(rom, core._chip8_wasm_rom_buffer());
+        const loaded = ok && core._chip8_wasm_load(rom.length, message.ipf || 10, message.seed >>> 0) === 1;
+        paused = !loaded;
+        nextFrame = performance.now();
+        self.postMessage({type: 'loaded', ok: loaded});
+        break;
+    }
+    case 'keys':
+        keys = message.mask & 0xFFFF;
+        break;
+    case 'pause':
+        paused = message.paused;
+        nextFrame = performance.now();
+        break;
+    case 'stream':
+        spectate(new Uint8Array(message.message));
+        break;
+    }
+};
+
+createChip8Module().then((module) =>
+{
+    core = module;
+    if (!(core.HEAPU8.buffer instanceof SharedArrayBuffer))
+        throw new Error('chip8.js must be built with -sSHARED_MEMORY, and the page must be cross-origin isolated');
+    self.postMessage({type: 'ready', memory: core.HEAPU8.buffer, frame: core._chip8_wasm_frame()});
+    tick();
+});